@@ -3,17 +3,197 @@
 #include "cbuildertextlogger.h"
 #include "cnesicideproject.h"
 
+#include <QtConcurrent>
+#include <QByteArrayMatcher>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+// Files are searched in parallel a batch at a time.  Each batch's results
+// are written to the search pane together, in the order the files were found.
+#define SEARCH_BATCH_SIZE 128
+
+// Index file header; the version changes whenever what is kept does.
+#define SEARCH_INDEX_MAGIC   0x4E534958
+#define SEARCH_INDEX_VERSION 1
+
+struct SearchParameters
+{
+   QByteArrayMatcher matcher;
+   QRegExp           regex;
+   QString           text;
+   bool              useRegex;
+
+   // Case-insensitive text that isn't plain ASCII is compared a line at a
+   // time as a QString, since lowercasing the bytes doesn't fold its case.
+   bool              foldCase;
+   bool              caseSensitive;
+   bool              useIndex;
+
+   // Trigrams of the lowercased search text; empty if the index can't
+   // rule files out for this search.
+   QVector<quint32>  trigrams;
+};
+
+struct SearchFileTask
+{
+   QString                 path;
+   const SearchParameters* pParameters;
+
+   // The file's index entry, or NULL if it isn't indexed.
+   const SearchIndexEntry* pEntry;
+};
+
+struct SearchFileResult
+{
+   QList<int>       lines;
+   QStringList      text;
+   bool             readable;
+
+   // Set if the file was (re)indexed.
+   bool             indexed;
+   SearchIndexEntry entry;
+};
+
+static void findTrigrams(const QByteArray& lowerContent,QVector<quint32>* trigrams)
+{
+   const uchar* data = (const uchar*)lowerContent.constData();
+   int idx;
+
+   trigrams->clear();
+   for ( idx = 0; idx+2 < lowerContent.size(); idx++ )
+   {
+      trigrams->append((data[idx]<<16)|(data[idx+1]<<8)|data[idx+2]);
+   }
+   std::sort(trigrams->begin(),trigrams->end());
+   trigrams->erase(std::unique(trigrams->begin(),trigrams->end()),trigrams->end());
+}
+
+static SearchFileResult searchFile(const SearchFileTask& task)
+{
+   const SearchParameters* pParameters = task.pParameters;
+   SearchFileResult result;
+   QFileInfo        fileInfo(task.path);
+   QFile            file(task.path);
+   QByteArray       content;
+   QByteArray       lowerContent;
+   QString          lineText;
+   QRegExp          regex;
+   bool             indexFresh;
+   int              trigram;
+   int              pos;
+   int              lineStart;
+   int              lineEnd;
+   int              line;
+
+   result.readable = true;
+   result.indexed = false;
+
+   // A file the index says can't contain the search text isn't read.
+   indexFresh = task.pEntry &&
+                (task.pEntry->size == fileInfo.size()) &&
+                (task.pEntry->modified == fileInfo.lastModified());
+   if ( indexFresh )
+   {
+      for ( trigram = 0; trigram < pParameters->trigrams.count(); trigram++ )
+      {
+         if ( !std::binary_search(task.pEntry->trigrams.constBegin(),task.pEntry->trigrams.constEnd(),pParameters->trigrams.at(trigram)) )
+         {
+            return result;
+         }
+      }
+   }
+
+   if ( !file.open(QIODevice::ReadOnly) )
+   {
+      result.readable = false;
+      return result;
+   }
+   content = file.readAll();
+   file.close();
+
+   if ( (!pParameters->caseSensitive) || (pParameters->useIndex && (!indexFresh)) )
+   {
+      lowerContent = content.toLower();
+   }
+   if ( pParameters->useIndex && (!indexFresh) )
+   {
+      result.indexed = true;
+      result.entry.size = fileInfo.size();
+      result.entry.modified = fileInfo.lastModified();
+      findTrigrams(lowerContent,&result.entry.trigrams);
+   }
+
+   if ( pParameters->useRegex || pParameters->foldCase )
+   {
+      regex = pParameters->regex;
+
+      line = 0;
+      for ( lineStart = 0; lineStart <= content.size(); lineStart = lineEnd+1 )
+      {
+         lineEnd = content.indexOf('\n',lineStart);
+         if ( lineEnd < 0 )
+         {
+            lineEnd = content.size();
+         }
+         lineText = QString::fromUtf8(content.constData()+lineStart,lineEnd-lineStart);
+         if ( (pParameters->useRegex)?lineText.contains(regex):lineText.contains(pParameters->text,Qt::CaseInsensitive) )
+         {
+            result.lines.append(line);
+            result.text.append(lineText);
+         }
+         line++;
+      }
+   }
+   else
+   {
+      // Search the raw bytes, then find the line around each match.
+      const QByteArray& haystack = pParameters->caseSensitive?content:lowerContent;
+
+      line = 0;
+      lineStart = 0;
+      for ( pos = pParameters->matcher.indexIn(haystack,0); pos >= 0; pos = pParameters->matcher.indexIn(haystack,pos) )
+      {
+         for ( lineEnd = content.indexOf('\n',lineStart); (lineEnd >= 0) && (lineEnd < pos); lineEnd = content.indexOf('\n',lineStart) )
+         {
+            lineStart = lineEnd+1;
+            line++;
+         }
+         if ( lineEnd < 0 )
+         {
+            lineEnd = content.size();
+         }
+         result.lines.append(line);
+         result.text.append(QString::fromUtf8(content.constData()+lineStart,lineEnd-lineStart));
+
+         // Each line is reported once.
+         pos = lineEnd+1;
+         if ( pos > haystack.size() )
+         {
+            break;
+         }
+      }
+   }
+   return result;
+}
+
 SearcherWorker::SearcherWorker(QObject*)
 {
    m_found = 0;
+   m_indexChanged = false;
 }
 
 SearcherWorker::~SearcherWorker()
 {
 }
 
-void SearcherWorker::search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive)
+void SearcherWorker::search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive, bool useIndex)
 {
+   QStringList files;
+
    m_dir = dir;
    m_searchText = searchText;
    m_pattern = pattern;
@@ -21,72 +201,247 @@ void SearcherWorker::search(QDir dir, QString searchText, QString pattern, bool
    m_sourceSearchPaths = sourceSearchPaths;
    m_useRegex = useRegex;
    m_caseSensitive = caseSensitive;
+   m_useIndex = useIndex;
 
-   m_found = 0;
-   doSearch(m_dir,&m_found);
+   // File patterns are separated by spaces or semicolons, as in "*.s;*.c".
+   m_nameFilters = QDir::nameFiltersFromString(m_pattern);
+
+   if ( !m_useIndex )
+   {
+      m_index.clear();
+      m_indexFile.clear();
+   }
+   else if ( indexFile(m_dir) != m_indexFile )
+   {
+      // A missing or unreadable index is simply built again.
+      m_indexFile = indexFile(m_dir);
+      readIndex(m_indexFile);
+      m_indexChanged = false;
+   }
+
+   findFiles(m_dir,&files);
    if ( m_sourceSearchPaths )
    {
       foreach ( QString searchPath, CNesicideProject::instance()->getSourceSearchPaths() )
       {
          m_dir = searchPath;
-         doSearch(m_dir,&m_found);
+         findFiles(m_dir,&files);
       }
    }
+
+   m_found = 0;
+   searchFiles(files,&m_found);
+   if ( m_useIndex && m_indexChanged )
+   {
+      writeIndex(m_indexFile);
+      m_indexChanged = false;
+   }
    emit searchDone(m_found);
 }
 
-void SearcherWorker::doSearch(QDir dir,int* finds)
+QString SearcherWorker::indexFile(QDir dir)
 {
-   QDir          base(QDir::currentPath());
-   QFileInfoList entries = dir.entryInfoList(QDir::AllDirs|QDir::NoDotAndDotDot|QDir::NoSymLinks|QDir::Files);
-   QFile         file;
-   QString       content;
-   QStringList   contentLines;
-   QString       foundText;
-   bool          found;
-   int           entry;
-   int           line;
-   Qt::CaseSensitivity caseSensitivity = (m_caseSensitive)?Qt::CaseSensitive:Qt::CaseInsensitive;
-   QRegExp       regex;
+   QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
 
-   regex = QRegExp(m_searchText);
-   regex.setCaseSensitivity(caseSensitivity);
+   return cacheDir.filePath("search/"+QCryptographicHash::hash(dir.absolutePath().toUtf8(),QCryptographicHash::Sha1).toHex()+".idx");
+}
+
+bool SearcherWorker::readIndex(QString indexFileName)
+{
+   QFile            file(indexFileName);
+   QDataStream      ds(&file);
+   SearchIndexEntry entry;
+   QString          path;
+   quint32          magic;
+   quint32          version;
+   quint32          count;
+   quint32          trigrams;
+   quint32          idx;
+   qint64           modified;
+
+   m_index.clear();
+
+   if ( !file.open(QIODevice::ReadOnly) )
+   {
+      return false;
+   }
+   ds.setVersion(QDataStream::Qt_5_0);
+
+   // Every entry takes at least 24 bytes, and every trigram 4.
+   ds >> magic >> version >> count;
+   if ( (ds.status() != QDataStream::Ok) ||
+        (magic != SEARCH_INDEX_MAGIC) ||
+        (version != SEARCH_INDEX_VERSION) ||
+        (count > (file.size()/24)) )
+   {
+      return false;
+   }
+   for ( idx = 0; (idx < count) && (ds.status() == QDataStream::Ok); idx++ )
+   {
+      ds >> path >> entry.size >> modified >> trigrams;
+      if ( (ds.status() != QDataStream::Ok) || (trigrams > (file.size()/4)) )
+      {
+         break;
+      }
+      entry.modified = QDateTime::fromMSecsSinceEpoch(modified);
+      entry.trigrams.resize(trigrams);
+      if ( ds.readRawData((char*)entry.trigrams.data(),trigrams*sizeof(quint32)) != (int)(trigrams*sizeof(quint32)) )
+      {
+         break;
+      }
+      m_index.insert(path,entry);
+   }
+   file.close();
+
+   if ( (idx < count) || (ds.status() != QDataStream::Ok) )
+   {
+      m_index.clear();
+      return false;
+   }
+   return true;
+}
+
+void SearcherWorker::writeIndex(QString indexFileName)
+{
+   QSaveFile   file(indexFileName);
+   QDataStream ds(&file);
+   QHash<QString,SearchIndexEntry>::iterator entry;
+
+   // Files that are gone are forgotten rather than carried forever.
+   for ( entry = m_index.begin(); entry != m_index.end(); )
+   {
+      if ( QFile::exists(entry.key()) )
+      {
+         ++entry;
+      }
+      else
+      {
+         entry = m_index.erase(entry);
+      }
+   }
+
+   QDir().mkpath(QFileInfo(indexFileName).absolutePath());
+   if ( !file.open(QIODevice::WriteOnly) )
+   {
+      return;
+   }
+   ds.setVersion(QDataStream::Qt_5_0);
+
+   // Trigrams are kept in the byte order of the machine that wrote them,
+   // as the cache is not shared between machines.
+   ds << (quint32)SEARCH_INDEX_MAGIC << (quint32)SEARCH_INDEX_VERSION << (quint32)m_index.count();
+   for ( entry = m_index.begin(); entry != m_index.end(); ++entry )
+   {
+      ds << entry.key() << entry.value().size << entry.value().modified.toMSecsSinceEpoch() << (quint32)entry.value().trigrams.count();
+      ds.writeRawData((const char*)entry.value().trigrams.constData(),entry.value().trigrams.count()*sizeof(quint32));
+   }
+
+   if ( ds.status() == QDataStream::Ok )
+   {
+      file.commit();
+   }
+   else
+   {
+      file.cancelWriting();
+   }
+}
+
+void SearcherWorker::findFiles(QDir dir,QStringList* files)
+{
+   QFileInfoList entries = dir.entryInfoList(m_nameFilters,QDir::AllDirs|QDir::NoDotAndDotDot|QDir::NoSymLinks|QDir::Files);
+   int           entry;
 
    for ( entry = 0; entry < entries.count(); entry++ )
    {
       if ( (m_subfolders) && (entries.at(entry).isDir()) )
       {
-         doSearch(QDir(entries.at(entry).filePath()),finds);
+         findFiles(QDir(entries.at(entry).filePath()),files);
       }
       else if ( entries.at(entry).isFile() )
       {
-         file.setFileName(entries.at(entry).filePath());
-         if ( file.open(QIODevice::ReadOnly) )
+         files->append(entries.at(entry).filePath());
+      }
+   }
+}
+
+void SearcherWorker::searchFiles(const QStringList& files,int* finds)
+{
+   QDir                    base(QDir::currentPath());
+   SearchParameters        parameters;
+   SearchFileTask          task;
+   QList<SearchFileTask>   tasks;
+   QList<SearchFileResult> results;
+   QStringList             foundText;
+   QString                 text;
+   QHash<QString,SearchIndexEntry>::const_iterator indexEntry;
+   int                     batch;
+   int                     file;
+   int                     line;
+
+   parameters.useRegex = m_useRegex;
+   parameters.caseSensitive = m_caseSensitive;
+   parameters.useIndex = m_useIndex;
+   parameters.text = m_searchText;
+   parameters.foldCase = (!m_caseSensitive) && (m_searchText.toUtf8() != m_searchText.toLatin1());
+   parameters.regex = QRegExp(m_searchText);
+   parameters.regex.setCaseSensitivity((m_caseSensitive)?Qt::CaseSensitive:Qt::CaseInsensitive);
+   if ( m_caseSensitive )
+   {
+      parameters.matcher.setPattern(m_searchText.toUtf8());
+   }
+   else
+   {
+      parameters.matcher.setPattern(m_searchText.toUtf8().toLower());
+   }
+   if ( m_useIndex && (!m_useRegex) && (!parameters.foldCase) )
+   {
+      findTrigrams(m_searchText.toUtf8().toLower(),&parameters.trigrams);
+   }
+
+   task.pParameters = &parameters;
+
+   for ( batch = 0; batch < files.count(); batch += SEARCH_BATCH_SIZE )
+   {
+      tasks.clear();
+      for ( file = batch; (file < files.count()) && (file < batch+SEARCH_BATCH_SIZE); file++ )
+      {
+         task.path = files.at(file);
+         task.pEntry = NULL;
+         indexEntry = m_index.constFind(task.path);
+         if ( indexEntry != m_index.constEnd() )
+         {
+            task.pEntry = &indexEntry.value();
+         }
+         tasks.append(task);
+      }
+
+      results = QtConcurrent::blockingMapped<QList<SearchFileResult> >(tasks,searchFile);
+
+      foundText.clear();
+      for ( file = 0; file < results.count(); file++ )
+      {
+         const SearchFileResult& result = results.at(file);
+
+         if ( result.indexed )
          {
-            content.clear();
-            content = file.readAll();
-            contentLines.clear();
-            contentLines = content.split(QRegExp("[\n]"));
-
-            for ( line = 0; line < contentLines.count(); line++ )
-            {
-               if ( m_useRegex )
-               {
-                  found = contentLines.at(line).contains(regex);
-               }
-               else
-               {
-                  found = contentLines.at(line).contains(m_searchText,caseSensitivity);
-               }
-               if ( found )
-               {
-                  foundText.sprintf("%s:%d:%s",base.relativeFilePath(entries.at(entry).filePath()).toLatin1().constData(),line+1,contentLines.at(line).toLatin1().constData());
-                  searchTextLogger->write(foundText);
-                  (*finds)++;
-               }
-            }
-            file.close();
+            m_index.insert(tasks.at(file).path,result.entry);
+            m_indexChanged = true;
          }
+         else if ( (!result.readable) && m_index.remove(tasks.at(file).path) )
+         {
+            m_indexChanged = true;
+         }
+
+         for ( line = 0; line < result.lines.count(); line++ )
+         {
+            text.sprintf("%s:%d:%s",base.relativeFilePath(tasks.at(file).path).toLatin1().constData(),result.lines.at(line)+1,result.text.at(line).toLatin1().constData());
+            foundText.append(text);
+            (*finds)++;
+         }
+      }
+      if ( !foundText.isEmpty() )
+      {
+         searchTextLogger->write(foundText.join("<br>"));
       }
    }
 }
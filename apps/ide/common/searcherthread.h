@@ -4,6 +4,19 @@
 #include <QThread>
 #include <QDir>
 #include <QSemaphore>
+#include <QHash>
+#include <QDateTime>
+#include <QVector>
+
+// What the search index knows about one file: the distinct trigrams of
+// its lowercased contents, sorted, as of the size and modification time
+// it had when it was last read.
+struct SearchIndexEntry
+{
+   qint64           size;
+   QDateTime        modified;
+   QVector<quint32> trigrams;
+};
 
 class SearcherWorker : public QObject
 {
@@ -12,13 +25,17 @@ public:
    SearcherWorker ( QObject* parent = 0 );
    virtual ~SearcherWorker ();
 
-   void search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive);
+   void search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive, bool useIndex);
 
 signals:
    void searchDone(int found);
 
 protected:
-   void doSearch(QDir dir,int* finds);
+   void findFiles(QDir dir,QStringList* files);
+   void searchFiles(const QStringList& files,int* finds);
+   QString indexFile(QDir dir);
+   bool readIndex(QString indexFileName);
+   void writeIndex(QString indexFileName);
    bool m_isTerminating;
    QDir m_dir;
    QString m_searchText;
@@ -27,7 +44,16 @@ protected:
    bool m_sourceSearchPaths;
    bool m_useRegex;
    bool m_caseSensitive;
+   bool m_useIndex;
+   QStringList m_nameFilters;
    int m_found;
+
+   // Kept across searches while the index is in use, and across sessions
+   // in the cache, one file per searched folder.  Entries are brought up
+   // to date as files are found to have changed.
+   QHash<QString,SearchIndexEntry> m_index;
+   QString m_indexFile;
+   bool m_indexChanged;
 };
 
 class SearcherThread : public QObject
@@ -38,9 +64,9 @@ public:
    virtual ~SearcherThread ();
 
 public slots:
-   void search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive)
+   void search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive, bool useIndex)
    {
-      pWorker->search(dir,searchText,pattern,subfolders,sourceSearchPaths,useRegex,caseSensitive);
+      pWorker->search(dir,searchText,pattern,subfolders,sourceSearchPaths,useRegex,caseSensitive,useIndex);
    }
 
 signals:
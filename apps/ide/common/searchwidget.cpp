@@ -30,6 +30,7 @@ SearchWidget::SearchWidget(QWidget *parent) :
    ui->caseSensitive->setChecked(settings.value("CaseSensitive",QVariant(false)).toBool());
    ui->regex->setChecked(settings.value("RegularExpression",QVariant(false)).toBool());
    ui->projectFolder->setChecked(settings.value("UseProjectFolder",QVariant(true)).toBool());
+   ui->searchIndex->setChecked(settings.value("UseSearchIndex",QVariant(false)).toBool());
    settings.endGroup();
 
    on_projectFolder_clicked(ui->projectFolder->isChecked());
@@ -40,7 +41,7 @@ SearchWidget::SearchWidget(QWidget *parent) :
 
    QObject* searcher = CObjectRegistry::instance()->getObject("Searcher");
    qRegisterMetaType<QDir>("QDir");
-   QObject::connect(this,SIGNAL(search(QDir,QString,QString,bool,bool,bool,bool)),searcher,SLOT(search(QDir,QString,QString,bool,bool,bool,bool)));
+   QObject::connect(this,SIGNAL(search(QDir,QString,QString,bool,bool,bool,bool,bool)),searcher,SLOT(search(QDir,QString,QString,bool,bool,bool,bool,bool)));
    QObject::connect(searcher,SIGNAL(searchDone(int)),this,SLOT(searcher_searchDone(int)));
 
    ui->searchText->installEventFilter(this);
@@ -109,6 +110,7 @@ void SearchWidget::on_find_clicked()
       settings.setValue("CaseSensitive",QVariant(ui->caseSensitive->isChecked()));
       settings.setValue("RegularExpression",QVariant(ui->regex->isChecked()));
       settings.setValue("UseProjectFolder",QVariant(ui->projectFolder->isChecked()));
+      settings.setValue("UseSearchIndex",QVariant(ui->searchIndex->isChecked()));
       if ( (!ui->location->currentText().isEmpty()) && (ui->location->findText(ui->location->currentText(),Qt::MatchExactly|Qt::MatchCaseSensitive) == -1) )
       {
          ui->location->addItem(ui->location->currentText());
@@ -155,11 +157,11 @@ void SearchWidget::on_find_clicked()
       searchTextLogger->write("<b>Searching for \""+ui->searchText->currentText()+"\"...</b>");
       if ( ui->projectFolder->isChecked() )
       {
-         emit search(QDir::currentPath(),ui->searchText->currentText(),ui->type->currentText(),ui->subfolders->isChecked(),ui->sourceSearchPaths->isChecked(),ui->regex->isChecked(),ui->caseSensitive->isChecked());
+         emit search(QDir::currentPath(),ui->searchText->currentText(),ui->type->currentText(),ui->subfolders->isChecked(),ui->sourceSearchPaths->isChecked(),ui->regex->isChecked(),ui->caseSensitive->isChecked(),ui->searchIndex->isChecked());
       }
       else
       {
-         emit search(ui->location->currentText(),ui->searchText->currentText(),ui->type->currentText(),ui->subfolders->isChecked(),ui->sourceSearchPaths->isChecked(),ui->regex->isChecked(),ui->caseSensitive->isChecked());
+         emit search(ui->location->currentText(),ui->searchText->currentText(),ui->type->currentText(),ui->subfolders->isChecked(),ui->sourceSearchPaths->isChecked(),ui->regex->isChecked(),ui->caseSensitive->isChecked(),ui->searchIndex->isChecked());
       }
 
       settings.endGroup();
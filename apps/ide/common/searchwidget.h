@@ -24,7 +24,7 @@ private:
    Ui::SearchWidget *ui;
 
 signals:
-   void search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive);
+   void search(QDir dir, QString searchText, QString pattern, bool subfolders, bool sourceSearchPaths, bool useRegex, bool caseSensitive, bool useIndex);
    void snapTo(QString item);
 
 private slots:
@@ -11,6 +11,8 @@
 
 #include "environmentsettingsdialog.h"
 
+#include "ccc65objectcache.h"
+
 CCC65Interface *CCC65Interface::_instance = NULL;
 
 // This utility compares two file paths regardless of original slashery.
@@ -23,19 +25,20 @@ bool fileNamesAreIdentical(QString file1, QString file2)
 
 static const char* clangTargetRuleFmt =
       "vpath %<!extension!> $(foreach <!extension!>,$(SOURCES),$(dir $<!extension!>))\r\n\r\n"
-      "$(OBJDIR)/%.o: %.<!extension!>\r\n"
+      "$(OBJDIR)/%.o: %.<!extension!> | $(OBJDIR)\r\n"
       "\t$(COMPILE) --create-dep $(@:.o=.d) -S $(CFLAGS) -o $(@:.o=.s) $<\r\n"
       "\t$(ASSEMBLE) $(ASFLAGS) -o $@ $(@:.o=.s)\r\n\r\n"
       ;
 
 static const char* asmTargetRuleFmt =
       "vpath %<!extension!> $(foreach <!extension!>,$(SOURCES),$(dir $<!extension!>))\r\n\r\n"
-      "$(OBJDIR)/%.o: %.<!extension!>\r\n"
-      "\t$(ASSEMBLE) $(ASFLAGS) -o $@ $<\r\n\r\n"
+      "$(OBJDIR)/%.o: %.<!extension!> | $(OBJDIR)\r\n"
+      "\t$(ASSEMBLE) --create-dep $(@:.o=.d) $(ASFLAGS) -o $@ $<\r\n\r\n"
       ;
 
 CCC65Interface::CCC65Interface()
    : dbgInfo(NULL),
+     nesIndexed(false),
      targetMachine("none"),
      process(NULL)
 {
@@ -58,6 +61,12 @@ void CCC65Interface::clear()
 {
    cc65_free_dbginfo(dbgInfo);
    dbgInfo = 0;
+
+   nesIndexProtect.lock();
+   nesAddressRanges.clear();
+   nesOpcodeAddresses.clear();
+   nesIndexed = false;
+   nesIndexProtect.unlock();
 }
 
 QStringList CCC65Interface::getAssemblerSourcesFromProject()
@@ -159,6 +168,37 @@ QStringList CCC65Interface::getCustomSourcesFromProject()
    return includedSources;
 }
 
+QString CCC65Interface::getObjectFlagsFromProject(bool clang)
+{
+   QString flags;
+
+   // Everything substituted into ASFLAGS, and CFLAGS for C sources.
+   flags = targetMachine+"\n";
+   if ( clang )
+   {
+      flags += CNesicideProject::instance()->getCompilerDefinedSymbols()+"\n";
+      flags += CNesicideProject::instance()->getCompilerAdditionalOptions()+"\n";
+      flags += CNesicideProject::instance()->getCompilerIncludePaths()+"\n";
+   }
+   flags += CNesicideProject::instance()->getAssemblerDefinedSymbols()+"\n";
+   flags += CNesicideProject::instance()->getAssemblerAdditionalOptions()+"\n";
+   flags += CNesicideProject::instance()->getAssemblerIncludePaths()+"\n";
+
+   return flags;
+}
+
+QString CCC65Interface::getToolchainVersion()
+{
+   QProcess version;
+
+   // Objects built by another cc65 release are not reused.
+   version.setProcessChannelMode(QProcess::MergedChannels);
+   version.start("cl65 --version");
+   version.waitForFinished();
+
+   return QString(version.readAll())+"\n";
+}
+
 bool CCC65Interface::createMakefile()
 {
    QDir outputDir(QDir::currentPath());
@@ -189,12 +229,10 @@ bool CCC65Interface::createMakefile()
       targetRules += targetRule;
    }
 
-   // Create the project's makefile...
-   makeFile.open(QIODevice::ReadWrite|QIODevice::Truncate);
-
-   if ( res.isOpen() && makeFile.isOpen() )
+   if ( res.isOpen() )
    {
       QString makeFileContent;
+      QByteArray makeFileData;
 
       // Read the embedded Makefile resource.
       makeFileContent = res.readAll();
@@ -229,13 +267,33 @@ bool CCC65Interface::createMakefile()
       }
       makeFileContent.replace("<!custom-rules!>",customRulesFiles);
 
-      // Write the file to disk.
-      makeFile.write(makeFileContent.toLatin1());
-
-      makeFile.close();
       res.close();
 
-      return true;
+      // The makefile includes the dependency files of the last build.
+      CCC65ObjectCache::rewriteDependencies(CNesicideProject::instance()->getProjectOutputBasePath(),
+                                            getCLanguageSourcesFromProject()+getAssemblerSourcesFromProject());
+
+      // The makefile is regenerated before every build and up-to-date
+      // check but rarely changes; leave it alone if it hasn't.
+      makeFileData = makeFileContent.toLatin1();
+      if ( makeFile.open(QIODevice::ReadOnly) )
+      {
+         if ( makeFile.readAll() == makeFileData )
+         {
+            makeFile.close();
+            return true;
+         }
+         makeFile.close();
+      }
+
+      // Write the file to disk.
+      if ( makeFile.open(QIODevice::WriteOnly|QIODevice::Truncate) )
+      {
+         makeFile.write(makeFileData);
+         makeFile.close();
+
+         return true;
+      }
    }
 
    return false;
@@ -375,6 +433,10 @@ bool CCC65Interface::assemble()
    QStringList                  stdioList;
    QDir                         outputDir(CNesicideProject::instance()->getProjectLinkerOutputBasePath());
    QString                      outputName;
+   QString                      toolchain;
+   CCC65ObjectCache*            clangCache = NULL;
+   CCC65ObjectCache*            asmCache = NULL;
+   int                          objects;
    int                          exitCode;
    bool                         ok = true;
 
@@ -406,18 +468,46 @@ bool CCC65Interface::assemble()
 
    createMakefile();
 
-   invocationStr = "make -f nesicide.mk all";
+   // Objects of unchanged sources are copied in from the cache so that
+   // make sees them as up to date.
+   if ( EnvironmentSettingsDialog::useObjectCache() )
+   {
+      toolchain = getToolchainVersion();
+      clangCache = new CCC65ObjectCache(CNesicideProject::instance()->getProjectOutputBasePath(),
+                                        toolchain+getObjectFlagsFromProject(true));
+      asmCache = new CCC65ObjectCache(CNesicideProject::instance()->getProjectOutputBasePath(),
+                                      toolchain+getObjectFlagsFromProject(false));
+      objects = clangCache->restore(getCLanguageSourcesFromProject());
+      objects += asmCache->restore(getAssemblerSourcesFromProject());
+      if ( objects )
+      {
+         buildTextLogger->write("Reused "+QString::number(objects)+" object(s) from the object cache.");
+      }
+   }
+
+   invocationStr = "make -j"+QString::number(EnvironmentSettingsDialog::buildJobs())+" -f nesicide.mk all";
 
    buildTextLogger->write(invocationStr);
 
    process.start(invocationStr);
-   process.waitForFinished();
+   process.waitForFinished(-1);
    exitCode = process.exitCode();
    if ( exitCode )
    {
       ok = false;
    }
 
+   if ( clangCache && asmCache )
+   {
+      if ( ok )
+      {
+         clangCache->store(getCLanguageSourcesFromProject());
+         asmCache->store(getAssemblerSourcesFromProject());
+      }
+      delete clangCache;
+      delete asmCache;
+   }
+
    QObject::disconnect(&process,SIGNAL(started()),this,SLOT(process_started()));
    QObject::disconnect(&process,SIGNAL(finished(int,QProcess::ExitStatus)),this,SLOT(process_finished(int,QProcess::ExitStatus)));
    QObject::disconnect(&process,SIGNAL(errorOccurred(QProcess::ProcessError)),this,SLOT(process_errorOccurred(QProcess::ProcessError)));
@@ -471,9 +561,234 @@ bool CCC65Interface::captureDebugInfo()
    // Check consistency of debug information when it's loaded.
    CCC65Interface::isBuildUpToDate();
 
+   if ( !targetMachine.compare("nes",Qt::CaseInsensitive) )
+   {
+      nesBuildAddressIndex();
+   }
+
    return true;
 }
 
+static bool nesAddressRangeLessThan(const CCC65Interface::CC65AddressRange& a,const CCC65Interface::CC65AddressRange& b)
+{
+   return a.absAddr < b.absAddr;
+}
+
+// Where a segment's first byte is in PRG-ROM.  Segments written to the
+// output file are offset by the iNES header.
+static uint32_t nesSegmentPhysicalBase(const cc65_segmentdata& segment)
+{
+   if ( segment.output_name )
+   {
+      return segment.output_offs-0x10;
+   }
+   return segment.output_offs;
+}
+
+void CCC65Interface::nesBuildAddressIndex()
+{
+   const cc65_segmentinfo* dbgSegments;
+   const cc65_spaninfo* dbgSpans;
+   QVector<CC65AddressRange> ranges;
+   QVector<uint32_t> opcodes;
+   QVector<uint32_t> cuts;
+   QVector<unsigned> overlaps;
+   CC65AddressRange range;
+   uint32_t physBase;
+   uint32_t spanBase;
+   uint32_t virtAddr;
+   int      segment;
+   int      other;
+   int      span;
+   int      cut;
+
+   // The queries below must not be answered from the old index.
+   nesIndexProtect.lock();
+   nesAddressRanges.clear();
+   nesOpcodeAddresses.clear();
+   nesIndexed = false;
+   nesIndexProtect.unlock();
+
+   if ( !dbgInfo )
+   {
+      return;
+   }
+
+   dbgSegments = cc65_get_segmentlist(dbgInfo);
+   dbgSpans = cc65_get_spanlist(dbgInfo);
+
+   if ( dbgSegments && dbgSpans )
+   {
+      for ( segment = 0; segment < dbgSegments->count; segment++ )
+      {
+         const cc65_segmentdata& seg = dbgSegments->data[segment];
+
+         if ( (!seg.output_name) || (!seg.segment_size) )
+         {
+            continue;
+         }
+         physBase = nesSegmentPhysicalBase(seg);
+
+         // The answers can only change where some segment's PRG-ROM range
+         // starts or ends, or where a span that could contain an address
+         // of this segment starts or ends.  Spans of segments that are
+         // elsewhere in PRG-ROM never match.
+         cuts.clear();
+         cuts.append(0);
+         cuts.append(seg.segment_size);
+         overlaps.clear();
+         for ( other = 0; other < dbgSegments->count; other++ )
+         {
+            const cc65_segmentdata& oseg = dbgSegments->data[other];
+
+            cuts.append(nesSegmentPhysicalBase(oseg)-physBase);
+            cuts.append(nesSegmentPhysicalBase(oseg)+oseg.segment_size-physBase);
+            if ( (nesSegmentPhysicalBase(oseg) < physBase+seg.segment_size) &&
+                 (nesSegmentPhysicalBase(oseg)+oseg.segment_size > physBase) )
+            {
+               overlaps.append(oseg.segment_id);
+            }
+         }
+         for ( span = 0; span < dbgSpans->count; span++ )
+         {
+            const cc65_spandata& spn = dbgSpans->data[span];
+
+            if ( overlaps.contains(spn.segment_id) &&
+                 (spn.span_end >= seg.segment_start) &&
+                 (spn.span_start < seg.segment_start+seg.segment_size) )
+            {
+               cuts.append(spn.span_start-seg.segment_start);
+               cuts.append(spn.span_end+1-seg.segment_start);
+            }
+         }
+         qSort(cuts);
+
+         // Answer each run with the full query at its first address.  The
+         // index is empty while it is being built so these take the slow
+         // path.
+         for ( cut = 0; cut < cuts.count()-1; cut++ )
+         {
+            if ( (cuts.at(cut) == cuts.at(cut+1)) ||
+                 (cuts.at(cut) >= seg.segment_size) ||
+                 (cuts.at(cut+1) > seg.segment_size) )
+            {
+               continue;
+            }
+            range.absAddr = physBase+cuts.at(cut);
+            range.absEnd = physBase+cuts.at(cut+1)-1;
+            range.addr = seg.segment_start+cuts.at(cut);
+            range.file = nesGetSourceFileFromPhysicalAddress(range.addr,range.absAddr);
+            range.sourceLine = nesGetSourceLineFromPhysicalAddress(range.addr,range.absAddr);
+            range.endAddr = nesGetEndAddressFromPhysicalAddress(range.addr,range.absAddr);
+
+            // Runs answered the same way are kept as one.
+            if ( (!ranges.isEmpty()) &&
+                 (ranges.last().absEnd+1 == range.absAddr) &&
+                 (ranges.last().addr+(range.absAddr-ranges.last().absAddr) == range.addr) &&
+                 (ranges.last().sourceLine == range.sourceLine) &&
+                 (ranges.last().endAddr == range.endAddr) &&
+                 (ranges.last().file == range.file) )
+            {
+               ranges.last().absEnd = range.absEnd;
+            }
+            else
+            {
+               ranges.append(range);
+            }
+         }
+      }
+
+      // An address is an opcode if a span starts there and the span can be
+      // found by looking up the address in one of the eight 8KB windows of
+      // the CPU address space.
+      for ( span = 0; span < dbgSpans->count; span++ )
+      {
+         const cc65_spandata& spn = dbgSpans->data[span];
+
+         for ( segment = 0; segment < dbgSegments->count; segment++ )
+         {
+            if ( dbgSegments->data[segment].segment_id == spn.segment_id )
+            {
+               break;
+            }
+         }
+         if ( segment == dbgSegments->count )
+         {
+            continue;
+         }
+         spanBase = nesSegmentPhysicalBase(dbgSegments->data[segment])+(spn.span_start-dbgSegments->data[segment].segment_start);
+         for ( virtAddr = (spanBase&MASK_8KB); virtAddr < MEM_64KB; virtAddr += MEM_8KB )
+         {
+            if ( (virtAddr >= spn.span_start) && (virtAddr <= spn.span_end) )
+            {
+               opcodes.append(spanBase);
+               break;
+            }
+         }
+      }
+      qSort(opcodes);
+   }
+
+   if ( dbgSegments )
+   {
+      cc65_free_segmentinfo(dbgInfo,dbgSegments);
+   }
+   if ( dbgSpans )
+   {
+      cc65_free_spaninfo(dbgInfo,dbgSpans);
+   }
+
+   qSort(ranges.begin(),ranges.end(),nesAddressRangeLessThan);
+
+   nesIndexProtect.lock();
+   nesAddressRanges.swap(ranges);
+   nesOpcodeAddresses.swap(opcodes);
+   nesIndexed = true;
+   nesIndexProtect.unlock();
+}
+
+bool CCC65Interface::nesFindAddressRange(uint32_t addr,uint32_t absAddr,CC65AddressRange* range)
+{
+   bool found = false;
+   int  lo = 0;
+   int  hi;
+   int  mid;
+
+   nesIndexProtect.lock();
+
+   hi = nesAddressRanges.count()-1;
+   while ( lo <= hi )
+   {
+      mid = (lo+hi)>>1;
+
+      const CC65AddressRange& candidate = nesAddressRanges.at(mid);
+
+      if ( absAddr < candidate.absAddr )
+      {
+         hi = mid-1;
+      }
+      else if ( absAddr > candidate.absEnd )
+      {
+         lo = mid+1;
+      }
+      else
+      {
+         // The index only knows the address each physical address is
+         // assembled for; anything else takes the slow path.
+         if ( candidate.addr+(absAddr-candidate.absAddr) == addr )
+         {
+            (*range) = candidate;
+            found = true;
+         }
+         break;
+      }
+   }
+
+   nesIndexProtect.unlock();
+
+   return found;
+}
+
 bool CCC65Interface::isBuildUpToDate()
 {
    QProcessEnvironment          env = QProcessEnvironment::systemEnvironment();
@@ -1041,6 +1356,13 @@ QString CCC65Interface::nesGetSourceFileFromPhysicalAddress(uint32_t addr,uint32
    int indexOfHighestTypeMatch = -1;
    QString file = "";
 
+   CC65AddressRange range;
+
+   if ( nesFindAddressRange(addr,absAddr,&range) )
+   {
+      return range.file;
+   }
+
    if ( dbgInfo )
    {
       // Get the span containing this virtual address.
@@ -1221,6 +1543,13 @@ int CCC65Interface::nesGetSourceLineFromPhysicalAddress(uint32_t addr,uint32_t a
    int indexOfHighestTypeMatch = -1;
    int source_line = -1;
 
+   CC65AddressRange range;
+
+   if ( nesFindAddressRange(addr,absAddr,&range) )
+   {
+      return range.sourceLine;
+   }
+
    if ( dbgInfo )
    {
       // Get the span containing this virtual address.
@@ -1824,6 +2153,13 @@ unsigned int CCC65Interface::nesGetEndAddressFromPhysicalAddress(uint32_t addr,u
    int indexOfHighestTypeMatch = -1;
    int endAddr = -1;
 
+   CC65AddressRange range;
+
+   if ( nesFindAddressRange(addr,absAddr,&range) )
+   {
+      return range.endAddr;
+   }
+
    if ( dbgInfo )
    {
       dbgSpans = cc65_span_byaddr(dbgInfo,addr);
@@ -1984,6 +2320,41 @@ bool CCC65Interface::nesIsPhysicalAddressAnOpcode(uint32_t absAddr)
    uint32_t addr;
    int      span;
    bool     opcode = false;
+   bool     indexed;
+   int      lo = 0;
+   int      hi;
+   int      mid;
+
+   // Served from the index when there is one.
+   nesIndexProtect.lock();
+   indexed = nesIndexed;
+   if ( indexed )
+   {
+      hi = nesOpcodeAddresses.count()-1;
+      while ( lo <= hi )
+      {
+         mid = (lo+hi)>>1;
+         if ( absAddr < nesOpcodeAddresses.at(mid) )
+         {
+            hi = mid-1;
+         }
+         else if ( absAddr > nesOpcodeAddresses.at(mid) )
+         {
+            lo = mid+1;
+         }
+         else
+         {
+            opcode = true;
+            break;
+         }
+      }
+   }
+   nesIndexProtect.unlock();
+
+   if ( indexed )
+   {
+      return opcode;
+   }
 
    if ( dbgInfo )
    {
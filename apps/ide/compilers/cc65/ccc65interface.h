@@ -3,6 +3,7 @@
 
 #include <QProcess>
 #include <QMutex>
+#include <QVector>
 
 #include "stdint.h"
 
@@ -12,6 +13,18 @@ class CCC65Interface : public QObject
 {
    Q_OBJECT
 public:
+   // A run of PRG-ROM physical addresses that the NES address queries
+   // answer the same way for, and the virtual address of its first byte.
+   typedef struct
+   {
+      uint32_t     absAddr;
+      uint32_t     absEnd;
+      uint32_t     addr;
+      QString      file;
+      int          sourceLine;
+      unsigned int endAddr;
+   } CC65AddressRange;
+
    static CCC65Interface *_instance;
    static CCC65Interface *instance()
    {
@@ -34,6 +47,8 @@ public:
    QStringList getCLanguageSourcesFromProject();
    QStringList getAssemblerSourcesFromProject();
    QStringList getCustomSourcesFromProject();
+   QString getObjectFlagsFromProject(bool clang);
+   QString getToolchainVersion();
    void updateTargetMachine(QString target);
 
    // Debug information parsing/extending APIs.
@@ -89,7 +104,21 @@ public slots:
    void process_stateChanged(QProcess::ProcessState newState);
 
 protected:
+   // Built from the debug information by captureDebugInfo so that the
+   // per-row address queries of the code browser, breakpoint markers and
+   // loader are a binary search instead of a walk of the debug
+   // information.  Ranges are sorted by physical address and do not
+   // overlap; opcode addresses are sorted.  The index is built aside and
+   // swapped in under nesIndexProtect, and lookups copy out under it, so
+   // the debugger threads never see it half-replaced.
+   void nesBuildAddressIndex();
+   bool nesFindAddressRange(uint32_t addr,uint32_t absAddr,CC65AddressRange* range);
+
    cc65_dbginfo        dbgInfo;
+   QVector<CC65AddressRange> nesAddressRanges;
+   QVector<uint32_t>   nesOpcodeAddresses;
+   bool                nesIndexed;
+   QMutex              nesIndexProtect;
    QStringList         errors;
    QString             targetMachine;
    QMutex              protect;
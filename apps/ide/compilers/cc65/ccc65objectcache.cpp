@@ -0,0 +1,466 @@
+#include "ccc65objectcache.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QStandardPaths>
+
+// Closures remembered per source, most recently built first.  A few are
+// enough to flip between branches that include different headers.
+#define MAX_CLOSURES_PER_SOURCE 8
+
+// Objects and dependency files past this many bytes, least recently used
+// first, are removed after each store.
+#define MAX_CACHE_SIZE (256*1024*1024)
+
+CCC65ObjectCache::CCC65ObjectCache(QString objectDir,QString flags)
+   : m_cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)),
+     m_objectDir(QDir::fromNativeSeparators(objectDir)),
+     m_flags(flags)
+{
+   m_cacheDir.mkpath("objects");
+   m_cacheDir.cd("objects");
+}
+
+QString CCC65ObjectCache::objectFile(const QString& objectDir,const QString& source)
+{
+   // Same naming as OBJECTS in the makefile.
+   return objectDir+"/"+QFileInfo(source).completeBaseName()+".o";
+}
+
+QString CCC65ObjectCache::dependencyFile(const QString& objectDir,const QString& source)
+{
+   return objectDir+"/"+QFileInfo(source).completeBaseName()+".d";
+}
+
+QString CCC65ObjectCache::projectPath(const QString& file)
+{
+   QString path = QDir::cleanPath(QDir::fromNativeSeparators(file));
+   QString relative = QDir::current().relativeFilePath(path);
+
+   // The build runs in the project directory.  Anything outside of it,
+   // such as the toolchain's own includes, keeps its absolute path.
+   if ( relative.startsWith("../") || QDir::isAbsolutePath(relative) )
+   {
+      return path;
+   }
+   return relative;
+}
+
+QString CCC65ObjectCache::makePath(const QString& file)
+{
+   QString path = file;
+
+   path.replace("$","$$");
+   path.replace("#","\\#");
+   path.replace(" ","\\ ");
+   return path;
+}
+
+QString CCC65ObjectCache::manifestFile(const QString& source)
+{
+   QCryptographicHash hash(QCryptographicHash::Sha1);
+
+   hash.addData(projectPath(source).toUtf8());
+   hash.addData("",1);
+   hash.addData(m_flags.toUtf8());
+   return m_cacheDir.filePath(hash.result().toHex()+".manifest");
+}
+
+QStringList CCC65ObjectCache::readDependencies(const QString& dependencyFile)
+{
+   QFile       file(dependencyFile);
+   QString     text;
+   QStringList lines;
+   QStringList closure;
+   QString     path;
+   int         colon;
+   int         idx;
+
+   if ( !file.open(QIODevice::ReadOnly) )
+   {
+      return closure;
+   }
+   text = QString::fromUtf8(file.readAll());
+   file.close();
+
+   // Only the first rule is wanted; the rest are the empty rules for the
+   // headers.  A drive letter's colon is not followed by whitespace.
+   // Escapes are those of both the toolchain and rewriteDependencies.
+   text.replace("\\\r\n"," ");
+   text.replace("\\\n"," ");
+   lines = text.split(QRegExp("[\r\n]"),QString::SkipEmptyParts);
+   foreach ( const QString& line, lines )
+   {
+      colon = line.indexOf(QRegExp(":(\\s|$)"));
+      if ( colon < 0 )
+      {
+         continue;
+      }
+      for ( idx = colon+1; idx < line.length(); idx++ )
+      {
+         if ( (line.at(idx) == '\\') && (idx+1 < line.length()) &&
+              ((line.at(idx+1) == ' ') || (line.at(idx+1) == '#')) )
+         {
+            path += line.at(idx+1);
+            idx++;
+         }
+         else if ( (line.at(idx) == '$') && (idx+1 < line.length()) && (line.at(idx+1) == '$') )
+         {
+            path += '$';
+            idx++;
+         }
+         else if ( line.at(idx).isSpace() )
+         {
+            if ( !path.isEmpty() )
+            {
+               closure.append(projectPath(path));
+               path.clear();
+            }
+         }
+         else
+         {
+            path += line.at(idx);
+         }
+      }
+      if ( !path.isEmpty() )
+      {
+         closure.append(projectPath(path));
+      }
+      break;
+   }
+
+   return closure;
+}
+
+bool CCC65ObjectCache::isCurrent(const QString& objectFile,const QString& source,const QStringList& closure)
+{
+   QFileInfo objectInfo(objectFile);
+
+   if ( (!objectInfo.exists()) ||
+        (objectInfo.lastModified() < QFileInfo(source).lastModified()) )
+   {
+      return false;
+   }
+   foreach ( const QString& file, closure )
+   {
+      if ( objectInfo.lastModified() < QFileInfo(file).lastModified() )
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+void CCC65ObjectCache::rewriteDependencies(QString objectDir,const QStringList& sources)
+{
+   QStringList closure;
+   QString     source;
+   QString     content;
+   QFile       file;
+
+   // Same as OBJDIR in the makefile, so the target names match OBJECTS.
+   objectDir.replace('\\','/');
+
+   foreach ( const QString& item, sources )
+   {
+      file.setFileName(dependencyFile(objectDir,item));
+      closure = readDependencies(file.fileName());
+      if ( closure.isEmpty() )
+      {
+         continue;
+      }
+
+      source = projectPath(item);
+      content = makePath(objectFile(objectDir,item))+":";
+      foreach ( const QString& path, closure )
+      {
+         content += " "+makePath(path);
+      }
+      content += "\n";
+      foreach ( const QString& path, closure )
+      {
+         if ( path != source )
+         {
+            content += "\n"+makePath(path)+":\n";
+         }
+      }
+
+      // Left alone if already rewritten so that its time does not change.
+      if ( file.open(QIODevice::ReadOnly) )
+      {
+         if ( file.readAll() == content.toUtf8() )
+         {
+            file.close();
+            continue;
+         }
+         file.close();
+      }
+      if ( file.open(QIODevice::WriteOnly|QIODevice::Truncate) )
+      {
+         file.write(content.toUtf8());
+         file.close();
+      }
+   }
+}
+
+QList<QStringList> CCC65ObjectCache::readManifest(const QString& manifestFile)
+{
+   QFile              file(manifestFile);
+   QList<QStringList> closures;
+   QStringList        lines;
+
+   if ( file.open(QIODevice::ReadOnly) )
+   {
+      lines = QString::fromUtf8(file.readAll()).split('\n',QString::SkipEmptyParts);
+      foreach ( const QString& line, lines )
+      {
+         closures.append(line.split('\t',QString::SkipEmptyParts));
+      }
+      file.close();
+   }
+
+   return closures;
+}
+
+void CCC65ObjectCache::writeManifest(const QString& manifestFile,const QList<QStringList>& closures)
+{
+   QFile      file(manifestFile);
+   QByteArray content;
+
+   foreach ( const QStringList& closure, closures )
+   {
+      content += closure.join("\t").toUtf8();
+      content += '\n';
+   }
+   if ( file.open(QIODevice::WriteOnly|QIODevice::Truncate) )
+   {
+      file.write(content);
+      file.close();
+   }
+}
+
+QByteArray CCC65ObjectCache::fileHash(const QString& file)
+{
+   QHash<QString,QByteArray>::const_iterator iter = m_fileHashes.constFind(file);
+   QFile      input(file);
+   QByteArray result;
+
+   if ( iter != m_fileHashes.constEnd() )
+   {
+      return iter.value();
+   }
+
+   // A file that cannot be read hashes to nothing, which no object key
+   // is built from.
+   if ( input.open(QIODevice::ReadOnly) )
+   {
+      result = QCryptographicHash::hash(input.readAll(),QCryptographicHash::Sha1);
+      input.close();
+   }
+   m_fileHashes.insert(file,result);
+   return result;
+}
+
+QByteArray CCC65ObjectCache::objectKey(const QString& source,const QStringList& closure)
+{
+   QCryptographicHash hash(QCryptographicHash::Sha1);
+   QByteArray         contents;
+
+   hash.addData(projectPath(source).toUtf8());
+   hash.addData("",1);
+   hash.addData(m_flags.toUtf8());
+   hash.addData("",1);
+   contents = fileHash(source);
+   if ( contents.isEmpty() )
+   {
+      return QByteArray();
+   }
+   hash.addData(contents);
+   foreach ( const QString& file, closure )
+   {
+      contents = fileHash(file);
+      if ( contents.isEmpty() )
+      {
+         return QByteArray();
+      }
+      hash.addData(file.toUtf8());
+      hash.addData("",1);
+      hash.addData(contents);
+   }
+   return hash.result().toHex();
+}
+
+bool CCC65ObjectCache::copyFile(const QString& from,const QString& to)
+{
+   QFile      input(from);
+   QFile      output(to);
+   QByteArray content;
+
+   // Written rather than QFile::copy'd so the copy is newer than its
+   // sources wherever the platform's copy would keep the old time.
+   if ( !input.open(QIODevice::ReadOnly) )
+   {
+      return false;
+   }
+   content = input.readAll();
+   input.close();
+   if ( !output.open(QIODevice::WriteOnly|QIODevice::Truncate) )
+   {
+      return false;
+   }
+   if ( output.write(content) != content.size() )
+   {
+      output.close();
+      output.remove();
+      return false;
+   }
+   output.close();
+   return true;
+}
+
+void CCC65ObjectCache::touch(const QString& file)
+{
+   QFile output(file);
+
+   // Marks an entry as used for trim().
+   if ( output.open(QIODevice::ReadWrite) )
+   {
+      output.setFileTime(QDateTime::currentDateTime(),QFileDevice::FileModificationTime);
+      output.close();
+   }
+}
+
+void CCC65ObjectCache::trim()
+{
+   QFileInfoList files = m_cacheDir.entryInfoList(QDir::Files,QDir::Time);
+   qint64        size = 0;
+
+   // Newest first; an object and its dependency file go together.
+   foreach ( const QFileInfo& file, files )
+   {
+      size += file.size();
+      if ( size <= MAX_CACHE_SIZE )
+      {
+         continue;
+      }
+      if ( (file.suffix() == "o") || (file.suffix() == "d") )
+      {
+         m_cacheDir.remove(file.completeBaseName()+".o");
+         m_cacheDir.remove(file.completeBaseName()+".d");
+      }
+      else
+      {
+         m_cacheDir.remove(file.fileName());
+      }
+   }
+}
+
+int CCC65ObjectCache::restore(const QStringList& sources)
+{
+   QList<QStringList> closures;
+   QString            manifest;
+   QByteArray         key;
+   int                restored = 0;
+
+   QDir().mkpath(m_objectDir);
+
+   foreach ( const QString& source, sources )
+   {
+      // Leave alone anything make already considers up to date: an object
+      // newer than its source and everything it included.
+      if ( isCurrent(objectFile(m_objectDir,source),source,
+                     readDependencies(dependencyFile(m_objectDir,source))) )
+      {
+         continue;
+      }
+
+      manifest = manifestFile(source);
+      closures = readManifest(manifest);
+      foreach ( const QStringList& closure, closures )
+      {
+         key = objectKey(source,closure);
+         if ( key.isEmpty() ||
+              (!QFile::exists(m_cacheDir.filePath(key+".o"))) )
+         {
+            continue;
+         }
+         if ( copyFile(m_cacheDir.filePath(key+".d"),dependencyFile(m_objectDir,source)) &&
+              copyFile(m_cacheDir.filePath(key+".o"),objectFile(m_objectDir,source)) )
+         {
+            touch(m_cacheDir.filePath(key+".d"));
+            touch(m_cacheDir.filePath(key+".o"));
+            touch(manifest);
+            restored++;
+         }
+         break;
+      }
+   }
+
+   return restored;
+}
+
+int CCC65ObjectCache::store(const QStringList& sources)
+{
+   QStringList        closure;
+   QList<QStringList> closures;
+   QString            manifest;
+   QByteArray         key;
+   int                stored = 0;
+
+   // The cached dependency files are restored where make includes them.
+   rewriteDependencies(m_objectDir,sources);
+
+   foreach ( const QString& source, sources )
+   {
+      closure = readDependencies(dependencyFile(m_objectDir,source));
+      if ( closure.isEmpty() )
+      {
+         continue;
+      }
+
+      // A file edited while the build ran is newer than the object, which
+      // was then not built from what the key would be hashed from.
+      if ( !isCurrent(objectFile(m_objectDir,source),source,closure) )
+      {
+         continue;
+      }
+
+      key = objectKey(source,closure);
+      if ( key.isEmpty() )
+      {
+         continue;
+      }
+
+      // Lookups check for the object, so it goes in last.
+      if ( !QFile::exists(m_cacheDir.filePath(key+".o")) )
+      {
+         if ( copyFile(dependencyFile(m_objectDir,source),m_cacheDir.filePath(key+".d")) &&
+              copyFile(objectFile(m_objectDir,source),m_cacheDir.filePath(key+".o")) )
+         {
+            stored++;
+         }
+      }
+
+      manifest = manifestFile(source);
+      closures = readManifest(manifest);
+      if ( closures.isEmpty() || (closures.first() != closure) )
+      {
+         closures.removeAll(closure);
+         closures.prepend(closure);
+         while ( closures.count() > MAX_CLOSURES_PER_SOURCE )
+         {
+            closures.removeLast();
+         }
+         writeManifest(manifest,closures);
+      }
+   }
+
+   if ( stored )
+   {
+      trim();
+   }
+
+   return stored;
+}
@@ -0,0 +1,67 @@
+#ifndef CCC65OBJECTCACHE_H
+#define CCC65OBJECTCACHE_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+// Objects built by the generated makefile, kept by a hash of everything
+// that goes into them: the source, the flags it is built with and the
+// contents of every file in its include closure as reported by the
+// --create-dep output of cc65/ca65.  A source's include closure is only
+// known once it has been built, so each source also has a manifest of the
+// closures it has been built with recently; a lookup tries each of them.
+//
+// The cache lives outside the project so that it survives a clean and
+// is shared by every checkout of the same project: files inside the
+// project are keyed by their project-relative path.  It is trimmed to
+// the most recently used objects that fit in MAX_CACHE_SIZE.
+class CCC65ObjectCache
+{
+public:
+   // Flags must include everything other than the source and its
+   // includes that changes the object, including the toolchain version.
+   CCC65ObjectCache(QString objectDir,QString flags);
+
+   // Copies in the cached object of each source that make would otherwise
+   // rebuild.  Returns the number of objects restored.
+   int restore(const QStringList& sources);
+
+   // Adds the objects of the sources that were built to the cache.
+   // Returns the number of objects added.
+   int store(const QStringList& sources);
+
+   // Rewrites the --create-dep output of each source with forward slashes,
+   // project-relative paths and an empty rule for each included file, so
+   // that the generated makefile can include it on every platform and a
+   // deleted include does not stop make.
+   static void rewriteDependencies(QString objectDir,const QStringList& sources);
+
+private:
+   static QString objectFile(const QString& objectDir,const QString& source);
+   static QString dependencyFile(const QString& objectDir,const QString& source);
+   static QString projectPath(const QString& file);
+   static QString makePath(const QString& file);
+   static QStringList readDependencies(const QString& dependencyFile);
+   static bool isCurrent(const QString& objectFile,const QString& source,const QStringList& closure);
+   QString manifestFile(const QString& source);
+   QList<QStringList> readManifest(const QString& manifestFile);
+   void writeManifest(const QString& manifestFile,const QList<QStringList>& closures);
+   QByteArray fileHash(const QString& file);
+   QByteArray objectKey(const QString& source,const QStringList& closure);
+   bool copyFile(const QString& from,const QString& to);
+   void touch(const QString& file);
+   void trim();
+
+   QDir    m_cacheDir;
+   QString m_objectDir;
+   QString m_flags;
+
+   // Headers are shared by many sources; each is hashed once per build.
+   QHash<QString,QByteArray> m_fileHashes;
+};
+
+#endif // CCC65OBJECTCACHE_H
@@ -357,12 +357,10 @@ int CCodeBrowserDisplayModel::columnCount(const QModelIndex& parent) const
 
 void CCodeBrowserDisplayModel::update()
 {
-   // Update display...
-   if ( !CNesicideProject::instance()->getProjectTarget().compare("nes",Qt::CaseInsensitive) )
-   {
-      nesDisassemble();
-   }
-   else if ( !CNesicideProject::instance()->getProjectTarget().compare("c64",Qt::CaseInsensitive) )
+   // Update display...  The NES emulator thread disassembles before it
+   // stops, resets or updates the debuggers, as it cannot be done here
+   // while it runs.
+   if ( !CNesicideProject::instance()->getProjectTarget().compare("c64",Qt::CaseInsensitive) )
    {
       c64Disassemble();
    }
@@ -1,19 +1,61 @@
-#include <QFileInfo>
-
 #include "cdebuggercodeprofilermodel.h"
 
 #include "ccc65interface.h"
 #include "nes_emulator_core.h"
 
-#include "ccodedatalogger.h"
+class ProfiledItemLessThan
+{
+public:
+   ProfiledItemLessThan(int column,Qt::SortOrder order) : m_column(column), m_order(order) {}
+   bool operator()(const ProfiledItem& left,const ProfiledItem& right) const
+   {
+      if ( m_order == Qt::DescendingOrder )
+      {
+         return lessThan(right,left);
+      }
+      return lessThan(left,right);
+   }
+
+private:
+   bool lessThan(const ProfiledItem& left,const ProfiledItem& right) const
+   {
+      switch ( m_column )
+      {
+      case CodeProfilerCol_Symbol:
+         return left.symbol < right.symbol;
+      case CodeProfilerCol_Address:
+         return left.address < right.address;
+      case CodeProfilerCol_Size:
+         return left.size < right.size;
+      case CodeProfilerCol_Calls:
+         return left.calls < right.calls;
+      case CodeProfilerCol_Inclusive:
+         return left.inclusive < right.inclusive;
+      case CodeProfilerCol_Exclusive:
+         return left.exclusive < right.exclusive;
+      case CodeProfilerCol_PerFrame:
+         return left.perFrame < right.perFrame;
+      case CodeProfilerCol_PeakFrame:
+         return left.peakFrame < right.peakFrame;
+      case CodeProfilerCol_File:
+         return left.file < right.file;
+      }
+      return false;
+   }
+
+   int           m_column;
+   Qt::SortOrder m_order;
+};
 
 CDebuggerCodeProfilerModel::CDebuggerCodeProfilerModel(QObject *parent) :
     QAbstractTableModel(parent)
 {
-   m_currentSortColumn = CodeProfilerCol_Symbol;
+   m_currentSortColumn = CodeProfilerCol_Inclusive;
    m_currentSortOrder = Qt::DescendingOrder;
-   m_currentItemCount = 0;
    m_modelStringBuffer = new char[32];
+   m_symbolsValid = false;
+   m_profiler = NULL;
+   m_generation = 0;
 }
 
 CDebuggerCodeProfilerModel::~CDebuggerCodeProfilerModel()
@@ -35,51 +77,49 @@ QModelIndex CDebuggerCodeProfilerModel::index(int row, int column, const QModelI
 {
    if ( (row >= 0) && (row < m_items.count()) )
    {
-      CCodeDataLogger* pLogger;
-      unsigned int addr;
-      unsigned int absAddr;
-
-      addr = CCC65Interface::instance()->getSymbolAddress(m_items.at(row).symbol);
-      absAddr = CCC65Interface::instance()->getSymbolPhysicalAddress(m_items.at(row).symbol);
-
-      if ( addr >= MEM_32KB )
-      {
-         pLogger = nesGetPhysicalPRGROMCodeDataLoggerDatabase(absAddr);
-         return createIndex(row,column,pLogger);
-      }
-      return QModelIndex();
+      return createIndex(row,column);
    }
    return QModelIndex();
 }
 
 QVariant CDebuggerCodeProfilerModel::data(const QModelIndex& index, int role) const
 {
-   CCodeDataLogger* pLogger = reinterpret_cast<CCodeDataLogger*>(index.internalPointer());
-   unsigned int addr;
-   unsigned int absAddr;
-
    if (role != Qt::DisplayRole)
    {
       return QVariant();
    }
 
+   const ProfiledItem& item = m_items.at(index.row());
+
    // Get data for columns...
    switch ( index.column() )
    {
    case CodeProfilerCol_Symbol:
-      return m_items.at(index.row()).symbol;
+      return item.symbol;
       break;
    case CodeProfilerCol_Address:
-      return m_items.at(index.row()).address;
+      return item.address;
       break;
    case CodeProfilerCol_Size:
-      return QVariant(m_items.at(index.row()).size);
+      return QVariant(item.size);
       break;
    case CodeProfilerCol_Calls:
-      return QVariant(m_items.at(index.row()).count);
+      return QVariant(item.calls);
+      break;
+   case CodeProfilerCol_Inclusive:
+      return QVariant(item.inclusive);
+      break;
+   case CodeProfilerCol_Exclusive:
+      return QVariant(item.exclusive);
+      break;
+   case CodeProfilerCol_PerFrame:
+      return QVariant(item.perFrame);
+      break;
+   case CodeProfilerCol_PeakFrame:
+      return QVariant(item.peakFrame);
       break;
    case CodeProfilerCol_File:
-      return m_items.at(index.row()).file;
+      return item.file;
       break;
    }
    return QVariant();
@@ -108,6 +148,18 @@ QVariant CDebuggerCodeProfilerModel::headerData(int section, Qt::Orientation ori
       case CodeProfilerCol_Calls:
          return QString("# Calls");
          break;
+      case CodeProfilerCol_Inclusive:
+         return QString("Inclusive");
+         break;
+      case CodeProfilerCol_Exclusive:
+         return QString("Exclusive");
+         break;
+      case CodeProfilerCol_PerFrame:
+         return QString("Per Frame");
+         break;
+      case CodeProfilerCol_PeakFrame:
+         return QString("Peak Frame");
+         break;
       case CodeProfilerCol_File:
          return QString("File");
          break;
@@ -126,142 +178,150 @@ int CDebuggerCodeProfilerModel::columnCount(const QModelIndex&) const
    return CodeProfilerCol_MAX;
 }
 
-void CDebuggerCodeProfilerModel::update()
+const ProfiledItem* CDebuggerCodeProfilerModel::getItemForRoutine(uint32_t routine) const
 {
-   QStringList symbols = CCC65Interface::instance()->getSymbolsForSourceFile(""); // CPTODO: File doesn't matter (yet).
-   CCodeDataLogger* pLogger;
-   unsigned int addr;
-   unsigned int absAddr;
-   ProfiledItem item;
-   QFileInfo fileInfo;
-   unsigned int mask;
+   if ( routine < (uint32_t)m_rowOfRoutine.count() )
+   {
+      return &m_items.at(m_rowOfRoutine.at(routine));
+   }
+   return NULL;
+}
+
+void CDebuggerCodeProfilerModel::clear()
+{
+   beginResetModel();
+   m_items.clear();
+   m_rowOfRoutine.clear();
+   m_symbols.clear();
+   m_symbolsValid = false;
+   endResetModel();
+}
+
+void CDebuggerCodeProfilerModel::resolve(ProfiledItem& item, uint32_t addr, uint32_t absAddr)
+{
+   QStringList symbols;
+   unsigned int symbolAddr;
+   unsigned int symbolAbsAddr;
 
-   foreach ( QString symbol, symbols )
+   // Routines are named by the symbol at their entry point, if any.
+   if ( !m_symbolsValid )
    {
-      // CPTODO: Temporary hack to get around temporary labels.
-      if ( !symbol.startsWith('@') )
+      symbols = CCC65Interface::instance()->getSymbolsForSourceFile(""); // CPTODO: File doesn't matter (yet).
+      foreach ( QString symbol, symbols )
       {
-         addr = CCC65Interface::instance()->getSymbolAddress(symbol);
-         absAddr = CCC65Interface::instance()->getSymbolPhysicalAddress(symbol);
-
-         if ( absAddr != -1 )
+         // CPTODO: Temporary hack to get around temporary labels.
+         if ( !symbol.startsWith('@') )
          {
-            pLogger = NULL;
-            if ( addr >= 0x8000 )
-            {
-               pLogger = nesGetPhysicalPRGROMCodeDataLoggerDatabase(absAddr);
-            }
-            else if ( addr >= 0x6000 )
-            {
-               pLogger = nesGetPhysicalSRAMCodeDataLoggerDatabase(absAddr);
-            }
-            else if ( addr >= 0x5C00 )
-            {
-               pLogger = nesGetEXRAMCodeDataLoggerDatabase();
-            }
-            else if ( addr < 0x800 )
-            {
-               pLogger = nesGetCpuCodeDataLoggerDatabase();
-            }
-            if ( pLogger )
+            symbolAddr = CCC65Interface::instance()->getSymbolAddress(symbol);
+            symbolAbsAddr = CCC65Interface::instance()->getSymbolPhysicalAddress(symbol);
+
+            if ( (symbolAbsAddr != (unsigned int)-1) &&
+                 (!m_symbols.contains((((quint64)symbolAddr)<<32)|symbolAbsAddr)) )
             {
-               mask = pLogger->GetMask();
-               if ( (pLogger->GetCount(addr&mask)) &&
-                    (pLogger->GetType(addr&mask) == eLogger_InstructionFetch) )
-               {
-                  item.symbol = symbol;
-                  item.size = CCC65Interface::instance()->getSymbolSize(symbol);
-                  item.file = CCC65Interface::instance()->getSourceFileFromSymbol(symbol);
-                  fileInfo.setFile(item.file);
-
-                  nesGetPrintablePhysicalAddress(m_modelStringBuffer,addr,absAddr);
-                  item.address = m_modelStringBuffer;
-                  item.count = pLogger->GetCount(addr&mask);
-                  if ( !m_items.contains(item) )
-                  {
-                     m_items.append(item);
-                  }
-                  else
-                  {
-                     m_items.replace(m_items.indexOf(item),item);
-                  }
-               }
+               m_symbols.insert((((quint64)symbolAddr)<<32)|symbolAbsAddr,symbol);
             }
          }
       }
+      m_symbolsValid = true;
    }
 
-   sort(m_currentSortColumn,m_currentSortOrder);
+   nesGetPrintablePhysicalAddress(m_modelStringBuffer,addr,absAddr);
+   item.address = m_modelStringBuffer;
+   item.symbol = m_symbols.value((((quint64)addr)<<32)|absAddr);
+   item.size = 0;
+   if ( item.symbol.isEmpty() )
+   {
+      item.symbol = item.address;
+   }
+   else
+   {
+      item.size = CCC65Interface::instance()->getSymbolSize(item.symbol);
+   }
+   item.file = CCC65Interface::instance()->getSourceFileFromPhysicalAddress(addr,absAddr);
 }
 
-void CDebuggerCodeProfilerModel::sort(int column, Qt::SortOrder order)
+void CDebuggerCodeProfilerModel::update()
 {
-   int idx1;
-   int idx2;
-   QString strData1;
-   QString strData2;
-   unsigned int uiData1;
-   unsigned int uiData2;
-
-   if ( (column != m_currentSortColumn) ||
-        (order != m_currentSortOrder) ||
-        (m_items.count() != m_currentItemCount) )
+   CProfiler* pProfiler = nesGetProfilerDatabase();
+   const ProfilerRoutineInfo* pRoutine;
+   uint32_t generation = pProfiler->GetGeneration();
+   uint32_t numRoutines = pProfiler->GetNumRoutines();
+   uint32_t numFrames = pProfiler->GetNumFrames();
+   uint32_t routine;
+   ProfiledItem item;
+   int row;
+
+   // The profile was cleared, or another machine's profile is being
+   // shown, since the last update.
+   if ( (pProfiler != m_profiler) || (generation != m_generation) )
    {
-      for ( idx1 = 0; idx1 < m_items.count(); idx1++ )
+      clear();
+      m_profiler = pProfiler;
+      m_generation = generation;
+   }
+
+   // Only routines new to the profile are looked up in the debug
+   // information.
+   if ( numRoutines > (uint32_t)m_rowOfRoutine.count() )
+   {
+      beginInsertRows(QModelIndex(),m_items.count(),m_items.count()+numRoutines-m_rowOfRoutine.count()-1);
+      for ( routine = m_rowOfRoutine.count(); routine < numRoutines; routine++ )
       {
-         for ( idx2 = idx1; idx2 < m_items.count(); idx2++ )
+         pRoutine = pProfiler->GetRoutine(routine);
+
+         item.routine = routine;
+         if ( routine == PROFILER_ROOT )
          {
-            switch ( column )
-            {
-            case CodeProfilerCol_Size:
-            case CodeProfilerCol_Calls:
-               // These columns require integer sorting.
-               uiData1 = data(index(idx1,column),Qt::DisplayRole).toInt();
-               uiData2 = data(index(idx2,column),Qt::DisplayRole).toInt();
-               switch ( order )
-               {
-               case Qt::AscendingOrder:
-                  if ( uiData1 > uiData2 )
-                  {
-                     m_items.swap(idx1,idx2);
-                  }
-                  break;
-               case Qt::DescendingOrder:
-                  if ( uiData2 > uiData1 )
-                  {
-                     m_items.swap(idx1,idx2);
-                  }
-                  break;
-               }
-               break;
-            default:
-               // Every other column can use string sorting.
-               strData1 = data(index(idx1,column),Qt::DisplayRole).toString();
-               strData2 = data(index(idx2,column),Qt::DisplayRole).toString();
-               switch ( order )
-               {
-               case Qt::AscendingOrder:
-                  if ( strData1 > strData2 )
-                  {
-                     m_items.swap(idx1,idx2);
-                  }
-                  break;
-               case Qt::DescendingOrder:
-                  if ( strData2 > strData1 )
-                  {
-                     m_items.swap(idx1,idx2);
-                  }
-                  break;
-               }
-               break;
-            }
+            // Code run outside of any call, usually the main loop.
+            item.symbol = "(reset)";
+            item.address = "";
+            item.size = 0;
+            item.file = "";
+         }
+         else
+         {
+            resolve(item,pRoutine->addr,pRoutine->absAddr);
          }
+
+         m_rowOfRoutine.append(m_items.count());
+         m_items.append(item);
       }
+      endInsertRows();
+   }
+
+   for ( row = 0; row < m_items.count(); row++ )
+   {
+      ProfiledItem& rItem = m_items[row];
+
+      pRoutine = pProfiler->GetRoutine(rItem.routine);
+      rItem.calls = pRoutine->calls;
+      rItem.inclusive = pRoutine->inclusive;
+      rItem.exclusive = pRoutine->exclusive;
+      rItem.perFrame = numFrames?(pRoutine->inclusive/numFrames):0;
+      rItem.peakFrame = pRoutine->peakInclusive;
+   }
+
+   sort(m_currentSortColumn,m_currentSortOrder);
+}
+
+void CDebuggerCodeProfilerModel::sort(int column, Qt::SortOrder order)
+{
+   int row;
+
+   emit layoutAboutToBeChanged();
+
+   qStableSort(m_items.begin(),m_items.end(),ProfiledItemLessThan(column,order));
+   for ( row = 0; row < m_items.count(); row++ )
+   {
+      m_rowOfRoutine[m_items.at(row).routine] = row;
    }
 
    m_currentSortColumn = column;
    m_currentSortOrder = order;
-   m_currentItemCount = m_items.count();
 
    emit layoutChanged();
+   if ( m_items.count() )
+   {
+      emit dataChanged(index(0,0),index(m_items.count()-1,CodeProfilerCol_MAX-1));
+   }
 }
@@ -2,7 +2,13 @@
 #define CDEBUGGERCODEPROFILERMODEL_H
 
 #include <QAbstractTableModel>
+#include <QHash>
 #include <QList>
+#include <QVector>
+
+#include <stdint.h>
+
+class CProfiler;
 
 enum
 {
@@ -10,28 +16,29 @@ enum
    CodeProfilerCol_Address,
    CodeProfilerCol_Size,
    CodeProfilerCol_Calls,
+   CodeProfilerCol_Inclusive,
+   CodeProfilerCol_Exclusive,
+   CodeProfilerCol_PerFrame,
+   CodeProfilerCol_PeakFrame,
    CodeProfilerCol_File,
    CodeProfilerCol_MAX
 };
 
+// One routine of the emulator's cycle profile.  The strings are looked up
+// in the debug information once, when the routine first appears in the
+// profile; the counts are copied from the profile on every update.
 struct ProfiledItem
 {
+   uint32_t routine;
    QString file;
    QString symbol;
    QString address;
    unsigned int size;
-   unsigned int count;
-   bool operator==(const ProfiledItem& rI)
-   {
-      if ( (rI.file == file) &&
-           (rI.symbol == symbol) &&
-           (rI.address == address) &&
-           (rI.size == size) )
-      {
-         return true;
-      }
-      return false;
-   }
+   unsigned int calls;
+   quint64 inclusive;
+   quint64 exclusive;
+   quint64 perFrame;
+   unsigned int peakFrame;
 };
 
 class CDebuggerCodeProfilerModel : public QAbstractTableModel
@@ -48,7 +55,8 @@ public:
    int rowCount(const QModelIndex& parent = QModelIndex()) const;
 
    QList<ProfiledItem> getItems() { return m_items; }
-   void clear() { m_items.clear(); }
+   const ProfiledItem* getItemForRoutine(uint32_t routine) const;
+   void clear();
 
 signals:
 
@@ -57,11 +65,21 @@ public slots:
    void sort(int column, Qt::SortOrder order);
 
 private:
+   void resolve(ProfiledItem& item, uint32_t addr, uint32_t absAddr);
+
    QList<ProfiledItem>  m_items;
+   QVector<int>         m_rowOfRoutine;
    int                  m_currentSortColumn;
    Qt::SortOrder        m_currentSortOrder;
-   int                  m_currentItemCount;
    char                *m_modelStringBuffer;
+
+   // Symbols by address, built on the first update after a clear.
+   QHash<quint64,QString> m_symbols;
+   bool                 m_symbolsValid;
+
+   // The profile the items were read from.
+   CProfiler*           m_profiler;
+   uint32_t             m_generation;
 };
 
 #endif // CDEBUGGERCODEPROFILERMODEL_H
@@ -0,0 +1,303 @@
+#include <QStringList>
+
+#include "cdebuggercodeprofilertreemodel.h"
+
+#include "nes_emulator_core.h"
+
+CDebuggerCodeProfilerTreeModel::CDebuggerCodeProfilerTreeModel(CDebuggerCodeProfilerModel* routines,QObject *parent) :
+    QAbstractItemModel(parent)
+{
+   m_routines = routines;
+   m_profiler = NULL;
+   m_generation = 0;
+}
+
+CDebuggerCodeProfilerTreeModel::~CDebuggerCodeProfilerTreeModel()
+{
+}
+
+Qt::ItemFlags CDebuggerCodeProfilerTreeModel::flags(const QModelIndex& /*index*/) const
+{
+   return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+}
+
+QModelIndex CDebuggerCodeProfilerTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+   if ( !parent.isValid() )
+   {
+      // The root of the call tree is the only top-level item.
+      if ( (row == 0) && (!m_nodes.isEmpty()) )
+      {
+         return createIndex(row,column,(quintptr)PROFILER_ROOT);
+      }
+      return QModelIndex();
+   }
+
+   const ProfiledNode& node = m_nodes.at(parent.internalId());
+   if ( (row >= 0) && (row < node.children.count()) )
+   {
+      return createIndex(row,column,(quintptr)node.children.at(row));
+   }
+   return QModelIndex();
+}
+
+QModelIndex CDebuggerCodeProfilerTreeModel::parent(const QModelIndex& index) const
+{
+   int parent;
+
+   if ( !index.isValid() )
+   {
+      return QModelIndex();
+   }
+
+   parent = m_nodes.at(index.internalId()).parent;
+   if ( parent < 0 )
+   {
+      return QModelIndex();
+   }
+   return createIndex(m_nodes.at(parent).row,0,(quintptr)parent);
+}
+
+QString CDebuggerCodeProfilerTreeModel::routineName(uint32_t routine) const
+{
+   const ProfiledItem* pItem = m_routines->getItemForRoutine(routine);
+
+   if ( pItem )
+   {
+      return pItem->symbol;
+   }
+   return QString("?");
+}
+
+QVariant CDebuggerCodeProfilerTreeModel::data(const QModelIndex& index, int role) const
+{
+   if ( !index.isValid() )
+   {
+      return QVariant();
+   }
+
+   const ProfiledNode& node = m_nodes.at(index.internalId());
+   quint64 total = m_nodes.at(PROFILER_ROOT).inclusive;
+
+   if ( role == CodeProfilerTreeSortRole )
+   {
+      switch ( index.column() )
+      {
+      case CodeProfilerTreeCol_Routine:
+         return routineName(node.routine);
+         break;
+      case CodeProfilerTreeCol_Calls:
+         return QVariant(node.calls);
+         break;
+      case CodeProfilerTreeCol_Exclusive:
+         return QVariant(node.exclusive);
+         break;
+      default:
+         return QVariant(node.inclusive);
+         break;
+      }
+   }
+
+   if ( role != Qt::DisplayRole )
+   {
+      return QVariant();
+   }
+
+   // Get data for columns...
+   switch ( index.column() )
+   {
+   case CodeProfilerTreeCol_Routine:
+      return routineName(node.routine);
+      break;
+   case CodeProfilerTreeCol_Calls:
+      return QVariant(node.calls);
+      break;
+   case CodeProfilerTreeCol_Inclusive:
+      return QVariant(node.inclusive);
+      break;
+   case CodeProfilerTreeCol_Exclusive:
+      return QVariant(node.exclusive);
+      break;
+   case CodeProfilerTreeCol_Percent:
+      return QString::number(total?(100.0*node.inclusive/total):0.0,'f',1)+"%";
+      break;
+   }
+   return QVariant();
+}
+
+QVariant CDebuggerCodeProfilerTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+   if (role != Qt::DisplayRole)
+   {
+      return QVariant();
+   }
+
+   if ( orientation == Qt::Horizontal )
+   {
+      switch ( section )
+      {
+      case CodeProfilerTreeCol_Routine:
+         return QString("Routine");
+         break;
+      case CodeProfilerTreeCol_Calls:
+         return QString("# Calls");
+         break;
+      case CodeProfilerTreeCol_Inclusive:
+         return QString("Inclusive");
+         break;
+      case CodeProfilerTreeCol_Exclusive:
+         return QString("Exclusive");
+         break;
+      case CodeProfilerTreeCol_Percent:
+         return QString("% Total");
+         break;
+      }
+   }
+   return QVariant();
+}
+
+int CDebuggerCodeProfilerTreeModel::rowCount(const QModelIndex& parent) const
+{
+   if ( !parent.isValid() )
+   {
+      return m_nodes.isEmpty()?0:1;
+   }
+   if ( parent.column() > 0 )
+   {
+      return 0;
+   }
+   return m_nodes.at(parent.internalId()).children.count();
+}
+
+int CDebuggerCodeProfilerTreeModel::columnCount(const QModelIndex&) const
+{
+   return CodeProfilerTreeCol_MAX;
+}
+
+const ProfiledItem* CDebuggerCodeProfilerTreeModel::getItem(const QModelIndex& index) const
+{
+   if ( index.isValid() )
+   {
+      return m_routines->getItemForRoutine(m_nodes.at(index.internalId()).routine);
+   }
+   return NULL;
+}
+
+void CDebuggerCodeProfilerTreeModel::clear()
+{
+   beginResetModel();
+   m_nodes.clear();
+   endResetModel();
+}
+
+void CDebuggerCodeProfilerTreeModel::update()
+{
+   CProfiler* pProfiler = nesGetProfilerDatabase();
+   const ProfilerNodeInfo* pNodeInfo;
+   uint32_t generation = pProfiler->GetGeneration();
+   int numNodes = pProfiler->GetNumNodes();
+   bool reset;
+   ProfiledNode node;
+   int idx;
+
+   // The profile was cleared, or another machine's profile is being
+   // shown, since the last update.
+   if ( (pProfiler != m_profiler) || (generation != m_generation) )
+   {
+      clear();
+      m_profiler = pProfiler;
+      m_generation = generation;
+   }
+
+   // Nodes are added after their parents, so each new node's parent is
+   // already in the tree.  A new tree is built in one go rather than a
+   // row at a time.
+   reset = m_nodes.isEmpty() && numNodes;
+   if ( reset )
+   {
+      beginResetModel();
+   }
+   for ( idx = m_nodes.count(); idx < numNodes; idx++ )
+   {
+      pNodeInfo = pProfiler->GetNode(idx);
+
+      node.routine = pNodeInfo->routine;
+      node.calls = 0;
+      node.inclusive = 0;
+      node.exclusive = 0;
+      if ( pNodeInfo->parent == PROFILER_NO_NODE )
+      {
+         node.parent = -1;
+         node.row = 0;
+      }
+      else
+      {
+         node.parent = pNodeInfo->parent;
+         node.row = m_nodes.at(node.parent).children.count();
+      }
+
+      if ( (!reset) && (node.parent >= 0) )
+      {
+         beginInsertRows(createIndex(m_nodes.at(node.parent).row,0,(quintptr)node.parent),node.row,node.row);
+      }
+      m_nodes.append(node);
+      if ( node.parent >= 0 )
+      {
+         m_nodes[node.parent].children.append(idx);
+      }
+      if ( (!reset) && (node.parent >= 0) )
+      {
+         endInsertRows();
+      }
+   }
+   if ( reset )
+   {
+      endResetModel();
+   }
+
+   for ( idx = 0; idx < m_nodes.count(); idx++ )
+   {
+      ProfiledNode& rNode = m_nodes[idx];
+
+      pNodeInfo = pProfiler->GetNode(idx);
+      rNode.calls = pNodeInfo->calls;
+      rNode.inclusive = pNodeInfo->inclusive;
+      rNode.exclusive = pNodeInfo->exclusive;
+   }
+
+   // Rows changed only under a common parent can be signalled together.
+   if ( !m_nodes.isEmpty() )
+   {
+      emit dataChanged(index(0,0),index(0,CodeProfilerTreeCol_MAX-1));
+   }
+   for ( idx = 0; idx < m_nodes.count(); idx++ )
+   {
+      const ProfiledNode& rNode = m_nodes.at(idx);
+
+      if ( !rNode.children.isEmpty() )
+      {
+         emit dataChanged(createIndex(0,0,(quintptr)rNode.children.first()),
+                          createIndex(rNode.children.count()-1,CodeProfilerTreeCol_MAX-1,(quintptr)rNode.children.last()));
+      }
+   }
+}
+
+void CDebuggerCodeProfilerTreeModel::exportCollapsedStacks(QTextStream& stream) const
+{
+   QStringList path;
+   int idx;
+   int node;
+
+   for ( idx = 0; idx < m_nodes.count(); idx++ )
+   {
+      if ( m_nodes.at(idx).exclusive )
+      {
+         path.clear();
+         for ( node = idx; node >= 0; node = m_nodes.at(node).parent )
+         {
+            path.prepend(routineName(m_nodes.at(node).routine));
+         }
+         stream << path.join(";") << " " << m_nodes.at(idx).exclusive << "\n";
+      }
+   }
+}
@@ -0,0 +1,78 @@
+#ifndef CDEBUGGERCODEPROFILERTREEMODEL_H
+#define CDEBUGGERCODEPROFILERTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QTextStream>
+#include <QVector>
+
+#include <stdint.h>
+
+#include "cdebuggercodeprofilermodel.h"
+
+enum
+{
+   CodeProfilerTreeCol_Routine = 0,
+   CodeProfilerTreeCol_Calls,
+   CodeProfilerTreeCol_Inclusive,
+   CodeProfilerTreeCol_Exclusive,
+   CodeProfilerTreeCol_Percent,
+   CodeProfilerTreeCol_MAX
+};
+
+// Sort role; the display role of the count columns is formatted.
+#define CodeProfilerTreeSortRole Qt::UserRole
+
+// One node of the emulator's call tree.  Nodes are only ever added to
+// the call tree until it is cleared, so rows are inserted as nodes appear
+// and the expanded state of the view survives updates.
+struct ProfiledNode
+{
+   uint32_t routine;
+   int parent;
+   int row;
+   QVector<int> children;
+   unsigned int calls;
+   quint64 inclusive;
+   quint64 exclusive;
+};
+
+class CDebuggerCodeProfilerTreeModel : public QAbstractItemModel
+{
+   Q_OBJECT
+public:
+   // Routine names are taken from the flat profile model, which looks
+   // them up in the debug information.
+   explicit CDebuggerCodeProfilerTreeModel(CDebuggerCodeProfilerModel* routines,QObject *parent = 0);
+   virtual ~CDebuggerCodeProfilerTreeModel();
+   Qt::ItemFlags flags(const QModelIndex& index) const;
+   QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+   QModelIndex parent(const QModelIndex& index) const;
+   QVariant data(const QModelIndex& index, int role) const;
+   QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+   int columnCount(const QModelIndex& parent = QModelIndex()) const;
+   int rowCount(const QModelIndex& parent = QModelIndex()) const;
+
+   const ProfiledItem* getItem(const QModelIndex& index) const;
+   void clear();
+
+   // Writes one line per call path that spent cycles in its last routine,
+   // in the collapsed-stack format read by flame graph tools.
+   void exportCollapsedStacks(QTextStream& stream) const;
+
+signals:
+
+public slots:
+   void update();
+
+private:
+   QString routineName(uint32_t routine) const;
+
+   CDebuggerCodeProfilerModel* m_routines;
+   QVector<ProfiledNode>       m_nodes;
+
+   // The profile the nodes were read from.
+   CProfiler*                  m_profiler;
+   uint32_t                    m_generation;
+};
+
+#endif // CDEBUGGERCODEPROFILERTREEMODEL_H
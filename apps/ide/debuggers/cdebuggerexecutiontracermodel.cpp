@@ -8,6 +8,7 @@ void GetPrintable ( TracerInfo* pSample, int subItem, char* str );
 CDebuggerExecutionTracerModel::CDebuggerExecutionTracerModel(QObject*)
 {
    m_pTracer = nesGetExecutionTracerDatabase();
+   m_pTracer->GetSnapshot(&m_snapshot);
    m_bShowCPU = true;
    m_bShowPPU = true;
    m_modelStringBuffer = new char[256];
@@ -30,7 +31,16 @@ QVariant CDebuggerExecutionTracerModel::data(const QModelIndex& index, int role)
       return QVariant();
    }
 
-   GetPrintable((TracerInfo*)index.internalPointer(), index.column(), m_modelStringBuffer);
+   TracerInfo sample;
+
+   // The emulator may have run on since the snapshot was taken and
+   // overwritten the sample, in which case there is nothing to show.
+   if ( !m_pTracer->ReadSample(m_snapshot,view(),index.row(),&sample) )
+   {
+      return QVariant();
+   }
+
+   GetPrintable(&sample, index.column(), m_modelStringBuffer);
 
    return QVariant(m_modelStringBuffer);
 }
@@ -106,20 +116,9 @@ QVariant CDebuggerExecutionTracerModel::headerData(int section, Qt::Orientation
 
 QModelIndex CDebuggerExecutionTracerModel::index(int row, int column, const QModelIndex&) const
 {
-   if ( (row >= 0) && (column >= 0) )
+   if ( (row >= 0) && (column >= 0) && (m_bShowCPU || m_bShowPPU) )
    {
-      if ( (m_bShowCPU) && (m_bShowPPU) )
-      {
-         return createIndex(row, column, m_pTracer->GetSample(row));
-      }
-      else if ( m_bShowCPU )
-      {
-         return createIndex(row, column, m_pTracer->GetCPUSample(row));
-      }
-      else if ( m_bShowPPU )
-      {
-         return createIndex(row, column, m_pTracer->GetPPUSample(row));
-      }
+      return createIndex(row, column);
    }
 
    return QModelIndex();
@@ -129,17 +128,9 @@ int CDebuggerExecutionTracerModel::rowCount(const QModelIndex&) const
 {
    int rows = 0;
 
-   if ( (m_bShowCPU) && (m_bShowPPU) )
+   if ( m_bShowCPU || m_bShowPPU )
    {
-      rows = m_pTracer->GetNumSamples();
-   }
-   else if ( m_bShowCPU )
-   {
-      rows = m_pTracer->GetNumCPUSamples();
-   }
-   else if ( m_bShowPPU )
-   {
-      rows = m_pTracer->GetNumPPUSamples();
+      rows = CTracer::GetNumSamples(m_snapshot,view());
    }
 
    return rows;
@@ -157,6 +148,7 @@ int CDebuggerExecutionTracerModel::columnCount(const QModelIndex& parent) const
 
 void CDebuggerExecutionTracerModel::update()
 {
+   m_pTracer->GetSnapshot(&m_snapshot);
    emit layoutChanged();
 }
 
@@ -170,6 +162,20 @@ void CDebuggerExecutionTracerModel::showPPU ( bool show )
    m_bShowPPU = show;
 }
 
+eTracerView CDebuggerExecutionTracerModel::view() const
+{
+   if ( m_bShowCPU && !m_bShowPPU )
+   {
+      return eTracerView_CPU;
+   }
+   else if ( m_bShowPPU && !m_bShowCPU )
+   {
+      return eTracerView_PPU;
+   }
+
+   return eTracerView_All;
+}
+
 void GetPrintable ( TracerInfo* pSample, int subItem, char* str )
 {
    if ( pSample )
@@ -25,7 +25,10 @@ public slots:
    void update();
 
 private:
+   eTracerView view() const;
+
    CTracer *m_pTracer;
+   TracerSnapshot m_snapshot;
    bool     m_bShowCPU;
    bool     m_bShowPPU;
    char    *m_modelStringBuffer;
@@ -9,6 +9,7 @@ CDebuggerMemoryDisplayModel::CDebuggerMemoryDisplayModel(memDBFunc memDB,QObject
 
    m_memDBFunc = memDB;
    m_memDB = memDB();
+   m_generation = 0;
 }
 
 CDebuggerMemoryDisplayModel::~CDebuggerMemoryDisplayModel()
@@ -61,6 +62,12 @@ QVariant CDebuggerMemoryDisplayModel::data(const QModelIndex& index, int role) c
 
       if (role == Qt::ForegroundRole)
       {
+         int cell = (index.row()*m_memDB->GetNumColumns())+index.column();
+         if ( (cell < m_cellChanged.size()) && m_cellChanged.testBit(cell) )
+         {
+            return QBrush(QColor(255, 0, 0));
+         }
+
          QColor col = QColor(m_memDB->GetCellRedComponent(m_memDB->Get((index.row()*m_memDB->GetNumColumns())+index.column())),
                              m_memDB->GetCellGreenComponent(m_memDB->Get((index.row()*m_memDB->GetNumColumns())+index.column())),
                              m_memDB->GetCellBlueComponent(m_memDB->Get((index.row()*m_memDB->GetNumColumns())+index.column())));
@@ -186,6 +193,93 @@ int CDebuggerMemoryDisplayModel::columnCount(const QModelIndex& /*parent*/) cons
 
 void CDebuggerMemoryDisplayModel::update()
 {
-   m_memDB = m_memDBFunc();
-   emit dataChanged(QModelIndex(),QModelIndex());
+   CMemoryDatabase* pMemDB = m_memDBFunc();
+   uint32_t generation;
+   uint32_t data;
+   int columns;
+   int firstRow;
+   int row;
+   int col;
+   int cell;
+   bool changed;
+   bool rowChanged;
+   bool highlighted;
+
+   // A different memory starts over.
+   if ( pMemDB != m_memDB )
+   {
+      beginResetModel();
+      m_memDB = pMemDB;
+      m_generation = 0;
+      m_cellChanged.clear();
+      endResetModel();
+   }
+   if ( !m_memDB )
+   {
+      return;
+   }
+   if ( !m_memDB->GetCellsTracked() )
+   {
+      emit dataChanged(QModelIndex(),QModelIndex());
+      return;
+   }
+
+   if ( m_generation == 0 )
+   {
+      m_lastValue.fill(0,m_memDB->GetSize());
+      m_cellChanged.fill(false,m_memDB->GetSize());
+      m_rowHighlighted.fill(false,m_memDB->GetNumRows());
+   }
+
+   // Writes made from here on are seen by the next update.
+   generation = m_memDB->AdvanceGeneration();
+
+   // Read back the rows that were written, and those still showing the
+   // last update's changes, and signal runs of rows that look different.
+   columns = m_memDB->GetNumColumns();
+   firstRow = -1;
+   for ( row = 0; row < m_memDB->GetNumRows(); row++ )
+   {
+      rowChanged = false;
+      if ( m_rowHighlighted.testBit(row) ||
+           m_memDB->ChangedSince(row*columns,columns,m_generation) )
+      {
+         highlighted = false;
+         for ( col = 0; col < columns; col++ )
+         {
+            cell = (row*columns)+col;
+            data = m_memDB->Get(cell);
+
+            // Nothing is highlighted on the first update.
+            changed = (m_generation != 0) && (data != m_lastValue.at(cell));
+            if ( (m_generation == 0) || changed || m_cellChanged.testBit(cell) )
+            {
+               rowChanged = true;
+            }
+            m_cellChanged.setBit(cell,changed);
+            highlighted |= changed;
+            m_lastValue[cell] = data;
+         }
+         m_rowHighlighted.setBit(row,highlighted);
+      }
+
+      if ( rowChanged )
+      {
+         if ( firstRow < 0 )
+         {
+            firstRow = row;
+         }
+      }
+      else if ( firstRow >= 0 )
+      {
+         emit dataChanged(index(firstRow,0),index(row-1,columns-1));
+         firstRow = -1;
+      }
+   }
+   if ( firstRow >= 0 )
+   {
+      emit dataChanged(index(firstRow,0),index(row-1,columns-1));
+   }
+
+   m_generation = generation;
 }
@@ -2,6 +2,8 @@
 #define CDEBUGGERMEMORYDISPLAYMODEL_H
 
 #include <QAbstractTableModel>
+#include <QBitArray>
+#include <QVector>
 
 #include "cmemorydata.h"
 
@@ -32,6 +34,14 @@ private:
    memDBFunc        m_memDBFunc;
    CMemoryDatabase *m_memDB;
    char            *m_modelStringBuffer;
+
+   // For memories whose writes are tracked, only the rows written since
+   // the last update are read back.  Cells whose value differs from that
+   // update are highlighted until the next one.
+   uint32_t          m_generation;
+   QVector<uint32_t> m_lastValue;
+   QBitArray         m_cellChanged;
+   QBitArray         m_rowHighlighted;
 };
 
 #endif // CDEBUGGERMEMORYDISPLAYMODEL_H
@@ -1,6 +1,10 @@
 #include "codeprofilerdockwidget.h"
 #include "ui_codeprofilerdockwidget.h"
 
+#include <QDir>
+#include <QFile>
+#include <QFileDialog>
+
 #include "nes_emulator_core.h"
 
 #include "ccodedatalogger.h"
@@ -17,7 +21,16 @@ CodeProfilerDockWidget::CodeProfilerDockWidget(QWidget *parent) :
    ui->tableView->setModel(model);
    ui->tableView->resizeColumnsToContents();
 
-   ui->tableView->sortByColumn(CodeProfilerCol_Calls,Qt::DescendingOrder);
+   ui->tableView->sortByColumn(CodeProfilerCol_Inclusive,Qt::DescendingOrder);
+
+   treeModel = new CDebuggerCodeProfilerTreeModel(model);
+   treeProxyModel = new QSortFilterProxyModel(this);
+   treeProxyModel->setSourceModel(treeModel);
+   treeProxyModel->setSortRole(CodeProfilerTreeSortRole);
+   treeProxyModel->setDynamicSortFilter(true);
+
+   ui->treeView->setModel(treeProxyModel);
+   ui->treeView->sortByColumn(CodeProfilerTreeCol_Inclusive,Qt::DescendingOrder);
 
 #if defined(Q_OS_MAC) || defined(Q_OS_MACX) || defined(Q_OS_MAC64)
    ui->tableView->setFont(QFont("Monaco", 11));
@@ -28,6 +41,7 @@ CodeProfilerDockWidget::CodeProfilerDockWidget(QWidget *parent) :
 #ifdef Q_OS_WIN
    ui->tableView->setFont(QFont("Consolas", 11));
 #endif
+   ui->treeView->setFont(ui->tableView->font());
 
    QObject::connect(ui->tableView->horizontalHeader(),SIGNAL(sortIndicatorChanged(int,Qt::SortOrder)),model,SLOT(sort(int,Qt::SortOrder)));
    QObject::connect(model,SIGNAL(layoutChanged()),this,SLOT(updateUi()));
@@ -36,6 +50,8 @@ CodeProfilerDockWidget::CodeProfilerDockWidget(QWidget *parent) :
 CodeProfilerDockWidget::~CodeProfilerDockWidget()
 {
     delete ui;
+    delete treeModel;
+    delete model;
 }
 
 void CodeProfilerDockWidget::updateTargetMachine(QString target)
@@ -45,10 +61,10 @@ void CodeProfilerDockWidget::updateTargetMachine(QString target)
       QObject* breakpointWatcher = CObjectRegistry::instance()->getObject("Breakpoint Watcher");
       QObject* emulator = CObjectRegistry::instance()->getObject("Emulator");
 
-      QObject::connect(breakpointWatcher,SIGNAL(breakpointHit()),model,SLOT(update()));
+      QObject::connect(breakpointWatcher,SIGNAL(breakpointHit()),this,SLOT(updateProfile()));
       QObject::connect(emulator,SIGNAL(machineReady()),this,SLOT(on_clear_clicked()));
-      QObject::connect(emulator,SIGNAL(emulatorReset()),model,SLOT(update()));
-      QObject::connect(emulator,SIGNAL(emulatorPaused(bool)),model,SLOT(update()));
+      QObject::connect(emulator,SIGNAL(emulatorReset()),this,SLOT(updateProfile()));
+      QObject::connect(emulator,SIGNAL(emulatorPaused(bool)),this,SLOT(updateProfile()));
    }
 }
 
@@ -58,9 +74,9 @@ void CodeProfilerDockWidget::showEvent(QShowEvent */*event*/)
 
    if ( emulator )
    {
-      QObject::connect(emulator,SIGNAL(updateDebuggers()),model,SLOT(update()));
+      QObject::connect(emulator,SIGNAL(updateDebuggers()),this,SLOT(updateProfile()));
    }
-   model->update();
+   updateProfile();
 }
 
 void CodeProfilerDockWidget::hideEvent(QHideEvent */*event*/)
@@ -69,10 +85,18 @@ void CodeProfilerDockWidget::hideEvent(QHideEvent */*event*/)
 
    if ( emulator )
    {
-      QObject::disconnect(emulator,SIGNAL(updateDebuggers()),model,SLOT(update()));
+      QObject::disconnect(emulator,SIGNAL(updateDebuggers()),this,SLOT(updateProfile()));
    }
 }
 
+void CodeProfilerDockWidget::updateProfile()
+{
+   // The call tree names its nodes from the routines, so the routines
+   // must be brought up to date first.
+   model->update();
+   treeModel->update();
+}
+
 void CodeProfilerDockWidget::updateUi()
 {
    ui->symbolsProfiled->setText(QString::number(model->getItems().count()));
@@ -80,17 +104,58 @@ void CodeProfilerDockWidget::updateUi()
 
 void CodeProfilerDockWidget::on_tableView_doubleClicked(QModelIndex index)
 {
-   QString symbol = model->getItems().at(index.row()).symbol;
-   QString file = model->getItems().at(index.row()).file;
+   QString address = model->getItems().at(index.row()).address;
 
-   emit snapTo("SourceNavigatorFile,"+file);
-   emit snapTo("SourceNavigatorSymbol,"+symbol);
+   if ( !address.isEmpty() )
+   {
+      emit snapTo("Address,"+address);
+   }
+}
+
+void CodeProfilerDockWidget::on_treeView_doubleClicked(QModelIndex index)
+{
+   const ProfiledItem* pItem = treeModel->getItem(treeProxyModel->mapToSource(index));
+
+   if ( pItem && (!pItem->address.isEmpty()) )
+   {
+      emit snapTo("Address,"+pItem->address);
+   }
 }
 
 void CodeProfilerDockWidget::on_clear_clicked()
 {
    nesClearCodeDataLoggerDatabases();
+   nesClearProfiler();
+
+   // This is also how a new machine is picked up, so make sure its
+   // profiler matches the setting.
+   nesEnableProfiler(ui->profile->isChecked());
 
+   treeModel->clear();
    model->clear();
-   model->update();
+   updateProfile();
+}
+
+void CodeProfilerDockWidget::on_profile_toggled(bool checked)
+{
+   nesEnableProfiler(checked);
+}
+
+void CodeProfilerDockWidget::on_exportFlameGraph_clicked()
+{
+   QString fileName = QFileDialog::getSaveFileName(this,"Export Flame Graph",QDir::currentPath(),"Collapsed Stacks (*.folded)");
+
+   if ( !fileName.isEmpty() )
+   {
+      QFile file(fileName);
+
+      updateProfile();
+      if ( file.open(QIODevice::WriteOnly|QIODevice::Text|QIODevice::Truncate) )
+      {
+         QTextStream stream(&file);
+
+         treeModel->exportCollapsedStacks(stream);
+         file.close();
+      }
+   }
 }
@@ -3,7 +3,10 @@
 
 #include "cdebuggerbase.h"
 
+#include <QSortFilterProxyModel>
+
 #include "cdebuggercodeprofilermodel.h"
+#include "cdebuggercodeprofilertreemodel.h"
 #include "ixmlserializable.h"
 
 namespace Ui {
@@ -25,12 +28,18 @@ protected:
 private:
    Ui::CodeProfilerDockWidget *ui;
    CDebuggerCodeProfilerModel *model;
+   CDebuggerCodeProfilerTreeModel *treeModel;
+   QSortFilterProxyModel *treeProxyModel;
 
 signals:
 
 private slots:
    void on_clear_clicked();
+   void on_profile_toggled(bool checked);
+   void on_exportFlameGraph_clicked();
    void on_tableView_doubleClicked(QModelIndex index);
+   void on_treeView_doubleClicked(QModelIndex index);
+   void updateProfile();
    void updateUi();
    void updateTargetMachine(QString target);
 };
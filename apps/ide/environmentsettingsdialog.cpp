@@ -9,6 +9,7 @@
 #include "codeeditorform.h"
 
 #include <QSettings>
+#include <QThread>
 
 // Settings data structures.
 //QModelIndex EnvironmentSettingsDialog::m_lastActiveTab;
@@ -16,6 +17,8 @@ bool EnvironmentSettingsDialog::m_useInternalGameDatabase;
 QString EnvironmentSettingsDialog::m_gameDatabase;
 bool EnvironmentSettingsDialog::m_showWelcomeOnStart;
 bool EnvironmentSettingsDialog::m_saveAllOnCompile;
+int EnvironmentSettingsDialog::m_buildJobs;
+bool EnvironmentSettingsDialog::m_useObjectCache;
 bool EnvironmentSettingsDialog::m_rememberWindowSettings;
 bool EnvironmentSettingsDialog::m_trackRecentProjects;
 QString EnvironmentSettingsDialog::m_romPath;
@@ -115,6 +118,8 @@ EnvironmentSettingsDialog::EnvironmentSettingsDialog(QWidget* parent) :
 
    ui->showWelcomeOnStart->setChecked(m_showWelcomeOnStart);
    ui->saveAllOnCompile->setChecked(m_saveAllOnCompile);
+   ui->buildJobs->setValue(m_buildJobs);
+   ui->useObjectCache->setChecked(m_useObjectCache);
    ui->rememberWindowSettings->setChecked(m_rememberWindowSettings);
    ui->trackRecentProjects->setChecked(m_trackRecentProjects);
 
@@ -215,6 +220,12 @@ void EnvironmentSettingsDialog::readSettings()
    m_gameDatabase = settings.value("GameDatabase").toString();
    m_showWelcomeOnStart = settings.value("showWelcomeOnStart",QVariant(true)).toBool();
    m_saveAllOnCompile = settings.value("saveAllOnCompile",QVariant(true)).toBool();
+   m_buildJobs = settings.value("buildJobs",QVariant(QThread::idealThreadCount())).toInt();
+   if ( m_buildJobs < 1 )
+   {
+      m_buildJobs = 1;
+   }
+   m_useObjectCache = settings.value("useObjectCache",QVariant(false)).toBool();
    m_rememberWindowSettings = settings.value("rememberWindowSettings",QVariant(true)).toBool();
    m_trackRecentProjects = settings.value("trackRecentProjects",QVariant(true)).toBool();
    m_romPath = settings.value("romPath").toString();
@@ -297,6 +308,8 @@ void EnvironmentSettingsDialog::writeSettings()
    m_gameDatabase = ui->GameDatabasePathEdit->text();
    m_showWelcomeOnStart = ui->showWelcomeOnStart->isChecked();
    m_saveAllOnCompile = ui->saveAllOnCompile->isChecked();
+   m_buildJobs = ui->buildJobs->value();
+   m_useObjectCache = ui->useObjectCache->isChecked();
    m_rememberWindowSettings = ui->rememberWindowSettings->isChecked();
    m_trackRecentProjects = ui->trackRecentProjects->isChecked();
    m_romPath = ui->ROMPath->text();
@@ -341,6 +354,8 @@ void EnvironmentSettingsDialog::writeSettings()
    settings.beginGroup("Environment");
    settings.setValue("showWelcomeOnStart",m_showWelcomeOnStart);
    settings.setValue("saveAllOnCompile",m_saveAllOnCompile);
+   settings.setValue("buildJobs",m_buildJobs);
+   settings.setValue("useObjectCache",m_useObjectCache);
    settings.setValue("rememberWindowSettings",m_rememberWindowSettings);
    settings.setValue("trackRecentProjects",m_trackRecentProjects);
 
@@ -30,6 +30,8 @@ public:
    static QString getGameDatabase() { return m_gameDatabase; }
    static bool showWelcomeOnStart() { return m_showWelcomeOnStart; }
    static bool saveAllOnCompile() { return m_saveAllOnCompile; }
+   static int buildJobs() { return m_buildJobs; }
+   static bool useObjectCache() { return m_useObjectCache; }
    static bool rememberWindowSettings() { return m_rememberWindowSettings; }
    static bool trackRecentProjects() { return m_trackRecentProjects; }
    static QString romPath() { return m_romPath; }
@@ -88,6 +90,8 @@ private:
    static QString m_gameDatabase;
    static bool m_showWelcomeOnStart;
    static bool m_saveAllOnCompile;
+   static int m_buildJobs;
+   static bool m_useObjectCache;
    static bool m_rememberWindowSettings;
    static bool m_trackRecentProjects;
    static QString m_romPath;
@@ -1,114 +1,321 @@
 #include "cgamedatabasehandler.h"
 
-#include <QResource>
-#include <QFile>
+#include <QCoreApplication>
 #include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QXmlStreamReader>
 
 #include "nes_emulator_core.h"
 
+// Index file header; the version changes whenever what is kept does.
+#define GAME_DB_INDEX_MAGIC   0x4E474442
+#define GAME_DB_INDEX_VERSION 1
+
 CGameDatabaseHandler *CGameDatabaseHandler::_instance = NULL;
 
 CGameDatabaseHandler::CGameDatabaseHandler()
+   : m_partialMatch(false)
 {
 }
 
 bool CGameDatabaseHandler::initialize(QString fileName)
 {
-   QFile file(fileName);
-   QFile res(":/GameDatabase");
-   bool openedFile = false;
+   QFile     file(fileName);
+   QString   source = fileName;
+   QFileInfo stamp;
+   qint64    size;
+   qint64    modified;
+   bool      openedFile = false;
 
    // First attempt to open the user-specified game database...
-   file.open(QIODevice::ReadOnly);
-
-   if ( file.isOpen() )
+   if ( file.open(QIODevice::ReadOnly) )
    {
-      m_db.clear();
-      m_db.setContent(&file);
-      file.close();
       openedFile = true;
    }
    else
    {
       // Couldn't open the user-specified game database, resort
       // to using the internal resource...
-      res.open(QIODevice::ReadOnly);
+      source = ":/GameDatabase";
+      file.setFileName(source);
+      file.open(QIODevice::ReadOnly);
+   }
 
-      m_db.clear();
-      m_db.setContent(&res);
-      res.close();
+   // The internal resource only changes with the executable it is in.
+   if ( source.startsWith(':') )
+   {
+      stamp.setFile(QCoreApplication::applicationFilePath());
+   }
+   else
+   {
+      stamp.setFile(source);
+   }
+   size = file.size();
+   modified = stamp.lastModified().toMSecsSinceEpoch();
+
+   m_entry = GameDatabaseEntry();
+   m_partialMatch = false;
+
+   if ( (!readIndex(indexFile(source,false),size,modified)) &&
+        (!readIndex(indexFile(source,true),size,modified)) )
+   {
+      parse(&file);
+      writeIndex(indexFile(source,source.startsWith(':')),size,modified);
    }
+   file.close();
+
+   buildLookups();
+
    return openedFile;
 }
 
-QString CGameDatabaseHandler::getGameDBTimestamp()
+QString CGameDatabaseHandler::indexFile(QString fileName,bool cached)
 {
-   QDomElement        docElem = m_db.documentElement();
-   return docElem.attribute("timestamp");
+   QFileInfo fileInfo(fileName);
+   QDir      cacheDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+
+   if ( cached )
+   {
+      return cacheDir.filePath(fileInfo.completeBaseName()+".idx");
+   }
+   if ( fileName.startsWith(':') )
+   {
+      return QString();
+   }
+   return fileInfo.absolutePath()+"/"+fileInfo.completeBaseName()+".idx";
 }
 
-QString CGameDatabaseHandler::getGameDBAuthor()
+bool CGameDatabaseHandler::readIndex(QString indexFileName,qint64 size,qint64 modified)
 {
-   QDomElement        docElem = m_db.documentElement();
-   return docElem.attribute("author");
+   QFile       file(indexFileName);
+   QDataStream ds(&file);
+   quint32     magic;
+   quint32     version;
+   qint64      indexSize;
+   qint64      indexModified;
+   quint32     count;
+   quint32     idx;
+   qint32      mapper;
+
+   if ( indexFileName.isEmpty() || (!file.open(QIODevice::ReadOnly)) )
+   {
+      return false;
+   }
+   ds.setVersion(QDataStream::Qt_5_0);
+
+   ds >> magic >> version >> indexSize >> indexModified;
+   if ( (ds.status() != QDataStream::Ok) ||
+        (magic != GAME_DB_INDEX_MAGIC) ||
+        (version != GAME_DB_INDEX_VERSION) ||
+        (indexSize != size) ||
+        (indexModified != modified) )
+   {
+      return false;
+   }
+
+   // Every entry takes at least 40 bytes.
+   ds >> m_author >> m_timestamp >> count;
+   if ( (ds.status() != QDataStream::Ok) || (count > (file.size()/40)) )
+   {
+      return false;
+   }
+   m_entries.resize(count);
+   for ( idx = 0; (idx < count) && (ds.status() == QDataStream::Ok); idx++ )
+   {
+      GameDatabaseEntry& entry = m_entries[idx];
+
+      ds >> entry.sha1 >> entry.prgSha1 >> entry.crc >> mapper;
+      ds >> entry.name >> entry.publisher >> entry.date;
+      ds >> entry.region >> entry.system >> entry.board;
+      entry.mapper = mapper;
+   }
+   file.close();
+
+   if ( ds.status() != QDataStream::Ok )
+   {
+      m_entries.clear();
+      return false;
+   }
+   return true;
 }
 
-bool CGameDatabaseHandler::find(CCartridge* pCartridge)
+void CGameDatabaseHandler::writeIndex(QString indexFileName,qint64 size,qint64 modified)
 {
-   QDomElement        docElem = m_db.documentElement();
-   QCryptographicHash sha1alg(QCryptographicHash::Sha1);
-   QByteArray         sha1key;
-   int                i;
+   // The index goes next to the XML unless it cannot be written there,
+   // in which case it goes in the cache.
+   if ( !writeIndexFile(indexFileName,size,modified) )
+   {
+      QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+      writeIndexFile(indexFile(indexFileName,true),size,modified);
+   }
+}
 
-   // Reset the crypto...
-   sha1alg.reset();
+bool CGameDatabaseHandler::writeIndexFile(QString indexFileName,qint64 size,qint64 modified)
+{
+   QSaveFile   file(indexFileName);
+   QDataStream ds(&file);
 
-   // Clear the found elements...
-   m_game.clear();
-   m_cartridge.clear();
+   if ( indexFileName.isEmpty() || (!file.open(QIODevice::WriteOnly)) )
+   {
+      return false;
+   }
+   ds.setVersion(QDataStream::Qt_5_0);
 
-   // Pump ROM data into crypto to get SHA1...
-   for ( i = 0; i < pCartridge->getPrgRomBanks()->getPrgRomBanks().count(); i++ )
+   ds << (quint32)GAME_DB_INDEX_MAGIC << (quint32)GAME_DB_INDEX_VERSION << size << modified;
+   ds << m_author << m_timestamp << (quint32)m_entries.count();
+   foreach ( const GameDatabaseEntry& entry, m_entries )
    {
-      sha1alg.addData((char*)pCartridge->getPrgRomBanks()->getPrgRomBanks().at(i)->getBankData(),MEM_8KB);
+      ds << entry.sha1 << entry.prgSha1 << entry.crc << (qint32)entry.mapper;
+      ds << entry.name << entry.publisher << entry.date;
+      ds << entry.region << entry.system << entry.board;
    }
 
-   for ( i = 0; i < pCartridge->getChrRomBanks()->getChrRomBanks().count(); i++ )
+   // Nothing replaces the old index unless the new one is complete.
+   if ( ds.status() != QDataStream::Ok )
    {
-      sha1alg.addData((char*)pCartridge->getChrRomBanks()->getChrRomBanks().at(i)->getBankData(),MEM_8KB);
+      file.cancelWriting();
+      return false;
    }
+   return file.commit();
+}
 
-   // Get the resulting hash value from the crypto...
-   sha1key = sha1alg.result();
+void CGameDatabaseHandler::parse(QIODevice* pDevice)
+{
+   QXmlStreamReader  xml(pDevice);
+   GameDatabaseEntry game;
+   GameDatabaseEntry cartridge;
+   int               prgChips = 0;
 
-   // Search the loaded game database for the corresponding hash value...
-   QDomNode gameNode = docElem.firstChild();
+   m_author.clear();
+   m_timestamp.clear();
+   m_entries.clear();
 
-   while (!gameNode.isNull())
+   // Only what the entries keep is looked at; nothing else is built.
+   while ( !xml.atEnd() )
    {
-      QDomElement gameElem = gameNode.toElement(); // try to convert the node to an element.
+      xml.readNext();
 
-      if (!gameElem.isNull())
+      if ( xml.isStartElement() )
       {
-         QDomNode cartridgeNode = gameElem.firstChild();
+         QXmlStreamAttributes attrs = xml.attributes();
 
-         while (!cartridgeNode.isNull())
+         if ( xml.name() == QLatin1String("database") )
+         {
+            m_author = attrs.value("author").toString();
+            m_timestamp = attrs.value("timestamp").toString();
+         }
+         else if ( xml.name() == QLatin1String("game") )
+         {
+            game = GameDatabaseEntry();
+            game.name = attrs.value("name").toString();
+            game.publisher = attrs.value("publisher").toString();
+            game.date = attrs.value("date").toString();
+            game.region = attrs.value("region").toString();
+         }
+         else if ( xml.name() == QLatin1String("cartridge") )
+         {
+            cartridge = game;
+            cartridge.sha1 = QByteArray::fromHex(attrs.value("sha1").toString().toLatin1());
+            cartridge.crc = attrs.value("crc").toString().toUInt(NULL,16);
+            cartridge.mapper = -1;
+            cartridge.system = attrs.value("system").toString();
+            prgChips = 0;
+         }
+         else if ( xml.name() == QLatin1String("board") )
+         {
+            cartridge.board = attrs.value("type").toString();
+            cartridge.mapper = attrs.value("mapper").toString().toInt();
+         }
+         else if ( xml.name() == QLatin1String("prg") )
+         {
+            cartridge.prgSha1 = QByteArray::fromHex(attrs.value("sha1").toString().toLatin1());
+            prgChips++;
+         }
+      }
+      else if ( xml.isEndElement() && (xml.name() == QLatin1String("cartridge")) )
+      {
+         // A PRG hash only says what the whole PRG is for a single chip.
+         if ( prgChips != 1 )
          {
-            QDomElement cartridgeElem = cartridgeNode.toElement(); // try to convert the node to an element.
+            cartridge.prgSha1.clear();
+         }
+         if ( !cartridge.sha1.isEmpty() )
+         {
+            m_entries.append(cartridge);
+         }
+      }
+   }
+}
 
-            if ( sha1key.toHex().toUpper() == cartridgeElem.attribute("sha1").toUpper() )
-            {
-               // Save found game for later reference...
-               m_game = gameNode.cloneNode();
-               m_cartridge = cartridgeNode.cloneNode();
-               return true;
-            }
+void CGameDatabaseHandler::buildLookups()
+{
+   int idx;
 
-            cartridgeNode = cartridgeNode.nextSibling();
-         }
+   m_sha1Lookup.clear();
+   m_prgSha1Lookup.clear();
+   m_sha1Lookup.reserve(m_entries.count());
+   m_prgSha1Lookup.reserve(m_entries.count());
+
+   // The first cartridge with a hash is the one found, as it was when
+   // the XML was searched from the top.
+   for ( idx = 0; idx < m_entries.count(); idx++ )
+   {
+      if ( !m_sha1Lookup.contains(m_entries.at(idx).sha1) )
+      {
+         m_sha1Lookup.insert(m_entries.at(idx).sha1,idx);
+      }
+      if ( (!m_entries.at(idx).prgSha1.isEmpty()) &&
+           (!m_prgSha1Lookup.contains(m_entries.at(idx).prgSha1)) )
+      {
+         m_prgSha1Lookup.insert(m_entries.at(idx).prgSha1,idx);
       }
+   }
+}
 
-      gameNode = gameNode.nextSibling();
+bool CGameDatabaseHandler::find(CCartridge* pCartridge)
+{
+   QCryptographicHash sha1alg(QCryptographicHash::Sha1);
+   QCryptographicHash prgSha1alg(QCryptographicHash::Sha1);
+   QHash<QByteArray,int>::const_iterator iter;
+   int                i;
+
+   // Clear the found elements...
+   m_entry = GameDatabaseEntry();
+   m_partialMatch = false;
+
+   // Pump ROM data into crypto to get SHA1...
+   for ( i = 0; i < pCartridge->getPrgRomBanks()->getPrgRomBanks().count(); i++ )
+   {
+      sha1alg.addData((char*)pCartridge->getPrgRomBanks()->getPrgRomBanks().at(i)->getBankData(),MEM_8KB);
+      prgSha1alg.addData((char*)pCartridge->getPrgRomBanks()->getPrgRomBanks().at(i)->getBankData(),MEM_8KB);
+   }
+
+   for ( i = 0; i < pCartridge->getChrRomBanks()->getChrRomBanks().count(); i++ )
+   {
+      sha1alg.addData((char*)pCartridge->getChrRomBanks()->getChrRomBanks().at(i)->getBankData(),MEM_8KB);
+   }
+
+   // Search the game database for the whole cartridge...
+   iter = m_sha1Lookup.constFind(sha1alg.result());
+   if ( iter != m_sha1Lookup.constEnd() )
+   {
+      m_entry = m_entries.at(iter.value());
+      return true;
+   }
+
+   // ...then for its PRG alone.
+   iter = m_prgSha1Lookup.constFind(prgSha1alg.result());
+   if ( iter != m_prgSha1Lookup.constEnd() )
+   {
+      m_entry = m_entries.at(iter.value());
+      m_partialMatch = true;
+      return true;
    }
 
    return false;
@@ -116,8 +323,7 @@ bool CGameDatabaseHandler::find(CCartridge* pCartridge)
 
 int CGameDatabaseHandler::getRegion()
 {
-   QDomElement cartridgeElem = m_cartridge.toElement();
-   QString str = cartridgeElem.attribute("system");
+   QString str = m_entry.system;
 
    if ( str.contains("USA") )
    {
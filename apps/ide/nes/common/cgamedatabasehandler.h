@@ -1,14 +1,28 @@
 #ifndef CGAMEDATABASEHANDLER_H
 #define CGAMEDATABASEHANDLER_H
 
-#include <QDomDocument>
-#include <QDomElement>
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
 #include <QString>
+#include <QVector>
 
 #include "ccartridge.h"
 
-#define GAME_DATA(attr)  QDomElement gameElem = m_game.toElement(); return gameElem.attribute(attr)
-#define CART_DATA(attr)  QDomElement cartridgeElem = m_cartridge.toElement(); return cartridgeElem.attribute(attr)
+// What is kept of each cartridge in the game database.
+struct GameDatabaseEntry
+{
+   QByteArray sha1;     // Raw SHA1 of PRG then CHR.
+   QByteArray prgSha1;  // Raw SHA1 of PRG only; empty for several PRG chips.
+   quint32    crc;
+   int        mapper;
+   QString    name;
+   QString    publisher;
+   QString    date;
+   QString    region;
+   QString    system;
+   QString    board;
+};
 
 class CGameDatabaseHandler
 {
@@ -24,44 +38,81 @@ public:
    bool initialize(QString fileName);
 
    // Database information.
-   QString getGameDBTimestamp();
-   QString getGameDBAuthor();
+   QString getGameDBTimestamp()
+   {
+      return m_timestamp;
+   }
+   QString getGameDBAuthor()
+   {
+      return m_author;
+   }
 
-   // Database searching.
+   // Database searching.  A cartridge whose PRG is in the database but
+   // whose CHR is not is found too, as a partial match.
    bool find(CCartridge* pCartridge);
+   bool isPartialMatch()
+   {
+      return m_partialMatch;
+   }
 
    // Game values.
    QString getName()
    {
-      GAME_DATA("name");
+      return m_entry.name;
    }
    QString getPublisher()
    {
-      GAME_DATA("publisher");
+      return m_entry.publisher;
    }
    QString getDate()
    {
-      GAME_DATA("date");
+      return m_entry.date;
    }
    int getRegion();
 
    // Cartridge values.
    QString getSystem()
    {
-      CART_DATA("system");
+      return m_entry.system;
    }
    QString getSHA1()
    {
-      CART_DATA("sha1").toUpper();
+      return QString(m_entry.sha1.toHex().toUpper());
+   }
+   QString getCRC()
+   {
+      return QString::number(m_entry.crc,16).toUpper().rightJustified(8,'0');
+   }
+   QString getBoard()
+   {
+      return m_entry.board;
+   }
+   int getMapper()
+   {
+      return m_entry.mapper;
    }
 private:
    static CGameDatabaseHandler *_instance;
    CGameDatabaseHandler();
 
 protected:
-   QDomDocument m_db;
-   QDomNode     m_game;
-   QDomNode     m_cartridge;
+   // The XML is only parsed when the binary index kept from it last time
+   // is missing or older than it.
+   QString indexFile(QString fileName,bool cached);
+   bool readIndex(QString indexFileName,qint64 size,qint64 modified);
+   void writeIndex(QString indexFileName,qint64 size,qint64 modified);
+   bool writeIndexFile(QString indexFileName,qint64 size,qint64 modified);
+   void parse(QIODevice* pDevice);
+   void buildLookups();
+
+   QString m_author;
+   QString m_timestamp;
+   QVector<GameDatabaseEntry> m_entries;
+   QHash<QByteArray,int> m_sha1Lookup;
+   QHash<QByteArray,int> m_prgSha1Lookup;
+
+   GameDatabaseEntry m_entry;
+   bool              m_partialMatch;
 };
 
 #endif // CGAMEDATABASEHANDLER_H
@@ -1,10 +1,11 @@
 #include "tilificationthread.h"
 
-#include "nes_emulator_core.h"
+#include <QHash>
 
 TilificationThread::TilificationThread(QObject *parent) :
    QThread(parent)
 {
+   m_mode = Tilify_None;
 }
 
 void TilificationThread::prepareToTilify()
@@ -23,109 +24,181 @@ void TilificationThread::tilify()
    start();
 }
 
-void TilificationThread::run()
+static void flipTile(const char* tile,char* flipped,quint32 flip)
+{
+   unsigned char data;
+   unsigned char mirrored;
+   int row;
+   int plane;
+   int bit;
+
+   for ( plane = 0; plane < TILE_BYTES; plane += PATTERN_SIZE )
+   {
+      for ( row = 0; row < PATTERN_SIZE; row++ )
+      {
+         data = tile[plane+((flip&TILE_REMAP_FLIP_VERT)?(PATTERN_SIZE-1-row):row)];
+         if ( flip&TILE_REMAP_FLIP_HORIZ )
+         {
+            mirrored = 0;
+            for ( bit = 0; bit < 8; bit++ )
+            {
+               mirrored |= ((data>>bit)&1)<<(7-bit);
+            }
+            data = mirrored;
+         }
+         flipped[plane+row] = data;
+      }
+   }
+}
+
+QByteArray TilificationThread::tilifyItems(QList<IChrRomBankItem*> items,int mode,QVector<quint32>* remap)
 {
    QByteArray tileDataIn;
    QByteArray tileDataLockMap;
-   int idx1;
-   int idx2;
+   QByteArray itemData;
+   QByteArray tile;
+   QByteArray output;
+   QVector<bool> locked;
+   QHash<QByteArray,int> tiles;
+   QHash<QByteArray,int>::const_iterator found;
+   char flipped[TILE_BYTES];
+   quint32 entry;
+   quint32 flip;
    bool newTile;
-   unsigned int* pSrc;
-   unsigned int* pDst;
-   const char* tileSrc;
-   const char* tileDst;
-
-#if 1
-// disable tilification for now until I sort out how to incorporate it best.
-   for ( idx1 = 0; idx1 < m_input.count(); idx1++ )
+   int numTiles;
+   int table;
+   int tableEnd;
+   int free;
+   int idx;
+
+   // Lock every byte of data that isn't from a tile stamp in place.  So is
+   // a tile stamp that doesn't start on a tile boundary, as its tiles
+   // aren't whole.
+   for ( idx = 0; idx < items.count(); idx++ )
    {
-      m_output.append(m_input.at(idx1)->getChrRomBankItemData());
+      itemData = items.at(idx)->getChrRomBankItemData();
+      tileDataLockMap.append(QByteArray(itemData.count(),((items.at(idx)->getItemType() == "Tile") && (!(tileDataIn.count()%TILE_BYTES)))?'0':'1'));
+      tileDataIn.append(itemData);
    }
-#else
-   for ( idx1 = 0; idx1 < m_input.count(); idx1++ )
+   numTiles = tileDataIn.count()/TILE_BYTES;
+
+   if ( remap )
    {
-      tileDataIn.append(m_input.at(idx1)->getChrRomBankItemData());
-      if ( m_input.at(idx1)->getItemType() == "Tile" )
-      {
-         for ( idx2 = 0; idx2 < m_input.at(idx1)->getChrRomBankItemData().count()>>4; idx2++ )
-         {
-            tileDataLockMap.append('0');
-         }
-      }
-      else
-      {
-         for ( idx2 = 0; idx2 < m_input.at(idx1)->getChrRomBankItemData().count()>>4; idx2++ )
-         {
-            tileDataLockMap.append('1');
-         }
-      }
+      remap->clear();
    }
 
-   for ( idx1 = 0; idx1 < tileDataIn.count(); idx1 += 16)
+   // Locked data is output where it was.
+   output = tileDataIn;
+   locked.resize(numTiles);
+   for ( idx = 0; idx < numTiles; idx++ )
    {
-      // Go through the tile data and 'compress' it by
-      // keeping only unique tiles.
-      // Pointer for tile data.
-      tileSrc = tileDataIn.constData();
+      locked[idx] = tileDataLockMap.mid(idx*TILE_BYTES,TILE_BYTES).contains('1');
+   }
 
-      // First tile always gets put in.
-      if ( (tileDataLockMap.at(idx1>>4) == '1') || idx1 == 0 )
-      {
-         m_output.append(tileSrc,16);
-      }
-      else
+   // Each tile is looked up by its contents, so the bank is merged in one
+   // pass however many tiles it has.  The tiles that are kept fill the
+   // unlocked places of their pattern table in order, so none of them
+   // moves later in the bank.  Places left over are cleared.
+   free = 0;
+   for ( table = 0; table < numTiles; table += TILES_PER_PATTERN_TABLE )
+   {
+      tableEnd = qMin(table+TILES_PER_PATTERN_TABLE,numTiles);
+
+      // Tiles of tile stamps can be merged into locked tiles too.
+      tiles.clear();
+      for ( idx = table; (idx < tableEnd) && (mode != Tilify_None); idx++ )
       {
-         // Go through tiles in the output list already.
-         newTile = true;
-         for ( idx2 = 0; idx2 < m_output.count(); idx2 += 16)
+         if ( locked[idx] )
          {
-            // Pointer for tile data.
-            tileDst = m_output.constData();
-            pSrc = (unsigned int*)(tileSrc+idx1);
-            pDst = (unsigned int*)(tileDst+idx2);
-
-            // If the tiles match, add this tile.
-            if ( (*pSrc == *pDst) &&
-                 (*(pSrc+2) == *(pDst+2)) &&
-                 (*(pSrc+1) == *(pDst+1)) &&
-                 (*(pSrc+3) == *(pDst+3)) )
+            tile = tileDataIn.mid(idx*TILE_BYTES,TILE_BYTES);
+            if ( !tiles.contains(tile) )
             {
-               // Tile already copied.
-               newTile = false;
-               break;
+               tiles.insert(tile,idx);
             }
          }
+      }
+
+      free = table;
+      for ( idx = table; idx < tableEnd; idx++ )
+      {
+         entry = idx;
 
-         // Copy tile if needed.
-         if ( newTile )
+         if ( !locked[idx] )
          {
-            m_output.append(tileSrc+idx1,16);
+            tile = tileDataIn.mid(idx*TILE_BYTES,TILE_BYTES);
+            newTile = true;
+
+            if ( mode != Tilify_None )
+            {
+               found = tiles.constFind(tile);
+               if ( found != tiles.constEnd() )
+               {
+                  newTile = false;
+                  entry = found.value();
+               }
+               else if ( mode == Tilify_DuplicatesAndFlips )
+               {
+                  for ( flip = TILE_REMAP_FLIP_HORIZ; flip <= (TILE_REMAP_FLIP_HORIZ|TILE_REMAP_FLIP_VERT); flip += TILE_REMAP_FLIP_HORIZ )
+                  {
+                     flipTile(tile.constData(),flipped,flip);
+                     found = tiles.constFind(QByteArray::fromRawData(flipped,TILE_BYTES));
+                     if ( found != tiles.constEnd() )
+                     {
+                        newTile = false;
+                        entry = found.value()|flip;
+                        break;
+                     }
+                  }
+               }
+            }
 
-            // Go through original tile data and remove the tile we just found.
-            for ( idx2 = idx1+16; idx2 < tileDataIn.count(); )
+            if ( newTile )
             {
-               // Pointer for tile data.
-               tileDst = tileDataIn.constData();
-               pSrc = (unsigned int*)(tileSrc+idx1);
-               pDst = (unsigned int*)(tileDst+idx2);
-
-               // If the tiles match, remove this tile.
-               if ( (*pSrc == *pDst) &&
-                    (*(pSrc+2) == *(pDst+2)) &&
-                    (*(pSrc+1) == *(pDst+1)) &&
-                    (*(pSrc+3) == *(pDst+3)) )
+               while ( locked[free] )
                {
-                  tileDataIn.remove(idx2,16);
+                  free++;
                }
-               else
+               entry = free;
+               free++;
+               if ( mode != Tilify_None )
                {
-                  idx2 += 16;
+                  tiles.insert(tile,entry);
                }
+               output.replace(entry*TILE_BYTES,TILE_BYTES,tile);
             }
          }
+
+         if ( remap )
+         {
+            remap->append(entry);
+         }
+      }
+
+      for ( idx = free; idx < tableEnd; idx++ )
+      {
+         if ( !locked[idx] )
+         {
+            output.replace(idx*TILE_BYTES,TILE_BYTES,QByteArray(TILE_BYTES,0));
+         }
+      }
+   }
+
+   // Places left over at the end of the bank are dropped.  A partial tile
+   // at the end is kept where it is.
+   if ( !(tileDataIn.count()%TILE_BYTES) )
+   {
+      for ( idx = numTiles; (idx > free) && (!locked[idx-1]); idx-- )
+      {
       }
+      output.truncate(idx*TILE_BYTES);
    }
-#endif
+
+   return output;
+}
+
+void TilificationThread::run()
+{
+   m_output = tilifyItems(m_input,m_mode);
 
    emit tilificationComplete(m_output);
 }
@@ -2,15 +2,49 @@
 #define TILIFICATIONTHREAD_H
 
 #include <QThread>
+#include <QVector>
 
 #include "ichrrombankitem.h"
 
+#include "nes_emulator_core.h"
+
+// Bytes in one tile, both bit planes.
+#define TILE_BYTES (PATTERN_SIZE<<1)
+
+// Tiles in one pattern table.  Tiles are only merged within the pattern
+// table they are in, as the PPU fetches each from its own table.
+#define TILES_PER_PATTERN_TABLE (MEM_4KB/TILE_BYTES)
+
+// How the tiles of a graphics bank are merged.
+enum
+{
+   Tilify_None = 0,
+   Tilify_Duplicates,
+   Tilify_DuplicatesAndFlips
+};
+
+// Each whole input tile has an entry in the remap table giving the index
+// of the output tile it ended up in.  The flags say how that output tile
+// must be flipped to reproduce the input tile.
+#define TILE_REMAP_INDEX_MASK 0x0000FFFF
+#define TILE_REMAP_FLIP_HORIZ 0x00010000
+#define TILE_REMAP_FLIP_VERT  0x00020000
+
 class TilificationThread : public QThread
 {
    Q_OBJECT
 public:
    explicit TilificationThread(QObject *parent = 0);
 
+   void setMode(int mode) { m_mode = mode; }
+
+   // Keeps one copy of each tile that comes from a tile stamp in each
+   // pattern table.  Data from other items stays at the same offset, since
+   // code refers to it by position, and the tiles that are kept fill the
+   // places in between in their pattern table.
+   // The remap table says where each tile of a tile stamp went.
+   static QByteArray tilifyItems(QList<IChrRomBankItem*> items,int mode,QVector<quint32>* remap = NULL);
+
 protected:
    void run();
 
@@ -25,6 +59,7 @@ public slots:
 private:
    QList<IChrRomBankItem*> m_input;
    QByteArray m_output;
+   int m_mode;
 };
 
 #endif // TILIFICATIONTHREAD_H
@@ -1,8 +1,67 @@
 #include "cgraphicsassembler.h"
 #include "cnesicideproject.h"
+#include "tilificationthread.h"
+
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSet>
+#include <QTextStream>
 
 static const char emptyBank[MEM_8KB] = { 0, };
 
+// Labels in the tile number include are made from item names.
+static QString tileLabel(QString name)
+{
+   name.replace(QRegExp("[^A-Za-z0-9_]"),"_");
+   if ( name.isEmpty() || name.at(0).isDigit() )
+   {
+      name.prepend('_');
+   }
+   return name;
+}
+
+// Writes where each tile of a tile stamp ended up in its bank, so code can
+// find them however the bank's tiles were merged.  Stamps whose labels
+// would clash with one written before get a number on the end.
+static void writeTileNumbers(QString& text,QSet<QString>* labels,CGraphicsBank* gfxBank,const QVector<quint32>& remap)
+{
+   QString label;
+   QString unique;
+   QString flips;
+   quint32 entry;
+   int offset = 0;
+   int suffix;
+   int tile;
+
+   foreach ( IChrRomBankItem* bankItem, gfxBank->getGraphics() )
+   {
+      IProjectTreeViewItem* ptvi = dynamic_cast<IProjectTreeViewItem*>(bankItem);
+
+      // A stamp off a tile boundary is kept where it is, in pieces.
+      if ( (bankItem->getItemType() == "Tile") && (!(offset%TILE_BYTES)) )
+      {
+         label = tileLabel(gfxBank->caption())+"_"+tileLabel(ptvi->caption());
+         unique = label;
+         for ( suffix = 2; labels->contains(unique); suffix++ )
+         {
+            unique = label+"_"+QString::number(suffix);
+         }
+         label = unique;
+         labels->insert(label);
+         text += label+"_tiles:";
+         flips = label+"_flips:";
+         for ( tile = 0; tile < bankItem->getChrRomBankItemSize()/TILE_BYTES; tile++ )
+         {
+            entry = remap.isEmpty()?((offset/TILE_BYTES)+tile):remap.at((offset/TILE_BYTES)+tile);
+            text += QString((tile%16)?",":"\n   .byte ")+"$"+QString::number(entry&0xFF,16).rightJustified(2,'0').toUpper();
+            flips += QString((tile%16)?",":"\n   .byte ")+"$"+QString::number(((entry&TILE_REMAP_FLIP_HORIZ)?0x40:0)|((entry&TILE_REMAP_FLIP_VERT)?0x80:0),16).rightJustified(2,'0').toUpper();
+         }
+         text += "\n"+flips+"\n";
+      }
+      offset += bankItem->getChrRomBankItemSize();
+   }
+}
+
 CGraphicsAssembler::CGraphicsAssembler()
 {
 }
@@ -18,7 +77,13 @@ bool CGraphicsAssembler::assemble()
    CCHRROMBanks* chrBanks = CNesicideProject::instance()->getCartridge()->getChrRomBanks();
    QDir outputDir(CNesicideProject::instance()->getProjectCHRROMOutputBasePath());
    QString outputName;
+   QString tilesName;
+   QString tilesText;
+   QSet<QString> tilesLabels;
    QFile chrRomFile;
+   QFile tilesFile;
+   QVector<quint32> remap;
+   bool merged = false;
    int gfxBankSize;
    int currentChrSize;
    int currentGfxSize;
@@ -38,6 +103,12 @@ bool CGraphicsAssembler::assemble()
       outputName = outputDir.fromNativeSeparators(outputDir.filePath(CNesicideProject::instance()->getProjectCHRROMOutputName()));
    }
 
+   // Tile numbers go in an include beside the CHR-ROM.
+   tilesName = outputDir.fromNativeSeparators(outputDir.filePath(QFileInfo(outputName).completeBaseName()+"_tiles.inc"));
+   tilesText = "; Tile numbers of the tile stamps in each graphics bank, counted from\n"
+               "; the start of their pattern table, and the sprite attribute bits that\n"
+               "; flip a merged tile back.  Written when the CHR-ROM is built.\n";
+
    if ( gfxBanks->getGraphicsBanks().count() )
    {
       buildTextLogger->write("<b>Building: "+outputName+"</b>");
@@ -61,13 +132,33 @@ bool CGraphicsAssembler::assemble()
 
             if ( curGfxBank->getGraphics().count() )
             {
+               QList<QByteArray> bankData;
+
                for (int bankItemIdx = 0; bankItemIdx < curGfxBank->getGraphics().count(); bankItemIdx++)
                {
                   IChrRomBankItem* bankItem = curGfxBank->getGraphics().at(bankItemIdx);
                   IProjectTreeViewItem* ptvi = dynamic_cast<IProjectTreeViewItem*>(bankItem);
                   buildTextLogger->write("&nbsp;&nbsp;&nbsp;Adding: "+ptvi->caption()+"("+QString::number(bankItem->getChrRomBankItemSize())+" bytes)");
 
-                  QByteArray bankItemData = bankItem->getChrRomBankItemData();
+                  if ( curGfxBank->getTilification() == Tilify_None )
+                  {
+                     bankData.append(bankItem->getChrRomBankItemData());
+                  }
+               }
+
+               // Merged tiles are written as one block.
+               remap.clear();
+               if ( curGfxBank->getTilification() != Tilify_None )
+               {
+                  bankData.append(TilificationThread::tilifyItems(curGfxBank->getGraphics(),curGfxBank->getTilification(),&remap));
+                  buildTextLogger->write("&nbsp;&nbsp;&nbsp;Merged tiles: "+QString::number(bankData.first().count())+" bytes");
+                  merged = true;
+               }
+               writeTileNumbers(tilesText,&tilesLabels,curGfxBank,remap);
+
+               for (int bankDataIdx = 0; bankDataIdx < bankData.count(); bankDataIdx++)
+               {
+                  QByteArray bankItemData = bankData.at(bankDataIdx);
                   currentGfxSize += bankItemData.count();
                   currentChrSize += bankItemData.count();
                   if ( currentGfxSize > gfxBankSize )
@@ -108,6 +199,22 @@ bool CGraphicsAssembler::assemble()
 
          chrRomFile.close();
 
+         // Code that uses merged tiles needs their new numbers.  An include
+         // written before is kept up to date even once nothing is merged.
+         if ( merged || QFile::exists(tilesName) )
+         {
+            buildTextLogger->write("<b>Building: "+tilesName+"</b>");
+
+            tilesFile.setFileName(tilesName);
+            if ( !tilesFile.open(QIODevice::WriteOnly|QIODevice::Truncate|QIODevice::Text) )
+            {
+               buildTextLogger->write("<font color='red'>"+tilesName+": Error: cannot write tile numbers</font>");
+               return false;
+            }
+            QTextStream(&tilesFile) << tilesText;
+            tilesFile.close();
+         }
+
          return true;
       }
    }
@@ -2642,7 +2642,7 @@ void RENDERCPUCODEDATALOGGER ()
 {
    uint32_t idxx, idxy;
    uint32_t cycleDiff;
-   uint32_t curCycle = CCodeDataLogger::GetCurCycle ();
+   uint32_t curCycle = nesGetCodeDataLoggerCycle ();
    QColor lcolor;
    CCodeDataLogger* pLogger;
    LoggerInfo* pLogEntry;
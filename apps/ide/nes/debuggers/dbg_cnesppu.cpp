@@ -102,7 +102,7 @@ void RENDERPPUCODEDATALOGGER ( void )
 {
    uint32_t idxx;
    uint32_t cycleDiff;
-   uint32_t curCycle = CCodeDataLogger::GetCurCycle ();
+   uint32_t curCycle = nesGetCodeDataLoggerCycle ();
    QColor lcolor;
    CCodeDataLogger* pLogger;
    LoggerInfo* pLogEntry;
@@ -176,8 +176,75 @@ void RENDERPPUCODEDATALOGGER ( void )
    }
 }
 
+// The CHR memory and NameTable inspectors keep a cache of decoded tiles.
+// Each 16-byte pattern is decoded once into eight rows of eight color
+// indices and decoded again only when its bytes in the PPU snapshot change.
+// Together with a record of what each inspector last drew, this lets an
+// inspector redraw only the tiles whose inputs changed.
+#define NUM_PATTERNS (MEM_8KB/(PATTERN_SIZE<<1))
+
+typedef struct
+{
+   uint8_t data[NUM_PATTERNS][PATTERN_SIZE<<1];
+   uint8_t row[NUM_PATTERNS][PATTERN_SIZE][PATTERN_SIZE];
+   bool    changed[NUM_PATTERNS];
+   bool    valid;
+} DecodedTileCache;
+
+// Spreads the bits of a pattern plane byte out one per byte, leftmost
+// pixel first, so a row of both planes decodes eight pixels at a time.
+static struct PatternSpread
+{
+   PatternSpread()
+   {
+      uint8_t spread[PATTERN_SIZE];
+      int32_t data;
+      int32_t xf;
+
+      for ( data = 0; data < 256; data++ )
+      {
+         for ( xf = 0; xf < PATTERN_SIZE; xf++ )
+         {
+            spread[xf] = (data>>(7-xf))&0x1;
+         }
+         memcpy(&plane[data],spread,PATTERN_SIZE);
+      }
+   }
+   uint64_t plane[256];
+} m_patternSpread;
+
+static void DECODETILES ( DecodedTileCache* pCache, const uint8_t* pPatterns )
+{
+   uint64_t row;
+   int32_t pattern;
+   int32_t yf;
+
+   for ( pattern = 0; pattern < NUM_PATTERNS; pattern++ )
+   {
+      pCache->changed[pattern] = (!pCache->valid) ||
+                                 memcmp(pCache->data[pattern],pPatterns,PATTERN_SIZE<<1);
+      if ( pCache->changed[pattern] )
+      {
+         memcpy(pCache->data[pattern],pPatterns,PATTERN_SIZE<<1);
+         for ( yf = 0; yf < PATTERN_SIZE; yf++ )
+         {
+            row = m_patternSpread.plane[pPatterns[yf]]|
+                  (m_patternSpread.plane[pPatterns[yf+PATTERN_SIZE]]<<1);
+            memcpy(pCache->row[pattern][yf],&row,PATTERN_SIZE);
+         }
+      }
+      pPatterns += PATTERN_SIZE<<1;
+   }
+   pCache->valid = true;
+}
+
 static int8_t* _CHRMEMTV = NULL;
 
+// What the CHR memory inspector last drew.
+static DecodedTileCache m_chrMemTiles;
+static int32_t          m_chrMemDrawnColor [ 4 ][ 3 ];
+static bool             m_chrMemTVValid = false;
+
 int8_t* CHRMEMTV() { return _CHRMEMTV; }
 
 void CLEARCHRMEMTV()
@@ -190,6 +257,7 @@ void CLEARCHRMEMTV()
    {
       _CHRMEMTV[i] = 0xFF;
    }
+   m_chrMemTVValid = false;
 }
 
 static QColor         m_chrMemColor [ 4 ];
@@ -201,12 +269,15 @@ void SetCHRMEMInspectorColor ( int32_t idx, QColor color )
 
 void RENDERCHRMEM ( void )
 {
-   uint32_t ppuAddr = 0x0000;
-   uint8_t patternData1;
-   uint8_t patternData2;
-   uint8_t bit1, bit2;
+   int32_t tileX;
+   int32_t tileY;
+   int32_t pattern;
+   int32_t xf;
+   int32_t yf;
+   const uint8_t* pRow;
    uint8_t colorIdx;
    int32_t color[4][3];
+   bool colorChanged;
    int8_t* pTV;
 
    if ( !_CHRMEMTV )
@@ -217,9 +288,9 @@ void RENDERCHRMEM ( void )
       CLEARCHRMEMTV();
    }
 
-   pTV = _CHRMEMTV;
+   nesGetPpuSnapshotSections(&m_ppuState,PPU_SNAPSHOT_PATTERNS);
 
-   nesGetPpuSnapshot(&m_ppuState);
+   DECODETILES(&m_chrMemTiles,m_ppuState.memory);
 
    color[0][0] = m_chrMemColor[0].red();
    color[0][1] = m_chrMemColor[0].green();
@@ -234,33 +305,41 @@ void RENDERCHRMEM ( void )
    color[3][1] = m_chrMemColor[3].green();
    color[3][2] = m_chrMemColor[3].blue();
 
-   for (int y = 0; y < 128; y++)
+   colorChanged = (!m_chrMemTVValid) || memcmp(color,m_chrMemDrawnColor,sizeof(color));
+   memcpy(m_chrMemDrawnColor,color,sizeof(color));
+
+   // Pattern table 0 is on the left, pattern table 1 on the right, each
+   // 16 tiles across.
+   for ( tileY = 0; tileY < 16; tileY++ )
    {
-      for (int x = 0; x < 256; x += 8)
+      for ( tileX = 0; tileX < 32; tileX++ )
       {
-         ppuAddr = ((y>>3)<<8)+((x%128)<<1)+(y&0x7);
+         pattern = ((tileX>>4)<<8)+(tileY<<4)+(tileX&0xF);
 
-         if ( x >= 128 )
+         if ( (!colorChanged) && (!m_chrMemTiles.changed[pattern]) )
          {
-            ppuAddr += 0x1000;
+            continue;
          }
 
-         patternData1 = m_ppuState.memory[ppuAddr];
-         patternData2 = m_ppuState.memory[ppuAddr+8];
-
-         for ( int32_t xf = 0; xf < 8; xf++ )
+         for ( yf = 0; yf < PATTERN_SIZE; yf++ )
          {
-            bit1 = (patternData1>>(7-(xf)))&0x1;
-            bit2 = (patternData2>>(7-(xf)))&0x1;
-            colorIdx = (bit1|(bit2<<1));
-            *pTV = color[colorIdx][0];
-            *(pTV+1) = color[colorIdx][1];
-            *(pTV+2) = color[colorIdx][2];
-
-            pTV += 4;
+            pTV = _CHRMEMTV+((((tileY<<3)+yf)<<8)+(tileX<<3))*4;
+            pRow = m_chrMemTiles.row[pattern][yf];
+
+            for ( xf = 0; xf < PATTERN_SIZE; xf++ )
+            {
+               colorIdx = pRow[xf];
+               *pTV = color[colorIdx][0];
+               *(pTV+1) = color[colorIdx][1];
+               *(pTV+2) = color[colorIdx][2];
+
+               pTV += 4;
+            }
          }
       }
    }
+
+   m_chrMemTVValid = true;
 }
 
 static int8_t* _OAMTV = NULL;
@@ -308,7 +387,7 @@ void RENDEROAM ( void )
 
    pTV = _OAMTV;
 
-   nesGetPpuSnapshot(&m_ppuState);
+   nesGetPpuSnapshotSections(&m_ppuState,PPU_SNAPSHOT_REGISTERS|PPU_SNAPSHOT_OAM|PPU_SNAPSHOT_PATTERNS|PPU_SNAPSHOT_PALETTE);
 
    color[0] = CBasePalette::GetPalette ( 0x0D );
    color[1] = CBasePalette::GetPalette ( 0x10 );
@@ -402,6 +481,22 @@ void RENDEROAM ( void )
 
 static int8_t* NameTableTV = NULL;
 
+// What the NameTable inspector last drew in each tile.
+typedef struct
+{
+   uint16_t pattern;
+   uint8_t  attrib;
+   uint8_t  hidden[PATTERN_SIZE];
+} NameTableTile;
+
+static DecodedTileCache m_nameTableTiles;
+static NameTableTile    m_nameTableTile [ 60 ][ 64 ];
+static int8_t           m_nameTableDrawnColor [ 16 ][ 3 ];
+static bool             m_nameTableTVValid = false;
+
+// Pixels outside the TV screen, one bit per pixel of each tile row.
+static uint8_t          m_nameTableHidden [ 480 ][ 64 ];
+
 int8_t* NAMETABLETV() { return NameTableTV; }
 
 void CLEARNAMETABLETV()
@@ -414,25 +509,59 @@ void CLEARNAMETABLETV()
    {
       NameTableTV[i] = 0xFF;
    }
+   m_nameTableTVValid = false;
+}
+
+// Marks the pixels of a row from first through last that lie within the
+// span from spanFirst through spanLast as outside the TV screen.
+static void HIDEPIXELS ( uint8_t* pHidden, int32_t spanFirst, int32_t spanLast, int32_t first, int32_t last )
+{
+   if ( first < spanFirst )
+   {
+      first = spanFirst;
+   }
+   if ( last > spanLast )
+   {
+      last = spanLast;
+   }
+   for ( ; (first <= last) && (first&0x7); first++ )
+   {
+      pHidden[first>>3] |= (1<<(first&0x7));
+   }
+   for ( ; first+7 <= last; first += 8 )
+   {
+      pHidden[first>>3] = 0xFF;
+   }
+   for ( ; first <= last; first++ )
+   {
+      pHidden[first>>3] |= (1<<(first&0x7));
+   }
 }
 
 void RENDERNAMETABLE ( void )
 {
-   int32_t x, xf, y;
+   int32_t x, xf, y, yf;
    int32_t lbx, ubx, lby, uby;
-
-   uint32_t ppuAddr = 0x0000;
-   uint16_t patternIdx;
+   int32_t line;
+   int32_t change;
+   int32_t changes;
+   int32_t first;
+   int32_t last;
+   const PpuScrollChange* pChange;
    int32_t tileX;
    int32_t tileY;
+   int32_t nameTable;
    int32_t nameAddr;
    int32_t attribAddr;
    int32_t bkgndPatBase;
+   uint16_t pattern;
    uint8_t attribData;
-   uint8_t patternData1;
-   uint8_t patternData2;
-   uint8_t bit1, bit2;
+   uint8_t hidden[PATTERN_SIZE];
+   const uint8_t* pRow;
    uint8_t colorIdx;
+   int8_t color[16][3];
+   bool paletteChanged[4];
+   NameTableTile* pTile;
    int8_t* pTV;
 
    if ( !NameTableTV )
@@ -443,113 +572,125 @@ void RENDERNAMETABLE ( void )
       CLEARNAMETABLETV();
    }
 
-   pTV = NameTableTV;
+   nesGetPpuSnapshotSections(&m_ppuState,PPU_SNAPSHOT_REGISTERS|PPU_SNAPSHOT_PATTERNS|PPU_SNAPSHOT_NAMETABLES|PPU_SNAPSHOT_PALETTE|(m_bPPUViewerShowVisible?PPU_SNAPSHOT_SCROLL:0));
+
+   DECODETILES(&m_nameTableTiles,m_ppuState.memory);
 
-   nesGetPpuSnapshot(&m_ppuState);
+   for ( colorIdx = 0; colorIdx < 16; colorIdx++ )
+   {
+      color[colorIdx][0] = CBasePalette::GetPaletteR(m_ppuState.paletteMemory[colorIdx]);
+      color[colorIdx][1] = CBasePalette::GetPaletteG(m_ppuState.paletteMemory[colorIdx]);
+      color[colorIdx][2] = CBasePalette::GetPaletteB(m_ppuState.paletteMemory[colorIdx]);
+   }
+   for ( colorIdx = 0; colorIdx < 4; colorIdx++ )
+   {
+      paletteChanged[colorIdx] = (!m_nameTableTVValid) ||
+                                 memcmp(color[colorIdx<<2],m_nameTableDrawnColor[colorIdx<<2],sizeof(color[0])<<2);
+   }
+   memcpy(m_nameTableDrawnColor,color,sizeof(color));
 
-   for ( y = 0; y < 480; y++ )
+   // Work out which pixels lie outside the TV screen.  Each scanline's
+   // scroll changes split its row into spans that share one visible range.
+   memset(m_nameTableHidden,0,sizeof(m_nameTableHidden));
+   if ( m_bPPUViewerShowVisible )
    {
-      for ( x = 0; x < 512; x += PATTERN_SIZE ) // pattern-slice rendering...
+      for ( y = 0; y < 480; y++ )
       {
-         tileX = ppuAddr&0x001F;
-         tileY = (ppuAddr&0x03E0)>>5;
-         nameAddr = 0x2000 + (ppuAddr&0x0FFF);
-         attribAddr = 0x2000 + (ppuAddr&0x0C00) + 0x03C0 + ((tileY&0xFFFC)<<1) + (tileX>>2);
-         bkgndPatBase = (!!(m_ppuState.reg[PPUCTRL_REG]&PPUCTRL_BKGND_PAT_TBL_ADDR))<<12;
-
-         patternIdx = bkgndPatBase+(m_ppuState.memory[nameAddr]<<4)+((ppuAddr&0x7000)>>12);
-         attribData = m_ppuState.memory[attribAddr];
-         patternData1 = m_ppuState.memory[patternIdx];
-         patternData2 = m_ppuState.memory[patternIdx+PATTERN_SIZE];
-
-         if ( (tileY&0x0002) == 0 )
-         {
-            if ( (tileX&0x0002) == 0 )
-            {
-               attribData = (attribData&0x03)<<2;
-            }
-            else
-            {
-               attribData = (attribData&0x0C);
-            }
-         }
-         else
-         {
-            if ( (tileX&0x0002) == 0 )
-            {
-               attribData = (attribData&0x30)>>2;
-            }
-            else
-            {
-               attribData = (attribData&0xC0)>>4;
-            }
-         }
+         line = y%240;
+         changes = m_ppuState.scrollChanges[line];
+         pChange = m_ppuState.scrollChange[line];
 
-         for ( xf = 0; xf < PATTERN_SIZE; xf++ )
+         for ( change = 0; change < (changes?changes:1); change++ )
          {
-            bit1 = (patternData1>>(7-(xf)))&0x1;
-            bit2 = (patternData2>>(7-(xf)))&0x1;
-            colorIdx = (attribData|bit1|(bit2<<1));
-            *pTV = CBasePalette::GetPaletteR(m_ppuState.paletteMemory[colorIdx]);
-            *(pTV+1) = CBasePalette::GetPaletteG(m_ppuState.paletteMemory[colorIdx]);
-            *(pTV+2) = CBasePalette::GetPaletteB(m_ppuState.paletteMemory[colorIdx]);
-
-            if ( m_bPPUViewerShowVisible )
+            lbx = changes?(pChange+change)->scrollX:0;
+            ubx = lbx>>8?lbx&0xFF:lbx+255;
+            lby = changes?(pChange+change)->scrollY:0;
+            uby = lby/240?lby%240:lby+239;
+
+            first = change?(pChange+change)->x:0;
+            last = (change+1 < changes)?(pChange+change+1)->x-1:255;
+
+            // The same span of the TV screen is checked against both
+            // NameTables across the row.
+            for ( x = 0; x < 512; x += 256 )
             {
-               lbx = *(*(m_ppuState.xOffset+((x+xf)&0xFF))+(y%240));
-               ubx = lbx>>8?lbx&0xFF:lbx+255;
-               lby = *(*(m_ppuState.yOffset+((x+xf)&0xFF))+(y%240));
-               uby = lby/240?lby%240:lby+239;
-
-               if ( !( (((lbx <= ubx) && ((x+xf) >= lbx) && ((x+xf) <= ubx)) ||
-                        ((lbx > ubx) && (!(((x+xf) <= lbx) && ((x+xf) >= ubx))))) &&
-                       (((lby <= uby) && (y >= lby) && (y <= uby)) ||
-                        ((lby > uby) && (!((y <= lby) && (y >= uby))))) ) )
+               if ( !(((lby <= uby) && (y >= lby) && (y <= uby)) ||
+                      ((lby > uby) && (!((y <= lby) && (y >= uby))))) )
                {
-                  *pTV &= 0xCF;
-                  *(pTV+1) &= 0xCF;
-                  *(pTV+2) &= 0xCF;
+                  HIDEPIXELS(m_nameTableHidden[y],x+first,x+last,x+first,x+last);
+               }
+               else if ( lbx <= ubx )
+               {
+                  HIDEPIXELS(m_nameTableHidden[y],x+first,x+last,0,lbx-1);
+                  HIDEPIXELS(m_nameTableHidden[y],x+first,x+last,ubx+1,511);
+               }
+               else
+               {
+                  HIDEPIXELS(m_nameTableHidden[y],x+first,x+last,ubx,lbx);
                }
             }
-
-            pTV += 4;
          }
+      }
+   }
 
-         ppuAddr++;
+   bkgndPatBase = (!!(m_ppuState.reg[PPUCTRL_REG]&PPUCTRL_BKGND_PAT_TBL_ADDR))<<12;
+
+   // NameTables 0 and 1 are across the top, 2 and 3 across the bottom.
+   for ( tileY = 0; tileY < 60; tileY++ )
+   {
+      for ( tileX = 0; tileX < 64; tileX++ )
+      {
+         nameTable = ((tileY/30)<<1)|(tileX>>5);
+         nameAddr = 0x2000 + (nameTable<<10) + ((tileY%30)<<5) + (tileX&0x1F);
+         attribAddr = 0x2000 + (nameTable<<10) + 0x03C0 + (((tileY%30)&0xFFFC)<<1) + ((tileX&0x1F)>>2);
 
-         if ( x == 248 || x == 504 )
+         pattern = (bkgndPatBase+(m_ppuState.memory[nameAddr]<<4))>>4;
+         attribData = ((m_ppuState.memory[attribAddr]>>((((tileY%30)&0x0002)<<1)|(tileX&0x0002)))&0x03)<<2;
+         for ( yf = 0; yf < PATTERN_SIZE; yf++ )
          {
-            ppuAddr ^= 0x400;
-            ppuAddr -= 0x20;
+            hidden[yf] = m_nameTableHidden[(tileY<<3)+yf][tileX];
          }
-      }
-
-      if ( (ppuAddr&0x7000) == 0x7000 )
-      {
-         ppuAddr &= 0x8FFF;
 
-         if ( (ppuAddr&0x03E0) == 0x03A0 )
+         pTile = &m_nameTableTile[tileY][tileX];
+         if ( m_nameTableTVValid &&
+              (pTile->pattern == pattern) &&
+              (pTile->attrib == attribData) &&
+              (!m_nameTableTiles.changed[pattern]) &&
+              (!paletteChanged[attribData>>2]) &&
+              (!memcmp(pTile->hidden,hidden,sizeof(hidden))) )
          {
-            ppuAddr ^= 0x0800;
-            ppuAddr &= 0xFC1F;
+            continue;
          }
-         else
+         pTile->pattern = pattern;
+         pTile->attrib = attribData;
+         memcpy(pTile->hidden,hidden,sizeof(hidden));
+
+         for ( yf = 0; yf < PATTERN_SIZE; yf++ )
          {
-            if ( (ppuAddr&0x03E0) == 0x03E0 )
-            {
-               ppuAddr &= 0xFC1F;
-            }
-            else
+            pTV = NameTableTV+((((tileY<<3)+yf)<<9)+(tileX<<3))*4;
+            pRow = m_nameTableTiles.row[pattern][yf];
+
+            for ( xf = 0; xf < PATTERN_SIZE; xf++ )
             {
-               ppuAddr += 0x0020;
+               colorIdx = attribData|pRow[xf];
+               *pTV = color[colorIdx][0];
+               *(pTV+1) = color[colorIdx][1];
+               *(pTV+2) = color[colorIdx][2];
+
+               if ( (hidden[yf]>>xf)&0x1 )
+               {
+                  *pTV &= 0xCF;
+                  *(pTV+1) &= 0xCF;
+                  *(pTV+2) &= 0xCF;
+               }
+
+               pTV += 4;
             }
          }
       }
-      else
-      {
-         ppuAddr += 0x1000;
-      }
    }
+
+   m_nameTableTVValid = true;
 }
 
 uint32_t SCANLINES ( void )
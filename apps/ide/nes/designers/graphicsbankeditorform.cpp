@@ -9,7 +9,7 @@
 #include "nes_emulator_core.h"
 #include "cnessystempalette.h"
 
-GraphicsBankEditorForm::GraphicsBankEditorForm(uint32_t size, QList<IChrRomBankItem*> bankItems,IProjectTreeViewItem* link,QWidget* parent) :
+GraphicsBankEditorForm::GraphicsBankEditorForm(uint32_t size, int tilification, QList<IChrRomBankItem*> bankItems,IProjectTreeViewItem* link,QWidget* parent) :
    CDesignerEditorBase(link,parent),
    ui(new Ui::GraphicsBankEditorForm)
 {
@@ -53,6 +53,11 @@ GraphicsBankEditorForm::GraphicsBankEditorForm(uint32_t size, QList<IChrRomBankI
 
    ui->gauge->setMaximum(size);
 
+   ui->tilify->blockSignals(true);
+   ui->tilify->setCurrentIndex(tilification);
+   ui->tilify->blockSignals(false);
+   pThread->setMode(tilification);
+
    updateChrRomBankItemList(bankItems);
 
    // Get mouse events from the renderer here!
@@ -96,6 +101,11 @@ uint32_t GraphicsBankEditorForm::bankSize()
    return ui->bankSize->itemData(ui->bankSize->currentIndex()).toInt();
 }
 
+int GraphicsBankEditorForm::tilification()
+{
+   return ui->tilify->currentIndex();
+}
+
 bool GraphicsBankEditorForm::eventFilter(QObject* obj,QEvent* event)
 {
    if ( obj == renderer )
@@ -519,3 +529,11 @@ void GraphicsBankEditorForm::on_bankSize_currentIndexChanged(int index)
    setModified(true);
    emit markProjectDirty(true);
 }
+
+void GraphicsBankEditorForm::on_tilify_currentIndexChanged(int index)
+{
+   pThread->setMode(index);
+   updateUi();
+   setModified(true);
+   emit markProjectDirty(true);
+}
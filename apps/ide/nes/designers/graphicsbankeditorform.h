@@ -22,13 +22,14 @@ class GraphicsBankEditorForm : public CDesignerEditorBase
 {
    Q_OBJECT
 public:
-   GraphicsBankEditorForm(uint32_t size, QList<IChrRomBankItem*> bankItems,IProjectTreeViewItem* link = 0,QWidget* parent = 0);
+   GraphicsBankEditorForm(uint32_t size, int tilification, QList<IChrRomBankItem*> bankItems,IProjectTreeViewItem* link = 0,QWidget* parent = 0);
    virtual ~GraphicsBankEditorForm();
    void updateChrRomBankItemList(QList<IChrRomBankItem*> bankItems);
 
    // Member getters.
    QList<IChrRomBankItem*> bankItems();
    uint32_t bankSize();
+   int tilification();
 
 protected:
    void changeEvent(QEvent* event);
@@ -67,6 +68,7 @@ private slots:
    void on_moveDown_clicked();
 
    void on_bankSize_currentIndexChanged(int index);
+   void on_tilify_currentIndexChanged(int index);
    void tableView_doubleClicked(QModelIndex index);
 
 signals:
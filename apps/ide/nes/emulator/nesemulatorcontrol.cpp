@@ -44,6 +44,8 @@ NESEmulatorControl::NESEmulatorControl(QWidget *parent) :
    QObject::connect(this,SIGNAL(stepOutCPUEmulation()),emulator,SLOT(stepOutCPUEmulation()));
    QObject::connect(this,SIGNAL(stepPPUEmulation()),emulator,SLOT(stepPPUEmulation()));
    QObject::connect(this,SIGNAL(advanceFrame()),emulator,SLOT(advanceFrame()));
+   QObject::connect(this,SIGNAL(stepBackFrame()),emulator,SLOT(stepBackFrame()));
+   QObject::connect(this,SIGNAL(stepBackBreakpoint()),emulator,SLOT(stepBackBreakpoint()));
    QObject::connect(this,SIGNAL(resetEmulator()),emulator,SLOT(resetEmulator()));
    QObject::connect(this,SIGNAL(softResetEmulator()),emulator,SLOT(softResetEmulator()));
 
@@ -66,6 +68,8 @@ QList<QAction*> NESEmulatorControl::menu()
    items.append(ui->actionStep_Out);
    items.append(ui->actionStep_PPU);
    items.append(ui->actionFrame_Advance);
+   items.append(ui->actionStep_Back_Frame);
+   items.append(ui->actionStep_Back_Breakpoint);
    items.append(ui->actionReset);
    items.append(ui->actionSoft_Reset);
    return items;
@@ -87,6 +91,8 @@ void NESEmulatorControl::internalPlay()
    ui->actionStep_Out->setEnabled(false);
    ui->actionStep_PPU->setEnabled(false);
    ui->actionFrame_Advance->setEnabled(false);
+   ui->actionStep_Back_Frame->setEnabled(false);
+   ui->actionStep_Back_Breakpoint->setEnabled(false);
 }
 
 void NESEmulatorControl::internalPause()
@@ -107,6 +113,8 @@ void NESEmulatorControl::internalPause()
       ui->actionStep_Out->setEnabled(debugging);
       ui->actionStep_PPU->setEnabled(debugging);
       ui->actionFrame_Advance->setEnabled(debugging);
+      ui->actionStep_Back_Frame->setEnabled(debugging);
+      ui->actionStep_Back_Breakpoint->setEnabled(debugging);
    }
    else
    {
@@ -124,6 +132,8 @@ void NESEmulatorControl::internalPause()
       ui->actionStep_Out->setEnabled(false);
       ui->actionStep_PPU->setEnabled(false);
       ui->actionFrame_Advance->setEnabled(false);
+      ui->actionStep_Back_Frame->setEnabled(false);
+      ui->actionStep_Back_Breakpoint->setEnabled(false);
    }
 }
 
@@ -176,6 +186,16 @@ void NESEmulatorControl::on_frameAdvance_clicked()
    emit advanceFrame();
 }
 
+void NESEmulatorControl::on_actionStep_Back_Frame_triggered()
+{
+   emit stepBackFrame();
+}
+
+void NESEmulatorControl::on_actionStep_Back_Breakpoint_triggered()
+{
+   emit stepBackBreakpoint();
+}
+
 void NESEmulatorControl::on_stepOverButton_clicked()
 {
    CCC65Interface::instance()->isBuildUpToDate();
@@ -203,6 +223,8 @@ void NESEmulatorControl::on_debugButton_toggled(bool checked)
    ui->actionStep_Out->setEnabled(checked);
    ui->actionStep_PPU->setEnabled(checked);
    ui->actionFrame_Advance->setEnabled(checked);
+   ui->actionStep_Back_Frame->setEnabled(checked);
+   ui->actionStep_Back_Breakpoint->setEnabled(checked);
 
    if ( debugging )
    {
@@ -29,6 +29,8 @@ signals:
    void stepOutCPUEmulation();
    void stepPPUEmulation();
    void advanceFrame();
+   void stepBackFrame();
+   void stepBackBreakpoint();
    void resetEmulator();
    void softResetEmulator();
 
@@ -38,6 +40,8 @@ private slots:
    void on_stepOutButton_clicked();
    void on_stepOverButton_clicked();
    void on_frameAdvance_clicked();
+   void on_actionStep_Back_Frame_triggered();
+   void on_actionStep_Back_Breakpoint_triggered();
    void on_resetButton_clicked();
    void on_stepPPUButton_clicked();
    void on_stepCPUButton_clicked();
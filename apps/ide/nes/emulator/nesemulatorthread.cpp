@@ -23,6 +23,8 @@
 #include "dbg_cnes.h"
 #include "dbg_cnesrom.h"
 
+#include "cbreakpointinfo.h"
+
 #include "ccc65interface.h"
 
 #include "cobjectregistry.h"
@@ -47,22 +49,56 @@ static void breakpointHook ( void )
    NESEmulatorThread* emulator = dynamic_cast<NESEmulatorThread*>(CObjectRegistry::instance()->getObject("Emulator"));
    if ( emulator && emulator->worker() )
    {
-      emulator->worker()->_breakpointHook();
-
-      // Put my thread to sleep.
-      emulator->worker()->nesBreakpointSemaphore->acquire();
+      if ( emulator->worker()->_breakpointHook() )
+      {
+         // Put my thread to sleep.
+         emulator->worker()->nesBreakpointSemaphore->acquire();
+      }
    }
 }
 
-void NESEmulatorWorker::_breakpointHook()
+bool NESEmulatorWorker::_breakpointHook()
 {
+   CBreakpointInfo* pBreakpoints = nesGetBreakpointDatabase();
+   int idx;
+
+   // When rewinding to a breakpoint hit, pass over the hits before it.
+   if ( m_replayToBreakpoint )
+   {
+      if ( nesGetCPUCycle() < m_replayCycle )
+      {
+         return false;
+      }
+      m_replayToBreakpoint = false;
+      m_replayStopped = true;
+      m_isReplaying = false;
+   }
+
+   // Remember where breakpoints, as opposed to steps and pauses, stopped
+   // the emulator so that they can be stepped back to.
+   for ( idx = 0; idx < pBreakpoints->GetNumBreakpoints(); idx++ )
+   {
+      if ( pBreakpoints->GetBreakpoint(idx)->hit )
+      {
+         m_rewind.breakpointHit(nesGetPPUFrame(),nesGetCPUCycle());
+         break;
+      }
+   }
+
+   // Trigger inspector updates...
+   nesDisassemble();
+
    emit breakpoint();
+
+   return true;
 }
 
 static void audioHook ( void )
 {
    NESEmulatorThread* emulator = dynamic_cast<NESEmulatorThread*>(CObjectRegistry::instance()->getObject("Emulator"));
-   if ( emulator && emulator->worker() )
+
+   // Replayed frames are not heard so they need not wait for the audio.
+   if ( emulator && emulator->worker() && (!emulator->worker()->isReplaying()) )
       emulator->worker()->nesAudioSemaphore->acquire();
 }
 
@@ -198,6 +234,16 @@ void NESEmulatorThread::advanceFrame ()
    pWorker->advanceFrame();
 }
 
+void NESEmulatorThread::stepBackFrame ()
+{
+   pWorker->stepBackFrame();
+}
+
+void NESEmulatorThread::stepBackBreakpoint ()
+{
+   pWorker->stepBackBreakpoint();
+}
+
 void NESEmulatorThread::exitEmulator()
 {
    pWorker->exitEmulator();
@@ -245,6 +291,14 @@ NESEmulatorWorker::NESEmulatorWorker(QObject*)
    m_isExiting = false;
    m_debugFrame = 0;
    m_pCartridge = NULL;
+   m_isRewinding = false;
+   m_rewindToBreakpoint = false;
+   m_rewindFrame = 0;
+   m_rewindCycle = 0;
+   m_isReplaying = false;
+   m_replayToBreakpoint = false;
+   m_replayStopped = false;
+   m_replayCycle = 0;
 
    nesBreakpointSemaphore = new QSemaphore(0);
    nesAudioSemaphore = new QSemaphore(0);
@@ -480,6 +534,139 @@ void NESEmulatorWorker::advanceFrame ()
    }
 }
 
+void NESEmulatorWorker::stepBackFrame ()
+{
+   uint32_t frame = nesGetPPUFrame();
+
+   // Go back to the start of the frame the emulator is stopped in, or to
+   // the start of the previous one if stopped between frames.  The
+   // emulator is stopped so its position can be read from here.
+   if ( nesGetPPUCycle() == 0 )
+   {
+      frame--;
+   }
+   if ( (frame == 0) || (!m_rewind.canRestore(frame-1)) )
+   {
+      return;
+   }
+
+   m_rewindFrame = frame-1;
+   m_rewindToBreakpoint = false;
+   m_isRewinding = true;
+   m_isStarting = false;
+   m_isRunning = false;
+
+   // Let the frame the emulator is stopped in finish without stopping
+   // again since it is about to be undone...
+   nesEnableBreakpoints(false);
+
+   if ( !(nesBreakpointSemaphore->available()) )
+   {
+      nesBreakpointSemaphore->release();
+   }
+}
+
+void NESEmulatorWorker::stepBackBreakpoint ()
+{
+   uint32_t hitFrame;
+   uint32_t hitCycle;
+
+   if ( (!m_rewind.previousBreakpoint(nesGetPPUFrame(),nesGetCPUCycle(),&hitFrame,&hitCycle)) ||
+        (!m_rewind.canRestore(hitFrame-1)) )
+   {
+      return;
+   }
+
+   m_rewindFrame = hitFrame-1;
+   m_rewindCycle = hitCycle;
+   m_rewindToBreakpoint = true;
+   m_isRewinding = true;
+   m_isStarting = false;
+   m_isRunning = false;
+
+   // Let the frame the emulator is stopped in finish without stopping
+   // again since it is about to be undone...
+   nesEnableBreakpoints(false);
+
+   if ( !(nesBreakpointSemaphore->available()) )
+   {
+      nesBreakpointSemaphore->release();
+   }
+}
+
+void NESEmulatorWorker::configureRewind ()
+{
+   uint32_t budget = EmulatorPrefsDialog::getRewindBudget()<<20;
+   int32_t  snapshotInterval = EmulatorPrefsDialog::getRewindSnapshotInterval();
+   int32_t  keyframeInterval = EmulatorPrefsDialog::getRewindKeyframeInterval();
+
+   if ( (budget != m_rewind.budget()) ||
+        (snapshotInterval != m_rewind.snapshotInterval()) ||
+        (keyframeInterval != m_rewind.keyframeInterval()) )
+   {
+      m_rewind.configure(budget,snapshotInterval,keyframeInterval);
+   }
+}
+
+void NESEmulatorWorker::rewind ()
+{
+   uint32_t joy [ NUM_CONTROLLERS ] = { 0, 0 };
+   uint32_t snapshotFrame;
+   uint32_t frame;
+
+   m_replayStopped = false;
+
+   // Restore the nearest snapshot and run forward to the end of the target
+   // frame with breakpoints off and without waiting on the audio.
+   m_isReplaying = true;
+   nesEnableBreakpoints(false);
+
+   if ( m_rewind.restore(m_rewindFrame,&snapshotFrame) )
+   {
+      for ( frame = snapshotFrame+1; frame <= m_rewindFrame; frame++ )
+      {
+         m_rewind.input(frame,joy);
+         nesRun(joy);
+      }
+
+      if ( m_rewindToBreakpoint )
+      {
+         // Run the frame the breakpoint was hit in, stopping at the hit.
+         m_rewind.input(m_rewindFrame+1,joy);
+         m_rewind.truncate(m_rewindFrame);
+         m_rewind.forgetBreakpoints(m_rewindFrame+1,m_rewindCycle);
+         m_rewind.recordInput(m_rewindFrame+1,joy);
+
+         m_replayCycle = m_rewindCycle;
+         m_replayToBreakpoint = true;
+         nesEnableBreakpoints(true);
+         nesRun(joy);
+         m_replayToBreakpoint = false;
+
+         if ( !m_isRewinding )
+         {
+            m_rewind.frameCompleted(nesGetPPUFrame());
+         }
+      }
+      else
+      {
+         m_rewind.truncate(m_rewindFrame);
+      }
+   }
+
+   m_isReplaying = false;
+   nesClearAudioSamplesAvailable();
+   nesEnableBreakpoints(true);
+
+   // Pause where the rewind ended unless it stopped at the breakpoint hit,
+   // in which case whatever was done there decides what happens next.
+   if ( !m_replayStopped )
+   {
+      m_isPaused = true;
+      m_showOnPause = true;
+   }
+}
+
 void NESEmulatorWorker::exitEmulator()
 {
    m_isExiting = true;
@@ -586,6 +773,7 @@ void NESEmulatorWorker::process ()
    int emuY;
    int32_t samplesAvailable;
    int32_t debuggerUpdateRate = EnvironmentSettingsDialog::debuggerUpdateRate();
+   uint32_t joy [ NUM_CONTROLLERS ];
 
    // Special case for 1Hz debugger update to match system mode.
    if ( debuggerUpdateRate == -1 )
@@ -600,6 +788,9 @@ void NESEmulatorWorker::process ()
       }
    }
 
+   // Pick up any change to the rewind settings...
+   configureRewind();
+
    // Exit?
    if ( m_isExiting )
    {
@@ -651,13 +842,28 @@ void NESEmulatorWorker::process ()
             emit updateDebuggers();
          }
       }
+      // Start the rewind history over from the reset...
+      m_rewind.clear();
+      if ( nesROMIsLoaded() )
+      {
+         m_rewind.frameCompleted(nesGetPPUFrame());
+      }
+
       // Trigger UI updates...
+      nesDisassemble();
       emit emulatorReset();
 
       // Don't *keep* resetting...
       m_isResetting = false;
    }
 
+   // Step back?
+   if ( m_isRewinding )
+   {
+      m_isRewinding = false;
+      rewind();
+   }
+
    // Pause?
    if ( m_isPaused || (m_pauseAfterFrames == 0) )
    {
@@ -732,7 +938,18 @@ void NESEmulatorWorker::process ()
                                            emuY+(240*scale));
          }
       }
-      nesRun(m_joy);
+      // Keep the input for the frame so that it can be replayed...
+      joy [ CONTROLLER1 ] = m_joy [ CONTROLLER1 ];
+      joy [ CONTROLLER2 ] = m_joy [ CONTROLLER2 ];
+      m_rewind.recordInput(nesGetPPUFrame()+1,joy);
+
+      nesRun(joy);
+
+      // Add the frame to the rewind history unless it is about to be undone...
+      if ( !m_isRewinding )
+      {
+         m_rewind.frameCompleted(nesGetPPUFrame());
+      }
 
       if ( m_pauseAfterFrames != -1 )
       {
@@ -750,6 +967,8 @@ void NESEmulatorWorker::process ()
          m_debugFrame = debuggerUpdateRate;
          if ( nesIsDebuggable && (!DebuggerUpdateThread::isSilenced()) )
          {
+            // Show code executed since the last update...
+            nesDisassemble();
             emit updateDebuggers();
          }
       }
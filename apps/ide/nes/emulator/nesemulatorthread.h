@@ -10,6 +10,8 @@
 
 #include "ccartridge.h"
 
+#include "nesrewindbuffer.h"
+
 class NESEmulatorWorker : public QObject, public IXMLSerializable
 {
    Q_OBJECT
@@ -24,7 +26,8 @@ public:
    virtual bool serializeContent(QFile& fileOut);
    virtual bool deserializeContent(QFile& fileIn);
 
-   void _breakpointHook();
+   bool _breakpointHook();
+   bool isReplaying() const { return m_isReplaying; }
 
    QSemaphore* nesBreakpointSemaphore;
    QSemaphore* nesAudioSemaphore;
@@ -41,6 +44,8 @@ public:
    void stepOutCPUEmulation ();
    void stepPPUEmulation ();
    void advanceFrame ();
+   void stepBackFrame ();
+   void stepBackBreakpoint ();
    void exitEmulator ();
    void adjustAudio ( int32_t bufferDepth );
    void controllerInput ( uint32_t* joy )
@@ -66,6 +71,9 @@ public slots:
    void process();
 
 protected:
+   void configureRewind ();
+   void rewind ();
+
    QTimer* pTimer;
 
    CCartridge*   m_pCartridge;
@@ -81,6 +89,20 @@ protected:
    bool          m_isExiting;
    int           m_debugFrame;
    uint32_t      m_joy [ NUM_CONTROLLERS ];
+
+   // Rewind history and the position a step back was requested from.
+   NESRewindBuffer m_rewind;
+   bool          m_isRewinding;
+   bool          m_rewindToBreakpoint;
+   uint32_t      m_rewindFrame;
+   uint32_t      m_rewindCycle;
+
+   // While replaying recorded frames audio is not synchronized and only
+   // the breakpoint hit being rewound to stops the emulator.
+   bool          m_isReplaying;
+   bool          m_replayToBreakpoint;
+   bool          m_replayStopped;
+   uint32_t      m_replayCycle;
 };
 
 class NESEmulatorThread : public QObject, public IXMLSerializable
@@ -112,6 +134,8 @@ public slots:
    void stepOutCPUEmulation ();
    void stepPPUEmulation ();
    void advanceFrame ();
+   void stepBackFrame ();
+   void stepBackBreakpoint ();
    void exitEmulator ();
    void adjustAudio ( int32_t bufferDepth );
    void controllerInput ( uint32_t* joy ) { pWorker->controllerInput(joy); }
@@ -0,0 +1,545 @@
+//    NESICIDE - an IDE for the 8-bit NES.
+//    Copyright (C) 2009  Christopher S. Pow
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "nesrewindbuffer.h"
+
+#include <string.h>
+
+// Snapshot encoding.  The state is XORed against a reference state (the
+// keyframe, or zeroes for a keyframe itself) and stored as pairs of
+// varint lengths: a run of bytes equal to the reference followed by a run
+// of literal XORed bytes.  A literal run ends at the first four bytes that
+// match the reference, so short matches inside changed data do not cost a
+// pair of lengths each.
+static inline uint8_t* putLength ( uint8_t* out, uint32_t length )
+{
+   while ( length >= 0x80 )
+   {
+      *out++ = (length&0x7F)|0x80;
+      length >>= 7;
+   }
+   *out++ = length;
+   return out;
+}
+
+static inline const uint8_t* getLength ( const uint8_t* in, uint32_t* length )
+{
+   uint32_t shift = 0;
+
+   (*length) = 0;
+   do
+   {
+      (*length) |= ((*in)&0x7F)<<shift;
+      shift += 7;
+   } while ( (*in++)&0x80 );
+   return in;
+}
+
+static inline bool matches4 ( const uint8_t* a, const uint8_t* b )
+{
+   uint32_t wa;
+   uint32_t wb;
+
+   memcpy(&wa,a,sizeof(wa));
+   memcpy(&wb,b,sizeof(wb));
+   return wa == wb;
+}
+
+static uint32_t encodeState ( const uint8_t* state, const uint8_t* reference, uint32_t size, uint8_t* out )
+{
+   uint8_t* start = out;
+   uint32_t pos = 0;
+   uint32_t end;
+   uint32_t idx;
+   uint64_t wa;
+   uint64_t wb;
+
+   while ( pos < size )
+   {
+      // Unchanged run, compared a word at a time.
+      end = pos;
+      while ( end+8 <= size )
+      {
+         memcpy(&wa,state+end,sizeof(wa));
+         memcpy(&wb,reference+end,sizeof(wb));
+         if ( wa != wb )
+         {
+            break;
+         }
+         end += 8;
+      }
+      while ( (end < size) && (state[end] == reference[end]) )
+      {
+         end++;
+      }
+      out = putLength(out,end-pos);
+      pos = end;
+
+      // Changed run.
+      while ( (end < size) &&
+              ((end+4 > size) || (!matches4(state+end,reference+end))) )
+      {
+         end++;
+      }
+      out = putLength(out,end-pos);
+      for ( idx = pos; idx < end; idx++ )
+      {
+         *out++ = state[idx]^reference[idx];
+      }
+      pos = end;
+   }
+
+   return out-start;
+}
+
+static void decodeState ( const uint8_t* in, const uint8_t* reference, uint32_t size, uint8_t* state )
+{
+   uint32_t pos = 0;
+   uint32_t length;
+   uint32_t idx;
+
+   while ( pos < size )
+   {
+      in = getLength(in,&length);
+      memcpy(state+pos,reference+pos,length);
+      pos += length;
+
+      in = getLength(in,&length);
+      for ( idx = pos; idx < pos+length; idx++ )
+      {
+         state[idx] = (*in++)^reference[idx];
+      }
+      pos += length;
+   }
+}
+
+// Worst case encoded size: a literal byte with a pair of lengths for every
+// five bytes of state.
+#define ENCODED_SIZE(size) (((size)*2)+16)
+
+// Records are kept word aligned for the recorded input at their start.
+#define ALIGNED(size) (((size)+3)&(~3))
+
+NESRewindBuffer::NESRewindBuffer()
+   : m_arena(NULL),
+     m_size(0),
+     m_tail(0),
+     m_snapshotInterval(1),
+     m_keyframeInterval(1),
+     m_stateSize(0),
+     m_state(NULL),
+     m_keyframe(NULL),
+     m_reference(NULL),
+     m_zero(NULL),
+     m_encoded(NULL),
+     m_keyframeValid(false),
+     m_keyframeFrame(0),
+     m_sinceKeyframe(0)
+{
+}
+
+NESRewindBuffer::~NESRewindBuffer()
+{
+   delete [] m_arena;
+   delete [] m_state;
+   delete [] m_keyframe;
+   delete [] m_reference;
+   delete [] m_zero;
+   delete [] m_encoded;
+}
+
+void NESRewindBuffer::configure ( uint32_t budget, int32_t snapshotInterval, int32_t keyframeInterval )
+{
+   delete [] m_arena;
+   m_arena = NULL;
+   m_size = budget;
+   if ( m_size )
+   {
+      m_arena = new uint8_t [ m_size ];
+   }
+   m_snapshotInterval = (snapshotInterval<1)?1:snapshotInterval;
+   m_keyframeInterval = (keyframeInterval<1)?1:keyframeInterval;
+
+   clear();
+}
+
+void NESRewindBuffer::clear ()
+{
+   m_records.clear();
+   m_breakpoints.clear();
+   m_tail = 0;
+   m_keyframeValid = false;
+}
+
+uint32_t NESRewindBuffer::bytesUsed () const
+{
+   uint32_t used = 0;
+   int32_t  idx;
+
+   for ( idx = 0; idx < m_records.count(); idx++ )
+   {
+      used += m_records.at(idx).size;
+   }
+   return used;
+}
+
+uint32_t* NESRewindBuffer::inputs ( const RewindRecord& record ) const
+{
+   return (uint32_t*)(m_arena+record.offset);
+}
+
+void NESRewindBuffer::recordInput ( uint32_t frame, const uint32_t* joy )
+{
+   uint32_t slot;
+
+   if ( m_records.isEmpty() )
+   {
+      return;
+   }
+
+   RewindRecord& record = m_records.last();
+   slot = frame-record.frame-1;
+   if ( (frame > record.frame) &&
+        (slot < (uint32_t)m_snapshotInterval) &&
+        (slot <= record.numInputs) )
+   {
+      memcpy(inputs(record)+(slot*NUM_CONTROLLERS),joy,NUM_CONTROLLERS*sizeof(uint32_t));
+      record.numInputs = slot+1;
+   }
+}
+
+void NESRewindBuffer::frameCompleted ( uint32_t frame )
+{
+   if ( !m_arena )
+   {
+      return;
+   }
+
+   // Frames only go backwards if the emulator was reset behind our back.
+   if ( (!m_records.isEmpty()) && (frame < m_records.last().frame) )
+   {
+      clear();
+   }
+
+   // Snapshots are taken at a fixed distance from the last one rather than
+   // on multiples of the interval so that history restarts cleanly after
+   // a rewind.
+   if ( m_records.isEmpty() ||
+        (frame-m_records.last().frame >= (uint32_t)m_snapshotInterval) )
+   {
+      if ( !capture(frame) )
+      {
+         clear();
+      }
+   }
+}
+
+void NESRewindBuffer::breakpointHit ( uint32_t frame, uint32_t cycle )
+{
+   RewindBreakpointHit hit;
+
+   if ( m_records.isEmpty() )
+   {
+      return;
+   }
+
+   hit.frame = frame;
+   hit.cycle = cycle;
+   m_breakpoints.append(hit);
+}
+
+bool NESRewindBuffer::capture ( uint32_t frame )
+{
+   RewindRecord record;
+   uint32_t     size;
+   uint32_t     reserve;
+   bool         keyframe;
+
+   size = nesSaveState(m_state,m_stateSize);
+   if ( size == 0 )
+   {
+      return false;
+   }
+   if ( size != m_stateSize )
+   {
+      // First snapshot, or a different cartridge.  The state size never
+      // changes for a given cartridge.
+      delete [] m_state;
+      delete [] m_keyframe;
+      delete [] m_reference;
+      delete [] m_zero;
+      delete [] m_encoded;
+      m_stateSize = size;
+      m_state = new uint8_t [ m_stateSize ];
+      m_keyframe = new uint8_t [ m_stateSize ];
+      m_reference = new uint8_t [ m_stateSize ];
+      m_zero = new uint8_t [ m_stateSize ];
+      m_encoded = new uint8_t [ ENCODED_SIZE(m_stateSize) ];
+      memset(m_zero,0,m_stateSize);
+      clear();
+      if ( nesSaveState(m_state,m_stateSize) != m_stateSize )
+      {
+         return false;
+      }
+   }
+
+   reserve = m_snapshotInterval*NUM_CONTROLLERS*sizeof(uint32_t);
+   keyframe = (!m_keyframeValid) || (m_sinceKeyframe >= m_keyframeInterval);
+   size = encodeState(m_state,keyframe?m_zero:m_keyframe,m_stateSize,m_encoded);
+   if ( !allocate(ALIGNED(reserve+size),&record.offset) )
+   {
+      return false;
+   }
+   if ( (!keyframe) && (!m_keyframeValid) )
+   {
+      // Making room discarded the keyframe this snapshot was encoded
+      // against, so it has to become a keyframe itself.
+      keyframe = true;
+      size = encodeState(m_state,m_zero,m_stateSize,m_encoded);
+      if ( !allocate(ALIGNED(reserve+size),&record.offset) )
+      {
+         return false;
+      }
+   }
+   memcpy(m_arena+record.offset+reserve,m_encoded,size);
+
+   record.frame = frame;
+   record.size = ALIGNED(reserve+size);
+   record.numInputs = 0;
+   record.keyframe = keyframe;
+   m_records.append(record);
+
+   if ( keyframe )
+   {
+      memcpy(m_keyframe,m_state,m_stateSize);
+      m_keyframeValid = true;
+      m_keyframeFrame = frame;
+      m_sinceKeyframe = 0;
+   }
+   m_sinceKeyframe++;
+
+   return true;
+}
+
+bool NESRewindBuffer::allocate ( uint32_t size, uint32_t* offset )
+{
+   uint32_t pos;
+
+   if ( size > m_size )
+   {
+      return false;
+   }
+
+   pos = m_records.isEmpty()?0:m_tail;
+   if ( pos+size > m_size )
+   {
+      // Wrap.  Anything stored past the tail is older than anything at the
+      // start of the arena.
+      while ( (!m_records.isEmpty()) && (m_records.first().offset >= pos) )
+      {
+         evictOldest();
+      }
+      pos = 0;
+   }
+   while ( (!m_records.isEmpty()) &&
+           (m_records.first().offset < pos+size) &&
+           (m_records.first().offset+m_records.first().size > pos) )
+   {
+      evictOldest();
+   }
+
+   (*offset) = pos;
+   m_tail = pos+size;
+   return true;
+}
+
+void NESRewindBuffer::evictOldest ()
+{
+   // A keyframe goes together with the snapshots encoded against it.
+   do
+   {
+      if ( m_records.first().keyframe &&
+           (m_records.first().frame == m_keyframeFrame) )
+      {
+         m_keyframeValid = false;
+      }
+      m_records.removeFirst();
+   } while ( (!m_records.isEmpty()) && (!m_records.first().keyframe) );
+
+   while ( (!m_breakpoints.isEmpty()) &&
+           (m_records.isEmpty() || (m_breakpoints.first().frame <= m_records.first().frame)) )
+   {
+      m_breakpoints.removeFirst();
+   }
+}
+
+void NESRewindBuffer::decode ( int32_t record, uint8_t* state )
+{
+   int32_t key = record;
+
+   while ( !m_records.at(key).keyframe )
+   {
+      key--;
+   }
+
+   const RewindRecord& keyframe = m_records.at(key);
+   const uint32_t reserve = m_snapshotInterval*NUM_CONTROLLERS*sizeof(uint32_t);
+
+   if ( key == record )
+   {
+      decodeState(m_arena+keyframe.offset+reserve,m_zero,m_stateSize,state);
+   }
+   else
+   {
+      decodeState(m_arena+keyframe.offset+reserve,m_zero,m_stateSize,m_reference);
+      decodeState(m_arena+m_records.at(record).offset+reserve,m_reference,m_stateSize,state);
+   }
+}
+
+int32_t NESRewindBuffer::find ( uint32_t frame ) const
+{
+   int32_t idx;
+
+   for ( idx = m_records.count()-1; idx >= 0; idx-- )
+   {
+      const RewindRecord& record = m_records.at(idx);
+
+      if ( (record.frame <= frame) &&
+           (frame-record.frame <= record.numInputs) )
+      {
+         return idx;
+      }
+      if ( record.frame < frame )
+      {
+         // Older snapshots cannot reach the frame either.
+         break;
+      }
+   }
+   return -1;
+}
+
+bool NESRewindBuffer::canRestore ( uint32_t frame ) const
+{
+   return find(frame) >= 0;
+}
+
+bool NESRewindBuffer::restore ( uint32_t frame, uint32_t* snapshotFrame )
+{
+   int32_t idx = find(frame);
+
+   if ( idx < 0 )
+   {
+      return false;
+   }
+
+   decode(idx,m_state);
+   if ( !nesLoadState(m_state,m_stateSize) )
+   {
+      return false;
+   }
+   (*snapshotFrame) = m_records.at(idx).frame;
+   return true;
+}
+
+bool NESRewindBuffer::input ( uint32_t frame, uint32_t* joy ) const
+{
+   int32_t idx;
+   uint32_t slot;
+
+   for ( idx = m_records.count()-1; idx >= 0; idx-- )
+   {
+      const RewindRecord& record = m_records.at(idx);
+
+      if ( record.frame < frame )
+      {
+         slot = frame-record.frame-1;
+         if ( slot < record.numInputs )
+         {
+            memcpy(joy,inputs(record)+(slot*NUM_CONTROLLERS),NUM_CONTROLLERS*sizeof(uint32_t));
+            return true;
+         }
+         break;
+      }
+   }
+   return false;
+}
+
+bool NESRewindBuffer::previousBreakpoint ( uint32_t frame, uint32_t cycle, uint32_t* hitFrame, uint32_t* hitCycle ) const
+{
+   int32_t idx;
+
+   for ( idx = m_breakpoints.count()-1; idx >= 0; idx-- )
+   {
+      const RewindBreakpointHit& hit = m_breakpoints.at(idx);
+
+      if ( (hit.frame < frame) ||
+           ((hit.frame == frame) && (hit.cycle < cycle)) )
+      {
+         (*hitFrame) = hit.frame;
+         (*hitCycle) = hit.cycle;
+         return true;
+      }
+   }
+   return false;
+}
+
+void NESRewindBuffer::truncate ( uint32_t frame )
+{
+   int32_t idx;
+
+   while ( (!m_records.isEmpty()) && (m_records.last().frame > frame) )
+   {
+      m_records.removeLast();
+   }
+   while ( (!m_breakpoints.isEmpty()) && (m_breakpoints.last().frame > frame) )
+   {
+      m_breakpoints.removeLast();
+   }
+
+   if ( m_records.isEmpty() )
+   {
+      clear();
+      return;
+   }
+
+   RewindRecord& last = m_records.last();
+   if ( last.numInputs > frame-last.frame )
+   {
+      last.numInputs = frame-last.frame;
+   }
+   m_tail = last.offset+last.size;
+
+   // Carry on encoding against the newest surviving keyframe.
+   for ( idx = m_records.count()-1; !m_records.at(idx).keyframe; idx-- )
+      ;
+   if ( m_records.at(idx).frame != m_keyframeFrame )
+   {
+      decode(idx,m_keyframe);
+      m_keyframeFrame = m_records.at(idx).frame;
+   }
+   m_keyframeValid = true;
+   m_sinceKeyframe = m_records.count()-idx;
+}
+
+void NESRewindBuffer::forgetBreakpoints ( uint32_t frame, uint32_t cycle )
+{
+   while ( (!m_breakpoints.isEmpty()) &&
+           ((m_breakpoints.last().frame > frame) ||
+           ((m_breakpoints.last().frame == frame) && (m_breakpoints.last().cycle >= cycle))) )
+   {
+      m_breakpoints.removeLast();
+   }
+}
@@ -0,0 +1,113 @@
+#ifndef NESREWINDBUFFER_H
+#define NESREWINDBUFFER_H
+
+#include <QList>
+
+#include <stdint.h>
+
+#include "nes_emulator_core.h"
+
+// The rewind buffer keeps a history of emulator save states so that the
+// debugger can step backwards.  A snapshot is taken every few frames and
+// stored in a fixed-size arena.  Every so often a snapshot is stored as a
+// keyframe; the snapshots in between are stored as the XOR of the state
+// against that keyframe, run-length encoded, which is usually a few
+// hundred bytes since most of a state does not change from frame to frame.
+// When the arena fills up the oldest keyframe and the snapshots that
+// depend on it are discarded.
+//
+// Frames are numbered as nesGetPPUFrame numbers them.  The snapshot for
+// frame N is the state after frame N has been run.  Each snapshot also
+// holds the controller input for the frames run after it, so that any
+// frame between two snapshots can be reached by restoring the earlier
+// one and running forward.
+typedef struct
+{
+   uint32_t frame;
+   uint32_t offset;
+   uint32_t size;
+   uint32_t numInputs;
+   bool     keyframe;
+} RewindRecord;
+
+typedef struct
+{
+   uint32_t frame;
+   uint32_t cycle;
+} RewindBreakpointHit;
+
+class NESRewindBuffer
+{
+public:
+   NESRewindBuffer();
+   virtual ~NESRewindBuffer();
+
+   // Sets the size of the arena in bytes, the number of frames between
+   // snapshots, and the number of snapshots stored against each keyframe.
+   // Any history is discarded.  A budget of 0 disables rewind.
+   void configure ( uint32_t budget, int32_t snapshotInterval, int32_t keyframeInterval );
+   uint32_t budget() const { return m_size; }
+   int32_t snapshotInterval() const { return m_snapshotInterval; }
+   int32_t keyframeInterval() const { return m_keyframeInterval; }
+
+   void clear ();
+   bool isEmpty () const { return m_records.isEmpty(); }
+   uint32_t oldestFrame () const { return m_records.isEmpty()?0:m_records.first().frame; }
+   uint32_t bytesUsed () const;
+
+   // Recording.  recordInput is called with the input for a frame before it
+   // is run and frameCompleted after it has been run; a snapshot is taken
+   // if one is due.  breakpointHit remembers where a breakpoint stopped
+   // the emulator.
+   void recordInput ( uint32_t frame, const uint32_t* joy );
+   void frameCompleted ( uint32_t frame );
+   void breakpointHit ( uint32_t frame, uint32_t cycle );
+
+   // Playback.  restore loads the newest snapshot from which frame can be
+   // reached and returns the frame it was taken at; the caller then runs
+   // forward to frame using the recorded input.
+   bool canRestore ( uint32_t frame ) const;
+   bool restore ( uint32_t frame, uint32_t* snapshotFrame );
+   bool input ( uint32_t frame, uint32_t* joy ) const;
+
+   // Finds the newest breakpoint hit before the given position.
+   bool previousBreakpoint ( uint32_t frame, uint32_t cycle, uint32_t* hitFrame, uint32_t* hitCycle ) const;
+
+   // After a rewind the recorded future is no longer valid.  truncate
+   // discards snapshots taken after frame and breakpoint hits in later
+   // frames; forgetBreakpoints discards hits at or after a position.
+   void truncate ( uint32_t frame );
+   void forgetBreakpoints ( uint32_t frame, uint32_t cycle );
+
+protected:
+   bool capture ( uint32_t frame );
+   int32_t find ( uint32_t frame ) const;
+   bool allocate ( uint32_t size, uint32_t* offset );
+   void evictOldest ();
+   void decode ( int32_t record, uint8_t* state );
+   uint32_t* inputs ( const RewindRecord& record ) const;
+
+   // Arena.
+   uint8_t*  m_arena;
+   uint32_t  m_size;
+   uint32_t  m_tail;
+   QList<RewindRecord> m_records;
+   QList<RewindBreakpointHit> m_breakpoints;
+
+   int32_t   m_snapshotInterval;
+   int32_t   m_keyframeInterval;
+
+   // Working buffers, each the size of a save state.  m_keyframe holds the
+   // most recent keyframe so that new snapshots can be encoded against it.
+   uint32_t  m_stateSize;
+   uint8_t*  m_state;
+   uint8_t*  m_keyframe;
+   uint8_t*  m_reference;
+   uint8_t*  m_zero;
+   uint8_t*  m_encoded;
+   bool      m_keyframeValid;
+   uint32_t  m_keyframeFrame;
+   int32_t   m_sinceKeyframe;
+};
+
+#endif // NESREWINDBUFFER_H
@@ -13,6 +13,7 @@ CGraphicsBank::CGraphicsBank(IProjectTreeViewItem* parent)
    // Allocate attributes
    m_bankItems.clear();
    m_bankSize = MEM_8KB;
+   m_tilification = Tilify_None;
 }
 
 CGraphicsBank::~CGraphicsBank()
@@ -29,12 +30,18 @@ uint32_t CGraphicsBank::getSize()
    return m_bankSize;
 }
 
+int CGraphicsBank::getTilification()
+{
+   return m_tilification;
+}
+
 bool CGraphicsBank::serialize(QDomDocument& doc, QDomNode& node)
 {
    QDomElement element = addElement( doc, node, "graphicsbank" );
    element.setAttribute("name", m_name);
    element.setAttribute("uuid", uuid());
    element.setAttribute("size", m_bankSize);
+   element.setAttribute("tilify", m_tilification);
 
    if ( m_editor && m_editor->isModified() )
    {
@@ -99,6 +106,9 @@ bool CGraphicsBank::deserialize(QDomDocument& /*doc*/, QDomNode& node, QString&
    // Default size is 8KB
    m_bankSize = element.attribute("size","8192").toInt();
 
+   // Default is to keep every tile
+   m_tilification = element.attribute("tilify","0").toInt();
+
    m_name = element.attribute("name");
 
    setUuid(element.attribute("uuid"));
@@ -188,7 +198,7 @@ void CGraphicsBank::openItemEvent(CProjectTabWidget* tabWidget)
    }
    else
    {
-      m_editor = new GraphicsBankEditorForm(m_bankSize,m_bankItems,this);
+      m_editor = new GraphicsBankEditorForm(m_bankSize,m_tilification,m_bankItems,this);
       tabWidget->addTab(m_editor, this->caption());
       tabWidget->setCurrentWidget(m_editor);
    }
@@ -198,6 +208,7 @@ void CGraphicsBank::saveItemEvent()
 {
    m_bankItems = editor()->bankItems();
    m_bankSize = editor()->bankSize();
+   m_tilification = editor()->tilification();
 
    if ( m_editor )
    {
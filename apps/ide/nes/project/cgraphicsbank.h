@@ -17,6 +17,7 @@ public:
    // Member getters
    QList<IChrRomBankItem*> getGraphics();
    uint32_t getSize();
+   int getTilification();
 
    GraphicsBankEditorForm* editor() { return dynamic_cast<GraphicsBankEditorForm*>(m_editor); }
    void exportAsPNG();
@@ -39,6 +40,7 @@ private:
    // Attributes
    QList<IChrRomBankItem*> m_bankItems;
    uint32_t m_bankSize;
+   int m_tilification;
 };
 
 #endif // CGRAPHICSBANK_H
@@ -4,7 +4,8 @@
 QT += network \
       opengl \
       xml \
-      widgets
+      widgets \
+      concurrent
 
 greaterThan(QT_MAJOR_VERSION,5) {
     QT += core5compat
@@ -298,6 +299,7 @@ SOURCES += \
    common/sourcenavigator.cpp \
    nes/common/tilificationthread.cpp \
    compilers/cc65/ccc65interface.cpp \
+   compilers/cc65/ccc65objectcache.cpp \
    compilers/cc65/dbginfo.c \
    nes/compilers/ccartridgebuilder.cpp \
    nes/compilers/cgraphicsassembler.cpp \
@@ -311,6 +313,7 @@ SOURCES += \
    debuggers/ccodebrowserdisplaymodel.cpp \
    debuggers/cdebuggerbase.cpp \
    debuggers/cdebuggercodeprofilermodel.cpp \
+   debuggers/cdebuggercodeprofilertreemodel.cpp \
    debuggers/cdebuggerexecutiontracermodel.cpp \
    debuggers/cdebuggermemorydisplaymodel.cpp \
    debuggers/cdebuggernumericitemdelegate.cpp \
@@ -358,6 +361,7 @@ SOURCES += \
    nes/emulator/nesemulatordockwidget.cpp \
    nes/emulator/nesemulatorrenderer.cpp \
    nes/emulator/nesemulatorthread.cpp \
+   nes/emulator/nesrewindbuffer.cpp \
    $$TOP/common/emulatorprefsdialog.cpp \
    c64/emulator/c64emulatorthread.cpp \
    environmentsettingsdialog.cpp \
@@ -448,6 +452,7 @@ HEADERS += \
    common/sourcenavigator.h \
    nes/common/tilificationthread.h \
    compilers/cc65/ccc65interface.h \
+   compilers/cc65/ccc65objectcache.h \
    compilers/cc65/dbginfo.h \
    nes/compilers/ccartridgebuilder.h \
    nes/compilers/cgraphicsassembler.h \
@@ -461,6 +466,7 @@ HEADERS += \
    debuggers/ccodebrowserdisplaymodel.h \
    debuggers/cdebuggerbase.h \
    debuggers/cdebuggercodeprofilermodel.h \
+   debuggers/cdebuggercodeprofilertreemodel.h \
    debuggers/cdebuggerexecutiontracermodel.h \
    debuggers/cdebuggermemorydisplaymodel.h \
    debuggers/cdebuggernumericitemdelegate.h \
@@ -508,6 +514,7 @@ HEADERS += \
    nes/emulator/nesemulatordockwidget.h \
    nes/emulator/nesemulatorrenderer.h \
    nes/emulator/nesemulatorthread.h \
+   nes/emulator/nesrewindbuffer.h \
    c64/emulator/c64emulatorthread.h \
    $$TOP/common/emulatorprefsdialog.h \
    environmentsettingsdialog.h \
@@ -763,6 +763,10 @@ bool CNesicideProject::createProjectFromRom(QString fileName,bool silent)
       {
          str = "&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;SHA1: ";
          str += CGameDatabaseHandler::instance()->getSHA1();
+         if ( CGameDatabaseHandler::instance()->isPartialMatch() )
+         {
+            str += " (PRG matches, CHR does not)";
+         }
          generalTextLogger->write(str);
 
          str = "&nbsp;&nbsp;&nbsp;&nbsp;&nbsp;Name: ";
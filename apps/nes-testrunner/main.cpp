@@ -0,0 +1,177 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThread>
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "testsuiterunner.h"
+
+// With --benchmark the positional argument is a ROM instead of a test
+// suite.  It is run headless a few times and the frames per second are
+// reported so that changes to the emulator core can be measured.
+static int benchmark ( QString romPath, QString system, int frames, int repeats )
+{
+   TestSuiteWorker worker(NULL,NULL,NULL,false);
+   QList<double> fps;
+   QString errors;
+   uint32_t mode = MODE_NTSC;
+   double seconds;
+   int repeat;
+
+   if ( system == "pal" )
+   {
+      mode = MODE_PAL;
+   }
+   else if ( system == "dendy" )
+   {
+      mode = MODE_DENDY;
+   }
+
+   for ( repeat = 0; repeat < repeats; repeat++ )
+   {
+      seconds = worker.benchmark(romPath,mode,frames,&errors);
+      if ( seconds < 0.0 )
+      {
+         fprintf(stderr,"%s\n",errors.toLocal8Bit().constData());
+         return 2;
+      }
+      fps.append(frames/seconds);
+      printf("run %d: %d frames in %.3fs, %.1f fps\n",repeat+1,frames,seconds,frames/seconds);
+      fflush(stdout);
+   }
+
+   std::sort(fps.begin(),fps.end());
+   printf("%s: best %.1f fps, median %.1f fps\n",
+          romPath.toLocal8Bit().constData(),
+          fps.last(),
+          fps.at(fps.count()/2));
+   return 0;
+}
+
+// With --trace the positional argument is a ROM.  It is run headless with
+// the execution tracer on and the trace is written to a file, so that runs
+// of different builds of a ROM can be compared with nes-tracequery.
+static int trace ( QString romPath, QString system, int frames, QString traceFile )
+{
+   TestSuiteWorker worker(NULL,NULL,NULL,false);
+   QString errors;
+   uint32_t mode = MODE_NTSC;
+
+   if ( system == "pal" )
+   {
+      mode = MODE_PAL;
+   }
+   else if ( system == "dendy" )
+   {
+      mode = MODE_DENDY;
+   }
+
+   if ( !worker.trace(romPath,mode,frames,traceFile,&errors) )
+   {
+      fprintf(stderr,"%s\n",errors.toLocal8Bit().constData());
+      return 2;
+   }
+   return 0;
+}
+
+// Runs a test suite saved by the IDE's Test Suite Executive without any
+// user interface.  Each test ROM is run for its recorded number of frames
+// with its recorded input and the final TV image is compared against the
+// SHA1 stored in the suite.  Tests are spread across a pool of workers,
+// each with its own emulated NES.
+int main(int argc, char* argv[])
+{
+   QCoreApplication app(argc, argv);
+   QCommandLineParser parser;
+   TestSuite testSuite;
+   QString errors;
+   int numWorkers;
+
+   QCoreApplication::setOrganizationName("CSPSoftware");
+   QCoreApplication::setOrganizationDomain("nesicide.com");
+   QCoreApplication::setApplicationName("nes-testrunner");
+
+   parser.setApplicationDescription("Runs a NESICIDE test suite without a user interface.");
+   parser.addHelpOption();
+   parser.addPositionalArgument("testsuite","Test suite XML file saved by the Test Suite Executive.");
+   QCommandLineOption jobsOption(QStringList() << "j" << "jobs","Number of tests to run at once (default: number of cores).","count");
+   QCommandLineOption junitOption("junit","Write JUnit XML results to <file>.","file");
+   QCommandLineOption csvOption("csv","Write CSV results to <file>.","file");
+   QCommandLineOption verboseOption(QStringList() << "v" << "verbose","Report every test, not just the ones that do not pass.");
+   QCommandLineOption benchmarkOption("benchmark","Time the emulator running the ROM given instead of a test suite.");
+   QCommandLineOption traceOption("trace","Write an execution trace of the ROM given instead of a test suite to <file>.","file");
+   QCommandLineOption framesOption("frames","Number of frames to run for --benchmark or --trace (default: 600).","count","600");
+   QCommandLineOption repeatOption("repeat","Number of times to run for --benchmark (default: 5).","count","5");
+   QCommandLineOption systemOption("system","System for --benchmark or --trace: ntsc, pal or dendy (default: ntsc).","system","ntsc");
+   parser.addOption(jobsOption);
+   parser.addOption(junitOption);
+   parser.addOption(csvOption);
+   parser.addOption(verboseOption);
+   parser.addOption(benchmarkOption);
+   parser.addOption(traceOption);
+   parser.addOption(framesOption);
+   parser.addOption(repeatOption);
+   parser.addOption(systemOption);
+   parser.process(app);
+
+   if ( parser.positionalArguments().count() != 1 )
+   {
+      parser.showHelp(1);
+   }
+
+   if ( parser.isSet(benchmarkOption) )
+   {
+      return benchmark(parser.positionalArguments().at(0),
+                       parser.value(systemOption),
+                       qMax(parser.value(framesOption).toInt(),1),
+                       qMax(parser.value(repeatOption).toInt(),1));
+   }
+
+   if ( parser.isSet(traceOption) )
+   {
+      return trace(parser.positionalArguments().at(0),
+                   parser.value(systemOption),
+                   qMax(parser.value(framesOption).toInt(),1),
+                   parser.value(traceOption));
+   }
+
+   numWorkers = QThread::idealThreadCount();
+   if ( parser.isSet(jobsOption) )
+   {
+      numWorkers = parser.value(jobsOption).toInt();
+   }
+
+   if ( !testSuite.load(parser.positionalArguments().at(0),&errors) )
+   {
+      fprintf(stderr,"%s\n",errors.toLocal8Bit().constData());
+      return 2;
+   }
+
+   testSuite.run(numWorkers,parser.isSet(verboseOption));
+
+   printf("%d tests: %d passed, %d failed, %d errors, %d skipped in %.3fs\n",
+          testSuite.tests().count(),
+          testSuite.count(TestSuiteEntry::Passed),
+          testSuite.count(TestSuiteEntry::Failed),
+          testSuite.count(TestSuiteEntry::Errored),
+          testSuite.count(TestSuiteEntry::Skipped),
+          testSuite.wallTime());
+
+   if ( parser.isSet(junitOption) && !testSuite.writeJUnit(parser.value(junitOption)) )
+   {
+      fprintf(stderr,"Cannot write %s\n",parser.value(junitOption).toLocal8Bit().constData());
+      return 2;
+   }
+   if ( parser.isSet(csvOption) && !testSuite.writeCSV(parser.value(csvOption)) )
+   {
+      fprintf(stderr,"Cannot write %s\n",parser.value(csvOption).toLocal8Bit().constData());
+      return 2;
+   }
+
+   if ( testSuite.count(TestSuiteEntry::Failed) || testSuite.count(TestSuiteEntry::Errored) )
+   {
+      return 1;
+   }
+   return 0;
+}
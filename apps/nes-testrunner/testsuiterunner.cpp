@@ -0,0 +1,529 @@
+#include <QDomDocument>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QMutexLocker>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "testsuiterunner.h"
+
+#include "cjoypadlogger.h"
+
+QMutex TestSuiteWorker::m_outputMutex;
+
+static const char* outcomeName ( int outcome )
+{
+   switch ( outcome )
+   {
+   case TestSuiteEntry::Passed:
+      return "pass";
+   case TestSuiteEntry::Failed:
+      return "fail";
+   case TestSuiteEntry::Skipped:
+      return "skipped";
+   case TestSuiteEntry::Errored:
+      return "error";
+   default:
+      return "none";
+   }
+}
+
+static QString csvField ( QString field )
+{
+   if ( field.contains(',') || field.contains('"') || field.contains('\n') )
+   {
+      field.replace("\"","\"\"");
+      field = "\""+field+"\"";
+   }
+   return field;
+}
+
+TestSuite::TestSuite()
+{
+   m_wallTime = 0.0;
+}
+
+bool TestSuite::load(QString testSuiteFileName, QString* errors)
+{
+   QFileInfo    testSuiteFileInfo(testSuiteFileName);
+   QDir         testSuiteFolder = testSuiteFileInfo.absoluteDir();
+   QFile        testSuiteFile(testSuiteFileName);
+   QDomDocument testSuiteDoc;
+   QDomElement  testSuiteElement;
+   QDomNode     testNode;
+   QDomElement  testElement;
+   QString      errorMsg;
+   int          errorLine;
+
+   m_tests.clear();
+   m_name = testSuiteFileInfo.completeBaseName();
+
+   if ( !testSuiteFile.open(QIODevice::ReadOnly|QIODevice::Text) )
+   {
+      (*errors) = "Cannot open "+testSuiteFileName;
+      return false;
+   }
+   if ( !testSuiteDoc.setContent(&testSuiteFile,&errorMsg,&errorLine) )
+   {
+      (*errors) = testSuiteFileName+":"+QString::number(errorLine)+": "+errorMsg;
+      testSuiteFile.close();
+      return false;
+   }
+   testSuiteFile.close();
+
+   // Same layout as TestSuiteExecutiveDialog::loadTestSuite.
+   testSuiteElement = testSuiteDoc.documentElement();
+   testNode = testSuiteElement.firstChild();
+   while ( !testNode.isNull() )
+   {
+      TestSuiteEntry test;
+
+      testElement = testNode.toElement();
+      test.fileName = QDir::fromNativeSeparators(testElement.attribute("filename"));
+      test.romPath = testSuiteFolder.absoluteFilePath(test.fileName);
+      test.frames = testElement.attribute("runframes").toInt();
+      test.system = testElement.attribute("system");
+      test.lastResult = testElement.attribute("testresult");
+      test.failComment = testElement.attribute("failcomment");
+      test.notes = testElement.attribute("testnotes");
+
+      QDomNode childNode = testElement.firstChild();
+      while ( !childNode.isNull() )
+      {
+         QDomElement childElement = childNode.toElement();
+         if ( childElement.nodeName() == "tvsha1" )
+         {
+            test.tvSha1 = childElement.firstChild().toCDATASection().data();
+         }
+         else if ( childElement.nodeName() == "recordedinput" )
+         {
+            test.recordedInput = QByteArray::fromBase64(childElement.firstChild().toCDATASection().data().toLatin1());
+         }
+         childNode = childNode.nextSibling();
+      }
+
+      test.outcome = TestSuiteEntry::NotRun;
+      test.wallTime = 0.0;
+
+      m_tests.append(test);
+
+      testNode = testNode.nextSibling();
+   }
+
+   return true;
+}
+
+void TestSuite::run(int numWorkers, bool verbose)
+{
+   QThreadPool   pool;
+   QElapsedTimer timer;
+   QAtomicInt    next(0);
+   QList<int>    order;
+   int           test;
+   int           worker;
+
+   // Hand out the longest tests first so that a long test picked up
+   // late does not leave the rest of the pool idle at the end.
+   for ( test = 0; test < m_tests.count(); test++ )
+   {
+      int pos = 0;
+      while ( (pos < order.count()) && (m_tests.at(order.at(pos)).frames >= m_tests.at(test).frames) )
+      {
+         pos++;
+      }
+      order.insert(pos,test);
+   }
+
+   if ( numWorkers > m_tests.count() )
+   {
+      numWorkers = m_tests.count();
+   }
+   if ( numWorkers < 1 )
+   {
+      numWorkers = 1;
+   }
+   pool.setMaxThreadCount(numWorkers);
+
+   timer.start();
+   for ( worker = 0; worker < numWorkers; worker++ )
+   {
+      pool.start(new TestSuiteWorker(&m_tests,&order,&next,verbose));
+   }
+   pool.waitForDone();
+   m_wallTime = timer.elapsed()/1000.0;
+}
+
+int TestSuite::count(int outcome) const
+{
+   int num = 0;
+
+   foreach ( const TestSuiteEntry& test, m_tests )
+   {
+      if ( test.outcome == outcome )
+      {
+         num++;
+      }
+   }
+   return num;
+}
+
+bool TestSuite::writeJUnit(QString fileName)
+{
+   QFile        file(fileName);
+   QDomDocument doc;
+   QDomElement  suitesElement;
+   QDomElement  suiteElement;
+   QDomElement  caseElement;
+   QDomElement  resultElement;
+   double       testTime = 0.0;
+
+   if ( !file.open(QIODevice::WriteOnly|QIODevice::Text|QIODevice::Truncate) )
+   {
+      return false;
+   }
+
+   foreach ( const TestSuiteEntry& test, m_tests )
+   {
+      testTime += test.wallTime;
+   }
+
+   doc.appendChild(doc.createProcessingInstruction("xml","version='1.0' encoding='UTF-8'"));
+   suitesElement = doc.createElement("testsuites");
+   doc.appendChild(suitesElement);
+   suiteElement = doc.createElement("testsuite");
+   suiteElement.setAttribute("name",m_name);
+   suiteElement.setAttribute("tests",m_tests.count());
+   suiteElement.setAttribute("failures",count(TestSuiteEntry::Failed));
+   suiteElement.setAttribute("errors",count(TestSuiteEntry::Errored));
+   suiteElement.setAttribute("skipped",count(TestSuiteEntry::Skipped));
+   suiteElement.setAttribute("time",QString::number(testTime,'f',3));
+   suitesElement.appendChild(suiteElement);
+
+   foreach ( const TestSuiteEntry& test, m_tests )
+   {
+      caseElement = doc.createElement("testcase");
+      caseElement.setAttribute("classname",m_name);
+      caseElement.setAttribute("name",test.fileName);
+      caseElement.setAttribute("time",QString::number(test.wallTime,'f',3));
+
+      if ( test.outcome == TestSuiteEntry::Failed )
+      {
+         resultElement = doc.createElement("failure");
+         resultElement.setAttribute("message",test.message);
+         caseElement.appendChild(resultElement);
+      }
+      else if ( test.outcome == TestSuiteEntry::Errored )
+      {
+         resultElement = doc.createElement("error");
+         resultElement.setAttribute("message",test.message);
+         caseElement.appendChild(resultElement);
+      }
+      else if ( test.outcome == TestSuiteEntry::Skipped )
+      {
+         resultElement = doc.createElement("skipped");
+         resultElement.setAttribute("message",test.message);
+         caseElement.appendChild(resultElement);
+      }
+
+      suiteElement.appendChild(caseElement);
+   }
+
+   file.write(doc.toByteArray());
+   file.close();
+
+   return true;
+}
+
+bool TestSuite::writeCSV(QString fileName)
+{
+   QFile file(fileName);
+
+   if ( !file.open(QIODevice::WriteOnly|QIODevice::Text|QIODevice::Truncate) )
+   {
+      return false;
+   }
+
+   QTextStream out(&file);
+
+   out << "File Name,# of Frames,System,Result,Last Result,Wall Time (s),TV SHA1,Expected TV SHA1,Message\n";
+   foreach ( const TestSuiteEntry& test, m_tests )
+   {
+      out << csvField(test.fileName) << ","
+          << test.frames << ","
+          << csvField(test.system) << ","
+          << outcomeName(test.outcome) << ","
+          << csvField(test.lastResult) << ","
+          << QString::number(test.wallTime,'f',3) << ","
+          << test.resultSha1 << ","
+          << test.tvSha1 << ","
+          << csvField(test.message) << "\n";
+   }
+   out.flush();
+   file.close();
+
+   return true;
+}
+
+TestSuiteWorker::TestSuiteWorker(QList<TestSuiteEntry>* tests, const QList<int>* order, QAtomicInt* next, bool verbose)
+{
+   m_tests = tests;
+   m_order = order;
+   m_next = next;
+   m_verbose = verbose;
+   m_machine = NULL;
+   m_tvIndexed = new int8_t[TV_SIZE_INDEXED];
+   m_tv = new int8_t[TV_SIZE_RGBA];
+}
+
+TestSuiteWorker::~TestSuiteWorker()
+{
+   delete [] m_tvIndexed;
+   delete [] m_tv;
+}
+
+void TestSuiteWorker::run()
+{
+   int idx;
+
+   // The machine is created on the worker's thread and lives only as
+   // long as the worker does.
+   m_machine = nesCreateMachine();
+   nesMachineSetTVOut(m_machine,m_tvIndexed);
+   nesMachineSetTVOutFormat(m_machine,TV_FORMAT_INDEXED);
+
+   while ( (idx = m_next->fetchAndAddOrdered(1)) < m_order->count() )
+   {
+      TestSuiteEntry* test = &((*m_tests)[m_order->at(idx)]);
+
+      runTest(test);
+
+      if ( m_verbose || (test->outcome != TestSuiteEntry::Passed) )
+      {
+         QMutexLocker locker(&m_outputMutex);
+         printf("%-7s %8.3fs  %s%s%s\n",
+                outcomeName(test->outcome),
+                test->wallTime,
+                test->fileName.toLocal8Bit().constData(),
+                test->message.isEmpty()?"":": ",
+                test->message.toLocal8Bit().constData());
+         fflush(stdout);
+      }
+   }
+
+   nesDestroyMachine(m_machine);
+   m_machine = NULL;
+}
+
+void TestSuiteWorker::runTest(TestSuiteEntry* test)
+{
+   QElapsedTimer timer;
+   QString       errors;
+   uint32_t      joy [ NUM_CONTROLLERS ] = { 0, 0 };
+   int           numInputSamples;
+   int           sample;
+   int           frame;
+
+   timer.start();
+
+   // Feed the recorded input back in, or run without input if none was recorded.
+   nesMachineResetInputRecording(m_machine);
+   numInputSamples = test->recordedInput.length()/sizeof(JoypadLoggerInfo);
+   for ( sample = 0; sample < numInputSamples; sample++ )
+   {
+      nesMachineSetInputSample(m_machine,0,((JoypadLoggerInfo*)test->recordedInput.constData())+sample);
+   }
+   nesMachineSetInputRecording(m_machine,false);
+   nesMachineSetInputPlayback(m_machine,numInputSamples>0);
+
+   if ( test->system == "ntsc" )
+   {
+      nesMachineSetSystemMode(m_machine,MODE_NTSC);
+   }
+   else
+   {
+      nesMachineSetSystemMode(m_machine,MODE_PAL);
+   }
+
+   if ( !loadCartridge(test->romPath,&errors) )
+   {
+      test->outcome = TestSuiteEntry::Errored;
+      test->message = errors;
+      test->wallTime = timer.elapsed()/1000.0;
+      return;
+   }
+
+   for ( frame = 0; frame < test->frames; frame++ )
+   {
+      nesMachineRun(m_machine,joy);
+
+      // Nobody is listening.
+      nesMachineClearAudioSamplesAvailable(m_machine);
+   }
+
+   // Hash the image the way the IDE's Test Suite Executive does.
+   nesConvertTVOut(m_tvIndexed,m_tv);
+   QCryptographicHash crypto(QCryptographicHash::Sha1);
+   crypto.addData((char*)m_tv,256*240*4);
+   test->resultSha1 = crypto.result().toBase64();
+
+   if ( test->tvSha1.isEmpty() )
+   {
+      test->outcome = TestSuiteEntry::Skipped;
+      test->message = "No TV SHA1 recorded";
+   }
+   else if ( test->resultSha1 == test->tvSha1 )
+   {
+      test->outcome = TestSuiteEntry::Passed;
+   }
+   else
+   {
+      test->outcome = TestSuiteEntry::Failed;
+      test->message = "TV SHA1 "+test->resultSha1+" does not match "+test->tvSha1;
+   }
+
+   test->wallTime = timer.elapsed()/1000.0;
+}
+
+double TestSuiteWorker::benchmark(QString romPath, uint32_t mode, int frames, QString* errors)
+{
+   QElapsedTimer timer;
+   uint32_t      joy [ NUM_CONTROLLERS ] = { 0, 0 };
+   int           frame;
+   double        seconds = -1.0;
+
+   m_machine = nesCreateMachine();
+   nesMachineSetTVOut(m_machine,m_tvIndexed);
+   nesMachineSetTVOutFormat(m_machine,TV_FORMAT_INDEXED);
+   nesMachineSetSystemMode(m_machine,mode);
+
+   if ( loadCartridge(romPath,errors) )
+   {
+      timer.start();
+      for ( frame = 0; frame < frames; frame++ )
+      {
+         nesMachineRun(m_machine,joy);
+         nesMachineClearAudioSamplesAvailable(m_machine);
+      }
+      seconds = timer.nsecsElapsed()/1000000000.0;
+   }
+
+   nesDestroyMachine(m_machine);
+   m_machine = NULL;
+
+   return seconds;
+}
+
+bool TestSuiteWorker::trace(QString romPath, uint32_t mode, int frames, QString traceFile, QString* errors)
+{
+   uint32_t      joy [ NUM_CONTROLLERS ] = { 0, 0 };
+   int           frame;
+   bool          ok = false;
+
+   m_machine = nesCreateMachine();
+   nesMachineSetTVOut(m_machine,m_tvIndexed);
+   nesMachineSetTVOutFormat(m_machine,TV_FORMAT_INDEXED);
+   nesMachineSetSystemMode(m_machine,mode);
+
+   // The tracer only records while debugging is enabled.
+   nesMachineEnableDebug(m_machine);
+
+   if ( loadCartridge(romPath,errors) )
+   {
+      if ( nesMachineStartTraceFile(m_machine,traceFile.toLocal8Bit().constData()) )
+      {
+         for ( frame = 0; frame < frames; frame++ )
+         {
+            nesMachineRun(m_machine,joy);
+            nesMachineClearAudioSamplesAvailable(m_machine);
+         }
+         ok = nesMachineStopTraceFile(m_machine);
+      }
+      if ( !ok )
+      {
+         (*errors) = "Cannot write "+traceFile;
+      }
+   }
+
+   nesDestroyMachine(m_machine);
+   m_machine = NULL;
+
+   return ok;
+}
+
+bool TestSuiteWorker::loadCartridge(QString fileName, QString* errors)
+{
+   QFile      fileIn(fileName);
+   QByteArray rom;
+   const uint8_t* header;
+   const uint8_t* data;
+   int        numPrgRomBanks;
+   int        numChrRomBanks;
+   int        bank;
+
+   if ( !fileIn.open(QIODevice::ReadOnly) )
+   {
+      (*errors) = "Cannot open "+fileName;
+      return false;
+   }
+   rom = fileIn.readAll();
+   fileIn.close();
+
+   header = (const uint8_t*)rom.constData();
+   if ( (rom.length() < 16) || memcmp(header,"NES\x1A",4) )
+   {
+      (*errors) = "Invalid ROM format";
+      return false;
+   }
+
+   // iNES header; see MainWindow::loadCartridge in the nes-emulator app.
+   numPrgRomBanks = header[4]<<1;
+   numChrRomBanks = header[5];
+   data = header+16;
+   if ( header[6]&FLAG_TRAINER )
+   {
+      data += 512;
+   }
+   if ( (data+((numPrgRomBanks+numChrRomBanks)*MEM_8KB)) > (header+rom.length()) )
+   {
+      (*errors) = "ROM image is truncated";
+      return false;
+   }
+
+   nesMachineFrontload(m_machine,((header[6]>>4)&0x0F)|(header[7]&0xF0));
+
+   for ( bank = 0; bank < numPrgRomBanks; bank++ )
+   {
+      nesMachineLoadPRGROMBank(m_machine,bank,(uint8_t*)data);
+      data += MEM_8KB;
+   }
+   for ( bank = 0; bank < numChrRomBanks; bank++ )
+   {
+      nesMachineLoadCHRROMBank(m_machine,bank,(uint8_t*)data);
+      data += MEM_8KB;
+   }
+
+   nesMachineFinalizeLoad(m_machine);
+
+   if ( (header[6]&FLAG_MIRROR) == FLAG_MIRROR_VERT )
+   {
+      nesMachineSetVerticalMirroring(m_machine);
+   }
+   else
+   {
+      nesMachineSetHorizontalMirroring(m_machine);
+   }
+   if ( header[6]&FLAG_FOURSCREEN_VRAM )
+   {
+      nesMachineSetFourScreen(m_machine);
+   }
+
+   nesMachineReset(m_machine,false);
+
+   return true;
+}
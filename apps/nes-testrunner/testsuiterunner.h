@@ -0,0 +1,106 @@
+#ifndef TESTSUITERUNNER_H
+#define TESTSUITERUNNER_H
+
+#include <QString>
+#include <QList>
+#include <QByteArray>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QMutex>
+
+#include "nes_emulator_core.h"
+
+// One test from a test suite XML file, as written by the IDE's
+// TestSuiteExecutiveDialog, along with the outcome of running it.
+struct TestSuiteEntry
+{
+   // Attributes from the test suite file.
+   QString    fileName;
+   QString    romPath;
+   int        frames;
+   QString    system;
+   QString    lastResult;
+   QString    failComment;
+   QString    notes;
+   QString    tvSha1;
+   QByteArray recordedInput;
+
+   // Outcome of the run.
+   enum
+   {
+      NotRun,
+      Passed,
+      Failed,
+      Skipped,
+      Errored
+   }          outcome;
+   QString    message;
+   QString    resultSha1;
+   double     wallTime;
+};
+
+class TestSuite
+{
+public:
+   TestSuite();
+
+   bool load ( QString fileName, QString* errors );
+
+   QList<TestSuiteEntry>& tests() { return m_tests; }
+   QString name() const { return m_name; }
+
+   // Runs the tests on a pool of workers, each with its own emulated NES.
+   void run ( int numWorkers, bool verbose );
+
+   int count ( int outcome ) const;
+   double wallTime() const { return m_wallTime; }
+
+   bool writeJUnit ( QString fileName );
+   bool writeCSV ( QString fileName );
+
+protected:
+   QList<TestSuiteEntry> m_tests;
+   QString m_name;
+   double m_wallTime;
+};
+
+// A worker owns one emulated NES and runs tests on it until the shared
+// queue of tests is exhausted.  Workers are handed to a QThreadPool.
+class TestSuiteWorker : public QRunnable
+{
+public:
+   TestSuiteWorker(QList<TestSuiteEntry>* tests, const QList<int>* order, QAtomicInt* next, bool verbose);
+   virtual ~TestSuiteWorker();
+
+   void run();
+
+   // Times nesMachineRun on one ROM with no input, for measuring the
+   // speed of the emulator core.  Returns the seconds taken to run the
+   // frames, not counting loading the ROM, or a negative number if the
+   // ROM cannot be loaded.
+   double benchmark ( QString romPath, uint32_t mode, int frames, QString* errors );
+
+   // Runs one ROM with no input and the execution tracer on, writing the
+   // trace to traceFile for nes-tracequery.
+   bool trace ( QString romPath, uint32_t mode, int frames, QString traceFile, QString* errors );
+
+protected:
+   void runTest ( TestSuiteEntry* test );
+   bool loadCartridge ( QString fileName, QString* errors );
+
+   NesMachine* m_machine;
+   // The machine draws into the indexed surface, which is turned into
+   // RGBA only when a test finishes and its image is hashed.
+   int8_t*     m_tvIndexed;
+   int8_t*     m_tv;
+
+   QList<TestSuiteEntry>* m_tests;
+   const QList<int>*      m_order;
+   QAtomicInt*            m_next;
+   bool                   m_verbose;
+
+   // Serializes progress output from the workers.
+   static QMutex m_outputMutex;
+};
+
+#endif // TESTSUITERUNNER_H
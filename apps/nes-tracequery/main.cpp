@@ -0,0 +1,349 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nes_emulator_core.h"
+#include "ctracefile.h"
+
+// Short names used both to print samples and to select them on the
+// command line, indexed by the eTracer_*, eNESSource_* and eTarget_*
+// enumerations.
+static const char* typeNames [] =
+{
+   "unknown", "fetch", "operand", "extrafetch", "stolen", "read", "write",
+   "dma", "reset", "nmi", "irq", "irqrelease", "garbage", "bkgnd", "sprite",
+   "ppuframestart", "sprite0", "vblankstart", "vblankend", "prerenderstart",
+   "prerenderend", "quietstart", "quietend", "ppuframeend", "apuframestart",
+   "sequencer", "apuframeend"
+};
+#define NUM_TYPES (int32_t)(sizeof(typeNames)/sizeof(typeNames[0]))
+
+static const char* sourceNames [] =
+{
+   "cpu", "ppu", "apu", "mapper"
+};
+#define NUM_SOURCES (int32_t)(sizeof(sourceNames)/sizeof(sourceNames[0]))
+
+static const char* targetNames [] =
+{
+   "unknown", "ram", "ppureg", "apureg", "ioreg", "sram", "exram", "mapper",
+   "pattern", "nametable", "attribute", "palette", "extracycle"
+};
+#define NUM_TARGETS (int32_t)(sizeof(targetNames)/sizeof(targetNames[0]))
+
+typedef struct
+{
+   uint32_t frameMin;
+   uint32_t frameMax;
+   uint32_t addrMin;
+   uint32_t addrMax;
+   uint32_t typeMask;
+   uint32_t sourceMask;
+   bool     countOnly;
+   bool     info;
+} TraceQuery;
+
+static const char* name ( const char** names, int32_t count, int32_t value )
+{
+   if ( (value >= 0) && (value < count) )
+   {
+      return names[value];
+   }
+   return "?";
+}
+
+static void usage ( void )
+{
+   int32_t idx;
+
+   fprintf(stderr,
+           "Usage: nes-tracequery [options] <tracefile>\n"
+           "Prints the samples of an execution trace file that match all of the\n"
+           "options given, one per line, oldest first.\n"
+           "\n"
+           "  --frames <first>[-<last>]  frame window\n"
+           "  --addr <lo>[-<hi>]         address range, in hex\n"
+           "  --source <name>[,<name>]   sources to include\n"
+           "  --type <name>[,<name>]     sample types to include\n"
+           "  --count                    print only the number of matching samples\n"
+           "  --info                     describe the file instead of querying it\n"
+           "\n"
+           "Sources:");
+   for ( idx = 0; idx < NUM_SOURCES; idx++ )
+   {
+      fprintf(stderr," %s",sourceNames[idx]);
+   }
+   fprintf(stderr,"\nTypes:");
+   for ( idx = 0; idx < NUM_TYPES; idx++ )
+   {
+      fprintf(stderr,"%s%s",(idx%8)?" ":"\n  ",typeNames[idx]);
+   }
+   fprintf(stderr,"\n");
+}
+
+static bool parseRange ( const char* arg, int base, uint32_t* pLo, uint32_t* pHi )
+{
+   char* end;
+
+   (*pLo) = strtoul(arg,&end,base);
+   if ( end == arg )
+   {
+      return false;
+   }
+   if ( (*end) == '-' )
+   {
+      arg = end+1;
+      (*pHi) = strtoul(arg,&end,base);
+      if ( end == arg )
+      {
+         return false;
+      }
+   }
+   else
+   {
+      (*pHi) = (*pLo);
+   }
+   return ((*end) == 0) && ((*pLo) <= (*pHi));
+}
+
+static bool parseNames ( const char* arg, const char** names, int32_t count, uint32_t* pMask )
+{
+   const char* start = arg;
+   const char* end;
+   int32_t     idx;
+
+   (*pMask) = 0;
+   while ( (*start) )
+   {
+      end = strchr(start,',');
+      if ( !end )
+      {
+         end = start+strlen(start);
+      }
+      for ( idx = 0; idx < count; idx++ )
+      {
+         if ( (strlen(names[idx]) == (size_t)(end-start)) &&
+              (!strncmp(names[idx],start,end-start)) )
+         {
+            (*pMask) |= 1<<idx;
+            break;
+         }
+      }
+      if ( idx == count )
+      {
+         fprintf(stderr,"Unknown name '%.*s'\n",(int)(end-start),start);
+         return false;
+      }
+      start = (*end)?end+1:end;
+   }
+   return true;
+}
+
+static void printSample ( const TracerInfo* pSample )
+{
+   char disassembly [ 64 ];
+
+   printf("%u\t%u\t%s\t%s\t%s\t%04X\t%02X",
+          pSample->frame,
+          pSample->cycle,
+          name(sourceNames,NUM_SOURCES,pSample->source),
+          name(typeNames,NUM_TYPES,pSample->type),
+          name(targetNames,NUM_TARGETS,pSample->target),
+          pSample->addr,
+          pSample->data);
+   if ( pSample->regsset )
+   {
+      printf("\tA:%02X X:%02X Y:%02X SP:%02X F:%02X",
+             pSample->a,
+             pSample->x,
+             pSample->y,
+             pSample->sp,
+             pSample->f);
+   }
+   if ( pSample->ea != 0xFFFFFFFF )
+   {
+      printf("\tEA:%04X",pSample->ea);
+   }
+   if ( pSample->disassemble[3] == 0x00 )
+   {
+      nesDisassembleSingle((uint8_t*)pSample->disassemble,disassembly);
+      printf("\t%s",disassembly);
+   }
+   printf("\n");
+}
+
+static void printInfo ( CTraceFileReader& reader )
+{
+   uint64_t samples = 0;
+   uint64_t gaps = 0;
+   uint64_t bytes = 0;
+   uint32_t block;
+
+   for ( block = 0; block < reader.GetNumBlocks(); block++ )
+   {
+      const TraceFileBlockInfo& info = reader.GetBlockInfo(block);
+
+      samples += info.count;
+      bytes += info.encodedSize;
+      if ( block &&
+           (info.firstSequence != reader.GetBlockInfo(block-1).firstSequence+reader.GetBlockInfo(block-1).count) )
+      {
+         gaps++;
+      }
+   }
+
+   printf("blocks:  %u\n",reader.GetNumBlocks());
+   printf("samples: %llu\n",(unsigned long long)samples);
+   if ( reader.GetNumBlocks() )
+   {
+      printf("frames:  %u-%u\n",
+             reader.GetBlockInfo(0).frameMin,
+             reader.GetBlockInfo(reader.GetNumBlocks()-1).frameMax);
+   }
+   if ( samples )
+   {
+      printf("encoded: %llu bytes, %.2f bytes per sample\n",(unsigned long long)bytes,(double)bytes/samples);
+   }
+   printf("gaps:    %llu\n",(unsigned long long)gaps);
+   printf("index:   %s\n",reader.HasIndex()?"yes":"no (file was not closed)");
+}
+
+// Answers queries against a trace file written by the emulator's
+// execution tracer.  Only blocks whose summary in the index can match the
+// query are decoded, and only one block is in memory at a time, so traces
+// much larger than memory can be filtered.
+int main(int argc, char* argv[])
+{
+   CTraceFileReader  reader;
+   TraceQuery        query;
+   const TracerInfo* pSamples;
+   const char*       fileName = NULL;
+   uint64_t          matches = 0;
+   uint32_t          block;
+   uint32_t          idx;
+   int               arg;
+
+   query.frameMin = 0;
+   query.frameMax = 0xFFFFFFFF;
+   query.addrMin = 0;
+   query.addrMax = 0xFFFF;
+   query.typeMask = 0xFFFFFFFF;
+   query.sourceMask = 0xFFFFFFFF;
+   query.countOnly = false;
+   query.info = false;
+
+   for ( arg = 1; arg < argc; arg++ )
+   {
+      if ( (!strcmp(argv[arg],"--frames")) && (arg+1 < argc) )
+      {
+         if ( !parseRange(argv[++arg],10,&query.frameMin,&query.frameMax) )
+         {
+            usage();
+            return 2;
+         }
+      }
+      else if ( (!strcmp(argv[arg],"--addr")) && (arg+1 < argc) )
+      {
+         if ( !parseRange(argv[++arg],16,&query.addrMin,&query.addrMax) )
+         {
+            usage();
+            return 2;
+         }
+      }
+      else if ( (!strcmp(argv[arg],"--source")) && (arg+1 < argc) )
+      {
+         if ( !parseNames(argv[++arg],sourceNames,NUM_SOURCES,&query.sourceMask) )
+         {
+            return 2;
+         }
+      }
+      else if ( (!strcmp(argv[arg],"--type")) && (arg+1 < argc) )
+      {
+         if ( !parseNames(argv[++arg],typeNames,NUM_TYPES,&query.typeMask) )
+         {
+            return 2;
+         }
+      }
+      else if ( !strcmp(argv[arg],"--count") )
+      {
+         query.countOnly = true;
+      }
+      else if ( !strcmp(argv[arg],"--info") )
+      {
+         query.info = true;
+      }
+      else if ( (argv[arg][0] != '-') && (!fileName) )
+      {
+         fileName = argv[arg];
+      }
+      else
+      {
+         usage();
+         return 2;
+      }
+   }
+
+   if ( !fileName )
+   {
+      usage();
+      return 2;
+   }
+   if ( !reader.Open(fileName) )
+   {
+      fprintf(stderr,"Cannot read trace file %s\n",fileName);
+      return 2;
+   }
+
+   if ( query.info )
+   {
+      printInfo(reader);
+      return 0;
+   }
+
+   for ( block = reader.FindFrame(query.frameMin); block < reader.GetNumBlocks(); block++ )
+   {
+      const TraceFileBlockInfo& info = reader.GetBlockInfo(block);
+
+      if ( (info.frameMax < query.frameMin) ||
+           (info.frameMin > query.frameMax) ||
+           (info.addrMax < query.addrMin) ||
+           (info.addrMin > query.addrMax) ||
+           (!(info.typeMask&query.typeMask)) ||
+           (!(info.sourceMask&query.sourceMask)) )
+      {
+         continue;
+      }
+
+      if ( !reader.ReadBlock(block,&pSamples) )
+      {
+         fprintf(stderr,"Trace file %s is corrupt at block %u\n",fileName,block);
+         return 2;
+      }
+
+      for ( idx = 0; idx < info.count; idx++ )
+      {
+         const TracerInfo* pSample = pSamples+idx;
+
+         if ( (pSample->frame >= query.frameMin) &&
+              (pSample->frame <= query.frameMax) &&
+              (pSample->addr >= query.addrMin) &&
+              (pSample->addr <= query.addrMax) &&
+              (query.typeMask&(1<<(pSample->type&31))) &&
+              (query.sourceMask&(1<<(pSample->source&31))) )
+         {
+            matches++;
+            if ( !query.countOnly )
+            {
+               printSample(pSample);
+            }
+         }
+      }
+   }
+
+   if ( query.countOnly )
+   {
+      printf("%llu\n",(unsigned long long)matches);
+   }
+
+   return 0;
+}
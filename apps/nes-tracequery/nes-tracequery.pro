@@ -0,0 +1,57 @@
+#-------------------------------------------------
+#
+# Command-line query tool for execution trace files.
+#
+#-------------------------------------------------
+
+QT =
+
+CONFIG += console c++11
+CONFIG -= app_bundle qt
+
+TOP = ../..
+
+CONFIG(release, debug|release) {
+   DESTDIR = release
+} else {
+   DESTDIR = debug
+}
+
+# Remove crap we do not need!
+CONFIG -= rtti exceptions
+
+OBJECTS_DIR = $$DESTDIR
+
+TARGET = "nes-tracequery"
+
+TEMPLATE = app
+
+NESICIDE_CXXFLAGS = -I$$TOP/libs/nes -I$$TOP/libs/nes/emulator -I$$TOP/libs/nes/common -I$$TOP/common
+NESICIDE_LIBS = -L$$TOP/libs/nes/$$DESTDIR -lnes-emulator
+
+QMAKE_CXXFLAGS_WARN_ON += -Wno-unused-parameter
+
+win32 {
+   QMAKE_LFLAGS += -static-libgcc
+}
+
+unix:!mac {
+   PREFIX = $$(PREFIX)
+   isEmpty (PREFIX) {
+      PREFIX = /usr/local
+   }
+
+   BINDIR = $$(BINDIR)
+   isEmpty (BINDIR) {
+      BINDIR=$$PREFIX/bin
+   }
+
+   target.path = $$BINDIR
+   INSTALLS += target
+}
+
+QMAKE_CXXFLAGS += $$NESICIDE_CXXFLAGS
+LIBS += $$NESICIDE_LIBS
+
+SOURCES += \
+   main.cpp
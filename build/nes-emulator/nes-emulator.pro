@@ -1,8 +1,12 @@
 TEMPLATE = subdirs
 
-SUBDIRS = nes-emulator-lib nes-emulator-app
+SUBDIRS = nes-emulator-lib nes-emulator-app nes-testrunner-app nes-tracequery-app
 
 nes-emulator-lib.file = ../../libs/nes/nes-emulator-lib.pro
 nes-emulator-app.file = ../../apps/nes-emulator/nesicide-emulator.pro
+nes-testrunner-app.file = ../../apps/nes-testrunner/nes-testrunner.pro
+nes-tracequery-app.file = ../../apps/nes-tracequery/nes-tracequery.pro
 
 nes-emulator-app.depends = nes-emulator-lib
+nes-testrunner-app.depends = nes-emulator-lib
+nes-tracequery-app.depends = nes-emulator-lib
@@ -12,11 +12,15 @@ CBreakpointInfo::~CBreakpointInfo()
 void CBreakpointInfo::ToggleEnabled ( int bp )
 {
    m_breakpoint [ bp ].enabled = !m_breakpoint [ bp ].enabled;
+
+   BreakpointsChanged();
 }
 
 void CBreakpointInfo::SetEnabled ( int bp, bool enabled )
 {
    m_breakpoint [ bp ].enabled = enabled;
+
+   BreakpointsChanged();
 }
 
 int CBreakpointInfo::FindExactMatch ( int type, eBreakpointItemType itemType, int event, int item1, int item1Physical, int item2, int mask, bool maskExclusive, eBreakpointConditionType conditionType, int condition, eBreakpointDataType dataType, int data )
@@ -65,6 +69,8 @@ void CBreakpointInfo::ModifyBreakpoint ( int bp, BreakpointInfo* pBreakpoint )
                        pBreakpoint->dataType,
                        pBreakpoint->data,
                        pBreakpoint->enabled);
+
+      BreakpointsChanged();
    }
 }
 
@@ -93,6 +99,8 @@ int CBreakpointInfo::AddBreakpoint ( BreakpointInfo* pBreakpoint )
                          pBreakpoint->data,
                          pBreakpoint->enabled );
       m_numBreakpoints++;
+
+      BreakpointsChanged();
    }
    else
    {
@@ -122,6 +130,8 @@ int CBreakpointInfo::AddBreakpoint ( int type, eBreakpointItemType itemType, int
                          data,
                          enabled );
       m_numBreakpoints++;
+
+      BreakpointsChanged();
    }
    else
    {
@@ -157,6 +167,8 @@ void CBreakpointInfo::RemoveBreakpoint ( int index )
    }
 
    m_numBreakpoints--;
+
+   BreakpointsChanged();
 }
 
 BreakpointStatus CBreakpointInfo::GetStatus ( int idx )
@@ -182,6 +182,11 @@ protected:
    // Must be provided by subclass.
    virtual void ModifyBreakpoint ( BreakpointInfo* pBreakpoint, int type, eBreakpointItemType itemType, int event, int item1, int item1Physical, int item2, int mask, bool maskExclusive, eBreakpointConditionType conditionType, int condition, eBreakpointDataType dataType, int data, bool enabled ) = 0;
 
+   // Invoked whenever the set of breakpoints, or the enabled state of any
+   // breakpoint, changes.  Subclasses can override this to rebuild any
+   // lookup structures they use to evaluate breakpoints during emulation.
+   virtual void BreakpointsChanged ( void ) {}
+
 protected:
    BreakpointInfo m_breakpoint [ NUM_BREAKPOINTS ];
    int            m_numBreakpoints;
@@ -21,6 +21,8 @@ typedef uint32_t (*getMemFunc)(uint32_t);
 typedef void (*rowHeadingFunc)(char*,uint32_t);
 typedef bool (*cellsEditableFunc)();
 typedef uint32_t (*cellColorComponentFunc)(uint32_t);
+typedef uint32_t (*advanceGenerationFunc)();
+typedef bool (*changedSinceFunc)(uint32_t,uint32_t,uint32_t);
 
 class CMemoryDatabase
 {
@@ -37,7 +39,9 @@ public:
                    cellColorComponentFunc cellRed = NULL,
                    cellColorComponentFunc cellGreen = NULL,
                    cellColorComponentFunc cellBlue = NULL,
-                   cellsEditableFunc cellsEditable = NULL)
+                   cellsEditableFunc cellsEditable = NULL,
+                   advanceGenerationFunc advanceGeneration = NULL,
+                   changedSinceFunc changedSince = NULL)
    {
       m_type = type;
       m_base = base;
@@ -53,6 +57,8 @@ public:
       m_cellRed = cellRed;
       m_cellGreen = cellGreen;
       m_cellBlue = cellBlue;
+      m_advanceGeneration = advanceGeneration;
+      m_changedSince = changedSince;
    }
    virtual ~CMemoryDatabase () {};
    const char* GetName ( void ) const
@@ -115,6 +121,29 @@ public:
       }
       return 0xFF;
    }
+   // Write tracking.  A view keeps the generation AdvanceGeneration gave it
+   // when it last refreshed and asks ChangedSince which cells may have
+   // changed since.  Memories whose writes aren't tracked always have.
+   bool GetCellsTracked ( void ) const
+   {
+      return m_changedSince != NULL;
+   }
+   uint32_t AdvanceGeneration ( void )
+   {
+      if ( m_advanceGeneration )
+      {
+         return m_advanceGeneration();
+      }
+      return 0;
+   }
+   bool ChangedSince ( uint32_t offset, uint32_t length, uint32_t generation )
+   {
+      if ( m_changedSince )
+      {
+         return m_changedSince(m_base+offset,length,generation);
+      }
+      return true;
+   }
    void GetRowHeading(char* buffer,int idx) { return m_rowHeading(buffer,idx); }
    void Set ( uint32_t offset, uint32_t data ) { m_set(m_base+offset,data); }
    uint32_t Get ( uint32_t offset ) { return m_get(m_base+offset); }
@@ -136,6 +165,8 @@ protected:
    cellColorComponentFunc m_cellRed;
    cellColorComponentFunc m_cellGreen;
    cellColorComponentFunc m_cellBlue;
+   advanceGenerationFunc m_advanceGeneration;
+   changedSinceFunc m_changedSince;
 };
 
 typedef CMemoryDatabase* (*memDBFunc)();
@@ -26,6 +26,9 @@ bool EmulatorPrefsDialog::vausArkanoidMouseMap[NUM_CONTROLLERS][IO_Vaus_MAX];
 int EmulatorPrefsDialog::vausArkanoidTrimPot[NUM_CONTROLLERS];
 int EmulatorPrefsDialog::tvStandard;
 bool EmulatorPrefsDialog::pauseOnKIL;
+int EmulatorPrefsDialog::rewindBudget;
+int EmulatorPrefsDialog::rewindSnapshotInterval;
+int EmulatorPrefsDialog::rewindKeyframeInterval;
 bool EmulatorPrefsDialog::square1Enabled;
 bool EmulatorPrefsDialog::square2Enabled;
 bool EmulatorPrefsDialog::triangleEnabled;
@@ -82,6 +85,9 @@ EmulatorPrefsDialog::EmulatorPrefsDialog(QString target,QWidget* parent) :
 
    ui->tvStandard->setCurrentIndex(tvStandard);
    ui->pauseOnKIL->setChecked(pauseOnKIL);
+   ui->rewindBudget->setValue(rewindBudget);
+   ui->rewindSnapshotInterval->setValue(rewindSnapshotInterval);
+   ui->rewindKeyframeInterval->setValue(rewindKeyframeInterval);
 
    ui->square1->setChecked(square1Enabled);
    ui->square2->setChecked(square2Enabled);
@@ -231,6 +237,9 @@ void EmulatorPrefsDialog::readSettings()
    settings.beginGroup("EmulatorPreferences/NES/System");
    tvStandard = settings.value("TVStandard",QVariant(MODE_NTSC)).toInt();
    pauseOnKIL = settings.value("PauseOnKIL",QVariant(true)).toBool();
+   rewindBudget = settings.value("RewindBudget",QVariant(32)).toInt();
+   rewindSnapshotInterval = settings.value("RewindSnapshotInterval",QVariant(1)).toInt();
+   rewindKeyframeInterval = settings.value("RewindKeyframeInterval",QVariant(60)).toInt();
    settings.endGroup();
 
    settings.beginGroup("EmulatorPreferences/C64");
@@ -304,7 +313,10 @@ void EmulatorPrefsDialog::writeSettings()
 
    // Set query flags.
    if ( (tvStandard != ui->tvStandard->currentIndex()) ||
-        (pauseOnKIL != ui->pauseOnKIL->isChecked()) )
+        (pauseOnKIL != ui->pauseOnKIL->isChecked()) ||
+        (rewindBudget != ui->rewindBudget->value()) ||
+        (rewindSnapshotInterval != ui->rewindSnapshotInterval->value()) ||
+        (rewindKeyframeInterval != ui->rewindKeyframeInterval->value()) )
    {
       systemUpdated = true;
    }
@@ -418,6 +430,9 @@ void EmulatorPrefsDialog::writeSettings()
 
    tvStandard = ui->tvStandard->currentIndex();
    pauseOnKIL = ui->pauseOnKIL->isChecked();
+   rewindBudget = ui->rewindBudget->value();
+   rewindSnapshotInterval = ui->rewindSnapshotInterval->value();
+   rewindKeyframeInterval = ui->rewindKeyframeInterval->value();
 
    square1Enabled = ui->square1->isChecked();
    square2Enabled = ui->square2->isChecked();
@@ -535,6 +550,9 @@ void EmulatorPrefsDialog::writeSettings()
    settings.beginGroup("EmulatorPreferences/NES/System");
    settings.setValue("TVStandard",tvStandard);
    settings.setValue("PauseOnKIL",pauseOnKIL);
+   settings.setValue("RewindBudget",rewindBudget);
+   settings.setValue("RewindSnapshotInterval",rewindSnapshotInterval);
+   settings.setValue("RewindKeyframeInterval",rewindKeyframeInterval);
    settings.endGroup();
 
    settings.beginGroup("EmulatorPreferences/C64");
@@ -39,6 +39,9 @@ public:
    static int getControllerSpecial(int port);
    static int getTVStandard();
    static bool getPauseOnKIL();
+   static int getRewindBudget() { return rewindBudget; }
+   static int getRewindSnapshotInterval() { return rewindSnapshotInterval; }
+   static int getRewindKeyframeInterval() { return rewindKeyframeInterval; }
    static bool getSquare1Enabled() { return square1Enabled; }
    static bool getSquare2Enabled() { return square2Enabled; }
    static bool getTriangleEnabled() { return triangleEnabled; }
@@ -120,6 +123,9 @@ private:
    static int vausArkanoidTrimPot[NUM_CONTROLLERS];
    static int tvStandard;
    static bool pauseOnKIL;
+   static int rewindBudget;
+   static int rewindSnapshotInterval;
+   static int rewindKeyframeInterval;
    static bool square1Enabled;
    static bool square2Enabled;
    static bool triangleEnabled;
@@ -1,7 +1,9 @@
 
 // Blip_Buffer 0.4.0. http://www.slack.net/~ant/
 
+#if !defined ( BLIP_BUFFER_STANDALONE )
 #include "../stdafx.h"
+#endif
 
 #include "Blip_Buffer.h"
 
@@ -41,7 +43,9 @@ Blip_Buffer::Blip_Buffer()
 	
 	// assumptions code makes about implementation-defined features
 	#ifndef NDEBUG
+#if !defined ( BLIP_BUFFER_STANDALONE )
    qDebug("Figure out 64-bit version of these asserts...");
+#endif
 //		// right shift of negative value preserves sign
 //		long i = LONG_MIN;
 //		assert( (i >> 1) == LONG_MIN / 2 );
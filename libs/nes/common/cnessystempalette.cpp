@@ -109,6 +109,8 @@ int32_t CBasePalette::m_paletteVariants [ 8 ] [ 64 ];
 
 int8_t   CBasePalette::m_paletteRGBs [ 8 ] [ 64 ] [ 3 ];
 
+uint32_t CBasePalette::m_paletteTV [ 8 ] [ 64 ];
+
 static CBasePalette __init __attribute__((unused));
 
 void CBasePalette::CalculateVariants ( void )
@@ -183,4 +185,20 @@ void CBasePalette::CalculateVariants ( void )
          m_paletteRGBs [ idx1 ] [ idx2 ] [ 2 ] = temp;
       }
    }
+
+   // Pack the RGB values into TV pixels.  Going through bytes keeps
+   // the pixel layout the same whatever the host byte order is.
+   for ( idx1 = 0; idx1 < 8; idx1++ )
+   {
+      for ( idx2 = 0; idx2 < 64; idx2++ )
+      {
+         uint8_t pixel [ 4 ];
+
+         pixel [ 0 ] = m_paletteRGBs [ idx1 ] [ idx2 ] [ 0 ];
+         pixel [ 1 ] = m_paletteRGBs [ idx1 ] [ idx2 ] [ 1 ];
+         pixel [ 2 ] = m_paletteRGBs [ idx1 ] [ idx2 ] [ 2 ];
+         pixel [ 3 ] = 0xFF;
+         memcpy ( &(m_paletteTV [ idx1 ] [ idx2 ]), pixel, sizeof(pixel) );
+      }
+   }
 }
@@ -80,6 +80,13 @@ public:
 
       return *(*(*(m_paletteRGBs+((bEmphasizeRed)|((bEmphasizeGreen)<<1)|((bEmphasizeBlue)<<2)))+idx)+2);
    }
+   // Packed TV pixels for one emphasis setting: the colour's R, G and B
+   // bytes followed by an opaque alpha byte, in the byte order of the TV
+   // surface, indexed by the 6-bit colour.
+   static inline const uint32_t* GetTVPalette ( int emphasis )
+   {
+      return *(m_paletteTV+(emphasis&0x7));
+   }
    static inline void SetPalette ( int idx, uint32_t color )
    {
       m_paletteVariants[0][idx] = color;
@@ -116,6 +123,7 @@ protected:
    static int32_t m_paletteBase [ 64 ];
    static int32_t m_paletteVariants [ 8 ] [ 64 ];
    static int8_t   m_paletteRGBs [ 8 ] [ 64 ] [ 3 ];
+   static uint32_t m_paletteTV [ 8 ] [ 64 ];
 };
 
 #endif
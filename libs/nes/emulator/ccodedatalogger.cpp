@@ -22,9 +22,6 @@
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
-uint32_t CCodeDataLogger::m_curCycle = 0;
-LoggerInfo* CCodeDataLogger::m_pLastLoad = NULL;
-
 CCodeDataLogger::CCodeDataLogger(uint32_t size, uint32_t mask)
 {
    m_size = size;
@@ -64,7 +61,7 @@ uint32_t CCodeDataLogger::GetLastLoadAddr ( uint32_t addr )
    return laddr;
 }
 
-void CCodeDataLogger::LogAccess ( uint32_t cycle, uint32_t addr, uint8_t data, int8_t type, int8_t source )
+void CCodeDataLogger::LogAccess ( LoggerState* state, uint32_t cycle, uint32_t addr, uint8_t data, int8_t type, int8_t source )
 {
    LoggerInfo* pLogger = m_pLogger+(addr&m_mask);
 
@@ -85,18 +82,18 @@ void CCodeDataLogger::LogAccess ( uint32_t cycle, uint32_t addr, uint8_t data, i
 
    pLogger->pLastLoad = NULL;
 
-   if ( (m_pLastLoad) &&
+   if ( (state->pLastLoad) &&
          (type == eLogger_DataWrite) )
    {
-      pLogger->pLastLoad = m_pLastLoad;
+      pLogger->pLastLoad = state->pLastLoad;
    }
 
    if ( type == eLogger_DataRead )
    {
-      m_pLastLoad = pLogger;
+      state->pLastLoad = pLogger;
    }
 
-   m_curCycle = cycle;
+   state->curCycle = cycle;
 }
 
 void CCodeDataLogger::GetPrintable ( uint32_t addr, int32_t subItem, char* str )
@@ -36,6 +36,14 @@ typedef struct _LoggerInfo
 } LoggerInfo;
 #pragma pack()
 
+// Logging state shared by all of the loggers of one machine, so that a
+// write logged in RAM can refer to the load, logged in ROM, that it stores.
+typedef struct _LoggerState
+{
+   uint32_t curCycle;
+   LoggerInfo* pLastLoad;
+} LoggerState;
+
 class CCodeDataLogger
 {
 public:
@@ -43,7 +51,7 @@ public:
    ~CCodeDataLogger();
 
    void ClearData ( void );
-   void LogAccess ( uint32_t cycle, uint32_t addr, uint8_t data, int8_t type, int8_t source );
+   void LogAccess ( LoggerState* state, uint32_t cycle, uint32_t addr, uint8_t data, int8_t type, int8_t source );
    uint32_t GetMask() { return m_mask; }
    uint32_t GetCount ( uint32_t addr )
    {
@@ -76,10 +84,6 @@ public:
       return (m_pLogger+(addr&m_mask));
    }
 
-   static inline uint32_t GetCurCycle ( void )
-   {
-      return m_curCycle;
-   }
    inline uint32_t GetMaxCount ( void )
    {
       return m_maxCount;
@@ -88,13 +92,12 @@ public:
 protected:
    uint32_t        m_size;
    uint32_t        m_mask;
-   static uint32_t m_curCycle;
    uint32_t m_maxCount;
-   static LoggerInfo* m_pLastLoad;
    LoggerInfo* m_pLogger;
 };
 
 void nesClearCodeDataLoggerDatabases ();
+uint32_t nesGetCodeDataLoggerCycle ( void );
 CCodeDataLogger* nesGetCpuCodeDataLoggerDatabase ( void );
 CCodeDataLogger* nesGetVirtualPRGROMCodeDataLoggerDatabase ( uint32_t addr );
 CCodeDataLogger* nesGetPhysicalPRGROMCodeDataLoggerDatabase ( uint32_t addr );
@@ -42,4 +42,10 @@ protected:
 JoypadLoggerInfo* nesGetInputSample ( int32_t port, int sample );
 void nesSetInputSample ( int32_t port, JoypadLoggerInfo* sample );
 
+class CNES;
+typedef CNES NesMachine;
+
+JoypadLoggerInfo* nesMachineGetInputSample ( NesMachine* machine, int32_t port, int sample );
+void nesMachineSetInputSample ( NesMachine* machine, int32_t port, JoypadLoggerInfo* sample );
+
 #endif
@@ -16,30 +16,77 @@
 
 #include "cmemory.h"
 #include "cnes6502.h"
+#include "cnessavestate.h"
+
+#include <atomic>
+
+// Longest line DISASSEMBLELINE prints is an undocumented absolute indexed
+// instruction, "*NOP $1234, X", and its terminator.  The last byte of a
+// slot is never written, so text read while it is being printed again
+// still ends inside its slot.  A slot whose first byte is zero holds no
+// code line.
+#define DISASSEMBLY_TEXT_SIZE 16
+#define DISASSEMBLY_CHUNK_BITS 8
+#define DISASSEMBLY_CHUNK_LINES (1<<DISASSEMBLY_CHUNK_BITS)
+
+// Text of a data line, ".DB $xx", for every byte value.
+static char* DATALINE ( uint8_t data )
+{
+   static struct DataLines
+   {
+      DataLines()
+      {
+         char* ptr;
+         int   idx;
+
+         for ( idx = 0; idx < 256; idx++ )
+         {
+            ptr = text[idx];
+            sprintf_db(ptr);
+            sprintf_02x(ptr,idx);
+         }
+      }
+      char text [ 256 ][ 8 ];
+   } lines;
+
+   return lines.text[data];
+}
 
 CMEMORYBANK::CMEMORYBANK() :
    m_memory(NULL),
    m_bankNum(0),
    m_size(0),
-   m_sizeMask(0)
+   m_sizeMask(0),
+   m_pLogger(NULL),
+   m_opcodeMask(NULL),
+   m_opcodeMaskDirty(true),
+   m_opcodeMaskDirtyLo(0),
+   m_opcodeMaskDirtyHi(0),
+   m_sloc2addr(NULL),
+   m_addr2sloc(NULL),
+   m_sloc(0),
+   m_textChunk(NULL),
+   m_pageGeneration(NULL),
+   m_generation(NULL)
 {}
 
 CMEMORYBANK::~CMEMORYBANK()
 {
-   uint32_t addr;
-
-   for ( addr = 0; addr < m_size; addr++ )
-   {
-      delete [] m_disassembly[addr];
-   }
+   uint32_t chunk;
 
    delete m_pLogger;
 
    delete [] m_memory;
-   delete [] m_opcodeMask;
-   delete [] m_sloc2addr;
-   delete [] m_addr2sloc;
-   delete [] m_disassembly;
+   delete [] m_sloc2addr.load(std::memory_order_relaxed);
+   if ( m_textChunk )
+   {
+      for ( chunk = 0; (chunk<<DISASSEMBLY_CHUNK_BITS) < m_size; chunk++ )
+      {
+         delete [] (m_textChunk+chunk)->load(std::memory_order_relaxed);
+      }
+      delete [] m_textChunk;
+   }
+   delete [] m_pageGeneration;
 }
 
 uint32_t CMEMORYBANK::BASEADDR() const
@@ -53,51 +100,245 @@ void CMEMORYBANK::INITIALIZE(CMEMORY *parent,
                              uint32_t size,
                              uint32_t sizeMask)
 {
-   uint32_t addr;
-
    m_parent = parent;
 
    m_bankNum = bankNum;
    m_size = size;
    m_sizeMask = sizeMask;
 
-   m_memory = new uint8_t[m_size];
-   m_disassembly = new char*[m_size];
+   m_memory = new uint8_t[m_size<<1];
+   m_opcodeMask = m_memory+m_size;
+   memset(m_opcodeMask,0,m_size);
    m_opcodeMaskDirty = true;
-   m_opcodeMask = new uint8_t[m_size];
-   m_sloc2addr = new uint16_t[m_size];
-   m_addr2sloc = new uint16_t[m_size];
+   m_opcodeMaskDirtyLo = 0;
+   m_opcodeMaskDirtyHi = m_sizeMask;
    m_sloc = m_size; // assume 1:1 map until otherwise known
 
+   // A new bank is news to any debugger looking at its memory.
+   m_generation = parent->MEMORYGENERATION();
+   m_pageGeneration = new uint32_t[(m_size+MEMORY_PAGE_SIZE-1)>>MEMORY_PAGE_BITS];
+   TOUCHALL();
+
    m_pLogger = new CCodeDataLogger ( m_size, m_sizeMask );
+}
+
+void CMEMORYBANK::TOUCHALL ()
+{
+   uint32_t page;
+
+   for ( page = 0; page < ((m_size+MEMORY_PAGE_SIZE-1)>>MEMORY_PAGE_BITS); page++ )
+   {
+      *(m_pageGeneration+page) = GENERATION();
+   }
+
+   // Every line may be different now.
+   m_opcodeMaskDirty = true;
+   m_opcodeMaskDirtyLo = 0;
+   m_opcodeMaskDirtyHi = m_sizeMask;
+}
 
-   for ( addr = 0; addr < m_size; addr++ )
+void CMEMORYBANK::MEMCOPY (uint8_t* dest, uint32_t addr, uint32_t length) const
+{
+   uint32_t chunk;
+
+   // Ranges longer than the bank wrap around it, as MEM does.
+   addr &= m_sizeMask;
+   while ( length )
    {
-      m_disassembly[addr] = new char [ 20 ];
-      m_disassembly[addr][0] = '\0';
-      m_opcodeMask[addr] = 0;
-      m_sloc2addr[addr] = addr; // assume 1:1 map until otherwise known
-      m_addr2sloc[addr] = addr; // assume 1:1 map until otherwise known
+      chunk = m_size-addr;
+      if ( chunk > length )
+      {
+         chunk = length;
+      }
+      memcpy(dest,m_memory+addr,chunk);
+      dest += chunk;
+      length -= chunk;
+      addr = 0;
    }
 }
 
+bool CMEMORYBANK::CHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation ) const
+{
+   uint32_t page;
+   uint32_t lastPage;
+
+   // A range that wraps around a bank smaller than itself covers all of it.
+   addr &= m_sizeMask;
+   if ( length > m_size-addr )
+   {
+      addr = 0;
+      length = m_size;
+   }
+   lastPage = (addr+length-1)>>MEMORY_PAGE_BITS;
+   for ( page = addr>>MEMORY_PAGE_BITS; page <= lastPage; page++ )
+   {
+      if ( *(m_pageGeneration+page) >= generation )
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
 void CMEMORYBANK::DISASSEMBLE()
 {
+   uint16_t* sloc2addr;
+   uint32_t  addr;
+   uint32_t  sloc;
+
    // Disassemble if necessary...
    if ( m_opcodeMaskDirty )
    {
-      CNES::NES()->CPU()->DISASSEMBLE ( m_disassembly,
-                           m_memory,
-                           m_size,
-                           m_opcodeMask,
-                           m_sloc2addr,
-                           m_addr2sloc,
-                           &(m_sloc) );
+      if ( !m_sloc2addr.load(std::memory_order_relaxed) )
+      {
+         sloc2addr = new uint16_t[m_size*2];
+         m_addr2sloc = sloc2addr+m_size;
+         m_textChunk = new std::atomic<char*>[(m_size+DISASSEMBLY_CHUNK_LINES-1)>>DISASSEMBLY_CHUNK_BITS]();
+         for ( addr = 0; addr < m_size; addr++ )
+         {
+            sloc2addr[addr] = addr; // assume 1:1 map until otherwise known
+         }
+
+         C6502::SLOCMAP ( m_memory,
+                          m_size,
+                          m_opcodeMask,
+                          sloc2addr,
+                          m_addr2sloc,
+                          &(m_sloc) );
+         for ( sloc = 0; sloc < m_sloc; sloc++ )
+         {
+            PRINTLINE ( *(sloc2addr+sloc) );
+         }
+
+         // Lookups start from the line maps, so they go in last.
+         m_sloc2addr.store(sloc2addr,std::memory_order_release);
+      }
+      else
+      {
+         RESLOC ( m_opcodeMaskDirtyLo, m_opcodeMaskDirtyHi );
+      }
 
       m_opcodeMaskDirty = false;
+      m_opcodeMaskDirtyLo = m_size;
+      m_opcodeMaskDirtyHi = 0;
    }
 }
 
+void CMEMORYBANK::RESLOC ( uint32_t lo, uint32_t hi )
+{
+   uint16_t* sloc2addr = m_sloc2addr.load(std::memory_order_relaxed);
+   uint32_t start;
+   uint32_t end;
+   uint32_t firstSloc;
+   uint32_t oldLines;
+   uint32_t newLines = 0;
+   uint32_t addr;
+   uint32_t sloc;
+   int32_t  size;
+   int32_t  delta;
+
+   // Only the lines from the one holding the first changed address up to
+   // the first place past the last changed address where the new lines
+   // fall back into step with the old ones can differ.  Find that place
+   // while the old maps are still intact.
+   firstSloc = *(m_addr2sloc+lo);
+   start = *(sloc2addr+firstSloc);
+   for ( end = start; end < m_size; )
+   {
+      end += C6502::LINESIZE(m_memory,m_size,m_opcodeMask,end);
+      newLines++;
+      if ( (end > hi) &&
+           (end < m_size) &&
+           ((*(sloc2addr+(*(m_addr2sloc+end)))) == end) )
+      {
+         break;
+      }
+   }
+   oldLines = ((end < m_size)?(*(m_addr2sloc+end)):m_sloc)-firstSloc;
+   delta = newLines-oldLines;
+
+   // Move the lines after the region to their new numbers...
+   if ( delta )
+   {
+      memmove(sloc2addr+firstSloc+newLines,
+              sloc2addr+firstSloc+oldLines,
+              (m_sloc-firstSloc-oldLines)*sizeof(uint16_t));
+      for ( addr = end; addr < m_size; addr++ )
+      {
+         (*(m_addr2sloc+addr)) += delta;
+      }
+      m_sloc += delta;
+   }
+
+   // ...and lay out and print the region again.
+   for ( addr = start, sloc = firstSloc; addr < end; sloc++ )
+   {
+      (*(sloc2addr+sloc)) = addr;
+      PRINTLINE ( addr );
+      for ( size = C6502::LINESIZE(m_memory,m_size,m_opcodeMask,addr); size; size--, addr++ )
+      {
+         (*(m_addr2sloc+addr)) = sloc;
+      }
+   }
+}
+
+void CMEMORYBANK::PRINTLINE ( uint32_t addr )
+{
+   std::atomic<char*>* chunk = m_textChunk+(addr>>DISASSEMBLY_CHUNK_BITS);
+   char* text = chunk->load(std::memory_order_relaxed);
+
+   if ( *(m_opcodeMask+addr) )
+   {
+      if ( !text )
+      {
+         text = new char[DISASSEMBLY_CHUNK_LINES*DISASSEMBLY_TEXT_SIZE]();
+
+         // Lookups find the chunk through its pointer, so it goes in last.
+         chunk->store(text,std::memory_order_release);
+      }
+
+      C6502::DISASSEMBLELINE ( text+((addr&(DISASSEMBLY_CHUNK_LINES-1))*DISASSEMBLY_TEXT_SIZE),
+                               m_memory,
+                               m_size,
+                               m_opcodeMask,
+                               addr );
+   }
+   else if ( text )
+   {
+      // No longer code.
+      (*(text+((addr&(DISASSEMBLY_CHUNK_LINES-1))*DISASSEMBLY_TEXT_SIZE))) = 0;
+   }
+}
+
+char* CMEMORYBANK::DISASSEMBLY ( uint32_t addr )
+{
+   static char empty [] = "";
+   uint16_t* sloc2addr = m_sloc2addr.load(std::memory_order_acquire);
+   char* text;
+
+   if ( !sloc2addr )
+   {
+      // Not disassembled yet.
+      return empty;
+   }
+
+   addr &= m_sizeMask;
+   addr = *(sloc2addr+(*(m_addr2sloc+addr)));
+
+   text = (m_textChunk+(addr>>DISASSEMBLY_CHUNK_BITS))->load(std::memory_order_acquire);
+   if ( text )
+   {
+      text += (addr&(DISASSEMBLY_CHUNK_LINES-1))*DISASSEMBLY_TEXT_SIZE;
+      if ( *text )
+      {
+         return text;
+      }
+   }
+
+   // Data lines are the same for every byte of the same value.
+   return DATALINE(*(m_memory+addr));
+}
+
 uint32_t intLog(uint32_t a)
 {
    uint32_t p = 0;
@@ -113,11 +354,13 @@ uint32_t intLog(uint32_t a)
    return p;
 }
 
-CMEMORY::CMEMORY(uint32_t virtBaseAddress,
+CMEMORY::CMEMORY(CNES* pNES,
+                 uint32_t virtBaseAddress,
                  uint32_t bankSize,
                  uint32_t numPhysBanks,
                  uint32_t numVirtBanks) :
    m_bank(NULL),
+   m_generation(pNES->MEMORYGENERATION()),
    m_bankSize(bankSize),
    m_bankSizeMask(bankSize-1),
    m_numPhysBanks(numPhysBanks),
@@ -137,6 +380,7 @@ CMEMORY::CMEMORY(uint32_t virtBaseAddress,
 
    m_bank = new CMEMORYBANK[m_numPhysBanks];
    m_pBank = new CMEMORYBANK*[m_numVirtBanks];
+   m_mapGeneration = new uint32_t[m_numVirtBanks];
 
    for ( bank = 0; bank < m_numPhysBanks; bank++ )
    {
@@ -153,11 +397,13 @@ CMEMORY::CMEMORY(uint32_t virtBaseAddress,
 
       // Start with identity mapping.
       m_pBank[bank] = &m_bank[physBank];
+      m_mapGeneration[bank] = GENERATION();
    }
 }
 
 CMEMORY::~CMEMORY()
 {
+   delete [] m_mapGeneration;
    delete [] m_pBank;
    delete [] m_bank;
 }
@@ -183,6 +429,83 @@ void CMEMORY::RESET ( bool soft )
 
       // Start with identity mapping.
       m_pBank[bank] = &m_bank[physBank];
+      m_mapGeneration[bank] = GENERATION();
+   }
+}
+
+bool CMEMORY::CHANGEDSINCE ( uint32_t virtAddr, uint32_t length, uint32_t generation ) const
+{
+   uint32_t bank;
+   uint32_t bankLength;
+
+   while ( length )
+   {
+      bank = virtBankFromVirtAddr(virtAddr);
+      bankLength = m_bankSize-offsetInBank(virtAddr);
+      if ( bankLength > length )
+      {
+         bankLength = length;
+      }
+      if ( ((*(m_mapGeneration+bank)) >= generation) ||
+           ((*(m_pBank+bank))->CHANGEDSINCE(virtAddr,bankLength,generation)) )
+      {
+         return true;
+      }
+      virtAddr += bankLength;
+      length -= bankLength;
+   }
+   return false;
+}
+
+void CMEMORY::MEMCOPY (uint8_t* dest, uint32_t virtAddr, uint32_t length)
+{
+   uint32_t bankLength;
+
+   while ( length )
+   {
+      bankLength = m_bankSize-offsetInBank(virtAddr);
+      if ( bankLength > length )
+      {
+         bankLength = length;
+      }
+      (*(m_pBank+virtBankFromVirtAddr(virtAddr)))->MEMCOPY(dest,virtAddr,bankLength);
+      dest += bankLength;
+      virtAddr += bankLength;
+      length -= bankLength;
+   }
+}
+
+void CMEMORY::SERIALIZEMAP ( CNESSaveState* state )
+{
+   uint32_t bank;
+
+   if ( TOTALSIZE() )
+   {
+      for ( bank = 0; bank < m_numVirtBanks; bank++ )
+      {
+         state->BANK ( m_pBank+bank );
+         if ( state->LOADING() )
+         {
+            m_mapGeneration[bank] = GENERATION();
+         }
+      }
+   }
+}
+
+void CMEMORY::SERIALIZEBANKS ( CNESSaveState* state, uint32_t firstBank, uint32_t numBanks )
+{
+   uint32_t bank;
+
+   if ( TOTALSIZE() )
+   {
+      for ( bank = firstBank; (bank < m_numPhysBanks) && (bank-firstBank < numBanks); bank++ )
+      {
+         state->DATA ( m_bank[bank].MEMPTR(0), m_bankSize );
+         if ( state->LOADING() )
+         {
+            m_bank[bank].TOUCHALL();
+         }
+      }
    }
 }
 
@@ -274,7 +597,7 @@ CCodeDataLogger* COPENBUS::LOGGERATPHYSADDR (uint32_t physAddr)
 
 uint8_t COPENBUS::MEM (uint32_t addr)
 {
-   return CNES::NES()->CPU()->OPENBUS();
+   return m_nes->CPU()->OPENBUS();
 }
 
 void COPENBUS::MEM (uint32_t addr, uint8_t data)
@@ -284,7 +607,7 @@ void COPENBUS::MEM (uint32_t addr, uint8_t data)
 
 uint8_t COPENBUS::MEMATPHYSADDR (uint32_t absAddr)
 {
-   return CNES::NES()->CPU()->OPENBUS();
+   return m_nes->CPU()->OPENBUS();
 }
 
 void COPENBUS::MEMATPHYSADDR (uint32_t absAddr, uint8_t data)
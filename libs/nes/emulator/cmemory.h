@@ -1,6 +1,8 @@
 #if !defined ( CMEMORY_H )
 #define CMEMORY_H
 
+#include <atomic>
+
 #include "nes_emulator_core.h"
 
 #include "cnesmappers.h"
@@ -12,8 +14,14 @@
 
 extern char* DISASSEMBLE(uint8_t* pOpcode, char* buffer);
 
+// Writes are tracked in pages of this many bytes, the width of a row in
+// most of the debugger's memory inspectors.
+#define MEMORY_PAGE_BITS 4
+#define MEMORY_PAGE_SIZE (1<<MEMORY_PAGE_BITS)
+
 class C6502;
 class CMEMORY;
+class CNESSaveState;
 
 class CMEMORYBANK
 {
@@ -27,6 +35,7 @@ public:
                    uint32_t sizeMask);
 
    inline uint32_t BANKNUM() const { return m_bankNum; }
+   inline CMEMORY* PARENT() const { return m_parent; }
 
    uint32_t BASEADDR() const;
 
@@ -36,7 +45,7 @@ public:
       addr &= m_sizeMask;
       if ( (*(m_opcodeMask+addr)) != mask )
       {
-         m_opcodeMaskDirty = true;
+         LINEDIRTY(addr);
       }
       *(m_opcodeMask+addr) = mask;
    }
@@ -47,45 +56,55 @@ public:
    }
    inline void OPCODEMASKCLR ( void )
    {
-      uint32_t idx1;
-      for ( idx1 = 0; idx1 < m_size; idx1++ )
-      {
-         m_opcodeMask[idx1] = 0;
-      }
+      memset(m_opcodeMask,0,m_size);
       m_opcodeMaskDirty = true;
+      m_opcodeMaskDirtyLo = 0;
+      m_opcodeMaskDirtyHi = m_sizeMask;
    }
    uint32_t SLOC2VIRTADDR ( uint16_t sloc )
    {
       if ( sloc < m_size )
       {
-         return *(m_sloc2addr+sloc);
+         uint16_t* sloc2addr = m_sloc2addr.load(std::memory_order_acquire);
+         return sloc2addr?(*(sloc2addr+sloc)):sloc;
       }
       return 0;
    }
    uint16_t ADDR2SLOC ( uint32_t addr )
    {
       addr &= m_sizeMask;
-      return *(m_addr2sloc+addr);
+      return m_sloc2addr.load(std::memory_order_acquire)?(*(m_addr2sloc+addr)):addr;
    }
    inline uint32_t SLOC ()
    {
       return m_sloc;
    }
-   char* DISASSEMBLY ( uint32_t addr )
+   char* DISASSEMBLY ( uint32_t addr );
+   void DISASSEMBLE ();
+
+   // Write generations.  Every page of a bank keeps the generation it was
+   // last written in, so a debugger can ask what changed since it last
+   // looked instead of fetching all of the memory again.  The generation
+   // belongs to the machine the memory is part of and only moves when a
+   // debugger advances it, from its own thread while the emulator thread
+   // stamps pages with it.
+   inline uint32_t GENERATION () const
    {
-      addr &= m_sizeMask;
-      return *(m_disassembly+addr);
+      return m_generation->load(std::memory_order_relaxed);
    }
-   void DISASSEMBLE ();
+   bool CHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation ) const;
+   void TOUCHALL ();
 
    void MEMCLR ()
    {
       memset(m_memory,0,m_size);
+      TOUCHALL();
    }
 
    void MEMSET (uint8_t* data)
    {
       memcpy(m_memory,data,m_size);
+      TOUCHALL();
    }
 
    inline uint8_t* MEMPTR (uint32_t addr)
@@ -94,6 +113,9 @@ public:
       return m_memory+addr;
    }
 
+   // Copies length bytes from addr as MEM would read them one at a time.
+   void MEMCOPY (uint8_t* dest, uint32_t addr, uint32_t length) const;
+
    inline uint8_t MEM (uint32_t addr)
    {
       addr &= m_sizeMask;
@@ -104,6 +126,13 @@ public:
    {
       addr &= m_sizeMask;
       *(m_memory+addr) = data;
+      *(m_pageGeneration+(addr>>MEMORY_PAGE_BITS)) = GENERATION();
+
+      // A line's size and text depend on its bytes.
+      if ( m_sloc2addr.load(std::memory_order_relaxed) )
+      {
+         LINEDIRTY(addr);
+      }
    }
 
    inline CCodeDataLogger* LOGGER() const
@@ -112,6 +141,27 @@ public:
    }
 
 protected:
+   // Marks the line holding addr to be laid out and printed again.
+   inline void LINEDIRTY ( uint32_t addr )
+   {
+      m_opcodeMaskDirty = true;
+      if ( addr < m_opcodeMaskDirtyLo )
+      {
+         m_opcodeMaskDirtyLo = addr;
+      }
+      if ( addr > m_opcodeMaskDirtyHi )
+      {
+         m_opcodeMaskDirtyHi = addr;
+      }
+   }
+
+   // Lays out the source lines affected by opcode mask or memory changes
+   // between lo and hi again, keeping the rest of the line maps.
+   void RESLOC ( uint32_t lo, uint32_t hi );
+
+   // Prints the text of the line starting at addr if it is code.
+   void PRINTLINE ( uint32_t addr );
+
    CMEMORY *m_parent;
    uint8_t* m_memory;
    uint32_t m_bankNum;
@@ -124,18 +174,40 @@ protected:
    // Code/Data Logger displays the collected information graphically.
    CCodeDataLogger* m_pLogger;
 
+   // The bank's memory and its opcode mask share one allocation.  The
+   // dirty range covers every address whose mask or memory has changed
+   // since the bank was last disassembled.
    uint8_t*  m_opcodeMask;
    bool      m_opcodeMaskDirty;
-   char**    m_disassembly;
-   uint16_t* m_sloc2addr;
-   uint16_t* m_addr2sloc;
-   uint32_t  m_sloc;
+   uint32_t  m_opcodeMaskDirtyLo;
+   uint32_t  m_opcodeMaskDirtyHi;
+
+   // Disassembly.  The source line maps are allocated the first time the
+   // bank is disassembled; banks that never hold code, such as CHR, never
+   // have them.  Until then a bank is one line per byte.  Code lines are
+   // printed into a fixed-size slot at the line's first address, in
+   // chunks of slots allocated when the first code line lands in them.
+   // Data lines are not printed at all.  Only DISASSEMBLE, on the thread
+   // running the machine, writes them, and they are not freed until the
+   // bank is, so the debuggers can look lines up while the machine runs.
+   // The maps and each chunk are published through their pointers, so
+   // a debugger that sees a pointer also sees what it points to.
+   std::atomic<uint16_t*> m_sloc2addr;
+   uint16_t*              m_addr2sloc;
+   uint32_t               m_sloc;
+   std::atomic<char*>*    m_textChunk;
+
+   // Generation each page was last written in, and the machine's
+   // generation to stamp them with.
+   uint32_t* m_pageGeneration;
+   std::atomic<uint32_t>* m_generation;
 };
 
 class CMEMORY
 {
 public:
-   CMEMORY(uint32_t virtBaseAddress,
+   CMEMORY(CNES* pNES,
+           uint32_t virtBaseAddress,
            uint32_t bankSize,
            uint32_t numPhysBanks = 1,
            uint32_t numVirtBanks = 1);        // represent unity for no bankswitch
@@ -146,13 +218,29 @@ public:
 
    uint32_t VIRTBASEADDR() const { return m_virtBaseAddress; }
 
+   // The write generation of the machine this memory is part of.
+   inline std::atomic<uint32_t>* MEMORYGENERATION() const { return m_generation; }
+   inline uint32_t GENERATION() const { return m_generation->load(std::memory_order_relaxed); }
+
    void RESET ( bool soft );
 
    inline CMEMORYBANK* PHYSBANK(uint32_t bank) const { return &m_bank[bank]; }
    inline CMEMORYBANK* VIRTBANK(uint32_t bank) const { return m_pBank[bank]; }
 
+   inline uint32_t NUMPHYSBANKS() const { return m_numPhysBanks; }
+
    virtual uint32_t TOTALSIZE() const { return m_totalPhysSize; }
 
+   // Save state support.  SERIALIZEMAP moves the virtual-to-physical bank
+   // mapping and SERIALIZEBANKS moves the contents of a run of physical
+   // banks.  Both do nothing for memories with no storage of their own.
+   void SERIALIZEMAP ( CNESSaveState* state );
+   void SERIALIZEBANKS ( CNESSaveState* state, uint32_t firstBank = 0, uint32_t numBanks = 0xFFFFFFFF );
+
+   // Whether any of length bytes from virtAddr were written, or had a
+   // different bank mapped in, in the given generation or a later one.
+   virtual bool CHANGEDSINCE ( uint32_t virtAddr, uint32_t length, uint32_t generation ) const;
+
    // Code/Data logger support functions
    virtual CCodeDataLogger* LOGGER (uint32_t virtAddr = 0)
    {
@@ -222,6 +310,10 @@ public:
       return (*(m_pBank+virtBankFromVirtAddr(addr)))->MEMPTR(addr);
    }
 
+   // Copies length bytes from virtAddr as MEM would read them one at a
+   // time, a bank at a time.
+   virtual void MEMCOPY (uint8_t* dest, uint32_t virtAddr, uint32_t length);
+
    virtual uint8_t MEM (uint32_t addr)
    {
       return (*(m_pBank+virtBankFromVirtAddr(addr)))->MEM(addr);
@@ -245,11 +337,13 @@ public:
    virtual void REMAP(uint32_t virt, uint32_t phys)
    {
       (*(m_pBank+virt)) = m_bank+phys;
+      (*(m_mapGeneration+virt)) = GENERATION();
    }
 
    virtual void REMAPEXT(uint32_t virt, CMEMORYBANK* phys)
    {
       (*(m_pBank+virt)) = phys;
+      (*(m_mapGeneration+virt)) = GENERATION();
    }
 
    inline uint32_t bankSize() const
@@ -308,6 +402,8 @@ public:
 protected:
    CMEMORYBANK* m_bank;
    CMEMORYBANK** m_pBank;
+   uint32_t* m_mapGeneration;
+   std::atomic<uint32_t>* m_generation;
    uint32_t m_bankSize;
    uint32_t m_bankSizeMask;
    uint32_t m_numPhysBanks;
@@ -325,7 +421,7 @@ protected:
 class COPENBUS: public CMEMORY
 {
 public:
-   COPENBUS() : CMEMORY(0,1) {}
+   COPENBUS(CNES* pNES) : CMEMORY(pNES,0,1), m_nes(pNES) {}
    virtual ~COPENBUS() {}
 
    // Code/Data logger support functions
@@ -341,15 +437,29 @@ public:
    void MEMATPHYSADDR (uint32_t absAddr, uint8_t data);
 
    uint8_t* MEMPTR (uint32_t addr) { return m_pBank[0]->MEMPTR(0); }
+   void MEMCOPY (uint8_t* dest, uint32_t virtAddr, uint32_t length)
+   {
+      while ( length-- )
+      {
+         *(dest++) = MEM(virtAddr++);
+      }
+   }
 
    void REMAP(uint32_t virt, uint32_t phys) {}
    void REMAPEXT(uint32_t virt, CMEMORYBANK* phys) {}
 
+   // The open bus changes with every CPU access.
+   bool CHANGEDSINCE ( uint32_t virtAddr, uint32_t length, uint32_t generation ) const { return true; }
+
    uint32_t SLOC ( uint32_t virtAddr ) { return 1; }
    char* DISASSEMBLY ( uint32_t virtAddr ) { return "???"; }
    char* DISASSEMBLYATPHYSADDR ( uint32_t physAddr, char* buffer ) { return "???"; }
 
    uint32_t TOTALSIZE() const { return 0; }
+
+protected:
+   // The machine whose CPU supplies the open-bus value.
+   CNES* m_nes;
 };
 
 #endif // CMEMORY_H
@@ -20,13 +20,14 @@
 #include "cnesppu.h"
 #include "cnesio.h"
 #include "cnesapu.h"
-
-CNES* CNES::self = new CNES();
+#include "cnessavestate.h"
 
 CNES::CNES()
-   : m_cpu(new C6502(this)),
-     m_ppu(new CPPU()),
-     m_cart(CARTFACTORY(0))
+   : m_bDebuggable(false),
+     m_memoryGeneration(1),
+     m_cpu(new C6502(this)),
+     m_ppu(new CPPU(this)),
+     m_cart(CARTFACTORY(this,0))
 {
    m_videoMode = MODE_NTSC;
    m_controllerType[0] = IO_StandardJoypad;
@@ -38,24 +39,38 @@ CNES::CNES()
    m_windowX2 = 0;
    m_windowY2 = 0;
 
+   IOSTATEINIT ( &m_io, this );
+
+   m_mmc5AudioMask = 0xffffffff;
+   m_vrc6AudioMask = 0xffffffff;
+   m_n106AudioMask = 0xffffffff;
+
    m_bReplay = false;
    m_bRecord = true;
    m_frame = 0;
 
    m_bBreakpointsEnabled = true;
    m_bAtBreakpoint = false;
+   m_bBreakpointsHit = false;
    m_bStepCPUBreakpoint = false;
    m_bStepPPUBreakpoint = false;
    m_ppuCycleToStepTo = -1;
    m_ppuFrameToStepTo = -1;
 
-   m_breakpoints = new CNESBreakpointInfo();
+   m_breakpoints = new CNESBreakpointInfo(this);
 
    m_tracer = new CTracer();
+
+   m_loggerState.curCycle = 0;
+   m_loggerState.pLastLoad = NULL;
 }
 
 CNES::~CNES()
 {
+   delete m_cart;
+   delete m_ppu;
+   delete m_cpu;
+
    delete m_breakpoints;
 
    delete m_tracer;
@@ -240,11 +255,21 @@ void CNES::FRONTLOAD ( uint32_t mapper )
    if ( mapper != CART()->MAPPER() )
    {
       delete m_cart;
+      // The last load may have been logged in the old cartridge.
+      m_loggerState.pLastLoad = NULL;
       // Create cartridge space.
-      m_cart = CARTFACTORY(mapper);
+      m_cart = CARTFACTORY(this,mapper);
    }
    CART()->ClearCHRBanks();
    CART()->ClearPRGBanks();
+
+   BINDSYNC();
+}
+
+void CNES::BINDSYNC ( void )
+{
+   m_cpu->SYNCCAPS ( m_cart->SYNCCAPS()&SYNC_CPU_CYCLE );
+   m_ppu->SYNCCAPS ( m_cart->SYNCCAPS()&SYNC_PPU );
 }
 
 void CNES::RESET ( bool soft )
@@ -269,9 +294,68 @@ void CNES::RESET ( bool soft )
    // The SDL callback triggers emulation...
    m_cpu->RESET ( soft );
 
+   // Mapper events are scheduled against the CPU and PPU just reset.
+   m_cart->RESCHEDULE ();
+
    m_frame = 0;
 }
 
+void CNES::SERIALIZE ( CNESSaveState* state )
+{
+   state->BEGIN ();
+
+   // Every memory whose banks can be mapped into another memory's
+   // address space, so that bank mappings can be stored.
+   state->MEMORY ( PPU()->VRAM() );
+   CART()->MEMORIES ( state );
+
+   state->BEGINCHUNK ( "NES ", 1 );
+   state->CHECK ( m_videoMode );
+   state->CHECK ( CART()->MAPPER() );
+   state->CHECK ( CART()->NUMPRGROMBANKS() );
+   state->CHECK ( CART()->NUMCHRROMBANKS() );
+   state->VALUE ( m_frame );
+   state->ENDCHUNK ();
+
+   IOSTATESERIALIZE ( &m_io, state );
+   CPU()->SERIALIZE ( state );
+   CPU()->APU()->SERIALIZE ( state );
+   PPU()->SERIALIZE ( state );
+   CART()->SERIALIZE ( state );
+
+   state->END ();
+}
+
+uint32_t CNES::SAVESTATE ( uint8_t* buffer, uint32_t size )
+{
+   CNESSaveState state(buffer,size,eSaveState_Save);
+
+   SERIALIZE ( &state );
+
+   return state.OK()?state.SIZE():0;
+}
+
+bool CNES::LOADSTATE ( const uint8_t* buffer, uint32_t size )
+{
+   CNESSaveState verify((uint8_t*)buffer,size,eSaveState_Verify);
+   CNESSaveState state((uint8_t*)buffer,size,eSaveState_Load);
+
+   // Walk the state once without changing anything so that a state for
+   // some other cartridge or build is rejected up front.
+   SERIALIZE ( &verify );
+   if ( !verify.OK() )
+   {
+      return false;
+   }
+
+   SERIALIZE ( &state );
+
+   // The profiled call stack is not part of the state.
+   CPU()->PROFILER()->Restart ( CPU()->_CYCLES() );
+
+   return state.OK();
+}
+
 void CNES::STEPCPUBREAKPOINT ( void )
 {
    m_bStepCPUBreakpoint = true;
@@ -300,6 +384,7 @@ void CNES::CHECKBREAKPOINT ( eBreakpointTarget target, eBreakpointType type, int
    CBitfieldData* pBitfield;
    uint32_t addr = 0;
    uint32_t absAddr = 0;
+   uint32_t key;
    int32_t value = 0;
    bool force = false;
 
@@ -324,521 +409,560 @@ void CNES::CHECKBREAKPOINT ( eBreakpointTarget target, eBreakpointType type, int
    // For all breakpoints...if we're not stepping...
    else
    {
-      for ( idx = 0; idx < m_breakpoints->GetNumBreakpoints(); idx++ )
+      // Not hit yet...
+      if ( m_bBreakpointsHit )
       {
-         // Get breakpoint data...
-         pBreakpoint = m_breakpoints->GetBreakpoint(idx);
+         for ( idx = 0; idx < m_breakpoints->GetNumBreakpoints(); idx++ )
+         {
+            m_breakpoints->GetBreakpoint(idx)->hit = false;
+         }
+         m_bBreakpointsHit = false;
+      }
 
-         // Not hit yet...
-         pBreakpoint->hit = false;
+      // Pick up any breakpoint changes...
+      m_breakpoints->UpdateIndex();
 
-         // Is this breakpoint enabled?
-         if ( pBreakpoint->enabled )
+      // Are there any enabled breakpoints of the specified type?
+      if ( (type < 0) ||
+           (type >= NUM_BREAKPOINT_TYPES) ||
+           (!m_breakpoints->GetNumBreakpointsOfType(type)) )
+      {
+         return;
+      }
+
+      // Could any of them fire given the current machine state?
+      switch ( type )
+      {
+         case eBreakOnCPUExecution:
+            key = CPU()->__PCSYNC();
+            break;
+         case eBreakOnCPUMemoryAccess:
+         case eBreakOnCPUMemoryRead:
+         case eBreakOnCPUMemoryWrite:
+            key = CPU()->_EA();
+            break;
+         case eBreakOnOAMPortalAccess:
+         case eBreakOnOAMPortalRead:
+         case eBreakOnOAMPortalWrite:
+            key = PPU()->_OAMADDR();
+            break;
+         case eBreakOnPPUFetch:
+         case eBreakOnPPUPortalAccess:
+         case eBreakOnPPUPortalRead:
+         case eBreakOnPPUPortalWrite:
+            key = PPU()->_PPUADDR();
+            break;
+         case eBreakOnCPUState:
+         case eBreakOnPPUState:
+         case eBreakOnAPUState:
+         case eBreakOnMapperState:
+            key = data;
+            break;
+         case eBreakOnCPUEvent:
+         case eBreakOnPPUEvent:
+         case eBreakOnAPUEvent:
+         case eBreakOnMapperEvent:
+            key = event;
+            break;
+         default:
+            key = 0;
+            break;
+      }
+
+      if ( !m_breakpoints->IsBreakpointCandidate(type,key) )
+      {
+         return;
+      }
+
+      // Evaluate only the breakpoints that could fire...
+      for ( idx = 0; idx < m_breakpoints->GetNumBreakpointsOfType(type); idx++ )
+      {
+         // Get breakpoint data...
+         pBreakpoint = m_breakpoints->GetBreakpointOfType(type,idx);
+
+         switch ( pBreakpoint->type )
          {
-            // Are there any for the specified target?
-            if ( pBreakpoint->target == target )
-            {
-               // Promote "Access" types...
-               if ( (pBreakpoint->type == eBreakOnCPUMemoryAccess) &&
-                     ((type == eBreakOnCPUMemoryRead) || (type == eBreakOnCPUMemoryWrite)) )
+            case eBreakOnPPUCycle:
+               // Nothing to do here; make the warning go away...
+               break;
+            case eBreakOnCPUExecution:
+               addr = CPU()->__PCSYNC();
+               absAddr = PHYSADDR(CPU()->__PCSYNC());
+
+               if ( pBreakpoint->item1 == pBreakpoint->item2 )
                {
-                  type = eBreakOnCPUMemoryAccess;
+                  if ( ((absAddr == (uint32_t)-1) || (absAddr == pBreakpoint->item1Physical)) &&
+                       (addr >= pBreakpoint->item1) &&
+                       (addr <= pBreakpoint->item2) &&
+                       (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
+                        ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
+                  {
+                     pBreakpoint->itemActual = addr;
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
                }
-
-               if ( (pBreakpoint->type == eBreakOnOAMPortalAccess) &&
-                     ((type == eBreakOnOAMPortalRead) || (type == eBreakOnOAMPortalWrite)) )
+               else
                {
-                  type = eBreakOnOAMPortalAccess;
+                  if ( (addr >= pBreakpoint->item1) &&
+                       (addr <= pBreakpoint->item2) &&
+                       (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
+                        ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
+                  {
+                     pBreakpoint->itemActual = addr;
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
                }
-
-               if ( (pBreakpoint->type == eBreakOnPPUPortalAccess) &&
-                     ((type == eBreakOnPPUPortalRead) || (type == eBreakOnPPUPortalWrite)) )
+               break;
+            case eBreakOnCPUMemoryAccess:
+            case eBreakOnCPUMemoryRead:
+            case eBreakOnCPUMemoryWrite:
+               addr = CPU()->_EA();
+
+               if ( (addr >= pBreakpoint->item1) &&
+                    (addr <= pBreakpoint->item2) &&
+                    (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
+                     ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
                {
-                  type = eBreakOnPPUPortalAccess;
+                  pBreakpoint->itemActual = addr;
+
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (data == pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (data != pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (data < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (data > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (data&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (data&pBreakpoint->data) &&
+                            ((data&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
                }
 
-               if ( pBreakpoint->type == type )
+               break;
+            case eBreakOnCPUState:
+
+               // Is the breakpoint on this register?
+               if ( pBreakpoint->item1 == (uint32_t)data )
                {
-                  switch ( pBreakpoint->type )
+                  pRegister = nesGetCpuRegisterDatabase()->GetRegister(pBreakpoint->item1);
+                  pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
+
+                  // Get actual register data...
+                  switch ( pBreakpoint->item1 )
                   {
-                     case eBreakOnPPUCycle:
-                        // Nothing to do here; make the warning go away...
+                     case CPU_PC:
+                        value = CPU()->__PC();
                         break;
-                     case eBreakOnCPUExecution:
-                        addr = CPU()->__PCSYNC();
-                        absAddr = PHYSADDR(CPU()->__PCSYNC());
-
-                        if ( pBreakpoint->item1 == pBreakpoint->item2 )
-                        {
-                           if ( ((absAddr == (uint32_t)-1) || (absAddr == pBreakpoint->item1Physical)) &&
-                                (addr >= pBreakpoint->item1) &&
-                                (addr <= pBreakpoint->item2) &&
-                                (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
-                                 ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
-                           {
-                              pBreakpoint->itemActual = addr;
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
-                        else
-                        {
-                           if ( (addr >= pBreakpoint->item1) &&
-                                (addr <= pBreakpoint->item2) &&
-                                (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
-                                 ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
-                           {
-                              pBreakpoint->itemActual = addr;
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
+                     case CPU_A:
+                        value = CPU()->_A();
                         break;
-                     case eBreakOnCPUMemoryAccess:
-                     case eBreakOnCPUMemoryRead:
-                     case eBreakOnCPUMemoryWrite:
-                        addr = CPU()->_EA();
-
-                        if ( (addr >= pBreakpoint->item1) &&
-                             (addr <= pBreakpoint->item2) &&
-                             (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
-                              ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
-                        {
-                           pBreakpoint->itemActual = addr;
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (data == pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (data != pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (data < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (data > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (data&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (data&pBreakpoint->data) &&
-                                     ((data&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
-
+                     case CPU_X:
+                        value = CPU()->_X();
                         break;
-                     case eBreakOnCPUState:
-
-                        // Is the breakpoint on this register?
-                        if ( pBreakpoint->item1 == (uint32_t)data )
-                        {
-                           pRegister = nesGetCpuRegisterDatabase()->GetRegister(pBreakpoint->item1);
-                           pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
-
-                           // Get actual register data...
-                           switch ( pBreakpoint->item1 )
-                           {
-                              case CPU_PC:
-                                 value = CPU()->__PC();
-                                 break;
-                              case CPU_A:
-                                 value = CPU()->_A();
-                                 break;
-                              case CPU_X:
-                                 value = CPU()->_X();
-                                 break;
-                              case CPU_Y:
-                                 value = CPU()->_Y();
-                                 break;
-                              case CPU_SP:
-                                 value = CPU()->_SP();
-                                 break;
-                              case CPU_F:
-                                 value = CPU()->_F();
-                                 break;
-                           }
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
-                                     ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
-
+                     case CPU_Y:
+                        value = CPU()->_Y();
                         break;
-                     case eBreakOnOAMPortalAccess:
-                     case eBreakOnOAMPortalRead:
-                     case eBreakOnOAMPortalWrite:
-                        addr = PPU()->_OAMADDR();
-
-                        if ( (addr >= pBreakpoint->item1) &&
-                             (addr <= pBreakpoint->item2) &&
-                             (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
-                              ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
-                        {
-                           pBreakpoint->itemActual = addr;
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (data == pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (data != pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (data < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (data > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (data&pBreakpoint->data) &&
-                                     ((data&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (data&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
-
+                     case CPU_SP:
+                        value = CPU()->_SP();
                         break;
-                     case eBreakOnPPUFetch:
-                     case eBreakOnPPUPortalAccess:
-                     case eBreakOnPPUPortalRead:
-                     case eBreakOnPPUPortalWrite:
-                        addr = PPU()->_PPUADDR();
-
-                        if ( (addr >= pBreakpoint->item1) &&
-                             (addr <= pBreakpoint->item2) &&
-                             (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
-                              ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
-                        {
-                           pBreakpoint->itemActual = addr;
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (data == pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (data != pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (data < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (data > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (data&pBreakpoint->data) &&
-                                     ((data&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (data&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
-
+                     case CPU_F:
+                        value = CPU()->_F();
                         break;
-                     case eBreakOnPPUState:
-
-                        // Is the breakpoint on this register?
-                        if ( pBreakpoint->item1 == (uint32_t)data )
-                        {
-                           pRegister = nesGetPpuRegisterDatabase()->GetRegister(pBreakpoint->item1);
-                           pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
-
-                           // Get actual register data...
-                           value = PPU()->_PPU(pRegister->GetAddr());
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
-                                     ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
+                  }
 
-                        break;
-                     case eBreakOnAPUState:
-
-                        // Is the breakpoint on this register?
-                        if ( pBreakpoint->item1 == (uint32_t)data )
-                        {
-                           pRegister = nesGetApuRegisterDatabase()->GetRegister(pBreakpoint->item1);
-                           pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
-
-                           // Get actual register data...
-                           value = CPU()->APU()->_APU(pRegister->GetAddr());
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
-                                     ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
+                            ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+               }
 
-                        break;
-                     case eBreakOnMapperState:
-
-                        // Is the breakpoint on this register?
-                        if ( pBreakpoint->item1 == (uint32_t)data )
-                        {
-                           pRegister = nesGetCartridgeRegisterDatabase()->GetRegister(pBreakpoint->item1);
-                           pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
-
-                           // Get actual register data...
-                           if ( pRegister->GetAddr() >= MEM_32KB )
-                           {
-                              value = CART()->DEBUGINFO(pRegister->GetAddr());
-                           }
-                           else
-                           {
-                              value = CART()->DEBUGINFO(pRegister->GetAddr());
-                           }
-
-                           if ( pBreakpoint->condition == eBreakIfAnything )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfEqual) &&
-                                     (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
-                                     (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
-                                     (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
-                                     (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
-                                     ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                           else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
-                                     (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
-                           {
-                              pBreakpoint->hit = true;
-                              force = true;
-                           }
-                        }
+               break;
+            case eBreakOnOAMPortalAccess:
+            case eBreakOnOAMPortalRead:
+            case eBreakOnOAMPortalWrite:
+               addr = PPU()->_OAMADDR();
 
-                        break;
-                     case eBreakOnCPUEvent:
-                     case eBreakOnPPUEvent:
-                     case eBreakOnAPUEvent:
-                     case eBreakOnMapperEvent:
-
-                        // If this is the right event to check, check it...
-                        if ( pBreakpoint->event == event )
-                        {
-                           pBreakpoint->hit = pBreakpoint->pEvent->Evaluate(pBreakpoint,data);
-
-                           if ( pBreakpoint->hit )
-                           {
-                              force = true;
-                           }
-                        }
+               if ( (addr >= pBreakpoint->item1) &&
+                    (addr <= pBreakpoint->item2) &&
+                    (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
+                     ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
+               {
+                  pBreakpoint->itemActual = addr;
 
-                        break;
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (data == pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (data != pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (data < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (data > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (data&pBreakpoint->data) &&
+                            ((data&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (data&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+               }
+
+               break;
+            case eBreakOnPPUFetch:
+            case eBreakOnPPUPortalAccess:
+            case eBreakOnPPUPortalRead:
+            case eBreakOnPPUPortalWrite:
+               addr = PPU()->_PPUADDR();
+
+               if ( (addr >= pBreakpoint->item1) &&
+                    (addr <= pBreakpoint->item2) &&
+                    (((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
+                     ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0))) )
+               {
+                  pBreakpoint->itemActual = addr;
+
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (data == pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (data != pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (data < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (data > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (data&pBreakpoint->data) &&
+                            ((data&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (data&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+               }
+
+               break;
+            case eBreakOnPPUState:
+
+               // Is the breakpoint on this register?
+               if ( pBreakpoint->item1 == (uint32_t)data )
+               {
+                  pRegister = nesGetPpuRegisterDatabase()->GetRegister(pBreakpoint->item1);
+                  pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
+
+                  // Get actual register data...
+                  value = PPU()->_PPU(pRegister->GetAddr());
+
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
+                            ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+               }
+
+               break;
+            case eBreakOnAPUState:
+
+               // Is the breakpoint on this register?
+               if ( pBreakpoint->item1 == (uint32_t)data )
+               {
+                  pRegister = nesGetApuRegisterDatabase()->GetRegister(pBreakpoint->item1);
+                  pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
+
+                  // Get actual register data...
+                  value = CPU()->APU()->_APU(pRegister->GetAddr());
+
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
+                            ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+               }
+
+               break;
+            case eBreakOnMapperState:
+
+               // Is the breakpoint on this register?
+               if ( pBreakpoint->item1 == (uint32_t)data )
+               {
+                  pRegister = nesGetCartridgeRegisterDatabase()->GetRegister(pBreakpoint->item1);
+                  pBitfield = pRegister->GetBitfield(pBreakpoint->item2);
+
+                  // Get actual register data...
+                  if ( pRegister->GetAddr() >= MEM_32KB )
+                  {
+                     value = CART()->DEBUGINFO(pRegister->GetAddr());
+                  }
+                  else
+                  {
+                     value = CART()->DEBUGINFO(pRegister->GetAddr());
+                  }
+
+                  if ( pBreakpoint->condition == eBreakIfAnything )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfEqual) &&
+                            (pBreakpoint->data == pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfNotEqual) &&
+                            (pBreakpoint->data != pBitfield->GetValueRaw(value)) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfLessThan) &&
+                            (pBitfield->GetValueRaw(value) < pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfGreaterThan) &&
+                            (pBitfield->GetValueRaw(value) > pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfExclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) &&
+                            ((pBitfield->GetValueRaw(value)&(~pBreakpoint->data)) == 0) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
+                  }
+                  else if ( (pBreakpoint->condition == eBreakIfInclusiveMask) &&
+                            (pBitfield->GetValueRaw(value)&pBreakpoint->data) )
+                  {
+                     pBreakpoint->hit = true;
+                     force = true;
                   }
                }
-            }
+
+               break;
+            case eBreakOnCPUEvent:
+            case eBreakOnPPUEvent:
+            case eBreakOnAPUEvent:
+            case eBreakOnMapperEvent:
+
+               // If this is the right event to check, check it...
+               if ( pBreakpoint->event == event )
+               {
+                  pBreakpoint->hit = pBreakpoint->pEvent->Evaluate(pBreakpoint,data);
+
+                  if ( pBreakpoint->hit )
+                  {
+                     force = true;
+                  }
+               }
+
+               break;
          }
       }
+
+      // Remember to clear the hits on the next check...
+      if ( force )
+      {
+         m_bBreakpointsHit = true;
+      }
    }
 
    if ( force )
@@ -853,6 +977,9 @@ void CNES::FORCEBREAKPOINT ( void )
    {
       m_bAtBreakpoint = true;
 
+      // Let the debuggers see the trace up to the breakpoint...
+      m_tracer->Publish ();
+
       // Hook back to IDE to force it to update...
       nesBreak();
    }
@@ -865,7 +992,7 @@ void CNES::RUN ( uint32_t* joy )
 
    if ( m_bReplay )
    {
-      if ( m_frame >= CIOStandardJoypad::LOGGER(0)->GetNumSamples() )
+      if ( m_frame >= CIOStandardJoypad::LOGGER(&m_io,0)->GetNumSamples() )
       {
          m_bReplay = false;
       }
@@ -877,70 +1004,70 @@ void CNES::RUN ( uint32_t* joy )
 
    if ( m_bRecord )
    {
-      CIOStandardJoypad::LOGGER(0)->AddSample ( CPU()->_CYCLES(), *(ljoy+CONTROLLER1) );
-      CIOStandardJoypad::LOGGER(1)->AddSample ( CPU()->_CYCLES(), *(ljoy+CONTROLLER2) );
+      CIOStandardJoypad::LOGGER(&m_io,0)->AddSample ( CPU()->_CYCLES(), *(ljoy+CONTROLLER1) );
+      CIOStandardJoypad::LOGGER(&m_io,1)->AddSample ( CPU()->_CYCLES(), *(ljoy+CONTROLLER2) );
    }
 
    if ( CONTROLLER(0) == IO_StandardJoypad )
    {
       if ( m_bReplay )
       {
-         pSample = CIOStandardJoypad::LOGGER(0)->GetSample ( m_frame );
+         pSample = CIOStandardJoypad::LOGGER(&m_io,0)->GetSample ( m_frame );
          *(ljoy+CONTROLLER1) |= (pSample->data);
       }
-      CIOStandardJoypad::JOY ( CONTROLLER1, *(ljoy+CONTROLLER1) );
+      CIOStandardJoypad::JOY ( &m_io, CONTROLLER1, *(ljoy+CONTROLLER1) );
    }
    else if ( CONTROLLER(0) == IO_TurboJoypad )
    {
       if ( m_bReplay )
       {
-         pSample = CIOTurboJoypad::LOGGER(0)->GetSample ( m_frame );
+         pSample = CIOTurboJoypad::LOGGER(&m_io,0)->GetSample ( m_frame );
          *(ljoy+CONTROLLER1) |= (pSample->data);
       }
-      CIOTurboJoypad::JOY ( CONTROLLER1, *(ljoy+CONTROLLER1) );
+      CIOTurboJoypad::JOY ( &m_io, CONTROLLER1, *(ljoy+CONTROLLER1) );
    }
    else if ( CONTROLLER(0) == IO_Zapper )
    {
-      CIOZapper::JOY ( CONTROLLER1, *(ljoy+CONTROLLER1) );
+      CIOZapper::JOY ( &m_io, CONTROLLER1, *(ljoy+CONTROLLER1) );
    }
    else if ( CONTROLLER(0) == IO_Vaus )
    {
-      CIOVaus::JOY ( CONTROLLER1, *(ljoy+CONTROLLER1) );
+      CIOVaus::JOY ( &m_io, CONTROLLER1, *(ljoy+CONTROLLER1) );
    }
    else
    {
-      CIOStandardJoypad::JOY ( CONTROLLER1, 0x00 );
+      CIOStandardJoypad::JOY ( &m_io, CONTROLLER1, 0x00 );
    }
 
    if ( CONTROLLER(1) == IO_StandardJoypad )
    {
       if ( m_bReplay )
       {
-         pSample = CIOStandardJoypad::LOGGER(1)->GetSample ( m_frame );
+         pSample = CIOStandardJoypad::LOGGER(&m_io,1)->GetSample ( m_frame );
          *(ljoy+CONTROLLER2) |= (pSample->data);
       }
-      CIOStandardJoypad::JOY ( CONTROLLER2, *(ljoy+CONTROLLER2) );
+      CIOStandardJoypad::JOY ( &m_io, CONTROLLER2, *(ljoy+CONTROLLER2) );
    }
    else if ( CONTROLLER(1) == IO_TurboJoypad )
    {
       if ( m_bReplay )
       {
-         pSample = CIOTurboJoypad::LOGGER(1)->GetSample ( m_frame );
+         pSample = CIOTurboJoypad::LOGGER(&m_io,1)->GetSample ( m_frame );
          *(ljoy+CONTROLLER2) |= (pSample->data);
       }
-      CIOTurboJoypad::JOY ( CONTROLLER2, *(ljoy+CONTROLLER2) );
+      CIOTurboJoypad::JOY ( &m_io, CONTROLLER2, *(ljoy+CONTROLLER2) );
    }
    else if ( CONTROLLER(1) == IO_Zapper )
    {
-      CIOZapper::JOY ( CONTROLLER2, *(ljoy+CONTROLLER2) );
+      CIOZapper::JOY ( &m_io, CONTROLLER2, *(ljoy+CONTROLLER2) );
    }
    else if ( CONTROLLER(1) == IO_Vaus )
    {
-      CIOVaus::JOY ( CONTROLLER2, *(ljoy+CONTROLLER2) );
+      CIOVaus::JOY ( &m_io, CONTROLLER2, *(ljoy+CONTROLLER2) );
    }
    else
    {
-      CIOStandardJoypad::JOY ( CONTROLLER2, 0x00 );
+      CIOStandardJoypad::JOY ( &m_io, CONTROLLER2, 0x00 );
    }
 
    // PPU cycles repeat...
@@ -948,7 +1075,7 @@ void CNES::RUN ( uint32_t* joy )
 
    m_frame = PPU()->_FRAME();
 
-   if ( nesIsDebuggable )
+   if ( DEBUGGABLE() )
    {
       m_tracer->SetFrame ( m_frame );
 
@@ -959,7 +1086,7 @@ void CNES::RUN ( uint32_t* joy )
    // Do scanline processing for scanlines 0 - 239 (the screen!)...
    PPU()->RENDERSCANLINE ( SCANLINES_VISIBLE );
 
-   if ( nesIsDebuggable )
+   if ( DEBUGGABLE() )
    {
       // Emit start-of-quiet scanline indication to Tracer...
       m_tracer->AddSample ( PPU()->_CYCLES(), eTracer_QuietStart, eNESSource_PPU, 0, 0, 0 );
@@ -968,7 +1095,7 @@ void CNES::RUN ( uint32_t* joy )
    // Emulate PPU resting scanlines...
    PPU()->QUIETSCANLINES ();
 
-   if ( nesIsDebuggable )
+   if ( DEBUGGABLE() )
    {
       // Emit end-of-quiet scanline indication to Tracer...
       m_tracer->AddSample ( PPU()->_CYCLES(), eTracer_QuietEnd, eNESSource_PPU, 0, 0, 0 );
@@ -981,7 +1108,7 @@ void CNES::RUN ( uint32_t* joy )
    // Emulate VBLANK non-render scanlines...
    PPU()->VBLANKSCANLINES ();
 
-   if ( nesIsDebuggable )
+   if ( DEBUGGABLE() )
    {
       // Emit end-VBLANK indication to Tracer...
       m_tracer->AddSample ( PPU()->_CYCLES(), eTracer_VBLANKEnd, eNESSource_PPU, 0, 0, 0 );
@@ -993,12 +1120,18 @@ void CNES::RUN ( uint32_t* joy )
    // Pre-render scanline...
    PPU()->RENDERSCANLINE ( -1 );
 
-   if ( nesIsDebuggable )
+   if ( DEBUGGABLE() )
    {
       // Emit end-of-prerender scanline indication to Tracer...
       m_tracer->AddSample ( PPU()->_CYCLES(), eTracer_PreRenderEnd, eNESSource_PPU, 0, 0, 0 );
 
       // Emit end-of-frame indication to Tracer...
       m_tracer->AddSample ( PPU()->_CYCLES(), eTracer_EndPPUFrame, eNESSource_PPU, 0, 0, 0 );
+
+      // Let the debuggers see this frame's trace...
+      m_tracer->Publish ();
+
+      // Close out this frame's cycle profile...
+      CPU()->PROFILER()->EndFrame ( CPU()->_CYCLES() );
    }
 }
@@ -1,9 +1,13 @@
 #if !defined ( NES_H )
 #define NES_H
 
+#include <atomic>
+
 #include "ctracer.h"
+#include "ccodedatalogger.h"
 #include "cjoypadlogger.h"
 #include "cnesbreakpointinfo.h"
+#include "cnesio.h"
 
 // The CNES class is the implementation of the NES as a complete
 // emulatable machine.  It contains a RUN method which is used
@@ -33,21 +37,21 @@
 //
 // The NES object also contains information regarding the replay
 // mode, which is used to record input sequences for testing.
+//
+// Every object that makes up the machine holds a pointer back to the
+// CNES object that owns it rather than relying on any process-wide
+// state, so any number of CNES objects can be created and run side
+// by side, each on its own thread if desired.
 class C6502;
 class CPPU;
 class CROM;
 class CAPU;
+class CNESSaveState;
 
 class CNES
 {   
-private:
-   CNES();
-   static CNES* self;
 public:
-   static inline CNES* NES()
-   {
-      return self;
-   }
+   CNES();
    ~CNES();
 
    inline CPPU* PPU() const
@@ -106,9 +110,30 @@ public:
       (*wy2) = m_windowY2;
    }
 
+   // Accessor methods to get/set which channels of the expansion audio
+   // hardware found on some cartridges are enabled.  The settings are
+   // kept here so that they survive a cartridge being swapped out.
+   inline void MMC5AUDIOMASK ( uint32_t mask ) { m_mmc5AudioMask = mask; }
+   inline uint32_t MMC5AUDIOMASK ( void ) const { return m_mmc5AudioMask; }
+   inline void VRC6AUDIOMASK ( uint32_t mask ) { m_vrc6AudioMask = mask; }
+   inline uint32_t VRC6AUDIOMASK ( void ) const { return m_vrc6AudioMask; }
+   inline void N106AUDIOMASK ( uint32_t mask ) { m_n106AudioMask = mask; }
+   inline uint32_t N106AUDIOMASK ( void ) const { return m_n106AudioMask; }
+
+   // Accessor method to retrieve the state of the controller ports.
+   inline IOState* IO ( void )
+   {
+      return &m_io;
+   }
+
    // This method initializes the cartridge object.
    void FRONTLOAD ( uint32_t mapper );
 
+   // Tells the CPU and PPU which mapper hooks the cartridge needs so that
+   // they skip the rest.  Done when the cartridge is created and whenever
+   // the mapper changes what it needs.
+   void BINDSYNC ( void );
+
    // This method performs a full NES reset and initializes
    // the ROM object with the appropriate mapper index.
    void RESET ( bool soft );
@@ -119,6 +144,16 @@ public:
    // intercepted keypress/keyrelease events in the UI.
    void RUN ( uint32_t* joy );
 
+   // These methods save or restore the complete emulation state of the
+   // machine to or from a flat buffer (see CNESSaveState).  SAVESTATE
+   // returns the size of the state, which is larger than size if the
+   // buffer was too small to hold it, or 0 if the machine is in a state
+   // that cannot be saved.  LOADSTATE checks the whole state
+   // against the loaded cartridge before touching anything and returns
+   // false, leaving the machine as it was, if it does not belong to it.
+   uint32_t SAVESTATE ( uint8_t* buffer, uint32_t size );
+   bool LOADSTATE ( const uint8_t* buffer, uint32_t size );
+
    // Accessor methods to get/set whether or not the emulation
    // engine is in replay mode.  In replay mode the emulation runs
    // as normal but the joypad inputs are fed in from previously
@@ -161,6 +196,30 @@ public:
       return m_tracer;
    }
 
+   // Accessor method to retrieve the state shared by the code/data
+   // loggers of this machine.
+   inline LoggerState* LOGGERSTATE ( void )
+   {
+      return &m_loggerState;
+   }
+
+   // Accessor method to retrieve the write generation the memories of
+   // this machine stamp their pages with.  Only a debugger looking at
+   // this machine advances it.
+   inline std::atomic<uint32_t>* MEMORYGENERATION ( void )
+   {
+      return &m_memoryGeneration;
+   }
+
+   // These methods get/set whether this machine is being debugged.  The
+   // debugger-only bookkeeping, such as logging, tracing and breakpoint
+   // checks, is only done while it is.
+   inline bool DEBUGGABLE ( void ) const
+   {
+      return m_bDebuggable;
+   }
+   void DEBUGGABLE ( bool enable ) { m_bDebuggable = enable; }
+
    // This method globally enables or disables breakpoints.  It is used
    // during an emulation hard-reset (which is caused whenever a new
    // ROM image is loaded) to prevent the emulation engine from getting
@@ -221,6 +280,16 @@ public:
    void PRINTABLEADDR ( char* buffer, uint32_t addr, uint32_t absAddr );
 
 protected:
+   void SERIALIZE ( CNESSaveState* state );
+
+   // Whether or not this machine is being debugged.  Declared ahead of
+   // the parts of the machine, as they may ask while being constructed.
+   bool m_bDebuggable;
+
+   // Write generation of this machine's memories, also declared ahead
+   // of the parts that stamp their memory with it when constructed.
+   std::atomic<uint32_t> m_memoryGeneration;
+
    C6502* m_cpu;
    CPPU*  m_ppu;
    CROM*  m_cart;
@@ -246,13 +315,28 @@ protected:
    int32_t  m_windowX2;
    int32_t  m_windowY2;
 
+   // Controller port state
+   IOState  m_io;
+
+   // Expansion audio channel enables
+   uint32_t m_mmc5AudioMask;
+   uint32_t m_vrc6AudioMask;
+   uint32_t m_n106AudioMask;
+
    // The execution tracer database.
    CTracer*         m_tracer;
 
+   // The state shared by the code/data loggers.
+   LoggerState      m_loggerState;
+
    // This is the database of active breakpoints.
-   CBreakpointInfo* m_breakpoints;
+   CNESBreakpointInfo* m_breakpoints;
    bool m_bBreakpointsEnabled;
 
+   // Whether or not any breakpoint was marked as hit by the last
+   // breakpoint check.  Hits are cleared on the next check.
+   bool m_bBreakpointsHit;
+
    // These flags determine the breakpoint state and behavior
    // of the emulation engine.
    bool            m_bAtBreakpoint;
@@ -21,8 +21,9 @@
 #include "cnesio.h"
 #include "cnesmappers.h"
 #include "cnesios.h"
+#include "cnessavestate.h"
 
-static int32_t opcode_size [ NUM_ADDRESSING_MODES ] =
+static const int32_t opcode_size [ NUM_ADDRESSING_MODES ] =
 {
    1, // AM_IMPLIED
    2, // AM_IMMEDIATE
@@ -56,7 +57,7 @@ static const char* operandFmt [ NUM_ADDRESSING_MODES ] =
    " $%02X"  // AM_RELATIVE
 };
 
-CNES6502_opcode C6502::m_6502opcode [ 256 ] =
+const CNES6502_opcode C6502::m_6502opcode [ 256 ] =
 {
    { 0x00, "BRK", &C6502::BRK, AM_IMPLIED, 7, true, false, 0x0 }, // BRK
    { 0x01, "ORA", &C6502::ORA, AM_PREINDEXED_INDIRECT, 6, true, false, 0x20 }, // ORA - (Indirect,X)
@@ -317,9 +318,9 @@ CNES6502_opcode C6502::m_6502opcode [ 256 ] =
 };
 
 C6502::C6502(CNES *pNES)
-   : m_apu(new CAPU()),
+   : m_apu(new CAPU(pNES)),
      m_nes(pNES),
-     m_6502memory(CMEMORY(0x0000, MEM_2KB, 1, 4))
+     m_6502memory(CMEMORY(pNES, 0x0000, MEM_2KB, 1, 4))
 {
    m_killed = false;              // KIL opcode not executed.
    m_breakOnKIL = false;          // IDE sets this for us.
@@ -343,8 +344,13 @@ C6502::C6502(CNES *pNES)
    m_cycles = 0;
    m_curCycles = 0;
 
+   m_syncCaps = SYNC_NONE;
+   m_eventCycle = 0;
+   m_eventScheduled = false;
+
    m_writeDmaAddr = 0x0000;
    m_writeDmaCounter = 0;
+   m_writeDmaData = 0x00;
    m_readDmaAddr = 0x0000;
    m_dmaRequest = -1;
    m_readDmaCounter = 0;
@@ -354,14 +360,20 @@ C6502::C6502(CNES *pNES)
    m_write = false;
    m_phase = 0;
 
-   pDisassemblySample = NULL;
+   m_brkVectorLo = 0x00;
+   m_brkDoingIrq = false;
+
+   disassemblySample = TRACER_NO_SAMPLE;
 
    m_marker = new CMarker;
+   m_profiler = new CProfiler;
 }
 
 C6502::~C6502()
 {
+   delete m_apu;
    delete m_marker;
+   delete m_profiler;
 }
 
 void C6502::EMULATE ( int32_t cycles )
@@ -398,10 +410,10 @@ void C6502::EMULATE ( int32_t cycles )
 
                   NES()->CHECKBREAKPOINT ( eBreakInCPU, eBreakOnCPUExecution, (*opcodeData) );
 
-                  // Save the pointer to where to put the disassembly of
+                  // Save the sample to put the disassembly of
                   // the current opcode now.  This might be the last fetch
                   // for an instruction and the disassembly should be placed there.
-                  pDisassemblySample = NES()->TRACER()->GetLastCPUSample ();
+                  disassemblySample = NES()->TRACER()->GetLastCPUSample ();
 
                   // Check flags breakpoint.  Do it here instead of everywhere flags are
                   // changed so as to limit the number of calls to check the breakpoint.
@@ -526,10 +538,10 @@ void C6502::EMULATE ( int32_t cycles )
                }
                else if (  m_phase == -1 )
                {
-                  if ( nesIsDebuggable )
+                  if ( NES()->DEBUGGABLE() )
                   {
                      // Update Tracer
-                     NES()->TRACER()->SetRegisters ( pDisassemblySample, rA(), rX(), rY(), rSP(), rF() );
+                     NES()->TRACER()->SetRegisters ( disassemblySample, rA(), rX(), rY(), rSP(), rF() );
                   }
 
                   if ( rPC() == m_pcGoto )
@@ -541,10 +553,10 @@ void C6502::EMULATE ( int32_t cycles )
                   // Execute
                   (this->*pOpcodeStruct->pFn)();
 
-                  if ( nesIsDebuggable )
+                  if ( NES()->DEBUGGABLE() )
                   {
                      // Update Tracer
-                     NES()->TRACER()->SetDisassembly ( pDisassemblySample, opcodeData );
+                     NES()->TRACER()->SetDisassembly ( disassemblySample, opcodeData );
 
                      // Check for undocumented breakpoint...
                      if ( pOpcodeStruct->documented )
@@ -642,7 +654,6 @@ void C6502::ADVANCE ( bool stealing )
 bool C6502::DMA( void )
 {
    bool doCycle = true;
-   static uint8_t databuf;
 
    // If the DMC DMA request is active it means the CPU was writing when
    // the DMC DMA controller went active.  We need to assert RDY on the next
@@ -706,7 +717,7 @@ bool C6502::DMA( void )
          m_readDmaCounter--;
          doCycle = false;
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for APU DMC channel DMA breakpoint event...
             NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_DMC_DMA);
@@ -725,9 +736,9 @@ bool C6502::DMA( void )
       // If we're ready to do the sprite DMA read, do it.
       if ( m_writeDmaCounter )
       {
-         databuf = DMA(m_writeDmaAddr|(((512-m_writeDmaCounter)>>1)&0xFF));
+         m_writeDmaData = DMA(m_writeDmaAddr|(((512-m_writeDmaCounter)>>1)&0xFF));
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for PPU cycle breakpoint...
             NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, (512-m_writeDmaCounter)>>1, PPU_EVENT_SPRITE_DMA );
@@ -793,7 +804,7 @@ bool C6502::DMA( void )
       {
          DMA ( (m_writeDmaAddr)|(((512-m_writeDmaCounter)>>1)&0xFF),
                OAMDATA,
-               databuf );
+               m_writeDmaData );
          m_writeDmaCounter--;
          doCycle = false;
          goto done;
@@ -844,7 +855,7 @@ bool C6502::DMA( void )
       // If this is a read-beat, do the read.
       if ( !(m_writeDmaCounter&0x01) )
       {
-         databuf = DMA(m_writeDmaAddr|(((512-m_writeDmaCounter)>>1)&0xFF));
+         m_writeDmaData = DMA(m_writeDmaAddr|(((512-m_writeDmaCounter)>>1)&0xFF));
          doCycle = false;
       }
       // If this is a write-beat, do the write.
@@ -852,7 +863,7 @@ bool C6502::DMA( void )
       {
          DMA ( (m_writeDmaAddr)|(((512-m_writeDmaCounter)>>1)&0xFF),
                OAMDATA,
-               databuf );
+               m_writeDmaData );
          doCycle = false;
       }
       m_writeDmaCounter--;
@@ -897,7 +908,7 @@ bool C6502::DMA( void )
       {
          if ( !(m_writeDmaCounter&1) )
          {
-            databuf = DMA(m_writeDmaAddr|(((512-m_writeDmaCounter)>>1)&0xFF));
+            m_writeDmaData = DMA(m_writeDmaAddr|(((512-m_writeDmaCounter)>>1)&0xFF));
             m_writeDmaCounter--;
             doCycle = false;
          }
@@ -906,7 +917,7 @@ bool C6502::DMA( void )
          {
             DMA ( (m_writeDmaAddr)|(((512-m_writeDmaCounter)>>1)&0xFF),
                   OAMDATA,
-                  databuf );
+                  m_writeDmaData );
             m_writeDmaCounter--;
             doCycle = false;
          }
@@ -1436,6 +1447,11 @@ void C6502::JSR ( void )
 
    wPC ( MAKE16(GETUNSIGNED8(data,0),GETUNSIGNED8(data,1)) );
 
+   if ( NES()->DEBUGGABLE() && m_profiler->IsEnabled() )
+   {
+      m_profiler->Call ( m_cycles, rPC(), NES()->PHYSADDR(rPC()), rSP(), false );
+   }
+
    if ( rPC() == m_pcGoto )
    {
       NES()->STEPCPUBREAKPOINT();
@@ -1665,6 +1681,11 @@ void C6502::RTI ( void )
    // Synchronize CPU and APU...
    MEM ( GETSTACKADDR() );
 
+   if ( NES()->DEBUGGABLE() && m_profiler->IsEnabled() )
+   {
+      m_profiler->Return ( m_cycles, rSP(), true );
+   }
+
    f = POP();
    pclo = POP ();
    pchi = POP ();
@@ -1942,6 +1963,11 @@ void C6502::RTS ( void )
    // Synchronize CPU and APU...
    MEM ( GETSTACKADDR() );
 
+   if ( NES()->DEBUGGABLE() && m_profiler->IsEnabled() )
+   {
+      m_profiler->Return ( m_cycles, rSP(), false );
+   }
+
    pclo = POP ();
    pchi = POP ();
 
@@ -3191,8 +3217,6 @@ void C6502::SED ( void )
 void C6502::BRK ( void )
 {
    uint8_t         pchi;
-   static uint8_t  pclo = 0x00;
-   static bool     doingIrq = false;
 
    if ( !m_killed )
    {
@@ -3209,26 +3233,26 @@ void C6502::BRK ( void )
          PUSH ( rF() );
          if ( m_nmiPending )
          {
-            doingIrq = false;
+            m_brkDoingIrq = false;
          }
          else
          {
-            doingIrq = true;
+            m_brkDoingIrq = true;
          }
       }
       else
       {
-         if ( m_nmiPending && !doingIrq )
+         if ( m_nmiPending && !m_brkDoingIrq )
          {
             if ( m_instrCycle == 5 )
             {
-               pclo = MEM(VECTOR_NMI);
+               m_brkVectorLo = MEM(VECTOR_NMI);
             }
             else if ( m_instrCycle == 6 )
             {
                pchi = MEM(VECTOR_NMI+1);
 
-               wPC ( MAKE16(pclo,pchi) );
+               wPC ( MAKE16(m_brkVectorLo,pchi) );
 
                if ( rPC() == m_pcGoto )
                {
@@ -3236,28 +3260,33 @@ void C6502::BRK ( void )
                   m_pcGoto = 0xFFFFFFFF;
                }
 
-               if ( nesIsDebuggable )
+               if ( NES()->DEBUGGABLE() )
                {
+                  if ( m_profiler->IsEnabled() )
+                  {
+                     m_profiler->Call ( m_cycles, rPC(), NES()->PHYSADDR(rPC()), rSP(), true );
+                  }
+
                   // Check for NMI breakpoint...
                   NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUEvent,0,CPU_EVENT_NMI_ENTERED);
                }
 
                sI();
                m_nmiPending = false;
-               doingIrq = false;
+               m_brkDoingIrq = false;
             }
          }
          else
          {
             if ( m_instrCycle == 5 )
             {
-               pclo = MEM(VECTOR_IRQ);
+               m_brkVectorLo = MEM(VECTOR_IRQ);
             }
             else if ( m_instrCycle == 6 )
             {
                pchi = MEM(VECTOR_IRQ+1);
 
-               wPC ( MAKE16(pclo,pchi) );
+               wPC ( MAKE16(m_brkVectorLo,pchi) );
 
                if ( rPC() == m_pcGoto )
                {
@@ -3265,15 +3294,20 @@ void C6502::BRK ( void )
                   m_pcGoto = 0xFFFFFFFF;
                }
 
-               if ( nesIsDebuggable )
+               if ( NES()->DEBUGGABLE() )
                {
+                  if ( m_profiler->IsEnabled() )
+                  {
+                     m_profiler->Call ( m_cycles, rPC(), NES()->PHYSADDR(rPC()), rSP(), true );
+                  }
+
                   // Check for IRQ breakpoint...
                   NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUEvent,0,CPU_EVENT_IRQ_ENTERED);
                }
 
                sI();
                m_irqPending = false;
-               doingIrq = false;
+               m_brkDoingIrq = false;
             }
          }
       }
@@ -3286,7 +3320,7 @@ void C6502::ASSERTIRQ ( int8_t source )
 {
    m_irqAsserted = true;
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       if ( source == eNESSource_Mapper )
       {
@@ -3304,7 +3338,7 @@ void C6502::ASSERTIRQ ( int8_t source )
 
 void C6502::RELEASEIRQ ( int8_t source )
 {
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       if ( source == eNESSource_Mapper )
       {
@@ -3322,7 +3356,7 @@ void C6502::ASSERTNMI ()
 {
    m_nmiAsserted = true;
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       NES()->TRACER()->AddNMI ( NES()->PPU()->_CYCLES(), eNESSource_PPU );
 
@@ -3346,6 +3380,11 @@ void C6502::RESET ( bool soft )
    m_curCycles = 0;
    m_phase = 0;
 
+   // The cartridge schedules again once everything is reset.
+   UNSCHEDULE ();
+
+   m_profiler->Restart ( m_cycles );
+
    m_dmaRequest = -1;
    m_writeDmaCounter = 0;
    m_readDmaCounter = 0;
@@ -3353,7 +3392,7 @@ void C6502::RESET ( bool soft )
    m_write = false;
 
    // Clear the disassembly sample...
-   pDisassemblySample = NULL;
+   disassemblySample = TRACER_NO_SAMPLE;
 
    m_irqAsserted = false;
    m_irqPending = false;
@@ -3397,13 +3436,69 @@ void C6502::RESET ( bool soft )
       m_6502memory.MEMCLR ();
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for RESET breakpoint...
       NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUEvent,0,CPU_EVENT_RESET);
    }
 }
 
+void C6502::SERIALIZE ( CNESSaveState* state )
+{
+   int16_t opcode;
+   int8_t  dataOffset;
+
+   state->BEGINCHUNK ( "CPU ", 1 );
+   m_6502memory.SERIALIZEBANKS ( state );
+   state->VALUE ( m_killed );
+   state->VALUE ( m_irqAsserted );
+   state->VALUE ( m_irqPending );
+   state->VALUE ( m_nmiAsserted );
+   state->VALUE ( m_nmiPending );
+   state->VALUE ( m_a );
+   state->VALUE ( m_x );
+   state->VALUE ( m_y );
+   state->VALUE ( m_f );
+   state->VALUE ( m_pc );
+   state->VALUE ( m_pcSync );
+   state->VALUE ( m_pcSyncSet );
+   state->VALUE ( m_sp );
+   state->VALUE ( m_ea );
+   state->VALUE ( m_cycles );
+   state->VALUE ( m_instrCycle );
+   state->VALUE ( m_curCycles );
+   state->VALUE ( amode );
+   state->VALUE ( m_dmaRequest );
+   state->VALUE ( m_writeDmaAddr );
+   state->VALUE ( m_writeDmaCounter );
+   state->VALUE ( m_writeDmaData );
+   state->VALUE ( m_readDmaAddr );
+   state->VALUE ( m_readDmaCounter );
+   state->VALUE ( opcodeData );
+   state->VALUE ( opcodeSize );
+   state->VALUE ( m_write );
+   state->VALUE ( m_brkVectorLo );
+   state->VALUE ( m_brkDoingIrq );
+   state->VALUE ( m_openBusData );
+   state->VALUE ( m_phase );
+
+   // The decoded opcode is kept as pointers into the opcode table and
+   // the opcode buffer, so store where they point instead.
+   opcode = pOpcodeStruct?(pOpcodeStruct-m_6502opcode):-1;
+   dataOffset = data?(data-opcodeData):-1;
+   state->VALUE ( opcode );
+   state->VALUE ( dataOffset );
+   if ( state->LOADING() )
+   {
+      pOpcodeStruct = (opcode >= 0)?m_6502opcode+(opcode&0xFF):NULL;
+      data = (dataOffset >= 0)?opcodeData+(dataOffset&0x03):NULL;
+
+      // The cartridge, which is loaded last, schedules again.
+      UNSCHEDULE ();
+   }
+   state->ENDCHUNK ();
+}
+
 uint8_t C6502::LOAD ( uint32_t addr, int8_t* pTarget )
 {
    uint8_t data = C6502::OPENBUS();
@@ -3450,12 +3545,12 @@ uint8_t C6502::LOAD ( uint32_t addr, int8_t* pTarget )
       if ( addr == 0x4016 )
       {
          (*pTarget) = eTarget_IORegister;
-         data = iofunc[NES()->CONTROLLER(CONTROLLER1)].emuread(addr);
+         data = iofunc[NES()->CONTROLLER(CONTROLLER1)].emuread(NES()->IO(),addr);
       }
       else if ( addr == 0x4017 )
       {
          (*pTarget) = eTarget_IORegister;
-         data = iofunc[NES()->CONTROLLER(CONTROLLER2)].emuread(addr);
+         data = iofunc[NES()->CONTROLLER(CONTROLLER2)].emuread(NES()->IO(),addr);
       }
       // Otherwise if not accessing a controller port, use default...
       else
@@ -3466,7 +3561,15 @@ uint8_t C6502::LOAD ( uint32_t addr, int8_t* pTarget )
    }
 
    // Synchronize CPU and CART...
-   NES()->CART()->SYNCCPU(false,addr,data);
+   if ( m_syncCaps&SYNC_CPU_CYCLE )
+   {
+      NES()->CART()->SYNCCPU(false,addr,data);
+   }
+   if ( m_eventScheduled && ((int32_t)(m_cycles-m_eventCycle) >= 0) )
+   {
+      m_eventScheduled = false;
+      NES()->CART()->CPUEVENT();
+   }
 
    return data;
 }
@@ -3491,8 +3594,8 @@ void C6502::STORE ( uint32_t addr, uint8_t data, int8_t* pTarget )
          (*pTarget) = eTarget_IORegister;
 
          // Writes to $4016 need to be given to all controllers.
-         iofunc[NES()->CONTROLLER(CONTROLLER1)].emuwrite(addr,data);
-         iofunc[NES()->CONTROLLER(CONTROLLER2)].emuwrite(addr,data);
+         iofunc[NES()->CONTROLLER(CONTROLLER1)].emuwrite(NES()->IO(),addr,data);
+         iofunc[NES()->CONTROLLER(CONTROLLER2)].emuwrite(NES()->IO(),addr,data);
       }
       else if ( addr == 0x4014 )
       {
@@ -3536,7 +3639,15 @@ void C6502::STORE ( uint32_t addr, uint8_t data, int8_t* pTarget )
    }
 
    // Synchronize CPU and CART...
-   NES()->CART()->SYNCCPU(true,addr,data);
+   if ( m_syncCaps&SYNC_CPU_CYCLE )
+   {
+      NES()->CART()->SYNCCPU(true,addr,data);
+   }
+   if ( m_eventScheduled && ((int32_t)(m_cycles-m_eventCycle) >= 0) )
+   {
+      m_eventScheduled = false;
+      NES()->CART()->CPUEVENT();
+   }
 }
 
 uint8_t C6502::FETCH ()
@@ -3550,7 +3661,7 @@ uint8_t C6502::FETCH ()
 
    // Set effective address.
    wEA ( rPC() );
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       NES()->TRACER()->SetEffectiveAddress ( NES()->TRACER()->GetLastCPUSample(), rEA() );
    }
@@ -3563,7 +3674,7 @@ uint8_t C6502::FETCH ()
    // Store data to return as open-bus.
    m_openBusData = data;
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Add Tracer sample...
       if ( instrCycle == 0 )
@@ -3583,11 +3694,11 @@ uint8_t C6502::FETCH ()
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( rPC() );
          if ( instrCycle == 0 )
          {
-            pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
+            pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
          }
          else
          {
-            pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+            pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
          }
 
          // Update Markers...
@@ -3602,11 +3713,11 @@ uint8_t C6502::FETCH ()
          CCodeDataLogger* pLogger = NES()->CART()->SRAMLOGGERVIRT ( rPC() );
          if ( instrCycle == 0 )
          {
-            pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
+            pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
          }
          else
          {
-            pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+            pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
          }
 
          // Update opcode masking for disassembler...
@@ -3618,11 +3729,11 @@ uint8_t C6502::FETCH ()
          CCodeDataLogger* pLogger = NES()->CART()->EXRAMLOGGER ();
          if ( instrCycle == 0 )
          {
-            pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
+            pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
          }
          else
          {
-            pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+            pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
          }
 
          // Update opcode masking for disassembler...
@@ -3632,11 +3743,11 @@ uint8_t C6502::FETCH ()
       {
          if ( instrCycle == 0 )
          {
-            m_6502memory.LOGGER()->LogAccess ( m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
+            m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_InstructionFetch, eNESSource_CPU );
          }
          else
          {
-            m_6502memory.LOGGER()->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+            m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
          }
 
          // ... and update opcode masking for disassembler...
@@ -3657,7 +3768,7 @@ uint8_t C6502::EXTRAFETCH ()
 
    // Set effective address.
    wEA ( rPC() );
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       NES()->TRACER()->SetEffectiveAddress ( NES()->TRACER()->GetLastCPUSample(), rEA() );
    }
@@ -3667,7 +3778,7 @@ uint8_t C6502::EXTRAFETCH ()
 
    data = LOAD ( rPC(), &target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Add Tracer sample...
       NES()->TRACER()->AddSample ( m_cycles, eTracer_OperandFetch, eNESSource_CPU, target, rPC(), data );
@@ -3677,23 +3788,23 @@ uint8_t C6502::EXTRAFETCH ()
       if ( target == eTarget_Mapper )
       {
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( rPC() );
-         pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
       }
       else if ( target == eTarget_SRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->SRAMLOGGERVIRT ( rPC() );
-         pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
       }
       else if ( target == eTarget_EXRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->EXRAMLOGGER ();
-         pLogger->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
       }
       else if ( target == eTarget_RAM )
       {
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, rPC(), data, eLogger_OperandFetch, eNESSource_CPU );
       }
 #endif
    }
@@ -3714,7 +3825,7 @@ uint8_t C6502::DMA ( uint32_t addr )
 
    data = LOAD ( addr, &target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Add Tracer sample...
       NES()->TRACER()->AddSample ( m_cycles, eTracer_DMA, eNESSource_CPU, target, addr, data );
@@ -3724,11 +3835,11 @@ uint8_t C6502::DMA ( uint32_t addr )
            (addr >= MEM_32KB) )
       {
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DMA, eNESSource_APU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DMA, eNESSource_APU );
       }
       else if ( target == eTarget_RAM )
       {
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DMA, eNESSource_APU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DMA, eNESSource_APU );
       }
 
       // Check for breakpoint...
@@ -3740,7 +3851,7 @@ uint8_t C6502::DMA ( uint32_t addr )
 
 void C6502::DMA ( uint32_t srcAddr, uint32_t dstAddr, uint8_t data )
 {
-   TracerInfo* pSample = NULL;
+   TracerSample sample = TRACER_NO_SAMPLE;
    int8_t target = -1;
 
    // Writing...
@@ -3749,35 +3860,35 @@ void C6502::DMA ( uint32_t srcAddr, uint32_t dstAddr, uint8_t data )
    // Synchronize CPU and APU...
    ADVANCE ( true );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Store unknown target because otherwise the trace will be out of order...
-      pSample = NES()->TRACER()->AddSample ( m_cycles, eTracer_DMA, eNESSource_CPU, target, dstAddr, data );
+      sample = NES()->TRACER()->AddSample ( m_cycles, eTracer_DMA, eNESSource_CPU, target, dstAddr, data );
    }
 
    STORE ( dstAddr, data, &target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // If ROM or RAM is being accessed, log code/data logger...
       if ( srcAddr >= MEM_32KB )
       {
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( srcAddr );
-         pLogger->LogAccess ( m_cycles, srcAddr, data, eLogger_DMA, eNESSource_PPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, srcAddr, data, eLogger_DMA, eNESSource_PPU );
       }
       else if ( srcAddr < MEM_8KB )
       {
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, srcAddr, data, eLogger_DMA, eNESSource_PPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, srcAddr, data, eLogger_DMA, eNESSource_PPU );
       }
    }
 
    // Store real target...
-   if ( pSample )
+   if ( sample != TRACER_NO_SAMPLE )
    {
-      pSample->target = target;
+      NES()->TRACER()->SetTarget ( sample, target );
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for breakpoint...
       NES()->CHECKBREAKPOINT ( eBreakInCPU, eBreakOnCPUMemoryWrite, data );
@@ -3794,7 +3905,7 @@ uint8_t C6502::MEM ( uint32_t addr )
 
    // Set effective address.
    wEA ( addr );
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       NES()->TRACER()->SetEffectiveAddress ( NES()->TRACER()->GetLastCPUSample(), rEA() );
    }
@@ -3804,7 +3915,7 @@ uint8_t C6502::MEM ( uint32_t addr )
 
    data = LOAD ( addr, &target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Add Tracer sample...
       NES()->TRACER()->AddSample ( m_cycles, eTracer_DataRead, eNESSource_CPU, target, addr, data );
@@ -3814,30 +3925,30 @@ uint8_t C6502::MEM ( uint32_t addr )
            (addr >= MEM_32KB) )
       {
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else if ( target == eTarget_SRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->SRAMLOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else if ( target == eTarget_EXRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->EXRAMLOGGER ();
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else if ( target == eTarget_RAM )
       {
          // Log to Code/Data Logger...
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else
       {
          // Registers...
          // Log to Code/Data Logger...
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
 
       // Check for breakpoint...
@@ -3849,7 +3960,7 @@ uint8_t C6502::MEM ( uint32_t addr )
 
 void C6502::MEM ( uint32_t addr, uint8_t data )
 {
-   TracerInfo* pSample = NULL;
+   TracerSample sample = TRACER_NO_SAMPLE;
    int8_t target;
 
    // Writing...
@@ -3857,7 +3968,7 @@ void C6502::MEM ( uint32_t addr, uint8_t data )
 
    // Set effective address.
    wEA ( addr );
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       NES()->TRACER()->SetEffectiveAddress ( NES()->TRACER()->GetLastCPUSample(), rEA() );
    }
@@ -3865,54 +3976,54 @@ void C6502::MEM ( uint32_t addr, uint8_t data )
    // Synchronize CPU and APU...
    ADVANCE ();
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Store unknown target because otherwise the trace will be out of order...
-      pSample = NES()->TRACER()->AddSample ( m_cycles, eTracer_DataWrite, eNESSource_CPU, 0, addr, data );
+      sample = NES()->TRACER()->AddSample ( m_cycles, eTracer_DataWrite, eNESSource_CPU, 0, addr, data );
    }
 
    STORE ( addr, data, &target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // If ROM or RAM is being accessed, log code/data logger...
       if ( (target == eTarget_Mapper) &&
            (addr >= MEM_32KB) )
       {
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
       }
       else if ( target == eTarget_SRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->SRAMLOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
       }
       else if ( target == eTarget_EXRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->EXRAMLOGGER ();
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
       }
       else if ( target == eTarget_RAM )
       {
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
       }
       else
       {
          // Registers...
          // Log to Code/Data Logger...
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataWrite, eNESSource_CPU );
       }
    }
 
    // Store real target...
-   if ( pSample )
+   if ( sample != TRACER_NO_SAMPLE )
    {
-      pSample->target = target;
+      NES()->TRACER()->SetTarget ( sample, target );
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for breakpoint...
       NES()->CHECKBREAKPOINT ( eBreakInCPU, eBreakOnCPUMemoryWrite, data );
@@ -3929,7 +4040,7 @@ uint8_t C6502::STEAL ( uint32_t addr, uint8_t source )
 
    // Set effective address.
    wEA ( addr );
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       NES()->TRACER()->SetEffectiveAddress ( NES()->TRACER()->GetLastCPUSample(), rEA() );
    }
@@ -3939,7 +4050,7 @@ uint8_t C6502::STEAL ( uint32_t addr, uint8_t source )
 
    data = LOAD ( addr, &target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Add Tracer sample...
       NES()->TRACER()->AddStolenCycle ( m_cycles, source );
@@ -3949,30 +4060,30 @@ uint8_t C6502::STEAL ( uint32_t addr, uint8_t source )
            (addr >= MEM_32KB) )
       {
          CCodeDataLogger* pLogger = NES()->CART()->LOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else if ( target == eTarget_SRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->SRAMLOGGERVIRT ( addr );
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else if ( target == eTarget_EXRAM )
       {
          // Log to Code/Data Logger...
          CCodeDataLogger* pLogger = NES()->CART()->EXRAMLOGGER ();
-         pLogger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         pLogger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else if ( target == eTarget_RAM )
       {
          // Log to Code/Data Logger...
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
       else
       {
          // Registers...
          // Log to Code/Data Logger...
-         m_6502memory.LOGGER()->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
+         m_6502memory.LOGGER()->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_CPU );
       }
 
       // Check stolen cycles breakpoint.
@@ -4078,88 +4189,86 @@ void C6502::DISASSEMBLE ()
    }
 }
 
-void C6502::DISASSEMBLE ( char** disassembly, uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, uint16_t* sloc2addr, uint16_t* addr2sloc, uint32_t* sourceLength )
+int32_t C6502::LINESIZE ( uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, int32_t addr )
 {
-   CNES6502_opcode* pOp;
-   int32_t opSize;
-   uint8_t op;
-   char* ptr;
-   uint8_t mask;
-
-   (*sourceLength) = 0;
+   int32_t opSize = *(opcode_size+(m_6502opcode+(*(binary+addr)))->amode);
 
-   for ( int32_t i = 0; i < binaryLength; )
+   // If we've discovered this address has been executed by the 6502 we'll
+   // attempt to provide disassembly for it, and all of its bytes belong
+   // to the one source line...
+   if ( (*(opcodeMask+addr)) && ((addr+opSize) < binaryLength) )
    {
-      op = *(binary+i);
-      pOp = m_6502opcode+op;
-      opSize = *(opcode_size+pOp->amode);
+      return opSize;
+   }
+   return 1;
+}
 
-      mask = *(opcodeMask+i);
+void C6502::SLOCMAP ( uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, uint16_t* sloc2addr, uint16_t* addr2sloc, uint32_t* sourceLength )
+{
+   int32_t opSize;
+   int32_t i;
 
-      ptr = (*disassembly);
+   (*sourceLength) = 0;
 
+   for ( i = 0; i < binaryLength; )
+   {
       // save sloc
       (*sloc2addr) = i;
       sloc2addr++;
-      (*addr2sloc) = (*sourceLength);
-      addr2sloc++;
 
-      // If we've discovered this address has been executed by the 6502 we'll
-      // attempt to provide disassembly for it...
-      if ( (mask) && ((i+opSize) < binaryLength) )
+      for ( opSize = LINESIZE(binary,binaryLength,opcodeMask,i); opSize; opSize--, i++ )
       {
-         sprintf_opcode ( ptr, pOp->name );
+         (*addr2sloc) = (*sourceLength);
+         addr2sloc++;
+      }
 
-         switch ( pOp->amode )
-         {
-               // Single byte operands
-            case AM_IMMEDIATE:
-            case AM_ZEROPAGE_INDEXED_X:
-            case AM_ZEROPAGE_INDEXED_Y:
-            case AM_ZEROPAGE:
-            case AM_PREINDEXED_INDIRECT:
-            case AM_POSTINDEXED_INDIRECT:
-            case AM_RELATIVE:
-               ptr += sprintf ( ptr, operandFmt[pOp->amode], binary[i+1] );
-               break;
-
-               // Two byte operands
-            case AM_ABSOLUTE:
-            case AM_ABSOLUTE_INDEXED_X:
-            case AM_ABSOLUTE_INDEXED_Y:
-            case AM_INDIRECT:
-               ptr += sprintf ( ptr, operandFmt[pOp->amode], binary[i+2], binary[i+1] );
-               break;
-         }
+      (*sourceLength)++;
+   }
+}
 
-         if ( opSize > 2 )
-         {
-            strcpy((*(disassembly+2)), (*disassembly));
-            (*addr2sloc) = (*sourceLength);
-            addr2sloc++;
-         }
+char* C6502::DISASSEMBLELINE ( char* buffer, uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, int32_t addr )
+{
+   const CNES6502_opcode* pOp = m_6502opcode+(*(binary+addr));
+   const char* name;
+   int32_t opSize = *(opcode_size+pOp->amode);
+   char* ptr = buffer;
 
-         if ( opSize > 1 )
-         {
-            strcpy((*(disassembly+1)), (*disassembly));
-            (*addr2sloc) = (*sourceLength);
-            addr2sloc++;
-         }
+   if ( (*(opcodeMask+addr)) && ((addr+opSize) < binaryLength) )
+   {
+      // Walk a copy of the name pointer so the shared opcode table
+      // is never written.
+      name = pOp->name;
+      sprintf_opcode ( ptr, name );
 
-         i += opSize;
-         disassembly += opSize;
-      }
-      else
+      switch ( pOp->amode )
       {
-         sprintf_db(ptr);
-         sprintf_02x(ptr,binary[i]);
-
-         i++;
-         disassembly++;
+            // Single byte operands
+         case AM_IMMEDIATE:
+         case AM_ZEROPAGE_INDEXED_X:
+         case AM_ZEROPAGE_INDEXED_Y:
+         case AM_ZEROPAGE:
+         case AM_PREINDEXED_INDIRECT:
+         case AM_POSTINDEXED_INDIRECT:
+         case AM_RELATIVE:
+            sprintf ( ptr, operandFmt[pOp->amode], binary[addr+1] );
+            break;
+
+            // Two byte operands
+         case AM_ABSOLUTE:
+         case AM_ABSOLUTE_INDEXED_X:
+         case AM_ABSOLUTE_INDEXED_Y:
+         case AM_INDIRECT:
+            sprintf ( ptr, operandFmt[pOp->amode], binary[addr+2], binary[addr+1] );
+            break;
       }
-
-      (*sourceLength)++;
    }
+   else
+   {
+      sprintf_db(ptr);
+      sprintf_02x(ptr,binary[addr]);
+   }
+
+   return buffer;
 }
 
 void C6502::PRINTABLEADDR ( char* buffer, uint32_t addr )
@@ -4175,7 +4284,7 @@ void C6502::PRINTABLEADDR ( char* buffer, uint32_t addr, uint32_t absAddr )
 char* DISASSEMBLE ( uint8_t* pOpcode, char* buffer )
 {
    char* lbuffer = buffer;
-   CNES6502_opcode* pOp = C6502::m_6502opcode+(*pOpcode);
+   const CNES6502_opcode* pOp = C6502::m_6502opcode+(*pOpcode);
 
    if ( pOp->documented )
    {
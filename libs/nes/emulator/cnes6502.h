@@ -8,6 +8,7 @@
 
 #include "cmemory.h"
 #include "cmarker.h"
+#include "cprofiler.h"
 #include "ctracer.h"
 #include "ccodedatalogger.h"
 
@@ -42,14 +43,14 @@
 
 // CPU program counter manipulation macros.
 #define rPC() (uint32_t)(m_pc)
-#define wPC(pc) { m_pc = (pc); CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_PC); }
-#define INCPC() { m_pc++; CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_PC); }
+#define wPC(pc) { m_pc = (pc); NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_PC); }
+#define INCPC() { m_pc++; NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_PC); }
 
 // CPU stack pointer manipulation macros.
 #define rSP() (m_sp)
 #define wSP(sp) { m_sp = (sp); }
-#define DECSP() { m_sp--;  CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_SP); }
-#define INCSP() { m_sp++;  CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_SP); }
+#define DECSP() { m_sp--;  NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_SP); }
+#define INCSP() { m_sp++;  NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_SP); }
 #define PUSH(data) { MEM(GETSTACKADDR(),(data)); DECSP(); }
 
 // The effective address is the calculated address for a
@@ -67,9 +68,9 @@
 #define rA() (m_a)
 #define rX() (m_x)
 #define rY() (m_y)
-#define wA(a) { m_a = (a); CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_A); }
-#define wX(x) { m_x = (x); CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_X); }
-#define wY(y) { m_y = (y); CNES::NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_Y); }
+#define wA(a) { m_a = (a); NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_A); }
+#define wX(x) { m_x = (x); NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_X); }
+#define wY(y) { m_y = (y); NES()->CHECKBREAKPOINT(eBreakInCPU,eBreakOnCPUState,CPU_Y); }
 
 // CPU flags register manipulation macros.  Used by instructions
 // that manipulate the flags register as a complete set rather than
@@ -112,6 +113,7 @@
 
 class CMEMORY;
 class CNES;
+class CNESSaveState;
 
 // The C6502 class is the implementation of the core CPU of the NES.
 // It provides CPU-fetch-cycle granular emulation of the CPU core, including
@@ -166,6 +168,9 @@ public:
    // CPU reset vector routine.
    void RESET ( bool soft );
 
+   // Save state support.
+   void SERIALIZE ( CNESSaveState* state );
+
    // Routines to manipulate the IRQ/NMI inputs to the CPU core.
    void ASSERTIRQ ( int8_t source );
    void RELEASEIRQ ( int8_t source );
@@ -179,7 +184,7 @@ public:
       m_nmiAsserted = false;
    }
 
-   static struct _CNES6502_opcode m_6502opcode[256];
+   static const struct _CNES6502_opcode m_6502opcode[256];
 
    // The CPU BRK instruction and also the handler routines for
    // NMI and IRQ interrupts, since the behavior of BRK, IRQ, and NMI
@@ -288,6 +293,18 @@ public:
    // Modify the contents of a memory location visible to the CPU.
    void _MEM ( uint32_t addr, uint8_t data );
 
+   // Return whether or not the contents of memory locations visible to
+   // the CPU may have changed in the given write generation or a later
+   // one.  Only the CPU's own RAM is tracked.
+   bool _MEMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+   {
+      if ( addr+length <= 0x2000 )
+      {
+         return m_6502memory.CHANGEDSINCE(addr,length,generation);
+      }
+      return true;
+   }
+
    // Return whether or not the CPU is currently in the middle of
    // the first cycle of an instruction fetch (the opcode fetch).
    bool _SYNC ( void )
@@ -314,6 +331,26 @@ public:
    // Method to return the current open bus data.
    uint8_t OPENBUS () { return m_openBusData; }
 
+   // Which mapper hooks LOAD and STORE call; set by CNES::BINDSYNC.
+   inline void SYNCCAPS ( uint32_t caps )
+   {
+      m_syncCaps = caps;
+   }
+
+   // A mapper whose IRQ counter only counts CPU cycles works out when it
+   // next fires and has CPUEVENT called at the end of the bus access of
+   // that cycle, instead of SYNCCPU on every one.  Only one event is
+   // pending at a time; scheduling replaces it.
+   inline void SCHEDULE ( uint32_t cycle )
+   {
+      m_eventCycle = cycle;
+      m_eventScheduled = true;
+   }
+   inline void UNSCHEDULE ( void )
+   {
+      m_eventScheduled = false;
+   }
+
    // DMA driver method.
    bool DMA ( void );
 
@@ -469,6 +506,15 @@ public:
       return m_marker;
    }
 
+   // Interface to retrieve the cycle profile.  While it is enabled the
+   // CPU core tells the profiler about each JSR, RTS, RTI and interrupt
+   // so that it can charge cycles to the routines on the call stack.
+   // The Code Profiler debugger inspector displays this database.
+   CProfiler* PROFILER()
+   {
+      return m_profiler;
+   }
+
    // Disassembly routines for display.
    void DISASSEMBLE ();
 
@@ -524,7 +570,13 @@ public:
       return (512-m_writeDmaCounter)>>1;
    }
 
-   void DISASSEMBLE ( char** disassembly, uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, uint16_t* sloc2addr, uint16_t* addr2sloc, uint32_t* sourceLength );
+   // Inline disassembly of a bank of memory.  SLOCMAP works out where each
+   // source line starts: an instruction where the opcode mask shows one
+   // was fetched, otherwise a byte of data.  LINESIZE is the number of
+   // bytes in the line that starts at addr, and DISASSEMBLELINE prints it.
+   static int32_t LINESIZE ( uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, int32_t addr );
+   static void SLOCMAP ( uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, uint16_t* sloc2addr, uint16_t* addr2sloc, uint32_t* sourceLength );
+   static char* DISASSEMBLELINE ( char* buffer, uint8_t* binary, int32_t binaryLength, uint8_t* opcodeMask, int32_t addr );
    void PRINTABLEADDR ( char* buffer, uint32_t addr );
    void PRINTABLEADDR ( char* buffer, uint32_t addr, uint32_t absAddr );
 
@@ -589,6 +641,13 @@ protected:
    uint32_t    m_cycles;
    int32_t     m_instrCycle;
 
+   // SYNC_ flags of the cartridge that concern the CPU.
+   uint32_t    m_syncCaps;
+
+   // Cycle of the pending mapper event, if one is scheduled.
+   uint32_t    m_eventCycle;
+   bool        m_eventScheduled;
+
    // The current number of CPU cycles ready to be executed by
    // the CPU core.
    int32_t             m_curCycles; // must be allowed to go negative!
@@ -611,6 +670,10 @@ protected:
    uint16_t m_writeDmaAddr;
    int32_t m_writeDmaCounter;
 
+   // The byte read on the read-beat of a sprite DMA transfer, waiting
+   // to be written to OAM on the following write-beat.
+   uint8_t m_writeDmaData;
+
    // DMA address for DMA read transfers.  The APU sets this on a DMA
    // request for a DMC channel sample, then begins its DMA transfer at the
    // appropriate time.  When not DMAing the counter will be 0.
@@ -622,7 +685,7 @@ protected:
    uint8_t   opcodeData [ 4 ]; // 3 opcode bytes and 1 byte for operand return data [extra cycle]
 
    // The current opcode's table entry (see struct _CNES6502_opcode below).
-   struct _CNES6502_opcode* pOpcodeStruct;
+   const struct _CNES6502_opcode* pOpcodeStruct;
 
    // The size of the current opcode in bytes (1, 2, or 3).
    int32_t             opcodeSize;
@@ -630,6 +693,10 @@ protected:
    // Whether or not the CPU is in a write memory cycle.
    bool            m_write;
 
+   // Interrupt vector fetch state carried between the cycles of BRK.
+   uint8_t         m_brkVectorLo;
+   bool            m_brkDoingIrq;
+
    // Open bus data to be returned if reading an unconnected memory region.
    uint8_t m_openBusData;
 
@@ -640,16 +707,19 @@ protected:
    // Then m_phase goes to -1 for the instruction execution.
    int8_t            m_phase;
 
-   // This points to the last execution tracer tag that
+   // This is the last execution tracer sample, which
    // is where the disassembly of the instruction should
    // be placed.
-   TracerInfo* pDisassemblySample;
+   TracerSample disassemblySample;
 
    // Database used by the Execution Visualizer debugger inspector.
    // The data structure is maintained by the CPU core as it executes
    // instructions that are marked.
    CMarker*         m_marker;
 
+   // Database used by the Code Profiler debugger inspector.
+   CProfiler*       m_profiler;
+
    // Configuration from EmulatorPrefs.
    bool m_breakOnKIL;
 };
@@ -17,9 +17,11 @@
 #include "cnesapu.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
+#include "cnessavestate.h"
 
 //#define OUTPUT_WAV
 
+#if defined ( OUTPUT_WAV )
 FILE* wavOut = NULL;
 int   wavOutFileNum = 1;
 char wavOutName [ 100 ];
@@ -50,6 +52,7 @@ typedef struct
 wavHdr wavOutHdr;
 wavChunkHdr wavChunk;
 wavFmtChunk wavFmt;
+#endif
 
 // Events that can occur during the APU sequence stepping
 enum
@@ -59,7 +62,7 @@ enum
    APU_SEQ_CLK_ENVELOPE_CTR = 0x04
 };
 
-static int32_t m_seq4 [ 4 ] =
+static const int32_t m_seq4 [ 4 ] =
 {
    APU_SEQ_CLK_ENVELOPE_CTR,
    APU_SEQ_CLK_ENVELOPE_CTR|APU_SEQ_CLK_LENGTH_CTR,
@@ -67,7 +70,7 @@ static int32_t m_seq4 [ 4 ] =
    APU_SEQ_CLK_ENVELOPE_CTR|APU_SEQ_CLK_LENGTH_CTR|APU_SEQ_INT_FLAG,
 };
 
-static int32_t m_seq5 [ 5 ] =
+static const int32_t m_seq5 [ 5 ] =
 {
    APU_SEQ_CLK_ENVELOPE_CTR|APU_SEQ_CLK_LENGTH_CTR,
    APU_SEQ_CLK_ENVELOPE_CTR,
@@ -76,7 +79,7 @@ static int32_t m_seq5 [ 5 ] =
    0
 };
 
-static uint8_t m_lengthLUT [ 32 ] =
+static const uint8_t m_lengthLUT [ 32 ] =
 {
    0x0A,
    0xFE,
@@ -112,9 +115,8 @@ static uint8_t m_lengthLUT [ 32 ] =
    0x1E
 };
 
-int32_t apuDataAvailable = 0;
-
-CAPU::CAPU()
+CAPU::CAPU(CNES* pNES)
+   : m_nes(pNES)
 {
    memset(m_APUreg,0,sizeof(m_APUreg));
    memset(m_APUregDirty,1,sizeof(m_APUreg));
@@ -128,8 +130,13 @@ CAPU::CAPU()
    m_cycles = 0;
 
    m_sampleSpacer = 0.0;
+   m_takeSample = 0.0f;
+
+   m_outLast = 0;
+   m_outDownsampled = 0;
 
    m_sampleBufferSize = APU_BUFFER_SIZE;
+   m_samplesAvailable = 0;
 
    m_sequencerMode = 0;
    m_newSequencerMode = 0;
@@ -162,6 +169,22 @@ CAPU::CAPU()
 
    // Default for sanity.
    MACHINE_SPECIFIC_EMULATE = &CAPU::EMULATE_NTSC_DENDY;
+
+   MIXERINIT();
+
+#if defined ( NES_BLIP_BUFFER )
+   m_blipBuffer.set_sample_rate ( SDL_SAMPLE_RATE );
+   m_blipBuffer.clock_rate ( (long)(SDL_SAMPLE_RATE*APU_SAMPLE_SPACE_NTSC) );
+   m_blipSynth.volume ( 1.0 );
+   m_blipTime = 0;
+   m_blipAmp = 0;
+   m_blipMapperAmp = 0;
+#endif
+}
+
+CAPU::~CAPU()
+{
+   delete [] m_waveBuf;
 }
 
 uint8_t* CAPU::PLAY ( uint16_t samples )
@@ -182,27 +205,70 @@ uint8_t* CAPU::PLAY ( uint16_t samples )
    m_waveBufConsume += samples;
    m_waveBufConsume %= m_sampleBufferSize;
 
-   apuDataAvailable -= samples;
+   m_samplesAvailable -= samples;
 
    return (uint8_t*)waveBuf;
 }
 
 uint16_t CAPU::AMPLITUDE ( void )
 {
-   float famp;
-   int16_t amp;
-   int16_t delta;
-   static int16_t outLast = 0;
+   int32_t amp = 0;
    uint8_t sample;
+   uint8_t samples = m_square[0].GETDACSAMPLECOUNT();
    uint8_t* sq1dacSamples = m_square[0].GETDACSAMPLES();
    uint8_t* sq2dacSamples = m_square[1].GETDACSAMPLES();
    uint8_t* triangleDacSamples = m_triangle.GETDACSAMPLES();
    uint8_t* noiseDacSamples = m_noise.GETDACSAMPLES();
    uint8_t* dmcDacSamples = m_dmc.GETDACSAMPLES();
-   static int32_t outDownsampled = 0;
 
-   for ( sample = 0; sample < m_square[0].GETDACSAMPLECOUNT(); sample++ )
+   // Average the mixer output over the DAC samples taken since the last
+   // audio sample.  See MIXERINIT for the mixer itself.
+   for ( sample = 0; sample < samples; sample++ )
    {
+      amp += MIX ( (*(sq1dacSamples+sample)),
+                   (*(sq2dacSamples+sample)),
+                   (*(triangleDacSamples+sample)),
+                   (*(noiseDacSamples+sample)),
+                   (*(dmcDacSamples+sample)) );
+   }
+
+   if ( samples )
+   {
+      amp /= samples;
+   }
+
+   // Add mapper audio if any.
+   m_outDownsampled = amp+NES()->CART()->AMPLITUDE();
+
+   m_outDownsampled = m_outLast+(int32_t)((((int64_t)(m_outDownsampled-m_outLast))*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
+
+   // Mapper audio can take the sum out of the range of a sample.
+   if ( m_outDownsampled > 32767 )
+   {
+      m_outDownsampled = 32767;
+   }
+   else if ( m_outDownsampled < -32768 )
+   {
+      m_outDownsampled = -32768;
+   }
+
+   m_outLast = m_outDownsampled;
+
+   // Reset DAC averaging...
+   m_square[0].CLEARDACAVG();
+   m_square[1].CLEARDACAVG();
+   m_triangle.CLEARDACAVG();
+   m_noise.CLEARDACAVG();
+   m_dmc.CLEARDACAVG();
+
+   return m_outDownsampled;
+}
+
+void CAPU::MIXERINIT ( void )
+{
+   int32_t idx;
+   double  scale;
+
 //      output = square_out + tnd_out
 //
 //
@@ -220,40 +286,124 @@ uint16_t CAPU::AMPLITUDE ( void )
 //                triangle   noise    dmc
 //                -------- + ----- + -----
 //                  8227     12241   22638
-      famp = 0.0;
-      if ( (*(sq1dacSamples+sample))+(*(sq2dacSamples+sample)) )
-      {
-         famp = (95.88/((8128.0/((*(sq1dacSamples+sample))+(*(sq2dacSamples+sample))))+100.0));
-      }
-      if ( (*(triangleDacSamples+sample))+(*(noiseDacSamples+sample))+(*(dmcDacSamples+sample)) )
-      {
-         famp += (159.79/((1.0/((((*(triangleDacSamples+sample))/8227.0)+((*(noiseDacSamples+sample))/12241.0)+((*(dmcDacSamples+sample))/22638.0))))+100.0));
-      }
-      amp = (int16_t)(float)(65535.0*famp*0.50);
+//
+//   The pulse half depends only on square1+square2 [0..30].  The TND half is
+//   approximated by a single function of 3*triangle+2*noise+dmc [0..202]:
+//
+//                            163.67
+//      tnd_out = ------------------------------
+//                        24329
+//                -------------------- + 100
+//                3*triangle+2*noise+dmc
+//
+//   Both are scaled to the output sample range here so that mixing a DAC
+//   sample is two table lookups, and so that the loudest pulse and TND
+//   outputs together are the loudest sample.
+   scale = 32767.0/((95.88/((8128.0/30)+100.0))+(163.67/((24329.0/202)+100.0)));
 
-      (*(m_out+sample)) = amp;
+   m_pulseTable[0] = 0;
+   for ( idx = 1; idx < 31; idx++ )
+   {
+      m_pulseTable[idx] = (int32_t)(scale*(95.88/((8128.0/idx)+100.0)));
+   }
+   m_tndTable[0] = 0;
+   for ( idx = 1; idx < 203; idx++ )
+   {
+      m_tndTable[idx] = (int32_t)(scale*(163.67/((24329.0/idx)+100.0)));
+   }
+}
+
+inline void CAPU::PRODUCESAMPLE ( uint16_t sample )
+{
+   uint16_t* pWaveBuf = m_waveBuf+m_waveBufProduce;
+
+   (*pWaveBuf) = sample;
+
+#if defined ( OUTPUT_WAV )
+if ( wavOut )
+{
+//   uint8_t s1,s2,t,n,d;
+//   GETDACS(&s1,&s2,&t,&n,&d);
+//   fwrite(&s1,1,1,wavOut);
+//   fwrite(&s2,1,1,wavOut);
+//   fwrite(&t,1,1,wavOut);
+//   fwrite(&n,1,1,wavOut);
+//   fwrite(&d,1,1,wavOut);
+   fwrite(&(*pWaveBuf),1,2,wavOut);
+   wavFileSize += 2;
+   if ( wavFileSize == 88200*200 )
+   {
+      fclose(wavOut);
+      wavOut = NULL;
+   }
+}
+#endif
+
+   m_waveBufProduce++;
+   m_waveBufProduce %= m_sampleBufferSize;
 
-      outDownsampled += (*(m_out+sample));
+   m_samplesAvailable++;
+
+   if ( m_samplesAvailable >= APU_BUFFER_PRERENDER )
+   {
+      nesBreakAudio();
    }
+}
 
-   outDownsampled = (int32_t)((float)outDownsampled/((float)m_square[0].GETDACSAMPLECOUNT()));
+inline void CAPU::GENERATESAMPLES ( void )
+{
+#if defined ( NES_BLIP_BUFFER )
+   int32_t amp = MIX ( m_square[0].GETDAC(),
+                       m_square[1].GETDAC(),
+                       m_triangle.GETDAC(),
+                       m_noise.GETDAC(),
+                       m_dmc.GETDAC() );
 
-   // Add mapper audio if any.
-   outDownsampled += CNES::NES()->CART()->AMPLITUDE();
+   // Feed every change in the mixer output into the band-limited synthesizer
+   // at the APU cycle on which it happened.
+   if ( amp != m_blipAmp )
+   {
+      m_blipSynth.offset_inline ( m_blipTime, amp-m_blipAmp, &m_blipBuffer );
+      m_blipAmp = amp;
+   }
+   m_blipTime++;
+#endif
 
-   delta = outDownsampled - outLast;
-   outDownsampled = outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
+   m_takeSample += 1.0;
 
-   outLast = outDownsampled;
+   if ( m_takeSample >= m_sampleSpacer )
+   {
+      m_takeSample -= m_sampleSpacer;
 
-   // Reset DAC averaging...
-   m_square[0].CLEARDACAVG();
-   m_square[1].CLEARDACAVG();
-   m_triangle.CLEARDACAVG();
-   m_noise.CLEARDACAVG();
-   m_dmc.CLEARDACAVG();
+#if defined ( NES_BLIP_BUFFER )
+      blip_sample_t sample;
 
-   return outDownsampled;
+      // Mapper audio is only available averaged over the sample period.
+      amp = NES()->CART()->AMPLITUDE();
+      if ( amp != m_blipMapperAmp )
+      {
+         m_blipSynth.offset_inline ( m_blipTime, amp-m_blipMapperAmp, &m_blipBuffer );
+         m_blipMapperAmp = amp;
+      }
+
+      // The DAC averages are not used but must not overflow.
+      m_square[0].CLEARDACAVG();
+      m_square[1].CLEARDACAVG();
+      m_triangle.CLEARDACAVG();
+      m_noise.CLEARDACAVG();
+      m_dmc.CLEARDACAVG();
+
+      m_blipBuffer.end_frame ( m_blipTime );
+      m_blipTime = 0;
+
+      while ( m_blipBuffer.read_samples(&sample,1) )
+      {
+         PRODUCESAMPLE ( (uint16_t)sample );
+      }
+#else
+      PRODUCESAMPLE ( AMPLITUDE() );
+#endif
+   }
 }
 
 void CAPU::SEQTICK ( int32_t sequence )
@@ -306,23 +456,23 @@ void CAPU::SEQTICK ( int32_t sequence )
          if ( m_irqEnabled )
          {
             m_irqAsserted = true;
-            CNES::NES()->CPU()->ASSERTIRQ ( eNESSource_APU );
+            NES()->CPU()->ASSERTIRQ ( eNESSource_APU );
 
-            if ( nesIsDebuggable )
+            if ( NES()->DEBUGGABLE() )
             {
                // Check for IRQ breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_IRQ);
+               NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_IRQ);
             }
          }
       }
    }
 
    // Check for Length Counter clocking breakpoint...
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       if ( clockedLengthCounter )
       {
-         CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_LENGTH_COUNTER_CLOCKED);
+         NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_LENGTH_COUNTER_CLOCKED);
       }
    }
 }
@@ -379,7 +529,7 @@ void CAPU::RESET ( void )
 
    m_irqEnabled = false;
    m_irqAsserted = false;
-   CNES::NES()->CPU()->RELEASEIRQ ( eNESSource_APU );
+   NES()->CPU()->RELEASEIRQ ( eNESSource_APU );
    m_sequencerMode = 0;
    m_sequenceStep = 0;
 
@@ -388,12 +538,12 @@ void CAPU::RESET ( void )
 
    memset( m_waveBuf, 0, m_waveBufDepth*sizeof(uint16_t) );
 
-   if ( CNES::NES()->VIDEOMODE() == MODE_NTSC )
+   if ( NES()->VIDEOMODE() == MODE_NTSC )
    {
       m_sampleSpacer = APU_SAMPLE_SPACE_NTSC;
       MACHINE_SPECIFIC_EMULATE = &CAPU::EMULATE_NTSC_DENDY;
    }
-   else if ( CNES::NES()->VIDEOMODE() == MODE_DENDY )
+   else if ( NES()->VIDEOMODE() == MODE_DENDY )
    {
       m_sampleSpacer = APU_SAMPLE_SPACE_DENDY;
       MACHINE_SPECIFIC_EMULATE = &CAPU::EMULATE_NTSC_DENDY;
@@ -404,8 +554,113 @@ void CAPU::RESET ( void )
       MACHINE_SPECIFIC_EMULATE = &CAPU::EMULATE_PAL;
    }
 
+#if defined ( NES_BLIP_BUFFER )
+   // The band-limited synthesizer runs at the APU clock of the machine mode.
+   m_blipBuffer.clock_rate ( (long)(SDL_SAMPLE_RATE*m_sampleSpacer) );
+   m_blipBuffer.clear();
+   m_blipTime = 0;
+   m_blipAmp = 0;
+   m_blipMapperAmp = 0;
+#endif
+
    m_cycles = 0;
-   apuDataAvailable = 0;
+   m_samplesAvailable = 0;
+}
+
+void CAPU::SERIALIZE ( CNESSaveState* state )
+{
+   state->BEGINCHUNK ( "APU ", 1 );
+   state->VALUE ( m_APUreg );
+   state->VALUE ( m_APUregDirty );
+   state->VALUE ( m_irqEnabled );
+   state->VALUE ( m_irqAsserted );
+   state->VALUE ( m_sequencerMode );
+   state->VALUE ( m_newSequencerMode );
+   state->VALUE ( m_changeModes );
+   state->VALUE ( m_sequenceStep );
+   m_square[0].SERIALIZE ( state );
+   m_square[1].SERIALIZE ( state );
+   m_triangle.SERIALIZE ( state );
+   m_noise.SERIALIZE ( state );
+   m_dmc.SERIALIZE ( state );
+   state->VALUE ( m_cycles );
+   state->VALUE ( m_takeSample );
+   state->VALUE ( m_outLast );
+   state->VALUE ( m_outDownsampled );
+   state->ENDCHUNK ();
+
+   // Samples already produced belong to the audio stream that was playing,
+   // not to the state, so the wave buffer is left alone.
+#if defined ( NES_BLIP_BUFFER )
+   if ( state->LOADING() )
+   {
+      m_blipBuffer.clear();
+      m_blipTime = 0;
+      m_blipAmp = 0;
+      m_blipMapperAmp = 0;
+   }
+#endif
+}
+
+void CAPUOscillator::SERIALIZE ( CNESSaveState* state )
+{
+   // The mixer tables are looked up by DAC value, so a state whose DAC
+   // and volume values could not have come from the channel is rejected.
+   uint8_t dacMax = (m_channel == 4)?127:15;
+   uint32_t sample;
+
+   state->VALUE ( m_linearCounter );
+   state->VALUE ( m_linearCounterReload );
+   state->VALUE ( m_lengthCounter );
+   state->VALUE ( m_clockLengthCounter );
+   state->VALUE ( m_period );
+   state->VALUE ( m_periodCounter );
+   state->VALUE ( m_envelope );
+   state->RANGE ( m_envelopeCounter, (uint8_t)0, (uint8_t)15 );
+   state->VALUE ( m_envelopeDivider );
+   state->VALUE ( m_envelopeLoop );
+   state->RANGE ( m_sweepShift, (uint8_t)0, (uint8_t)7 );
+   state->VALUE ( m_sweepDivider );
+   state->VALUE ( m_sweep );
+   state->VALUE ( m_sweepVolume );
+   state->RANGE ( m_volume, (uint8_t)0, dacMax );
+   state->RANGE ( m_volumeSet, (uint8_t)0, dacMax );
+   state->VALUE ( m_enabled );
+   state->VALUE ( m_halted );
+   state->VALUE ( m_newHalted );
+   state->VALUE ( m_linearCounterHalted );
+   state->VALUE ( m_envelopeEnabled );
+   state->VALUE ( m_sweepEnabled );
+   state->VALUE ( m_sweepNegate );
+   state->RANGE ( m_dac, (uint8_t)0, dacMax );
+   for ( sample = 0; sample < sizeof(m_dacAverage); sample++ )
+   {
+      state->RANGE ( m_dacAverage[sample], (uint8_t)0, dacMax );
+   }
+   state->RANGE ( m_dacSamples, (uint8_t)0, (uint8_t)(sizeof(m_dacAverage)-1) );
+   state->VALUE ( m_reg1Wrote );
+   state->VALUE ( m_reg3Wrote );
+   state->VALUE ( m_reg );
+}
+
+void CAPUSquare::SERIALIZE ( CNESSaveState* state )
+{
+   CAPUOscillator::SERIALIZE ( state );
+   state->RANGE ( m_seqTick, 0, 7 );
+   state->RANGE ( m_duty, 0, 3 );
+}
+
+void CAPUTriangle::SERIALIZE ( CNESSaveState* state )
+{
+   CAPUOscillator::SERIALIZE ( state );
+   state->RANGE ( m_seqTick, 0, 31 );
+}
+
+void CAPUNoise::SERIALIZE ( CNESSaveState* state )
+{
+   CAPUOscillator::SERIALIZE ( state );
+   state->VALUE ( m_mode );
+   state->VALUE ( m_shiftRegister );
 }
 
 CAPUOscillator::CAPUOscillator(uint8_t periodAdjust) :
@@ -438,6 +693,8 @@ CAPUOscillator::CAPUOscillator(uint8_t periodAdjust) :
    m_sweepEnabled = false;
    m_linearCounterHalted = false;
    m_dac = 0x00;
+   memset(m_dacAverage,0,sizeof(m_dacAverage));
+   m_dacSamples = 0;
    m_reg1Wrote = false;
    m_reg3Wrote = false;
 
@@ -618,7 +875,7 @@ uint32_t CAPUOscillator::CLKDIVIDER ( void )
    return clockIt;
 }
 
-static int32_t m_squareSeq [ 4 ] [ 8 ] =
+static const int32_t m_squareSeq [ 4 ] [ 8 ] =
 {
    { 0, 1, 0, 0, 0, 0, 0, 0 },
    { 0, 1, 1, 0, 0, 0, 0, 0 },
@@ -657,7 +914,7 @@ void CAPUSquare::APU ( uint32_t addr, uint8_t data )
    {
       if ( m_enabled )
       {
-         if ( (CNES::NES()->VIDEOMODE() == MODE_NTSC) || (CNES::NES()->VIDEOMODE() == MODE_DENDY) )
+         if ( (NES()->VIDEOMODE() == MODE_NTSC) || (NES()->VIDEOMODE() == MODE_DENDY) )
          {
             if ( PARENT()->SEQUENCERMODE() == 0 )
             {
@@ -769,7 +1026,7 @@ void CAPUSquare::TIMERTICK ( void )
    m_halted = m_newHalted;
 }
 
-static int32_t m_triangleSeq [ 32 ] =
+static const int32_t m_triangleSeq [ 32 ] =
 {
    0xF, 0xE, 0xD, 0xC, 0xB, 0xA, 0x9, 0x8,
    0x7, 0x6, 0x5, 0x4, 0x3, 0x2, 0x1, 0x0,
@@ -795,7 +1052,7 @@ void CAPUTriangle::APU ( uint32_t addr, uint8_t data )
    {
       if ( m_enabled )
       {
-         if ( (CNES::NES()->VIDEOMODE() == MODE_NTSC) || (CNES::NES()->VIDEOMODE() == MODE_DENDY) )
+         if ( (NES()->VIDEOMODE() == MODE_NTSC) || (NES()->VIDEOMODE() == MODE_DENDY) )
          {
             if ( PARENT()->SEQUENCERMODE() == 0 )
             {
@@ -902,7 +1159,7 @@ void CAPUTriangle::TIMERTICK ( void )
    m_halted = m_newHalted;
 }
 
-static uint16_t m_noisePeriod [ 3 ][ 16 ] =
+static const uint16_t m_noisePeriod [ 3 ][ 16 ] =
 {
    // NTSC
    {
@@ -934,13 +1191,13 @@ void CAPUNoise::APU ( uint32_t addr, uint8_t data )
    else if ( addr == 2 )
    {
       m_mode = data&0x80;
-      m_period = *(*(m_noisePeriod+CNES::NES()->VIDEOMODE())+(data&0xF));
+      m_period = *(*(m_noisePeriod+NES()->VIDEOMODE())+(data&0xF));
    }
    else if ( addr == 3 )
    {
       if ( m_enabled )
       {
-         if ( (CNES::NES()->VIDEOMODE() == MODE_NTSC) || (CNES::NES()->VIDEOMODE() == MODE_DENDY) )
+         if ( (NES()->VIDEOMODE() == MODE_NTSC) || (NES()->VIDEOMODE() == MODE_DENDY) )
          {
             if ( PARENT()->SEQUENCERMODE() == 0 )
             {
@@ -1055,7 +1312,7 @@ void CAPUNoise::TIMERTICK ( void )
    m_halted = m_newHalted;
 }
 
-static uint16_t m_dmcPeriod [ 3 ][ 16 ] =
+static const uint16_t m_dmcPeriod [ 3 ][ 16 ] =
 {
    // NTSC
    {
@@ -1085,7 +1342,23 @@ void CAPUDMC::RESET ( void )
    m_outputShift = 0x00;
    m_outputShiftCounter = 0;
    m_silence = true;
-   m_period = (*(*(m_dmcPeriod+CNES::NES()->VIDEOMODE())));
+   m_period = (*(*(m_dmcPeriod+NES()->VIDEOMODE())));
+}
+
+void CAPUDMC::SERIALIZE ( CNESSaveState* state )
+{
+   CAPUOscillator::SERIALIZE ( state );
+   state->VALUE ( m_dmaReaderAddrPtr );
+   state->VALUE ( m_dmcIrqEnabled );
+   state->VALUE ( m_dmcIrqAsserted );
+   state->VALUE ( m_sampleBuffer );
+   state->VALUE ( m_sampleBufferFull );
+   state->VALUE ( m_loop );
+   state->VALUE ( m_sampleAddr );
+   state->VALUE ( m_sampleLength );
+   state->VALUE ( m_outputShift );
+   state->VALUE ( m_outputShiftCounter );
+   state->VALUE ( m_silence );
 }
 
 void CAPUDMC::APU ( uint32_t addr, uint8_t data )
@@ -1103,7 +1376,7 @@ void CAPUDMC::APU ( uint32_t addr, uint8_t data )
       }
 
       m_loop = data&0x40;
-      m_period = (*(*(m_dmcPeriod+CNES::NES()->VIDEOMODE())+(data&0xF)));
+      m_period = (*(*(m_dmcPeriod+NES()->VIDEOMODE())+(data&0xF)));
    }
    else if ( addr == 1 )
    {
@@ -1159,7 +1432,7 @@ void CAPUDMC::DMASAMPLE ( uint8_t data )
    if ( (!m_lengthCounter) && m_dmcIrqEnabled && (!m_loop) )
    {
       m_dmcIrqAsserted = true;
-      CNES::NES()->CPU()->ASSERTIRQ ( eNESSource_APU );
+      NES()->CPU()->ASSERTIRQ ( eNESSource_APU );
    }
 
    if ( (!m_lengthCounter) && m_loop )
@@ -1175,7 +1448,7 @@ void CAPUDMC::DMAREADER ( void )
    {
       if ( m_lengthCounter )
       {
-         CNES::NES()->CPU()->APUDMAREQ ( m_dmaReaderAddrPtr );
+         NES()->CPU()->APUDMAREQ ( m_dmaReaderAddrPtr );
       }
    }
 }
@@ -1239,9 +1512,7 @@ void CAPUDMC::TIMERTICK ( void )
 
 void CAPU::EMULATE ( void )
 {
-   static float takeSample = 0.0f;
-   uint16_t* pWaveBuf;
-   CTracer* pTracer = CNES::NES()->TRACER();
+   CTracer* pTracer = NES()->TRACER();
 
    // Handle APU clock jitter.  Mode changes occur
    // only on even APU clocks.  On a mode change write
@@ -1257,7 +1528,7 @@ void CAPU::EMULATE ( void )
       m_sequenceStep = 0;
       RESETCYCLECOUNTER(0);
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-start indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_StartAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1274,9 +1545,7 @@ void CAPU::EMULATE ( void )
 
 void CAPU::EMULATE_NTSC_DENDY ( void )
 {
-   static float takeSample = 0.0f;
-   uint16_t* pWaveBuf;
-   CTracer* pTracer = CNES::NES()->TRACER();
+   CTracer* pTracer = NES()->TRACER();
 
    // Clock the 240Hz sequencer.
    // NTSC APU
@@ -1285,7 +1554,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
    {
       if ( m_cycles == 1 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1295,7 +1564,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
       }
       else if ( m_cycles == 7459 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1305,7 +1574,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
       }
       else if ( m_cycles == 14915 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1315,7 +1584,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
       }
       else if ( m_cycles == 22373 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1325,7 +1594,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
       }
       else if ( m_cycles == 29829 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1339,7 +1608,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
    {
       if ( m_cycles == 7459 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1349,7 +1618,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
       }
       else if ( m_cycles == 14915 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1359,7 +1628,7 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
       }
       else if ( m_cycles == 22373 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1373,18 +1642,18 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
          if ( m_irqEnabled )
          {
             m_irqAsserted = true;
-            CNES::NES()->CPU()->ASSERTIRQ(eNESSource_APU);
+            NES()->CPU()->ASSERTIRQ(eNESSource_APU);
 
-            if ( nesIsDebuggable )
+            if ( NES()->DEBUGGABLE() )
             {
                // Check for IRQ breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_IRQ);
+               NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_IRQ);
             }
          }
       }
       else if ( m_cycles == 29831 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1403,52 +1672,14 @@ void CAPU::EMULATE_NTSC_DENDY ( void )
    m_dmc.TIMERTICK ();
 
    // Generate audio samples.
-   takeSample += 1.0;
-
-   if ( takeSample >= m_sampleSpacer )
-   {
-      takeSample -= m_sampleSpacer;
-
-      pWaveBuf = m_waveBuf+m_waveBufProduce;
-      (*pWaveBuf) = AMPLITUDE ();
-
-#if defined ( OUTPUT_WAV )
-if ( wavOut )
-{
-//   uint8_t s1,s2,t,n,d;
-//   GETDACS(&s1,&s2,&t,&n,&d);
-//   fwrite(&s1,1,1,wavOut);
-//   fwrite(&s2,1,1,wavOut);
-//   fwrite(&t,1,1,wavOut);
-//   fwrite(&n,1,1,wavOut);
-//   fwrite(&d,1,1,wavOut);
-   fwrite(&(*pWaveBuf),1,2,wavOut);
-   wavFileSize += 2;
-   if ( wavFileSize == 88200*200 )
-   {
-      fclose(wavOut);
-      wavOut = NULL;
-   }
-}
-#endif
-
-      m_waveBufProduce++;
-      m_waveBufProduce %= m_sampleBufferSize;
-
-      apuDataAvailable++;
-
-      if ( apuDataAvailable >= APU_BUFFER_PRERENDER )
-      {
-         nesBreakAudio();
-      }
-   }
+   GENERATESAMPLES ();
 
    // Go to next cycle and restart if necessary...
    m_cycles++;
 
    if ( (m_sequencerMode) && (m_cycles >= 37283) )
    {
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-end indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_EndAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1456,7 +1687,7 @@ if ( wavOut )
 
       RESETCYCLECOUNTER(1);
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-start indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_StartAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1464,7 +1695,7 @@ if ( wavOut )
    }
    else if ( (!m_sequencerMode) && (m_cycles >= 37289) )
    {
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-end indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_EndAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1472,7 +1703,7 @@ if ( wavOut )
 
       RESETCYCLECOUNTER(7459);
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-start indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_StartAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1482,9 +1713,7 @@ if ( wavOut )
 
 void CAPU::EMULATE_PAL ( void )
 {
-   static float takeSample = 0.0f;
-   uint16_t* pWaveBuf;
-   CTracer* pTracer = CNES::NES()->TRACER();
+   CTracer* pTracer = NES()->TRACER();
 
    // Clock the 240Hz sequencer.
    // APU sequencer mode 1
@@ -1492,7 +1721,7 @@ void CAPU::EMULATE_PAL ( void )
    {
       if ( m_cycles == 1 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1502,7 +1731,7 @@ void CAPU::EMULATE_PAL ( void )
       }
       else if ( m_cycles == 8315 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1512,7 +1741,7 @@ void CAPU::EMULATE_PAL ( void )
       }
       else if ( m_cycles == 16629 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1522,7 +1751,7 @@ void CAPU::EMULATE_PAL ( void )
       }
       else if ( m_cycles == 24941 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1532,7 +1761,7 @@ void CAPU::EMULATE_PAL ( void )
       }
       else if ( m_cycles == 33255 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1546,7 +1775,7 @@ void CAPU::EMULATE_PAL ( void )
    {
       if ( m_cycles == 8315 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1556,7 +1785,7 @@ void CAPU::EMULATE_PAL ( void )
       }
       else if ( m_cycles == 16629 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1566,7 +1795,7 @@ void CAPU::EMULATE_PAL ( void )
       }
       else if ( m_cycles == 24941 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1580,18 +1809,18 @@ void CAPU::EMULATE_PAL ( void )
          if ( m_irqEnabled )
          {
             m_irqAsserted = true;
-            CNES::NES()->CPU()->ASSERTIRQ(eNESSource_APU);
+            NES()->CPU()->ASSERTIRQ(eNESSource_APU);
 
-            if ( nesIsDebuggable )
+            if ( NES()->DEBUGGABLE() )
             {
                // Check for IRQ breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_IRQ);
+               NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,0,APU_EVENT_IRQ);
             }
          }
       }
       else if ( m_cycles == 33255 )
       {
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Emit frame-end indication to Tracer...
             pTracer->AddSample ( CYCLES(), eTracer_SequencerStep, eNESSource_APU, 0, 0, 0 );
@@ -1610,52 +1839,14 @@ void CAPU::EMULATE_PAL ( void )
    m_dmc.TIMERTICK ();
 
    // Generate audio samples.
-   takeSample += 1.0;
-
-   if ( takeSample >= m_sampleSpacer )
-   {
-      takeSample -= m_sampleSpacer;
-
-      pWaveBuf = m_waveBuf+m_waveBufProduce;
-      (*pWaveBuf) = AMPLITUDE ();
-
-#if defined ( OUTPUT_WAV )
-if ( wavOut )
-{
-//   uint8_t s1,s2,t,n,d;
-//   GETDACS(&s1,&s2,&t,&n,&d);
-//   fwrite(&s1,1,1,wavOut);
-//   fwrite(&s2,1,1,wavOut);
-//   fwrite(&t,1,1,wavOut);
-//   fwrite(&n,1,1,wavOut);
-//   fwrite(&d,1,1,wavOut);
-   fwrite(&(*pWaveBuf),1,2,wavOut);
-   wavFileSize += 2;
-   if ( wavFileSize == 88200*200 )
-   {
-      fclose(wavOut);
-      wavOut = NULL;
-   }
-}
-#endif
-
-      m_waveBufProduce++;
-      m_waveBufProduce %= m_sampleBufferSize;
-
-      apuDataAvailable++;
-
-      if ( apuDataAvailable >= APU_BUFFER_PRERENDER )
-      {
-         nesBreakAudio();
-      }
-   }
+   GENERATESAMPLES ();
 
    // Go to next cycle and restart if necessary...
    m_cycles++;
 
    if ( (m_sequencerMode) && (m_cycles >= 41567) )
    {
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-end indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_EndAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1663,7 +1854,7 @@ if ( wavOut )
 
       RESETCYCLECOUNTER(1);
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-start indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_StartAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1671,7 +1862,7 @@ if ( wavOut )
    }
    else if ( (!m_sequencerMode) && (m_cycles >= 41569) )
    {
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-end indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_EndAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1679,7 +1870,7 @@ if ( wavOut )
 
       RESETCYCLECOUNTER(8315);
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Emit frame-start indication to Tracer...
          pTracer->AddSample ( CYCLES(), eTracer_StartAPUFrame, eNESSource_APU, 0, 0, 0 );
@@ -1691,7 +1882,7 @@ void CAPU::RELEASEIRQ ( void )
 {
    if ( (!m_irqAsserted) && (!m_dmc.IRQASSERTED()) )
    {
-      CNES::NES()->CPU()->RELEASEIRQ ( eNESSource_APU );
+      NES()->CPU()->RELEASEIRQ ( eNESSource_APU );
    }
 }
 
@@ -1712,9 +1903,9 @@ uint32_t CAPU::APU ( uint32_t addr )
       m_irqAsserted = false;
       RELEASEIRQ ();
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
-         CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUState, addr&0x1F);
+         NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUState, addr&0x1F);
       }
    }
    else
@@ -1779,12 +1970,12 @@ void CAPU::APU ( uint32_t addr, uint8_t data )
       }
 
       // Change modes on even cycle...
-      m_changeModes = CNES::NES()->CPU()->_CYCLES()&1;
+      m_changeModes = NES()->CPU()->_CYCLES()&1;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
-      CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUState,addr&0x1F);
+      NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUState,addr&0x1F);
    }
 }
 
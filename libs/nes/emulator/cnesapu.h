@@ -3,6 +3,12 @@
 
 #include "cnes.h"
 
+#if defined ( NES_BLIP_BUFFER )
+#include "Blip_Buffer.h"
+#endif
+
+class CNESSaveState;
+
 #define NUM_APU_BUFS 16
 #define APU_BUFFER_SIZE (NUM_APU_BUFS*APU_SAMPLES)
 
@@ -44,6 +50,9 @@ public:
    inline CAPU *PARENT() const { return m_apu; }
    void PARENT(CAPU *pAPU) { m_apu = pAPU; }
 
+   // Accessor method to retrieve the machine the parent APU is a part of.
+   inline CNES* NES() const;
+
    // An APU channel should know what channel ID it has.  This isn't
    // useful in the APU itself but is needed by the debugger inspectors
    // and designers that need to do specific things to specific APU channels.
@@ -113,7 +122,7 @@ public:
       m_dacSamples++;
       if ( dac != oldDac )
       {
-         CNES::NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,dac,APU_EVENT_SQUARE1_DAC_VALUE+m_channel);
+         NES()->CHECKBREAKPOINT(eBreakInAPU,eBreakOnAPUEvent,dac,APU_EVENT_SQUARE1_DAC_VALUE+m_channel);
       }
    }
    inline uint8_t GETDAC ( void )
@@ -161,6 +170,9 @@ public:
       m_clockLengthCounter = true;
    }
 
+   // Save state support.
+   void SERIALIZE ( CNESSaveState* state );
+
    // These are called directly for use in debugger inspectors.
    // Returns the channels' current length counter value.
    uint16_t LENGTHCOUNTER(void) const
@@ -334,6 +346,8 @@ public:
       m_seqTick = 0;
    }
 
+   void SERIALIZE ( CNESSaveState* state );
+
 protected:
    // The square waveform channel has an internal 8-step sequencer for
    // generating the appropriate duty-cycle.
@@ -378,6 +392,8 @@ public:
       m_seqTick = 0;
    }
 
+   void SERIALIZE ( CNESSaveState* state );
+
 protected:
    // The triangle waveform channel has an internal 32-step sequencer
    // for generating the appropriate triangular waveform.
@@ -425,6 +441,8 @@ public:
       m_shiftRegister = 1;
    }
 
+   void SERIALIZE ( CNESSaveState* state );
+
 protected:
    // The noise channel has two different modes:
    // 93-cycle pattern
@@ -524,6 +542,8 @@ public:
    // what it should be at NES reset.
    void RESET ( void );
 
+   void SERIALIZE ( CNESSaveState* state );
+
 protected:
    // Current address within NES system memory where
    // sample data is being fetched from.
@@ -573,9 +593,17 @@ class C6502;
 class CAPU
 {
 public:
-   CAPU();
+   CAPU(CNES* pNES);
+   ~CAPU();
+
+   // Accessor method to retrieve the machine this APU is a part of.
+   inline CNES* NES() const { return m_nes; }
 
    void RESET ( void );
+
+   // Save state support.
+   void SERIALIZE ( CNESSaveState* state );
+
    uint32_t APU ( uint32_t addr );
    void APU ( uint32_t addr, uint8_t data );
    void EMULATE ( void );
@@ -583,6 +611,17 @@ public:
    void EMULATE_PAL ( void );
    uint8_t* PLAY ( uint16_t samples );
 
+   // Accessor methods to get/clear the number of samples that have been
+   // produced but not yet consumed by PLAY.
+   inline int32_t SAMPLESAVAILABLE ( void ) const
+   {
+      return m_samplesAvailable;
+   }
+   inline void CLEARSAMPLESAVAILABLE ( void )
+   {
+      m_samplesAvailable = 0;
+   }
+
    void DMASAMPLE ( uint8_t data )
    {
       m_dmc.DMASAMPLE ( data );
@@ -624,6 +663,12 @@ public:
    inline void SEQTICK ( int32_t sequence );
    inline uint16_t AMPLITUDE ( void );
 
+   // Nonlinear mixing of the channel DACs, see MIXERINIT.
+   inline int32_t MIX ( uint8_t square1, uint8_t square2, uint8_t triangle, uint8_t noise, uint8_t dmc )
+   {
+      return m_pulseTable[square1+square2]+m_tndTable[(3*triangle)+(2*noise)+dmc];
+   }
+
    inline void RESETCYCLECOUNTER ( uint32_t cycle )
    {
       m_cycles = cycle;
@@ -682,6 +727,8 @@ public:
    }
 
 protected:
+   CNES* m_nes;
+
    uint8_t m_APUreg [ 32 ];
    uint8_t m_APUregDirty [ 32 ];
    bool m_irqEnabled;
@@ -707,9 +754,37 @@ protected:
    uint32_t   m_cycles;
 
    float m_sampleSpacer;
-   int16_t m_out[1024];
+   float m_takeSample;
+
+   // Mixer lookup tables, built by MIXERINIT.
+   void MIXERINIT ( void );
+   int32_t m_pulseTable [ 31 ];
+   int32_t m_tndTable [ 203 ];
+
+   // Audio sample generation, run once per APU cycle.
+   inline void GENERATESAMPLES ( void );
+   inline void PRODUCESAMPLE ( uint16_t sample );
+
+#if defined ( NES_BLIP_BUFFER )
+   // Band-limited synthesis of the mixer output.
+   Blip_Buffer m_blipBuffer;
+   Blip_Synth<blip_good_quality,32768> m_blipSynth;
+   blip_time_t m_blipTime;
+   int32_t m_blipAmp;
+   int32_t m_blipMapperAmp;
+#endif
+
+   // Mixer output history used by the output filter.
+   int16_t m_outLast;
+   int32_t m_outDownsampled;
 
    int32_t m_sampleBufferSize;
+   int32_t m_samplesAvailable;
 };
 
+inline CNES* CAPUOscillator::NES() const
+{
+   return m_apu->NES();
+}
+
 #endif
@@ -7,8 +7,11 @@
 #include "cnesapu.h"
 #include "cnesrom.h"
 
-CNESBreakpointInfo::CNESBreakpointInfo()
+CNESBreakpointInfo::CNESBreakpointInfo(CNES* pNES)
+   : m_nes(pNES),
+     m_indexStale(false)
 {
+   BuildIndex();
 }
 
 CNESBreakpointInfo::~CNESBreakpointInfo()
@@ -91,6 +94,109 @@ void CNESBreakpointInfo::ModifyBreakpoint ( BreakpointInfo* pBreakpoint, int typ
    pBreakpoint->data = data;
 }
 
+void CNESBreakpointInfo::AddToIndex ( int type, int bp )
+{
+   BreakpointIndexInfo* pIndex = &(m_index[type]);
+   BreakpointInfo* pBreakpoint = &(m_breakpoint[bp]);
+   uint32_t addr;
+   uint32_t addrEnd;
+
+   pIndex->breakpoint[pIndex->numBreakpoints] = bp;
+   pIndex->numBreakpoints++;
+
+   switch ( pBreakpoint->type )
+   {
+      case eBreakOnCPUExecution:
+      case eBreakOnCPUMemoryAccess:
+      case eBreakOnCPUMemoryRead:
+      case eBreakOnCPUMemoryWrite:
+      case eBreakOnOAMPortalAccess:
+      case eBreakOnOAMPortalRead:
+      case eBreakOnOAMPortalWrite:
+      case eBreakOnPPUFetch:
+      case eBreakOnPPUPortalAccess:
+      case eBreakOnPPUPortalRead:
+      case eBreakOnPPUPortalWrite:
+         // Mark every address in the range that passes the address mask...
+         addrEnd = (pBreakpoint->item2 < MEM_64KB)?pBreakpoint->item2:MASK_64KB;
+         for ( addr = pBreakpoint->item1; addr <= addrEnd; addr++ )
+         {
+            if ( ((!pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask)) ||
+                 ((pBreakpoint->itemMaskExclusive) && (addr&pBreakpoint->itemMask) && ((addr&(~pBreakpoint->itemMask)) == 0)) )
+            {
+               pIndex->keyMap[addr>>5] |= (1<<(addr&0x1F));
+            }
+         }
+         break;
+      case eBreakOnCPUState:
+      case eBreakOnPPUState:
+      case eBreakOnAPUState:
+      case eBreakOnMapperState:
+         // Mark the register...
+         if ( pBreakpoint->item1 < MEM_64KB )
+         {
+            pIndex->keyMap[pBreakpoint->item1>>5] |= (1<<(pBreakpoint->item1&0x1F));
+         }
+         break;
+      case eBreakOnCPUEvent:
+      case eBreakOnPPUEvent:
+      case eBreakOnAPUEvent:
+      case eBreakOnMapperEvent:
+         // Mark the event...
+         if ( (pBreakpoint->event >= 0) && (pBreakpoint->event < MEM_64KB) )
+         {
+            pIndex->keyMap[pBreakpoint->event>>5] |= (1<<(pBreakpoint->event&0x1F));
+         }
+         break;
+   }
+}
+
+void CNESBreakpointInfo::BreakpointsChanged ( void )
+{
+   // The emulator thread may be checking breakpoints against the index
+   // right now, so leave the rebuild to it.
+   m_indexStale.store(true,std::memory_order_release);
+}
+
+void CNESBreakpointInfo::BuildIndex ( void )
+{
+   int bp;
+   int type;
+
+   memset(m_index,0,sizeof(m_index));
+
+   for ( bp = 0; bp < m_numBreakpoints; bp++ )
+   {
+      // Disabled breakpoints can never fire so leave them out...
+      if ( m_breakpoint[bp].enabled )
+      {
+         type = m_breakpoint[bp].type;
+
+         if ( (type >= 0) && (type < NUM_BREAKPOINT_TYPES) )
+         {
+            AddToIndex ( type, bp );
+
+            // "Access" breakpoints also fire on reads and writes...
+            switch ( type )
+            {
+               case eBreakOnCPUMemoryAccess:
+                  AddToIndex ( eBreakOnCPUMemoryRead, bp );
+                  AddToIndex ( eBreakOnCPUMemoryWrite, bp );
+                  break;
+               case eBreakOnOAMPortalAccess:
+                  AddToIndex ( eBreakOnOAMPortalRead, bp );
+                  AddToIndex ( eBreakOnOAMPortalWrite, bp );
+                  break;
+               case eBreakOnPPUPortalAccess:
+                  AddToIndex ( eBreakOnPPUPortalRead, bp );
+                  AddToIndex ( eBreakOnPPUPortalWrite, bp );
+                  break;
+            }
+         }
+      }
+   }
+}
+
 void CNESBreakpointInfo::GetPrintable ( int idx, char* msg )
 {
    CRegisterData* pRegister;
@@ -1846,6 +1952,6 @@ void CNESBreakpointInfo::GetHitPrintable ( int idx, char* hmsg )
 {
    char*          msg = hmsg;
 
-   msg += sprintf ( msg, "[PPU(frame=%d,cycle=%d),CPU(cycle=%d),APU(cycle=%d)] BREAK: ", CNES::NES()->PPU()->_FRAME(), CNES::NES()->PPU()->_CYCLES(), CNES::NES()->CPU()->_CYCLES(), CNES::NES()->CPU()->APU()->CYCLES() );
+   msg += sprintf ( msg, "[PPU(frame=%d,cycle=%d),CPU(cycle=%d),APU(cycle=%d)] BREAK: ", m_nes->PPU()->_FRAME(), m_nes->PPU()->_CYCLES(), m_nes->CPU()->_CYCLES(), m_nes->CPU()->APU()->CYCLES() );
    GetPrintable(idx,msg);
 }
@@ -1,18 +1,92 @@
 #ifndef CNESBREAKPOINTINFO_H
 #define CNESBREAKPOINTINFO_H
 
+#include <atomic>
+
 #include "cbreakpointinfo.h"
 
+#include "nes_emulator_core.h"
+
+// Number of distinct breakpoint types, including the internal-only
+// PPU cycle breakpoint type.
+#define NUM_BREAKPOINT_TYPES (eBreakOnPPUCycle+1)
+
+// The breakpoint dispatch index groups the enabled breakpoints by type.
+// Each group also carries a bitmap of the 'keys' that could possibly
+// cause one of its breakpoints to fire.  The key is the value the
+// breakpoint is compared against:
+//
+// CPU execution: the address of the opcode being fetched.
+// CPU memory access: the effective address of the access.
+// OAM portal access: the OAM address.
+// PPU fetch and PPU portal access: the PPU address.
+// CPU, PPU, APU, and mapper state: the register being modified.
+// CPU, PPU, APU, and mapper events: the event identifier.
+//
+// CNES::CHECKBREAKPOINT consults the index so that it only evaluates
+// breakpoints that stand a chance of firing.  Breakpoints are edited on
+// the UI thread while the emulator thread checks them, so an edit only
+// marks the index stale and the emulator thread rebuilds it before its
+// next check.
+typedef struct _BreakpointIndexInfo
+{
+   int      numBreakpoints;
+   int      breakpoint [ NUM_BREAKPOINTS ];
+   uint32_t keyMap [ MEM_64KB>>5 ];
+} BreakpointIndexInfo;
+
+class CNES;
+
 class CNESBreakpointInfo : public CBreakpointInfo
 {
 public:
-   CNESBreakpointInfo();
+   CNESBreakpointInfo(CNES* pNES);
    virtual ~CNESBreakpointInfo();
    void GetPrintable ( int idx, char* msg );
    void GetHitPrintable ( int idx, char* hmsg );
 
+   // Rebuilds the dispatch index if the breakpoints have changed since
+   // it was last built.  Only the emulator thread calls this.
+   inline void UpdateIndex ( void )
+   {
+      if ( m_indexStale.load(std::memory_order_relaxed) &&
+           m_indexStale.exchange(false,std::memory_order_acquire) )
+      {
+         BuildIndex();
+      }
+   }
+
+   // Breakpoint dispatch index accessors.
+   inline int GetNumBreakpointsOfType ( int type ) const
+   {
+      return m_index[type].numBreakpoints;
+   }
+   inline BreakpointInfo* GetBreakpointOfType ( int type, int idx )
+   {
+      return &(m_breakpoint[m_index[type].breakpoint[idx]]);
+   }
+   inline bool IsBreakpointCandidate ( int type, uint32_t key ) const
+   {
+      // Keys outside of the mapped space always require a full evaluation.
+      if ( key >= MEM_64KB )
+      {
+         return true;
+      }
+      return (m_index[type].keyMap[key>>5]>>(key&0x1F))&1;
+   }
+
 protected:
    void ModifyBreakpoint ( BreakpointInfo* pBreakpoint, int type, eBreakpointItemType itemType, int event, int item1, int item1Physical, int item2, int mask, bool maskExclusive, eBreakpointConditionType conditionType, int condition, eBreakpointDataType dataType, int data, bool enabled );
+   void BreakpointsChanged ( void );
+
+   void BuildIndex ( void );
+   void AddToIndex ( int type, int bp );
+
+   // The machine whose state is reported on breakpoint hits.
+   CNES* m_nes;
+
+   BreakpointIndexInfo m_index [ NUM_BREAKPOINT_TYPES ];
+   std::atomic<bool>   m_indexStale;
 };
 
 #endif // CBREAKPOINTINFO_H
@@ -18,25 +18,45 @@
 #include "cnesapu.h"
 #include "cnesppu.h"
 #include "cnes6502.h"
+#include "cnessavestate.h"
 
-// Default IO implementation stuff
-uint32_t   CIO::m_ioJoy [] = { 0x00, 0x00 };
+void IOSTATEINIT ( IOState* io, CNES* pNES )
+{
+   io->nes = pNES;
+
+   // Default IO implementation stuff
+   memset(io->ioJoy,0,sizeof(io->ioJoy));
+
+   // Standard joypad stuff
+   memset(io->ioJoyLatch,0,sizeof(io->ioJoyLatch));
+   io->last4016 = 0x00;
 
-// Standard joypad stuff
-uint8_t   CIOStandardJoypad::m_ioJoyLatch [] = { 0x00, 0x00 };
-uint8_t   CIOStandardJoypad::m_last4016 = 0x00;
-CJoypadLogger  CIOStandardJoypad::m_logger [ NUM_CONTROLLERS ];
+   // Turbo joypad stuff
+   memset(io->alternator,0,sizeof(io->alternator));
+   io->lastFrame = 0;
 
-// Turbo joypad stuff
-uint8_t   CIOTurboJoypad::m_alternator [][2] = { { 0, 0 }, { 0, 0 } };
-uint32_t  CIOTurboJoypad::m_lastFrame = 0;
+   // Vaus Arkanoid pad stuff
+   memset(io->ioPotLatch,0,sizeof(io->ioPotLatch));
+   io->vausLast4016 = 0x00;
+   io->trimPot[CONTROLLER1] = 0x54;
+   io->trimPot[CONTROLLER2] = 0x54;
+}
 
-// Vaus Arkanoid pad stuff
-uint8_t   CIOVaus::m_ioPotLatch [] = { 0x00, 0x00 };
-uint8_t   CIOVaus::m_last4016 = 0x00;
-uint8_t   CIOVaus::m_trimPot [] = { 0x54, 0x54 };
+void IOSTATESERIALIZE ( IOState* io, CNESSaveState* state )
+{
+   state->BEGINCHUNK ( "IO  ", 1 );
+   state->VALUE ( io->ioJoy );
+   state->VALUE ( io->ioJoyLatch );
+   state->VALUE ( io->last4016 );
+   state->VALUE ( io->lastFrame );
+   state->VALUE ( io->alternator );
+   state->VALUE ( io->ioPotLatch );
+   state->VALUE ( io->vausLast4016 );
+   state->VALUE ( io->trimPot );
+   state->ENDCHUNK ();
+}
 
-uint32_t CIO::IO ( uint32_t addr )
+uint32_t CIO::IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
@@ -54,13 +74,13 @@ uint32_t CIO::IO ( uint32_t addr )
    return data;
 }
 
-void CIO::IO ( uint32_t addr, uint8_t data )
+void CIO::IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    // No effect.
    return;
 }
 
-uint32_t CIO::_IO ( uint32_t addr )
+uint32_t CIO::_IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
@@ -78,182 +98,182 @@ uint32_t CIO::_IO ( uint32_t addr )
    return data;
 }
 
-void CIO::_IO ( uint32_t addr, uint8_t data )
+void CIO::_IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    // No effect.
    return;
 }
 
-uint32_t CIOStandardJoypad::IO ( uint32_t addr )
+uint32_t CIOStandardJoypad::IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
    switch ( addr )
    {
       case IOJOY1:
-         data = 0x40|((*(m_ioJoyLatch+CONTROLLER1))&0x01);
-         *(m_ioJoyLatch+CONTROLLER1) >>= 1;
-         *(m_ioJoyLatch+CONTROLLER1) |= 0x80;
+         data = 0x40|((*(io->ioJoyLatch+CONTROLLER1))&0x01);
+         *(io->ioJoyLatch+CONTROLLER1) >>= 1;
+         *(io->ioJoyLatch+CONTROLLER1) |= 0x80;
          break;
 
       case IOJOY2:
-         data = 0x40|((*(m_ioJoyLatch+CONTROLLER2))&0x01);
-         *(m_ioJoyLatch+CONTROLLER2) >>= 1;
-         *(m_ioJoyLatch+CONTROLLER2) |= 0x80;
+         data = 0x40|((*(io->ioJoyLatch+CONTROLLER2))&0x01);
+         *(io->ioJoyLatch+CONTROLLER2) >>= 1;
+         *(io->ioJoyLatch+CONTROLLER2) |= 0x80;
          break;
    }
 
    return data;
 }
 
-void CIOStandardJoypad::IO ( uint32_t addr, uint8_t data )
+void CIOStandardJoypad::IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    switch ( addr )
    {
       case IOJOY1:
 
-         if ( (m_last4016&1) && (!(data&1)) ) // latch on negative edge
+         if ( (io->last4016&1) && (!(data&1)) ) // latch on negative edge
          {
-            *(m_ioJoyLatch+CONTROLLER1) = *(m_ioJoy+CONTROLLER1);
-            *(m_ioJoyLatch+CONTROLLER2) = *(m_ioJoy+CONTROLLER2);
+            *(io->ioJoyLatch+CONTROLLER1) = *(io->ioJoy+CONTROLLER1);
+            *(io->ioJoyLatch+CONTROLLER2) = *(io->ioJoy+CONTROLLER2);
          }
 
-         m_last4016 = data;
+         io->last4016 = data;
          break;
    }
 }
 
-uint32_t CIOStandardJoypad::_IO ( uint32_t addr )
+uint32_t CIOStandardJoypad::_IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
    switch ( addr )
    {
       case IOJOY1:
-         data = 0x40|(m_ioJoyLatch[CONTROLLER1]&0x01);
+         data = 0x40|(io->ioJoyLatch[CONTROLLER1]&0x01);
          break;
 
       case IOJOY2:
-         data = 0x40|(m_ioJoyLatch[CONTROLLER2]&0x01);
+         data = 0x40|(io->ioJoyLatch[CONTROLLER2]&0x01);
          break;
    }
 
    return data;
 }
 
-void CIOStandardJoypad::_IO ( uint32_t addr, uint8_t data )
+void CIOStandardJoypad::_IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    switch ( addr )
    {
       case IOJOY1:
 
-         if ( (m_last4016&1) && (!(data&1)) ) // latch on negative edge
+         if ( (io->last4016&1) && (!(data&1)) ) // latch on negative edge
          {
-            *(m_ioJoyLatch+CONTROLLER1) = *(m_ioJoy+CONTROLLER1);
-            *(m_ioJoyLatch+CONTROLLER2) = *(m_ioJoy+CONTROLLER2);
+            *(io->ioJoyLatch+CONTROLLER1) = *(io->ioJoy+CONTROLLER1);
+            *(io->ioJoyLatch+CONTROLLER2) = *(io->ioJoy+CONTROLLER2);
          }
 
-         m_last4016 = data;
+         io->last4016 = data;
          break;
    }
 }
 
-void CIOTurboJoypad::IO ( uint32_t addr, uint8_t data )
+void CIOTurboJoypad::IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    switch ( addr )
    {
       case IOJOY1:
 
-         if ( (m_last4016&1) && (!(data&1)) ) // latch on negative edge
+         if ( (io->last4016&1) && (!(data&1)) ) // latch on negative edge
          {
-            *(m_ioJoyLatch+CONTROLLER1) = (uint8_t)(*(m_ioJoy+CONTROLLER1))&0xFF;
-            *(m_ioJoyLatch+CONTROLLER2) = (uint8_t)(*(m_ioJoy+CONTROLLER2))&0xFF;
+            *(io->ioJoyLatch+CONTROLLER1) = (uint8_t)(*(io->ioJoy+CONTROLLER1))&0xFF;
+            *(io->ioJoyLatch+CONTROLLER2) = (uint8_t)(*(io->ioJoy+CONTROLLER2))&0xFF;
 
             // Alternate for turbos if necessary.
-            if ( m_lastFrame != CNES::NES()->FRAME() )
+            if ( io->lastFrame != io->nes->FRAME() )
             {
-               m_alternator[CONTROLLER1][0] = !m_alternator[CONTROLLER1][0];
-               m_alternator[CONTROLLER1][1] = !m_alternator[CONTROLLER1][1];
-               m_alternator[CONTROLLER2][0] = !m_alternator[CONTROLLER2][0];
-               m_alternator[CONTROLLER2][1] = !m_alternator[CONTROLLER2][1];
+               io->alternator[CONTROLLER1][0] = !io->alternator[CONTROLLER1][0];
+               io->alternator[CONTROLLER1][1] = !io->alternator[CONTROLLER1][1];
+               io->alternator[CONTROLLER2][0] = !io->alternator[CONTROLLER2][0];
+               io->alternator[CONTROLLER2][1] = !io->alternator[CONTROLLER2][1];
             }
-            m_lastFrame = CNES::NES()->FRAME();
+            io->lastFrame = io->nes->FRAME();
 
-            if ( m_ioJoy[CONTROLLER1]&JOY_ATURBO )
+            if ( io->ioJoy[CONTROLLER1]&JOY_ATURBO )
             {
-               *(m_ioJoyLatch+CONTROLLER1) &= (~JOY_A);
-               if ( m_alternator[CONTROLLER1][0] )
+               *(io->ioJoyLatch+CONTROLLER1) &= (~JOY_A);
+               if ( io->alternator[CONTROLLER1][0] )
                {
-                  *(m_ioJoyLatch+CONTROLLER1) |= JOY_A;
+                  *(io->ioJoyLatch+CONTROLLER1) |= JOY_A;
                }
             }
-            if ( m_ioJoy[CONTROLLER1]&JOY_BTURBO )
+            if ( io->ioJoy[CONTROLLER1]&JOY_BTURBO )
             {
-               *(m_ioJoyLatch+CONTROLLER1) &= (~JOY_B);
-               if ( m_alternator[CONTROLLER1][1] )
+               *(io->ioJoyLatch+CONTROLLER1) &= (~JOY_B);
+               if ( io->alternator[CONTROLLER1][1] )
                {
-                  *(m_ioJoyLatch+CONTROLLER1) |= JOY_B;
+                  *(io->ioJoyLatch+CONTROLLER1) |= JOY_B;
                }
             }
-            if ( m_ioJoy[CONTROLLER2]&JOY_ATURBO )
+            if ( io->ioJoy[CONTROLLER2]&JOY_ATURBO )
             {
-               *(m_ioJoyLatch+CONTROLLER2) &= (~JOY_A);
-               if ( m_alternator[CONTROLLER2][0] )
+               *(io->ioJoyLatch+CONTROLLER2) &= (~JOY_A);
+               if ( io->alternator[CONTROLLER2][0] )
                {
-                  *(m_ioJoyLatch+CONTROLLER2) |= JOY_A;
+                  *(io->ioJoyLatch+CONTROLLER2) |= JOY_A;
                }
             }
-            if ( m_ioJoy[CONTROLLER2]&JOY_BTURBO )
+            if ( io->ioJoy[CONTROLLER2]&JOY_BTURBO )
             {
-               *(m_ioJoyLatch+CONTROLLER2) &= (~JOY_B);
-               if ( m_alternator[CONTROLLER2][1] )
+               *(io->ioJoyLatch+CONTROLLER2) &= (~JOY_B);
+               if ( io->alternator[CONTROLLER2][1] )
                {
-                  *(m_ioJoyLatch+CONTROLLER2) |= JOY_B;
+                  *(io->ioJoyLatch+CONTROLLER2) |= JOY_B;
                }
             }
          }
 
-         m_last4016 = data;
+         io->last4016 = data;
          break;
    }
 }
 
-uint32_t CIOTurboJoypad::_IO ( uint32_t addr )
+uint32_t CIOTurboJoypad::_IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
    switch ( addr )
    {
       case IOJOY1:
-         data = 0x40|(m_ioJoyLatch[CONTROLLER1]&0x01);
+         data = 0x40|(io->ioJoyLatch[CONTROLLER1]&0x01);
          break;
 
       case IOJOY2:
-         data = 0x40|(m_ioJoyLatch[CONTROLLER2]&0x01);
+         data = 0x40|(io->ioJoyLatch[CONTROLLER2]&0x01);
          break;
    }
 
    return data;
 }
 
-void CIOTurboJoypad::_IO ( uint32_t addr, uint8_t data )
+void CIOTurboJoypad::_IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    switch ( addr )
    {
       case IOJOY1:
 
-         if ( (m_last4016&1) && (!(data&1)) ) // latch on negative edge
+         if ( (io->last4016&1) && (!(data&1)) ) // latch on negative edge
          {
-            *(m_ioJoyLatch+CONTROLLER1) = *(m_ioJoy+CONTROLLER1);
-            *(m_ioJoyLatch+CONTROLLER2) = *(m_ioJoy+CONTROLLER2);
+            *(io->ioJoyLatch+CONTROLLER1) = *(io->ioJoy+CONTROLLER1);
+            *(io->ioJoyLatch+CONTROLLER2) = *(io->ioJoy+CONTROLLER2);
          }
 
-         m_last4016 = data;
+         io->last4016 = data;
          break;
    }
 }
 
-uint32_t CIOZapper::IO ( uint32_t addr )
+uint32_t CIOZapper::IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
    int32_t px, py, wx1, wy1, wx2, wy2;
@@ -266,7 +286,7 @@ uint32_t CIOZapper::IO ( uint32_t addr )
    switch ( addr )
    {
       case IOJOY1:
-         CNES::NES()->CONTROLLERPOSITION(CONTROLLER1,&px,&py,&wx1,&wy1,&wx2,&wy2);
+         io->nes->CONTROLLERPOSITION(CONTROLLER1,&px,&py,&wx1,&wy1,&wx2,&wy2);
          if ( (py > wy1) && (py < wy2) &&
               (px > wx1) && (px < wx2) )
          {
@@ -283,7 +303,7 @@ uint32_t CIOZapper::IO ( uint32_t addr )
             {
                for ( pys = py; pys < py+8; pys++ )
                {
-                  CNES::NES()->PPU()->PIXELRGB(pxs,pys,&r,&g,&b);
+                  io->nes->PPU()->PIXELRGB(pxs,pys,&r,&g,&b);
                   if ( (r>0) || (g>0) || (b>0) )
                   {
                      nonBlacks++;
@@ -293,7 +313,7 @@ uint32_t CIOZapper::IO ( uint32_t addr )
          }
 
          // grab trigger state...
-         data = m_ioJoy [ CONTROLLER1 ];
+         data = io->ioJoy [ CONTROLLER1 ];
 
          if ( nonBlacks > 0 )
          {
@@ -307,7 +327,7 @@ uint32_t CIOZapper::IO ( uint32_t addr )
          break;
 
       case IOJOY2:
-         CNES::NES()->CONTROLLERPOSITION(CONTROLLER2,&px,&py,&wx1,&wy1,&wx2,&wy2);
+         io->nes->CONTROLLERPOSITION(CONTROLLER2,&px,&py,&wx1,&wy1,&wx2,&wy2);
          if ( (py > wy1) && (py < wy2) &&
               (px > wx1) && (px < wx2) )
          {
@@ -324,7 +344,7 @@ uint32_t CIOZapper::IO ( uint32_t addr )
             {
                for ( pys = py; pys < py+8; pys++ )
                {
-                  CNES::NES()->PPU()->PIXELRGB(pxs,pys,&r,&g,&b);
+                  io->nes->PPU()->PIXELRGB(pxs,pys,&r,&g,&b);
                   if ( (r>0) || (g>0) || (b>0) )
                   {
                      nonBlacks++;
@@ -334,7 +354,7 @@ uint32_t CIOZapper::IO ( uint32_t addr )
          }
 
          // grab trigger state...
-         data = m_ioJoy [ CONTROLLER2 ];
+         data = io->ioJoy [ CONTROLLER2 ];
 
          if ( nonBlacks > 0 )
          {
@@ -351,14 +371,14 @@ uint32_t CIOZapper::IO ( uint32_t addr )
    return data;
 }
 
-void CIOZapper::IO ( uint32_t addr, uint8_t data )
+void CIOZapper::IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    // Writes to zapper have no effect...
 }
 
-uint32_t CIOZapper::_IO ( uint32_t addr )
+uint32_t CIOZapper::_IO ( IOState* io, uint32_t addr )
 {
-   uint32_t data = CIO::_IO(addr);
+   uint32_t data = CIO::_IO(io,addr);
 
    switch ( addr )
    {
@@ -372,32 +392,32 @@ uint32_t CIOZapper::_IO ( uint32_t addr )
    return data;
 }
 
-void CIOZapper::_IO ( uint32_t addr, uint8_t data )
+void CIOZapper::_IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    // Writes to zapper have no effect...
 }
 
-uint32_t CIOVaus::IO ( uint32_t addr )
+uint32_t CIOVaus::IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
    switch ( addr )
    {
       case IOJOY1:
-         data = 0x40|(*(m_ioJoy+CONTROLLER1))|(((*(m_ioPotLatch+CONTROLLER1))&0x80)>>3);
-         *(m_ioPotLatch+CONTROLLER1) <<= 1;
+         data = 0x40|(*(io->ioJoy+CONTROLLER1))|(((*(io->ioPotLatch+CONTROLLER1))&0x80)>>3);
+         *(io->ioPotLatch+CONTROLLER1) <<= 1;
          break;
 
       case IOJOY2:
-         data = 0x40|(*(m_ioJoy+CONTROLLER2))|(((*(m_ioPotLatch+CONTROLLER2))&0x80)>>3);
-         *(m_ioPotLatch+CONTROLLER2) <<= 1;
+         data = 0x40|(*(io->ioJoy+CONTROLLER2))|(((*(io->ioPotLatch+CONTROLLER2))&0x80)>>3);
+         *(io->ioPotLatch+CONTROLLER2) <<= 1;
          break;
    }
 
    return data;
 }
 
-void CIOVaus::IO ( uint32_t addr, uint8_t data )
+void CIOVaus::IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    int32_t px1, py1;
    int32_t px2, py2;
@@ -406,47 +426,47 @@ void CIOVaus::IO ( uint32_t addr, uint8_t data )
    switch ( addr )
    {
       case IOJOY1:
-         CNES::NES()->CONTROLLERPOSITION(CONTROLLER1,&px1,&py1,&wx1,&wy1,&wx2,&wy2);
-         CNES::NES()->CONTROLLERPOSITION(CONTROLLER2,&px2,&py2,&wx1,&wy1,&wx2,&wy2);
+         io->nes->CONTROLLERPOSITION(CONTROLLER1,&px1,&py1,&wx1,&wy1,&wx2,&wy2);
+         io->nes->CONTROLLERPOSITION(CONTROLLER2,&px2,&py2,&wx1,&wy1,&wx2,&wy2);
 
-         if ( (m_last4016&1) && (!(data&1)) ) // latch on negative edge
+         if ( (io->vausLast4016&1) && (!(data&1)) ) // latch on negative edge
          {
             if ( (py1 > wy1) && (py1 < wy2) &&
                  (px1 > wx1) && (px1 < wx2) )
             {
-               *(m_ioPotLatch+CONTROLLER1) = ~((uint8_t)((((px1-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(m_trimPot+CONTROLLER1)));
+               *(io->ioPotLatch+CONTROLLER1) = ~((uint8_t)((((px1-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(io->trimPot+CONTROLLER1)));
             }
             if ( (py2 > wy1) && (py2 < wy2) &&
                  (px2 > wx1) && (px2 < wx2) )
             {
-               *(m_ioPotLatch+CONTROLLER2) = ~((uint8_t)((((px2-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(m_trimPot+CONTROLLER2)));
+               *(io->ioPotLatch+CONTROLLER2) = ~((uint8_t)((((px2-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(io->trimPot+CONTROLLER2)));
             }
          }
 
-         m_last4016 = data;
+         io->vausLast4016 = data;
          break;
    }
 }
 
-uint32_t CIOVaus::_IO ( uint32_t addr )
+uint32_t CIOVaus::_IO ( IOState* io, uint32_t addr )
 {
    uint32_t data = 0xFF;
 
    switch ( addr )
    {
       case IOJOY1:
-         data = 0x40|(*(m_ioJoy+CONTROLLER1))|(((*(m_ioPotLatch+CONTROLLER1))&0x80)>>3);
+         data = 0x40|(*(io->ioJoy+CONTROLLER1))|(((*(io->ioPotLatch+CONTROLLER1))&0x80)>>3);
          break;
 
       case IOJOY2:
-         data = 0x40|(*(m_ioJoy+CONTROLLER2))|(((*(m_ioPotLatch+CONTROLLER2))&0x80)>>3);
+         data = 0x40|(*(io->ioJoy+CONTROLLER2))|(((*(io->ioPotLatch+CONTROLLER2))&0x80)>>3);
          break;
    }
 
    return data;
 }
 
-void CIOVaus::_IO ( uint32_t addr, uint8_t data )
+void CIOVaus::_IO ( IOState* io, uint32_t addr, uint8_t data )
 {
    int32_t px1, py1;
    int32_t px2, py2;
@@ -455,29 +475,29 @@ void CIOVaus::_IO ( uint32_t addr, uint8_t data )
    switch ( addr )
    {
       case IOJOY1:
-         CNES::NES()->CONTROLLERPOSITION(CONTROLLER1,&px1,&py1,&wx1,&wy1,&wx2,&wy2);
-         CNES::NES()->CONTROLLERPOSITION(CONTROLLER2,&px2,&py2,&wx1,&wy1,&wx2,&wy2);
+         io->nes->CONTROLLERPOSITION(CONTROLLER1,&px1,&py1,&wx1,&wy1,&wx2,&wy2);
+         io->nes->CONTROLLERPOSITION(CONTROLLER2,&px2,&py2,&wx1,&wy1,&wx2,&wy2);
 
-         if ( (m_last4016&1) && (!(data&1)) ) // latch on negative edge
+         if ( (io->vausLast4016&1) && (!(data&1)) ) // latch on negative edge
          {
             if ( (py1 > wy1) && (py1 < wy2) &&
                  (px1 > wx1) && (px1 < wx2) )
             {
-               *(m_ioPotLatch+CONTROLLER1) = ~((uint8_t)((((px1-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(m_trimPot+CONTROLLER1)));
+               *(io->ioPotLatch+CONTROLLER1) = ~((uint8_t)((((px1-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(io->trimPot+CONTROLLER1)));
             }
             if ( (py2 > wy1) && (py2 < wy2) &&
                  (px2 > wx1) && (px2 < wx2) )
             {
-               *(m_ioPotLatch+CONTROLLER2) = ~((uint8_t)((((px2-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(m_trimPot+CONTROLLER2)));
+               *(io->ioPotLatch+CONTROLLER2) = ~((uint8_t)((((px2-wx1)*VAUS_POT_RANGE)/(wx2-wx1)))+(*(io->trimPot+CONTROLLER2)));
             }
          }
 
-         m_last4016 = data;
+         io->vausLast4016 = data;
          break;
    }
 }
 
-void CIOVaus::SPECIAL(int32_t port,int32_t special)
+void CIOVaus::SPECIAL(IOState* io,int32_t port,int32_t special)
 {
-   m_trimPot[port] = special;
+   io->trimPot[port] = special;
 }
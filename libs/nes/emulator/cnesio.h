@@ -4,22 +4,54 @@
 #include "cjoypadlogger.h"
 #include "nes_emulator_core.h"
 
+class CNES;
+class CNESSaveState;
+
+// The controller port state of one emulated machine.  The CIO classes
+// hold no state of their own; each machine owns one of these and hands
+// it to whichever controller handlers are plugged into its ports.
+typedef struct _IOState
+{
+   // The machine the ports belong to.
+   CNES*          nes;
+
+   // Default IO implementation stuff.
+   uint32_t       ioJoy [ NUM_CONTROLLERS ];
+
+   // Standard joypad stuff.
+   uint8_t        ioJoyLatch [ NUM_CONTROLLERS ];
+   uint8_t        last4016;
+   CJoypadLogger  logger [ NUM_CONTROLLERS ];
+
+   // Turbo joypad stuff.
+   uint32_t       lastFrame;
+   uint8_t        alternator [ NUM_CONTROLLERS ][ 2 ];
+
+   // Vaus Arkanoid pad stuff.
+   uint8_t        ioPotLatch [ NUM_CONTROLLERS ];
+   uint8_t        vausLast4016;
+   uint8_t        trimPot [ NUM_CONTROLLERS ];
+} IOState;
+
+// Puts an IOState into its power-on state.
+void IOSTATEINIT ( IOState* io, CNES* pNES );
+
+// Moves the port state, but not the input loggers, to or from a save state.
+void IOSTATESERIALIZE ( IOState* io, CNESSaveState* state );
+
 class CIO
 {
 public:
    CIO() {}
 
-   static void IO ( uint32_t addr, uint8_t data );
-   static uint32_t IO ( uint32_t addr );
-   static void _IO ( uint32_t addr, uint8_t data );
-   static uint32_t _IO ( uint32_t addr );
-   static inline void JOY ( uint8_t joy, uint32_t data )
+   static void IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t IO ( IOState* io, uint32_t addr );
+   static void _IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t _IO ( IOState* io, uint32_t addr );
+   static inline void JOY ( IOState* io, uint8_t joy, uint32_t data )
    {
-      *(m_ioJoy+joy) = data;
+      *(io->ioJoy+joy) = data;
    }
-
-protected:
-   static uint32_t  m_ioJoy [ NUM_CONTROLLERS ];
 };
 
 class CIOStandardJoypad : public CIO
@@ -27,16 +59,11 @@ class CIOStandardJoypad : public CIO
 public:
    CIOStandardJoypad() {}
 
-   static void IO ( uint32_t addr, uint8_t data );
-   static uint32_t IO ( uint32_t addr );
-   static void _IO ( uint32_t addr, uint8_t data );
-   static uint32_t _IO ( uint32_t addr );
-   static inline CJoypadLogger* LOGGER ( int idx ) { return m_logger+idx; }
-
-protected:
-   static uint8_t   m_ioJoyLatch [ NUM_CONTROLLERS ];
-   static uint8_t   m_last4016;
-   static CJoypadLogger  m_logger [ NUM_CONTROLLERS ];
+   static void IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t IO ( IOState* io, uint32_t addr );
+   static void _IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t _IO ( IOState* io, uint32_t addr );
+   static inline CJoypadLogger* LOGGER ( IOState* io, int idx ) { return io->logger+idx; }
 };
 
 class CIOTurboJoypad : public CIOStandardJoypad
@@ -44,13 +71,9 @@ class CIOTurboJoypad : public CIOStandardJoypad
 public:
    CIOTurboJoypad() {}
 
-   static void IO ( uint32_t addr, uint8_t data );
-   static void _IO ( uint32_t addr, uint8_t data );
-   static uint32_t _IO ( uint32_t addr );
-
-protected:
-   static uint32_t m_lastFrame;
-   static uint8_t m_alternator [ NUM_CONTROLLERS ][ 2 ];
+   static void IO ( IOState* io, uint32_t addr, uint8_t data );
+   static void _IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t _IO ( IOState* io, uint32_t addr );
 };
 
 class CIOVaus : public CIO
@@ -58,16 +81,11 @@ class CIOVaus : public CIO
 public:
    CIOVaus() {}
 
-   static void IO ( uint32_t addr, uint8_t data );
-   static uint32_t IO ( uint32_t addr );
-   static void _IO ( uint32_t addr, uint8_t data );
-   static uint32_t _IO ( uint32_t addr );
-   static void SPECIAL ( int32_t port, int32_t special );
-
-protected:
-   static uint8_t   m_ioPotLatch [ NUM_CONTROLLERS ];
-   static uint8_t   m_last4016;
-   static uint8_t   m_trimPot [ NUM_CONTROLLERS ];
+   static void IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t IO ( IOState* io, uint32_t addr );
+   static void _IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t _IO ( IOState* io, uint32_t addr );
+   static void SPECIAL ( IOState* io, int32_t port, int32_t special );
 };
 
 class CIOZapper : public CIO
@@ -75,10 +93,10 @@ class CIOZapper : public CIO
 public:
    CIOZapper() {}
 
-   static void IO ( uint32_t addr, uint8_t data );
-   static uint32_t IO ( uint32_t addr );
-   static void _IO ( uint32_t addr, uint8_t data );
-   static uint32_t _IO ( uint32_t addr );
+   static void IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t IO ( IOState* io, uint32_t addr );
+   static void _IO ( IOState* io, uint32_t addr, uint8_t data );
+   static uint32_t _IO ( IOState* io, uint32_t addr );
 };
 
 #endif
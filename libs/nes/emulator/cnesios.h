@@ -2,10 +2,11 @@
 #define IOS_H
 
 #include "nes_emulator_core.h"
+#include "cnesio.h"
 
-typedef uint32_t (*IORFUNC)(uint32_t addr);
-typedef void (*IOWFUNC)(uint32_t addr, uint8_t data);
-typedef void (*SPECIALFUNC)(int32_t port,int32_t special);
+typedef uint32_t (*IORFUNC)(IOState* io, uint32_t addr);
+typedef void (*IOWFUNC)(IOState* io, uint32_t addr, uint8_t data);
+typedef void (*SPECIALFUNC)(IOState* io, int32_t port,int32_t special);
 
 typedef struct _IOFuncs
 {
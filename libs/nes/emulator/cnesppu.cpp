@@ -20,6 +20,7 @@
 #include "cnes6502.h"
 #include "cnesrom.h"
 #include "cnesapu.h"
+#include "cnessavestate.h"
 
 #include "nes_emulator_core.h"
 
@@ -34,11 +35,10 @@ static uint8_t tblDefaultPalette [] =
    0x09,0x01,0x34,0x03,0x00,0x04,0x00,0x14,0x08,0x3A,0x00,0x02,0x00,0x20,0x2C,0x08
 };
 
-CPPU::CPPU()
-   : m_PPUmemory(CMEMORY(0x2000,MEM_1KB,2,8))
+CPPU::CPPU(CNES* pNES)
+   : m_nes(pNES),
+     m_PPUmemory(CMEMORY(pNES,0x2000,MEM_1KB,2,8))
 {
-   int idx;
-
    m_oamAddr = 0x00;
    m_ppuRegByte = 0;
    m_ppuAddr = 0x0000;
@@ -53,12 +53,20 @@ CPPU::CPPU()
    m_oneScreen = -1;
 
    m_cycles = 0;
+   m_syncCaps = SYNC_NONE;
+   m_eventCycle = PPU_NO_EVENT;
+   m_syncA12 = PPU_A13;
+   memset(m_eventRows,0,sizeof(m_eventRows));
+   memset(m_scanlineRow,0,sizeof(m_scanlineRow));
+   SYNCDOTCOUNTER ();
 
    m_vblankChoked = false;
    m_nmiChoked = false;
    m_nmiReenabled = false;
 
    m_pTV = NULL;
+   m_tvFormat = TV_FORMAT_RGBA;
+   SELECTTVPALETTE ();
 
    m_frame = 0;
    m_curCycles = 0;
@@ -70,161 +78,130 @@ CPPU::CPPU()
    m_x = 0xFF;
    m_y = 0xFF;
 
+   m_bkgndPatternIdx = 0;
+   memset(&m_bkgndTemp,0,sizeof(m_bkgndTemp));
+   memset(&m_spriteDevNull,0,sizeof(m_spriteDevNull));
+   m_pSpriteEval = &m_spriteDevNull;
+   m_spritesFound = 0;
+
    m_logger = new CCodeDataLogger ( MEM_16KB, MASK_16KB );
 
-   m_2005x = new uint16_t*[256];
-   for ( idx = 0; idx < 256; idx++ )
-   {
-      m_2005x[idx] = new uint16_t[240];
-   }
-   m_2005y = new uint16_t*[256];
-   for ( idx = 0; idx < 256; idx++ )
-   {
-      m_2005y[idx] = new uint16_t[240];
-   }
+   memset(m_scrollChanges,0,sizeof(m_scrollChanges));
 }
 
 CPPU::~CPPU()
 {
-   int idx;
-
    delete m_logger;
-   for ( idx = 0; idx < 256; idx++ )
-   {
-      delete [] m_2005x[idx];
-   }
-   delete [] m_2005x;
-   for ( idx = 0; idx < 256; idx++ )
-   {
-      delete [] m_2005y[idx];
-   }
-   delete [] m_2005y;
 }
 
 void CPPU::EMULATE(uint32_t cycles)
 {
-   uint32_t idxx = 0xffffffff;
-   uint32_t idxy = 0xffffffff;
-   uint32_t cycleInScanline;
-   uint32_t scanlineInPlane;
+   uint32_t events;
 
    for ( ; cycles > 0; cycles-- )
    {
-      // Reduce some maths
-      cycleInScanline = m_cycles%PPU_CYCLES_PER_SCANLINE;
-      scanlineInPlane = m_cycles/PPU_CYCLES_PER_SCANLINE;
-
-      // Get VBLANK raster position.
-      if ( m_cycles >= startVblank )
-      {
-         idxy = (m_cycles-startVblank)/PPU_CYCLES_PER_SCANLINE;
-         idxx = (m_cycles-startVblank)%PPU_CYCLES_PER_SCANLINE;
-      }
-
-      // We're emulating one PPU cycle...
-      m_curCycles += CPU_CYCLE_ADJUST;
+      // What happens on this cycle...
+      events = m_dotEvents[m_dot];
 
       // Update PPU address from latch at appropriate times...
       // Re-latch PPU address...
-      if ( rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES) )
+      if ( (events&PPU_DOT_ADDRESS_EVENTS) &&
+           (rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES)) )
       {
-         if ( scanlineInPlane < SCANLINES_VISIBLE )
+         if ( events&PPU_DOT_COPY_HORIZ )
          {
-            if ( cycleInScanline == 257 )
-            {
-               m_ppuAddr &= 0xFBE0;
-               m_ppuAddr |= m_ppuAddrLatch&0x41F;
-            }
-            else if ( cycleInScanline == 251 )
+            m_ppuAddr &= 0xFBE0;
+            m_ppuAddr |= m_ppuAddrLatch&0x41F;
+         }
+         else if ( events&PPU_DOT_INC_VERT )
+         {
+            if ( (m_ppuAddr&0x7000) == 0x7000 )
             {
-               if ( (m_ppuAddr&0x7000) == 0x7000 )
-               {
-                  m_ppuAddr &= 0x8FFF;
+               m_ppuAddr &= 0x8FFF;
 
-                  if ( (m_ppuAddr&0x03E0) == 0x03A0 )
+               if ( (m_ppuAddr&0x03E0) == 0x03A0 )
+               {
+                  m_ppuAddr ^= 0x0800;
+                  m_ppuAddr &= 0xFC1F;
+               }
+               else
+               {
+                  if ( (m_ppuAddr&0x03E0) == 0x03E0 )
                   {
-                     m_ppuAddr ^= 0x0800;
                      m_ppuAddr &= 0xFC1F;
                   }
                   else
                   {
-                     if ( (m_ppuAddr&0x03E0) == 0x03E0 )
-                     {
-                        m_ppuAddr &= 0xFC1F;
-                     }
-                     else
-                     {
-                        m_ppuAddr += 0x0020;
-                     }
+                     m_ppuAddr += 0x0020;
                   }
                }
-               else
-               {
-                  m_ppuAddr += 0x1000;
-               }
             }
+            else
+            {
+               m_ppuAddr += 0x1000;
+            }
+         }
 
-            if ( ((cycleInScanline&7) == 3) &&
-                  ((cycleInScanline < 256) ||
-                   (cycleInScanline == 323) ||
-                   (cycleInScanline == 331)) )
+         if ( events&PPU_DOT_INC_HORIZ )
+         {
+            if ( (m_ppuAddr&0x001F) != 0x001F )
             {
-               if ( (m_ppuAddr&0x001F) != 0x001F )
-               {
-                  m_ppuAddr++;
-               }
-               else
-               {
-                  m_ppuAddr ^= 0x041F;
-               }
+               m_ppuAddr++;
+            }
+            else
+            {
+               m_ppuAddr ^= 0x041F;
             }
          }
-         else if ( (scanlineInPlane == prerenderScanline) &&
-                   (cycleInScanline == 304) )
+         else if ( events&PPU_DOT_COPY_VERT )
          {
             m_ppuAddr = m_ppuAddrLatch;
          }
       }
 
-      // Run 0 or 1 CPU cycles...
-      CNES::NES()->CPU()->EMULATE ( m_curCycles/cycleRatio );
-
-      // Adjust current cycle count...
-      m_curCycles %= cycleRatio;
+      // We're emulating one PPU cycle...run a CPU cycle if one is due.
+      // m_curCycles is always less than cycleRatio here so at most one is.
+      m_curCycles += CPU_CYCLE_ADJUST;
+      if ( m_curCycles >= (int32_t)cycleRatio )
+      {
+         m_curCycles -= cycleRatio;
+         NES()->CPU()->EMULATE ( 1 );
+      }
 
       // Turn off NMI choking if it shouldn't be...
-      if ( m_cycles > startVblank+1 )
+      if ( events&PPU_DOT_NMI_UNCHOKE )
       {
          NMICHOKED ( false );
       }
 
       // Turn off NMI re-enablement if it shouldn't be...
-      if ( m_cycles > vblankEndCycle )
+      if ( events&PPU_DOT_NMI_UNREENABLE )
       {
          NMIREENABLED ( false );
       }
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for breakpoints...
-         CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUCycle );
+         NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUCycle );
       }
 
-      if ( (rPPU(PPUCTRL)&PPUCTRL_GENERATE_NMI) &&
-            (((!NMICHOKED()) && (idxy == 0) && (idxx == 1)) ||
-             ((NMIREENABLED()) && (idxy <= vblankScanlines-1) && (idxx < PPU_CYCLES_PER_SCANLINE-1))) )
+      if ( (events&PPU_DOT_NMI_EVENTS) &&
+           (rPPU(PPUCTRL)&PPUCTRL_GENERATE_NMI) &&
+           (((events&PPU_DOT_NMI_EDGE) && (!NMICHOKED())) ||
+            ((events&PPU_DOT_NMI_WINDOW) && (NMIREENABLED()))) )
       {
-         CNES::NES()->CPU()->ASSERTNMI ();
+         NES()->CPU()->ASSERTNMI ();
 
          // Check for PPU NMI breakpoint...
-         CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_NMI );
+         NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_NMI );
       }
 
       // Clear OAM at appropriate point...
       // Note the appropriate point comes from blargg's discussion on nesdev forum:
       // http://nesdev.parodius.com/bbs/viewtopic.php?t=1366&highlight=sprite+address+clear
-      if ( ((rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES)) == (PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES)) &&
-           (idxy == 19) && (idxx == 316) )
+      if ( (events&PPU_DOT_OAM_CLEAR) &&
+           ((rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES)) == (PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES)) )
       {
          m_oamAddr = 0x00;
       }
@@ -232,6 +209,148 @@ void CPPU::EMULATE(uint32_t cycles)
       // Internal cycle counter keeps track of stuff needing to happen
       // at particular PPU frame cycles.  It is reset at the end of a frame.
       m_cycles++;
+      m_dot++;
+      if ( m_dot == PPU_CYCLES_PER_SCANLINE )
+      {
+         m_dot = 0;
+         if ( m_scanline < SCANLINES_TOTAL_PAL )
+         {
+            m_scanline++;
+         }
+         m_dotEvents = m_eventRows[m_scanlineRow[m_scanline]];
+      }
+
+      if ( m_cycles == m_eventCycle )
+      {
+         m_eventCycle = PPU_NO_EVENT;
+         NES()->CART()->PPUEVENT ();
+      }
+   }
+}
+
+void CPPU::BUILDEVENTTABLE ( void )
+{
+   uint32_t dot;
+   uint32_t scanline;
+   uint32_t vblankScanline;
+
+   memset(m_eventRows,0,sizeof(m_eventRows));
+
+   // Visible scanlines update the PPU address as the background is fetched.
+   for ( dot = 0; dot < PPU_CYCLES_PER_SCANLINE; dot++ )
+   {
+      if ( ((dot&7) == 3) &&
+           ((dot < 256) || (dot == 323) || (dot == 331)) )
+      {
+         m_eventRows[ePPURow_Visible][dot] |= PPU_DOT_INC_HORIZ;
+      }
+   }
+   m_eventRows[ePPURow_Visible][251] |= PPU_DOT_INC_VERT;
+   m_eventRows[ePPURow_Visible][257] |= PPU_DOT_COPY_HORIZ;
+
+   // NMI is asserted on the second cycle of VBLANK unless a read of
+   // $2002 choked it, and can be re-asserted almost anywhere in VBLANK
+   // by re-enabling it.  The choke only lasts until the cycle after.
+   for ( dot = 0; dot < PPU_CYCLES_PER_SCANLINE; dot++ )
+   {
+      m_eventRows[ePPURow_Vblank][dot] = PPU_DOT_NMI_UNCHOKE;
+      if ( dot < PPU_CYCLES_PER_SCANLINE-1 )
+      {
+         m_eventRows[ePPURow_Vblank][dot] |= PPU_DOT_NMI_WINDOW;
+      }
+      m_eventRows[ePPURow_VblankFirst][dot] = m_eventRows[ePPURow_Vblank][dot];
+      m_eventRows[ePPURow_VblankOAMClear][dot] = m_eventRows[ePPURow_Vblank][dot];
+      m_eventRows[ePPURow_Prerender][dot] = PPU_DOT_NMI_UNCHOKE|PPU_DOT_NMI_UNREENABLE;
+      m_eventRows[ePPURow_PastFrame][dot] = PPU_DOT_NMI_UNCHOKE|PPU_DOT_NMI_UNREENABLE;
+   }
+   m_eventRows[ePPURow_VblankFirst][0] &= (~PPU_DOT_NMI_UNCHOKE);
+   m_eventRows[ePPURow_VblankFirst][1] &= (~PPU_DOT_NMI_UNCHOKE);
+   m_eventRows[ePPURow_VblankFirst][1] |= PPU_DOT_NMI_EDGE;
+   m_eventRows[ePPURow_VblankOAMClear][316] |= PPU_DOT_OAM_CLEAR;
+   m_eventRows[ePPURow_Prerender][0] &= (~PPU_DOT_NMI_UNREENABLE);
+   m_eventRows[ePPURow_Prerender][304] |= PPU_DOT_COPY_VERT;
+
+   for ( scanline = 0; scanline <= SCANLINES_TOTAL_PAL; scanline++ )
+   {
+      vblankScanline = scanline-(startVblank/PPU_CYCLES_PER_SCANLINE);
+
+      if ( scanline < SCANLINES_VISIBLE )
+      {
+         m_scanlineRow[scanline] = ePPURow_Visible;
+      }
+      else if ( scanline < startVblank/PPU_CYCLES_PER_SCANLINE )
+      {
+         m_scanlineRow[scanline] = ePPURow_Quiet;
+      }
+      else if ( vblankScanline == 0 )
+      {
+         m_scanlineRow[scanline] = ePPURow_VblankFirst;
+      }
+      else if ( vblankScanline == 19 )
+      {
+         m_scanlineRow[scanline] = ePPURow_VblankOAMClear;
+      }
+      else if ( vblankScanline < vblankScanlines )
+      {
+         m_scanlineRow[scanline] = ePPURow_Vblank;
+      }
+      else if ( scanline == prerenderScanline )
+      {
+         m_scanlineRow[scanline] = ePPURow_Prerender;
+      }
+      else
+      {
+         m_scanlineRow[scanline] = ePPURow_PastFrame;
+      }
+   }
+}
+
+void CPPU::SYNCDOTCOUNTER ( void )
+{
+   m_dot = m_cycles%PPU_CYCLES_PER_SCANLINE;
+   m_scanline = m_cycles/PPU_CYCLES_PER_SCANLINE;
+   if ( m_scanline > SCANLINES_TOTAL_PAL )
+   {
+      m_scanline = SCANLINES_TOTAL_PAL;
+   }
+   m_dotEvents = m_eventRows[m_scanlineRow[m_scanline]];
+}
+
+void CPPU::SYNCCAPS ( uint32_t caps )
+{
+   m_syncCaps = caps;
+   m_syncA12 = PPU_A13;
+}
+
+inline void CPPU::SYNCCART ( uint32_t addr, int8_t source )
+{
+   if ( m_syncCaps )
+   {
+      if ( m_syncCaps&SYNC_PPU_FETCH )
+      {
+         NES()->CART()->SYNCPPU(m_cycles,addr);
+      }
+      else if ( m_syncCaps&SYNC_PPU_A12 )
+      {
+         // Nothing happens on an MMC3 unless A12 changes.
+         if ( (addr&PPU_A12) != m_syncA12 )
+         {
+            m_syncA12 = addr&PPU_A12;
+            NES()->CART()->SYNCPPU(m_cycles,addr);
+         }
+      }
+      else if ( m_syncCaps&SYNC_PPU_LATCH )
+      {
+         // Address bits 4-11 are $FD or $FE.
+         if ( ((addr+0x10)&0x0FE0) == 0x0FE0 )
+         {
+            NES()->CART()->SYNCPPU(m_cycles,addr);
+         }
+      }
+      else if ( (m_syncCaps&SYNC_PPU_ADDRESS) && (source == eNESSource_CPU) )
+      {
+         NES()->CART()->SYNCPPU(m_cycles,addr);
+      }
    }
 }
 
@@ -244,17 +363,17 @@ uint32_t CPPU::LOAD ( uint32_t addr, int8_t source, int8_t type, bool trace )
    if ( trace )
    {
       // Provide PPU cycle and address to mappers that watch such things!
-      CNES::NES()->CART()->SYNCPPU(m_cycles,addr);
+      SYNCCART(addr,source);
    }
 
    if ( addr < 0x2000 )
    {
-      data = CNES::NES()->CART()->CHRMEM ( addr );
+      data = NES()->CART()->CHRMEM ( addr );
 
       // Add Tracer sample...
-      if ( nesIsDebuggable && trace )
+      if ( NES()->DEBUGGABLE() && trace )
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_PatternMemory, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_PatternMemory, addr, data );
       }
 
       return data;
@@ -265,15 +384,15 @@ uint32_t CPPU::LOAD ( uint32_t addr, int8_t source, int8_t type, bool trace )
       data = *(m_PALETTEmemory+(addr&0x1F));
 
       // Add Tracer sample...
-      if ( nesIsDebuggable && trace )
+      if ( NES()->DEBUGGABLE() && trace )
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_Palette, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_Palette, addr, data );
       }
 
       return data;
    }
 
-   uint32_t tryCart = CNES::NES()->CART()->VRAM(addr);
+   uint32_t tryCart = NES()->CART()->VRAM(addr);
    data = tryCart&0xFF;
    if ( tryCart == CART_UNCLAIMED )
    {
@@ -281,15 +400,15 @@ uint32_t CPPU::LOAD ( uint32_t addr, int8_t source, int8_t type, bool trace )
    }
 
    // Add Tracer sample...
-   if ( nesIsDebuggable && trace )
+   if ( NES()->DEBUGGABLE() && trace )
    {
       if ( (addr&0x3FF) < 0x3C0 )
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_NameTable, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_NameTable, addr, data );
       }
       else
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_AttributeTable, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_AttributeTable, addr, data );
       }
    }
 
@@ -303,20 +422,20 @@ void CPPU::STORE ( uint32_t addr, uint8_t data, int8_t source, int8_t type, bool
    if ( trace )
    {
       // Provide PPU cycle and address to mappers that watch such things!
-      CNES::NES()->CART()->SYNCPPU(m_cycles,addr);
+      SYNCCART(addr,source);
    }
 
    if ( addr < 0x2000 )
    {
       // Add Tracer sample...
-      if ( nesIsDebuggable && trace )
+      if ( NES()->DEBUGGABLE() && trace )
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_PatternMemory, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_PatternMemory, addr, data );
       }
 
-      if ( CNES::NES()->CART()->IsWriteProtected() == false )
+      if ( NES()->CART()->IsWriteProtected() == false )
       {
-         CNES::NES()->CART()->CHRMEM ( addr, data );
+         NES()->CART()->CHRMEM ( addr, data );
       }
 
       return;
@@ -325,9 +444,9 @@ void CPPU::STORE ( uint32_t addr, uint8_t data, int8_t source, int8_t type, bool
    if ( addr >= 0x3F00 )
    {
       // Add Tracer sample...
-      if ( nesIsDebuggable && trace )
+      if ( NES()->DEBUGGABLE() && trace )
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_Palette, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_Palette, addr, data );
       }
 
       if ( !(addr&0xF) )
@@ -344,25 +463,78 @@ void CPPU::STORE ( uint32_t addr, uint8_t data, int8_t source, int8_t type, bool
    }
 
    // Add Tracer sample...
-   if ( nesIsDebuggable && trace )
+   if ( NES()->DEBUGGABLE() && trace )
    {
       if ( (addr&0x3FF) < 0x3C0 )
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_NameTable, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_NameTable, addr, data );
       }
       else
       {
-         CNES::NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_AttributeTable, addr, data );
+         NES()->TRACER()->AddSample ( m_cycles, type, source, eTarget_AttributeTable, addr, data );
       }
    }
 
-   uint32_t tryCart = CNES::NES()->CART()->VRAM(addr,data);
+   uint32_t tryCart = NES()->CART()->VRAM(addr,data);
    if ( tryCart == CART_UNCLAIMED )
    {
       m_PPUmemory.MEM(addr,data);
    }
 }
 
+void CPPU::_MEMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length )
+{
+   uint32_t chunk;
+
+   while ( length )
+   {
+      addr &= 0x3FFF;
+      if ( addr < 0x2000 )
+      {
+         chunk = 0x2000-addr;
+         if ( chunk > length )
+         {
+            chunk = length;
+         }
+         NES()->CART()->CHRMEMCOPY(dest,addr,chunk);
+      }
+      else if ( addr < 0x3F00 )
+      {
+         chunk = 0x3F00-addr;
+         if ( chunk > length )
+         {
+            chunk = length;
+         }
+         if ( !NES()->CART()->VRAMCOPY(dest,addr,chunk) )
+         {
+            m_PPUmemory.MEMCOPY(dest,addr,chunk);
+         }
+      }
+      else
+      {
+         chunk = 1;
+         *dest = *(m_PALETTEmemory+(addr&0x1F));
+      }
+      dest += chunk;
+      addr += chunk;
+      length -= chunk;
+   }
+}
+
+bool CPPU::_MEMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   if ( addr+length <= 0x2000 )
+   {
+      return NES()->CART()->CHRMEMCHANGEDSINCE(addr,length,generation);
+   }
+   if ( (addr >= 0x2000) && (addr+length <= 0x3F00) )
+   {
+      return NES()->CART()->VRAMCHANGEDSINCE(addr,length,generation) ||
+             m_PPUmemory.CHANGEDSINCE(addr,length,generation);
+   }
+   return true;
+}
+
 uint32_t CPPU::RENDER ( uint32_t addr, int8_t target )
 {
    uint32_t data;
@@ -372,18 +544,18 @@ uint32_t CPPU::RENDER ( uint32_t addr, int8_t target )
 
    data = LOAD ( addr, eNESSource_PPU, target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
-      m_logger->LogAccess ( m_cycles, addr, data, eLogger_DataRead, eNESSource_PPU );
+      m_logger->LogAccess ( NES()->LOGGERSTATE(), m_cycles, addr, data, eLogger_DataRead, eNESSource_PPU );
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for PPU address breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, rPPUADDR(), PPU_EVENT_ADDRESS_EQUALS );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, rPPUADDR(), PPU_EVENT_ADDRESS_EQUALS );
 
       // Check for breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUFetch, data );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUFetch, data );
    }
 
    return data;
@@ -398,58 +570,64 @@ void CPPU::GARBAGE ( uint32_t addr, int8_t target )
 
    data = LOAD ( addr, eNESSource_PPU, target );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
-      CNES::NES()->TRACER()->AddGarbageFetch ( m_cycles, target, addr );
+      NES()->TRACER()->AddGarbageFetch ( m_cycles, target, addr );
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for PPU address breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, rPPUADDR(), PPU_EVENT_ADDRESS_EQUALS );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, rPPUADDR(), PPU_EVENT_ADDRESS_EQUALS );
 
       // Check for breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUFetch );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUFetch );
    }
 }
 
 void CPPU::EXTRA ()
 {
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
-      CNES::NES()->TRACER()->AddGarbageFetch ( m_cycles, eTarget_ExtraCycle, 0 );
+      NES()->TRACER()->AddGarbageFetch ( m_cycles, eTarget_ExtraCycle, 0 );
    }
 
    // Idle cycle...
    EMULATE(1);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for PPU address breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, rPPUADDR(), PPU_EVENT_ADDRESS_EQUALS );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, rPPUADDR(), PPU_EVENT_ADDRESS_EQUALS );
 
       // Check for breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUFetch );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUFetch );
    }
 }
 
 void CPPU::RESET ( bool soft )
 {
-   startVblank = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?PPU_CYCLE_START_VBLANK_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?PPU_CYCLE_START_VBLANK_PAL:PPU_CYCLE_START_VBLANK_DENDY;
-   quietScanlines = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?SCANLINES_QUIET_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?SCANLINES_QUIET_PAL:SCANLINES_QUIET_DENDY;
-   vblankScanlines = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?SCANLINES_VBLANK_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?SCANLINES_VBLANK_PAL:SCANLINES_VBLANK_DENDY;
-   vblankEndCycle = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?PPU_CYCLE_END_VBLANK_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?PPU_CYCLE_END_VBLANK_PAL:PPU_CYCLE_END_VBLANK_DENDY;
-   prerenderScanline = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?SCANLINE_PRERENDER_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?SCANLINE_PRERENDER_PAL:SCANLINE_PRERENDER_DENDY;
-   cycleRatio = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?PPU_CPU_RATIO_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?PPU_CPU_RATIO_PAL:PPU_CPU_RATIO_DENDY;
-   memoryDecayFrames = (CNES::NES()->VIDEOMODE()==MODE_NTSC)?PPU_DECAY_FRAME_COUNT_NTSC:(CNES::NES()->VIDEOMODE()==MODE_PAL)?PPU_DECAY_FRAME_COUNT_PAL:PPU_DECAY_FRAME_COUNT_DENDY;
+   startVblank = (NES()->VIDEOMODE()==MODE_NTSC)?PPU_CYCLE_START_VBLANK_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?PPU_CYCLE_START_VBLANK_PAL:PPU_CYCLE_START_VBLANK_DENDY;
+   quietScanlines = (NES()->VIDEOMODE()==MODE_NTSC)?SCANLINES_QUIET_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?SCANLINES_QUIET_PAL:SCANLINES_QUIET_DENDY;
+   vblankScanlines = (NES()->VIDEOMODE()==MODE_NTSC)?SCANLINES_VBLANK_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?SCANLINES_VBLANK_PAL:SCANLINES_VBLANK_DENDY;
+   vblankEndCycle = (NES()->VIDEOMODE()==MODE_NTSC)?PPU_CYCLE_END_VBLANK_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?PPU_CYCLE_END_VBLANK_PAL:PPU_CYCLE_END_VBLANK_DENDY;
+   prerenderScanline = (NES()->VIDEOMODE()==MODE_NTSC)?SCANLINE_PRERENDER_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?SCANLINE_PRERENDER_PAL:SCANLINE_PRERENDER_DENDY;
+   cycleRatio = (NES()->VIDEOMODE()==MODE_NTSC)?PPU_CPU_RATIO_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?PPU_CPU_RATIO_PAL:PPU_CPU_RATIO_DENDY;
+   memoryDecayFrames = (NES()->VIDEOMODE()==MODE_NTSC)?PPU_DECAY_FRAME_COUNT_NTSC:(NES()->VIDEOMODE()==MODE_PAL)?PPU_DECAY_FRAME_COUNT_PAL:PPU_DECAY_FRAME_COUNT_DENDY;
+   BUILDEVENTTABLE ();
 
    m_PPUreg [ 0 ] = 0x00;
    m_PPUreg [ 1 ] = 0x00;
    m_PPUreg [ 2 ] = 0x00;
+   SELECTTVPALETTE ();
 
    m_frame = 0;
    m_cycles = 0;
    m_curCycles = 0;
+   SYNCDOTCOUNTER ();
+
+   m_syncA12 = PPU_A13;
+   UNSCHEDULE ();
 
    m_vblankChoked = false;
    m_nmiChoked = false;
@@ -488,6 +666,57 @@ void CPPU::RESET ( bool soft )
    }
 }
 
+void CPPU::SERIALIZE ( CNESSaveState* state )
+{
+   int8_t spriteEval;
+
+   state->BEGINCHUNK ( "PPU ", 1 );
+   state->VALUE ( m_PALETTEmemory );
+   m_PPUmemory.SERIALIZEBANKS ( state );
+   m_PPUmemory.SERIALIZEMAP ( state );
+   state->VALUE ( m_ppuRegByte );
+   state->VALUE ( m_oamAddr );
+   state->VALUE ( m_ppuAddr );
+   state->VALUE ( m_ppuAddrLatch );
+   state->VALUE ( m_ppuAddrIncrement );
+   state->VALUE ( m_ppuReadLatch );
+   state->VALUE ( m_ppuIOLatch );
+   state->VALUE ( m_ppuIOLatchDecayFrames );
+   state->VALUE ( m_PPUreg );
+   state->VALUE ( m_PPUoam );
+   state->VALUE ( m_ppuScrollX );
+   state->VALUE ( m_oneScreen );
+   state->VALUE ( m_cycles );
+   state->VALUE ( m_frame );
+   state->VALUE ( m_curCycles );
+   state->VALUE ( m_vblankChoked );
+   state->VALUE ( m_nmiChoked );
+   state->VALUE ( m_nmiReenabled );
+   state->VALUE ( m_spriteTemporaryMemory );
+   state->VALUE ( m_spriteBuffer );
+   state->VALUE ( m_bkgndBuffer );
+   state->VALUE ( m_bkgndPatternIdx );
+   state->VALUE ( m_bkgndTemp );
+   state->VALUE ( m_spriteDevNull );
+   state->VALUE ( m_spritesFound );
+   state->VALUE ( m_x );
+   state->VALUE ( m_y );
+
+   // The sprite being evaluated is either a secondary OAM slot or the
+   // bit bucket; store which.
+   spriteEval = (m_pSpriteEval == &m_spriteDevNull)?-1:(m_pSpriteEval-m_spriteTemporaryMemory.data);
+   state->VALUE ( spriteEval );
+   if ( state->LOADING() )
+   {
+      m_pSpriteEval = ((spriteEval >= 0) && (spriteEval < NUM_SPRITES_PER_SCANLINE))?m_spriteTemporaryMemory.data+spriteEval:&m_spriteDevNull;
+      SYNCDOTCOUNTER ();
+      SELECTTVPALETTE ();
+      m_syncA12 = PPU_A13;
+      UNSCHEDULE ();
+   }
+   state->ENDCHUNK ();
+}
+
 uint32_t CPPU::PPU ( uint32_t addr )
 {
    uint8_t data = 0xFF;
@@ -530,10 +759,10 @@ uint32_t CPPU::PPU ( uint32_t addr )
       // Refresh I/O latch...
       m_ppuIOLatch = data;
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for breakpoint...
-         CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnOAMPortalRead, data );
+         NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnOAMPortalRead, data );
       }
    }
    else if ( fixAddr == PPUDATA_REG )
@@ -543,7 +772,7 @@ uint32_t CPPU::PPU ( uint32_t addr )
       m_ppuAddr += m_ppuAddrIncrement;
 
       // Toggling A12 causes IRQ count in some mappers...
-      CNES::NES()->CART()->SYNCPPU(m_cycles,m_ppuAddr);
+      SYNCCART(m_ppuAddr,eNESSource_CPU);
 
       if ( oldPpuAddr < 0x3F00 )
       {
@@ -572,13 +801,13 @@ uint32_t CPPU::PPU ( uint32_t addr )
          m_ppuReadLatch = m_PPUmemory.MEM(oldPpuAddr);
       }
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for breakpoint...
-         CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUPortalRead, data );
+         NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUPortalRead, data );
 
          // Log Code/Data logger...
-         m_logger->LogAccess ( CNES::NES()->CPU()->_CYCLES()/*m_cycles*/, oldPpuAddr, data, eLogger_DataRead, eNESSource_CPU );
+         m_logger->LogAccess ( NES()->LOGGERSTATE(), NES()->CPU()->_CYCLES()/*m_cycles*/, oldPpuAddr, data, eLogger_DataRead, eNESSource_CPU );
       }
    }
    else
@@ -586,10 +815,10 @@ uint32_t CPPU::PPU ( uint32_t addr )
       data = m_ppuIOLatch;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUState, fixAddr );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUState, fixAddr );
    }
 
    return data;
@@ -637,11 +866,25 @@ void CPPU::PPU ( uint32_t addr, uint8_t data )
       }
    }
 
-   if ( fixAddr == PPUCTRL_REG )
+   if ( fixAddr == PPUMASK_REG )
+   {
+      SELECTTVPALETTE ();
+
+      if ( m_syncCaps&SYNC_PPU_CONTROL )
+      {
+         NES()->CART()->SYNCPPUCONTROL ();
+      }
+   }
+   else if ( fixAddr == PPUCTRL_REG )
    {
       m_ppuAddrLatch &= 0x73FF;
       m_ppuAddrLatch |= ((((uint16_t)data&PPUCTRL_BASE_NAM_TBL_ADDR_MSK))<<10);
       m_ppuAddrIncrement = (((!!(data&PPUCTRL_VRAM_ADDR_INC))*31)+1);
+
+      if ( m_syncCaps&SYNC_PPU_CONTROL )
+      {
+         NES()->CART()->SYNCPPUCONTROL ();
+      }
    }
    else if ( fixAddr == OAMADDR_REG )
    {
@@ -651,10 +894,10 @@ void CPPU::PPU ( uint32_t addr, uint8_t data )
    {
       *(m_PPUoam+m_oamAddr) = data;
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for breakpoint...
-         CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnOAMPortalWrite, data );
+         NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnOAMPortalWrite, data );
       }
 
       m_oamAddr++;
@@ -668,10 +911,10 @@ void CPPU::PPU ( uint32_t addr, uint8_t data )
          m_ppuAddrLatch |= ((((uint16_t)data&0xF8))<<2);
          m_ppuAddrLatch |= ((((uint16_t)data&0x07))<<12);
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for PPU Y scroll update breakpoint...
-            CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_YSCROLL_UPDATE );
+            NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_YSCROLL_UPDATE );
          }
       }
       else
@@ -681,10 +924,10 @@ void CPPU::PPU ( uint32_t addr, uint8_t data )
          m_ppuAddrLatch &= 0xFFE0;
          m_ppuAddrLatch |= ((((uint16_t)data&0xF8))>>3);
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for PPU X scroll update breakpoint...
-            CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_XSCROLL_UPDATE );
+            NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_XSCROLL_UPDATE );
          }
       }
 
@@ -700,7 +943,7 @@ void CPPU::PPU ( uint32_t addr, uint8_t data )
          m_ppuAddr = m_ppuAddrLatch;
 
          // Toggling A12 causes IRQ count in some mappers...
-         CNES::NES()->CART()->SYNCPPU(m_cycles,m_ppuAddr);
+         SYNCCART(m_ppuAddr,eNESSource_CPU);
       }
       else
       {
@@ -716,25 +959,41 @@ void CPPU::PPU ( uint32_t addr, uint8_t data )
 
       oldPpuAddr = m_ppuAddr;
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
-         m_logger->LogAccess ( CNES::NES()->CPU()->_CYCLES()/*m_cycles*/, oldPpuAddr, data, eLogger_DataWrite, eNESSource_CPU );
+         m_logger->LogAccess ( NES()->LOGGERSTATE(), NES()->CPU()->_CYCLES()/*m_cycles*/, oldPpuAddr, data, eLogger_DataWrite, eNESSource_CPU );
 
          // Check for breakpoint...
-         CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUPortalWrite, data );
+         NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUPortalWrite, data );
       }
 
       // Increment PPUADDR
       m_ppuAddr += m_ppuAddrIncrement;
 
       // Toggling A12 causes IRQ count in some mappers...
-      CNES::NES()->CART()->SYNCPPU(m_cycles,m_ppuAddr);
+      SYNCCART(m_ppuAddr,eNESSource_CPU);
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check for breakpoint...
-      CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUState, fixAddr );
+      NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUState, fixAddr );
+   }
+}
+
+void CPPU::_PPU ( uint32_t addr, uint8_t data )
+{
+   *(m_PPUreg+(addr&0x0007)) = data;
+   if ( (addr&0x0007) == PPUMASK_REG )
+   {
+      SELECTTVPALETTE ();
+   }
+
+   // The mapper may have worked out what rendering does from the old value.
+   if ( (((addr&0x0007) == PPUMASK_REG) || ((addr&0x0007) == PPUCTRL_REG)) &&
+        (m_syncCaps&SYNC_PPU_CONTROL) )
+   {
+      NES()->CART()->SYNCPPUCONTROL ();
    }
 }
 
@@ -863,6 +1122,9 @@ void CPPU::PIXELPIPELINES ( int32_t pickoff, uint8_t* a, uint8_t* b1, uint8_t* b
 void CPPU::RENDERSCANLINE ( int32_t scanlines )
 {
    int32_t idxx;
+   uint16_t scrollX;
+   uint16_t scrollY;
+   PpuScrollChange* pScrollChange;
    int32_t sprite;
    SpriteBufferData* pSprite;
    SpriteTemporaryMemoryData* pSpriteTemp;
@@ -875,10 +1137,12 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
    int32_t startSprite;
    int start = -1;
    int scanline;
-   int32_t rasttv;
-   int8_t* pTV;
+   uint32_t* pTV = NULL;
+   uint8_t* pTVIndexed = NULL;
+   uint8_t* pTVEmphasis = NULL;
+   uint8_t emphasisSlot = 0;
+   uint8_t colour;
    int32_t p;
-   int greyscale, intenser, intenseg, intenseb;
 
    if ( scanlines == SCANLINES_VISIBLE )
    {
@@ -890,23 +1154,35 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
 
    for ( scanline = start; scanline <= scanlines; scanline++ )
    {
-      rasttv = ((scanline<<8)<<2);
-      pTV = (int8_t*)(m_pTV+rasttv);
+      if ( scanline >= 0 )
+      {
+         if ( m_tvFormat == TV_FORMAT_INDEXED )
+         {
+            pTVIndexed = ((uint8_t*)m_pTV)+(scanline<<8);
+            pTVEmphasis = ((uint8_t*)m_pTV)+TV_INDEXED_EMPHASIS_OFFSET+(scanline<<2);
+            emphasisSlot = 0;
+            *pTVEmphasis = m_tvEmphasis;
+         }
+         else
+         {
+            pTV = ((uint32_t*)m_pTV)+(scanline<<8);
+         }
+      }
       p = 0;
 
       m_x = 0;
       m_y = scanline;
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for start-of-scanline breakpoints...
          if ( scanline == -1 )
          {
-            CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_PRE_RENDER_SCANLINE_START);
+            NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_PRE_RENDER_SCANLINE_START);
          }
          else
          {
-            CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_SCANLINE_START);
+            NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_SCANLINE_START);
          }
       }
 
@@ -922,16 +1198,39 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
          // Only render to the screen on the visible scanlines...
          if ( scanline >= 0 )
          {
-            if ( nesIsDebuggable )
+            if ( NES()->DEBUGGABLE() )
             {
                m_x = idxx;
 
                // Update variables for PPU viewer
-               *(*(m_2005x+m_x)+m_y) = m_last2005x+((rPPU(PPUCTRL)&0x1)<<8);
-               *(*(m_2005y+m_x)+m_y) = m_last2005y+(((rPPU(PPUCTRL)&0x2)>>1)*240);
+               scrollX = m_last2005x+((rPPU(PPUCTRL)&0x1)<<8);
+               scrollY = m_last2005y+(((rPPU(PPUCTRL)&0x2)>>1)*240);
+               if ( !m_x )
+               {
+                  m_scrollChanges[m_y] = 0;
+               }
+               pScrollChange = m_scrollChange[m_y]+m_scrollChanges[m_y];
+               if ( (!m_scrollChanges[m_y]) ||
+                    (scrollX != (pScrollChange-1)->scrollX) ||
+                    (scrollY != (pScrollChange-1)->scrollY) )
+               {
+                  // The CPU can't write the scroll registers often enough
+                  // to fill a scanline's changes, but be safe.
+                  if ( m_scrollChanges[m_y] == PPU_SCROLL_CHANGES_PER_SCANLINE )
+                  {
+                     pScrollChange--;
+                  }
+                  else
+                  {
+                     m_scrollChanges[m_y]++;
+                  }
+                  pScrollChange->x = m_x;
+                  pScrollChange->scrollX = scrollX;
+                  pScrollChange->scrollY = scrollY;
+               }
 
                // Check for PPU pixel-at breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_PIXEL_XY);
+               NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_PIXEL_XY);
             }
 
             // Run sprite multiplexer to figure out what, if any,
@@ -949,10 +1248,10 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
                      (pSpriteTemp->spriteX+idx2 >= startSprite) &&
                      (pSpriteTemp->spriteX+idx2 >= startBkgnd) )
                {
-                  if ( nesIsDebuggable )
+                  if ( NES()->DEBUGGABLE() )
                   {
                      // Check for sprite-in-multiplexer event breakpoint...
-                     CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,pSpriteTemp->spriteIdx,PPU_EVENT_SPRITE_IN_MULTIPLEXER);
+                     NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,pSpriteTemp->spriteIdx,PPU_EVENT_SPRITE_IN_MULTIPLEXER);
                   }
 
                   if ( pSprite->spriteFlipHoriz )
@@ -979,10 +1278,10 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
 
                   if ( spriteColorIdx&0x3 )
                   {
-                     if ( nesIsDebuggable )
+                     if ( NES()->DEBUGGABLE() )
                      {
                         // Check for sprite selected event breakpoint...
-                        CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,pSpriteTemp->spriteIdx,PPU_EVENT_SPRITE_SELECTED);
+                        NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,pSpriteTemp->spriteIdx,PPU_EVENT_SPRITE_SELECTED);
                      }
 
                      // Save rendered sprite for multiplexing with background...
@@ -1008,12 +1307,6 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
                bkgndColorIdx = 0;
             }
 
-            // invariants
-            greyscale = !!(rPPU(PPUMASK)&PPUMASK_GREYSCALE);
-            intenser = !!(rPPU(PPUMASK)&PPUMASK_INTENSIFY_REDS);
-            intenseg = !!(rPPU(PPUMASK)&PPUMASK_INTENSIFY_GREENS);
-            intenseb = !!(rPPU(PPUMASK)&PPUMASK_INTENSIFY_BLUES);
-
             // Sprite/background pixel rendering determination...
             if ( rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES) )
             {
@@ -1022,30 +1315,24 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
                       ((bkgndColorIdx == 0) &&
                        (spriteColorIdx != 0))) )
                {
-                  if ( nesIsDebuggable )
+                  if ( NES()->DEBUGGABLE() )
                   {
                      // Check for sprite rendering event breakpoint...
-                     CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,pSelectedSpriteTemp->spriteIdx,PPU_EVENT_SPRITE_RENDERING);
+                     NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,pSelectedSpriteTemp->spriteIdx,PPU_EVENT_SPRITE_RENDERING);
                   }
 
                   // Draw sprite...
-                  *pTV++ = CBasePalette::GetPaletteR(rPALETTE(0x10+spriteColorIdx), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteG(rPALETTE(0x10+spriteColorIdx), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteB(rPALETTE(0x10+spriteColorIdx), greyscale, intenser, intenseg, intenseb);
+                  colour = rPALETTE(0x10+spriteColorIdx);
                }
                else if ( p>=startBkgnd )
                {
                   // Draw background...
-                  *pTV++ = CBasePalette::GetPaletteR(rPALETTE(bkgndColorIdx), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteG(rPALETTE(bkgndColorIdx), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteB(rPALETTE(bkgndColorIdx), greyscale, intenser, intenseg, intenseb);
+                  colour = rPALETTE(bkgndColorIdx);
                }
                else
                {
                   // Draw 'nothing'...
-                  *pTV++ = CBasePalette::GetPaletteR(rPALETTE(0), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteG(rPALETTE(0), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteB(rPALETTE(0), greyscale, intenser, intenseg, intenseb);
+                  colour = rPALETTE(0);
                }
 
                // Sprite 0 hit checks...
@@ -1059,17 +1346,17 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
                   {
                      wPPU ( PPUSTATUS, rPPU(PPUSTATUS)|PPUSTATUS_SPRITE_0_HIT );
 
-                     if ( nesIsDebuggable )
+                     if ( NES()->DEBUGGABLE() )
                      {
                         // Save last sprite 0 hit coords for OAM viewer...
                         m_lastSprite0HitX = p;
                         m_lastSprite0HitY = scanline;
 
                         // Add trace tag for Sprice 0 hit...
-                        CNES::NES()->TRACER()->AddSample ( m_cycles, eTracer_Sprite0Hit, eNESSource_PPU, 0, 0, 0 );
+                        NES()->TRACER()->AddSample ( m_cycles, eTracer_Sprite0Hit, eNESSource_PPU, 0, 0, 0 );
 
                         // Check for Sprite 0 Hit breakpoint...
-                        CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_SPRITE0_HIT);
+                        NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_SPRITE0_HIT);
                      }
                   }
                }
@@ -1078,20 +1365,30 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
             {
                if ( (m_ppuAddr&0x3F00) == 0x3F00 )
                {
-                  *pTV++ = CBasePalette::GetPaletteR(rPALETTE(m_ppuAddr&0x1F), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteG(rPALETTE(m_ppuAddr&0x1F), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteB(rPALETTE(m_ppuAddr&0x1F), greyscale, intenser, intenseg, intenseb);
+                  colour = rPALETTE(m_ppuAddr&0x1F);
                }
                else
                {
-                  *pTV++ = CBasePalette::GetPaletteR(rPALETTE(0), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteG(rPALETTE(0), greyscale, intenser, intenseg, intenseb);
-                  *pTV++ = CBasePalette::GetPaletteB(rPALETTE(0), greyscale, intenser, intenseg, intenseb);
+                  colour = rPALETTE(0);
                }
             }
 
-            // Move to next pixel...
-            pTV++; // skip alpha
+            // Draw the pixel and move to the next one...
+            colour &= m_tvGreyscaleMask;
+            if ( pTVIndexed )
+            {
+               if ( (m_tvEmphasis != *(pTVEmphasis+emphasisSlot)) &&
+                    (emphasisSlot < 3) )
+               {
+                  emphasisSlot++;
+                  *(pTVEmphasis+emphasisSlot) = m_tvEmphasis;
+               }
+               *pTVIndexed++ = colour|(emphasisSlot<<6);
+            }
+            else
+            {
+               *pTV++ = *(m_tvPalette+colour);
+            }
             p++;
          }
 
@@ -1107,16 +1404,16 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
          }
       }
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for end-of-scanline breakpoints...
          if ( scanline == -1 )
          {
-            CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_PRE_RENDER_SCANLINE_END);
+            NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_PRE_RENDER_SCANLINE_END);
          }
          else
          {
-            CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_SCANLINE_END);
+            NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUEvent,0,PPU_EVENT_SCANLINE_END);
          }
       }
 
@@ -1161,7 +1458,7 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
       // 340 dots for NTSC odd frames and 341 dots for NTSC even frames if rendering is off, 341 dots for all frames otherwise
       else
       {
-         if ( (CNES::NES()->VIDEOMODE() == MODE_DENDY) || (CNES::NES()->VIDEOMODE() == MODE_PAL) || ((CNES::NES()->VIDEOMODE() == MODE_NTSC) && ((!(m_frame&1)) || (!(rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND))))) )
+         if ( (NES()->VIDEOMODE() == MODE_DENDY) || (NES()->VIDEOMODE() == MODE_PAL) || ((NES()->VIDEOMODE() == MODE_NTSC) && ((!(m_frame&1)) || (!(rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND))))) )
          {
             // account for extra clock (341)
             EXTRA ();
@@ -1189,9 +1486,26 @@ void CPPU::RENDERSCANLINE ( int32_t scanlines )
    }
 }
 
+void CPPU::SELECTTVPALETTE ( void )
+{
+   m_tvEmphasis = (rPPU(PPUMASK)&(PPUMASK_INTENSIFY_REDS|PPUMASK_INTENSIFY_GREENS|PPUMASK_INTENSIFY_BLUES))>>5;
+   m_tvPalette = CBasePalette::GetTVPalette(m_tvEmphasis);
+   m_tvGreyscaleMask = (rPPU(PPUMASK)&PPUMASK_GREYSCALE)?0x30:0x3F;
+}
+
 void CPPU::PIXELRGB ( int32_t x, int32_t y, uint8_t* r, uint8_t* g, uint8_t* b )
 {
-   if ( (x>=0) && (x<=255) && (y>=0) && (y<=239) )
+   if ( (x>=0) && (x<=255) && (y>=0) && (y<=239) && (m_tvFormat == TV_FORMAT_INDEXED) )
+   {
+      uint8_t* pTV = (uint8_t*)m_pTV;
+      uint8_t  pixel = *(pTV+(y<<8)+x);
+      uint8_t  emphasis = *(pTV+TV_INDEXED_EMPHASIS_OFFSET+(y<<2)+(pixel>>6));
+
+      (*r) = CBasePalette::GetPaletteR(pixel&0x3F,0,emphasis&1,(emphasis>>1)&1,(emphasis>>2)&1);
+      (*g) = CBasePalette::GetPaletteG(pixel&0x3F,0,emphasis&1,(emphasis>>1)&1,(emphasis>>2)&1);
+      (*b) = CBasePalette::GetPaletteB(pixel&0x3F,0,emphasis&1,(emphasis>>1)&1,(emphasis>>2)&1);
+   }
+   else if ( (x>=0) && (x<=255) && (y>=0) && (y<=239) )
    {
       int32_t rasttv = (y<<8)<<2;
       int8_t* pTV = (int8_t*)(m_pTV+rasttv);
@@ -1206,9 +1520,6 @@ void CPPU::PIXELRGB ( int32_t x, int32_t y, uint8_t* r, uint8_t* g, uint8_t* b )
 
 void CPPU::GATHERBKGND ( int8_t phase )
 {
-   static uint16_t patternIdx;
-   static BackgroundBufferData bkgndTemp;
-
    uint32_t ppuAddr = rPPUADDR();
    int32_t tileX = ppuAddr&0x001F;
    int32_t tileY = (ppuAddr&0x03E0)>>5;
@@ -1222,7 +1533,7 @@ void CPPU::GATHERBKGND ( int8_t phase )
    {
       if ( rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES) )
       {
-         patternIdx = bkgndPatBase+(RENDER(nameAddr,eTracer_RenderBkgnd)<<4)+((ppuAddr&0x7000)>>12);
+         m_bkgndPatternIdx = bkgndPatBase+(RENDER(nameAddr,eTracer_RenderBkgnd)<<4)+((ppuAddr&0x7000)>>12);
       }
       else
       {
@@ -1246,40 +1557,40 @@ void CPPU::GATHERBKGND ( int8_t phase )
          {
             if ( attribData&0x01 )
             {
-               bkgndTemp.attribData1 = 0xFF;
+               m_bkgndTemp.attribData1 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData1 = 0x00;
+               m_bkgndTemp.attribData1 = 0x00;
             }
 
             if ( attribData&0x02 )
             {
-               bkgndTemp.attribData2 = 0xFF;
+               m_bkgndTemp.attribData2 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData2 = 0x00;
+               m_bkgndTemp.attribData2 = 0x00;
             }
          }
          else
          {
             if ( attribData&0x04 )
             {
-               bkgndTemp.attribData1 = 0xFF;
+               m_bkgndTemp.attribData1 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData1 = 0x00;
+               m_bkgndTemp.attribData1 = 0x00;
             }
 
             if ( attribData&0x08 )
             {
-               bkgndTemp.attribData2 = 0xFF;
+               m_bkgndTemp.attribData2 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData2 = 0x00;
+               m_bkgndTemp.attribData2 = 0x00;
             }
          }
       }
@@ -1289,40 +1600,40 @@ void CPPU::GATHERBKGND ( int8_t phase )
          {
             if ( attribData&0x10 )
             {
-               bkgndTemp.attribData1 = 0xFF;
+               m_bkgndTemp.attribData1 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData1 = 0x00;
+               m_bkgndTemp.attribData1 = 0x00;
             }
 
             if ( attribData&0x20 )
             {
-               bkgndTemp.attribData2 = 0xFF;
+               m_bkgndTemp.attribData2 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData2 = 0x00;
+               m_bkgndTemp.attribData2 = 0x00;
             }
          }
          else
          {
             if ( attribData&0x40 )
             {
-               bkgndTemp.attribData1 = 0xFF;
+               m_bkgndTemp.attribData1 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData1 = 0x00;
+               m_bkgndTemp.attribData1 = 0x00;
             }
 
             if ( attribData&0x80 )
             {
-               bkgndTemp.attribData2 = 0xFF;
+               m_bkgndTemp.attribData2 = 0xFF;
             }
             else
             {
-               bkgndTemp.attribData2 = 0x00;
+               m_bkgndTemp.attribData2 = 0x00;
             }
          }
       }
@@ -1331,7 +1642,7 @@ void CPPU::GATHERBKGND ( int8_t phase )
    {
       if ( rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES) )
       {
-         bkgndTemp.patternData1 = RENDER ( patternIdx,eTracer_RenderBkgnd );
+         m_bkgndTemp.patternData1 = RENDER ( m_bkgndPatternIdx,eTracer_RenderBkgnd );
       }
       else
       {
@@ -1342,27 +1653,23 @@ void CPPU::GATHERBKGND ( int8_t phase )
    {
       if ( rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES) )
       {
-         bkgndTemp.patternData2 = RENDER ( patternIdx+PATTERN_SIZE,eTracer_RenderBkgnd );
+         m_bkgndTemp.patternData2 = RENDER ( m_bkgndPatternIdx+PATTERN_SIZE,eTracer_RenderBkgnd );
       }
       else
       {
          EMULATE(1);
       }
 
-      pBkgnd->attribData1 = bkgndTemp.attribData1;
-      pBkgnd->attribData2 = bkgndTemp.attribData2;
-      pBkgnd->patternData1 = bkgndTemp.patternData1;
-      pBkgnd->patternData2 = bkgndTemp.patternData2;
+      pBkgnd->attribData1 = m_bkgndTemp.attribData1;
+      pBkgnd->attribData2 = m_bkgndTemp.attribData2;
+      pBkgnd->patternData1 = m_bkgndTemp.patternData1;
+      pBkgnd->patternData2 = m_bkgndTemp.patternData2;
 
    }
 }
 
 void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
 {
-   static SpriteTemporaryMemoryData  devNull;
-   static SpriteTemporaryMemoryData* pSprite = &devNull;
-   static int32_t                    spritesFound = 0;
-
    int32_t          idx1;
    int32_t          spriteY;
    int32_t          spriteSize;
@@ -1371,9 +1678,9 @@ void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
    // secondary OAM data...
    if ( cycle == 0 )
    {
-      spritesFound = 0;
+      m_spritesFound = 0;
       m_oamAddr = 0;
-      pSprite = &devNull;
+      m_pSpriteEval = &m_spriteDevNull;
       m_spriteTemporaryMemory.count = 0;
       m_spriteTemporaryMemory.sprite = (m_oamAddr>>2);
       m_spriteTemporaryMemory.phase = 0;
@@ -1414,19 +1721,19 @@ void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
       if ( (idx1 >= 0) && (idx1 < spriteSize) )
       {
          // Calculate sprite-per-scanline limit...
-         spritesFound++;
+         m_spritesFound++;
 
-         if ( spritesFound > 8 )
+         if ( m_spritesFound > 8 )
          {
             // Found 8 sprites, point to /dev/null for future sprites on this scanline...
-            pSprite = &devNull;
+            m_pSpriteEval = &m_spriteDevNull;
 
             // Move to next sprite...
             m_spriteTemporaryMemory.sprite++;
             m_spriteTemporaryMemory.phase = 0;
 
             // Should we assert sprite overflow?
-            if ( spritesFound == 9 )
+            if ( m_spritesFound == 9 )
             {
                if ( rPPU(PPUMASK)&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES) )
                {
@@ -1434,10 +1741,10 @@ void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
                   {
                      wPPU(PPUSTATUS,rPPU(PPUSTATUS)|PPUSTATUS_SPRITE_OVFLO );
 
-                     if ( nesIsDebuggable )
+                     if ( NES()->DEBUGGABLE() )
                      {
                         // Check for breakpoint...
-                        CNES::NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_SPRITE_OVERFLOW );
+                        NES()->CHECKBREAKPOINT ( eBreakInPPU, eBreakOnPPUEvent, 0, PPU_EVENT_SPRITE_OVERFLOW );
                      }
                   }
                }
@@ -1449,9 +1756,9 @@ void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
             m_spriteTemporaryMemory.phase++;
 
             // Found a sprite...
-            pSprite = m_spriteTemporaryMemory.data+m_spriteTemporaryMemory.count;
-            pSprite->spriteIdx = m_spriteTemporaryMemory.sprite;
-            pSprite->spriteSlice = idx1;
+            m_pSpriteEval = m_spriteTemporaryMemory.data+m_spriteTemporaryMemory.count;
+            m_pSpriteEval->spriteIdx = m_spriteTemporaryMemory.sprite;
+            m_pSpriteEval->spriteSlice = idx1;
          }
       }
       else
@@ -1462,7 +1769,7 @@ void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
 
       // If we've found 8 sprites on this scanline, enable the
       // obscure PPU 'bug'.
-      if ( (spritesFound == 8) && (!(idx1 >= 0) && (idx1 < spriteSize)) )
+      if ( (m_spritesFound == 8) && (!(idx1 >= 0) && (idx1 < spriteSize)) )
       {
          m_spriteTemporaryMemory.rolling = 1;
       }
@@ -1475,36 +1782,36 @@ void CPPU::BUILDSPRITELIST ( int32_t scanline, int32_t cycle )
          m_spriteTemporaryMemory.yByte %= OAM_SIZE;
       }
 
-      if ( spritesFound < NUM_SPRITES_PER_SCANLINE )
+      if ( m_spritesFound < NUM_SPRITES_PER_SCANLINE )
       {
-         m_spriteTemporaryMemory.count = spritesFound;
+         m_spriteTemporaryMemory.count = m_spritesFound;
       }
       else
       {
          m_spriteTemporaryMemory.count = NUM_SPRITES_PER_SCANLINE;
       }
    }
-   else if ( (pSprite != &devNull) && (m_spriteTemporaryMemory.phase == 1) )
+   else if ( (m_pSpriteEval != &m_spriteDevNull) && (m_spriteTemporaryMemory.phase == 1) )
    {
       // Cause fetch phases to occur for this in-range sprite...
       m_spriteTemporaryMemory.phase++;
 
-      pSprite->patternIdx = OAM ( SPRITEPAT, pSprite->spriteIdx );
+      m_pSpriteEval->patternIdx = OAM ( SPRITEPAT, m_pSpriteEval->spriteIdx );
    }
-   else if ( (pSprite != &devNull) && (m_spriteTemporaryMemory.phase == 2) )
+   else if ( (m_pSpriteEval != &m_spriteDevNull) && (m_spriteTemporaryMemory.phase == 2) )
    {
       // Cause fetch phases to occur for this in-range sprite...
       m_spriteTemporaryMemory.phase++;
 
-      pSprite->attribData = OAM ( SPRITEATT, pSprite->spriteIdx );
+      m_pSpriteEval->attribData = OAM ( SPRITEATT, m_pSpriteEval->spriteIdx );
    }
-   else if ( (pSprite != &devNull) && (m_spriteTemporaryMemory.phase == 3) )
+   else if ( (m_pSpriteEval != &m_spriteDevNull) && (m_spriteTemporaryMemory.phase == 3) )
    {
       // Move to next sprite...
       m_spriteTemporaryMemory.sprite++;
       m_spriteTemporaryMemory.phase = 0;
 
-      pSprite->spriteX = OAM ( SPRITEX, pSprite->spriteIdx );
+      m_pSpriteEval->spriteX = OAM ( SPRITEX, m_pSpriteEval->spriteIdx );
    }
 
    m_oamAddr = (m_spriteTemporaryMemory.sprite<<2)|(m_spriteTemporaryMemory.phase);
@@ -24,6 +24,39 @@
 #define PPU_CPU_RATIO_PAL   16
 #define PPU_CPU_RATIO_DENDY 15
 
+// No mapper event is scheduled; no frame is this long.
+#define PPU_NO_EVENT        0xFFFFFFFF
+
+// Events that can happen on a PPU cycle.  Each PPU cycle of a frame
+// has a set of these flags in a table built for the video mode when the
+// PPU is reset, so that most cycles can be emulated without working out
+// where the raster is.  The address events only happen if rendering is
+// enabled.
+#define PPU_DOT_INC_HORIZ         0x0001
+#define PPU_DOT_INC_VERT          0x0002
+#define PPU_DOT_COPY_HORIZ        0x0004
+#define PPU_DOT_COPY_VERT         0x0008
+#define PPU_DOT_NMI_UNCHOKE       0x0010
+#define PPU_DOT_NMI_UNREENABLE    0x0020
+#define PPU_DOT_NMI_EDGE          0x0040
+#define PPU_DOT_NMI_WINDOW        0x0080
+#define PPU_DOT_OAM_CLEAR         0x0100
+#define PPU_DOT_ADDRESS_EVENTS    (PPU_DOT_INC_HORIZ|PPU_DOT_INC_VERT|PPU_DOT_COPY_HORIZ|PPU_DOT_COPY_VERT)
+#define PPU_DOT_NMI_EVENTS        (PPU_DOT_NMI_EDGE|PPU_DOT_NMI_WINDOW)
+
+// Kinds of scanline as far as the PPU cycle events are concerned.
+typedef enum
+{
+   ePPURow_Visible = 0,
+   ePPURow_Quiet,
+   ePPURow_VblankFirst,
+   ePPURow_Vblank,
+   ePPURow_VblankOAMClear,
+   ePPURow_Prerender,
+   ePPURow_PastFrame,
+   ePPURow_Max
+} ePPURow;
+
 // This structure represents a sprite entry in the
 // sprite temporary memory which is the memory used
 // by the PPU during pixel rendering to store accumulated
@@ -144,7 +177,7 @@ typedef struct _BackgroundBuffer
 // Macros for internal access to PPU data for use within the PPU object.
 #define rPALETTE(addr) ( (*(m_PALETTEmemory+(addr))&0x3F) )
 #define rPPU(addr) ( *(m_PPUreg+((addr)&0x0007)) )
-#define wPPU(addr,data) { *(m_PPUreg+((addr)&0x0007)) = (data); CNES::NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUState,addr&0x0007); }
+#define wPPU(addr,data) { *(m_PPUreg+((addr)&0x0007)) = (data); NES()->CHECKBREAKPOINT(eBreakInPPU,eBreakOnPPUState,addr&0x0007); }
 #define rPPUADDR() ( m_ppuAddr )
 #define rSCROLLX() ( m_ppuScrollX )
 
@@ -186,12 +219,18 @@ typedef struct _BackgroundBuffer
 // cycle frequency (1,789,772.72Hz).  The APU 'frame', however, is
 // not at all related to the PPU frame.  The CPU itself has no concept
 // of 'frame'.
+class CNES;
+class CNESSaveState;
+
 class CPPU
 {
 public:
-   CPPU();
+   CPPU(CNES* pNES);
    ~CPPU();
 
+   // Accessor method to retrieve the machine this PPU is a part of.
+   inline CNES* NES() const { return m_nes; }
+
    // Emulation routine.  Emulates one PPU cycle.
    inline void EMULATE ( uint32_t cycles );
 
@@ -199,6 +238,26 @@ public:
    // Cleans up the PPU state as if a NES reset had just occurred.
    void RESET ( bool soft );
 
+   // Save state support.
+   void SERIALIZE ( CNESSaveState* state );
+
+   // Which mapper hooks PPU bus accesses call; set by CNES::BINDSYNC.
+   void SYNCCAPS ( uint32_t caps );
+
+   // A mapper that works out when rendering will clock its IRQ counter
+   // has PPUEVENT called when the given cycle of the frame is reached,
+   // before that cycle's fetch.  Only one event is pending at a time;
+   // scheduling replaces it.  A cycle earlier than the current one is
+   // reached in the next frame.
+   inline void SCHEDULE ( uint32_t cycle )
+   {
+      m_eventCycle = cycle;
+   }
+   inline void UNSCHEDULE ( void )
+   {
+      m_eventCycle = PPU_NO_EVENT;
+   }
+
    // State and internal data accessor interfaces.
    // Read a PPU register, affecting the PPU's internal state.
    // This function is used during emulation.
@@ -263,6 +322,9 @@ public:
    inline void RESETCYCLECOUNTER ( void )
    {
       m_cycles = 0;
+      m_dot = 0;
+      m_scanline = 0;
+      m_dotEvents = m_eventRows[m_scanlineRow[0]];
       m_frame++;
    }
 
@@ -362,10 +424,7 @@ public:
    // of the PPU from the perspective of the emulated machine, not because any
    // emulated code made it change.  For example, setting or clearing the VBLANK
    // flag are not necessarily dependent on executed code.
-   inline void _PPU ( uint32_t addr, uint8_t data )
-   {
-      *(m_PPUreg+(addr&0x0007)) = data;
-   }
+   void _PPU ( uint32_t addr, uint8_t data );
 
    // Silently read from a memory location visible to the PPU.
    // This routine is used by the debuggers to gather PPU information without
@@ -383,6 +442,15 @@ public:
       STORE(addr,data,0,0,false);
    }
 
+   // Copy the contents of a range of memory locations visible to the PPU,
+   // as _MEM would read them, a bank at a time where possible.
+   void _MEMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length );
+
+   // Return whether or not the contents of memory locations visible to
+   // the PPU may have changed in the given write generation or a later
+   // one.  The palette is not tracked.
+   bool _MEMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation );
+
    // Silently read from memory locations visible to the PPU.
    // These routines are used by the debuggers to gather PPU information without
    // impacting the state of the emulation.
@@ -444,18 +512,42 @@ public:
 
    inline CMEMORY *VRAM() { return &m_PPUmemory; }
 
-   // Accessor functions for the database of scroll values indexed by pixel
-   // location.  At each PPU cycle that is rendering a visible pixel the scroll
-   // register values are stored so that a representation of the visible portions
-   // of the nametable may be overlaid upon the actual nametable in the nametable visual
-   // inspector.
+   // Accessor functions for the database of scroll values of each visible
+   // scanline.  As each visible pixel is rendered the scroll register
+   // values are compared with the scanline's latest, and kept if they
+   // differ, so that a representation of the visible portions of the
+   // nametable may be overlaid upon the actual nametable in the nametable
+   // visual inspector.
+   inline uint8_t _SCROLLCHANGES ( int32_t y )
+   {
+      return *(m_scrollChanges+y);
+   }
+   inline const PpuScrollChange* _SCROLLCHANGE ( int32_t y )
+   {
+      return *(m_scrollChange+y);
+   }
+   inline int32_t _SCROLLCHANGEAT ( int32_t x, int32_t y )
+   {
+      int32_t change;
+
+      for ( change = m_scrollChanges[y]-1; change > 0; change-- )
+      {
+         if ( m_scrollChange[y][change].x <= x )
+         {
+            break;
+         }
+      }
+      return change;
+   }
    inline uint16_t _SCROLLX ( int32_t x, int32_t y )
    {
-      return *(*(m_2005x+x)+y);
+      int32_t change = _SCROLLCHANGEAT(x,y);
+      return (change >= 0)?m_scrollChange[y][change].scrollX:0;
    }
    inline uint16_t _SCROLLY ( int32_t x, int32_t y )
    {
-      return *(*(m_2005y+x)+y);
+      int32_t change = _SCROLLCHANGEAT(x,y);
+      return (change >= 0)?m_scrollChange[y][change].scrollY:0;
    }
    inline void _SCROLL ( uint8_t* x, uint8_t* y )
    {
@@ -482,6 +574,13 @@ public:
       return m_frame;
    }
 
+   // Returns the scanline of the frame that is the pre-render scanline
+   // in the current video mode.
+   inline uint32_t _PRERENDERSCANLINE ( void )
+   {
+      return prerenderScanline;
+   }
+
    // Accessor functions for the pixel coordinate of the PPU during rendering.
    inline uint8_t _X ( void )
    {
@@ -502,6 +601,14 @@ public:
    {
       return m_pTV;
    }
+   inline void TVFORMAT ( uint32_t format )
+   {
+      m_tvFormat = format;
+   }
+   inline uint32_t TVFORMAT ( void )
+   {
+      return m_tvFormat;
+   }
 
    // Accessor method to retrieve the database managed by the PPU
    // of accesses to its internally managed memories for the Code/Data
@@ -512,11 +619,16 @@ public:
    }
 
 protected:
+   CNES* m_nes;
+
    // Routines to access the RAM maintained by the PPU core object.
    // These are used internally by the PPU core during emulation.
    void STORE ( uint32_t addr, uint8_t data, int8_t source = eNESSource_PPU, int8_t type = eTracer_Unknown, bool trace = true );
    uint32_t LOAD ( uint32_t addr, int8_t source = eNESSource_PPU, int8_t type = eTracer_Unknown, bool trace = true );
 
+   // Provides the PPU cycle and address to mappers that watch such things.
+   inline void SYNCCART ( uint32_t addr, int8_t source );
+
    // Routines to access the RAM maintained by the PPU core object for rendering.
    // These are used internally by the PPU core during emulation.
    inline uint32_t RENDER ( uint32_t addr, int8_t target );
@@ -566,6 +678,14 @@ protected:
    uint32_t cycleRatio;
    uint32_t memoryDecayFrames;
 
+   // Per-cycle event table.  m_scanlineRow picks the row of events for
+   // each scanline of the frame in the current video mode; the scanlines
+   // past the end of the longest frame share the last entry.
+   void BUILDEVENTTABLE ( void );
+   void SYNCDOTCOUNTER ( void );
+   uint16_t m_eventRows [ ePPURow_Max ][ PPU_CYCLES_PER_SCANLINE ];
+   uint8_t  m_scanlineRow [ SCANLINES_TOTAL_PAL+1 ];
+
    // The PPU has an internal OAM address register that is
    // accessed via PPU address $2003.  It is incremented on
    // writes to $2004.
@@ -645,6 +765,25 @@ protected:
    // start of each PPU frame.
    uint32_t   m_cycles;
 
+   // SYNC_ flags of the cartridge that concern the PPU, and for
+   // SYNC_PPU_A12 the A12 of the last address given to the mapper.  The
+   // latter is PPU_A13, which no A12 matches, until the mapper has been
+   // given an address since it was bound or the machine was reset or
+   // loaded.
+   uint32_t   m_syncCaps;
+   uint32_t   m_syncA12;
+
+   // Cycle of the frame at which the mapper's event is due, or
+   // PPU_NO_EVENT.
+   uint32_t   m_eventCycle;
+
+   // The same position as a cycle within a scanline and a scanline
+   // within the frame, and the event row for that scanline.  These are
+   // kept alongside m_cycles so that nothing has to divide it.
+   uint32_t   m_dot;
+   uint32_t   m_scanline;
+   const uint16_t* m_dotEvents;
+
    // Running counter of PPU frames drawn.  It will roll over after
    // approximately 40 minutes of emulation.  However, this roll-over
    // is not a significant event.
@@ -678,11 +817,33 @@ protected:
    // rendered on the next scanline.
    BackgroundBuffer m_bkgndBuffer;
 
+   // Tile data gathered during the background fetch phases of a tile,
+   // held until the tile's last phase moves it into the buffer above.
+   uint16_t             m_bkgndPatternIdx;
+   BackgroundBufferData m_bkgndTemp;
+
+   // Sprite evaluation progress carried from one PPU cycle to the next.
+   // Once eight sprites have been found evaluation writes its results to
+   // the unused m_spriteDevNull entry.
+   SpriteTemporaryMemoryData  m_spriteDevNull;
+   SpriteTemporaryMemoryData* m_pSpriteEval;
+   int32_t                    m_spritesFound;
+
    // This is the rendering surface on which the PPU draws the
    // emulated frame representing the true visual state of the
    // NES as would be seen by a player.  The memory is allocated
    // by the dialog class and passed to the PPU.
    int8_t*          m_pTV;
+   uint32_t         m_tvFormat;
+
+   // The colour emphasis and greyscale bits of PPUMASK only change when
+   // PPUMASK is written, so the TV pixels for the current emphasis and
+   // the mask that applies greyscale are picked then rather than for
+   // every pixel.
+   void SELECTTVPALETTE ( void );
+   const uint32_t*  m_tvPalette;
+   uint8_t          m_tvEmphasis;
+   uint8_t          m_tvGreyscaleMask;
 
    // These items are the database that keeps track of the status of the
    // x and y scroll values for each rendered pixel.  This information is
@@ -690,8 +851,8 @@ protected:
    // memory internal to the PPU that are being rendered to the screen.
    uint8_t  m_last2005x;
    uint8_t  m_last2005y;
-   uint16_t** m_2005x;
-   uint16_t** m_2005y;
+   PpuScrollChange m_scrollChange[SCANLINES_VISIBLE][PPU_SCROLL_CHANGES_PER_SCANLINE];
+   uint8_t  m_scrollChanges[SCANLINES_VISIBLE];
 
    // These items are the position of the last sprite-0 hit event on the
    // last rendered PPU frame.  They are invalidated at the start of each
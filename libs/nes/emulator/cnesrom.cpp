@@ -47,79 +47,83 @@
 #include "cnesrommapper075.h"
 #include "cnesrommapper111.h"
 
-CROM* CARTFACTORY(uint32_t mapper)
+#include "cnessavestate.h"
+
+CROM* CARTFACTORY(CNES* pNES, uint32_t mapper)
 {
    switch ( mapper )
    {
    default:
-      return CROM::CARTFACTORY();
+      return CROM::CARTFACTORY(pNES);
    case 1:
-      return CROMMapper001::CARTFACTORY();
+      return CROMMapper001::CARTFACTORY(pNES);
    case 2:
-      return CROMMapper002::CARTFACTORY();
+      return CROMMapper002::CARTFACTORY(pNES);
    case 3:
-      return CROMMapper003::CARTFACTORY();
+      return CROMMapper003::CARTFACTORY(pNES);
    case 4:
-      return CROMMapper004::CARTFACTORY();
+      return CROMMapper004::CARTFACTORY(pNES);
    case 5:
-      return CROMMapper005::CARTFACTORY();
+      return CROMMapper005::CARTFACTORY(pNES);
    case 7:
-      return CROMMapper007::CARTFACTORY();
+      return CROMMapper007::CARTFACTORY(pNES);
    case 9:
-      return CROMMapper009::CARTFACTORY();
+      return CROMMapper009::CARTFACTORY(pNES);
    case 10:
-      return CROMMapper010::CARTFACTORY();
+      return CROMMapper010::CARTFACTORY(pNES);
    case 11:
-      return CROMMapper011::CARTFACTORY();
+      return CROMMapper011::CARTFACTORY(pNES);
    case 13:
-      return CROMMapper013::CARTFACTORY();
+      return CROMMapper013::CARTFACTORY(pNES);
    case 16:
-      return CROMMapper016::CARTFACTORY();
+      return CROMMapper016::CARTFACTORY(pNES);
    case 18:
-      return CROMMapper018::CARTFACTORY();
+      return CROMMapper018::CARTFACTORY(pNES);
    case 19:
-      return CROMMapper019::CARTFACTORY();
+      return CROMMapper019::CARTFACTORY(pNES);
    case 21:
-      return CROMMapper021::CARTFACTORY();
+      return CROMMapper021::CARTFACTORY(pNES);
    case 22:
-      return CROMMapper022::CARTFACTORY();
+      return CROMMapper022::CARTFACTORY(pNES);
    case 23:
-      return CROMMapper023::CARTFACTORY();
+      return CROMMapper023::CARTFACTORY(pNES);
    case 24:
-      return CROMMapper024::CARTFACTORY();
+      return CROMMapper024::CARTFACTORY(pNES);
    case 25:
-      return CROMMapper025::CARTFACTORY();
+      return CROMMapper025::CARTFACTORY(pNES);
    case 26:
-      return CROMMapper026::CARTFACTORY();
+      return CROMMapper026::CARTFACTORY(pNES);
    case 28:
-      return CROMMapper028::CARTFACTORY();
+      return CROMMapper028::CARTFACTORY(pNES);
    case 33:
-      return CROMMapper033::CARTFACTORY();
+      return CROMMapper033::CARTFACTORY(pNES);
    case 34:
-      return CROMMapper034::CARTFACTORY();
+      return CROMMapper034::CARTFACTORY(pNES);
    case 65:
-      return CROMMapper065::CARTFACTORY();
+      return CROMMapper065::CARTFACTORY(pNES);
    case 68:
-      return CROMMapper068::CARTFACTORY();
+      return CROMMapper068::CARTFACTORY(pNES);
    case 69:
-      return CROMMapper069::CARTFACTORY();
+      return CROMMapper069::CARTFACTORY(pNES);
    case 73:
-      return CROMMapper073::CARTFACTORY();
+      return CROMMapper073::CARTFACTORY(pNES);
    case 75:
-      return CROMMapper075::CARTFACTORY();
+      return CROMMapper075::CARTFACTORY(pNES);
    case 111:
-      return CROMMapper111::CARTFACTORY();
+      return CROMMapper111::CARTFACTORY(pNES);
    }
 }
 
-CROM::CROM(uint32_t mapper)
-   : m_PRGROMmemory(CMEMORY(0x8000,MEM_8KB,NUM_ROM_BANKS,4)),
-     m_CHRmemory(CMEMORY(0,MEM_1KB,NUM_CHR_BANKS,8)),
-     m_pSRAMmemory(new COPENBUS()),
-     m_pEXRAMmemory(new COPENBUS()),
-     m_pVRAMmemory(new COPENBUS())
+CROM::CROM(CNES* pNES, uint32_t mapper)
+   : m_nes(pNES),
+     m_PRGROMmemory(CMEMORY(pNES,0x8000,MEM_8KB,NUM_ROM_BANKS,4)),
+     m_CHRmemory(CMEMORY(pNES,0,MEM_1KB,NUM_CHR_BANKS,8)),
+     m_pSRAMmemory(new COPENBUS(pNES)),
+     m_pEXRAMmemory(new COPENBUS(pNES)),
+     m_pVRAMmemory(new COPENBUS(pNES))
 {
    m_mapper = mapper;
+   m_syncCaps = SYNC_NONE;
    m_numPrgBanks = 0;
    m_numChrBanks = 0;
    m_prgRemappable = false;
@@ -153,7 +157,7 @@ void CROM::SetCHRBank ( int32_t bank, uint8_t* data )
 
 void CROM::DoneLoadingBanks ()
 {
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Initial disassembly will be 'crap' but do it anyway...
       DISASSEMBLE();
@@ -163,6 +167,15 @@ void CROM::DoneLoadingBanks ()
    m_SRAMdirty = false;
 }
 
+void CROM::SYNCCAPS ( uint32_t caps )
+{
+   if ( caps != m_syncCaps )
+   {
+      m_syncCaps = caps;
+      NES()->BINDSYNC();
+   }
+}
+
 void CROM::RESET ( bool soft )
 {
    if ( m_mapper == 0 )
@@ -216,9 +229,43 @@ void CROM::RESET ( bool soft )
    }
 }
 
+void CROM::MEMORIES ( CNESSaveState* state )
+{
+   state->MEMORY ( &m_PRGROMmemory );
+   state->MEMORY ( &m_CHRmemory );
+   state->MEMORY ( m_pSRAMmemory );
+   state->MEMORY ( m_pEXRAMmemory );
+   state->MEMORY ( m_pVRAMmemory );
+}
+
+void CROM::SERIALIZE ( CNESSaveState* state )
+{
+   state->BEGINCHUNK ( "CART", 1 );
+   m_PRGROMmemory.SERIALIZEMAP ( state );
+   m_CHRmemory.SERIALIZEMAP ( state );
+
+   // CHR-RAM lives in the 32 banks following any CHR-ROM; CHR-ROM itself
+   // is part of the cartridge image, not the state.
+   m_CHRmemory.SERIALIZEBANKS ( state, m_numChrBanks<<3, 32 );
+
+   m_pSRAMmemory->SERIALIZEBANKS ( state );
+   m_pSRAMmemory->SERIALIZEMAP ( state );
+   m_pEXRAMmemory->SERIALIZEBANKS ( state );
+   m_pEXRAMmemory->SERIALIZEMAP ( state );
+   m_pVRAMmemory->SERIALIZEBANKS ( state );
+   m_pVRAMmemory->SERIALIZEMAP ( state );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() && m_pSRAMmemory->TOTALSIZE() )
+   {
+      // SRAM now holds what the state had, not what was last saved.
+      m_SRAMdirty = true;
+   }
+}
+
 uint32_t CROM::LMAPPER ( uint32_t addr )
 {
-   uint8_t data = CNES::NES()->CPU()->OPENBUS();
+   uint8_t data = NES()->CPU()->OPENBUS();
 
    if ( (m_mapper == 0) && (m_numPrgBanks > 4) )
    {
@@ -8,19 +8,48 @@
 
 #include "cnesppu.h"
 
+#define PPU_A12        (1<<12)
 #define PPU_A13        (1<<13)
 #define CART_UNCLAIMED 0xFFFFFFFF
 
-CROM* CARTFACTORY(uint32_t mapper);
+// What a mapper needs to see of the CPU and PPU buses.  The CPU and PPU
+// only call SYNCCPU and SYNCPPU for what the cartridge asks for, so the
+// many mappers that only switch banks on register writes cost nothing on
+// each bus access.
+#define SYNC_NONE      0x00
+// SYNCCPU on every CPU read and write.  Mappers whose hook only clocks an
+// IRQ counter ask for it only while the counter is running.
+#define SYNC_CPU_CYCLE 0x01
+// SYNCPPU on every PPU bus access.
+#define SYNC_PPU_FETCH 0x02
+// SYNCPPU only when PPU A12 differs from what it was last given.
+#define SYNC_PPU_A12   0x04
+// SYNCPPU only for the fetches of tiles $FD and $FE that MMC2 and MMC4
+// latch on, from either pattern table.
+#define SYNC_PPU_LATCH 0x08
+// SYNCPPU only for the addresses the CPU puts on the PPU bus through
+// PPUADDR and PPUDATA, for mappers that work out what rendering does.
+#define SYNC_PPU_ADDRESS 0x10
+// SYNCPPUCONTROL after each write to PPUCTRL or PPUMASK.
+#define SYNC_PPU_CONTROL 0x20
+#define SYNC_PPU       (SYNC_PPU_FETCH|SYNC_PPU_A12|SYNC_PPU_LATCH|SYNC_PPU_ADDRESS|SYNC_PPU_CONTROL)
+
+class CNES;
+class CNESSaveState;
+
+CROM* CARTFACTORY(CNES* pNES, uint32_t mapper);
 
 class CROM
 {
 protected:
-   CROM(uint32_t mapper);
+   CROM(CNES* pNES, uint32_t mapper);
 public:
-   static inline CROM* CARTFACTORY() { return new CROM(0); }
+   static inline CROM* CARTFACTORY(CNES* pNES) { return new CROM(pNES,0); }
    virtual ~CROM();
 
+   // Accessor method to retrieve the machine this cartridge is plugged into.
+   inline CNES* NES() const { return m_nes; }
+
    // Priming interfaces (data setup/initialization)
    void ClearPRGBanks ()
    {
@@ -133,6 +162,47 @@ public:
       return CART_UNCLAIMED;
    }
 
+   // Copy what the PPU sees of pattern memory, or of the cartridge's own
+   // nametables, a bank at a time.  VRAMCOPY returns false, copying
+   // nothing, if the PPU sees its own nametables instead.
+   virtual void CHRMEMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length )
+   {
+      m_CHRmemory.MEMCOPY(dest,addr,length);
+   }
+   virtual bool VRAMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length )
+   {
+      if ( m_pVRAMmemory->TOTALSIZE() )
+      {
+         m_pVRAMmemory->MEMCOPY(dest,addr,length);
+         return true;
+      }
+      return false;
+   }
+
+   // Whether what the debugger reads through the accessors above may have
+   // changed in the given write generation or a later one.  Mappers that
+   // make up what the PPU sees, rather than bank it in, must say so.
+   inline bool PRGROMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+   {
+      return m_PRGROMmemory.CHANGEDSINCE(addr,length,generation);
+   }
+   virtual bool CHRMEMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+   {
+      return m_CHRmemory.CHANGEDSINCE(addr,length,generation);
+   }
+   inline bool SRAMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+   {
+      return m_pSRAMmemory->CHANGEDSINCE(addr,length,generation);
+   }
+   inline bool EXRAMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+   {
+      return m_pEXRAMmemory->CHANGEDSINCE(addr,length,generation);
+   }
+   virtual bool VRAMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation )
+   {
+      return m_pVRAMmemory->TOTALSIZE() && m_pVRAMmemory->CHANGEDSINCE(addr,length,generation);
+   }
+
    // Mapper interfaces
    virtual void RESET ( bool soft );
    uint32_t MAPPER ( void )
@@ -148,6 +218,19 @@ public:
    virtual void LMAPPER ( uint32_t addr, uint8_t data);
    virtual void SYNCPPU ( uint32_t, uint32_t ) {}
    virtual void SYNCCPU ( bool write, uint16_t addr, uint8_t data ) {}
+   virtual void SYNCPPUCONTROL ( void ) {}
+   // Mappers that work out when their IRQ counter next fires schedule an
+   // event with the CPU or PPU rather than ask for SYNCCPU or SYNCPPU.
+   // The events are called when that cycle is reached and RESCHEDULE
+   // once the whole machine has been reset.
+   virtual void CPUEVENT ( void ) {}
+   virtual void PPUEVENT ( void ) {}
+   virtual void RESCHEDULE ( void ) {}
+   // Which of SYNCCPU and SYNCPPU the mapper needs; see SYNC_NONE.
+   inline uint32_t SYNCCAPS ( void ) const
+   {
+      return m_syncCaps;
+   }
    virtual uint32_t DEBUGINFO ( uint32_t addr )
    {
       return 0; // OPENBUS DON'T CARE
@@ -157,6 +240,13 @@ public:
       return 0; // soundless...
    }
 
+   // Save state support.  MEMORIES registers every memory whose banks can
+   // be mapped into the PPU's address space.  SERIALIZE moves the bank
+   // mappings and RAM of the cartridge; mappers extend it with a chunk
+   // of their own registers.
+   virtual void MEMORIES ( CNESSaveState* state );
+   virtual void SERIALIZE ( CNESSaveState* state );
+
    // Code/Data logger support functions
    inline CCodeDataLogger* LOGGERVIRT ( uint32_t addr )
    {
@@ -250,6 +340,13 @@ public:
    CMEMORY* VRAMMEMORY() { return m_pVRAMmemory; }
 
 protected:
+   // Mappers set m_syncCaps in their constructor.  Those that need their
+   // hooks only some of the time change them through here so the CPU and
+   // PPU are rebound.
+   void SYNCCAPS ( uint32_t caps );
+
+   CNES*       m_nes;
+
    CMEMORY     m_PRGROMmemory;
    CMEMORY     m_CHRmemory;
    CMEMORY    *m_pSRAMmemory;
@@ -262,6 +359,7 @@ protected:
 
    // Mapper stuff...
    uint32_t m_mapper;
+   uint32_t m_syncCaps;
    uint32_t m_numPrgBanks;
    uint32_t m_numChrBanks;
 };
@@ -15,7 +15,9 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper001.h"
+#include "cnessavestate.h"
 #include "cnesppu.h"
+#include "cnes6502.h"
 
 #include "cregisterdata.h"
 
@@ -64,11 +66,11 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,4,4,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper001::CROMMapper001()
-   : CROM(1)
+CROMMapper001::CROMMapper001(CNES* pNES)
+   : CROM(pNES,1)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
    memset(m_reg,0,sizeof(m_reg));
@@ -79,7 +81,6 @@ CROMMapper001::CROMMapper001()
    m_sel = 0x00;
    m_srCount = 0;
    m_cpuCycleOfLastWrite = 0xFFFFFFFF;
-   m_cpuCycle = 0xFFFFFFFF;
 }
 
 CROMMapper001::~CROMMapper001()
@@ -98,7 +99,6 @@ void CROMMapper001::RESET ( bool soft )
    m_srCount = 0;
 
    m_cpuCycleOfLastWrite = 0xFFFFFFFF;
-   m_cpuCycle = 0xFFFFFFFF;
 
    for ( idx = 0; idx < 4; idx++ )
    {
@@ -111,10 +111,18 @@ void CROMMapper001::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper001::SYNCCPU( bool write, uint16_t addr, uint8_t data )
+void CROMMapper001::SERIALIZE ( CNESSaveState* state )
 {
-   // This may not be the actual CPU cycle but it doesn't matter.
-   m_cpuCycle++;
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 2 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_regdef );
+   state->VALUE ( m_sr );
+   state->VALUE ( m_sel );
+   state->VALUE ( m_srCount );
+   state->VALUE ( m_cpuCycleOfLastWrite );
+   state->ENDCHUNK ();
 }
 
 uint32_t CROMMapper001::DEBUGINFO ( uint32_t addr )
@@ -127,13 +135,14 @@ void CROMMapper001::HMAPPER ( uint32_t addr, uint8_t data )
    uint8_t bank = 0;
 
    // Discard this write if it's immediately following another write.
-   if ( m_cpuCycle == m_cpuCycleOfLastWrite+1 )
+   // The CPU's cycle counter is used so that MMC1 needs no SYNCCPU.
+   if ( NES()->CPU()->_CYCLES() == m_cpuCycleOfLastWrite+1 )
    {
       return;
    }
 
    // Keep track of when we last wrote.
-   m_cpuCycleOfLastWrite = m_cpuCycle;
+   m_cpuCycleOfLastWrite = NES()->CPU()->_CYCLES();
 
    // Shift bits into registers...
    if ( data&0x80 )
@@ -165,16 +174,16 @@ void CROMMapper001::HMAPPER ( uint32_t addr, uint8_t data )
                {
                   if ( m_reg[0]&0x01 )
                   {
-                     CNES::NES()->PPU()->MIRRORHORIZ ();
+                     NES()->PPU()->MIRRORHORIZ ();
                   }
                   else
                   {
-                     CNES::NES()->PPU()->MIRRORVERT ();
+                     NES()->PPU()->MIRRORVERT ();
                   }
                }
                else
                {
-                  CNES::NES()->PPU()->MIRROR ( m_reg[0]&0x01 );
+                  NES()->PPU()->MIRROR ( m_reg[0]&0x01 );
                }
 
                break;
@@ -266,11 +275,11 @@ void CROMMapper001::HMAPPER ( uint32_t addr, uint8_t data )
                break;
          }
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check mapper state breakpoints...
             // m_sel is convenient register number...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,m_sel);
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,m_sel);
          }
       }
    }
@@ -6,14 +6,14 @@
 class CROMMapper001 : public CROM
 {
 private:
-   CROMMapper001();
+   CROMMapper001(CNES* pNES);
 public:
-   static inline CROMMapper001* CARTFACTORY() { return new CROMMapper001(); }
+   static inline CROMMapper001* CARTFACTORY(CNES* pNES) { return new CROMMapper001(pNES); }
    virtual ~CROMMapper001();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
    // Internal accessors for mapper information inspector...
@@ -35,7 +35,6 @@ protected:
    uint8_t  m_sel;
    uint8_t  m_srCount;
    uint32_t m_cpuCycleOfLastWrite;
-   uint32_t m_cpuCycle;
 };
 
 #endif
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper002.h"
+#include "cnessavestate.h"
 
 #include "cregisterdata.h"
 
@@ -41,8 +42,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,1,1,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper002::CROMMapper002()
-   : CROM(2)
+CROMMapper002::CROMMapper002(CNES* pNES)
+   : CROM(pNES,2)
 {
    m_reg = 0x00;
    m_prgRemappable = true;
@@ -65,6 +66,15 @@ void CROMMapper002::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper002::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper002::DEBUGINFO ( uint32_t addr )
 {
    return m_reg;
@@ -81,9 +91,9 @@ void CROMMapper002::HMAPPER ( uint32_t addr, uint8_t data )
    m_PRGROMmemory.REMAP(0,bank);
    m_PRGROMmemory.REMAP(1,bank+1);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper002 : public CROM
 {
 private:
-   CROMMapper002();
+   CROMMapper002(CNES* pNES);
 public:
-   static inline CROMMapper002* CARTFACTORY() { return new CROMMapper002(); }
+   static inline CROMMapper002* CARTFACTORY(CNES* pNES) { return new CROMMapper002(pNES); }
    virtual ~CROMMapper002();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper003.h"
+#include "cnessavestate.h"
 #include "cnesppu.h"
 
 #include "cregisterdata.h"
@@ -42,8 +43,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,1,1,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper003::CROMMapper003()
-   : CROM(3)
+CROMMapper003::CROMMapper003(CNES* pNES)
+   : CROM(pNES,3)
 {
    m_reg = 0x00;
    m_prgRemappable = false;
@@ -66,6 +67,15 @@ void CROMMapper003::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper003::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper003::DEBUGINFO ( uint32_t addr )
 {
    return m_reg;
@@ -85,9 +95,9 @@ void CROMMapper003::HMAPPER ( uint32_t addr, uint8_t data )
    m_CHRmemory.REMAP(6,(m_reg<<3)+6);
    m_CHRmemory.REMAP(7,(m_reg<<3)+7);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
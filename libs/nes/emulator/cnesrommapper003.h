@@ -6,12 +6,13 @@
 class CROMMapper003 : public CROM
 {
 private:
-   CROMMapper003();
+   CROMMapper003(CNES* pNES);
 public:
-   static inline CROMMapper003* CARTFACTORY() { return new CROMMapper003(); }
+   static inline CROMMapper003* CARTFACTORY(CNES* pNES) { return new CROMMapper003(pNES); }
    virtual ~CROMMapper003();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
@@ -15,11 +15,26 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper004.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
 #include "cregisterdata.h"
 
+// With the background at $0000 and 8x8 sprites at $1000 every rendered
+// scanline, and the pre-render scanline, fetches the patterns of eight
+// sprites, real or not, with A12 rising every eight dots from dot 262.
+// Only the first rise is far enough from the last to clock the counter.
+#define MMC3_RISE_DOT   262
+#define MMC3_RISES      8
+// PPUCTRL is read for a scanline's sprite fetches a little after its
+// visible dots, and for each background tile a few dots before its
+// patterns are fetched.  A change from then until the next scanline's
+// first two tiles have been fetched is not predicted.
+#define MMC3_UNSAFE_DOT 240
+#define MMC3_SAFE_DOT   337
+#define MMC3_CLOCKS_PER_FRAME (SCANLINES_VISIBLE+1)
+
 // Mapper 004 Registers
 static CBitfieldData* tbl8000Bitfields [] =
 {
@@ -88,13 +103,14 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,8,8,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper004::CROMMapper004()
-   : CROM(4)
+CROMMapper004::CROMMapper004(CNES* pNES)
+   : CROM(pNES,4)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
+   m_syncCaps = SYNC_PPU_A12|SYNC_PPU_CONTROL;
    memset(m_reg,0,sizeof(m_reg));
    m_irqAsserted = false;
    m_irqCounter = 0x00;
@@ -106,6 +122,14 @@ CROMMapper004::CROMMapper004()
 
    m_lastPPUAddrA12 = 0;
    m_lastPPUCycle = 0;
+
+   m_irqPredicted = false;
+   m_irqPredictRendering = false;
+   m_irqFrame = 0;
+   m_irqCycle = 0;
+   m_irqPPUCtrl = 0x00;
+   m_irqPredictHeld = false;
+   m_irqHeldFrame = 0;
 }
 
 CROMMapper004::~CROMMapper004()
@@ -139,17 +163,457 @@ void CROMMapper004::RESET ( bool soft )
    m_lastPPUCycle = 0;
    m_lastPPUAddrA12 = 0;
 
+   // Scheduled again once the PPU is reset.
+   m_irqPredicted = false;
+   m_irqPredictHeld = false;
+
    m_PRGROMmemory.REMAP(2,m_numPrgBanks-2);
    m_PRGROMmemory.REMAP(3,m_numPrgBanks-1);
 
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper004::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
+   {
+      IRQSYNC ();
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_irqAsserted );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqLatch );
+   state->VALUE ( m_irqEnable );
+   state->VALUE ( m_irqReload );
+   state->VALUE ( m_prg );
+   state->VALUE ( m_chr );
+   state->VALUE ( m_lastPPUAddrA12 );
+   state->VALUE ( m_lastPPUCycle );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
+   }
+}
+
+void CROMMapper004::RESCHEDULE ( void )
+{
+   m_irqPredicted = false;
+   IRQSYNC ();
+
+   // Whatever PPUCTRL said earlier in the frame is not known.
+   m_irqPPUCtrl = NES()->PPU()->_PPU(PPUCTRL);
+   IRQHOLD ();
+   IRQSCHEDULE ();
+}
+
+void CROMMapper004::IRQHOLD ( void )
+{
+   uint32_t prerender = NES()->PPU()->_PRERENDERSCANLINE();
+   uint32_t cycle = NES()->PPU()->_CYCLES();
+   uint32_t scanline = cycle/PPU_CYCLES_PER_SCANLINE;
+
+   // Scanlines still to be fetched this frame, up to and including the
+   // pre-render scanline's sprites, have their A12 rises watched.
+   if ( (scanline < SCANLINES_VISIBLE) ||
+        ((scanline == prerender) && ((cycle%PPU_CYCLES_PER_SCANLINE) < MMC3_SAFE_DOT)) )
+   {
+      m_irqPredicted = false;
+      m_irqPredictHeld = true;
+      m_irqHeldFrame = NES()->PPU()->_FRAME();
+   }
+}
+
+bool CROMMapper004::IRQPREDICTABLE ( bool* rendering )
+{
+   uint8_t ppuCtrl = NES()->PPU()->_PPU(PPUCTRL);
+   uint8_t ppuMask = NES()->PPU()->_PPU(PPUMASK);
+
+   (*rendering) = !!(ppuMask&(PPUMASK_RENDER_BKGND|PPUMASK_RENDER_SPRITES));
+
+   return (!(*rendering)) ||
+          ((ppuCtrl&(PPUCTRL_SPRITE_SIZE|PPUCTRL_BKGND_PAT_TBL_ADDR|PPUCTRL_SPRITE_PAT_TBL_ADDR)) == PPUCTRL_SPRITE_PAT_TBL_ADDR);
+}
+
+bool CROMMapper004::IRQCANPREDICT ( void )
+{
+   uint32_t prerender = NES()->PPU()->_PRERENDERSCANLINE();
+   uint32_t cycle = NES()->PPU()->_CYCLES();
+   uint32_t scanline = cycle/PPU_CYCLES_PER_SCANLINE;
+   uint32_t dot = cycle%PPU_CYCLES_PER_SCANLINE;
+   uint32_t clock = IRQCLOCKSUPTO(cycle);
+   uint32_t next;
+
+   // Not until the pre-render scanline's sprites have been fetched after
+   // a change of layout part way through a frame...
+   if ( m_irqPredictHeld )
+   {
+      if ( (NES()->PPU()->_FRAME() == m_irqHeldFrame) &&
+           (cycle < (prerender*PPU_CYCLES_PER_SCANLINE)+MMC3_SAFE_DOT) )
+      {
+         return false;
+      }
+
+      m_irqPredictHeld = false;
+   }
+
+   // ...nor while a scanline's sprites may still be fetched the way PPUCTRL
+   // said before...
+   if ( ((scanline < SCANLINES_VISIBLE) || (scanline == prerender)) &&
+        (dot >= MMC3_UNSAFE_DOT) && (dot < MMC3_SAFE_DOT) )
+   {
+      return false;
+   }
+
+   // ...nor if the next rise would not clock the counter as every other
+   // one does.
+   if ( clock < SCANLINES_VISIBLE )
+   {
+      next = (clock*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT;
+   }
+   else if ( clock == SCANLINES_VISIBLE )
+   {
+      next = (prerender*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT;
+   }
+   else
+   {
+      next = MMC3_RISE_DOT;
+   }
+
+   return (m_lastPPUAddrA12 == 0x0000) && ((next-m_lastPPUCycle) >= 12);
+}
+
+uint32_t CROMMapper004::IRQCLOCKSUPTO ( uint32_t cycle )
+{
+   uint32_t prerender = NES()->PPU()->_PRERENDERSCANLINE();
+   uint32_t clocks = 0;
+
+   // Clocks in the frame up to and including the given cycle.
+   if ( cycle >= MMC3_RISE_DOT )
+   {
+      clocks = ((cycle-MMC3_RISE_DOT)/PPU_CYCLES_PER_SCANLINE)+1;
+
+      if ( clocks > SCANLINES_VISIBLE )
+      {
+         clocks = SCANLINES_VISIBLE;
+
+         if ( cycle >= (prerender*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT )
+         {
+            clocks++;
+         }
+      }
+   }
+
+   return clocks;
+}
+
+uint32_t CROMMapper004::IRQCLOCKS ( void )
+{
+   uint32_t frame = NES()->PPU()->_FRAME();
+   uint32_t cycle = NES()->PPU()->_CYCLES();
+
+   if ( !(m_irqPredicted && m_irqPredictRendering) )
+   {
+      return 0;
+   }
+
+   return ((frame-m_irqFrame)*MMC3_CLOCKS_PER_FRAME)+IRQCLOCKSUPTO(cycle)-IRQCLOCKSUPTO(m_irqCycle);
+}
+
+bool CROMMapper004::IRQCLOCK ( uint32_t clocks, uint8_t* counter, bool* reload )
+{
+   uint32_t steps;
+   bool     zero = false;
+
+   // Counting down to zero...
+   if ( !(*reload) )
+   {
+      steps = (*counter)?(*counter):256;
+
+      if ( clocks < steps )
+      {
+         (*counter) -= clocks;
+         return false;
+      }
+
+      clocks -= steps;
+      (*counter) = 0;
+      (*reload) = true;
+      zero = true;
+   }
+
+   // ...then, over and over, reloading and counting down to zero again.
+   steps = 1+(m_irqLatch?m_irqLatch:256);
+
+   if ( clocks >= steps )
+   {
+      clocks %= steps;
+      zero = true;
+   }
+
+   if ( clocks )
+   {
+      if ( m_irqLatch == 0 )
+      {
+         zero = true;
+      }
+
+      (*counter) = m_irqLatch-(clocks-1);
+      (*reload) = false;
+   }
+
+   return zero;
+}
+
+bool CROMMapper004::IRQLASTRISE ( uint32_t cycle, uint32_t* rise, uint32_t* a12 )
+{
+   uint32_t prerender = NES()->PPU()->_PRERENDERSCANLINE();
+   uint32_t scanline = cycle/PPU_CYCLES_PER_SCANLINE;
+   uint32_t dot = cycle%PPU_CYCLES_PER_SCANLINE;
+   uint32_t fetch;
+
+   // A12 stays high for the two pattern fetches of each sprite.
+   (*a12) = 0x0000;
+
+   if ( ((scanline < SCANLINES_VISIBLE) || (scanline == prerender)) &&
+        (dot >= MMC3_RISE_DOT) )
+   {
+      fetch = (dot-MMC3_RISE_DOT)>>3;
+
+      if ( fetch < MMC3_RISES )
+      {
+         if ( ((dot-MMC3_RISE_DOT)&7) < 4 )
+         {
+            (*a12) = 0x1000;
+         }
+      }
+      else
+      {
+         fetch = MMC3_RISES-1;
+      }
+
+      (*rise) = (scanline*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT+(fetch<<3);
+      return true;
+   }
+
+   // Otherwise the last rise was on the last rendered scanline, if that
+   // was in this frame.
+   if ( scanline == 0 )
+   {
+      return false;
+   }
+
+   scanline = ((scanline < SCANLINES_VISIBLE)?scanline:SCANLINES_VISIBLE)-1;
+   (*rise) = (scanline*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT+((MMC3_RISES-1)<<3);
+   return true;
+}
+
+void CROMMapper004::IRQA12 ( uint32_t* a12, uint32_t* lastCycle )
+{
+   uint32_t prerender = NES()->PPU()->_PRERENDERSCANLINE();
+   uint32_t frame = NES()->PPU()->_FRAME();
+   uint32_t cycle = NES()->PPU()->_CYCLES();
+   uint32_t rise;
+
+   (*a12) = m_lastPPUAddrA12;
+   (*lastCycle) = m_lastPPUCycle;
+
+   if ( m_irqPredicted && m_irqPredictRendering )
+   {
+      if ( IRQLASTRISE(cycle,&rise,a12) )
+      {
+         if ( (frame != m_irqFrame) || (rise > m_irqCycle) )
+         {
+            (*lastCycle) = rise;
+         }
+      }
+      else if ( frame != m_irqFrame )
+      {
+         (*lastCycle) = (prerender*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT+((MMC3_RISES-1)<<3);
+      }
+   }
+}
+
+void CROMMapper004::IRQSYNC ( void )
+{
+   if ( IRQCLOCK(IRQCLOCKS(),&m_irqCounter,&m_irqReload) && m_irqEnable )
+   {
+      NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
+      m_irqAsserted = true;
+
+      if ( NES()->DEBUGGABLE() )
+      {
+         // Check for IRQ breakpoint...
+         NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+      }
+   }
+
+   IRQA12 ( &m_lastPPUAddrA12, &m_lastPPUCycle );
+
+   m_irqFrame = NES()->PPU()->_FRAME();
+   m_irqCycle = NES()->PPU()->_CYCLES();
+}
+
+void CROMMapper004::IRQSCHEDULE ( void )
+{
+   uint32_t prerender = NES()->PPU()->_PRERENDERSCANLINE();
+   uint32_t cycle = NES()->PPU()->_CYCLES();
+   uint32_t caps;
+   uint32_t clock;
+   uint32_t clocks;
+   uint32_t scanline;
+   bool     predictable;
+   bool     rendering;
+
+   predictable = IRQPREDICTABLE ( &rendering );
+
+   if ( !predictable )
+   {
+      m_irqPredicted = false;
+   }
+   else if ( !(m_irqPredicted && (rendering == m_irqPredictRendering)) )
+   {
+      m_irqPredicted = (!rendering) || IRQCANPREDICT();
+      m_irqPredictRendering = rendering;
+   }
+
+   // Only the CPU puts addresses on the PPU bus that are not predicted.
+   caps = m_irqPredicted?(SYNC_PPU_ADDRESS|SYNC_PPU_CONTROL):(SYNC_PPU_A12|SYNC_PPU_CONTROL);
+   if ( caps != m_syncCaps )
+   {
+      SYNCCAPS ( caps );
+   }
+
+   if ( m_irqPredicted && m_irqPredictRendering )
+   {
+      // Wake up when the counter next reaches zero, or at the latest on
+      // the pre-render scanline so no catching up spans more than a frame.
+      clocks = m_irqReload?(1+m_irqLatch):(m_irqCounter?m_irqCounter:256);
+      clock = IRQCLOCKSUPTO(cycle);
+      if ( clock == MMC3_CLOCKS_PER_FRAME )
+      {
+         clock = 0;
+      }
+      clock += clocks-1;
+
+      if ( (!m_irqEnable) || (clock >= SCANLINES_VISIBLE) )
+      {
+         NES()->PPU()->SCHEDULE ( (prerender*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT );
+      }
+      else
+      {
+         NES()->PPU()->SCHEDULE ( (clock*PPU_CYCLES_PER_SCANLINE)+MMC3_RISE_DOT );
+      }
+   }
+   else if ( predictable && (!m_irqPredicted) )
+   {
+      // Try again once the next scanline's sprites have been fetched, or
+      // the pre-render scanline's if a change of layout is being watched.
+      scanline = cycle/PPU_CYCLES_PER_SCANLINE;
+      if ( (cycle%PPU_CYCLES_PER_SCANLINE) >= MMC3_SAFE_DOT )
+      {
+         scanline++;
+      }
+      if ( m_irqPredictHeld && (scanline < prerender) )
+      {
+         scanline = prerender;
+      }
+      else if ( scanline > prerender )
+      {
+         scanline = 0;
+      }
+      else if ( (scanline >= SCANLINES_VISIBLE) && (scanline < prerender) )
+      {
+         scanline = prerender;
+      }
+
+      NES()->PPU()->SCHEDULE ( (scanline*PPU_CYCLES_PER_SCANLINE)+MMC3_SAFE_DOT );
+   }
+   else
+   {
+      NES()->PPU()->UNSCHEDULE ();
+   }
+}
+
+void CROMMapper004::SYNCPPUCONTROL ( void )
+{
+   uint8_t ppuCtrl = NES()->PPU()->_PPU(PPUCTRL);
+
+   IRQSYNC ();
+
+   // Where A12 rises in the rest of the frame depends on when the PPU
+   // reads the new pattern tables and sprite size, so watch it.
+   if ( (ppuCtrl^m_irqPPUCtrl)&(PPUCTRL_SPRITE_SIZE|PPUCTRL_BKGND_PAT_TBL_ADDR|PPUCTRL_SPRITE_PAT_TBL_ADDR) )
+   {
+      IRQHOLD ();
+   }
+   m_irqPPUCtrl = ppuCtrl;
+
+   IRQSCHEDULE ();
+}
+
+void CROMMapper004::PPUEVENT ( void )
+{
+   IRQSYNC ();
+   IRQSCHEDULE ();
+}
+
+uint32_t CROMMapper004::IRQRELOAD ( void )
+{
+   uint8_t counter = m_irqCounter;
+   bool    reload = m_irqReload;
+
+   IRQCLOCK ( IRQCLOCKS(), &counter, &reload );
+   return reload;
+}
+
+uint32_t CROMMapper004::IRQCOUNTER ( void )
+{
+   uint8_t counter = m_irqCounter;
+   bool    reload = m_irqReload;
+
+   IRQCLOCK ( IRQCLOCKS(), &counter, &reload );
+   return counter;
+}
+
+uint32_t CROMMapper004::PPUADDRA12 ( void )
+{
+   uint32_t a12;
+   uint32_t lastCycle;
+
+   IRQA12 ( &a12, &lastCycle );
+   return a12;
+}
+
+uint32_t CROMMapper004::PPUCYCLE ( void )
+{
+   uint32_t a12;
+   uint32_t lastCycle;
+
+   IRQA12 ( &a12, &lastCycle );
+   return lastCycle;
+}
+
+
 void CROMMapper004::SYNCPPU ( uint32_t ppuCycle, uint32_t ppuAddr )
 {
    bool zero = false;
    uint16_t ppuAddrA12 = ppuAddr&0x1000;
    bool clockIt = false;
+   bool predicted = m_irqPredicted;
+
+   // Only the CPU's addresses get here while the rest are predicted.
+   if ( predicted )
+   {
+      IRQSYNC ();
+   }
 
    // Determine if clocked...rising edge more than 11 cycles
    // after the last one.
@@ -198,16 +662,23 @@ void CROMMapper004::SYNCPPU ( uint32_t ppuCycle, uint32_t ppuAddr )
 
       if ( m_irqEnable && zero )
       {
-         CNES::NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
+         NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
          m_irqAsserted = true;
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for IRQ breakpoint...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
          }
       }
    }
+
+   // Predict again from what the CPU did, if it can be.
+   if ( predicted )
+   {
+      m_irqPredicted = false;
+      IRQSCHEDULE ();
+   }
 }
 
 void CROMMapper004::SETCPU ( void )
@@ -264,6 +735,12 @@ void CROMMapper004::HMAPPER ( uint32_t addr, uint8_t data )
    int32_t reg = (((addr-0x8000)/0x2000)*2)+(addr&0x0001);
    m_reg [ reg ] = data;
 
+   // The IRQ registers change when the counter next reaches zero.
+   if ( addr >= 0xC000 )
+   {
+      IRQSYNC ();
+   }
+
    switch ( addr&0xE001 )
    {
       case 0x8000:
@@ -312,11 +789,11 @@ void CROMMapper004::HMAPPER ( uint32_t addr, uint8_t data )
       case 0xA000:
          if ( data&0x01 )
          {
-            CNES::NES()->PPU()->MIRRORHORIZ ();
+            NES()->PPU()->MIRRORHORIZ ();
          }
          else
          {
-            CNES::NES()->PPU()->MIRRORVERT ();
+            NES()->PPU()->MIRRORVERT ();
          }
 
          break;
@@ -330,7 +807,7 @@ void CROMMapper004::HMAPPER ( uint32_t addr, uint8_t data )
          break;
       case 0xE000:
          m_irqEnable = false;
-         CNES::NES()->CPU()->RELEASEIRQ ( eNESSource_Mapper );
+         NES()->CPU()->RELEASEIRQ ( eNESSource_Mapper );
          m_irqAsserted = false;
          break;
       case 0xE001:
@@ -338,9 +815,14 @@ void CROMMapper004::HMAPPER ( uint32_t addr, uint8_t data )
          break;
    }
 
-   if ( nesIsDebuggable )
+   if ( addr >= 0xC000 )
+   {
+      IRQSCHEDULE ();
+   }
+
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
@@ -6,14 +6,18 @@
 class CROMMapper004 : public CROM
 {
 private:
-   CROMMapper004();
+   CROMMapper004(CNES* pNES);
 public:
-   static inline CROMMapper004* CARTFACTORY() { return new CROMMapper004(); }
+   static inline CROMMapper004* CARTFACTORY(CNES* pNES) { return new CROMMapper004(pNES); }
    virtual ~CROMMapper004();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SYNCPPU ( uint32_t ppuCycle, uint32_t ppuAddr );
+   void SYNCPPUCONTROL ( void );
+   void PPUEVENT ( void );
+   void RESCHEDULE ( void );
    void SETCPU ( void );
    void SETPPU ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
@@ -28,28 +32,35 @@ public:
    {
       return m_irqAsserted;
    }
-   uint32_t IRQRELOAD ( void )
-   {
-      return m_irqReload;
-   }
-   uint32_t IRQCOUNTER ( void )
-   {
-      return m_irqCounter;
-   }
+   uint32_t IRQRELOAD ( void );
+   uint32_t IRQCOUNTER ( void );
    uint32_t IRQLATCH ( void )
    {
       return m_irqLatch;
    }
-   uint32_t PPUADDRA12 ( void )
-   {
-      return m_lastPPUAddrA12;
-   }
-   uint32_t PPUCYCLE ( void )
-   {
-      return m_lastPPUCycle;
-   }
+   uint32_t PPUADDRA12 ( void );
+   uint32_t PPUCYCLE ( void );
 
 protected:
+   // While rendering is off, or fetches the background from $0000 and
+   // 8x8 sprites from $1000, when A12 rises and so when the IRQ counter
+   // is clocked is known in advance.  The counter is then brought up to
+   // date from the PPU frame and cycle it was last brought up to date at
+   // only when something needs it, instead of on every fetch.  A change
+   // of the pattern tables or sprite size part way through a frame goes
+   // back to watching every fetch until the pre-render scanline's sprites
+   // have been fetched.
+   bool IRQPREDICTABLE ( bool* rendering );
+   bool IRQCANPREDICT ( void );
+   uint32_t IRQCLOCKSUPTO ( uint32_t cycle );
+   uint32_t IRQCLOCKS ( void );
+   bool IRQCLOCK ( uint32_t clocks, uint8_t* counter, bool* reload );
+   bool IRQLASTRISE ( uint32_t cycle, uint32_t* rise, uint32_t* a12 );
+   void IRQA12 ( uint32_t* a12, uint32_t* lastCycle );
+   void IRQSYNC ( void );
+   void IRQHOLD ( void );
+   void IRQSCHEDULE ( void );
+
    // MMC3
    uint8_t  m_reg [ 8 ];
    bool           m_irqAsserted;
@@ -62,6 +73,14 @@ protected:
 
    uint32_t   m_lastPPUAddrA12;
    uint32_t   m_lastPPUCycle;
+
+   bool       m_irqPredicted;
+   bool       m_irqPredictRendering;
+   uint32_t   m_irqFrame;
+   uint32_t   m_irqCycle;
+   uint8_t    m_irqPPUCtrl;
+   bool       m_irqPredictHeld;
+   uint32_t   m_irqHeldFrame;
 };
 
 #endif
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper005.h"
+#include "cnessavestate.h"
 
 #include "cnes6502.h"
 #include "cnesppu.h"
@@ -320,7 +321,11 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,46,46,tblRegisters,rowHeadings,columnHeadings);
 
-uint32_t CROMMapper005::m_soundEnableMask = 0xffffffff;
+void CNAMETABLEFILLER::SERIALIZE ( CNESSaveState* state )
+{
+   state->VALUE ( m_tileFill );
+   state->VALUE ( m_attrFill );
+}
 
 CCodeDataLogger* CNAMETABLEFILLER::LOGGER (uint32_t virtAddr)
 {
@@ -380,19 +385,22 @@ void CNAMETABLEFILLER::MEMATPHYSADDR (uint32_t absAddr, uint8_t data)
    }
 }
 
-CROMMapper005::CROMMapper005()
-   : CROM(5)
+CROMMapper005::CROMMapper005(CNES* pNES)
+   : CROM(pNES,5)
 {
    delete m_pEXRAMmemory; // Remove open-bus default
-   m_pEXRAMmemory = new CMEMORY(0x5C00,MEM_1KB);
+   m_pEXRAMmemory = new CMEMORY(pNES,0x5C00,MEM_1KB);
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB,8,4);
-   m_pFILLmemory = new CNAMETABLEFILLER();
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB,8,4);
+   m_pFILLmemory = new CNAMETABLEFILLER(pNES);
    memset(m_prgRAM,false,sizeof(m_prgRAM));
    memset(m_reg,0,sizeof(m_reg));
    memset(m_chrReg_a,0,sizeof(m_chrReg_a));
    memset(m_chrReg_b,0,sizeof(m_chrReg_b));
+   m_outLast = 0;
+   m_outDownsampled = 0;
    m_prgRemappable = true;
+   m_syncCaps = SYNC_CPU_CYCLE|SYNC_PPU_FETCH;
    m_chrRemappable = true;
 }
 
@@ -407,9 +415,9 @@ void CROMMapper005::RESET ( bool soft )
 
    CROM::RESET ( soft );
 
-   m_square[0].PARENT(CNES::NES()->CPU()->APU());
-   m_square[1].PARENT(CNES::NES()->CPU()->APU());
-   m_dmc.PARENT(CNES::NES()->CPU()->APU());
+   m_square[0].PARENT(NES()->CPU()->APU());
+   m_square[1].PARENT(NES()->CPU()->APU());
+   m_dmc.PARENT(NES()->CPU()->APU());
 
    m_square[0].RESET();
    m_square[1].RESET();
@@ -447,6 +455,61 @@ void CROMMapper005::RESET ( bool soft )
    SETPPU();
 }
 
+void CROMMapper005::MEMORIES ( CNESSaveState* state )
+{
+   CROM::MEMORIES ( state );
+
+   // The fill-mode nametable can be mapped into the PPU's address space.
+   state->MEMORY ( m_pFILLmemory );
+}
+
+void CROMMapper005::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_prgMode );
+   state->VALUE ( m_chrMode );
+   state->VALUE ( m_chrHigh );
+   state->VALUE ( m_irqScanline );
+   state->VALUE ( m_irqEnabled );
+   state->VALUE ( m_irqStatus );
+   state->VALUE ( m_exRamMode );
+   state->VALUE ( m_sc1 );
+   state->VALUE ( m_sc2 );
+   state->VALUE ( m_sc3 );
+   state->VALUE ( m_sc4 );
+   state->VALUE ( m_prgRAM );
+   state->VALUE ( m_wp );
+   state->VALUE ( m_ppuCycle );
+   state->VALUE ( m_ppuAddr );
+   state->VALUE ( m_chrReg_a );
+   state->VALUE ( m_chrReg_b );
+   state->VALUE ( m_chrBank_a );
+   state->VALUE ( m_chrBank_b );
+   state->VALUE ( m_prg );
+   state->VALUE ( m_wp1 );
+   state->VALUE ( m_wp2 );
+   state->VALUE ( m_mult1 );
+   state->VALUE ( m_mult2 );
+   state->VALUE ( m_timer );
+   state->VALUE ( m_timerIrq );
+   state->VALUE ( m_prod );
+   state->VALUE ( m_8x16e );
+   state->VALUE ( m_8x16z );
+   state->VALUE ( m_lastChr );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_outLast );
+   state->VALUE ( m_outDownsampled );
+   state->VALUE ( m_sprite8x16Mode );
+   state->VALUE ( m_lastPPUCycle );
+   m_pFILLmemory->SERIALIZE ( state );
+   m_square[0].SERIALIZE ( state );
+   m_square[1].SERIALIZE ( state );
+   m_dmc.SERIALIZE ( state );
+   state->ENDCHUNK ();
+}
+
 void CROMMapper005::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
 {
    if ( write )
@@ -466,7 +529,7 @@ void CROMMapper005::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
       m_timer--;
       if ( !m_timer )
       {
-         CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+         NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
       }
    }
 
@@ -502,12 +565,12 @@ void CROMMapper005::SYNCPPU ( uint32_t ppuCycle, uint32_t ppuAddr )
 
    if ( m_irqEnabled && (m_irqStatus&0x80) && rasterX == 0 )
    {
-      CNES::NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
+      NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for IRQ breakpoint...
-         CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+         NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
       }
    }
 }
@@ -945,7 +1008,7 @@ uint32_t CROMMapper005::LMAPPER ( uint32_t addr )
       case 0x5204:
          data = m_irqStatus;
          m_irqStatus &= ~(0x80);
-         CNES::NES()->CPU()->RELEASEIRQ ( eNESSource_Mapper );
+         NES()->CPU()->RELEASEIRQ ( eNESSource_Mapper );
          break;
       case 0x5205:
          data = m_prod&0xFF;
@@ -955,7 +1018,7 @@ uint32_t CROMMapper005::LMAPPER ( uint32_t addr )
          break;
       case 0x5209:
          data = m_timerIrq?0x80:0x00;
-         CNES::NES()->CPU()->RELEASEIRQ ( eNESSource_Mapper );
+         NES()->CPU()->RELEASEIRQ ( eNESSource_Mapper );
          break;
       }
    }
@@ -1076,44 +1139,44 @@ void CROMMapper005::LMAPPER ( uint32_t addr, uint8_t data )
          if ( sc1 == 0x2 )
          {
             sc1 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_pEXRAMmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_pEXRAMmemory->PHYSBANK(0) );
          }
          else if ( sc1 == 0x3 )
          {
             sc1 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_pFILLmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_pFILLmemory->PHYSBANK(0) );
          }
          if ( sc2 == 0x2 )
          {
             sc2 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_pEXRAMmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_pEXRAMmemory->PHYSBANK(0) );
          }
          else if ( sc2 == 0x3 )
          {
             sc2 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_pFILLmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_pFILLmemory->PHYSBANK(0) );
          }
          if ( sc3 == 0x2 )
          {
             sc3 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_pEXRAMmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_pEXRAMmemory->PHYSBANK(0) );
          }
          else if ( sc3 == 0x3 )
          {
             sc3 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_pFILLmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_pFILLmemory->PHYSBANK(0) );
          }
          if ( sc4 == 0x2 )
          {
             sc4 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_pEXRAMmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_pEXRAMmemory->PHYSBANK(0) );
          }
          else if ( sc4 == 0x3 )
          {
             sc4 = -1;
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_pFILLmemory->PHYSBANK(0) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_pFILLmemory->PHYSBANK(0) );
          }
-         CNES::NES()->PPU()->MIRROR ( sc1, sc2, sc3, sc4 );
+         NES()->PPU()->MIRROR ( sc1, sc2, sc3, sc4 );
          break;
       case 0x5106:
          m_reg[17] = data;
@@ -1315,21 +1378,45 @@ uint32_t CROMMapper005::VRAM ( uint32_t addr )
    return CART_UNCLAIMED;
 }
 
+void CROMMapper005::CHRMEMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length )
+{
+   while ( length-- )
+   {
+      *(dest++) = CHRMEM(addr++);
+   }
+}
+
+bool CROMMapper005::VRAMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length )
+{
+   uint32_t data;
+
+   // Nametable bytes the mapper doesn't make up come from the PPU.
+   while ( length-- )
+   {
+      data = VRAM(addr);
+      if ( data == CART_UNCLAIMED )
+      {
+         data = NES()->PPU()->VRAM()->MEM(addr);
+      }
+      *(dest++) = data;
+      addr++;
+   }
+   return true;
+}
+
 uint16_t CROMMapper005::AMPLITUDE ( void )
 {
    float famp;
    int16_t amp;
    int16_t delta;
-   static int16_t outLast = 0;
    uint8_t sample;
    uint8_t* sq1dacSamples = m_square[0].GETDACSAMPLES();
    uint8_t* sq2dacSamples = m_square[1].GETDACSAMPLES();
    uint8_t* dmcDacSamples = m_dmc.GETDACSAMPLES();
-   static int32_t outDownsampled = 0;
 
-   m_square[0].MUTE(!(m_soundEnableMask&0x01));
-   m_square[1].MUTE(!(m_soundEnableMask&0x02));
-   m_dmc.MUTE(!(m_soundEnableMask&0x04));
+   m_square[0].MUTE(!(NES()->MMC5AUDIOMASK()&0x01));
+   m_square[1].MUTE(!(NES()->MMC5AUDIOMASK()&0x02));
+   m_dmc.MUTE(!(NES()->MMC5AUDIOMASK()&0x04));
 
    for ( sample = 0; sample < m_square[0].GETDACSAMPLECOUNT(); sample++ )
    {
@@ -1363,20 +1450,20 @@ uint16_t CROMMapper005::AMPLITUDE ( void )
 
       (*(m_out+sample)) = amp;
 
-      outDownsampled += (*(m_out+sample));
+      m_outDownsampled += (*(m_out+sample));
    }
 
-   outDownsampled = (int32_t)((float)outDownsampled/((float)m_square[0].GETDACSAMPLECOUNT()));
+   m_outDownsampled = (int32_t)((float)m_outDownsampled/((float)m_square[0].GETDACSAMPLECOUNT()));
 
-   delta = outDownsampled - outLast;
-   outDownsampled = outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
+   delta = m_outDownsampled - m_outLast;
+   m_outDownsampled = m_outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
 
-   outLast = outDownsampled;
+   m_outLast = m_outDownsampled;
 
    // Reset DAC averaging...
    m_square[0].CLEARDACAVG();
    m_square[1].CLEARDACAVG();
    m_dmc.CLEARDACAVG();
 
-   return outDownsampled;
+   return m_outDownsampled;
 }
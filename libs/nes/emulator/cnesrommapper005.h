@@ -7,7 +7,7 @@
 class CNAMETABLEFILLER: public CMEMORY
 {
 public:
-   CNAMETABLEFILLER() : CMEMORY(0x5106,1) {}
+   CNAMETABLEFILLER(CNES* pNES) : CMEMORY(pNES,0x5106,1) {}
    virtual ~CNAMETABLEFILLER() {};
 
    // Code/Data logger support functions
@@ -23,16 +23,27 @@ public:
    void MEMATPHYSADDR (uint32_t absAddr, uint8_t data);
 
    uint8_t* MEMPTR (uint32_t addr) { return m_pBank[0]->MEMPTR(0); }
+   void MEMCOPY (uint8_t* dest, uint32_t virtAddr, uint32_t length)
+   {
+      while ( length-- )
+      {
+         *(dest++) = MEM(virtAddr++);
+      }
+   }
 
    void REMAP(uint32_t virt, uint32_t phys) {}
    void REMAPEXT(uint32_t virt, CMEMORYBANK* phys) {}
 
+   bool CHANGEDSINCE ( uint32_t virtAddr, uint32_t length, uint32_t generation ) const { return true; }
+
    uint32_t SLOC ( uint32_t virtAddr ) { return 1; }
    char* DISASSEMBLY ( uint32_t virtAddr ) { return "???"; }
    char* DISASSEMBLYATPHYSADDR ( uint32_t physAddr, char* buffer ) { return "???"; }
 
    uint32_t TOTALSIZE() const { return 0; }
 
+   void SERIALIZE ( CNESSaveState* state );
+
 protected:
    uint8_t m_tileFill;
    uint8_t m_attrFill;
@@ -41,12 +52,14 @@ protected:
 class CROMMapper005 : public CROM
 {
 private:
-   CROMMapper005();
+   CROMMapper005(CNES* pNES);
 public:
-   static inline CROMMapper005* CARTFACTORY() { return new CROMMapper005(); }
+   static inline CROMMapper005* CARTFACTORY(CNES* pNES) { return new CROMMapper005(pNES); }
    virtual ~CROMMapper005();
 
    void RESET ( bool soft );
+   void MEMORIES ( CNESSaveState* state );
+   void SERIALIZE ( CNESSaveState* state );
    uint32_t HMAPPER ( uint32_t addr );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t LMAPPER ( uint32_t addr );
@@ -57,7 +70,6 @@ public:
    void SETPPU ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
    uint16_t AMPLITUDE ( void );
-   static void SOUNDENABLE ( uint32_t mask ) { m_soundEnableMask = mask; }
 
    // Internal accessors for mapper information inspector...
    // Note: called directly!
@@ -83,6 +95,13 @@ public:
    }
    uint32_t VRAM ( uint32_t addr );
    uint32_t CHRMEM ( uint32_t addr );
+   void CHRMEMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length );
+   bool VRAMCOPY ( uint8_t* dest, uint32_t addr, uint32_t length );
+
+   // The nametables and pattern tables the PPU sees are made up from
+   // EXRAM, the fill registers and the extended attribute mode.
+   bool VRAMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation ) { return true; }
+   bool CHRMEMCHANGEDSINCE ( uint32_t addr, uint32_t length, uint32_t generation ) { return true; }
 
 protected:
    // MMC5
@@ -122,11 +141,11 @@ protected:
    CAPUSquare m_square[2];
    CAPUDMC    m_dmc;
    int16_t    m_out[1024];
+   int16_t    m_outLast;
+   int32_t    m_outDownsampled;
 
    uint32_t   m_sprite8x16Mode;
    uint32_t   m_lastPPUCycle;
-
-   static uint32_t  m_soundEnableMask;
 };
 
 #endif
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper007.h"
+#include "cnessavestate.h"
 
 #include "cnesppu.h"
 
@@ -44,8 +45,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,1,1,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper007::CROMMapper007()
-   : CROM(7)
+CROMMapper007::CROMMapper007(CNES* pNES)
+   : CROM(pNES,7)
 {
    m_prgRemappable = true;
    m_chrRemappable = false;
@@ -65,11 +66,20 @@ void CROMMapper007::RESET ( bool soft )
    m_PRGROMmemory.REMAP(2,m_numPrgBanks-2);
    m_PRGROMmemory.REMAP(3,m_numPrgBanks-1);
 
-   CNES::NES()->PPU()->MIRROR ( 0 );
+   NES()->PPU()->MIRROR ( 0 );
 
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper007::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper007::DEBUGINFO ( uint32_t addr )
 {
    return m_reg;
@@ -88,11 +98,11 @@ void CROMMapper007::HMAPPER ( uint32_t addr, uint8_t data )
    m_PRGROMmemory.REMAP(2,bank+2);
    m_PRGROMmemory.REMAP(3,bank+3);
 
-   CNES::NES()->PPU()->MIRROR ( (m_reg&0x10)>>4 );
+   NES()->PPU()->MIRROR ( (m_reg&0x10)>>4 );
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
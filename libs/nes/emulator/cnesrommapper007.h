@@ -6,12 +6,13 @@
 class CROMMapper007 : public CROM
 {
 private:
-   CROMMapper007();
+   CROMMapper007(CNES* pNES);
 public:
-   static inline CROMMapper007* CARTFACTORY() { return new CROMMapper007(); }
+   static inline CROMMapper007* CARTFACTORY(CNES* pNES) { return new CROMMapper007(pNES); }
    virtual ~CROMMapper007();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
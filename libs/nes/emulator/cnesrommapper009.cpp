@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper009.h"
+#include "cnessavestate.h"
 
 #include "cnesppu.h"
 
@@ -71,13 +72,14 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,6,6,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper009::CROMMapper009()
-   : CROM(9)
+CROMMapper009::CROMMapper009(CNES* pNES)
+   : CROM(pNES,9)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
+   m_syncCaps = SYNC_PPU_LATCH;
    // MMC2 stuff
    memset(m_reg,0,sizeof(m_reg));
    m_latch0 = 0xFE;
@@ -122,6 +124,21 @@ void CROMMapper009::RESET ( bool soft )
    m_CHRmemory.REMAP(7,(m_latch1FE<<2)+3);
 }
 
+void CROMMapper009::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_latch0 );
+   state->VALUE ( m_latch1 );
+   state->VALUE ( m_latch0FD );
+   state->VALUE ( m_latch0FE );
+   state->VALUE ( m_latch1FD );
+   state->VALUE ( m_latch1FE );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper009::DEBUGINFO ( uint32_t addr )
 {
    switch ( addr&0xF000 )
@@ -222,20 +239,20 @@ void CROMMapper009::HMAPPER ( uint32_t addr, uint8_t data )
 
          if ( data&0x01 )
          {
-            CNES::NES()->PPU()->MIRRORHORIZ ();
+            NES()->PPU()->MIRRORHORIZ ();
          }
          else
          {
-            CNES::NES()->PPU()->MIRRORVERT ();
+            NES()->PPU()->MIRRORVERT ();
          }
 
          break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
 
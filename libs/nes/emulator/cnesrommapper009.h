@@ -6,12 +6,13 @@
 class CROMMapper009 : public CROM
 {
 private:
-   CROMMapper009();
+   CROMMapper009(CNES* pNES);
 public:
-   static inline CROMMapper009* CARTFACTORY() { return new CROMMapper009(); }
+   static inline CROMMapper009* CARTFACTORY(CNES* pNES) { return new CROMMapper009(pNES); }
    virtual ~CROMMapper009();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SYNCPPU ( uint32_t ppuCycle, uint32_t ppuAddr );
    uint32_t DEBUGINFO ( uint32_t addr );
@@ -6,12 +6,13 @@
 class CROMMapper010 : public CROM
 {
 private:
-   CROMMapper010();
+   CROMMapper010(CNES* pNES);
 public:
-   static inline CROMMapper010* CARTFACTORY() { return new CROMMapper010(); }
+   static inline CROMMapper010* CARTFACTORY(CNES* pNES) { return new CROMMapper010(pNES); }
    virtual ~CROMMapper010();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SYNCPPU ( uint32_t ppuCycle, uint32_t ppuAddr );
    uint32_t DEBUGINFO ( uint32_t addr );
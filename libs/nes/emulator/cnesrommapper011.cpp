@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper011.h"
+#include "cnessavestate.h"
 #include "cnesppu.h"
 
 // Mapper 011 Registers
@@ -42,8 +43,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,1,1,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper011::CROMMapper011()
-   : CROM(11)
+CROMMapper011::CROMMapper011(CNES* pNES)
+   : CROM(pNES,11)
 {
    m_reg = 0x00;
    m_prgRemappable = true;
@@ -66,6 +67,15 @@ void CROMMapper011::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper011::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper011::DEBUGINFO ( uint32_t addr )
 {
    return m_reg;
@@ -93,9 +103,9 @@ void CROMMapper011::HMAPPER ( uint32_t addr, uint8_t data )
    m_CHRmemory.REMAP(6,((data>>1)&0x78)+6);
    m_CHRmemory.REMAP(7,((data>>1)&0x78)+7);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper011 : public CROM
 {
 private:
-   CROMMapper011();
+   CROMMapper011(CNES* pNES);
 public:
-   static inline CROMMapper011* CARTFACTORY() { return new CROMMapper011(); }
+   static inline CROMMapper011* CARTFACTORY(CNES* pNES) { return new CROMMapper011(pNES); }
    virtual ~CROMMapper011();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper013.h"
+#include "cnessavestate.h"
 
 #include "cregisterdata.h"
 
@@ -41,8 +42,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,1,1,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper013::CROMMapper013()
-   : CROM(13)
+CROMMapper013::CROMMapper013(CNES* pNES)
+   : CROM(pNES,13)
 {
    m_reg = 0x00;
    m_prgRemappable = false;
@@ -65,6 +66,15 @@ void CROMMapper013::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper013::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper013::DEBUGINFO ( uint32_t addr )
 {
    return m_reg;
@@ -79,9 +89,9 @@ void CROMMapper013::HMAPPER ( uint32_t addr, uint8_t data )
    m_CHRmemory.REMAP(6,((m_reg&0x3)<<2)+2);
    m_CHRmemory.REMAP(7,((m_reg&0x3)<<2)+3);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper013 : public CROM
 {
 private:
-   CROMMapper013();
+   CROMMapper013(CNES* pNES);
 public:
-   static inline CROMMapper013* CARTFACTORY() { return new CROMMapper013(); }
+   static inline CROMMapper013* CARTFACTORY(CNES* pNES) { return new CROMMapper013(pNES); }
    virtual ~CROMMapper013();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
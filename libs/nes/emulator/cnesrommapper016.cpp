@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper016.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -86,8 +87,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,14,14,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper016::CROMMapper016()
-   : CROM(16)
+CROMMapper016::CROMMapper016(CNES* pNES)
+   : CROM(pNES,16)
 {
    memset(m_reg,0,sizeof(m_reg));
    m_prgRemappable = true;
@@ -95,6 +96,7 @@ CROMMapper016::CROMMapper016()
    m_irqCounter = 0;
    m_irqEnabled = false;
    m_irqAsserted = false;
+   m_irqCycle = 0;
    m_eepromBitCounter = 0;
    m_eepromState = 0;
 }
@@ -144,24 +146,98 @@ void CROMMapper016::RESET159 ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper016::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
+void CROMMapper016::SERIALIZE ( CNESSaveState* state )
 {
-   if ( m_irqEnabled )
+   CROM::SERIALIZE ( state );
+
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
+   {
+      IRQSYNC ( NES()->CPU()->_CYCLES() );
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqEnabled );
+   state->VALUE ( m_irqAsserted );
+   state->VALUE ( m_eepromBitCounter );
+   state->VALUE ( m_eepromState );
+   state->VALUE ( m_eepromCmd );
+   state->VALUE ( m_eepromAddr );
+   state->VALUE ( m_eepromDataBuf );
+   state->VALUE ( m_eepromRWBit );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
+   }
+}
+
+void CROMMapper016::RESCHEDULE ( void )
+{
+   m_irqCycle = NES()->CPU()->_CYCLES();
+   IRQSCHEDULE ();
+}
+
+void CROMMapper016::IRQSYNC ( uint32_t cycle )
+{
+   uint32_t cycles = cycle-m_irqCycle;
+
+   if ( (int32_t)cycles <= 0 )
    {
-      m_irqCounter--;
+      return;
+   }
+   m_irqCycle = cycle;
 
-      if ( !m_irqCounter )
+   // The counter counts down every CPU cycle while enabled and fires each
+   // time it reaches zero.
+   if ( m_irqEnabled )
+   {
+      if ( cycles >= (m_irqCounter?m_irqCounter:0x10000) )
       {
          m_irqAsserted = true;
-         CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+         NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for IRQ breakpoint...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
          }
       }
+      m_irqCounter -= cycles;
+   }
+}
+
+void CROMMapper016::IRQSCHEDULE ( void )
+{
+   if ( m_irqEnabled )
+   {
+      NES()->CPU()->SCHEDULE ( m_irqCycle+(m_irqCounter?m_irqCounter:0x10000) );
+   }
+   else
+   {
+      NES()->CPU()->UNSCHEDULE ();
+   }
+}
+
+void CROMMapper016::CPUEVENT ( void )
+{
+   IRQSYNC ( NES()->CPU()->_CYCLES() );
+   IRQSCHEDULE ();
+}
+
+uint32_t CROMMapper016::IRQCOUNTER ( void )
+{
+   uint32_t cycles = NES()->CPU()->_CYCLES()-m_irqCycle;
+
+   if ( m_irqEnabled && ((int32_t)cycles > 0) )
+   {
+      return (uint16_t)(m_irqCounter-cycles);
    }
+   return m_irqCounter;
 }
 
 uint32_t CROMMapper016::DEBUGINFO ( uint32_t addr )
@@ -216,7 +292,7 @@ uint32_t CROMMapper016::DEBUGINFO ( uint32_t addr )
 
 uint32_t CROMMapper016::LMAPPER ( uint32_t addr )
 {
-   uint8_t data = CNES::NES()->CPU()->OPENBUS();
+   uint8_t data = NES()->CPU()->OPENBUS();
 
    switch ( m_eepromState )
    {
@@ -277,6 +353,9 @@ void CROMMapper016::HMAPPER ( uint32_t addr, uint8_t data )
 {
    uint32_t reg = 0;
 
+   // The counter has counted up to, but not including, this cycle.
+   IRQSYNC ( NES()->CPU()->_CYCLES()-1 );
+
    switch ( addr&0x000F )
    {
    case 0x0000:
@@ -331,16 +410,16 @@ void CROMMapper016::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( data&0x03 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       case 2:
-         CNES::NES()->PPU()->MIRROR(0,0,0,0);
+         NES()->PPU()->MIRROR(0,0,0,0);
          break;
       case 3:
-         CNES::NES()->PPU()->MIRROR(1,1,1,1);
+         NES()->PPU()->MIRROR(1,1,1,1);
          break;
       }
       break;
@@ -349,7 +428,7 @@ void CROMMapper016::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[10] = data;
       m_irqEnabled = data&0x01;
       m_irqAsserted = false;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    case 0x000B:
       reg = 11;
@@ -443,7 +522,7 @@ void CROMMapper016::HMAPPER ( uint32_t addr, uint8_t data )
                   {
                      CROM::SRAMVIRT(0x6000+(m_eepromAddr>>1),m_eepromDataBuf);
                   }
-                  CNES::NES()->FORCEBREAKPOINT();
+                  NES()->FORCEBREAKPOINT();
                   if ( m_mapper == 16 )
                   {
                      m_eepromAddr++;
@@ -481,9 +560,11 @@ void CROMMapper016::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   IRQSCHEDULE ();
+
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
@@ -6,16 +6,18 @@
 class CROMMapper016 : public CROM
 {
 private:
-   CROMMapper016();
+   CROMMapper016(CNES* pNES);
 public:
-   static inline CROMMapper016* CARTFACTORY() { return new CROMMapper016(); }
+   static inline CROMMapper016* CARTFACTORY(CNES* pNES) { return new CROMMapper016(pNES); }
    virtual ~CROMMapper016();
 
    void RESET016 ( bool soft );
    void RESET159 ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t LMAPPER ( uint32_t addr );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
+   void CPUEVENT ( void );
+   void RESCHEDULE ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
 
    // Internal accessors for mapper information inspector...
@@ -24,10 +26,7 @@ public:
    {
       return m_irqEnabled;
    }
-   uint32_t IRQCOUNTER ( void )
-   {
-      return m_irqCounter;
-   }
+   uint32_t IRQCOUNTER ( void );
    uint32_t IRQASSERTED ( void )
    {
       return m_irqAsserted;
@@ -54,10 +53,16 @@ public:
    }
 
 protected:
+   // The IRQ counter is brought up to date from the CPU cycle it was last
+   // brought up to date at only when something needs it.
+   void IRQSYNC ( uint32_t cycle );
+   void IRQSCHEDULE ( void );
+
    uint8_t  m_reg [ 14 ];
    uint16_t m_irqCounter;
    bool     m_irqEnabled;
    bool     m_irqAsserted;
+   uint32_t m_irqCycle;
    uint8_t  m_eepromBitCounter;
    uint8_t  m_eepromState;
    uint8_t  m_eepromCmd;
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper018.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -129,11 +130,11 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,29,29,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper018::CROMMapper018()
-   : CROM(18)
+CROMMapper018::CROMMapper018(CNES* pNES)
+   : CROM(pNES,18)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
    memset(m_reg,0,sizeof(m_reg));
@@ -142,6 +143,7 @@ CROMMapper018::CROMMapper018()
    m_irqReload = 0;
    m_irqCounter = 0;
    m_irqEnabled = false;
+   m_irqCycle = 0;
 }
 
 CROMMapper018::~CROMMapper018()
@@ -166,54 +168,111 @@ void CROMMapper018::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper018::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
+void CROMMapper018::SERIALIZE ( CNESSaveState* state )
 {
-   uint16_t counterMask;
+   CROM::SERIALIZE ( state );
+
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
+   {
+      IRQSYNC ( NES()->CPU()->_CYCLES() );
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_prg );
+   state->VALUE ( m_chr );
+   state->VALUE ( m_irqReload );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqEnabled );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
+   }
+}
+
+void CROMMapper018::RESCHEDULE ( void )
+{
+   m_irqCycle = NES()->CPU()->_CYCLES();
+   IRQSCHEDULE ();
+}
+
+void CROMMapper018::IRQSYNC ( uint32_t cycle )
+{
+   uint32_t cycles = cycle-m_irqCycle;
+   uint16_t counterMask = IRQCOUNTERMASK();
    uint16_t counter;
-   uint8_t  size;
 
-   size = ((m_reg[27]&0x0E)>>1);
+   if ( (int32_t)cycles <= 0 )
+   {
+      return;
+   }
+   m_irqCycle = cycle;
 
+   // The relevant counter bits count down every CPU cycle while enabled
+   // and fire each time they wrap around.
    if ( m_irqEnabled )
    {
-      // Get relevant counter bits.
-      if ( size == 0 )
-      {
-         // 16 bits
-         counterMask = 0xFFFF;
-      }
-      else if ( size == 1 )
-      {
-         // 12 bits
-         counterMask = 0x0FFF;
-      }
-      else if ( size < 4 )
-      {
-         // 8 bits
-         counterMask = 0x00FF;
-      }
-      else
-      {
-         // 4 bits
-         counterMask = 0x000F;
-      }
-
       counter = m_irqCounter&counterMask;
-      counter--;
-      m_irqCounter &= (~counterMask);
-      m_irqCounter |= (counter&counterMask);
-
-      if ( (m_irqCounter&counterMask) == counterMask )
+      if ( cycles > counter )
       {
-         CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+         NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for IRQ breakpoint...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
          }
       }
+      counter -= cycles;
+      m_irqCounter &= (~counterMask);
+      m_irqCounter |= (counter&counterMask);
+   }
+}
+
+void CROMMapper018::IRQSCHEDULE ( void )
+{
+   if ( m_irqEnabled )
+   {
+      NES()->CPU()->SCHEDULE ( m_irqCycle+(m_irqCounter&IRQCOUNTERMASK())+1 );
+   }
+   else
+   {
+      NES()->CPU()->UNSCHEDULE ();
+   }
+}
+
+void CROMMapper018::CPUEVENT ( void )
+{
+   IRQSYNC ( NES()->CPU()->_CYCLES() );
+   IRQSCHEDULE ();
+}
+
+uint16_t CROMMapper018::IRQCOUNTERMASK ( void )
+{
+   uint8_t size = ((m_reg[27]&0x0E)>>1);
+
+   // Get relevant counter bits.
+   if ( size == 0 )
+   {
+      // 16 bits
+      return 0xFFFF;
    }
+   else if ( size == 1 )
+   {
+      // 12 bits
+      return 0x0FFF;
+   }
+   else if ( size < 4 )
+   {
+      // 8 bits
+      return 0x00FF;
+   }
+   // 4 bits
+   return 0x000F;
 }
 
 uint32_t CROMMapper018::DEBUGINFO ( uint32_t addr )
@@ -315,6 +374,9 @@ void CROMMapper018::HMAPPER ( uint32_t addr, uint8_t data )
 {
    uint32_t reg = 0;
 
+   // The counter has counted up to, but not including, this cycle.
+   IRQSYNC ( NES()->CPU()->_CYCLES()-1 );
+
    switch ( addr )
    {
    case 0x8000:
@@ -499,13 +561,13 @@ void CROMMapper018::HMAPPER ( uint32_t addr, uint8_t data )
       reg = 26;
       m_reg[26] = data;
       m_irqCounter = m_irqReload;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    case 0xF001:
       reg = 27;
       m_reg[27] = data;
       m_irqEnabled = data&0x01;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    case 0xF002:
       reg = 28;
@@ -513,24 +575,26 @@ void CROMMapper018::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( data&0x03 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 2:
-         CNES::NES()->PPU()->MIRROR(0,0,0,0);
+         NES()->PPU()->MIRROR(0,0,0,0);
          break;
       case 3:
-         CNES::NES()->PPU()->MIRROR(1,1,1,1);
+         NES()->PPU()->MIRROR(1,1,1,1);
          break;
       }
       break;
    }
 
-   if ( nesIsDebuggable )
+   IRQSCHEDULE ();
+
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
@@ -6,23 +6,32 @@
 class CROMMapper018 : public CROM
 {
 private:
-   CROMMapper018();
+   CROMMapper018(CNES* pNES);
 public:
-   static inline CROMMapper018* CARTFACTORY() { return new CROMMapper018(); }
+   static inline CROMMapper018* CARTFACTORY(CNES* pNES) { return new CROMMapper018(pNES); }
    virtual ~CROMMapper018();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
+   void CPUEVENT ( void );
+   void RESCHEDULE ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
 
 protected:
+   // The IRQ counter is brought up to date from the CPU cycle it was last
+   // brought up to date at only when something needs it.
+   void IRQSYNC ( uint32_t cycle );
+   void IRQSCHEDULE ( void );
+   uint16_t IRQCOUNTERMASK ( void );
+
    uint8_t  m_reg [ 29 ];
    uint8_t  m_prg [ 3 ];
    uint8_t  m_chr [ 8 ];
    uint16_t m_irqReload;
    uint16_t m_irqCounter;
    bool     m_irqEnabled;
+   uint32_t m_irqCycle;
 };
 
 #endif
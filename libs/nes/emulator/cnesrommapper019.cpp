@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper019.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -104,19 +105,20 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,19,19,tblRegisters,rowHeadings,columnHeadings);
 
-uint32_t CROMMapper019::m_soundEnableMask = 0xffffffff;
-
-CROMMapper019::CROMMapper019()
-   : CROM(19)
+CROMMapper019::CROMMapper019(CNES* pNES)
+   : CROM(pNES,19)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
+   m_syncCaps = SYNC_CPU_CYCLE;
    memset(m_reg,0,sizeof(m_reg));
    m_irqCounter = 0;
    m_irqEnabled = false;
    m_soundChansEnabled = 0;
+   m_outLast = 0;
+   m_outDownsampled = 0;
 }
 
 CROMMapper019::~CROMMapper019()
@@ -148,6 +150,29 @@ void CROMMapper019::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper019::SERIALIZE ( CNESSaveState* state )
+{
+   int32_t idx;
+
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_chr );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqEnabled );
+   state->VALUE ( m_outLast );
+   state->VALUE ( m_outDownsampled );
+   state->VALUE ( m_soundRAM );
+   state->VALUE ( m_soundRAMAddr );
+   state->VALUE ( m_soundChansEnabled );
+   for ( idx = 0; idx < 8; idx++ )
+   {
+      m_wave[idx].SERIALIZE ( state );
+   }
+   state->ENDCHUNK ();
+}
+
 void CROMMapper019::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
 {
    int32_t idx;
@@ -161,12 +186,12 @@ void CROMMapper019::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
    {
       if ( m_irqCounter == 0x7FFF )
       {
-         CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+         NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for IRQ breakpoint...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
          }
       }
       else
@@ -244,7 +269,7 @@ uint32_t CROMMapper019::DEBUGINFO ( uint32_t addr )
 uint32_t CROMMapper019::LMAPPER ( uint32_t addr )
 {
    uint32_t reg = 0;
-   uint8_t data = CNES::NES()->CPU()->OPENBUS();
+   uint8_t data = NES()->CPU()->OPENBUS();
 
    switch ( addr )
    {
@@ -260,19 +285,19 @@ uint32_t CROMMapper019::LMAPPER ( uint32_t addr )
    case 0x5000:
       reg = 1;
       data = m_reg[1];
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    case 0x5800:
       reg = 2;
       data = m_reg[2];
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 
    return data;
@@ -308,24 +333,24 @@ void CROMMapper019::LMAPPER ( uint32_t addr, uint8_t data )
    case 0x5000:
       reg = 1;
       m_reg[1] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       m_irqCounter &= 0xFF00;
       m_irqCounter |= data;
       break;
    case 0x5800:
       reg = 2;
       m_reg[2] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       m_irqCounter &= 0x00FF;
       m_irqCounter |= ((data&0x7F)<<8);
       m_irqEnabled = (data&0x80);
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
 
@@ -444,11 +469,11 @@ void CROMMapper019::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[11] = data;
       if ( data < 0xE0 )
       {
-         CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[11]) );
+         NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[11]) );
       }
       else
       {
-         CNES::NES()->PPU()->MIRROR(m_reg[11]&0x01,-1,-1,-1);
+         NES()->PPU()->MIRROR(m_reg[11]&0x01,-1,-1,-1);
       }
       break;
    case 0xC800:
@@ -456,11 +481,11 @@ void CROMMapper019::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[12] = data;
       if ( data < 0xE0 )
       {
-         CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[12]) );
+         NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[12]) );
       }
       else
       {
-         CNES::NES()->PPU()->MIRROR(-1,m_reg[12]&0x01,-1,-1);
+         NES()->PPU()->MIRROR(-1,m_reg[12]&0x01,-1,-1);
       }
       break;
    case 0xD000:
@@ -468,11 +493,11 @@ void CROMMapper019::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[13] = data;
       if ( data < 0xE0 )
       {
-         CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_CHRmemory.PHYSBANK(m_reg[13]) );
+         NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_CHRmemory.PHYSBANK(m_reg[13]) );
       }
       else
       {
-         CNES::NES()->PPU()->MIRROR(-1,-1,m_reg[13]&0x01,-1);
+         NES()->PPU()->MIRROR(-1,-1,m_reg[13]&0x01,-1);
       }
       break;
    case 0xD800:
@@ -480,11 +505,11 @@ void CROMMapper019::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[14] = data;
       if ( data < 0xE0 )
       {
-         CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_CHRmemory.PHYSBANK(m_reg[14]) );
+         NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_CHRmemory.PHYSBANK(m_reg[14]) );
       }
       else
       {
-         CNES::NES()->PPU()->MIRROR(-1,-1,-1,m_reg[14]&0x01);
+         NES()->PPU()->MIRROR(-1,-1,-1,m_reg[14]&0x01);
       }
       break;
    case 0xE000:
@@ -509,13 +534,26 @@ void CROMMapper019::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
 
+void N106WaveChannel::SERIALIZE(CNESSaveState* state)
+{
+   state->VALUE ( volume );
+   state->VALUE ( period );
+   state->VALUE ( periodCounter );
+   state->VALUE ( instrumentLength );
+   state->VALUE ( instrumentAddress );
+   state->VALUE ( instrumentStep );
+   state->VALUE ( dacAverage );
+   state->VALUE ( dac );
+   state->VALUE ( dacSamples );
+}
+
 void N106WaveChannel::TIMERTICK(uint8_t enabled)
 {
    uint8_t data;
@@ -562,10 +600,8 @@ uint16_t CROMMapper019::AMPLITUDE()
    int16_t amp;
    int16_t delta;
    int16_t out[100] = { 0, };
-   static int16_t outLast = 0;
    uint8_t sample;
    uint8_t* wdacSamples[8];
-   static int32_t outDownsampled = 0;
    int32_t idx;
 
    wdacSamples[0] = m_wave[0].GETDACSAMPLES();
@@ -580,7 +616,7 @@ uint16_t CROMMapper019::AMPLITUDE()
    uint32_t bit;
    for ( bit = 0; bit < 8; bit++ )
    {
-      m_wave[bit].muted = !(m_soundEnableMask&(0x01<<bit));
+      m_wave[bit].muted = !(NES()->N106AUDIOMASK()&(0x01<<bit));
    }
 
    for ( sample = 0; sample < m_wave[0].GETDACSAMPLECOUNT(); sample++ )
@@ -602,15 +638,15 @@ uint16_t CROMMapper019::AMPLITUDE()
 
       (*(out+sample)) = amp;
 
-      outDownsampled += (*(out+sample));
+      m_outDownsampled += (*(out+sample));
    }
 
-   outDownsampled = (int32_t)((float)outDownsampled/((float)m_wave[0].GETDACSAMPLECOUNT()));
+   m_outDownsampled = (int32_t)((float)m_outDownsampled/((float)m_wave[0].GETDACSAMPLECOUNT()));
 
-   delta = outDownsampled - outLast;
-   outDownsampled = outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
+   delta = m_outDownsampled - m_outLast;
+   m_outDownsampled = m_outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
 
-   outLast = outDownsampled;
+   m_outLast = m_outDownsampled;
 
    // Reset DAC averaging...
    m_wave[0].CLEARDACAVG();
@@ -622,5 +658,5 @@ uint16_t CROMMapper019::AMPLITUDE()
    m_wave[6].CLEARDACAVG();
    m_wave[7].CLEARDACAVG();
 
-   return outDownsampled;
+   return m_outDownsampled;
 }
@@ -63,6 +63,7 @@ struct N106WaveChannel
       }
    }
    void TIMERTICK(uint8_t enabled);
+   void SERIALIZE(CNESSaveState* state);
    void SETDAC(uint8_t value)
    {
       dacAverage[dacSamples] = value;
@@ -86,19 +87,19 @@ struct N106WaveChannel
 class CROMMapper019 : public CROM
 {
 private:
-   CROMMapper019();
+   CROMMapper019(CNES* pNES);
 public:
-   static inline CROMMapper019* CARTFACTORY() { return new CROMMapper019(); }
+   static inline CROMMapper019* CARTFACTORY(CNES* pNES) { return new CROMMapper019(pNES); }
    virtual ~CROMMapper019();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    uint32_t LMAPPER ( uint32_t addr );
    void LMAPPER ( uint32_t addr, uint8_t data );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
    uint16_t AMPLITUDE ( void );
-   static void SOUNDENABLE ( uint32_t mask ) { m_soundEnableMask = mask; }
 
 protected:
    // N106
@@ -109,8 +110,8 @@ protected:
 
    // N106 sound
    N106WaveChannel m_wave[8];
-
-   static uint32_t  m_soundEnableMask;
+   int16_t  m_outLast;
+   int32_t  m_outDownsampled;
 
    uint8_t m_soundRAM[128];
    uint8_t m_soundRAMAddr;
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper022.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -75,11 +76,11 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,19,19,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper022::CROMMapper022()
-   : CROM(22)
+CROMMapper022::CROMMapper022(CNES* pNES)
+   : CROM(pNES,22)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
    memset(m_reg,0,sizeof(m_reg));
@@ -103,6 +104,16 @@ void CROMMapper022::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper022::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_chr );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper022::DEBUGINFO ( uint32_t addr )
 {
    switch ( addr )
@@ -200,16 +211,16 @@ void CROMMapper022::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( data&0x03 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       case 2:
-         CNES::NES()->PPU()->MIRROR(0,0,0,0);
+         NES()->PPU()->MIRROR(0,0,0,0);
          break;
       case 3:
-         CNES::NES()->PPU()->MIRROR(1,1,1,1);
+         NES()->PPU()->MIRROR(1,1,1,1);
          break;
       }
       break;
@@ -335,9 +346,9 @@ void CROMMapper022::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
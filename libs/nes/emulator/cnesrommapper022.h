@@ -6,12 +6,13 @@
 class CROMMapper022 : public CROM
 {
 private:
-   CROMMapper022();
+   CROMMapper022(CNES* pNES);
 public:
-   static inline CROMMapper022* CARTFACTORY() { return new CROMMapper022(); }
+   static inline CROMMapper022* CARTFACTORY(CNES* pNES) { return new CROMMapper022(pNES); }
    virtual ~CROMMapper022();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
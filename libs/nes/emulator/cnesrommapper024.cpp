@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper024.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -127,19 +128,20 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,23,23,tblRegisters,rowHeadings,columnHeadings);
 
-uint32_t CROMMapper024::m_soundEnableMask = 0xffffffff;
-
-CROMMapper024::CROMMapper024()
-   : CROM(24)
+CROMMapper024::CROMMapper024(CNES* pNES)
+   : CROM(pNES,24)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
+   m_syncCaps = SYNC_CPU_CYCLE;
    memset(m_reg,0,sizeof(m_reg));
    m_irqReload = 0;
    m_irqCounter = 0;
    m_irqPrescaler = 0;
    m_irqPrescalerPhase = 0;
    m_irqEnabled = false;
+   m_outLast = 0;
+   m_outDownsampled = 0;
 }
 
 CROMMapper024::~CROMMapper024()
@@ -170,6 +172,26 @@ void CROMMapper024::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper024::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_chr );
+   state->VALUE ( m_irqReload );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqPrescaler );
+   state->VALUE ( m_irqPrescalerPhase );
+   state->VALUE ( m_irqEnabled );
+   state->VALUE ( m_outLast );
+   state->VALUE ( m_outDownsampled );
+   m_pulse[0].SERIALIZE ( state );
+   m_pulse[1].SERIALIZE ( state );
+   m_sawtooth.SERIALIZE ( state );
+   state->ENDCHUNK ();
+}
+
 void CROMMapper024::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
 {
    uint8_t phases[3] = { 114, 114, 113 };
@@ -186,12 +208,12 @@ void CROMMapper024::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
          if ( m_irqCounter == 0xFF )
          {
             m_irqCounter = m_irqReload;
-            CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+            NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-            if ( nesIsDebuggable )
+            if ( NES()->DEBUGGABLE() )
             {
                // Check for IRQ breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+               NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
             }
          }
          else
@@ -212,12 +234,12 @@ void CROMMapper024::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
             if ( m_irqCounter == 0xFF )
             {
                m_irqCounter = m_irqReload;
-               CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+               NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-               if ( nesIsDebuggable )
+               if ( NES()->DEBUGGABLE() )
                {
                   // Check for IRQ breakpoint...
-                  CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+                  NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
                }
             }
             else
@@ -378,16 +400,16 @@ void CROMMapper024::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( (data&0x0C)>>2 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       case 2:
-         CNES::NES()->PPU()->MIRROR(0,0,0,0);
+         NES()->PPU()->MIRROR(0,0,0,0);
          break;
       case 3:
-         CNES::NES()->PPU()->MIRROR(1,1,1,1);
+         NES()->PPU()->MIRROR(1,1,1,1);
          break;
       }
       break;
@@ -455,7 +477,7 @@ void CROMMapper024::HMAPPER ( uint32_t addr, uint8_t data )
    case 0xF001:
       reg = 21;
       m_reg[21] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       if ( m_reg[21]&0x02 )
       {
          m_irqCounter = m_irqReload;
@@ -471,7 +493,7 @@ void CROMMapper024::HMAPPER ( uint32_t addr, uint8_t data )
    case 0xF002:
       reg = 22;
       m_reg[22] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       m_reg[21] &= 0xFD;
       m_reg[21] |= ((m_reg[21]&0x01)<<1);
       if ( m_reg[21]&0x02 )
@@ -485,13 +507,27 @@ void CROMMapper024::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable && (reg != 0xFFFFFFFF) )
+   if ( NES()->DEBUGGABLE() && (reg != 0xFFFFFFFF) )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
 
+void VRC6PulseChannel::SERIALIZE(CNESSaveState* state)
+{
+   state->VALUE ( mode );
+   state->VALUE ( dutyCycle );
+   state->VALUE ( volume );
+   state->VALUE ( period );
+   state->VALUE ( periodCounter );
+   state->VALUE ( sequencerStep );
+   state->VALUE ( enabled );
+   state->VALUE ( dacAverage );
+   state->VALUE ( dac );
+   state->VALUE ( dacSamples );
+}
+
 void VRC6PulseChannel::TIMERTICK()
 {
    if ( periodCounter )
@@ -530,6 +566,20 @@ void VRC6PulseChannel::TIMERTICK()
    }
 }
 
+void VRC6SawtoothChannel::SERIALIZE(CNESSaveState* state)
+{
+   state->VALUE ( accumulator );
+   state->VALUE ( accumulatorRate );
+   state->VALUE ( accumulatorCount );
+   state->VALUE ( accumulatorDivider );
+   state->VALUE ( period );
+   state->VALUE ( periodCounter );
+   state->VALUE ( enabled );
+   state->VALUE ( dacAverage );
+   state->VALUE ( dac );
+   state->VALUE ( dacSamples );
+}
+
 void VRC6SawtoothChannel::TIMERTICK()
 {
    if ( periodCounter )
@@ -572,16 +622,14 @@ uint16_t CROMMapper024::AMPLITUDE()
    int16_t amp;
    int16_t delta;
    int16_t out[100] = { 0, };
-   static int16_t outLast = 0;
    uint8_t sample;
    uint8_t* p1dacSamples = m_pulse[0].GETDACSAMPLES();
    uint8_t* p2dacSamples = m_pulse[1].GETDACSAMPLES();
    uint8_t* sdacSamples = m_sawtooth.GETDACSAMPLES();
-   static int32_t outDownsampled = 0;
 
-   m_pulse[0].muted = !(m_soundEnableMask&0x01);
-   m_pulse[1].muted = !(m_soundEnableMask&0x02);
-   m_sawtooth.muted = !(m_soundEnableMask&0x04);
+   m_pulse[0].muted = !(NES()->VRC6AUDIOMASK()&0x01);
+   m_pulse[1].muted = !(NES()->VRC6AUDIOMASK()&0x02);
+   m_sawtooth.muted = !(NES()->VRC6AUDIOMASK()&0x04);
 
    for ( sample = 0; sample < m_pulse[0].GETDACSAMPLECOUNT(); sample++ )
    {
@@ -594,20 +642,20 @@ uint16_t CROMMapper024::AMPLITUDE()
 
       (*(out+sample)) = amp;
 
-      outDownsampled += (*(out+sample));
+      m_outDownsampled += (*(out+sample));
    }
 
-   outDownsampled = (int32_t)((float)outDownsampled/((float)m_pulse[0].GETDACSAMPLECOUNT()));
+   m_outDownsampled = (int32_t)((float)m_outDownsampled/((float)m_pulse[0].GETDACSAMPLECOUNT()));
 
-   delta = outDownsampled - outLast;
-   outDownsampled = outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
+   delta = m_outDownsampled - m_outLast;
+   m_outDownsampled = m_outLast+((delta*65371)/65536); // 65371/65536 is 0.9975 adjusted to 16-bit fixed point.
 
-   outLast = outDownsampled;
+   m_outLast = m_outDownsampled;
 
    // Reset DAC averaging...
    m_pulse[0].CLEARDACAVG();
    m_pulse[1].CLEARDACAVG();
    m_sawtooth.CLEARDACAVG();
 
-   return outDownsampled;
+   return m_outDownsampled;
 }
@@ -54,6 +54,7 @@ struct VRC6PulseChannel
       }
    }
    void TIMERTICK();
+   void SERIALIZE(CNESSaveState* state);
    void SETDAC(uint8_t value)
    {
       dacAverage[dacSamples] = value;
@@ -123,6 +124,7 @@ struct VRC6SawtoothChannel
       }
    }
    void TIMERTICK();
+   void SERIALIZE(CNESSaveState* state);
    void SETDAC(uint8_t value)
    {
       dacAverage[dacSamples] = value;
@@ -146,19 +148,18 @@ struct VRC6SawtoothChannel
 class CROMMapper024 : public CROM
 {
 protected:
-   CROMMapper024();
+   CROMMapper024(CNES* pNES);
 public:
-   static inline CROMMapper024* CARTFACTORY() { return new CROMMapper024(); }
+   static inline CROMMapper024* CARTFACTORY(CNES* pNES) { return new CROMMapper024(pNES); }
    virtual ~CROMMapper024();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
    uint16_t AMPLITUDE ( void );
 
-   static void SOUNDENABLE(uint32_t mask) { m_soundEnableMask = mask; }
-
 protected:
    // VRC6
    uint8_t  m_reg [ 23 ];
@@ -169,11 +170,11 @@ protected:
    uint8_t  m_irqPrescalerPhase;
    bool     m_irqEnabled;
 
-   static uint32_t  m_soundEnableMask;
-
    // VRC6 sound
    VRC6PulseChannel m_pulse[2];
    VRC6SawtoothChannel m_sawtooth;
+   int16_t  m_outLast;
+   int32_t  m_outDownsampled;
 };
 
 #endif
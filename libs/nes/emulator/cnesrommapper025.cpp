@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper025.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -135,20 +136,16 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,2,24,48,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper025::CROMMapper025()
-   : CROM(25)
+CROMMapper025::CROMMapper025(CNES* pNES)
+   : CROM(pNES,25),
+     m_irq(pNES)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
    memset(m_reg,0,sizeof(m_reg));
    memset(m_chr,0,sizeof(m_chr));
-   m_irqReload = 0;
-   m_irqCounter = 0;
-   m_irqPrescaler = 0;
-   m_irqPrescalerPhase = 0;
-   m_irqEnabled = false;
 }
 
 CROMMapper025::~CROMMapper025()
@@ -163,11 +160,7 @@ void CROMMapper025::RESET ( bool soft )
 
    CROM::RESET ( soft );
 
-   m_irqReload = 0;
-   m_irqCounter = 0;
-   m_irqPrescaler = 0;
-   m_irqPrescalerPhase = 0;
-   m_irqEnabled = false;
+   m_irq.RESET();
 
    m_PRGROMmemory.REMAP(2,m_numPrgBanks-2);
    m_PRGROMmemory.REMAP(3,m_numPrgBanks-1);
@@ -175,61 +168,40 @@ void CROMMapper025::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper025::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
+void CROMMapper025::SERIALIZE ( CNESSaveState* state )
 {
-   uint8_t phases[3] = { 114, 114, 113 };
+   CROM::SERIALIZE ( state );
 
-   if ( m_reg[21]&0x02 )
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
    {
-      if ( m_reg[21]&0x04 )
-      {
-         // Cycle mode counter
-         if ( m_irqCounter == 0xFF )
-         {
-            m_irqCounter = m_irqReload;
-            CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
-
-            if ( nesIsDebuggable )
-            {
-               // Check for IRQ breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
-            }
-         }
-         else
-         {
-            m_irqCounter++;
-         }
-      }
-      else
-      {
-         // Scanline mode counter
-         m_irqPrescaler++;
-         if ( m_irqPrescaler >= phases[m_irqPrescalerPhase] )
-         {
-            m_irqPrescaler = 0;
-            m_irqPrescalerPhase++;
-            m_irqPrescalerPhase %= 3;
-
-            if ( m_irqCounter == 0xFF )
-            {
-               m_irqCounter = m_irqReload;
-               CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
-
-               if ( nesIsDebuggable )
-               {
-                  // Check for IRQ breakpoint...
-                  CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
-               }
-            }
-            else
-            {
-               m_irqCounter++;
-            }
-         }
-      }
+      m_irq.SYNC ( NES()->CPU()->_CYCLES(), m_reg[21] );
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_chr );
+   m_irq.SERIALIZE ( state );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
    }
 }
 
+void CROMMapper025::RESCHEDULE ( void )
+{
+   m_irq.RESCHEDULE ( m_reg[21] );
+}
+
+void CROMMapper025::CPUEVENT ( void )
+{
+   m_irq.SYNC ( NES()->CPU()->_CYCLES(), m_reg[21] );
+   m_irq.SCHEDULE ( m_reg[21] );
+}
+
 uint32_t CROMMapper025::DEBUGINFO ( uint32_t addr )
 {
    switch ( addr )
@@ -346,6 +318,9 @@ void CROMMapper025::HMAPPER ( uint32_t addr, uint8_t data )
 {
    uint32_t reg = 0;
 
+   // The counter has counted up to, but not including, this cycle.
+   m_irq.SYNC ( NES()->CPU()->_CYCLES()-1, m_reg[21] );
+
    switch ( addr )
    {
    case 0x8000:
@@ -376,16 +351,16 @@ void CROMMapper025::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( data&0x03 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       case 2:
-         CNES::NES()->PPU()->MIRROR(0,0,0,0);
+         NES()->PPU()->MIRROR(0,0,0,0);
          break;
       case 3:
-         CNES::NES()->PPU()->MIRROR(1,1,1,1);
+         NES()->PPU()->MIRROR(1,1,1,1);
          break;
       }
       break;
@@ -542,54 +517,33 @@ void CROMMapper025::HMAPPER ( uint32_t addr, uint8_t data )
    case 0xF000:
       reg = 20;
       m_reg[20] = data;
-      m_irqReload &= 0xF0;
-      m_irqReload |= (data&0x0F);
+      m_irq.LATCHLOW ( data );
       break;
    case 0xF001:
    case 0xF004:
       reg = 21;
       m_reg[21] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
-      if ( m_reg[21]&0x02 )
-      {
-         m_irqCounter = m_irqReload;
-         m_irqPrescaler = 0;
-         m_irqPrescalerPhase = 0;
-         m_irqEnabled = true;
-      }
-      else
-      {
-         m_irqEnabled = false;
-      }
+      m_irq.CONTROL ( m_reg[21] );
       break;
    case 0xF002:
    case 0xF008:
       reg = 22;
       m_reg[22] = data;
-      m_irqReload &= 0x0F;
-      m_irqReload |= (data<<4);
+      m_irq.LATCHHIGH ( data );
       break;
    case 0xF003:
    case 0xF00C:
       reg = 23;
       m_reg[23] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
-      m_reg[21] &= 0xFD;
-      m_reg[21] |= ((m_reg[21]&0x01)<<1);
-      if ( m_reg[21]&0x02 )
-      {
-         m_irqEnabled = true;
-      }
-      else
-      {
-         m_irqEnabled = false;
-      }
+      m_irq.ACKNOWLEDGE ( &m_reg[21] );
       break;
    }
 
-   if ( nesIsDebuggable )
+   m_irq.SCHEDULE ( m_reg[21] );
+
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
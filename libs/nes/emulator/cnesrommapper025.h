@@ -2,29 +2,28 @@
 #define ROM_MAPPER025_H
 
 #include "cnesrom.h"
+#include "cnesvrcirq.h"
 
 class CROMMapper025 : public CROM
 {
 private:
-   CROMMapper025();
+   CROMMapper025(CNES* pNES);
 public:
-   static inline CROMMapper025* CARTFACTORY() { return new CROMMapper025(); }
+   static inline CROMMapper025* CARTFACTORY(CNES* pNES) { return new CROMMapper025(pNES); }
    virtual ~CROMMapper025();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
+   void CPUEVENT ( void );
+   void RESCHEDULE ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
 
 protected:
    // VRC2
    uint8_t  m_reg [ 24 ];
    uint8_t  m_chr [ 8 ];
-   uint8_t  m_irqReload;
-   uint8_t  m_irqCounter;
-   uint8_t  m_irqPrescaler;
-   uint8_t  m_irqPrescalerPhase;
-   bool     m_irqEnabled;
+   CVRCIRQ  m_irq;
 };
 
 #endif
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper026.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -127,7 +128,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,23,23,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper026::CROMMapper026()
+CROMMapper026::CROMMapper026(CNES* pNES)
+   : CROMMapper024(pNES)
 {
    m_mapper = 26;
    m_prgRemappable = true;
@@ -168,6 +170,21 @@ void CROMMapper026::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper026::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_chr );
+   state->VALUE ( m_irqReload );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqPrescaler );
+   state->VALUE ( m_irqPrescalerPhase );
+   state->VALUE ( m_irqEnabled );
+   state->ENDCHUNK ();
+}
+
 void CROMMapper026::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
 {
    uint8_t phases[3] = { 114, 114, 113 };
@@ -184,12 +201,12 @@ void CROMMapper026::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
          if ( m_irqCounter == 0xFF )
          {
             m_irqCounter = m_irqReload;
-            CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+            NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-            if ( nesIsDebuggable )
+            if ( NES()->DEBUGGABLE() )
             {
                // Check for IRQ breakpoint...
-               CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+               NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
             }
          }
          else
@@ -210,12 +227,12 @@ void CROMMapper026::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
             if ( m_irqCounter == 0xFF )
             {
                m_irqCounter = m_irqReload;
-               CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+               NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
 
-               if ( nesIsDebuggable )
+               if ( NES()->DEBUGGABLE() )
                {
                   // Check for IRQ breakpoint...
-                  CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+                  NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
                }
             }
             else
@@ -376,16 +393,16 @@ void CROMMapper026::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( (data&0x0C)>>2 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       case 2:
-         CNES::NES()->PPU()->MIRROR(0,0,0,0);
+         NES()->PPU()->MIRROR(0,0,0,0);
          break;
       case 3:
-         CNES::NES()->PPU()->MIRROR(1,1,1,1);
+         NES()->PPU()->MIRROR(1,1,1,1);
          break;
       }
       break;
@@ -453,7 +470,7 @@ void CROMMapper026::HMAPPER ( uint32_t addr, uint8_t data )
    case 0xF001:
       reg = 21;
       m_reg[21] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       m_reg[22] &= 0xFD;
       m_reg[22] |= ((m_reg[21]&0x01)<<1);
       if ( m_reg[22]&0x02 )
@@ -468,7 +485,7 @@ void CROMMapper026::HMAPPER ( uint32_t addr, uint8_t data )
    case 0xF002:
       reg = 22;
       m_reg[22] = data;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       if ( m_reg[21]&0x02 )
       {
          m_irqCounter = m_irqReload;
@@ -483,9 +500,9 @@ void CROMMapper026::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper026 : public CROMMapper024
 {
 private:
-   CROMMapper026();
+   CROMMapper026(CNES* pNES);
 public:
-   static inline CROMMapper026* CARTFACTORY() { return new CROMMapper026(); }
+   static inline CROMMapper026* CARTFACTORY(CNES* pNES) { return new CROMMapper026(pNES); }
    virtual ~CROMMapper026();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
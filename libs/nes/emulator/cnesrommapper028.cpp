@@ -15,12 +15,13 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper028.h"
+#include "cnessavestate.h"
 
 #include "cnes6502.h"
 #include "cnesppu.h"
 
-CROMMapper028::CROMMapper028()
-   : CROM(28)
+CROMMapper028::CROMMapper028(CNES* pNES)
+   : CROM(pNES,28)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
@@ -77,6 +78,22 @@ void CROMMapper028::RESET ( bool soft )
    }
 }
 
+void CROMMapper028::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg_sel );
+   state->VALUE ( m_chr_bank );
+   state->VALUE ( m_prg_inner_bank );
+   state->VALUE ( m_prg_size );
+   state->VALUE ( m_prg_mode );
+   state->VALUE ( m_mirror );
+   state->VALUE ( m_prg_outer_bank );
+   state->VALUE ( m_bank_size_mask );
+   state->ENDCHUNK ();
+}
+
 void CROMMapper028::SETCPU ( void )
 {
    uint8_t bank[2];
@@ -132,19 +149,19 @@ void CROMMapper028::SETPPU ( void )
 {
    if ( m_mirror == 0 )
    {
-      CNES::NES()->PPU()->MIRROR(0,0,0,0);
+      NES()->PPU()->MIRROR(0,0,0,0);
    }
    else if ( m_mirror == 1 )
    {
-      CNES::NES()->PPU()->MIRROR(1,1,1,1);
+      NES()->PPU()->MIRROR(1,1,1,1);
    }
    else if ( m_mirror == 2 )
    {
-      CNES::NES()->PPU()->MIRRORVERT();
+      NES()->PPU()->MIRRORVERT();
    }
    else if ( m_mirror == 3 )
    {
-      CNES::NES()->PPU()->MIRRORHORIZ();
+      NES()->PPU()->MIRRORHORIZ();
    }
 
    m_CHRmemory.REMAP(0,((m_chr_bank)<<3)+0);
@@ -6,12 +6,13 @@
 class CROMMapper028 : public CROM
 {
 private:
-   CROMMapper028();
+   CROMMapper028(CNES* pNES);
 public:
-   static inline CROMMapper028* CARTFACTORY() { return new CROMMapper028(); }
+   static inline CROMMapper028* CARTFACTORY(CNES* pNES) { return new CROMMapper028(pNES); }
    virtual ~CROMMapper028();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t LMAPPER ( uint32_t addr );
    void LMAPPER ( uint32_t addr, uint8_t data );
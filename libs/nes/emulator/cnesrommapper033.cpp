@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper033.h"
+#include "cnessavestate.h"
 #include "cnesppu.h"
 
 #include "cregisterdata.h"
@@ -85,8 +86,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,8,8,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper033::CROMMapper033()
-   : CROM(33)
+CROMMapper033::CROMMapper033(CNES* pNES)
+   : CROM(pNES,33)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
@@ -111,6 +112,15 @@ void CROMMapper033::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper033::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper033::DEBUGINFO ( uint32_t addr )
 {
    switch ( addr&0xA003 )
@@ -153,11 +163,11 @@ void CROMMapper033::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[0] = data;
       if ( m_reg[0]&0x40 )
       {
-         CNES::NES()->PPU()->MIRRORHORIZ ();
+         NES()->PPU()->MIRRORHORIZ ();
       }
       else
       {
-         CNES::NES()->PPU()->MIRRORVERT ();
+         NES()->PPU()->MIRRORVERT ();
       }
       bank = (m_reg[0]&0x3F)%m_numPrgBanks;
       m_PRGROMmemory.REMAP(0,bank);
@@ -195,9 +205,9 @@ void CROMMapper033::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper033 : public CROM
 {
 private:
-   CROMMapper033();
+   CROMMapper033(CNES* pNES);
 public:
-   static inline CROMMapper033* CARTFACTORY() { return new CROMMapper033(); }
+   static inline CROMMapper033* CARTFACTORY(CNES* pNES) { return new CROMMapper033(pNES); }
    virtual ~CROMMapper033();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper034.h"
+#include "cnessavestate.h"
 
 #include "cregisterdata.h"
 
@@ -62,8 +63,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,4,4,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper034::CROMMapper034()
-   : CROM(34)
+CROMMapper034::CROMMapper034(CNES* pNES)
+   : CROM(pNES,34)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
@@ -86,6 +87,15 @@ void CROMMapper034::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper034::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper034::LMAPPER ( uint32_t addr )
 {
    if ( (addr >= 0x7ffd) && (addr < 0x8000) )
@@ -135,10 +145,10 @@ void CROMMapper034::LMAPPER ( uint32_t addr, uint8_t data )
          break;
       }
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check mapper state breakpoints...
-         CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+         NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
       }
    }
    else if ( addr >= 0x6000 )
@@ -165,9 +175,9 @@ void CROMMapper034::HMAPPER ( uint32_t addr, uint8_t data )
    m_PRGROMmemory.REMAP(2,bank+2);
    m_PRGROMmemory.REMAP(3,bank+3);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper034 : public CROM
 {
 private:
-   CROMMapper034();
+   CROMMapper034(CNES* pNES);
 public:
-   static inline CROMMapper034* CARTFACTORY() { return new CROMMapper034(); }
+   static inline CROMMapper034* CARTFACTORY(CNES* pNES) { return new CROMMapper034(pNES); }
    virtual ~CROMMapper034();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t LMAPPER ( uint32_t addr );
    void LMAPPER ( uint32_t addr, uint8_t data );
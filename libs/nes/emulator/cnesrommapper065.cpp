@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper065.h"
+#include "cnessavestate.h"
 
 #include "cnes6502.h"
 #include "cnesppu.h"
@@ -87,8 +88,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,16,16,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper065::CROMMapper065()
-   : CROM(65)
+CROMMapper065::CROMMapper065(CNES* pNES)
+   : CROM(pNES,65)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
@@ -97,6 +98,7 @@ CROMMapper065::CROMMapper065()
    m_irqCounter = 0x00;
    m_irqEnable = false;
    m_irqReload = 0;
+   m_irqCycle = 0;
 }
 
 CROMMapper065::~CROMMapper065()
@@ -120,28 +122,87 @@ void CROMMapper065::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper065::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
+void CROMMapper065::SERIALIZE ( CNESSaveState* state )
 {
+   CROM::SERIALIZE ( state );
+
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
+   {
+      IRQSYNC ( NES()->CPU()->_CYCLES() );
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqEnable );
+   state->VALUE ( m_irqReload );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
+   }
+}
+
+void CROMMapper065::RESCHEDULE ( void )
+{
+   m_irqCycle = NES()->CPU()->_CYCLES();
+   IRQSCHEDULE ();
+}
+
+void CROMMapper065::IRQSYNC ( uint32_t cycle )
+{
+   uint32_t cycles = cycle-m_irqCycle;
+
+   if ( (int32_t)cycles <= 0 )
+   {
+      return;
+   }
+   m_irqCycle = cycle;
+
+   // The counter counts down every CPU cycle while enabled and fires,
+   // disabling itself, on the cycle after it reaches zero.
    if ( m_irqEnable )
    {
-      if ( m_irqCounter == 0 )
+      if ( cycles > m_irqCounter )
       {
+         m_irqCounter = 0;
          m_irqEnable = false;
-         CNES::NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
+         NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
 
-         if ( nesIsDebuggable )
+         if ( NES()->DEBUGGABLE() )
          {
             // Check for IRQ breakpoint...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
          }
       }
       else
       {
-         m_irqCounter--;
+         m_irqCounter -= cycles;
       }
    }
 }
 
+void CROMMapper065::IRQSCHEDULE ( void )
+{
+   if ( m_irqEnable )
+   {
+      NES()->CPU()->SCHEDULE ( m_irqCycle+m_irqCounter+1 );
+   }
+   else
+   {
+      NES()->CPU()->UNSCHEDULE ();
+   }
+}
+
+void CROMMapper065::CPUEVENT ( void )
+{
+   IRQSYNC ( NES()->CPU()->_CYCLES() );
+   IRQSCHEDULE ();
+}
+
 uint32_t CROMMapper065::DEBUGINFO ( uint32_t addr )
 {
    switch ( addr )
@@ -201,6 +262,9 @@ uint32_t CROMMapper065::DEBUGINFO ( uint32_t addr )
 
 void CROMMapper065::HMAPPER ( uint32_t addr, uint8_t data )
 {
+   // The counter has counted up to, but not including, this cycle.
+   IRQSYNC ( NES()->CPU()->_CYCLES()-1 );
+
    switch ( addr )
    {
       case 0x8000:
@@ -211,11 +275,11 @@ void CROMMapper065::HMAPPER ( uint32_t addr, uint8_t data )
          m_reg [ 1 ] = data;
          if ( data&0x80 )
          {
-            CNES::NES()->PPU()->MIRRORHORIZ();
+            NES()->PPU()->MIRRORHORIZ();
          }
          else
          {
-            CNES::NES()->PPU()->MIRRORVERT();
+            NES()->PPU()->MIRRORVERT();
          }
          break;
       case 0x9003:
@@ -277,4 +341,6 @@ void CROMMapper065::HMAPPER ( uint32_t addr, uint8_t data )
          m_PRGROMmemory.REMAP(2,data);
          break;
    }
+
+   IRQSCHEDULE ();
 }
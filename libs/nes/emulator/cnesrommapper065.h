@@ -6,22 +6,30 @@
 class CROMMapper065 : public CROM
 {
 private:
-   CROMMapper065();
+   CROMMapper065(CNES* pNES);
 public:
-   static inline CROMMapper065* CARTFACTORY() { return new CROMMapper065(); }
+   static inline CROMMapper065* CARTFACTORY(CNES* pNES) { return new CROMMapper065(pNES); }
    virtual ~CROMMapper065();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
+   void CPUEVENT ( void );
+   void RESCHEDULE ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
 
 protected:
+   // The IRQ counter is brought up to date from the CPU cycle it was last
+   // brought up to date at only when something needs it.
+   void IRQSYNC ( uint32_t cycle );
+   void IRQSCHEDULE ( void );
+
    // Irem H-3001
    uint8_t  m_reg [ 16 ];
    uint8_t  m_irqCounter;
    bool           m_irqEnable;
    uint16_t m_irqReload;
+   uint32_t m_irqCycle;
 };
 
 #endif
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper068.h"
+#include "cnessavestate.h"
 
 #include "cnesppu.h"
 
@@ -65,11 +66,11 @@ static const char* columnHeadings [] =
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,8,8,tblRegisters,rowHeadings,columnHeadings);
 
 // Sunsoft Mapper #4 stuff
-CROMMapper068::CROMMapper068()
-   : CROM(68)
+CROMMapper068::CROMMapper068(CNES* pNES)
+   : CROM(pNES,68)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
    memset(m_reg,0,sizeof(m_reg));
@@ -100,6 +101,15 @@ void CROMMapper068::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper068::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper068::DEBUGINFO ( uint32_t addr )
 {
    switch ( addr&0xF000 )
@@ -164,16 +174,16 @@ void CROMMapper068::HMAPPER ( uint32_t addr, uint8_t data )
          switch ( m_reg[6]&0x01 )
          {
          case 0:
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_CHRmemory.PHYSBANK(m_reg[5]) );
             break;
          case 1:
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_CHRmemory.PHYSBANK(m_reg[5]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x2, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x3, m_CHRmemory.PHYSBANK(m_reg[5]) );
             break;
          }
       }
@@ -182,10 +192,10 @@ void CROMMapper068::HMAPPER ( uint32_t addr, uint8_t data )
          switch ( m_reg[6]&0x01 )
          {
             case 0:
-               CNES::NES()->PPU()->MIRRORVERT ();
+               NES()->PPU()->MIRRORVERT ();
                break;
             case 1:
-               CNES::NES()->PPU()->MIRRORHORIZ ();
+               NES()->PPU()->MIRRORHORIZ ();
                break;
          }
       }
@@ -199,16 +209,16 @@ void CROMMapper068::HMAPPER ( uint32_t addr, uint8_t data )
          switch ( m_reg[6]&0x01 )
          {
          case 0:
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
             break;
          case 1:
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[5]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
             break;
          }
       }
@@ -217,10 +227,10 @@ void CROMMapper068::HMAPPER ( uint32_t addr, uint8_t data )
          switch ( m_reg[6]&0x01 )
          {
             case 0:
-               CNES::NES()->PPU()->MIRRORVERT ();
+               NES()->PPU()->MIRRORVERT ();
                break;
             case 1:
-               CNES::NES()->PPU()->MIRRORHORIZ ();
+               NES()->PPU()->MIRRORHORIZ ();
                break;
          }
       }
@@ -234,16 +244,16 @@ void CROMMapper068::HMAPPER ( uint32_t addr, uint8_t data )
          switch ( m_reg[6]&0x01 )
          {
          case 0:
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
             break;
          case 1:
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[4]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[5]) );
-            CNES::NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[4]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x0, m_CHRmemory.PHYSBANK(m_reg[5]) );
+            NES()->PPU()->VRAM()->REMAPEXT ( 0x1, m_CHRmemory.PHYSBANK(m_reg[5]) );
             break;
          }
       }
@@ -252,10 +262,10 @@ void CROMMapper068::HMAPPER ( uint32_t addr, uint8_t data )
          switch ( m_reg[6]&0x01 )
          {
             case 0:
-               CNES::NES()->PPU()->MIRRORVERT ();
+               NES()->PPU()->MIRRORVERT ();
                break;
             case 1:
-               CNES::NES()->PPU()->MIRRORHORIZ ();
+               NES()->PPU()->MIRRORHORIZ ();
                break;
          }
       }
@@ -6,12 +6,13 @@
 class CROMMapper068 : public CROM
 {
 private:
-   CROMMapper068();
+   CROMMapper068(CNES* pNES);
 public:
-   static inline CROMMapper068* CARTFACTORY() { return new CROMMapper068(); }
+   static inline CROMMapper068* CARTFACTORY(CNES* pNES) { return new CROMMapper068(pNES); }
    virtual ~CROMMapper068();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper069.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -61,11 +62,11 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,4,4,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper069::CROMMapper069()
-   : CROM(69)
+CROMMapper069::CROMMapper069(CNES* pNES)
+   : CROM(pNES,69)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = true;
    memset(m_reg,0,sizeof(m_reg));
@@ -73,6 +74,7 @@ CROMMapper069::CROMMapper069()
    m_irqCounter = 0x0000;
    m_irqEnable = false;
    m_irqCountEnable = false;
+   m_irqCycle = 0;
    memset(m_prg,0,sizeof(m_prg));
    memset(m_chr,0,sizeof(m_chr));
    m_sramAreaIsSram = false;
@@ -120,28 +122,113 @@ void CROMMapper069::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper069::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
+void CROMMapper069::SERIALIZE ( CNESSaveState* state )
 {
-   uint32_t prevCounter = m_irqCounter;
+   CROM::SERIALIZE ( state );
 
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
+   {
+      IRQSYNC ( NES()->CPU()->_CYCLES() );
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_subReg );
+   state->VALUE ( m_irqAsserted );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqEnable );
+   state->VALUE ( m_irqCountEnable );
+   state->VALUE ( m_prg );
+   state->VALUE ( m_chr );
+   state->VALUE ( m_sramAreaIsSram );
+   state->VALUE ( m_sramAreaEnabled );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
+   }
+}
+
+void CROMMapper069::RESCHEDULE ( void )
+{
+   m_irqCycle = NES()->CPU()->_CYCLES();
+   IRQSCHEDULE ();
+}
+
+void CROMMapper069::IRQSYNC ( uint32_t cycle )
+{
+   uint32_t cycles = cycle-m_irqCycle;
+   bool     fire = false;
+
+   if ( (int32_t)cycles <= 0 )
+   {
+      return;
+   }
+   m_irqCycle = cycle;
+
+   // The IRQ fires on every cycle that starts with the counter at zero.
    if ( m_irqCountEnable )
    {
-      m_irqCounter--;
+      if ( m_irqEnable && (cycles > m_irqCounter) )
+      {
+         fire = true;
+      }
+      m_irqCounter -= cycles;
+   }
+   else if ( m_irqEnable && (!m_irqCounter) )
+   {
+      fire = true;
    }
 
-   if ( m_irqEnable && (!prevCounter) )
+   if ( fire )
    {
-      CNES::NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
+      NES()->CPU()->ASSERTIRQ ( eNESSource_Mapper );
       m_irqAsserted = true;
 
-      if ( nesIsDebuggable )
+      if ( NES()->DEBUGGABLE() )
       {
          // Check for IRQ breakpoint...
-         CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+         NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
       }
    }
 }
 
+void CROMMapper069::IRQSCHEDULE ( void )
+{
+   if ( m_irqEnable && m_irqCountEnable )
+   {
+      NES()->CPU()->SCHEDULE ( m_irqCycle+m_irqCounter+1 );
+   }
+   else if ( m_irqEnable && (!m_irqCounter) )
+   {
+      NES()->CPU()->SCHEDULE ( m_irqCycle+1 );
+   }
+   else
+   {
+      NES()->CPU()->UNSCHEDULE ();
+   }
+}
+
+void CROMMapper069::CPUEVENT ( void )
+{
+   IRQSYNC ( NES()->CPU()->_CYCLES() );
+   IRQSCHEDULE ();
+}
+
+uint32_t CROMMapper069::IRQCOUNTER ( void )
+{
+   uint32_t cycles = NES()->CPU()->_CYCLES()-m_irqCycle;
+
+   if ( m_irqCountEnable && ((int32_t)cycles > 0) )
+   {
+      return (uint16_t)(m_irqCounter-cycles);
+   }
+   return m_irqCounter;
+}
+
 void CROMMapper069::SETCPU ( void )
 {
    m_PRGROMmemory.REMAP(0,m_prg[1]);
@@ -170,6 +257,10 @@ uint32_t CROMMapper069::DEBUGINFO ( uint32_t addr )
 void CROMMapper069::HMAPPER ( uint32_t addr, uint8_t data )
 {
    int32_t reg = ((addr-0x8000)/MEM_8KB);
+
+   // The counter has counted up to, but not including, this cycle.
+   IRQSYNC ( NES()->CPU()->_CYCLES()-1 );
+
    m_reg [ reg ] = data;
 
    switch ( addr&0xE000 )
@@ -212,16 +303,16 @@ void CROMMapper069::HMAPPER ( uint32_t addr, uint8_t data )
                switch ( data )
                {
                case 0x00:
-                  CNES::NES()->PPU()->MIRRORVERT();
+                  NES()->PPU()->MIRRORVERT();
                   break;
                case 0x01:
-                  CNES::NES()->PPU()->MIRRORHORIZ();
+                  NES()->PPU()->MIRRORHORIZ();
                   break;
                case 0x02:
-                  CNES::NES()->PPU()->MIRROR(0,0,0,0);
+                  NES()->PPU()->MIRROR(0,0,0,0);
                   break;
                case 0x03:
-                  CNES::NES()->PPU()->MIRROR(1,1,1,1);
+                  NES()->PPU()->MIRROR(1,1,1,1);
                   break;
                }
                break;
@@ -230,7 +321,7 @@ void CROMMapper069::HMAPPER ( uint32_t addr, uint8_t data )
                if ( !m_irqEnable )
                {
                   m_irqAsserted = false;
-                  CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+                  NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
                }
                m_irqCountEnable = (data&0x80);
                break;
@@ -250,16 +341,18 @@ void CROMMapper069::HMAPPER ( uint32_t addr, uint8_t data )
          break;
    }
 
-   if ( nesIsDebuggable )
+   IRQSCHEDULE ();
+
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
 
 uint32_t CROMMapper069::LMAPPER ( uint32_t addr )
 {
-   uint8_t data = CNES::NES()->CPU()->OPENBUS();
+   uint8_t data = NES()->CPU()->OPENBUS();
 
    if ( addr >= 0x6000 )
    {
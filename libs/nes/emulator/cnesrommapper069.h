@@ -6,16 +6,18 @@
 class CROMMapper069 : public CROM
 {
 private:
-   CROMMapper069();
+   CROMMapper069(CNES* pNES);
 public:
-   static inline CROMMapper069* CARTFACTORY() { return new CROMMapper069(); }
+   static inline CROMMapper069* CARTFACTORY(CNES* pNES) { return new CROMMapper069(pNES); }
    virtual ~CROMMapper069();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    uint32_t LMAPPER ( uint32_t addr );
    void LMAPPER ( uint32_t addr, uint8_t data );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
+   void CPUEVENT ( void );
+   void RESCHEDULE ( void );
    void SETCPU ( void );
    void SETPPU ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
@@ -34,10 +36,7 @@ public:
    {
       return m_irqAsserted;
    }
-   uint32_t IRQCOUNTER ( void )
-   {
-      return m_irqCounter;
-   }
+   uint32_t IRQCOUNTER ( void );
    uint32_t SRAMENABLED ( void )
    {
       return m_sramAreaEnabled;
@@ -60,6 +59,11 @@ public:
    }
 
 protected:
+   // The IRQ counter is brought up to date from the CPU cycle it was last
+   // brought up to date at only when something needs it.
+   void IRQSYNC ( uint32_t cycle );
+   void IRQSCHEDULE ( void );
+
    // MMC3
    uint8_t  m_reg [ 4 ];
    uint8_t  m_subReg [ 16 ];
@@ -71,6 +75,7 @@ protected:
    uint8_t  m_chr [ 8 ];
    bool m_sramAreaIsSram;
    bool m_sramAreaEnabled;
+   uint32_t m_irqCycle;
 };
 
 #endif
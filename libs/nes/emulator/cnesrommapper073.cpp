@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper073.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -81,17 +82,18 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,7,7,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper073::CROMMapper073()
-   : CROM(73)
+CROMMapper073::CROMMapper073(CNES* pNES)
+   : CROM(pNES,73)
 {
    delete m_pSRAMmemory; // Remove open-bus default
-   m_pSRAMmemory = new CMEMORY(0x6000,MEM_8KB);
+   m_pSRAMmemory = new CMEMORY(pNES,0x6000,MEM_8KB);
    m_prgRemappable = true;
    m_chrRemappable = false;
    memset(m_reg,0,sizeof(m_reg));
    m_irqReload = 0;
    m_irqCounter = 0;
    m_irqEnabled = false;
+   m_irqCycle = 0;
 }
 
 CROMMapper073::~CROMMapper073()
@@ -116,45 +118,105 @@ void CROMMapper073::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
-void CROMMapper073::SYNCCPU ( bool write, uint16_t addr, uint8_t data )
+void CROMMapper073::SERIALIZE ( CNESSaveState* state )
 {
-   uint16_t counterMask;
-   uint16_t counter;
+   CROM::SERIALIZE ( state );
 
+   // The counter is saved as of now.  A loaded one is rescheduled from
+   // where it was saved instead.
+   if ( !state->LOADING() )
+   {
+      IRQSYNC ( NES()->CPU()->_CYCLES() );
+   }
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_irqReload );
+   state->VALUE ( m_irqCounter );
+   state->VALUE ( m_irqEnabled );
+   state->ENDCHUNK ();
+
+   if ( state->LOADING() )
+   {
+      RESCHEDULE ();
+   }
+}
+
+void CROMMapper073::RESCHEDULE ( void )
+{
+   m_irqCycle = NES()->CPU()->_CYCLES();
+   IRQSCHEDULE ();
+}
+
+void CROMMapper073::IRQSYNC ( uint32_t cycle )
+{
+   uint32_t cycles = cycle-m_irqCycle;
+   uint32_t counterMask = IRQCOUNTERMASK();
+   uint32_t counter;
+   uint32_t reload;
+
+   if ( (int32_t)cycles <= 0 )
+   {
+      return;
+   }
+   m_irqCycle = cycle;
+
+   // The relevant counter bits count up every CPU cycle while enabled
+   // and are reloaded, firing, when they wrap around to zero.
    if ( m_irqEnabled )
    {
-      // Get relevant counter bits.
-      if ( (m_reg[4]&0x04) == 0 )
+      counter = m_irqCounter&counterMask;
+      if ( cycles >= (counterMask+1)-counter )
       {
-         // 16 bits
-         counterMask = 0xFFFF;
+         reload = m_irqReload&counterMask;
+         cycles -= (counterMask+1)-counter;
+         counter = reload+(cycles%((counterMask+1)-reload));
+
+         NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+
+         if ( NES()->DEBUGGABLE() )
+         {
+            // Check for IRQ breakpoint...
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+         }
       }
       else
       {
-         // 8 bits
-         counterMask = 0x00FF;
+         counter += cycles;
       }
-
-      counter = m_irqCounter&counterMask;
-      counter++;
       m_irqCounter &= (~counterMask);
-      m_irqCounter |= (counter&counterMask);
+      m_irqCounter |= counter;
+   }
+}
 
-      if ( (m_irqCounter&counterMask) == 0 )
-      {
-         // Reload!
-         m_irqCounter &= (~counterMask);
-         m_irqCounter |= m_irqReload&counterMask;
+void CROMMapper073::IRQSCHEDULE ( void )
+{
+   if ( m_irqEnabled )
+   {
+      NES()->CPU()->SCHEDULE ( m_irqCycle+(IRQCOUNTERMASK()+1)-(m_irqCounter&IRQCOUNTERMASK()) );
+   }
+   else
+   {
+      NES()->CPU()->UNSCHEDULE ();
+   }
+}
 
-         CNES::NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+void CROMMapper073::CPUEVENT ( void )
+{
+   IRQSYNC ( NES()->CPU()->_CYCLES() );
+   IRQSCHEDULE ();
+}
 
-         if ( nesIsDebuggable )
-         {
-            // Check for IRQ breakpoint...
-            CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
-         }
-      }
+uint32_t CROMMapper073::IRQCOUNTERMASK ( void )
+{
+   // Get relevant counter bits.
+   if ( (m_reg[4]&0x04) == 0 )
+   {
+      // 16 bits
+      return 0xFFFF;
    }
+   // 8 bits
+   return 0x00FF;
 }
 
 uint32_t CROMMapper073::DEBUGINFO ( uint32_t addr )
@@ -190,6 +252,9 @@ void CROMMapper073::HMAPPER ( uint32_t addr, uint8_t data )
 {
    uint32_t reg = 0;
 
+   // The counter has counted up to, but not including, this cycle.
+   IRQSYNC ( NES()->CPU()->_CYCLES()-1 );
+
    switch ( addr )
    {
    case 0x8000:
@@ -221,7 +286,7 @@ void CROMMapper073::HMAPPER ( uint32_t addr, uint8_t data )
       m_reg[4] = data;
       m_irqCounter = m_irqReload;
       m_irqEnabled = data&0x02;
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    case 0xD000:
       reg = 5;
@@ -236,7 +301,7 @@ void CROMMapper073::HMAPPER ( uint32_t addr, uint8_t data )
       {
          m_irqEnabled = false;
       }
-      CNES::NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+      NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
       break;
    case 0xF000:
       reg = 6;
@@ -246,9 +311,11 @@ void CROMMapper073::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   IRQSCHEDULE ();
+
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
@@ -6,22 +6,31 @@
 class CROMMapper073 : public CROM
 {
 private:
-   CROMMapper073();
+   CROMMapper073(CNES* pNES);
 public:
-   static inline CROMMapper073* CARTFACTORY() { return new CROMMapper073(); }
+   static inline CROMMapper073* CARTFACTORY(CNES* pNES) { return new CROMMapper073(pNES); }
    virtual ~CROMMapper073();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
-   void SYNCCPU ( bool write, uint16_t addr, uint8_t data );
+   void CPUEVENT ( void );
+   void RESCHEDULE ( void );
    uint32_t DEBUGINFO ( uint32_t addr );
 
 protected:
+   // The IRQ counter is brought up to date from the CPU cycle it was last
+   // brought up to date at only when something needs it.
+   void IRQSYNC ( uint32_t cycle );
+   void IRQSCHEDULE ( void );
+   uint32_t IRQCOUNTERMASK ( void );
+
    // VRC3
    uint8_t  m_reg [ 7 ];
    uint16_t m_irqReload;
    uint16_t m_irqCounter;
    bool     m_irqEnabled;
+   uint32_t m_irqCycle;
 };
 
 #endif
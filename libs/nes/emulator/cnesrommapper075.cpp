@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper075.h"
+#include "cnessavestate.h"
 #include "cnes6502.h"
 #include "cnesppu.h"
 
@@ -61,8 +62,8 @@ static const char* columnHeadings [] =
 
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,4,4,tblRegisters,rowHeadings,columnHeadings);
 
-CROMMapper075::CROMMapper075()
-   : CROM(75)
+CROMMapper075::CROMMapper075(CNES* pNES)
+   : CROM(pNES,75)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
@@ -108,6 +109,17 @@ void CROMMapper075::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper075::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->VALUE ( m_prg );
+   state->VALUE ( m_chr );
+   state->ENDCHUNK ();
+}
+
 void CROMMapper075::SETCPU ( void )
 {
    m_PRGROMmemory.REMAP(0,m_prg[0]);
@@ -168,10 +180,10 @@ void CROMMapper075::HMAPPER ( uint32_t addr, uint8_t data )
       switch ( data&0x01 )
       {
       case 0:
-         CNES::NES()->PPU()->MIRRORVERT();
+         NES()->PPU()->MIRRORVERT();
          break;
       case 1:
-         CNES::NES()->PPU()->MIRRORHORIZ();
+         NES()->PPU()->MIRRORHORIZ();
          break;
       }
       break;
@@ -215,9 +227,9 @@ void CROMMapper075::HMAPPER ( uint32_t addr, uint8_t data )
       break;
    }
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,reg);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper075 : public CROM
 {
 private:
-   CROMMapper075();
+   CROMMapper075(CNES* pNES);
 public:
-   static inline CROMMapper075* CARTFACTORY() { return new CROMMapper075(); }
+   static inline CROMMapper075* CARTFACTORY(CNES* pNES) { return new CROMMapper075(pNES); }
    virtual ~CROMMapper075();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void HMAPPER ( uint32_t addr, uint8_t data );
    void SETCPU ( void );
    void SETPPU ( void );
@@ -15,6 +15,7 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "cnesrommapper111.h"
+#include "cnessavestate.h"
 
 #include "cregisterdata.h"
 
@@ -46,8 +47,8 @@ static const char* columnHeadings [] =
 static CRegisterDatabase* dbRegisters = new CRegisterDatabase(eMemory_cartMapper,1,1,1,tblRegisters,rowHeadings,columnHeadings);
 
 
-CROMMapper111::CROMMapper111()
-   : CROM(111)
+CROMMapper111::CROMMapper111(CNES* pNES)
+   : CROM(pNES,111)
 {
    m_prgRemappable = true;
    m_chrRemappable = true;
@@ -69,6 +70,15 @@ void CROMMapper111::RESET ( bool soft )
    // CHR ROM/RAM already set up in CROM::RESET()...
 }
 
+void CROMMapper111::SERIALIZE ( CNESSaveState* state )
+{
+   CROM::SERIALIZE ( state );
+
+   state->BEGINCHUNK ( "MAPR", 1 );
+   state->VALUE ( m_reg );
+   state->ENDCHUNK ();
+}
+
 uint32_t CROMMapper111::DEBUGINFO ( uint32_t addr )
 {
    return m_reg;
@@ -100,18 +110,18 @@ void CROMMapper111::LMAPPER ( uint32_t addr, uint8_t data )
 
    bank = (m_reg&0x20)>>2;
 
-   CNES::NES()->PPU()->VRAM()->REMAP(0,bank+0);
-   CNES::NES()->PPU()->VRAM()->REMAP(1,bank+1);
-   CNES::NES()->PPU()->VRAM()->REMAP(2,bank+2);
-   CNES::NES()->PPU()->VRAM()->REMAP(3,bank+3);
-   CNES::NES()->PPU()->VRAM()->REMAP(4,bank+4);
-   CNES::NES()->PPU()->VRAM()->REMAP(5,bank+5);
-   CNES::NES()->PPU()->VRAM()->REMAP(6,bank+6);
-   CNES::NES()->PPU()->VRAM()->REMAP(7,bank+7);
+   NES()->PPU()->VRAM()->REMAP(0,bank+0);
+   NES()->PPU()->VRAM()->REMAP(1,bank+1);
+   NES()->PPU()->VRAM()->REMAP(2,bank+2);
+   NES()->PPU()->VRAM()->REMAP(3,bank+3);
+   NES()->PPU()->VRAM()->REMAP(4,bank+4);
+   NES()->PPU()->VRAM()->REMAP(5,bank+5);
+   NES()->PPU()->VRAM()->REMAP(6,bank+6);
+   NES()->PPU()->VRAM()->REMAP(7,bank+7);
 
-   if ( nesIsDebuggable )
+   if ( NES()->DEBUGGABLE() )
    {
       // Check mapper state breakpoints...
-      CNES::NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
+      NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperState,0);
    }
 }
@@ -6,12 +6,13 @@
 class CROMMapper111 : public CROM
 {
 private:
-   CROMMapper111();
+   CROMMapper111(CNES* pNES);
 public:
-   static inline CROMMapper111* CARTFACTORY() { return new CROMMapper111(); }
+   static inline CROMMapper111* CARTFACTORY(CNES* pNES) { return new CROMMapper111(pNES); }
    virtual ~CROMMapper111();
 
    void RESET ( bool soft );
+   void SERIALIZE ( CNESSaveState* state );
    void LMAPPER ( uint32_t addr, uint8_t data );
    uint32_t DEBUGINFO ( uint32_t addr );
 
@@ -0,0 +1,289 @@
+//    NESICIDE - an IDE for the 8-bit NES.
+//    Copyright (C) 2009  Christopher S. Pow
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cnessavestate.h"
+#include "cmemory.h"
+
+#include <string.h>
+
+// Save state header:
+// 4 bytes magic, 2 bytes format version, 2 bytes reserved, 4 bytes total length.
+static const char SAVESTATE_MAGIC [] = "NESS";
+#define SAVESTATE_HEADER_SIZE 12
+
+// Chunk header:
+// 4 bytes tag, 2 bytes chunk version, 2 bytes reserved, 4 bytes data length.
+#define SAVESTATE_CHUNK_HEADER_SIZE 12
+
+CNESSaveState::CNESSaveState(uint8_t* buffer, uint32_t size, eSaveStateMode mode)
+   : m_buffer(buffer),
+     m_size(buffer?size:0),
+     m_mode(mode),
+     m_ok(true),
+     m_pos(0),
+     m_chunk(0),
+     m_chunkEnd(0),
+     m_numMemories(0)
+{
+}
+
+void CNESSaveState::BEGIN ( void )
+{
+   uint16_t version = SAVESTATE_VERSION;
+   uint16_t reserved = 0;
+   uint32_t length = 0;
+
+   m_pos = 0;
+   m_chunkEnd = m_size;
+   if ( SAVING() )
+   {
+      DATA((void*)SAVESTATE_MAGIC,4);
+      VALUE(version);
+      VALUE(reserved);
+      VALUE(length);
+      return;
+   }
+
+   if ( (m_size < SAVESTATE_HEADER_SIZE) ||
+        (memcmp(m_buffer,SAVESTATE_MAGIC,4)) )
+   {
+      m_ok = false;
+      return;
+   }
+   memcpy(&version,m_buffer+4,sizeof(version));
+   memcpy(&length,m_buffer+8,sizeof(length));
+   if ( (version != SAVESTATE_VERSION) ||
+        (length < SAVESTATE_HEADER_SIZE) ||
+        (length > m_size) )
+   {
+      m_ok = false;
+      return;
+   }
+
+   // Ignore anything in the buffer past the end of the state.
+   m_size = length;
+   m_pos = SAVESTATE_HEADER_SIZE;
+   m_chunkEnd = SAVESTATE_HEADER_SIZE;
+}
+
+void CNESSaveState::END ( void )
+{
+   // If the buffer is too small (or absent) nothing more is written but
+   // SIZE() still tells the caller how big it needs to be.
+   if ( SAVING() && (m_pos <= m_size) )
+   {
+      memcpy(m_buffer+8,&m_pos,sizeof(m_pos));
+   }
+}
+
+void CNESSaveState::BEGINCHUNK ( const char* tag, uint16_t version )
+{
+   uint16_t chunkVersion;
+   uint32_t length;
+   uint32_t start;
+   uint32_t pos;
+
+   if ( SAVING() )
+   {
+      uint16_t reserved = 0;
+
+      m_chunk = m_pos;
+      DATA((void*)tag,4);
+      VALUE(version);
+      VALUE(reserved);
+      length = 0;
+      VALUE(length);
+      return;
+   }
+
+   if ( (!m_ok) || (m_size < SAVESTATE_HEADER_SIZE+SAVESTATE_CHUNK_HEADER_SIZE) )
+   {
+      m_ok = false;
+      return;
+   }
+
+   // Chunks are nearly always found in the order they are asked for, so
+   // start looking at the end of the previous chunk and wrap around.
+   start = m_chunkEnd;
+   if ( start+SAVESTATE_CHUNK_HEADER_SIZE > m_size )
+   {
+      start = SAVESTATE_HEADER_SIZE;
+   }
+   pos = start;
+   do
+   {
+      memcpy(&chunkVersion,m_buffer+pos+4,sizeof(chunkVersion));
+      memcpy(&length,m_buffer+pos+8,sizeof(length));
+      if ( (length > m_size) ||
+           (pos+SAVESTATE_CHUNK_HEADER_SIZE+length > m_size) )
+      {
+         // Corrupt chunk framing.
+         break;
+      }
+      if ( !memcmp(m_buffer+pos,tag,4) )
+      {
+         if ( chunkVersion != version )
+         {
+            break;
+         }
+         m_chunk = pos;
+         m_pos = pos+SAVESTATE_CHUNK_HEADER_SIZE;
+         m_chunkEnd = m_pos+length;
+         return;
+      }
+      pos += SAVESTATE_CHUNK_HEADER_SIZE+length;
+      if ( pos+SAVESTATE_CHUNK_HEADER_SIZE > m_size )
+      {
+         pos = SAVESTATE_HEADER_SIZE;
+      }
+   } while ( pos != start );
+
+   // Chunk is missing or has a layout this build does not understand.
+   m_ok = false;
+}
+
+void CNESSaveState::ENDCHUNK ( void )
+{
+   uint32_t length;
+
+   if ( SAVING() )
+   {
+      length = m_pos-m_chunk-SAVESTATE_CHUNK_HEADER_SIZE;
+      if ( m_pos <= m_size )
+      {
+         memcpy(m_buffer+m_chunk+8,&length,sizeof(length));
+      }
+      return;
+   }
+
+   if ( m_pos != m_chunkEnd )
+   {
+      // The chunk has the right version but the wrong size, so it
+      // was written for a different cartridge configuration.
+      m_ok = false;
+   }
+}
+
+void CNESSaveState::DATA ( void* data, uint32_t size )
+{
+   if ( SAVING() )
+   {
+      if ( m_pos+size <= m_size )
+      {
+         memcpy(m_buffer+m_pos,data,size);
+      }
+      m_pos += size;
+      return;
+   }
+
+   if ( (!m_ok) || (m_pos+size > m_chunkEnd) )
+   {
+      m_ok = false;
+      return;
+   }
+   if ( LOADING() )
+   {
+      memcpy(data,m_buffer+m_pos,size);
+   }
+   m_pos += size;
+}
+
+bool CNESSaveState::PEEKDATA ( void* data, uint32_t size ) const
+{
+   if ( (!m_ok) || (m_pos+size > m_chunkEnd) )
+   {
+      return false;
+   }
+   memcpy(data,m_buffer+m_pos,size);
+   return true;
+}
+
+void CNESSaveState::CHECKDATA ( const void* data, uint32_t size )
+{
+   if ( SAVING() )
+   {
+      DATA((void*)data,size);
+      return;
+   }
+
+   if ( (!m_ok) ||
+        (m_pos+size > m_chunkEnd) ||
+        (memcmp(data,m_buffer+m_pos,size)) )
+   {
+      m_ok = false;
+      return;
+   }
+   m_pos += size;
+}
+
+void CNESSaveState::MEMORY ( CMEMORY* memory )
+{
+   if ( m_numMemories < SAVESTATE_MAX_MEMORIES )
+   {
+      m_memory[m_numMemories++] = memory;
+   }
+   else
+   {
+      m_ok = false;
+   }
+}
+
+void CNESSaveState::BANK ( CMEMORYBANK** ppBank )
+{
+   uint32_t ref = 0xFFFFFFFF;
+   uint32_t memory;
+   uint32_t bank;
+   int32_t  idx;
+
+   if ( SAVING() )
+   {
+      for ( idx = 0; idx < m_numMemories; idx++ )
+      {
+         if ( (*ppBank)->PARENT() == m_memory[idx] )
+         {
+            ref = (idx<<24)|(*ppBank)->BANKNUM();
+            break;
+         }
+      }
+      if ( ref == 0xFFFFFFFF )
+      {
+         // Bank belongs to a memory nobody registered.
+         m_ok = false;
+      }
+      VALUE(ref);
+      return;
+   }
+
+   if ( (!m_ok) || (m_pos+sizeof(ref) > m_chunkEnd) )
+   {
+      m_ok = false;
+      return;
+   }
+   memcpy(&ref,m_buffer+m_pos,sizeof(ref));
+   m_pos += sizeof(ref);
+   memory = ref>>24;
+   bank = ref&0x00FFFFFF;
+   if ( (memory >= (uint32_t)m_numMemories) ||
+        (bank >= m_memory[memory]->NUMPHYSBANKS()) )
+   {
+      m_ok = false;
+      return;
+   }
+   if ( LOADING() )
+   {
+      (*ppBank) = m_memory[memory]->PHYSBANK(bank);
+   }
+}
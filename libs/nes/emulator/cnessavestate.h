@@ -0,0 +1,115 @@
+#if !defined ( NESSAVESTATE_H )
+#define NESSAVESTATE_H
+
+#include <stdint.h>
+
+class CMEMORY;
+class CMEMORYBANK;
+
+// Save state format version.  This is bumped only when the layout of the
+// header or chunk framing changes; the layout of the data inside a chunk
+// is covered by that chunk's own version.
+#define SAVESTATE_VERSION 1
+
+// Maximum number of memories whose banks can be referenced by a
+// save state's memory maps.
+#define SAVESTATE_MAX_MEMORIES 8
+
+typedef enum
+{
+   eSaveState_Save = 0,
+   eSaveState_Verify,
+   eSaveState_Load
+} eSaveStateMode;
+
+// The CNESSaveState class moves the emulation state of a machine to or
+// from a flat buffer.  The same SERIALIZE method of each emulated object
+// is used in every mode so the save and load paths can never drift apart:
+//
+// eSaveState_Save copies state into the buffer.  If the buffer is NULL
+// or too small nothing is written past its end but SIZE() still reports
+// how big the state is.
+// eSaveState_Verify walks a buffer without changing anything so that a
+// state that does not belong to the machine is rejected before any of
+// the machine's state is overwritten.
+// eSaveState_Load copies state out of the buffer.
+//
+// A save state is a header followed by chunks.  Each chunk has a
+// four-character tag, a version, and a length so that the loader can
+// find the chunks it needs and reject any whose layout has changed.
+// Values are stored in host byte order; save states are meant for quick
+// save slots and rewind, not for archiving.
+class CNESSaveState
+{
+public:
+   CNESSaveState(uint8_t* buffer, uint32_t size, eSaveStateMode mode);
+
+   inline bool LOADING() const { return m_mode == eSaveState_Load; }
+   inline bool SAVING() const { return m_mode == eSaveState_Save; }
+   inline bool OK() const { return m_ok; }
+
+   // Size of the state in bytes once END has been called.
+   inline uint32_t SIZE() const { return m_pos; }
+
+   // Header and chunk framing.
+   void BEGIN ( void );
+   void END ( void );
+   void BEGINCHUNK ( const char* tag, uint16_t version );
+   void ENDCHUNK ( void );
+
+   // Moves raw data in the direction of the current mode.
+   void DATA ( void* data, uint32_t size );
+   template<typename T> inline void VALUE ( T& value )
+   {
+      DATA(&value,sizeof(T));
+   }
+
+   // Moves a value that something is looked up by, rejecting the state
+   // when reading if the saved value is not between lo and hi.
+   template<typename T> inline void RANGE ( T& value, T lo, T hi )
+   {
+      T saved;
+
+      if ( (!SAVING()) &&
+           PEEKDATA(&saved,sizeof(T)) &&
+           ((saved < lo) || (saved > hi)) )
+      {
+         m_ok = false;
+      }
+      DATA(&value,sizeof(T));
+   }
+
+   // Saves a value, or when reading checks that the saved value matches
+   // it.  Used for things that a state must agree with the machine on,
+   // such as the mapper and the size of the cartridge.
+   void CHECKDATA ( const void* data, uint32_t size );
+   template<typename T> inline void CHECK ( const T& value )
+   {
+      CHECKDATA(&value,sizeof(T));
+   }
+
+   // Memories must be registered before any memory map is serialized
+   // so that banks can be stored as (memory,bank) references rather
+   // than pointers.
+   void MEMORY ( CMEMORY* memory );
+   void BANK ( CMEMORYBANK** ppBank );
+
+protected:
+   // Copies the next size bytes of the buffer without moving past them.
+   bool PEEKDATA ( void* data, uint32_t size ) const;
+
+   uint8_t*       m_buffer;
+   uint32_t       m_size;
+   eSaveStateMode m_mode;
+   bool           m_ok;
+   uint32_t       m_pos;
+
+   // Start of the chunk being serialized and, when reading, its end.
+   uint32_t       m_chunk;
+   uint32_t       m_chunkEnd;
+
+   CMEMORY*       m_memory [ SAVESTATE_MAX_MEMORIES ];
+   int32_t        m_numMemories;
+};
+
+#endif
@@ -0,0 +1,192 @@
+//    NESICIDE - an IDE for the 8-bit NES.
+//    Copyright (C) 2009  Christopher S. Pow
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "cnesvrcirq.h"
+#include "cnes.h"
+#include "cnessavestate.h"
+#include "cnes6502.h"
+
+// The prescaler clocks the counter three times in 341 CPU cycles, once
+// per scanline.
+static const uint8_t prescalerPhases[3] = { 114, 114, 113 };
+
+CVRCIRQ::CVRCIRQ(CNES* pNES)
+   : m_nes(pNES)
+{
+   RESET();
+   m_cycle = 0;
+}
+
+void CVRCIRQ::RESET ( void )
+{
+   m_reload = 0;
+   m_counter = 0;
+   m_prescaler = 0;
+   m_prescalerPhase = 0;
+   m_enabled = false;
+}
+
+void CVRCIRQ::SERIALIZE ( CNESSaveState* state )
+{
+   state->VALUE ( m_reload );
+   state->VALUE ( m_counter );
+   state->VALUE ( m_prescaler );
+   state->VALUE ( m_prescalerPhase );
+   state->VALUE ( m_enabled );
+}
+
+void CVRCIRQ::RESCHEDULE ( uint8_t control )
+{
+   m_cycle = NES()->CPU()->_CYCLES();
+   SCHEDULE ( control );
+}
+
+void CVRCIRQ::SYNC ( uint32_t cycle, uint8_t control )
+{
+   uint32_t cycles = cycle-m_cycle;
+   uint32_t clocks;
+   uint32_t toClock;
+
+   if ( (int32_t)cycles <= 0 )
+   {
+      return;
+   }
+   m_cycle = cycle;
+
+   if ( control&0x02 )
+   {
+      if ( control&0x04 )
+      {
+         // Cycle mode counter
+         clocks = cycles;
+      }
+      else
+      {
+         // Scanline mode counter, clocked by the prescaler.
+         clocks = 0;
+         while ( cycles )
+         {
+            toClock = (m_prescaler < prescalerPhases[m_prescalerPhase])?(prescalerPhases[m_prescalerPhase]-m_prescaler):1;
+            if ( cycles < toClock )
+            {
+               m_prescaler += cycles;
+               break;
+            }
+            cycles -= toClock;
+            clocks++;
+            m_prescaler = 0;
+            m_prescalerPhase++;
+            m_prescalerPhase %= 3;
+
+            clocks += (cycles/341)*3;
+            cycles %= 341;
+         }
+      }
+
+      // The counter counts up and is reloaded, firing, after $FF.
+      if ( clocks >= (uint32_t)(0x100-m_counter) )
+      {
+         clocks -= (0x100-m_counter);
+         clocks %= (0x100-m_reload);
+         m_counter = m_reload+clocks;
+         NES()->CPU()->ASSERTIRQ(eNESSource_Mapper);
+
+         if ( NES()->DEBUGGABLE() )
+         {
+            // Check for IRQ breakpoint...
+            NES()->CHECKBREAKPOINT(eBreakInMapper,eBreakOnMapperEvent,0,MAPPER_EVENT_IRQ);
+         }
+      }
+      else
+      {
+         m_counter += clocks;
+      }
+   }
+}
+
+void CVRCIRQ::SCHEDULE ( uint8_t control )
+{
+   uint32_t clocks = 0x100-m_counter;
+   uint32_t cycles;
+   uint8_t  phase;
+
+   if ( control&0x02 )
+   {
+      if ( control&0x04 )
+      {
+         cycles = clocks;
+      }
+      else
+      {
+         // Up to the first prescaler clock, then whole sets of three.
+         cycles = (m_prescaler < prescalerPhases[m_prescalerPhase])?(prescalerPhases[m_prescalerPhase]-m_prescaler):1;
+         clocks--;
+         cycles += (clocks/3)*341;
+         for ( phase = m_prescalerPhase+1; clocks%3; clocks--, phase++ )
+         {
+            cycles += prescalerPhases[phase%3];
+         }
+      }
+      NES()->CPU()->SCHEDULE ( m_cycle+cycles );
+   }
+   else
+   {
+      NES()->CPU()->UNSCHEDULE ();
+   }
+}
+
+void CVRCIRQ::LATCHLOW ( uint8_t data )
+{
+   m_reload &= 0xF0;
+   m_reload |= (data&0x0F);
+}
+
+void CVRCIRQ::LATCHHIGH ( uint8_t data )
+{
+   m_reload &= 0x0F;
+   m_reload |= (data<<4);
+}
+
+void CVRCIRQ::CONTROL ( uint8_t control )
+{
+   NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+   if ( control&0x02 )
+   {
+      m_counter = m_reload;
+      m_prescaler = 0;
+      m_prescalerPhase = 0;
+      m_enabled = true;
+   }
+   else
+   {
+      m_enabled = false;
+   }
+}
+
+void CVRCIRQ::ACKNOWLEDGE ( uint8_t* control )
+{
+   NES()->CPU()->RELEASEIRQ(eNESSource_Mapper);
+   (*control) &= 0xFD;
+   (*control) |= (((*control)&0x01)<<1);
+   if ( (*control)&0x02 )
+   {
+      m_enabled = true;
+   }
+   else
+   {
+      m_enabled = false;
+   }
+}
@@ -0,0 +1,53 @@
+#if !defined ( VRCIRQ_H )
+#define VRCIRQ_H
+
+#include <stdint.h>
+
+class CNES;
+class CNESSaveState;
+
+// The IRQ counter of the Konami VRC2/VRC4 boards (mappers 021, 023 and 025).
+// It is the same on each board; only where its registers are decoded, and
+// so which of the mapper's registers holds the control value, differs.
+// Each call takes that control value:
+//   bit 0: enable after acknowledge
+//   bit 1: enable
+//   bit 2: cycle mode (otherwise scanline mode)
+// The counter is brought up to date from the CPU cycle it was last brought
+// up to date at only when something needs it, and its next firing is
+// scheduled as a CPU event.
+class CVRCIRQ
+{
+public:
+   CVRCIRQ(CNES* pNES);
+
+   inline CNES* NES() const { return m_nes; }
+
+   void RESET ( void );
+
+   // The counter's part of the mapper's MAPR chunk.
+   void SERIALIZE ( CNESSaveState* state );
+
+   // Starts counting from the current CPU cycle, as after a load.
+   void RESCHEDULE ( uint8_t control );
+
+   void SYNC ( uint32_t cycle, uint8_t control );
+   void SCHEDULE ( uint8_t control );
+
+   // Register writes; the mapper keeps the control register itself.
+   void LATCHLOW ( uint8_t data );
+   void LATCHHIGH ( uint8_t data );
+   void CONTROL ( uint8_t control );
+   void ACKNOWLEDGE ( uint8_t* control );
+
+protected:
+   CNES*    m_nes;
+   uint8_t  m_reload;
+   uint8_t  m_counter;
+   uint8_t  m_prescaler;
+   uint8_t  m_prescalerPhase;
+   bool     m_enabled;
+   uint32_t m_cycle;
+};
+
+#endif
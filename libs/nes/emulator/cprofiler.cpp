@@ -0,0 +1,422 @@
+//    NESICIDE - an IDE for the 8-bit NES.
+//    Copyright (C) 2009  Christopher S. Pow
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+
+#include "cprofiler.h"
+
+// Routines are found by address through an open-addressed table kept at
+// most half full.
+#define PROFILER_HASH_SIZE (MAX_PROFILER_ROUTINES*2)
+#define PROFILER_HASH_MASK (PROFILER_HASH_SIZE-1)
+
+CProfiler::CProfiler()
+{
+   m_enabled = false;
+   m_requests = 0;
+   m_generation = 0;
+   m_routines = NULL;
+   m_numRoutines = 0;
+   m_hash = NULL;
+   m_nodes = NULL;
+   m_numNodes = 0;
+   m_stack = NULL;
+   m_depth = 0;
+   m_touched = NULL;
+   m_numTouched = 0;
+   m_now = 0;
+   m_lastCycle = 0;
+   m_frames = 0;
+}
+
+CProfiler::~CProfiler()
+{
+   delete [] m_routines;
+   delete [] m_hash;
+   delete [] m_nodes;
+   delete [] m_stack;
+   delete [] m_touched;
+}
+
+void CProfiler::ALLOCATE ( void )
+{
+   // Most machines are never profiled, so the profile is only
+   // allocated once it is first enabled.
+   if ( !m_routines )
+   {
+      m_routines = new ProfilerRoutineInfo [ MAX_PROFILER_ROUTINES ];
+      m_hash = new uint32_t [ PROFILER_HASH_SIZE ];
+      m_nodes = new ProfilerNodeInfo [ MAX_PROFILER_NODES ];
+      m_stack = new ProfilerStackEntry [ MAX_PROFILER_DEPTH ];
+      m_touched = new uint32_t [ MAX_PROFILER_ROUTINES ];
+      CLEAR ();
+   }
+}
+
+void CProfiler::Enable ( bool enable )
+{
+   uint32_t requests = m_requests;
+   uint32_t wanted;
+
+   // Only the last of several requests made in one frame counts.
+   do
+   {
+      wanted = (requests&PROFILER_REQUEST_CLEAR)|PROFILER_REQUEST_ENABLE;
+      if ( enable )
+      {
+         wanted |= PROFILER_REQUEST_ENABLED;
+      }
+   } while ( !m_requests.compare_exchange_weak(requests,wanted) );
+}
+
+void CProfiler::Clear ( void )
+{
+   m_requests |= PROFILER_REQUEST_CLEAR;
+   m_generation.fetch_add(1,std::memory_order_release);
+}
+
+void CProfiler::REQUESTS ( uint32_t cycle )
+{
+   uint32_t requests = m_requests.exchange(0);
+   bool     enable;
+
+   if ( requests&PROFILER_REQUEST_CLEAR )
+   {
+      CLEAR ();
+   }
+   if ( requests&PROFILER_REQUEST_ENABLE )
+   {
+      enable = !!(requests&PROFILER_REQUEST_ENABLED);
+      if ( enable && (!m_enabled) )
+      {
+         ALLOCATE ();
+
+         // Whatever was called while the profiler was off is unknown.
+         Restart ( cycle );
+      }
+      m_enabled = enable;
+   }
+}
+
+void CProfiler::CLEAR ( void )
+{
+   ProfilerRoutineInfo* pRoutine;
+   ProfilerNodeInfo*    pNode;
+
+   if ( !m_routines )
+   {
+      return;
+   }
+
+   memset ( m_hash, 0xFF, PROFILER_HASH_SIZE*sizeof(uint32_t) );
+
+   pRoutine = m_routines+PROFILER_ROOT;
+   memset ( pRoutine, 0, sizeof(ProfilerRoutineInfo) );
+   pRoutine->addr = 0xFFFFFFFF;
+   pRoutine->absAddr = 0xFFFFFFFF;
+   pRoutine->active = 1;
+   m_numRoutines = 1;
+
+   pNode = m_nodes+PROFILER_ROOT;
+   memset ( pNode, 0, sizeof(ProfilerNodeInfo) );
+   pNode->routine = PROFILER_ROOT;
+   pNode->parent = PROFILER_NO_NODE;
+   pNode->firstChild = PROFILER_NO_NODE;
+   pNode->nextSibling = PROFILER_NO_NODE;
+   m_numNodes = 1;
+
+   // The root is above any stack pointer so that it is never ended.
+   m_stack[0].node = PROFILER_ROOT;
+   m_stack[0].routine = PROFILER_ROOT;
+   m_stack[0].entry = 0;
+   m_stack[0].sp = 0x100;
+   m_stack[0].interrupt = false;
+   m_depth = 1;
+
+   m_numTouched = 0;
+   m_now = 0;
+   m_frames = 0;
+
+   m_generation.fetch_add(1,std::memory_order_release);
+}
+
+void CProfiler::TOUCH ( ProfilerRoutineInfo* pRoutine )
+{
+   // Routines keep the frame they were last charged in, offset by one so
+   // that a new routine is not taken to have been charged in frame 0.
+   if ( pRoutine->frame != m_frames+1 )
+   {
+      pRoutine->frame = m_frames+1;
+      pRoutine->frameInclusive = 0;
+      pRoutine->frameExclusive = 0;
+      m_touched[m_numTouched++] = pRoutine-m_routines;
+   }
+}
+
+void CProfiler::CHARGE ( uint32_t cycle )
+{
+   ProfilerStackEntry*  pTop = m_stack+m_depth-1;
+   ProfilerRoutineInfo* pRoutine = m_routines+pTop->routine;
+   uint32_t             delta = cycle-m_lastCycle;
+
+   m_lastCycle = cycle;
+   m_now += delta;
+
+   m_nodes[pTop->node].exclusive += delta;
+   pRoutine->exclusive += delta;
+   TOUCH ( pRoutine );
+   pRoutine->frameExclusive += delta;
+}
+
+uint32_t CProfiler::ROUTINE ( uint32_t addr, uint32_t absAddr, bool interrupt )
+{
+   ProfilerRoutineInfo* pRoutine;
+   uint32_t             slot = ((addr*2654435761U)^absAddr)&PROFILER_HASH_MASK;
+   uint32_t             routine;
+
+   while ( m_hash[slot] != PROFILER_NO_NODE )
+   {
+      routine = m_hash[slot];
+      pRoutine = m_routines+routine;
+      if ( (pRoutine->addr == addr) && (pRoutine->absAddr == absAddr) )
+      {
+         pRoutine->interrupt |= interrupt;
+         return routine;
+      }
+      slot = (slot+1)&PROFILER_HASH_MASK;
+   }
+
+   if ( m_numRoutines == MAX_PROFILER_ROUTINES )
+   {
+      return PROFILER_NO_NODE;
+   }
+
+   // Fill the routine in before counting it so that a debugger reading
+   // the profile never sees it half made.
+   routine = m_numRoutines;
+   pRoutine = m_routines+routine;
+   memset ( pRoutine, 0, sizeof(ProfilerRoutineInfo) );
+   pRoutine->addr = addr;
+   pRoutine->absAddr = absAddr;
+   pRoutine->interrupt = interrupt;
+   m_hash[slot] = routine;
+   m_numRoutines++;
+
+   return routine;
+}
+
+uint32_t CProfiler::CHILD ( uint32_t node, uint32_t routine )
+{
+   ProfilerNodeInfo* pParent = m_nodes+node;
+   ProfilerNodeInfo* pChild;
+   uint32_t          child;
+   uint32_t          prev = PROFILER_NO_NODE;
+
+   for ( child = pParent->firstChild; child != PROFILER_NO_NODE; child = pChild->nextSibling )
+   {
+      pChild = m_nodes+child;
+      if ( pChild->routine == routine )
+      {
+         // Keep the most recently called child first; most routines
+         // call the same few routines over and over.
+         if ( prev != PROFILER_NO_NODE )
+         {
+            m_nodes[prev].nextSibling = pChild->nextSibling;
+            pChild->nextSibling = pParent->firstChild;
+            pParent->firstChild = child;
+         }
+         return child;
+      }
+      prev = child;
+   }
+
+   if ( m_numNodes == MAX_PROFILER_NODES )
+   {
+      return PROFILER_NO_NODE;
+   }
+
+   child = m_numNodes;
+   pChild = m_nodes+child;
+   pChild->routine = routine;
+   pChild->parent = node;
+   pChild->firstChild = PROFILER_NO_NODE;
+   pChild->nextSibling = pParent->firstChild;
+   pChild->calls = 0;
+   pChild->inclusive = 0;
+   pChild->exclusive = 0;
+   pParent->firstChild = child;
+   m_numNodes++;
+
+   return child;
+}
+
+void CProfiler::LEAVE ( void )
+{
+   ProfilerStackEntry*  pTop = m_stack+(--m_depth);
+   ProfilerRoutineInfo* pRoutine = m_routines+pTop->routine;
+   uint64_t             cycles = m_now-pTop->entry;
+
+   // Entries are moved up to the start of each frame as the frame ends,
+   // so all of the cycles since the entry belong to this frame.
+   m_nodes[pTop->node].inclusive += cycles;
+   pRoutine->active--;
+   if ( !pRoutine->active )
+   {
+      pRoutine->inclusive += cycles;
+      TOUCH ( pRoutine );
+      pRoutine->frameInclusive += cycles;
+   }
+}
+
+void CProfiler::Call ( uint32_t cycle, uint32_t addr, uint32_t absAddr, uint8_t sp, bool interrupt )
+{
+   ProfilerStackEntry*  pEntry;
+   ProfilerRoutineInfo* pRoutine;
+   uint32_t             routine;
+   uint32_t             node;
+
+   CHARGE ( cycle );
+
+   // A call made with the stack pointer at or above that of an open call
+   // means the program has reset its stack; those calls are over.
+   while ( (m_depth > 1) && (m_stack[m_depth-1].sp <= sp) )
+   {
+      LEAVE ();
+   }
+
+   if ( m_depth == MAX_PROFILER_DEPTH )
+   {
+      return;
+   }
+
+   routine = ROUTINE ( addr, absAddr, interrupt );
+   if ( routine == PROFILER_NO_NODE )
+   {
+      return;
+   }
+   node = CHILD ( m_stack[m_depth-1].node, routine );
+   if ( node == PROFILER_NO_NODE )
+   {
+      return;
+   }
+
+   pEntry = m_stack+m_depth;
+   pEntry->node = node;
+   pEntry->routine = routine;
+   pEntry->entry = m_now;
+   pEntry->sp = sp;
+   pEntry->interrupt = interrupt;
+   m_depth++;
+
+   pRoutine = m_routines+routine;
+   pRoutine->calls++;
+   pRoutine->active++;
+   m_nodes[node].calls++;
+}
+
+void CProfiler::Return ( uint32_t cycle, uint8_t sp, bool interrupt )
+{
+   CHARGE ( cycle );
+
+   // Calls the stack has been unwound past are over.
+   while ( (m_depth > 1) && (m_stack[m_depth-1].sp < sp) )
+   {
+      LEAVE ();
+   }
+
+   // Anything else is a jump through an address pushed on the stack.
+   if ( (m_depth > 1) &&
+        (m_stack[m_depth-1].sp == sp) &&
+        (m_stack[m_depth-1].interrupt == interrupt) )
+   {
+      LEAVE ();
+   }
+}
+
+void CProfiler::EndFrame ( uint32_t cycle )
+{
+   ProfilerStackEntry*  pEntry;
+   ProfilerRoutineInfo* pRoutine;
+   uint64_t             cycles;
+   uint32_t             depth;
+   uint32_t             outer;
+   uint32_t             idx;
+
+   if ( !m_enabled )
+   {
+      REQUESTS ( cycle );
+      return;
+   }
+
+   CHARGE ( cycle );
+
+   // Charge the calls still open to this frame and move their entries up
+   // to the start of the next, so that routines that never return, like
+   // a main loop, still show where the time goes.
+   for ( depth = 0; depth < m_depth; depth++ )
+   {
+      pEntry = m_stack+depth;
+      cycles = m_now-pEntry->entry;
+
+      m_nodes[pEntry->node].inclusive += cycles;
+      pEntry->entry = m_now;
+
+      // Only the outermost call of a recursive routine counts.
+      for ( outer = 0; outer < depth; outer++ )
+      {
+         if ( m_stack[outer].routine == pEntry->routine )
+         {
+            break;
+         }
+      }
+      if ( outer == depth )
+      {
+         pRoutine = m_routines+pEntry->routine;
+         pRoutine->inclusive += cycles;
+         TOUCH ( pRoutine );
+         pRoutine->frameInclusive += cycles;
+      }
+   }
+
+   for ( idx = 0; idx < m_numTouched; idx++ )
+   {
+      pRoutine = m_routines+m_touched[idx];
+      pRoutine->lastFrame = m_frames;
+      pRoutine->lastInclusive = pRoutine->frameInclusive;
+      pRoutine->lastExclusive = pRoutine->frameExclusive;
+      if ( pRoutine->frameInclusive > pRoutine->peakInclusive )
+      {
+         pRoutine->peakInclusive = pRoutine->frameInclusive;
+      }
+   }
+   m_numTouched = 0;
+
+   m_frames++;
+
+   REQUESTS ( cycle );
+}
+
+void CProfiler::Restart ( uint32_t cycle )
+{
+   if ( m_routines )
+   {
+      while ( m_depth > 1 )
+      {
+         LEAVE ();
+      }
+   }
+   m_lastCycle = cycle;
+}
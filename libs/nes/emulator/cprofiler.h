@@ -0,0 +1,184 @@
+#if !defined ( PROFILER_H )
+#define PROFILER_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Capacities of the profile.  They are fixed so that the debuggers can
+// read the profile while the emulator adds to it.  Calls into routines
+// beyond MAX_PROFILER_ROUTINES are charged to the caller, as are calls
+// that would add a node to a full call tree.
+#define MAX_PROFILER_ROUTINES 8192
+#define MAX_PROFILER_NODES    65536
+#define MAX_PROFILER_DEPTH    256
+
+// The routine and node that stand for code run outside of any call
+// the profiler saw, normally the main loop started from RESET.
+#define PROFILER_ROOT 0
+
+#define PROFILER_NO_NODE 0xFFFFFFFF
+
+// Requests waiting for the end of the frame.
+#define PROFILER_REQUEST_CLEAR   0x1
+#define PROFILER_REQUEST_ENABLE  0x2
+#define PROFILER_REQUEST_ENABLED 0x4
+
+// A routine is identified by the address it was entered at, both as the
+// CPU saw it and as a physical address so that the same address in
+// different banks is a different routine.  Inclusive cycles are counted
+// only for the outermost call of a recursive routine.
+typedef struct
+{
+   uint32_t addr;
+   uint32_t absAddr;
+   bool     interrupt;
+   uint32_t calls;
+   uint64_t inclusive;
+   uint64_t exclusive;
+
+   // Cycles spent in the last completed frame, and the most spent in
+   // any one frame.
+   uint32_t lastFrame;
+   uint32_t lastInclusive;
+   uint32_t lastExclusive;
+   uint32_t peakInclusive;
+
+   // Bookkeeping of the frame in progress.
+   uint32_t frame;
+   uint32_t frameInclusive;
+   uint32_t frameExclusive;
+   uint32_t active;
+} ProfilerRoutineInfo;
+
+// A node is one path through the call tree.  Children of a node are
+// linked through nextSibling.
+typedef struct
+{
+   uint32_t routine;
+   uint32_t parent;
+   uint32_t firstChild;
+   uint32_t nextSibling;
+   uint32_t calls;
+   uint64_t inclusive;
+   uint64_t exclusive;
+} ProfilerNodeInfo;
+
+typedef struct
+{
+   uint32_t node;
+   uint32_t routine;
+   uint64_t entry;
+   uint16_t sp;
+   bool     interrupt;
+} ProfilerStackEntry;
+
+// The CPU core tells the profiler when it enters a routine through JSR
+// or an interrupt and when it leaves one through RTS or RTI.  The profiler
+// keeps a shadow of the call stack and charges the cycles between those
+// events to whatever routine is on top of it.
+//
+// Returns are matched to calls by the stack pointer rather than by
+// nesting alone, because 6502 code often leaves routines some other way.
+// An RTS or RTI whose stack pointer is below the one the innermost call
+// left is taken to be a jump through a pushed address and ends nothing.
+// One above it ends every call the stack has been unwound past, as does a
+// call made with the stack pointer at or above an open call's.
+class CProfiler
+{
+public:
+   CProfiler();
+   ~CProfiler();
+
+   // Enabling and clearing can be asked for from any thread.  They are
+   // carried out by EndFrame, on the thread running the machine, so the
+   // profile never changes under the CPU core.  Until then a profile with
+   // a clear pending reads as empty.  Enabling syncs the profiler to the
+   // CPU's cycle counter.
+   void Enable ( bool enable );
+   bool IsEnabled ( void ) const
+   {
+      return m_enabled;
+   }
+   void Clear ( void );
+
+   // Called by the CPU core.  The cycle is the CPU's cycle counter.
+   void Call ( uint32_t cycle, uint32_t addr, uint32_t absAddr, uint8_t sp, bool interrupt );
+   void Return ( uint32_t cycle, uint8_t sp, bool interrupt );
+
+   // Called at the end of each PPU frame.
+   void EndFrame ( uint32_t cycle );
+
+   // Called when the CPU's cycle counter is changed other than by running,
+   // that is on RESET and on loading a state.  The calls in progress are
+   // ended since the stack they were on is gone.
+   void Restart ( uint32_t cycle );
+
+   uint32_t GetNumRoutines ( void ) const
+   {
+      return (m_requests&PROFILER_REQUEST_CLEAR)?0:m_numRoutines;
+   }
+   const ProfilerRoutineInfo* GetRoutine ( uint32_t routine ) const
+   {
+      return m_routines+routine;
+   }
+   uint32_t GetNumNodes ( void ) const
+   {
+      return (m_requests&PROFILER_REQUEST_CLEAR)?0:m_numNodes;
+   }
+   const ProfilerNodeInfo* GetNode ( uint32_t node ) const
+   {
+      return m_nodes+node;
+   }
+   uint32_t GetNumFrames ( void ) const
+   {
+      return (m_requests&PROFILER_REQUEST_CLEAR)?0:m_frames;
+   }
+   uint64_t GetTotalCycles ( void ) const
+   {
+      return (m_requests&PROFILER_REQUEST_CLEAR)?0:m_now;
+   }
+
+   // Changes when a clear is asked for and again when it is carried out,
+   // so that a reader can tell a profile that was emptied and has grown
+   // back from one that has only grown.  Restart keeps the routines and
+   // nodes and so leaves it alone.
+   uint32_t GetGeneration ( void ) const
+   {
+      return m_generation.load(std::memory_order_acquire);
+   }
+
+protected:
+   void ALLOCATE ( void );
+   void REQUESTS ( uint32_t cycle );
+   void CLEAR ( void );
+   void CHARGE ( uint32_t cycle );
+   void TOUCH ( ProfilerRoutineInfo* pRoutine );
+   uint32_t ROUTINE ( uint32_t addr, uint32_t absAddr, bool interrupt );
+   uint32_t CHILD ( uint32_t node, uint32_t routine );
+   void LEAVE ( void );
+
+   bool                 m_enabled;
+   std::atomic<uint32_t> m_requests;
+   std::atomic<uint32_t> m_generation;
+
+   ProfilerRoutineInfo* m_routines;
+   uint32_t             m_numRoutines;
+   uint32_t*            m_hash;
+
+   ProfilerNodeInfo*    m_nodes;
+   uint32_t             m_numNodes;
+
+   ProfilerStackEntry*  m_stack;
+   uint32_t             m_depth;
+
+   // Routines charged in the frame in progress.
+   uint32_t*            m_touched;
+   uint32_t             m_numTouched;
+
+   uint64_t             m_now;
+   uint32_t             m_lastCycle;
+   uint32_t             m_frames;
+};
+
+#endif
@@ -0,0 +1,1062 @@
+//    NESICIDE - an IDE for the 8-bit NES.
+//    Copyright (C) 2009  Christopher S. Pow
+
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ctracefile.h"
+
+#include <string.h>
+
+// File header:
+// 4 bytes magic, 2 bytes version, 2 bytes reserved, 4 bytes samples per block.
+static const char TRACEFILE_MAGIC [] = "NTRC";
+#define TRACEFILE_HEADER_SIZE 12
+
+// Block header:
+// 4 bytes magic, 4 bytes sample count, 4 bytes encoded size, 8 bytes first
+// sample number, 4+4 bytes frame range, 2+2 bytes address range, 4 bytes
+// type mask, 4 bytes source mask.
+static const char TRACEFILE_BLOCK_MAGIC [] = "TBLK";
+#define TRACEFILE_BLOCK_HEADER_SIZE 40
+
+// Index:
+// 4 bytes magic, 4 bytes block count, 4 bytes frame count, then for each
+// block 8 bytes offset and the block header fields, then for each frame
+// 4 bytes frame, 4 bytes block, 4 bytes row.
+static const char TRACEFILE_INDEX_MAGIC [] = "TIDX";
+#define TRACEFILE_INDEX_HEADER_SIZE 12
+#define TRACEFILE_INDEX_BLOCK_SIZE 44
+#define TRACEFILE_INDEX_FRAME_SIZE 12
+
+// Trailer:
+// 8 bytes offset of the index, 4 bytes magic.
+static const char TRACEFILE_END_MAGIC [] = "TEND";
+#define TRACEFILE_TRAILER_SIZE 12
+
+// Columns of a block, in the order they are stored.  Kind packs the type
+// in the low five bits, the source in the next two and whether registers
+// were set in the top bit.  Target keeps the target in the low seven bits
+// and whether there is a disassembly in the top bit.  The register and
+// disassembly columns only have entries for the samples that have them.
+enum
+{
+   eTraceColumn_Kind = 0,
+   eTraceColumn_Target,
+   eTraceColumn_Frame,
+   eTraceColumn_Cycle,
+   eTraceColumn_Addr,
+   eTraceColumn_EA,
+   eTraceColumn_Data,
+   eTraceColumn_A,
+   eTraceColumn_X,
+   eTraceColumn_Y,
+   eTraceColumn_SP,
+   eTraceColumn_F,
+   eTraceColumn_Disassemble0,
+   eTraceColumn_Disassemble1,
+   eTraceColumn_Disassemble2,
+   eTraceColumn_MAX
+};
+
+#define TRACEFILE_KIND_REGSSET     0x80
+#define TRACEFILE_TARGET_DISASSEMBLY 0x80
+
+// Frame, cycle, address and effective address are numeric columns stored
+// as deltas.  The CPU and PPU count cycles and fetch from addresses
+// independently so the deltas are taken from the previous sample from the
+// same source, which keeps them small and regular.  A zigzag varint of a
+// 32-bit delta takes at most five bytes.
+#define TRACEFILE_MAX_VARINT 5
+#define TRACEFILE_NUM_SOURCES 4
+
+// A column before run-length encoding, and the worst case after it: one
+// control byte for every 128 literal bytes.
+#define TRACEFILE_COLUMN_SIZE (TRACEFILE_BLOCK_SAMPLES*TRACEFILE_MAX_VARINT)
+#define TRACEFILE_MAX_RLE_SIZE (TRACEFILE_COLUMN_SIZE+(TRACEFILE_COLUMN_SIZE/128)+1)
+#define TRACEFILE_MAX_BLOCK_SIZE (eTraceColumn_MAX*(TRACEFILE_MAX_VARINT+TRACEFILE_MAX_RLE_SIZE))
+
+static void tracefilePut16 ( uint8_t* pBuf, uint16_t value )
+{
+   (*(pBuf+0)) = value&0xFF;
+   (*(pBuf+1)) = value>>8;
+}
+
+static void tracefilePut32 ( uint8_t* pBuf, uint32_t value )
+{
+   tracefilePut16 ( pBuf, value&0xFFFF );
+   tracefilePut16 ( pBuf+2, value>>16 );
+}
+
+static void tracefilePut64 ( uint8_t* pBuf, uint64_t value )
+{
+   tracefilePut32 ( pBuf, value&0xFFFFFFFF );
+   tracefilePut32 ( pBuf+4, value>>32 );
+}
+
+static uint16_t tracefileGet16 ( const uint8_t* pBuf )
+{
+   return (*(pBuf+0))|((*(pBuf+1))<<8);
+}
+
+static uint32_t tracefileGet32 ( const uint8_t* pBuf )
+{
+   return tracefileGet16(pBuf)|(tracefileGet16(pBuf+2)<<16);
+}
+
+static uint64_t tracefileGet64 ( const uint8_t* pBuf )
+{
+   return tracefileGet32(pBuf)|(((uint64_t)tracefileGet32(pBuf+4))<<32);
+}
+
+static bool tracefileSeek ( FILE* file, uint64_t offset )
+{
+#if defined ( _WIN32 )
+   return _fseeki64(file,offset,SEEK_SET) == 0;
+#else
+   return fseeko(file,offset,SEEK_SET) == 0;
+#endif
+}
+
+static uint64_t tracefileSize ( FILE* file )
+{
+#if defined ( _WIN32 )
+   _fseeki64(file,0,SEEK_END);
+   return _ftelli64(file);
+#else
+   fseeko(file,0,SEEK_END);
+   return ftello(file);
+#endif
+}
+
+static uint32_t tracefilePutVarint ( uint8_t* pBuf, uint32_t value )
+{
+   uint32_t length = 0;
+
+   while ( value >= 0x80 )
+   {
+      (*(pBuf+length)) = (value&0x7F)|0x80;
+      value >>= 7;
+      length++;
+   }
+   (*(pBuf+length)) = value;
+
+   return length+1;
+}
+
+static bool tracefileGetVarint ( const uint8_t* pBuf, uint32_t size, uint32_t* pPos, uint32_t* pValue )
+{
+   uint32_t value = 0;
+   uint32_t shift = 0;
+   uint8_t  byte;
+
+   do
+   {
+      if ( ((*pPos) >= size) || (shift > 28) )
+      {
+         return false;
+      }
+      byte = (*(pBuf+(*pPos)));
+      (*pPos)++;
+      value |= (byte&0x7F)<<shift;
+      shift += 7;
+   } while ( byte&0x80 );
+
+   (*pValue) = value;
+
+   return true;
+}
+
+static inline uint32_t tracefileZigzag ( uint32_t value, uint32_t previous )
+{
+   int32_t delta = (int32_t)(value-previous);
+
+   return (((uint32_t)delta)<<1)^((uint32_t)(delta>>31));
+}
+
+static inline uint32_t tracefileUnzigzag ( uint32_t zigzag, uint32_t previous )
+{
+   return previous+((zigzag>>1)^(0-(zigzag&1)));
+}
+
+// Run-length encoding.  A control byte below 0x80 is followed by that
+// many plus one literal bytes; one at or above 0x80 is followed by a byte
+// repeated that many minus 0x80 plus three times.
+static uint32_t tracefileRLE ( const uint8_t* pIn, uint32_t size, uint8_t* pOut )
+{
+   uint32_t in = 0;
+   uint32_t out = 0;
+   uint32_t literal = 0;
+   uint32_t run;
+
+   while ( in < size )
+   {
+      run = 1;
+      while ( (in+run < size) && (run < 130) && (pIn[in+run] == pIn[in]) )
+      {
+         run++;
+      }
+      if ( run >= 3 )
+      {
+         if ( literal )
+         {
+            pOut[out] = literal-1;
+            out += literal+1;
+            literal = 0;
+         }
+         pOut[out++] = 0x80+(run-3);
+         pOut[out++] = pIn[in];
+         in += run;
+      }
+      else
+      {
+         // Literal bytes are copied to just past their control byte,
+         // which is filled in once the length of the literal is known.
+         pOut[out+1+literal] = pIn[in];
+         literal++;
+         in++;
+         if ( literal == 128 )
+         {
+            pOut[out] = literal-1;
+            out += literal+1;
+            literal = 0;
+         }
+      }
+   }
+   if ( literal )
+   {
+      pOut[out] = literal-1;
+      out += literal+1;
+   }
+
+   return out;
+}
+
+static bool tracefileUnRLE ( const uint8_t* pIn, uint32_t size, uint8_t* pOut, uint32_t maxSize, uint32_t* pOutSize )
+{
+   uint32_t in = 0;
+   uint32_t out = 0;
+   uint32_t count;
+   uint8_t  control;
+
+   while ( in < size )
+   {
+      control = pIn[in++];
+      if ( control < 0x80 )
+      {
+         count = control+1;
+         if ( (in+count > size) || (out+count > maxSize) )
+         {
+            return false;
+         }
+         memcpy(pOut+out,pIn+in,count);
+         in += count;
+      }
+      else
+      {
+         count = control-0x80+3;
+         if ( (in >= size) || (out+count > maxSize) )
+         {
+            return false;
+         }
+         memset(pOut+out,pIn[in],count);
+         in++;
+      }
+      out += count;
+   }
+
+   (*pOutSize) = out;
+
+   return true;
+}
+
+static inline bool tracefileHasDisassembly ( const TracerInfo* pSample )
+{
+   return pSample->disassemble[3] == 0x00;
+}
+
+static uint32_t tracefileNumeric ( const TracerInfo* pSample, int32_t column )
+{
+   switch ( column )
+   {
+      case eTraceColumn_Frame:
+         return pSample->frame;
+      case eTraceColumn_Cycle:
+         return pSample->cycle;
+      case eTraceColumn_Addr:
+         return pSample->addr;
+      default:
+         return pSample->ea;
+   }
+}
+
+static void tracefileSetNumeric ( TracerInfo* pSample, int32_t column, uint32_t value )
+{
+   switch ( column )
+   {
+      case eTraceColumn_Frame:
+         pSample->frame = value;
+         break;
+      case eTraceColumn_Cycle:
+         pSample->cycle = value;
+         break;
+      case eTraceColumn_Addr:
+         pSample->addr = value;
+         break;
+      default:
+         pSample->ea = value;
+         break;
+   }
+}
+
+static uint8_t* tracefileSparse ( TracerInfo* pSample, int32_t column )
+{
+   switch ( column )
+   {
+      case eTraceColumn_A:
+         return &pSample->a;
+      case eTraceColumn_X:
+         return &pSample->x;
+      case eTraceColumn_Y:
+         return &pSample->y;
+      case eTraceColumn_SP:
+         return &pSample->sp;
+      case eTraceColumn_F:
+         return &pSample->f;
+      default:
+         return pSample->disassemble+(column-eTraceColumn_Disassemble0);
+   }
+}
+
+static inline bool tracefileSparsePresent ( const TracerInfo* pSample, int32_t column )
+{
+   if ( column < eTraceColumn_Disassemble0 )
+   {
+      return pSample->regsset;
+   }
+   return tracefileHasDisassembly(pSample);
+}
+
+// Lays out one column of a block before it is run-length encoded.
+static uint32_t tracefileFillColumn ( TracerInfo* pSamples, uint32_t count, int32_t column, uint8_t* pColumn )
+{
+   TracerInfo* pSample;
+   uint32_t    previous [ TRACEFILE_NUM_SOURCES ] = { 0, 0, 0, 0 };
+   uint32_t    length = 0;
+   uint32_t    value;
+   uint32_t    idx;
+   int32_t     source;
+
+   for ( idx = 0, pSample = pSamples; idx < count; idx++, pSample++ )
+   {
+      switch ( column )
+      {
+         case eTraceColumn_Kind:
+            pColumn[length++] = (pSample->type&0x1F)|
+                                ((pSample->source&0x03)<<5)|
+                                (pSample->regsset?TRACEFILE_KIND_REGSSET:0);
+            break;
+         case eTraceColumn_Target:
+            pColumn[length++] = (pSample->target&0x7F)|
+                                (tracefileHasDisassembly(pSample)?TRACEFILE_TARGET_DISASSEMBLY:0);
+            break;
+         case eTraceColumn_Frame:
+         case eTraceColumn_Cycle:
+         case eTraceColumn_Addr:
+         case eTraceColumn_EA:
+            source = (column == eTraceColumn_Frame)?0:(pSample->source&0x03);
+            value = tracefileNumeric(pSample,column);
+            length += tracefilePutVarint ( pColumn+length, tracefileZigzag(value,previous[source]) );
+            previous[source] = value;
+            break;
+         case eTraceColumn_Data:
+            pColumn[length++] = pSample->data;
+            break;
+         default:
+            if ( tracefileSparsePresent(pSample,column) )
+            {
+               pColumn[length++] = (*tracefileSparse(pSample,column));
+            }
+            break;
+      }
+   }
+
+   return length;
+}
+
+// The reverse of tracefileFillColumn.  Kind and target come first in a
+// block so the source and the sparse column flags are known by the time
+// the other columns are decoded.
+static bool tracefileSpreadColumn ( TracerInfo* pSamples, uint32_t count, int32_t column, const uint8_t* pColumn, uint32_t size )
+{
+   TracerInfo* pSample;
+   uint32_t    previous [ TRACEFILE_NUM_SOURCES ] = { 0, 0, 0, 0 };
+   uint32_t    pos = 0;
+   uint32_t    value;
+   uint32_t    idx;
+   int32_t     source;
+
+   for ( idx = 0, pSample = pSamples; idx < count; idx++, pSample++ )
+   {
+      switch ( column )
+      {
+         case eTraceColumn_Kind:
+            if ( pos >= size )
+            {
+               return false;
+            }
+            pSample->type = pColumn[pos]&0x1F;
+            pSample->source = (pColumn[pos]>>5)&0x03;
+            pSample->regsset = (pColumn[pos]&TRACEFILE_KIND_REGSSET)?1:0;
+            pos++;
+            break;
+         case eTraceColumn_Target:
+            if ( pos >= size )
+            {
+               return false;
+            }
+            // Sign-extend the seven bit target.
+            pSample->target = ((int8_t)(pColumn[pos]<<1))>>1;
+            pSample->disassemble[3] = (pColumn[pos]&TRACEFILE_TARGET_DISASSEMBLY)?0x00:0xFF;
+            pos++;
+            break;
+         case eTraceColumn_Frame:
+         case eTraceColumn_Cycle:
+         case eTraceColumn_Addr:
+         case eTraceColumn_EA:
+            if ( !tracefileGetVarint(pColumn,size,&pos,&value) )
+            {
+               return false;
+            }
+            source = (column == eTraceColumn_Frame)?0:(pSample->source&0x03);
+            previous[source] = tracefileUnzigzag(value,previous[source]);
+            tracefileSetNumeric(pSample,column,previous[source]);
+            break;
+         case eTraceColumn_Data:
+            if ( pos >= size )
+            {
+               return false;
+            }
+            pSample->data = pColumn[pos++];
+            break;
+         default:
+            if ( tracefileSparsePresent(pSample,column) )
+            {
+               if ( pos >= size )
+               {
+                  return false;
+               }
+               (*tracefileSparse(pSample,column)) = pColumn[pos++];
+            }
+            else
+            {
+               (*tracefileSparse(pSample,column)) = 0;
+            }
+            break;
+      }
+   }
+
+   return pos == size;
+}
+
+static void tracefilePutBlockInfo ( uint8_t* pBuf, const TraceFileBlockInfo& info )
+{
+   tracefilePut32 ( pBuf+0, info.count );
+   tracefilePut32 ( pBuf+4, info.encodedSize );
+   tracefilePut64 ( pBuf+8, info.firstSequence );
+   tracefilePut32 ( pBuf+16, info.frameMin );
+   tracefilePut32 ( pBuf+20, info.frameMax );
+   tracefilePut16 ( pBuf+24, info.addrMin );
+   tracefilePut16 ( pBuf+26, info.addrMax );
+   tracefilePut32 ( pBuf+28, info.typeMask );
+   tracefilePut32 ( pBuf+32, info.sourceMask );
+}
+
+static void tracefileGetBlockInfo ( const uint8_t* pBuf, TraceFileBlockInfo* pInfo )
+{
+   pInfo->count = tracefileGet32 ( pBuf+0 );
+   pInfo->encodedSize = tracefileGet32 ( pBuf+4 );
+   pInfo->firstSequence = tracefileGet64 ( pBuf+8 );
+   pInfo->frameMin = tracefileGet32 ( pBuf+16 );
+   pInfo->frameMax = tracefileGet32 ( pBuf+20 );
+   pInfo->addrMin = tracefileGet16 ( pBuf+24 );
+   pInfo->addrMax = tracefileGet16 ( pBuf+26 );
+   pInfo->typeMask = tracefileGet32 ( pBuf+28 );
+   pInfo->sourceMask = tracefileGet32 ( pBuf+32 );
+}
+
+CTraceFileWriter::CTraceFileWriter()
+{
+   m_file = NULL;
+   m_failed = false;
+   m_offset = 0;
+   m_samples = 0;
+
+   m_pending = new TracerInfo [ TRACEFILE_BLOCK_SAMPLES ];
+   m_numPending = 0;
+   m_firstSequence = 0;
+   m_nextSequence = 0;
+   m_encoded = new uint8_t [ TRACEFILE_MAX_BLOCK_SIZE ];
+   m_column = new uint8_t [ TRACEFILE_COLUMN_SIZE ];
+
+   m_blocks = NULL;
+   m_numBlocks = 0;
+   m_maxBlocks = 0;
+   m_frames = NULL;
+   m_numFrames = 0;
+   m_maxFrames = 0;
+   m_frameValid = false;
+   m_lastFrame = 0;
+}
+
+CTraceFileWriter::~CTraceFileWriter()
+{
+   Close ();
+
+   delete [] m_pending;
+   delete [] m_encoded;
+   delete [] m_column;
+}
+
+bool CTraceFileWriter::Open ( const char* fileName )
+{
+   uint8_t header [ TRACEFILE_HEADER_SIZE ];
+
+   Close ();
+
+   m_file = fopen ( fileName, "wb" );
+   if ( !m_file )
+   {
+      return false;
+   }
+   m_failed = false;
+
+   memcpy(header,TRACEFILE_MAGIC,4);
+   tracefilePut16 ( header+4, TRACEFILE_VERSION );
+   tracefilePut16 ( header+6, 0 );
+   tracefilePut32 ( header+8, TRACEFILE_BLOCK_SAMPLES );
+   WRITE ( header, TRACEFILE_HEADER_SIZE );
+   if ( m_failed )
+   {
+      fclose ( m_file );
+      m_file = NULL;
+      return false;
+   }
+
+   m_offset = TRACEFILE_HEADER_SIZE;
+   m_samples = 0;
+   m_numPending = 0;
+   m_numBlocks = 0;
+   m_numFrames = 0;
+   m_frameValid = false;
+
+   return true;
+}
+
+bool CTraceFileWriter::Close ( void )
+{
+   uint8_t  buffer [ TRACEFILE_INDEX_BLOCK_SIZE ];
+   uint64_t indexOffset;
+   uint32_t idx;
+
+   if ( !m_file )
+   {
+      return true;
+   }
+
+   FLUSH ();
+
+   // An index of blocks that did not all make it to the file would
+   // send the reader to data that is not there.
+   if ( !m_failed )
+   {
+      indexOffset = m_offset;
+      memcpy(buffer,TRACEFILE_INDEX_MAGIC,4);
+      tracefilePut32 ( buffer+4, m_numBlocks );
+      tracefilePut32 ( buffer+8, m_numFrames );
+      WRITE ( buffer, TRACEFILE_INDEX_HEADER_SIZE );
+      for ( idx = 0; idx < m_numBlocks; idx++ )
+      {
+         tracefilePut64 ( buffer, m_blocks[idx].offset );
+         tracefilePutBlockInfo ( buffer+8, m_blocks[idx] );
+         WRITE ( buffer, TRACEFILE_INDEX_BLOCK_SIZE );
+      }
+      for ( idx = 0; idx < m_numFrames; idx++ )
+      {
+         tracefilePut32 ( buffer+0, m_frames[idx].frame );
+         tracefilePut32 ( buffer+4, m_frames[idx].block );
+         tracefilePut32 ( buffer+8, m_frames[idx].row );
+         WRITE ( buffer, TRACEFILE_INDEX_FRAME_SIZE );
+      }
+
+      tracefilePut64 ( buffer, indexOffset );
+      memcpy(buffer+8,TRACEFILE_END_MAGIC,4);
+      WRITE ( buffer, TRACEFILE_TRAILER_SIZE );
+   }
+
+   // Buffered data is only written out here, so this can fail too.
+   if ( fclose(m_file) )
+   {
+      m_failed = true;
+   }
+   m_file = NULL;
+
+   delete [] m_blocks;
+   m_blocks = NULL;
+   m_maxBlocks = 0;
+   delete [] m_frames;
+   m_frames = NULL;
+   m_maxFrames = 0;
+
+   return !m_failed;
+}
+
+void CTraceFileWriter::WRITE ( const void* data, uint32_t size )
+{
+   if ( (!m_failed) &&
+        (fwrite(data,1,size,m_file) != size) )
+   {
+      m_failed = true;
+   }
+}
+
+void CTraceFileWriter::GROWINDEX ( void )
+{
+   TraceFileBlockInfo* pBlocks;
+   TraceFileFrameInfo* pFrames;
+
+   if ( m_numBlocks == m_maxBlocks )
+   {
+      pBlocks = new TraceFileBlockInfo [ m_maxBlocks+1024 ];
+      memcpy(pBlocks,m_blocks,m_numBlocks*sizeof(TraceFileBlockInfo));
+      delete [] m_blocks;
+      m_blocks = pBlocks;
+      m_maxBlocks += 1024;
+   }
+   if ( m_numFrames == m_maxFrames )
+   {
+      pFrames = new TraceFileFrameInfo [ m_maxFrames+1024 ];
+      memcpy(pFrames,m_frames,m_numFrames*sizeof(TraceFileFrameInfo));
+      delete [] m_frames;
+      m_frames = pFrames;
+      m_maxFrames += 1024;
+   }
+}
+
+void CTraceFileWriter::AddSample ( TracerSample sequence, const TracerInfo& sample )
+{
+   TracerInfo* pSample;
+
+   if ( !m_file )
+   {
+      return;
+   }
+
+   // A block holds a run of consecutive samples.  If the tracer dropped
+   // some, start a new block so the reader can tell.
+   if ( m_numPending && (sequence != m_nextSequence) )
+   {
+      FLUSH ();
+   }
+   if ( !m_numPending )
+   {
+      m_firstSequence = sequence;
+   }
+   m_nextSequence = sequence+1;
+
+   if ( (!m_frameValid) || (sample.frame != m_lastFrame) )
+   {
+      GROWINDEX ();
+      m_frames[m_numFrames].frame = sample.frame;
+      m_frames[m_numFrames].block = m_numBlocks;
+      m_frames[m_numFrames].row = m_numPending;
+      m_numFrames++;
+      m_frameValid = true;
+      m_lastFrame = sample.frame;
+   }
+
+   pSample = m_pending+m_numPending;
+   (*pSample) = sample;
+   if ( !pSample->regsset )
+   {
+      pSample->a = 0;
+      pSample->x = 0;
+      pSample->y = 0;
+      pSample->sp = 0;
+      pSample->f = 0;
+   }
+   if ( pSample->disassemble[3] )
+   {
+      pSample->disassemble[0] = 0;
+      pSample->disassemble[1] = 0;
+      pSample->disassemble[2] = 0;
+      pSample->disassemble[3] = 0xFF;
+   }
+
+   m_numPending++;
+   m_samples++;
+   if ( m_numPending == TRACEFILE_BLOCK_SAMPLES )
+   {
+      FLUSH ();
+   }
+}
+
+void CTraceFileWriter::FLUSH ( void )
+{
+   uint8_t*            column = m_column;
+   uint8_t             header [ TRACEFILE_BLOCK_HEADER_SIZE ];
+   TraceFileBlockInfo* pInfo;
+   TracerInfo*         pSample;
+   uint32_t            length;
+   uint32_t            size = 0;
+   uint32_t            idx;
+   int32_t             col;
+
+   if ( !m_numPending )
+   {
+      return;
+   }
+
+   GROWINDEX ();
+   pInfo = m_blocks+m_numBlocks;
+   pInfo->offset = m_offset;
+   pInfo->firstSequence = m_firstSequence;
+   pInfo->count = m_numPending;
+   pInfo->frameMin = 0xFFFFFFFF;
+   pInfo->frameMax = 0;
+   pInfo->addrMin = 0xFFFF;
+   pInfo->addrMax = 0;
+   pInfo->typeMask = 0;
+   pInfo->sourceMask = 0;
+
+   for ( idx = 0, pSample = m_pending; idx < m_numPending; idx++, pSample++ )
+   {
+      if ( pSample->frame < pInfo->frameMin )
+      {
+         pInfo->frameMin = pSample->frame;
+      }
+      if ( pSample->frame > pInfo->frameMax )
+      {
+         pInfo->frameMax = pSample->frame;
+      }
+      if ( pSample->addr < pInfo->addrMin )
+      {
+         pInfo->addrMin = pSample->addr;
+      }
+      if ( pSample->addr > pInfo->addrMax )
+      {
+         pInfo->addrMax = pSample->addr;
+      }
+      pInfo->typeMask |= 1<<(pSample->type&31);
+      pInfo->sourceMask |= 1<<(pSample->source&31);
+   }
+
+   for ( col = 0; col < eTraceColumn_MAX; col++ )
+   {
+      length = tracefileFillColumn ( m_pending, m_numPending, col, column );
+
+      // The encoded length goes in front of the column; leave room for
+      // the longest varint and close the gap afterwards.
+      length = tracefileRLE ( column, length, m_encoded+size+TRACEFILE_MAX_VARINT );
+      idx = tracefilePutVarint ( m_encoded+size, length );
+      memmove(m_encoded+size+idx,m_encoded+size+TRACEFILE_MAX_VARINT,length);
+      size += idx+length;
+   }
+   pInfo->encodedSize = size;
+
+   memcpy(header,TRACEFILE_BLOCK_MAGIC,4);
+   tracefilePutBlockInfo ( header+4, *pInfo );
+   WRITE ( header, TRACEFILE_BLOCK_HEADER_SIZE );
+   WRITE ( m_encoded, size );
+
+   m_offset += TRACEFILE_BLOCK_HEADER_SIZE+size;
+   m_numBlocks++;
+   m_numPending = 0;
+}
+
+CTraceFileReader::CTraceFileReader()
+{
+   m_file = NULL;
+   m_indexed = false;
+   m_framesSorted = false;
+   m_blocks = NULL;
+   m_numBlocks = 0;
+   m_frames = NULL;
+   m_numFrames = 0;
+   m_samples = new TracerInfo [ TRACEFILE_BLOCK_SAMPLES ];
+   m_encoded = new uint8_t [ TRACEFILE_MAX_BLOCK_SIZE ];
+   m_column = new uint8_t [ TRACEFILE_COLUMN_SIZE ];
+}
+
+CTraceFileReader::~CTraceFileReader()
+{
+   Close ();
+
+   delete [] m_samples;
+   delete [] m_encoded;
+   delete [] m_column;
+}
+
+bool CTraceFileReader::Open ( const char* fileName )
+{
+   uint8_t header [ TRACEFILE_HEADER_SIZE ];
+
+   Close ();
+
+   m_file = fopen ( fileName, "rb" );
+   if ( !m_file )
+   {
+      return false;
+   }
+
+   if ( (fread(header,1,TRACEFILE_HEADER_SIZE,m_file) != TRACEFILE_HEADER_SIZE) ||
+        (memcmp(header,TRACEFILE_MAGIC,4)) ||
+        (tracefileGet16(header+4) != TRACEFILE_VERSION) ||
+        (tracefileGet32(header+8) > TRACEFILE_BLOCK_SAMPLES) )
+   {
+      Close ();
+      return false;
+   }
+
+   m_framesSorted = true;
+   m_indexed = READINDEX ();
+   if ( (!m_indexed) && (!SCANBLOCKS()) )
+   {
+      Close ();
+      return false;
+   }
+
+   return true;
+}
+
+void CTraceFileReader::Close ( void )
+{
+   if ( m_file )
+   {
+      fclose ( m_file );
+      m_file = NULL;
+   }
+   delete [] m_blocks;
+   m_blocks = NULL;
+   m_numBlocks = 0;
+   delete [] m_frames;
+   m_frames = NULL;
+   m_numFrames = 0;
+   m_indexed = false;
+   m_framesSorted = false;
+}
+
+bool CTraceFileReader::READINDEX ( void )
+{
+   uint8_t  buffer [ TRACEFILE_INDEX_BLOCK_SIZE ];
+   uint64_t fileSize = tracefileSize(m_file);
+   uint64_t indexOffset;
+   uint32_t numBlocks;
+   uint32_t numFrames;
+   uint32_t idx;
+
+   if ( fileSize < TRACEFILE_HEADER_SIZE+TRACEFILE_INDEX_HEADER_SIZE+TRACEFILE_TRAILER_SIZE )
+   {
+      return false;
+   }
+   if ( (!tracefileSeek(m_file,fileSize-TRACEFILE_TRAILER_SIZE)) ||
+        (fread(buffer,1,TRACEFILE_TRAILER_SIZE,m_file) != TRACEFILE_TRAILER_SIZE) ||
+        (memcmp(buffer+8,TRACEFILE_END_MAGIC,4)) )
+   {
+      return false;
+   }
+   indexOffset = tracefileGet64(buffer);
+   if ( (indexOffset < TRACEFILE_HEADER_SIZE) ||
+        (indexOffset > fileSize-TRACEFILE_INDEX_HEADER_SIZE-TRACEFILE_TRAILER_SIZE) ||
+        (!tracefileSeek(m_file,indexOffset)) ||
+        (fread(buffer,1,TRACEFILE_INDEX_HEADER_SIZE,m_file) != TRACEFILE_INDEX_HEADER_SIZE) ||
+        (memcmp(buffer,TRACEFILE_INDEX_MAGIC,4)) )
+   {
+      return false;
+   }
+   numBlocks = tracefileGet32(buffer+4);
+   numFrames = tracefileGet32(buffer+8);
+   if ( indexOffset+TRACEFILE_INDEX_HEADER_SIZE+
+        (uint64_t)numBlocks*TRACEFILE_INDEX_BLOCK_SIZE+
+        (uint64_t)numFrames*TRACEFILE_INDEX_FRAME_SIZE+
+        TRACEFILE_TRAILER_SIZE != fileSize )
+   {
+      return false;
+   }
+
+   m_blocks = new TraceFileBlockInfo [ numBlocks+1 ];
+   for ( idx = 0; idx < numBlocks; idx++ )
+   {
+      if ( fread(buffer,1,TRACEFILE_INDEX_BLOCK_SIZE,m_file) != TRACEFILE_INDEX_BLOCK_SIZE )
+      {
+         return false;
+      }
+      m_blocks[idx].offset = tracefileGet64(buffer);
+      tracefileGetBlockInfo ( buffer+8, m_blocks+idx );
+      if ( (m_blocks[idx].count > TRACEFILE_BLOCK_SAMPLES) ||
+           (m_blocks[idx].encodedSize > TRACEFILE_MAX_BLOCK_SIZE) )
+      {
+         return false;
+      }
+   }
+   m_numBlocks = numBlocks;
+
+   m_frames = new TraceFileFrameInfo [ numFrames+1 ];
+   for ( idx = 0; idx < numFrames; idx++ )
+   {
+      if ( fread(buffer,1,TRACEFILE_INDEX_FRAME_SIZE,m_file) != TRACEFILE_INDEX_FRAME_SIZE )
+      {
+         return false;
+      }
+      m_frames[idx].frame = tracefileGet32(buffer+0);
+      m_frames[idx].block = tracefileGet32(buffer+4);
+      m_frames[idx].row = tracefileGet32(buffer+8);
+      if ( idx && (m_frames[idx].frame < m_frames[idx-1].frame) )
+      {
+         m_framesSorted = false;
+      }
+   }
+   m_numFrames = numFrames;
+
+   return true;
+}
+
+bool CTraceFileReader::SCANBLOCKS ( void )
+{
+   uint8_t  header [ TRACEFILE_BLOCK_HEADER_SIZE ];
+   uint64_t fileSize = tracefileSize(m_file);
+   uint64_t offset = TRACEFILE_HEADER_SIZE;
+   uint32_t maxBlocks = 0;
+   TraceFileBlockInfo  info;
+   TraceFileBlockInfo* pBlocks;
+
+   delete [] m_blocks;
+   m_blocks = NULL;
+   m_numBlocks = 0;
+   delete [] m_frames;
+   m_frames = NULL;
+   m_numFrames = 0;
+
+   // Whatever was written of the last block before the writer stopped
+   // is ignored.
+   while ( (offset+TRACEFILE_BLOCK_HEADER_SIZE <= fileSize) &&
+           (tracefileSeek(m_file,offset)) &&
+           (fread(header,1,TRACEFILE_BLOCK_HEADER_SIZE,m_file) == TRACEFILE_BLOCK_HEADER_SIZE) &&
+           (!memcmp(header,TRACEFILE_BLOCK_MAGIC,4)) )
+   {
+      tracefileGetBlockInfo ( header+4, &info );
+      info.offset = offset;
+      if ( (info.count > TRACEFILE_BLOCK_SAMPLES) ||
+           (info.encodedSize > TRACEFILE_MAX_BLOCK_SIZE) ||
+           (offset+TRACEFILE_BLOCK_HEADER_SIZE+info.encodedSize > fileSize) )
+      {
+         break;
+      }
+      if ( m_numBlocks == maxBlocks )
+      {
+         pBlocks = new TraceFileBlockInfo [ maxBlocks+1024 ];
+         memcpy(pBlocks,m_blocks,m_numBlocks*sizeof(TraceFileBlockInfo));
+         delete [] m_blocks;
+         m_blocks = pBlocks;
+         maxBlocks += 1024;
+      }
+      m_blocks[m_numBlocks++] = info;
+      offset += TRACEFILE_BLOCK_HEADER_SIZE+info.encodedSize;
+   }
+
+   return true;
+}
+
+uint32_t CTraceFileReader::FindFrame ( uint32_t frame ) const
+{
+   uint32_t lo = 0;
+   uint32_t hi = m_numFrames;
+   uint32_t mid;
+   uint32_t block;
+
+   // Frames only go backwards if the machine was reset while tracing,
+   // in which case the frame index cannot be searched.
+   if ( m_framesSorted && m_numFrames )
+   {
+      while ( lo < hi )
+      {
+         mid = (lo+hi)/2;
+         if ( m_frames[mid].frame < frame )
+         {
+            lo = mid+1;
+         }
+         else
+         {
+            hi = mid;
+         }
+      }
+      if ( lo < m_numFrames )
+      {
+         return m_frames[lo].block;
+      }
+      return m_numBlocks;
+   }
+
+   for ( block = 0; block < m_numBlocks; block++ )
+   {
+      if ( m_blocks[block].frameMax >= frame )
+      {
+         break;
+      }
+   }
+
+   return block;
+}
+
+bool CTraceFileReader::ReadBlock ( uint32_t block, const TracerInfo** ppSamples )
+{
+   uint8_t* column = m_column;
+   uint32_t length;
+   uint32_t columnSize;
+   uint32_t pos = 0;
+   int32_t  col;
+
+   if ( block >= m_numBlocks )
+   {
+      return false;
+   }
+
+   const TraceFileBlockInfo& info = m_blocks[block];
+
+   if ( (!tracefileSeek(m_file,info.offset+TRACEFILE_BLOCK_HEADER_SIZE)) ||
+        (fread(m_encoded,1,info.encodedSize,m_file) != info.encodedSize) )
+   {
+      return false;
+   }
+
+   for ( col = 0; col < eTraceColumn_MAX; col++ )
+   {
+      if ( (!tracefileGetVarint(m_encoded,info.encodedSize,&pos,&length)) ||
+           (pos > info.encodedSize) ||
+           (length > info.encodedSize-pos) ||
+           (!tracefileUnRLE(m_encoded+pos,length,column,TRACEFILE_COLUMN_SIZE,&columnSize)) )
+      {
+         return false;
+      }
+      pos += length;
+
+      if ( !tracefileSpreadColumn(m_samples,info.count,col,column,columnSize) )
+      {
+         return false;
+      }
+   }
+
+   (*ppSamples) = m_samples;
+
+   return true;
+}
@@ -0,0 +1,166 @@
+#if !defined ( TRACEFILE_H )
+#define TRACEFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ctracer.h"
+
+// Trace file format version.  Bumped whenever the layout of the header,
+// the blocks or the index changes.
+#define TRACEFILE_VERSION 1
+
+// Number of samples encoded together in a block.
+#define TRACEFILE_BLOCK_SAMPLES 8192
+
+// What a block holds, kept in the block's header and again in the index
+// so that a reader can skip blocks that cannot match a query without
+// decoding them.
+typedef struct
+{
+   uint64_t offset;
+   uint64_t firstSequence;
+   uint32_t count;
+   uint32_t encodedSize;
+   uint32_t frameMin;
+   uint32_t frameMax;
+   uint16_t addrMin;
+   uint16_t addrMax;
+   uint32_t typeMask;
+   uint32_t sourceMask;
+} TraceFileBlockInfo;
+
+// The first sample of each frame.
+typedef struct
+{
+   uint32_t frame;
+   uint32_t block;
+   uint32_t row;
+} TraceFileFrameInfo;
+
+// A trace file is a header followed by blocks of samples and, once the
+// file is closed, an index of the blocks and of where each frame starts.
+// Each block holds the samples column by column.  Cycles and addresses are
+// stored as zigzag varint deltas from the previous sample from the same
+// source, registers and disassembly only for the samples that have them,
+// and each column is then run-length encoded.  A typical trace comes to
+// about seven bytes a sample, a quarter of the size in memory.
+//
+// Values are little-endian.  A file whose writer never closed it has no
+// index; the reader rebuilds the block list by walking the block headers.
+class CTraceFileWriter
+{
+public:
+   CTraceFileWriter();
+   ~CTraceFileWriter();
+
+   bool Open ( const char* fileName );
+
+   // False if anything could not be written, such as when the disk
+   // fills up.  Nothing more is written after a failure and the index is
+   // left off, so that a reader sees the file as one whose writer never
+   // closed it and keeps only the blocks that were written whole.
+   bool Close ( void );
+   bool IsOpen ( void ) const
+   {
+      return m_file != NULL;
+   }
+
+   // Samples are appended in order.  Registers and disassembly that were
+   // never set are zeroed so that traces of identical runs are identical.
+   void AddSample ( TracerSample sequence, const TracerInfo& sample );
+
+   uint64_t GetNumSamples ( void ) const
+   {
+      return m_samples;
+   }
+   uint64_t GetBytesWritten ( void ) const
+   {
+      return m_offset;
+   }
+
+protected:
+   void FLUSH ( void );
+   void GROWINDEX ( void );
+   void WRITE ( const void* data, uint32_t size );
+
+   FILE*               m_file;
+   bool                m_failed;
+   uint64_t            m_offset;
+   uint64_t            m_samples;
+
+   // Samples waiting to be encoded.
+   TracerInfo*         m_pending;
+   uint32_t            m_numPending;
+   TracerSample        m_firstSequence;
+   TracerSample        m_nextSequence;
+   uint8_t*            m_encoded;
+   uint8_t*            m_column;
+
+   TraceFileBlockInfo* m_blocks;
+   uint32_t            m_numBlocks;
+   uint32_t            m_maxBlocks;
+   TraceFileFrameInfo* m_frames;
+   uint32_t            m_numFrames;
+   uint32_t            m_maxFrames;
+   bool                m_frameValid;
+   uint32_t            m_lastFrame;
+};
+
+class CTraceFileReader
+{
+public:
+   CTraceFileReader();
+   ~CTraceFileReader();
+
+   bool Open ( const char* fileName );
+   void Close ( void );
+
+   // False if the writer did not close the file, in which case there is
+   // no frame index.
+   bool HasIndex ( void ) const
+   {
+      return m_indexed;
+   }
+
+   uint32_t GetNumBlocks ( void ) const
+   {
+      return m_numBlocks;
+   }
+   const TraceFileBlockInfo& GetBlockInfo ( uint32_t block ) const
+   {
+      return m_blocks[block];
+   }
+   uint32_t GetNumFrames ( void ) const
+   {
+      return m_numFrames;
+   }
+   const TraceFileFrameInfo& GetFrameInfo ( uint32_t idx ) const
+   {
+      return m_frames[idx];
+   }
+
+   // Finds the first block that may hold samples from frame onward.
+   uint32_t FindFrame ( uint32_t frame ) const;
+
+   // Decodes a block into the reader's buffer.  The samples stay valid
+   // until the next call.
+   bool ReadBlock ( uint32_t block, const TracerInfo** ppSamples );
+
+protected:
+   bool READINDEX ( void );
+   bool SCANBLOCKS ( void );
+
+   FILE*               m_file;
+   bool                m_indexed;
+   bool                m_framesSorted;
+   TraceFileBlockInfo* m_blocks;
+   uint32_t            m_numBlocks;
+   TraceFileFrameInfo* m_frames;
+   uint32_t            m_numFrames;
+   TracerInfo*         m_samples;
+   uint8_t*            m_encoded;
+   uint8_t*            m_column;
+};
+
+#endif
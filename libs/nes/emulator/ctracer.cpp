@@ -15,233 +15,564 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ctracer.h"
+#include "ctracefile.h"
+
+#include <string.h>
+
+#if defined ( _WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// Registers are stored A, X, Y, SP, F for each sample.
+#define TRACER_REGS_PER_SAMPLE 5
+
+// Number of the newest samples held back from the trace file when the
+// trace is published, enough to cover the longest instruction.
+#define TRACER_SPILL_LAG 1024
+
+// Columns start on cache line boundaries within the storage block.
+// Column sizes are multiples of the depth, a power of two, so each is
+// also pushed along by a few cache lines; otherwise the slot for the
+// same sample in every column would fall in the same cache set.
+#define TRACER_COLUMN_ALIGN 64
+#define TRACER_COLUMN_SKEW  (TRACER_COLUMN_ALIGN*5)
+
+static size_t tracerColumn ( size_t* pOffset, size_t size )
+{
+   size_t offset = ((*pOffset)+TRACER_COLUMN_ALIGN-1)&(~(size_t)(TRACER_COLUMN_ALIGN-1));
+
+   (*pOffset) = offset+size+TRACER_COLUMN_SKEW;
+
+   return offset;
+}
 
 CTracer::CTracer()
+   : m_head(0),
+     m_cpuHead(0),
+     m_ppuHead(0),
+     m_published(0),
+     m_snapFrame(0),
+     m_snapOldest(0),
+     m_snapHead(0),
+     m_snapCpuTail(0),
+     m_snapCpuHead(0),
+     m_snapPpuTail(0),
+     m_snapPpuHead(0),
+   m_pWriter(NULL),
+   m_spilling(false)
 {
    m_frame = 0;
+   m_oldest = 0;
+   m_cpuTail = 0;
+   m_ppuTail = 0;
+
+   m_spilled = 0;
+
+   m_storage = NULL;
+   m_storageSize = 0;
+   m_mapped = false;
+#if defined ( _WIN32 )
+   m_hFile = INVALID_HANDLE_VALUE;
+   m_hMapping = NULL;
+#else
+   m_fd = -1;
+#endif
+
+   ALLOCATE ( TRACER_DEFAULT_DEPTH, NULL );
+}
 
-   m_cursor = 0;
-   m_samples = 0;
 
-   m_cpuCursor = 0;
-   m_cpuSamples = 0;
-   m_ppuCursor = 0;
-   m_ppuSamples = 0;
+CTracer::~CTracer()
+{
+   StopFile ();
+   FREE ();
+}
 
-   m_pSamples = new TracerInfo [ TRACER_DEFAULT_DEPTH ];
+void CTracer::ALLOCATE ( uint32_t depth, const char* backingFile )
+{
+   size_t size = 0;
+   size_t offFrames, offCycles, offEA, offDisassemble, offAddr, offData;
+   size_t offRegs, offType, offSource, offTarget, offRegsset, offCPULinks, offPPULinks;
+
+   m_depth = depth;
+   m_mask = depth-1;
+
+   offFrames = tracerColumn ( &size, depth*sizeof(uint32_t) );
+   offCycles = tracerColumn ( &size, depth*sizeof(uint32_t) );
+   offEA = tracerColumn ( &size, depth*sizeof(uint32_t) );
+   offDisassemble = tracerColumn ( &size, depth*4 );
+   offAddr = tracerColumn ( &size, depth*sizeof(uint16_t) );
+   offData = tracerColumn ( &size, depth );
+   offRegs = tracerColumn ( &size, depth*TRACER_REGS_PER_SAMPLE );
+   offType = tracerColumn ( &size, depth );
+   offSource = tracerColumn ( &size, depth );
+   offTarget = tracerColumn ( &size, depth );
+   offRegsset = tracerColumn ( &size, depth );
+   offCPULinks = tracerColumn ( &size, depth*sizeof(uint32_t) );
+   offPPULinks = tracerColumn ( &size, depth*sizeof(uint32_t) );
+
+   m_storage = NULL;
+   m_storageSize = size;
+   m_mapped = false;
+
+   if ( backingFile )
+   {
+#if defined ( _WIN32 )
+      m_hFile = CreateFileA ( backingFile, GENERIC_READ|GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+      if ( m_hFile != INVALID_HANDLE_VALUE )
+      {
+         m_hMapping = CreateFileMappingA ( (HANDLE)m_hFile, NULL, PAGE_READWRITE, (DWORD)(((uint64_t)size)>>32), (DWORD)size, NULL );
+         if ( m_hMapping )
+         {
+            m_storage = (uint8_t*)MapViewOfFile ( (HANDLE)m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, size );
+         }
+      }
+#else
+      m_fd = open ( backingFile, O_RDWR|O_CREAT|O_TRUNC, 0644 );
+      if ( (m_fd >= 0) &&
+           (ftruncate(m_fd,size) == 0) )
+      {
+         void* pMap = mmap ( NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, m_fd, 0 );
+         if ( pMap != MAP_FAILED )
+         {
+            m_storage = (uint8_t*)pMap;
+         }
+      }
+#endif
+      if ( m_storage )
+      {
+         m_mapped = true;
+      }
+      else
+      {
+         FREE ();
+         return;
+      }
+   }
+   else
+   {
+      m_storage = new uint8_t [ size ];
+   }
 
-   m_sampleBufferDepth = TRACER_DEFAULT_DEPTH;
+   m_frames = (uint32_t*)(m_storage+offFrames);
+   m_cycles = (uint32_t*)(m_storage+offCycles);
+   m_ea = (uint32_t*)(m_storage+offEA);
+   m_disassemble = m_storage+offDisassemble;
+   m_addr = (uint16_t*)(m_storage+offAddr);
+   m_data = m_storage+offData;
+   m_regs = m_storage+offRegs;
+   m_type = (int8_t*)(m_storage+offType);
+   m_source = (int8_t*)(m_storage+offSource);
+   m_target = (int8_t*)(m_storage+offTarget);
+   m_regsset = (int8_t*)(m_storage+offRegsset);
+   m_cpuLinks = (uint32_t*)(m_storage+offCPULinks);
+   m_ppuLinks = (uint32_t*)(m_storage+offPPULinks);
 }
 
-
-CTracer::~CTracer()
+void CTracer::FREE ( void )
 {
-   delete [] m_pSamples;
+   if ( m_mapped )
+   {
+#if defined ( _WIN32 )
+      UnmapViewOfFile ( m_storage );
+#else
+      munmap ( m_storage, m_storageSize );
+#endif
+   }
+   else
+   {
+      delete [] m_storage;
+   }
+#if defined ( _WIN32 )
+   if ( m_hMapping )
+   {
+      CloseHandle ( (HANDLE)m_hMapping );
+      m_hMapping = NULL;
+   }
+   if ( m_hFile != INVALID_HANDLE_VALUE )
+   {
+      CloseHandle ( (HANDLE)m_hFile );
+      m_hFile = INVALID_HANDLE_VALUE;
+   }
+#else
+   if ( m_fd >= 0 )
+   {
+      close ( m_fd );
+      m_fd = -1;
+   }
+#endif
+   m_storage = NULL;
+   m_storageSize = 0;
+   m_mapped = false;
 }
 
-bool CTracer::ReallocateTracerMemory(int32_t newDepth)
+bool CTracer::ReallocateTracerMemory(uint32_t newDepth, const char* backingFile)
 {
+   uint32_t depth = 1;
    bool ok = true;
 
-   delete [] m_pSamples;
+   while ( (depth < newDepth) && (depth < 0x80000000) )
+   {
+      depth <<= 1;
+   }
 
-   m_pSamples = new TracerInfo [ newDepth ];
+   SPILL ( m_head.load(std::memory_order_relaxed) );
+   FREE ();
 
-   m_sampleBufferDepth = newDepth;
+   ALLOCATE ( depth, backingFile );
 
-   if ( !m_pSamples )
+   if ( !m_storage )
    {
+      ALLOCATE ( TRACER_DEFAULT_DEPTH, NULL );
       ok = false;
    }
 
+   // Sample numbers carry on from where they were so that handles
+   // held by anyone from before the reallocation are simply stale.
+   ClearSampleBuffer ();
+
    return ok;
 }
 
-TracerInfo* CTracer::AddSample(uint32_t cycle, int8_t type, int8_t source, int8_t target, uint16_t addr, uint8_t data)
+TracerSample CTracer::AddSample(uint32_t cycle, int8_t type, int8_t source, int8_t target, uint16_t addr, uint8_t data)
 {
-   TracerInfo* pSample = m_pSamples + m_cursor;
-   TracerInfo* pTargetSample = NULL;
-   int8_t      overwrittenSource;
-
-   // Save overwritten sample's type to adjust
-   // sample counts later on...
-   overwrittenSource = pSample->source;
-
-   // Set frame from emulator.
-   pSample->frame = m_frame;
-
-   pSample->cycle = cycle;
-   pSample->type = type;
-   pSample->source = source;
-   pSample->target = target;
-   pSample->addr = addr;
-   pSample->data = data;
-   *(pSample->disassemble+3) = 0xFF;
-   pSample->ea = 0xFFFFFFFF;
-   pSample->regsset = 0;
+   TracerSample sample = m_head.load(std::memory_order_relaxed);
+   uint32_t     slot = sample&m_mask;
+   uint64_t     link;
+   uint32_t*    pLinks;
 
-   m_cursor++;
-   m_cursor %= m_sampleBufferDepth;
-
-   if ( source == eNESSource_PPU )
+   if ( sample-m_oldest == m_depth )
    {
-      pTargetSample = m_pSamples + m_ppuCursor;
-      pTargetSample->pPPUSample = pSample;
-
-      m_ppuCursor++;
-      m_ppuCursor %= m_sampleBufferDepth;
-
-      if ( m_samples < m_sampleBufferDepth )
+      // The ring is full so the oldest sample is about to be overwritten.
+      // Whichever view it belongs to, it is that view's oldest sample.
+      if ( m_source[slot] == eNESSource_PPU )
       {
-         m_samples++;
-         m_ppuSamples++;
+         m_ppuTail++;
       }
       else
       {
-         if ( m_ppuSamples < m_sampleBufferDepth )
-         {
-            m_ppuSamples++;
-         }
-
-         if ( overwrittenSource == eNESSource_PPU )
-         {
-            m_ppuSamples--;
-         }
-         else
-         {
-            m_cpuSamples--;
-         }
+         m_cpuTail++;
       }
+      m_oldest++;
+   }
+
+   // Claim the slots before writing them.  A reader that sees any of
+   // what is written here will also see the new sample and link numbers
+   // and so know that what it copied may be torn.
+   m_head.store(sample+1,std::memory_order_relaxed);
+   if ( source == eNESSource_PPU )
+   {
+      link = m_ppuHead.load(std::memory_order_relaxed);
+      m_ppuHead.store(link+1,std::memory_order_relaxed);
+      pLinks = m_ppuLinks;
    }
    else
    {
-      pTargetSample = m_pSamples + m_cpuCursor;
-      pTargetSample->pCPUSample = pSample;
-
-      m_cpuCursor++;
-      m_cpuCursor %= m_sampleBufferDepth;
-
-      if ( m_samples < m_sampleBufferDepth )
-      {
-         m_samples++;
-         m_cpuSamples++;
-      }
-      else
-      {
-         if ( m_cpuSamples < m_sampleBufferDepth )
-         {
-            m_cpuSamples++;
-         }
-
-         if ( overwrittenSource == eNESSource_PPU )
-         {
-            m_ppuSamples--;
-         }
-         else
-         {
-            m_cpuSamples--;
-         }
-      }
+      link = m_cpuHead.load(std::memory_order_relaxed);
+      m_cpuHead.store(link+1,std::memory_order_relaxed);
+      pLinks = m_cpuLinks;
    }
+   std::atomic_thread_fence(std::memory_order_release);
+
+   pLinks[link&m_mask] = (uint32_t)sample;
 
-   return pSample;
+   // Set frame from emulator.
+   m_frames[slot] = m_frame;
+
+   m_cycles[slot] = cycle;
+   m_type[slot] = type;
+   m_source[slot] = source;
+   m_target[slot] = target;
+   m_addr[slot] = addr;
+   m_data[slot] = data;
+   m_disassemble[(slot<<2)+3] = 0xFF;
+   m_ea[slot] = 0xFFFFFFFF;
+   m_regsset[slot] = 0;
+
+   return sample;
 }
 
 void CTracer::ClearSampleBuffer(void)
 {
+   // Anything not yet in the trace file goes there before it is lost.
+   SPILL ( m_head.load(std::memory_order_relaxed) );
+
    m_frame = 0;
 
-   m_cursor = 0;
-   m_samples = 0;
+   m_oldest = m_head.load(std::memory_order_relaxed);
+   m_cpuTail = m_cpuHead.load(std::memory_order_relaxed);
+   m_ppuTail = m_ppuHead.load(std::memory_order_relaxed);
 
-   m_cpuCursor = 0;
-   m_cpuSamples = 0;
-   m_ppuCursor = 0;
-   m_ppuSamples = 0;
+   Publish ();
 }
 
-TracerInfo* CTracer::GetLastSample ( void )
+TracerSample CTracer::GetLastCPUSample ( void ) const
 {
-   int getsample = m_cursor-1;
+   uint64_t cpuHead = m_cpuHead.load(std::memory_order_relaxed);
+   uint64_t head = m_head.load(std::memory_order_relaxed);
 
-   if ( getsample < 0 )
+   if ( cpuHead == m_cpuTail )
    {
-      getsample = m_sampleBufferDepth-1;
+      return TRACER_NO_SAMPLE;
    }
 
-   return m_pSamples+getsample;
+   return head-(uint32_t)((uint32_t)head-m_cpuLinks[(cpuHead-1)&m_mask]);
 }
 
-TracerInfo* CTracer::GetLastCPUSample ( void )
+void CTracer::SetDisassembly ( TracerSample sample, uint8_t* szD )
 {
-   int getsample = m_cpuCursor-1;
-
-   if ( getsample < 0 )
+   if ( IsLive(sample) )
    {
-      getsample = m_sampleBufferDepth-1;
+      uint8_t* pD = m_disassemble+((sample&m_mask)<<2);
+
+      (*(pD+0)) = (*szD);
+      szD++;
+      (*(pD+1)) = (*szD);
+      szD++;
+      (*(pD+2)) = (*szD);
+      (*(pD+3)) = 0x00;
    }
+}
 
-   return (m_pSamples+getsample)->pCPUSample;
+void CTracer::SetRegisters ( TracerSample sample, uint8_t a, uint8_t x, uint8_t y, uint8_t sp, uint8_t f )
+{
+   if ( IsLive(sample) )
+   {
+      uint32_t slot = sample&m_mask;
+      uint8_t* pR = m_regs+(slot*TRACER_REGS_PER_SAMPLE);
+
+      (*(pR+0)) = a;
+      (*(pR+1)) = x;
+      (*(pR+2)) = y;
+      (*(pR+3)) = sp;
+      (*(pR+4)) = f;
+      m_regsset[slot] = 1;
+   }
 }
 
-TracerInfo* CTracer::GetSample ( uint32_t sample )
+void CTracer::Publish ( void )
 {
-   int32_t getsample = m_cursor-(sample+1);
+   uint64_t sequence = m_published.load(std::memory_order_relaxed);
+   TracerSample head = m_head.load(std::memory_order_relaxed);
 
-   if ( getsample < 0 )
+   // The newest samples may still be filled in by the CPU as it finishes
+   // its current instruction, so they are left for the next publish.
+   if ( head-m_oldest > TRACER_SPILL_LAG )
    {
-      getsample = m_sampleBufferDepth+getsample;
+      SPILL ( head-TRACER_SPILL_LAG );
    }
 
-   return m_pSamples+getsample;
+   // Odd while the fields are being changed.
+   m_published.store(sequence+1,std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   m_snapFrame.store(m_frame,std::memory_order_relaxed);
+   m_snapOldest.store(m_oldest,std::memory_order_relaxed);
+   m_snapHead.store(m_head.load(std::memory_order_relaxed),std::memory_order_relaxed);
+   m_snapCpuTail.store(m_cpuTail,std::memory_order_relaxed);
+   m_snapCpuHead.store(m_cpuHead.load(std::memory_order_relaxed),std::memory_order_relaxed);
+   m_snapPpuTail.store(m_ppuTail,std::memory_order_relaxed);
+   m_snapPpuHead.store(m_ppuHead.load(std::memory_order_relaxed),std::memory_order_relaxed);
+
+   m_published.store(sequence+2,std::memory_order_release);
 }
 
-TracerInfo* CTracer::GetCPUSample ( uint32_t sample )
+void CTracer::GetSnapshot ( TracerSnapshot* pSnapshot ) const
 {
-   int32_t getsample = m_cpuCursor-(sample+1);
+   uint64_t before;
+   uint64_t after;
+
+   do
+   {
+      before = m_published.load(std::memory_order_acquire);
+
+      pSnapshot->frame = m_snapFrame.load(std::memory_order_relaxed);
+      pSnapshot->oldest = m_snapOldest.load(std::memory_order_relaxed);
+      pSnapshot->head = m_snapHead.load(std::memory_order_relaxed);
+      pSnapshot->cpuTail = m_snapCpuTail.load(std::memory_order_relaxed);
+      pSnapshot->cpuHead = m_snapCpuHead.load(std::memory_order_relaxed);
+      pSnapshot->ppuTail = m_snapPpuTail.load(std::memory_order_relaxed);
+      pSnapshot->ppuHead = m_snapPpuHead.load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = m_published.load(std::memory_order_relaxed);
+   } while ( (before&1) || (before != after) );
 
-   if ( getsample < 0 )
+   pSnapshot->sequence = before>>1;
+}
+
+uint32_t CTracer::GetNumSamples ( const TracerSnapshot& snapshot, eTracerView view )
+{
+   switch ( view )
    {
-      getsample = m_sampleBufferDepth+getsample;
+      case eTracerView_CPU:
+         return snapshot.cpuHead-snapshot.cpuTail;
+      case eTracerView_PPU:
+         return snapshot.ppuHead-snapshot.ppuTail;
+      default:
+         return snapshot.head-snapshot.oldest;
    }
+}
 
-   return (m_pSamples+getsample)->pCPUSample;
+bool CTracer::ReadSample ( const TracerSnapshot& snapshot, eTracerView view, uint32_t row, TracerInfo* pSample ) const
+{
+   const std::atomic<uint64_t>* pLinkHead = NULL;
+   TracerSample sample;
+   uint64_t     link = 0;
+
+   if ( row >= GetNumSamples(snapshot,view) )
+   {
+      return false;
+   }
+
+   if ( view == eTracerView_CPU )
+   {
+      link = snapshot.cpuHead-(row+1);
+      sample = snapshot.head-(uint32_t)((uint32_t)snapshot.head-m_cpuLinks[link&m_mask]);
+      pLinkHead = &m_cpuHead;
+   }
+   else if ( view == eTracerView_PPU )
+   {
+      link = snapshot.ppuHead-(row+1);
+      sample = snapshot.head-(uint32_t)((uint32_t)snapshot.head-m_ppuLinks[link&m_mask]);
+      pLinkHead = &m_ppuHead;
+   }
+   else
+   {
+      sample = snapshot.head-(row+1);
+   }
+
+   COPY ( sample, pSample );
+
+   // If the writer has since come all the way round the ring the copy
+   // may be torn.  The writer claims the slot that replaces a sample,
+   // moving the head more than a depth past it, before writing to it.
+   std::atomic_thread_fence(std::memory_order_acquire);
+   if ( m_head.load(std::memory_order_relaxed)-sample > m_depth )
+   {
+      return false;
+   }
+   if ( pLinkHead &&
+        (pLinkHead->load(std::memory_order_relaxed)-link > m_depth) )
+   {
+      return false;
+   }
+
+   return true;
 }
 
-TracerInfo* CTracer::GetPPUSample ( uint32_t sample )
+void CTracer::COPY ( TracerSample sample, TracerInfo* pSample ) const
 {
-   int32_t getsample = m_ppuCursor-(sample+1);
+   uint32_t slot = sample&m_mask;
+   uint8_t* pR = m_regs+(slot*TRACER_REGS_PER_SAMPLE);
+
+   pSample->frame = m_frames[slot];
+   pSample->cycle = m_cycles[slot];
+   pSample->addr = m_addr[slot];
+   pSample->data = m_data[slot];
+   pSample->a = (*(pR+0));
+   pSample->x = (*(pR+1));
+   pSample->y = (*(pR+2));
+   pSample->sp = (*(pR+3));
+   pSample->f = (*(pR+4));
+   pSample->ea = m_ea[slot];
+   memcpy ( pSample->disassemble, m_disassemble+(slot<<2), 4 );
+   pSample->type = m_type[slot];
+   pSample->source = m_source[slot];
+   pSample->target = m_target[slot];
+   pSample->regsset = m_regsset[slot];
+}
 
-   if ( getsample < 0 )
+bool CTracer::StartFile ( const char* fileName )
+{
+   CTraceFileWriter* pWriter;
+
+   StopFile ();
+
+   pWriter = new CTraceFileWriter();
+   if ( !pWriter->Open(fileName) )
    {
-      getsample = m_sampleBufferDepth+getsample;
+      delete pWriter;
+      return false;
    }
 
-   return (m_pSamples+getsample)->pPPUSample;
+   // No writer is installed, so the emulator thread leaves m_spilled alone
+   // until it sees the new one.
+   m_spilled = m_head.load(std::memory_order_relaxed);
+   m_pWriter.store(pWriter,std::memory_order_release);
+
+   return true;
 }
 
-void CTracer::SetDisassembly ( TracerInfo* pS, uint8_t* szD )
+bool CTracer::StopFile ( void )
 {
-   if ( pS )
+   CTraceFileWriter* pWriter = m_pWriter.exchange(NULL);
+   TracerSnapshot snapshot;
+   TracerInfo     sample;
+   bool           ok;
+
+   if ( !pWriter )
    {
-      (*((pS->disassemble)+0)) = (*szD);
-      szD++;
-      (*((pS->disassemble)+1)) = (*szD);
-      szD++;
-      (*((pS->disassemble)+2)) = (*szD);
-      (*((pS->disassemble)+3)) = 0x00;
+      return true;
    }
+
+   // Wait out a spill the emulator thread may be in the middle of.  It
+   // cannot start another one with the writer gone.
+   while ( m_spilling.load() )
+   {
+   }
+
+   // Write out what was published since the last spill.  The emulator may
+   // still be running, so samples overwritten while being copied are
+   // skipped.
+   GetSnapshot ( &snapshot );
+   if ( m_spilled < snapshot.oldest )
+   {
+      m_spilled = snapshot.oldest;
+   }
+   for ( ; m_spilled < snapshot.head; m_spilled++ )
+   {
+      COPY ( m_spilled, &sample );
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ( m_head.load(std::memory_order_relaxed)-m_spilled <= m_depth )
+      {
+         pWriter->AddSample ( m_spilled, sample );
+      }
+   }
+
+   ok = pWriter->Close ();
+   delete pWriter;
+
+   return ok;
 }
 
-void CTracer::SetRegisters ( TracerInfo* pS, uint8_t a, uint8_t x, uint8_t y, uint8_t sp, uint8_t f )
+void CTracer::SPILL ( TracerSample upTo )
 {
-   if ( pS )
+   CTraceFileWriter* pWriter;
+   TracerInfo        sample;
+
+   // Keeps StopFile from closing the writer out from under us.
+   m_spilling.store(true);
+   pWriter = m_pWriter.load();
+
+   if ( pWriter )
    {
-      pS->a = a;
-      pS->x = x;
-      pS->y = y;
-      pS->sp = sp;
-      pS->f = f;
-      pS->regsset = 1;
+      // Samples overwritten or cleared before they could be written are
+      // skipped; the writer starts a new block at the gap.
+      if ( m_spilled < m_oldest )
+      {
+         m_spilled = m_oldest;
+      }
+      for ( ; m_spilled < upTo; m_spilled++ )
+      {
+         COPY ( m_spilled, &sample );
+         pWriter->AddSample ( m_spilled, sample );
+      }
    }
+
+   m_spilling.store(false,std::memory_order_release);
 }
@@ -3,6 +3,9 @@
 
 #include "nes_emulator_core.h"
 
+#include <stddef.h>
+#include <atomic>
+
 #define TRACER_DEFAULT_DEPTH 262144
 
 enum
@@ -72,7 +75,8 @@ enum
    eTracerCol_MAX
 };
 
-#pragma pack(1)
+// A copy of one sample, filled in by CTracer::ReadSample.  The tracer
+// itself does not store samples this way; see below.
 typedef struct _TracerInfo
 {
    uint32_t frame;
@@ -90,91 +94,209 @@ typedef struct _TracerInfo
    int8_t   source;
    int8_t   target;
    int8_t   regsset;
-   struct _TracerInfo* pCPUSample;
-   struct _TracerInfo* pPPUSample;
 } TracerInfo;
-#pragma pack()
 
+// Samples are numbered in the order they are added.  The number of a
+// sample is its handle; the slot it occupies in the ring is the number
+// masked by the depth of the ring, which is always a power of two.
+typedef uint64_t TracerSample;
+#define TRACER_NO_SAMPLE 0xFFFFFFFFFFFFFFFFULL
+
+// Which samples a row number of a snapshot refers to.  Row 0 is always
+// the newest sample.  The CPU view holds every sample not from the PPU,
+// as it always has.
+typedef enum
+{
+   eTracerView_All = 0,
+   eTracerView_CPU,
+   eTracerView_PPU
+} eTracerView;
+
+// The extent of the trace at the moment it was published.  Sequence is
+// bumped each time a snapshot is published so a reader can tell whether
+// anything has changed since it last looked.
+typedef struct
+{
+   uint64_t     sequence;
+   uint32_t     frame;
+   TracerSample oldest;
+   TracerSample head;
+   uint64_t     cpuTail;
+   uint64_t     cpuHead;
+   uint64_t     ppuTail;
+   uint64_t     ppuHead;
+} TracerSnapshot;
+
+class CTraceFileWriter;
+
+// The execution tracer keeps the most recent samples in a ring.  Each
+// field of a sample is kept in its own column so that adding a sample
+// touches only the fields it sets, and the CPU and PPU views are rings of
+// 32-bit links holding the low bits of the sample numbers they refer to.
+// The columns can be backed by a memory-mapped file so that very deep
+// traces need not be held in RAM.
+//
+// The emulator thread is the only writer.  It publishes a snapshot of the
+// extent of the trace at the end of each frame and when it stops at a
+// breakpoint.  Readers on other threads take a snapshot with GetSnapshot
+// and copy samples out of it with ReadSample, which fails if the sample
+// was overwritten while it was being copied.  Neither side takes a lock.
+//
+// While a trace file is open every sample is also spilled to it as the
+// trace is published, so the file holds far more than the ring does.  If
+// more than a ring's worth of samples is added between publishes the
+// samples that were overwritten are missing from the file.  The file can
+// be started and stopped from another thread while the emulator runs.
 class CTracer
 {
 public:
    void ClearSampleBuffer ( void );
-   inline TracerInfo* AddRESET ( void )
+   inline TracerSample AddRESET ( void )
    {
       return AddSample ( 0, eTracer_RESET, eNESSource_CPU, 0, 0, 0 );
    }
-   inline TracerInfo* AddNMI ( uint32_t cycle, int8_t source )
+   inline TracerSample AddNMI ( uint32_t cycle, int8_t source )
    {
       return AddSample ( cycle, eTracer_NMI, source, 0, 0, 0 );
    }
-   inline TracerInfo* AddIRQ ( uint32_t cycle, int8_t source )
+   inline TracerSample AddIRQ ( uint32_t cycle, int8_t source )
    {
       return AddSample ( cycle, eTracer_IRQ, source, 0, 0, 0 );
    }
-   inline TracerInfo* AddIRQRelease ( uint32_t cycle, int8_t source )
+   inline TracerSample AddIRQRelease ( uint32_t cycle, int8_t source )
    {
       return AddSample ( cycle, eTracer_IRQRelease, source, 0, 0, 0 );
    }
-   inline TracerInfo* AddStolenCycle ( uint32_t cycle, int8_t source )
+   inline TracerSample AddStolenCycle ( uint32_t cycle, int8_t source )
    {
       return AddSample ( cycle, eTracer_StolenCycle, source, 0, 0, 0 );
    }
-   inline TracerInfo* AddGarbageFetch( uint32_t cycle, int8_t target, uint16_t addr )
+   inline TracerSample AddGarbageFetch( uint32_t cycle, int8_t target, uint16_t addr )
    {
       return AddSample ( cycle, eTracer_GarbageRead, eNESSource_PPU, target, addr, 0 );
    }
-   TracerInfo* AddSample ( uint32_t cycle, int8_t type, int8_t source, int8_t target, uint16_t addr, uint8_t data );
-   bool ReallocateTracerMemory ( int32_t newDepth );
-   unsigned int GetNumSamples ( void ) const
+   TracerSample AddSample ( uint32_t cycle, int8_t type, int8_t source, int8_t target, uint16_t addr, uint8_t data );
+
+   // Resizes the ring, rounding the depth up to a power of two, and
+   // discards the trace.  If backingFile is given the columns are placed
+   // in that file, which is created or truncated, and mapped into memory.
+   // On failure the tracer falls back to the default depth in RAM.
+   bool ReallocateTracerMemory ( uint32_t newDepth, const char* backingFile = NULL );
+   uint32_t GetDepth ( void ) const
    {
-      return m_samples;
+      return m_depth;
    }
-   TracerInfo* GetSample ( uint32_t sample );
-   TracerInfo* GetCPUSample ( uint32_t sample );
-   TracerInfo* GetPPUSample ( uint32_t sample );
-   TracerInfo* GetLastSample ( void );
-   TracerInfo* GetLastCPUSample ( void );
-   void SetDisassembly ( TracerInfo* pS, uint8_t* szD );
-   void SetRegisters ( TracerInfo* pS, uint8_t a, uint8_t x, uint8_t y, uint8_t sp, uint8_t f );
-   void SetEffectiveAddress ( TracerInfo* pS, uint32_t ea )
+
+   // Writer side.  These are only called on the emulator thread.
+   inline bool IsLive ( TracerSample sample ) const
+   {
+      return (sample-m_oldest) < (m_head.load(std::memory_order_relaxed)-m_oldest);
+   }
+   TracerSample GetLastCPUSample ( void ) const;
+   void SetDisassembly ( TracerSample sample, uint8_t* szD );
+   void SetRegisters ( TracerSample sample, uint8_t a, uint8_t x, uint8_t y, uint8_t sp, uint8_t f );
+   void SetEffectiveAddress ( TracerSample sample, uint32_t ea )
    {
-      if ( pS )
+      if ( IsLive(sample) )
       {
-         pS->ea = ea;
+         m_ea[sample&m_mask] = ea;
       }
    }
-
-   CTracer();
-   ~CTracer();
-
-   unsigned int GetNumCPUSamples() const
+   void SetTarget ( TracerSample sample, int8_t target )
    {
-      return m_cpuSamples;
+      if ( IsLive(sample) )
+      {
+         m_target[sample&m_mask] = target;
+      }
    }
-   unsigned int GetNumPPUSamples() const
+   void SetFrame(uint32_t frame)
    {
-      return m_ppuSamples;
+      m_frame = frame;
    }
+   void Publish ( void );
 
-   void SetFrame(uint32_t frame)
+   // Spilling the trace to a file.  Samples already in the ring are not
+   // written; the file starts with the next sample added.
+   bool StartFile ( const char* fileName );
+   bool StopFile ( void );
+   bool IsFileOpen ( void ) const
    {
-      m_frame = frame;
+      return m_pWriter.load(std::memory_order_relaxed) != NULL;
    }
 
+   // Reader side.  Safe to call from any thread.
+   void GetSnapshot ( TracerSnapshot* pSnapshot ) const;
+   static uint32_t GetNumSamples ( const TracerSnapshot& snapshot, eTracerView view );
+   bool ReadSample ( const TracerSnapshot& snapshot, eTracerView view, uint32_t row, TracerInfo* pSample ) const;
+
+   CTracer();
+   ~CTracer();
+
 protected:
+   void ALLOCATE ( uint32_t depth, const char* backingFile );
+   void FREE ( void );
+   void COPY ( TracerSample sample, TracerInfo* pSample ) const;
+   void SPILL ( TracerSample upTo );
+
    // Frame # is set by emulator so it doesn't have to be passed in all the time...
    uint32_t    m_frame;
 
-   uint32_t    m_cursor;
-   uint32_t    m_samples;
-   uint32_t    m_sampleBufferDepth;
+   uint32_t    m_depth;
+   uint32_t    m_mask;
+
+   // Sample numbers.  Samples m_oldest up to m_head are in the ring;
+   // entries m_cpuTail up to m_cpuHead of the CPU link ring refer to
+   // the CPU samples among them, and likewise for the PPU.
+   std::atomic<uint64_t> m_head;
+   uint64_t    m_oldest;
+   std::atomic<uint64_t> m_cpuHead;
+   uint64_t    m_cpuTail;
+   std::atomic<uint64_t> m_ppuHead;
+   uint64_t    m_ppuTail;
 
-   uint32_t    m_cpuCursor;
-   uint32_t    m_cpuSamples;
-   uint32_t    m_ppuCursor;
-   uint32_t    m_ppuSamples;
+   // Columns.
+   uint32_t*   m_frames;
+   uint32_t*   m_cycles;
+   uint32_t*   m_ea;
+   uint8_t*    m_disassemble;
+   uint16_t*   m_addr;
+   uint8_t*    m_data;
+   uint8_t*    m_regs;
+   int8_t*     m_type;
+   int8_t*     m_source;
+   int8_t*     m_target;
+   int8_t*     m_regsset;
+   uint32_t*   m_cpuLinks;
+   uint32_t*   m_ppuLinks;
+
+   // Trace file, and the next sample to be written to it.  The emulator
+   // thread only uses the writer while m_spilling is set, and StopFile
+   // takes the writer away and waits for that to clear before closing it.
+   std::atomic<CTraceFileWriter*> m_pWriter;
+   std::atomic<bool> m_spilling;
+   TracerSample m_spilled;
+
+   // Storage for the columns, either from the heap or mapped from a file.
+   uint8_t*    m_storage;
+   size_t      m_storageSize;
+   bool        m_mapped;
+#if defined ( _WIN32 )
+   void*       m_hFile;
+   void*       m_hMapping;
+#else
+   int         m_fd;
+#endif
 
-   TracerInfo* m_pSamples;
+   // Published snapshot, guarded by a sequence lock.  m_published is odd
+   // while the writer is updating the fields.
+   std::atomic<uint64_t> m_published;
+   std::atomic<uint32_t> m_snapFrame;
+   std::atomic<uint64_t> m_snapOldest;
+   std::atomic<uint64_t> m_snapHead;
+   std::atomic<uint64_t> m_snapCpuTail;
+   std::atomic<uint64_t> m_snapCpuHead;
+   std::atomic<uint64_t> m_snapPpuTail;
+   std::atomic<uint64_t> m_snapPpuHead;
 };
 
 CTracer* nesGetExecutionTracerDatabase ( void );
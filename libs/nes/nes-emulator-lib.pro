@@ -64,6 +64,17 @@ unix:!mac {
 
 DEFINES += XML_SAVE_STATE
 
+# Uncomment to generate audio through FamiTracker's band-limited
+# synthesizer instead of averaging the APU mixer over each sample.
+#DEFINES += NES_BLIP_BUFFER
+
+contains(DEFINES,NES_BLIP_BUFFER) {
+   DEFINES += BLIP_BUFFER_STANDALONE
+   INCLUDEPATH += $$TOP/libs/famitracker/Source/Blip_Buffer
+   SOURCES += $$TOP/libs/famitracker/Source/Blip_Buffer/Blip_Buffer.cpp
+   HEADERS += $$TOP/libs/famitracker/Source/Blip_Buffer/Blip_Buffer.h
+}
+
 INCLUDEPATH += . \
                ./common \
                ./emulator \
@@ -83,6 +94,8 @@ SOURCES += \
    emulator/cnesrommapper002.cpp \
    emulator/cnesrommapper001.cpp \
    emulator/cnesrom.cpp \
+   emulator/cnessavestate.cpp \
+   emulator/cnesvrcirq.cpp \
    emulator/cnesppu.cpp \
    emulator/cnesio.cpp \
    emulator/cnesapu.cpp \
@@ -91,8 +104,10 @@ SOURCES += \
    common/cnessystempalette.cpp \
    nes_emulator_core.cpp \
    emulator/cmarker.cpp \
+   emulator/cprofiler.cpp \
    emulator/cjoypadlogger.cpp \
    emulator/ccodedatalogger.cpp \
+   emulator/ctracefile.cpp \
    emulator/ctracer.cpp \
    emulator/cnesbreakpointinfo.cpp \
    emulator/cnesrommapper033.cpp \
@@ -128,6 +143,8 @@ HEADERS +=\
    emulator/cnesrommapper002.h \
    emulator/cnesrommapper001.h \
    emulator/cnesrom.h \
+   emulator/cnessavestate.h \
+   emulator/cnesvrcirq.h \
    emulator/cnesppu.h \
    emulator/cnesio.h \
    emulator/cnesapu.h \
@@ -136,8 +153,10 @@ HEADERS +=\
    nes_emulator_core.h \
    common/cnessystempalette.h \
    emulator/cmarker.h \
+   emulator/cprofiler.h \
    emulator/cjoypadlogger.h \
    emulator/ccodedatalogger.h \
+   emulator/ctracefile.h \
    emulator/ctracer.h \
    emulator/cnesrommapper033.h \
    emulator/cnesrommapper069.h \
@@ -7,9 +7,12 @@
 #include "cnes6502.h"
 #include "cnesrommapper001.h"
 #include "cnesrommapper004.h"
+#include "cnesrommapper005.h"
 #include "cnesrommapper009.h"
 #include "cnesrommapper010.h"
 #include "cnesrommapper016.h"
+#include "cnesrommapper019.h"
+#include "cnesrommapper024.h"
 #include "cnesrommapper028.h"
 #include "cnesrommapper069.h"
 
@@ -19,6 +22,30 @@
 #include "cmemorydata.h"
 #include "cbreakpointinfo.h"
 
+// The machine created by the emulator core on first use of an interface
+// that does not take a machine, or NULL until then.
+static CNES* nesDefault = NULL;
+
+static CNES* nesDefaultMachine ( void )
+{
+   static CNES* machine = (nesDefault = new CNES());
+   return machine;
+}
+
+// The machine selected by nesSetActiveMachine, or NULL if the default
+// machine is active.
+static CNES* nesActiveMachine = NULL;
+
+// The machine that interfaces which do not take a machine act upon.
+static inline CNES* NES ( void )
+{
+   return nesActiveMachine?nesActiveMachine:nesDefaultMachine();
+}
+
+// The memory write generation in which the active machine was last
+// switched.  Everything a debugger shows changes then.
+static uint32_t nesActiveMachineGeneration = 0;
+
 // CPU Registers
 static CBitfieldData* tblCPUPCBitfields [] =
 {
@@ -104,7 +131,13 @@ static CMemoryDatabase* m_db6502Memory = new CMemoryDatabase(eMemory_CPU,
                                                        nesGetCPUMemory,
                                                        nesSetCPUMemory,
                                                        nesGetPrintableAddress,
-                                                       true);
+                                                       true,
+                                                       NULL,
+                                                       NULL,
+                                                       NULL,
+                                                       NULL,
+                                                       nesAdvanceMemoryGeneration,
+                                                       nesCPUMemoryChangedSince);
 
 // CPU Event breakpoints
 static bool cpuAlwaysFireEvent(BreakpointInfo* pBreakpoint,int data)
@@ -857,7 +890,13 @@ static CMemoryDatabase* m_dbNameTableMemory = new CMemoryDatabase(eMemory_PPU,
                                                                 nesGetPPUMemory,
                                                                 nesSetPPUMemory,
                                                                 nesGetPrintableAddress,
-                                                                true);
+                                                                true,
+                                                                NULL,
+                                                                NULL,
+                                                                NULL,
+                                                                NULL,
+                                                                nesAdvanceMemoryGeneration,
+                                                                nesPPUMemoryChangedSince);
 
 // PPU Event breakpoints
 static bool ppuAlwaysFireEvent(BreakpointInfo* pBreakpoint,int data)
@@ -869,8 +908,8 @@ static bool ppuAlwaysFireEvent(BreakpointInfo* pBreakpoint,int data)
 
 static bool ppuRasterPositionEvent(BreakpointInfo* pBreakpoint,int data)
 {
-   if ( (pBreakpoint->item1 == CNES::NES()->PPU()->_X()) &&
-         (pBreakpoint->item2 == CNES::NES()->PPU()->_Y()) )
+   if ( (pBreakpoint->item1 == NES()->PPU()->_X()) &&
+         (pBreakpoint->item2 == NES()->PPU()->_Y()) )
    {
       return true;
    }
@@ -880,7 +919,7 @@ static bool ppuRasterPositionEvent(BreakpointInfo* pBreakpoint,int data)
 
 static bool ppuSpriteDmaEvent(BreakpointInfo* pBreakpoint,int data)
 {
-   if ( pBreakpoint->item1 == CNES::NES()->CPU()->WRITEDMAADDR() )
+   if ( pBreakpoint->item1 == NES()->CPU()->WRITEDMAADDR() )
    {
       return true;
    }
@@ -971,7 +1010,13 @@ static CMemoryDatabase* m_dbCartSRAMMemory = new CMemoryDatabase(eMemory_cartSRA
                                                            nesGetSRAMDataVirtual,
                                                            nesSetSRAMDataVirtual,
                                                            nesGetPrintableAddress,
-                                                           true);
+                                                           true,
+                                                           NULL,
+                                                           NULL,
+                                                           NULL,
+                                                           NULL,
+                                                           nesAdvanceMemoryGeneration,
+                                                           nesSRAMDataVirtualChangedSince);
 
 static CMemoryDatabase* m_dbCartEXRAMMemory = new CMemoryDatabase(eMemory_cartEXRAM,
                                                             EXRAM_START,
@@ -981,7 +1026,13 @@ static CMemoryDatabase* m_dbCartEXRAMMemory = new CMemoryDatabase(eMemory_cartEX
                                                             nesGetEXRAMData,
                                                             nesSetEXRAMData,
                                                             nesGetPrintableAddress,
-                                                            true);
+                                                            true,
+                                                            NULL,
+                                                            NULL,
+                                                            NULL,
+                                                            NULL,
+                                                            nesAdvanceMemoryGeneration,
+                                                            nesEXRAMDataChangedSince);
 
 static CMemoryDatabase* m_dbCartVRAMMemory = new CMemoryDatabase(eMemory_cartVRAM,
                                                             VRAM_START,
@@ -991,7 +1042,13 @@ static CMemoryDatabase* m_dbCartVRAMMemory = new CMemoryDatabase(eMemory_cartVRA
                                                             nesGetVRAMData,
                                                             nesSetVRAMData,
                                                             nesGetPrintableAddress,
-                                                            true);
+                                                            true,
+                                                            NULL,
+                                                            NULL,
+                                                            NULL,
+                                                            NULL,
+                                                            nesAdvanceMemoryGeneration,
+                                                            nesVRAMDataChangedSince);
 
 static bool returnFalse() { return false; }
 
@@ -1007,7 +1064,9 @@ static CMemoryDatabase* m_dbCartPRGROMMemory = new CMemoryDatabase(eMemory_cartR
                                                              NULL,
                                                              NULL,
                                                              NULL,
-                                                             returnFalse);
+                                                             returnFalse,
+                                                             nesAdvanceMemoryGeneration,
+                                                             nesPRGROMDataChangedSince);
 
 static CMemoryDatabase* m_dbCartCHRMemory = new CMemoryDatabase(eMemory_cartCHRMEM,
                                                           0,
@@ -1021,7 +1080,9 @@ static CMemoryDatabase* m_dbCartCHRMemory = new CMemoryDatabase(eMemory_cartCHRM
                                                           NULL,
                                                           NULL,
                                                           NULL,
-                                                          nesIsCHRRAM);
+                                                          nesIsCHRRAM,
+                                                          nesAdvanceMemoryGeneration,
+                                                          nesCHRMEMDataChangedSince);
 
 static char __emu_version__ [] = "v2.0.0"
 #if defined ( QT_NO_DEBUG )
@@ -1034,25 +1095,32 @@ char* nesGetVersion()
 {
    return __emu_version__;
 }
-extern int32_t apuDataAvailable;
 
 const char* hex_char = "0123456789ABCDEF";
 
-bool __nesdebug = false;
-
 void nesEnableDebug ( void )
 {
-   __nesdebug = true;
+   nesMachineEnableDebug(NES());
 }
 
 void nesDisableDebug ( void )
 {
-   __nesdebug = false;
+   nesMachineDisableDebug(NES());
+}
+
+bool nesStartTraceFile ( const char* fileName )
+{
+   return nesMachineStartTraceFile(NES(),fileName);
+}
+
+bool nesStopTraceFile ( void )
+{
+   return nesMachineStopTraceFile(NES());
 }
 
 void nesSetBreakOnKIL ( bool breakOnKIL )
 {
-   CNES::NES()->CPU()->BREAKONKIL(breakOnKIL);
+   NES()->CPU()->BREAKONKIL(breakOnKIL);
 }
 
 static void (*breakpointHook)(void) = NULL;
@@ -1085,6 +1153,256 @@ void nesBreakAudio ( void )
    }
 }
 
+NesMachine* nesCreateMachine ( void )
+{
+   return new CNES();
+}
+
+void nesDestroyMachine ( NesMachine* machine )
+{
+   // The default machine lives for the life of the process.
+   if ( machine == nesDefault )
+   {
+      return;
+   }
+
+   if ( machine == nesActiveMachine )
+   {
+      nesActiveMachine = NULL;
+   }
+
+   delete machine;
+}
+
+void nesSetActiveMachine ( NesMachine* machine )
+{
+   CNES* previous = nesActiveMachine?nesActiveMachine:nesDefault;
+   uint32_t generation = 0;
+
+   if ( previous )
+   {
+      generation = previous->MEMORYGENERATION()->load();
+   }
+
+   nesActiveMachine = machine;
+
+   // Each machine counts its own write generations.  Bring this one up to
+   // those handed out for the previous one, so that whatever a debugger
+   // last saw reads as older than the switch.
+   if ( NES()->MEMORYGENERATION()->load() < generation )
+   {
+      NES()->MEMORYGENERATION()->store(generation);
+   }
+   nesActiveMachineGeneration = NES()->MEMORYGENERATION()->load();
+}
+
+NesMachine* nesGetActiveMachine ( void )
+{
+   return NES();
+}
+
+void nesMachineSetSystemMode ( NesMachine* machine, uint32_t mode )
+{
+   machine->VIDEOMODE(mode);
+}
+
+uint32_t nesMachineGetSystemMode ( NesMachine* machine )
+{
+   return machine->VIDEOMODE();
+}
+
+void nesMachineSetTVOut ( NesMachine* machine, int8_t* tv )
+{
+   machine->PPU()->TV ( tv );
+}
+
+int8_t* nesMachineGetTVOut ( NesMachine* machine )
+{
+   return machine->PPU()->TV();
+}
+
+void nesMachineSetTVOutFormat ( NesMachine* machine, uint32_t format )
+{
+   machine->PPU()->TVFORMAT ( format );
+}
+
+uint32_t nesMachineGetTVOutFormat ( NesMachine* machine )
+{
+   return machine->PPU()->TVFORMAT();
+}
+
+void nesMachineFrontload ( NesMachine* machine, uint32_t mapper )
+{
+   machine->FRONTLOAD(mapper);
+}
+
+void nesMachineLoadPRGROMBank ( NesMachine* machine, uint32_t bank, uint8_t* bankData )
+{
+   machine->CART()->SetPRGBank ( bank, bankData );
+}
+
+void nesMachineLoadCHRROMBank ( NesMachine* machine, uint32_t bank, uint8_t* bankData )
+{
+   machine->CART()->SetCHRBank ( bank, bankData );
+}
+
+void nesMachineSetHorizontalMirroring ( NesMachine* machine )
+{
+   machine->PPU()->MIRRORHORIZ();
+}
+
+void nesMachineSetVerticalMirroring ( NesMachine* machine )
+{
+   machine->PPU()->MIRRORVERT();
+}
+
+void nesMachineSetFourScreen ( NesMachine* machine )
+{
+   machine->PPU()->MIRROR(-1,true);
+}
+
+void nesMachineFinalizeLoad ( NesMachine* machine )
+{
+   machine->CART()->DoneLoadingBanks();
+}
+
+bool nesMachineROMIsLoaded ( NesMachine* machine )
+{
+   return ( machine->CART()?true:false );
+}
+
+void nesMachineReset ( NesMachine* machine, bool soft )
+{
+   machine->RESET(soft);
+}
+
+void nesMachineRun ( NesMachine* machine, uint32_t* joypads )
+{
+   machine->RUN(joypads);
+}
+
+int32_t nesMachineGetAudioSamplesAvailable ( NesMachine* machine )
+{
+   return machine->CPU()->APU()->SAMPLESAVAILABLE();
+}
+
+void nesMachineClearAudioSamplesAvailable ( NesMachine* machine )
+{
+   machine->CPU()->APU()->CLEARSAMPLESAVAILABLE();
+}
+
+uint8_t* nesMachineGetAudioSamples ( NesMachine* machine, uint16_t samples )
+{
+   return machine->CPU()->APU()->PLAY(samples);
+}
+
+void nesMachineSetAudioChannelMask ( NesMachine* machine, uint8_t mask )
+{
+   machine->CPU()->APU()->MUTE(mask);
+}
+
+void nesMachineSetMMC5AudioChannelMask ( NesMachine* machine, uint32_t mask )
+{
+   machine->MMC5AUDIOMASK(mask);
+}
+
+void nesMachineSetVRC6AudioChannelMask ( NesMachine* machine, uint32_t mask )
+{
+   machine->VRC6AUDIOMASK(mask);
+}
+
+void nesMachineSetN106AudioChannelMask ( NesMachine* machine, uint32_t mask )
+{
+   machine->N106AUDIOMASK(mask);
+}
+
+void nesMachineSetControllerType ( NesMachine* machine, int32_t port, int32_t type )
+{
+   machine->CONTROLLER(port,type);
+}
+
+void nesMachineSetControllerScreenPosition ( NesMachine* machine, int32_t port, int32_t px, int32_t py, int32_t wx1, int32_t wy1, int32_t wx2, int32_t wy2 )
+{
+   machine->CONTROLLERPOSITION(port,px,py,wx1,wy1,wx2,wy2);
+}
+
+void nesMachineSetControllerSpecial ( NesMachine* machine, int32_t port, int32_t special )
+{
+   // Note this function must be called after nesMachineSetControllerType is
+   // called otherwise the wrong controller type's special setting will
+   // be modified.
+   if ( iofunc[machine->CONTROLLER(port)].special )
+   {
+      iofunc[machine->CONTROLLER(port)].special(machine->IO(),port,special);
+   }
+}
+
+void nesMachineResetInputRecording ( NesMachine* machine )
+{
+   CIOStandardJoypad::LOGGER(machine->IO(),0)->ClearSampleBuffer();
+   CIOStandardJoypad::LOGGER(machine->IO(),1)->ClearSampleBuffer();
+}
+
+void nesMachineSetInputPlayback ( NesMachine* machine, bool enable )
+{
+   machine->REPLAY(enable);
+}
+
+void nesMachineSetInputRecording ( NesMachine* machine, bool enable )
+{
+   machine->RECORD(enable);
+}
+
+uint32_t nesMachineGetInputSamplesAvailable ( NesMachine* machine, int32_t port )
+{
+   return CIOStandardJoypad::LOGGER(machine->IO(),port)->GetNumSamples();
+}
+
+uint32_t nesMachineGetFrame ( NesMachine* machine )
+{
+   return machine->FRAME();
+}
+
+uint32_t nesMachineGetCPUCycle ( NesMachine* machine )
+{
+   return machine->CPU()->_CYCLES();
+}
+
+uint32_t nesMachineSaveState ( NesMachine* machine, uint8_t* buffer, uint32_t size )
+{
+   return machine->SAVESTATE(buffer,size);
+}
+
+bool nesMachineLoadState ( NesMachine* machine, const uint8_t* buffer, uint32_t size )
+{
+   return machine->LOADSTATE(buffer,size);
+}
+
+bool nesMachineStartTraceFile ( NesMachine* machine, const char* fileName )
+{
+   return machine->TRACER()->StartFile(fileName);
+}
+
+bool nesMachineStopTraceFile ( NesMachine* machine )
+{
+   return machine->TRACER()->StopFile();
+}
+
+void nesMachineEnableDebug ( NesMachine* machine )
+{
+   machine->DEBUGGABLE(true);
+}
+
+void nesMachineDisableDebug ( NesMachine* machine )
+{
+   machine->DEBUGGABLE(false);
+}
+
+bool nesMachineIsDebuggable ( NesMachine* machine )
+{
+   return machine->DEBUGGABLE();
+}
+
 uint32_t nesGetNumColors ( void )
 {
    return 64;
@@ -1092,161 +1410,189 @@ uint32_t nesGetNumColors ( void )
 
 void nesSetSystemMode ( uint32_t mode )
 {
-   CNES::NES()->VIDEOMODE(mode);
+   nesMachineSetSystemMode(NES(),mode);
 }
 
 uint32_t nesGetSystemMode ( void )
 {
-   return CNES::NES()->VIDEOMODE();
+   return nesMachineGetSystemMode(NES());
 }
 
 void nesGetPrintableAddress ( char* buffer, uint32_t virtAddr )
 {
-   CNES::NES()->PRINTABLEADDR(buffer,virtAddr);
+   NES()->PRINTABLEADDR(buffer,virtAddr);
 }
 
 void nesGetPrintablePhysicalAddress ( char* buffer, uint32_t virtAddr, uint32_t physAddr )
 {
-   CNES::NES()->PRINTABLEADDR(buffer,virtAddr,physAddr);
+   NES()->PRINTABLEADDR(buffer,virtAddr,physAddr);
 }
 
 void nesSetControllerType ( int32_t port, int32_t type )
 {
-   CNES::NES()->CONTROLLER(port,type);
+   nesMachineSetControllerType(NES(),port,type);
 }
 
 void nesSetControllerScreenPosition ( int32_t port, int32_t px, int32_t py, int32_t wx1, int32_t wy1, int32_t wx2, int32_t wy2 )
 {
-   CNES::NES()->CONTROLLERPOSITION(port,px,py,wx1,wy1,wx2,wy2);
+   nesMachineSetControllerScreenPosition(NES(),port,px,py,wx1,wy1,wx2,wy2);
 }
 
 void nesSetControllerSpecial ( int32_t port, int32_t special )
 {
-   // Note this function must be called after nesSetControllerType is
-   // called otherwise the wrong controller type's special setting will
-   // be modified.
-   if ( iofunc[CNES::NES()->CONTROLLER(port)].special )
-   {
-      iofunc[CNES::NES()->CONTROLLER(port)].special(port,special);
-   }
+   nesMachineSetControllerSpecial(NES(),port,special);
 }
 
 void nesEnableBreakpoints ( bool enable )
 {
-   CNES::NES()->BREAKPOINTS(enable);
+   NES()->BREAKPOINTS(enable);
 }
 
 void nesStepCpu ( void )
 {
-   CNES::NES()->STEPCPUBREAKPOINT();
+   NES()->STEPCPUBREAKPOINT();
 }
 
 void nesStepPpu ( void )
 {
-   CNES::NES()->STEPPPUBREAKPOINT();
+   NES()->STEPPPUBREAKPOINT();
 }
 
 void nesStepPpuFrame ( void )
 {
-   CNES::NES()->STEPPPUBREAKPOINT(true);
+   NES()->STEPPPUBREAKPOINT(true);
 }
 
 void nesResetInputRecording ( void )
 {
-   CIOStandardJoypad::LOGGER(0)->ClearSampleBuffer();
-   CIOStandardJoypad::LOGGER(1)->ClearSampleBuffer();
+   nesMachineResetInputRecording(NES());
 }
 
 void nesSetInputPlayback ( bool enable )
 {
-   CNES::NES()->REPLAY(enable);
+   nesMachineSetInputPlayback(NES(),enable);
 }
 
 void nesSetInputRecording ( bool enable )
 {
-   CNES::NES()->RECORD(enable);
+   nesMachineSetInputRecording(NES(),enable);
 }
 
 uint32_t nesGetInputSamplesAvailable ( int32_t port )
 {
-   return CIOStandardJoypad::LOGGER(port)->GetNumSamples();
+   return nesMachineGetInputSamplesAvailable(NES(),port);
+}
+
+JoypadLoggerInfo* nesMachineGetInputSample ( NesMachine* machine, int32_t port, int sample )
+{
+   return CIOStandardJoypad::LOGGER(machine->IO(),port)->GetSample(sample);
+}
+
+void nesMachineSetInputSample ( NesMachine* machine, int32_t port, JoypadLoggerInfo* sample )
+{
+   CIOStandardJoypad::LOGGER(machine->IO(),port)->AddSample(sample->cycle,sample->data);
 }
 
 JoypadLoggerInfo* nesGetInputSample ( int32_t port, int sample )
 {
-   return CIOStandardJoypad::LOGGER(port)->GetSample(sample);
+   return nesMachineGetInputSample(NES(),port,sample);
 }
 
 void nesSetInputSample ( int32_t port, JoypadLoggerInfo* sample )
 {
-   CIOStandardJoypad::LOGGER(port)->AddSample(sample->cycle,sample->data);
+   nesMachineSetInputSample(NES(),port,sample);
 }
 
 void nesGetInputSamples ( int32_t port, JoypadLoggerInfo** samples )
 {
-   (*samples) = CIOStandardJoypad::LOGGER(port)->GetSample(0);
+   (*samples) = CIOStandardJoypad::LOGGER(NES()->IO(),port)->GetSample(0);
 }
 
 CTracer* nesGetExecutionTracerDatabase ( void )
 {
-   return CNES::NES()->TRACER();
+   return NES()->TRACER();
 }
 
 CMarker* nesGetExecutionMarkerDatabase ( void )
 {
-   return CNES::NES()->CPU()->MARKERS();
+   return NES()->CPU()->MARKERS();
+}
+
+void nesEnableProfiler ( bool enable )
+{
+   NES()->CPU()->PROFILER()->Enable ( enable );
+}
+
+bool nesIsProfilerEnabled ( void )
+{
+   return NES()->CPU()->PROFILER()->IsEnabled();
+}
+
+void nesClearProfiler ( void )
+{
+   NES()->CPU()->PROFILER()->Clear();
+}
+
+CProfiler* nesGetProfilerDatabase ( void )
+{
+   return NES()->CPU()->PROFILER();
 }
 
 void nesClearCodeDataLoggerDatabases ( void )
 {
    unsigned int addr;
 
-   CNES::NES()->CPU()->LOGGER()->ClearData();
+   NES()->CPU()->LOGGER()->ClearData();
 
    for ( addr = 0; addr < nesGetPRGROMSize(); addr += MEM_8KB )
    {
-      CNES::NES()->CART()->LOGGERPHYS(addr)->ClearData();
+      NES()->CART()->LOGGERPHYS(addr)->ClearData();
    }
 }
 
+uint32_t nesGetCodeDataLoggerCycle ( void )
+{
+   return NES()->LOGGERSTATE()->curCycle;
+}
+
 CCodeDataLogger* nesGetCpuCodeDataLoggerDatabase ( void )
 {
-   return CNES::NES()->CPU()->LOGGER();
+   return NES()->CPU()->LOGGER();
 }
 
 CCodeDataLogger* nesGetVirtualPRGROMCodeDataLoggerDatabase ( uint32_t addr )
 {
-   return CNES::NES()->CART()->LOGGERVIRT(addr);
+   return NES()->CART()->LOGGERVIRT(addr);
 }
 
 CCodeDataLogger* nesGetPhysicalPRGROMCodeDataLoggerDatabase ( uint32_t addr )
 {
-   return CNES::NES()->CART()->LOGGERPHYS(addr);
+   return NES()->CART()->LOGGERPHYS(addr);
 }
 
 CCodeDataLogger* nesGetEXRAMCodeDataLoggerDatabase ( void )
 {
-   return CNES::NES()->CART()->EXRAMLOGGER();
+   return NES()->CART()->EXRAMLOGGER();
 }
 
 CCodeDataLogger* nesGetVirtualSRAMCodeDataLoggerDatabase ( uint32_t addr )
 {
-   return CNES::NES()->CART()->SRAMLOGGERVIRT(addr);
+   return NES()->CART()->SRAMLOGGERVIRT(addr);
 }
 
 CCodeDataLogger* nesGetPhysicalSRAMCodeDataLoggerDatabase ( uint32_t addr )
 {
-   return CNES::NES()->CART()->SRAMLOGGERPHYS(addr);
+   return NES()->CART()->SRAMLOGGERPHYS(addr);
 }
 
 CCodeDataLogger* nesGetPpuCodeDataLoggerDatabase ( void )
 {
-   return CNES::NES()->PPU()->LOGGER();
+   return NES()->PPU()->LOGGER();
 }
 
 CBreakpointInfo* nesGetBreakpointDatabase ( void )
 {
-   return CNES::NES()->BREAKPOINTS();
+   return NES()->BREAKPOINTS();
 }
 
 CRegisterDatabase* nesGetCpuRegisterDatabase ( void )
@@ -1356,7 +1702,7 @@ CBreakpointEventInfo** nesGetCartridgeBreakpointEventDatabase ( void )
 
 void nesDisassemble ()
 {
-   CNES::NES()->DISASSEMBLE();
+   NES()->DISASSEMBLE();
 }
 
 void nesDisassembleSingle ( uint8_t* pOpcode, char* buffer )
@@ -1366,190 +1712,226 @@ void nesDisassembleSingle ( uint8_t* pOpcode, char* buffer )
 
 char* nesGetDisassemblyAtAddress ( uint32_t addr )
 {
-   return CNES::NES()->DISASSEMBLY(addr);
+   return NES()->DISASSEMBLY(addr);
 }
 
 void nesGetDisassemblyAtPhysicalAddress ( uint32_t physAddr, char* buffer )
 {
-   CNES::NES()->CART()->PRGROMDISASSEMBLYATPHYSADDR(physAddr,buffer);
+   NES()->CART()->PRGROMDISASSEMBLYATPHYSADDR(physAddr,buffer);
 }
 
 uint32_t nesGetVirtualAddressFromSLOC ( uint16_t sloc )
 {
-   return CNES::NES()->SLOC2VIRTADDR(sloc);
+   return NES()->SLOC2VIRTADDR(sloc);
 }
 
 uint16_t nesGetSLOCFromAddress ( uint32_t addr )
 {
-   return CNES::NES()->ADDR2SLOC(addr);
+   return NES()->ADDR2SLOC(addr);
 }
 
 uint32_t nesGetSLOC ( uint32_t addr )
 {
-   return CNES::NES()->SLOC(addr);
+   return NES()->SLOC(addr);
 }
 
 uint32_t nesGetPhysicalAddressFromAddress ( uint32_t addr )
 {
-   return CNES::NES()->PHYSADDR(addr);
+   return NES()->PHYSADDR(addr);
 }
 
 void nesClearOpcodeMasks ( void )
 {
-   CNES::NES()->CPU()->OPCODEMASKCLR ();
-   CNES::NES()->CART()->PRGROMOPCODEMASKCLR ();
-   CNES::NES()->CART()->SRAMOPCODEMASKCLR ();
-   CNES::NES()->CART()->EXRAMOPCODEMASKCLR ();
+   NES()->CPU()->OPCODEMASKCLR ();
+   NES()->CART()->PRGROMOPCODEMASKCLR ();
+   NES()->CART()->SRAMOPCODEMASKCLR ();
+   NES()->CART()->EXRAMOPCODEMASKCLR ();
 }
 
 void nesSetOpcodeMask ( uint32_t addr, uint8_t mask )
 {
-   CNES::NES()->CART()->PRGROMOPCODEMASKATPHYSADDR(addr, mask);
+   NES()->CART()->PRGROMOPCODEMASKATPHYSADDR(addr, mask);
 }
 
 void nesSetTVOut ( int8_t* tv )
 {
-   CNES::NES()->PPU()->TV ( tv );
+   nesMachineSetTVOut(NES(),tv);
+}
+
+void nesSetTVOutFormat ( uint32_t format )
+{
+   nesMachineSetTVOutFormat(NES(),format);
+}
+
+uint32_t nesGetTVOutFormat ( void )
+{
+   return nesMachineGetTVOutFormat(NES());
+}
+
+void nesConvertTVOut ( const int8_t* indexed, int8_t* rgba )
+{
+   const uint8_t* pIndexed = (const uint8_t*)indexed;
+   const uint8_t* pEmphasis = pIndexed+TV_INDEXED_EMPHASIS_OFFSET;
+   uint32_t* pRGBA = (uint32_t*)rgba;
+   uint8_t pixel;
+   int32_t x, y;
+
+   for ( y = 0; y < 240; y++ )
+   {
+      for ( x = 0; x < 256; x++ )
+      {
+         pixel = *pIndexed++;
+         *pRGBA++ = *(CBasePalette::GetTVPalette(*(pEmphasis+(pixel>>6)))+(pixel&0x3F));
+      }
+      pEmphasis += 4;
+   }
 }
 
 void nesFrontload ( uint32_t mapper )
 {
-   CNES::NES()->FRONTLOAD(mapper);
+   nesMachineFrontload(NES(),mapper);
 }
 
 void nesLoadPRGROMBank ( uint32_t bank, uint8_t* bankData )
 {
-   CNES::NES()->CART()->SetPRGBank ( bank, bankData );
+   nesMachineLoadPRGROMBank(NES(),bank,bankData);
 }
 
 void nesLoadCHRROMBank ( uint32_t bank, uint8_t* bankData )
 {
-   CNES::NES()->CART()->SetCHRBank ( bank, bankData );
+   nesMachineLoadCHRROMBank(NES(),bank,bankData);
 }
 
 void nesFinalizeLoad ( void )
 {
-   CNES::NES()->CART()->DoneLoadingBanks();
+   nesMachineFinalizeLoad(NES());
 }
 
 bool nesROMIsLoaded ( void )
 {
-   return ( CNES::NES()->CART()?true:false );
+   return nesMachineROMIsLoaded(NES());
 }
 
 void nesSetHorizontalMirroring ( void )
 {
-   CNES::NES()->PPU()->MIRRORHORIZ();
+   nesMachineSetHorizontalMirroring(NES());
 }
 
 void nesSetVerticalMirroring ( void )
 {
-   CNES::NES()->PPU()->MIRRORVERT();
+   nesMachineSetVerticalMirroring(NES());
 }
 
 void nesSetFourScreen ( void )
 {
-   CNES::NES()->PPU()->MIRROR(-1,true);
+   nesMachineSetFourScreen(NES());
 }
 
 void nesReset ( bool soft )
 {
-   CNES::NES()->RESET(soft);
+   nesMachineReset(NES(),soft);
 }
 
 void nesResetInitial ()
 {
-   CNES::NES()->RESET(false);
+   nesMachineReset(NES(),false);
 }
 
 void nesRun ( uint32_t* joypads )
 {
-   CNES::NES()->RUN(joypads);
+   nesMachineRun(NES(),joypads);
+}
+
+uint32_t nesSaveState ( uint8_t* buffer, uint32_t size )
+{
+   return nesMachineSaveState(NES(),buffer,size);
+}
+
+bool nesLoadState ( const uint8_t* buffer, uint32_t size )
+{
+   return nesMachineLoadState(NES(),buffer,size);
 }
 
 uint8_t* nesGetAudioSamples ( uint16_t samples )
 {
-   return CNES::NES()->CPU()->APU()->PLAY(samples);
+   return nesMachineGetAudioSamples(NES(),samples);
 }
 
 int32_t nesGetAudioSamplesAvailable ( void )
 {
-   return apuDataAvailable;
+   return nesMachineGetAudioSamplesAvailable(NES());
 }
 
 void nesClearAudioSamplesAvailable ( void )
 {
-   apuDataAvailable = 0;
+   nesMachineClearAudioSamplesAvailable(NES());
 }
 
 uint32_t nesGetCPUCycle ( void )
 {
-   return CNES::NES()->CPU()->_CYCLES();
+   return NES()->CPU()->_CYCLES();
 }
 
 void nesSetGotoAddress ( uint32_t addr )
 {
    if ( addr == 0xFFFFFFFF )
    {
-      CNES::NES()->CPU()->GOTO ();
+      NES()->CPU()->GOTO ();
    }
    else
    {
-      CNES::NES()->CPU()->GOTO ( addr );
+      NES()->CPU()->GOTO ( addr );
    }
 }
 
 bool nesCPUIsFetchingOpcode ( void )
 {
-   return CNES::NES()->CPU()->_SYNC();
+   return NES()->CPU()->_SYNC();
 }
 
 bool nesCPUIsWritingMemory ( void )
 {
-   return CNES::NES()->CPU()->_WRITING();
+   return NES()->CPU()->_WRITING();
 }
 
 int8_t* nesGetTVOut ( void )
 {
-   return CNES::NES()->PPU()->TV();
+   return nesMachineGetTVOut(NES());
 }
 
-#include "cnesrommapper005.h"
 void nesSetMMC5AudioChannelMask ( uint32_t mask )
 {
-   CROMMapper005::SOUNDENABLE(mask);
+   nesMachineSetMMC5AudioChannelMask(NES(),mask);
 }
 
-#include "cnesrommapper024.h"
 void nesSetVRC6AudioChannelMask ( uint32_t mask )
 {
-   CROMMapper024::SOUNDENABLE(mask);
+   nesMachineSetVRC6AudioChannelMask(NES(),mask);
 }
 
-#include "cnesrommapper019.h"
 void nesSetN106AudioChannelMask ( uint32_t mask )
 {
-   CROMMapper019::SOUNDENABLE(mask);
+   nesMachineSetN106AudioChannelMask(NES(),mask);
 }
 
 void nesSetAudioChannelMask ( uint8_t mask )
 {
-   CNES::NES()->CPU()->APU()->MUTE(mask);
+   nesMachineSetAudioChannelMask(NES(),mask);
 }
 
 uint32_t nesGetCPUEffectiveAddress ( void )
 {
-   return CNES::NES()->CPU()->_EA();
+   return NES()->CPU()->_EA();
 }
 
 uint32_t nesGetCPUProgramCounter( void )
 {
-   return CNES::NES()->CPU()->__PC();
+   return NES()->CPU()->__PC();
 }
 
 uint32_t nesGetCPUProgramCounterOfLastSync( void )
 {
-   return CNES::NES()->CPU()->__PCSYNC();
+   return NES()->CPU()->__PCSYNC();
 }
 
 void nesSetCPURegister ( uint32_t addr, uint32_t data )
@@ -1557,22 +1939,22 @@ void nesSetCPURegister ( uint32_t addr, uint32_t data )
    switch ( addr )
    {
    case CPU_PC:
-      CNES::NES()->CPU()->__PC(data);
+      NES()->CPU()->__PC(data);
       break;
    case CPU_SP:
-      CNES::NES()->CPU()->_SP(data);
+      NES()->CPU()->_SP(data);
       break;
    case CPU_A:
-      CNES::NES()->CPU()->_A(data);
+      NES()->CPU()->_A(data);
       break;
    case CPU_X:
-      CNES::NES()->CPU()->_X(data);
+      NES()->CPU()->_X(data);
       break;
    case CPU_Y:
-      CNES::NES()->CPU()->_Y(data);
+      NES()->CPU()->_Y(data);
       break;
    case CPU_F:
-      CNES::NES()->CPU()->_F(data);
+      NES()->CPU()->_F(data);
       break;
    case VECTOR_IRQ:
       // Can't chage.
@@ -1591,31 +1973,31 @@ uint32_t nesGetCPURegister( uint32_t addr )
    switch ( addr )
    {
    case CPU_PC:
-      return CNES::NES()->CPU()->__PC();
+      return NES()->CPU()->__PC();
       break;
    case CPU_SP:
-      return 0x100|CNES::NES()->CPU()->_SP();
+      return 0x100|NES()->CPU()->_SP();
       break;
    case CPU_A:
-      return CNES::NES()->CPU()->_A();
+      return NES()->CPU()->_A();
       break;
    case CPU_X:
-      return CNES::NES()->CPU()->_X();
+      return NES()->CPU()->_X();
       break;
    case CPU_Y:
-      return CNES::NES()->CPU()->_Y();
+      return NES()->CPU()->_Y();
       break;
    case CPU_F:
-      return CNES::NES()->CPU()->_F();
+      return NES()->CPU()->_F();
       break;
    case VECTOR_IRQ:
-      return MAKE16(CNES::NES()->CPU()->_MEM(VECTOR_IRQ),CNES::NES()->CPU()->_MEM(VECTOR_IRQ+1));
+      return MAKE16(NES()->CPU()->_MEM(VECTOR_IRQ),NES()->CPU()->_MEM(VECTOR_IRQ+1));
       break;
    case VECTOR_RESET:
-      return MAKE16(CNES::NES()->CPU()->_MEM(VECTOR_RESET),CNES::NES()->CPU()->_MEM(VECTOR_RESET+1));
+      return MAKE16(NES()->CPU()->_MEM(VECTOR_RESET),NES()->CPU()->_MEM(VECTOR_RESET+1));
       break;
    case VECTOR_NMI:
-      return MAKE16(CNES::NES()->CPU()->_MEM(VECTOR_NMI),CNES::NES()->CPU()->_MEM(VECTOR_NMI+1));
+      return MAKE16(NES()->CPU()->_MEM(VECTOR_NMI),NES()->CPU()->_MEM(VECTOR_NMI+1));
       break;
    }
    return 0;
@@ -1623,164 +2005,181 @@ uint32_t nesGetCPURegister( uint32_t addr )
 
 uint32_t nesGetCPUFlagNegative ( void )
 {
-   return CNES::NES()->CPU()->_N();
+   return NES()->CPU()->_N();
 }
 
 uint32_t nesGetCPUFlagOverflow ( void )
 {
-   return CNES::NES()->CPU()->_V();
+   return NES()->CPU()->_V();
 }
 
 uint32_t nesGetCPUFlagBreak ( void )
 {
-   return CNES::NES()->CPU()->_B();
+   return NES()->CPU()->_B();
 }
 
 uint32_t nesGetCPUFlagDecimal ( void )
 {
-   return CNES::NES()->CPU()->_D();
+   return NES()->CPU()->_D();
 }
 
 uint32_t nesGetCPUFlagInterrupt ( void )
 {
-   return CNES::NES()->CPU()->_I();
+   return NES()->CPU()->_I();
 }
 
 uint32_t nesGetCPUFlagZero ( void )
 {
-   return CNES::NES()->CPU()->_Z();
+   return NES()->CPU()->_Z();
 }
 
 uint32_t nesGetCPUFlagCarry ( void )
 {
-   return CNES::NES()->CPU()->_C();
+   return NES()->CPU()->_C();
 }
 
 void nesSetCPUFlagNegative ( uint32_t set )
 {
-   CNES::NES()->CPU()->_N(set);
+   NES()->CPU()->_N(set);
 }
 
 void nesSetCPUFlagOverflow ( uint32_t set )
 {
-   CNES::NES()->CPU()->_V(set);
+   NES()->CPU()->_V(set);
 }
 
 void nesSetCPUFlagBreak ( uint32_t set )
 {
-   CNES::NES()->CPU()->_B(set);
+   NES()->CPU()->_B(set);
 }
 
 void nesSetCPUFlagDecimal ( uint32_t set )
 {
-   CNES::NES()->CPU()->_D(set);
+   NES()->CPU()->_D(set);
 }
 
 void nesSetCPUFlagInterrupt ( uint32_t set )
 {
-   CNES::NES()->CPU()->_I(set);
+   NES()->CPU()->_I(set);
 }
 
 void nesSetCPUFlagZero ( uint32_t set )
 {
-   CNES::NES()->CPU()->_Z(set);
+   NES()->CPU()->_Z(set);
 }
 
 void nesSetCPUFlagCarry ( uint32_t set )
 {
-   CNES::NES()->CPU()->_C(set);
+   NES()->CPU()->_C(set);
 }
 
 uint32_t nesGetPPUMemory ( uint32_t addr )
 {
-   return CNES::NES()->PPU()->_MEM(addr);
+   return NES()->PPU()->_MEM(addr);
 }
 
 void nesSetPPUMemory ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->PPU()->_MEM(addr,data);
+   NES()->PPU()->_MEM(addr,data);
+}
+
+bool nesPPUMemoryChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->PPU()->_MEMCHANGEDSINCE(addr,length,generation);
 }
 
 uint32_t nesGetCPUMemory ( uint32_t addr )
 {
-   return CNES::NES()->CPU()->_MEM(addr);
+   return NES()->CPU()->_MEM(addr);
 }
 
 void nesSetCPUMemory ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CPU()->_MEM(addr,data);
+   NES()->CPU()->_MEM(addr,data);
+}
+
+bool nesCPUMemoryChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->CPU()->_MEMCHANGEDSINCE(addr,length,generation);
 }
 
 uint8_t nesGetMemory ( uint32_t addr )
 {
-   return CNES::NES()->_MEM(addr);
+   return NES()->_MEM(addr);
+}
+
+uint32_t nesAdvanceMemoryGeneration ( void )
+{
+   return ++(*NES()->MEMORYGENERATION());
 }
 
 uint32_t nesGetPPUCycle ( void )
 {
-   return CNES::NES()->PPU()->_CYCLES();
+   return NES()->PPU()->_CYCLES();
 }
 
 uint32_t nesGetPPURegister ( uint32_t addr )
 {
-   return CNES::NES()->PPU()->_PPU(addr);
+   return NES()->PPU()->_PPU(addr);
 }
 
 void nesSetPPURegister ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->PPU()->_PPU(addr,data);
+   NES()->PPU()->_PPU(addr,data);
 }
 
 uint16_t nesGetScrollXAtXY ( int32_t x, int32_t y )
 {
-   return CNES::NES()->PPU()->_SCROLLX(x,y);
+   return NES()->PPU()->_SCROLLX(x,y);
 }
 
 uint16_t nesGetScrollYAtXY ( int32_t x, int32_t y )
 {
-   return CNES::NES()->PPU()->_SCROLLY(x,y);
+   return NES()->PPU()->_SCROLLY(x,y);
 }
 
 void nesGetCurrentScroll ( uint8_t* x, uint8_t* y )
 {
-   return CNES::NES()->PPU()->_SCROLL(x,y);
+   return NES()->PPU()->_SCROLL(x,y);
 }
 
 void nesGetLastSprite0Hit ( uint8_t* x, uint8_t* y )
 {
-   (*x) = CNES::NES()->PPU()->_SPRITE0HITX();
-   (*y) = CNES::NES()->PPU()->_SPRITE0HITY();
+   (*x) = NES()->PPU()->_SPRITE0HITX();
+   (*y) = NES()->PPU()->_SPRITE0HITY();
 }
 
 void nesGetCurrentPixel ( uint8_t* x, uint8_t* y )
 {
-   (*x) = CNES::NES()->PPU()->_X();
-   (*y) = CNES::NES()->PPU()->_Y();
+   (*x) = NES()->PPU()->_X();
+   (*y) = NES()->PPU()->_Y();
 }
 
 void nesGetMirroring ( uint16_t* sc1, uint16_t* sc2, uint16_t* sc3, uint16_t* sc4 )
 {
-   CNES::NES()->PPU()->_MIRROR(sc1,sc2,sc3,sc4);
+   NES()->PPU()->_MIRROR(sc1,sc2,sc3,sc4);
 }
 
 uint32_t nesGetAPUCycle ( void )
 {
-   return CNES::NES()->CPU()->APU()->CYCLES();
+   return NES()->CPU()->APU()->CYCLES();
 }
 
 uint32_t nesGetAPURegister ( uint32_t addr )
 {
-   return CNES::NES()->CPU()->APU()->_APU(addr);
+   return NES()->CPU()->APU()->_APU(addr);
 }
 
 void nesSetAPURegister ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CPU()->APU()->_APU(addr,data);
+   NES()->CPU()->APU()->_APU(addr,data);
 }
 
 int32_t nesGetAPUSequencerMode ( void )
 {
-   return CNES::NES()->CPU()->APU()->SEQUENCERMODE();
+   return NES()->CPU()->APU()->SEQUENCERMODE();
 }
 
 void nesGetAPULengthCounters( uint16_t* sq1,
@@ -1789,12 +2188,12 @@ void nesGetAPULengthCounters( uint16_t* sq1,
                               uint16_t* noise,
                               uint16_t* dmc)
 {
-   CNES::NES()->CPU()->APU()->LENGTHCOUNTERS(sq1,sq2,triangle,noise,dmc);
+   NES()->CPU()->APU()->LENGTHCOUNTERS(sq1,sq2,triangle,noise,dmc);
 }
 
 void nesGetAPUTriangleLinearCounter ( uint8_t* triangle )
 {
-   CNES::NES()->CPU()->APU()->LINEARCOUNTER(triangle);
+   NES()->CPU()->APU()->LINEARCOUNTER(triangle);
 }
 
 void nesGetAPUDACs ( uint8_t* sq1,
@@ -1803,211 +2202,241 @@ void nesGetAPUDACs ( uint8_t* sq1,
                      uint8_t* noise,
                      uint8_t* dmc )
 {
-   CNES::NES()->CPU()->APU()->GETDACS(sq1,sq2,triangle,noise,dmc);
+   NES()->CPU()->APU()->GETDACS(sq1,sq2,triangle,noise,dmc);
 }
 
 void nesGetAPUDMCIRQ ( bool* enabled,
                        bool* asserted )
 {
-   CNES::NES()->CPU()->APU()->DMCIRQ(enabled,asserted);
+   NES()->CPU()->APU()->DMCIRQ(enabled,asserted);
 }
 
 void nesGetAPUDMCSampleInfo ( uint16_t* addr,
                               uint16_t* length,
                               uint16_t* pos )
 {
-   CNES::NES()->CPU()->APU()->SAMPLEINFO(addr,length,pos);
+   NES()->CPU()->APU()->SAMPLEINFO(addr,length,pos);
 }
 
 void nesGetAPUDMCDMAInfo ( uint8_t* buffer,
                            bool* full )
 {
-   CNES::NES()->CPU()->APU()->DMAINFO(buffer,full);
+   NES()->CPU()->APU()->DMAINFO(buffer,full);
 }
 
 uint32_t nesGetPRGROMSize ( void )
 {
-   return CNES::NES()->CART()->NUMPRGROMBANKS()*MEM_8KB;
+   return NES()->CART()->NUMPRGROMBANKS()*MEM_8KB;
 }
 
 uint32_t nesGetNumPRGROMBanks ( void )
 {
-   return CNES::NES()->CART()->NUMPRGROMBANKS();
+   return NES()->CART()->NUMPRGROMBANKS();
 }
 
 uint32_t nesGetNumCHRROMBanks ( void )
 {
-   return CNES::NES()->CART()->NUMCHRROMBANKS();
+   return NES()->CART()->NUMCHRROMBANKS();
 }
 
 bool nesIsCHRRAM ( void )
 {
-   return !CNES::NES()->CART()->IsWriteProtected();
+   return !NES()->CART()->IsWriteProtected();
 }
 
 uint8_t nesGetMapper ( void )
 {
-   return CNES::NES()->CART()->MAPPER();
+   return NES()->CART()->MAPPER();
 }
 
 uint32_t nesMapperLowRead ( uint32_t addr )
 {
-   return CNES::NES()->CART()->DEBUGINFO(addr);
+   return NES()->CART()->DEBUGINFO(addr);
 }
 
 void nesMapperLowWrite ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->LMAPPER(addr,data);
+   NES()->CART()->LMAPPER(addr,data);
 }
 
 uint32_t nesMapperHighRead ( uint32_t addr )
 {
-   return CNES::NES()->CART()->DEBUGINFO(addr);
+   return NES()->CART()->DEBUGINFO(addr);
 }
 
 void nesMapperHighWrite ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->HMAPPER(addr,data);
+   NES()->CART()->HMAPPER(addr,data);
 }
 
 uint32_t nesGetPPUOAM ( uint32_t addr )
 {
-   return CNES::NES()->PPU()->_OAM(addr&3,addr>>2);
+   return NES()->PPU()->_OAM(addr&3,addr>>2);
 }
 
 void nesSetPPUOAM ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->PPU()->_OAM(addr&3,addr>>2,data);
+   NES()->PPU()->_OAM(addr&3,addr>>2,data);
 }
 
 uint32_t nesGetPPUFrame ( void )
 {
-   return CNES::NES()->PPU()->_FRAME();
+   return NES()->PPU()->_FRAME();
 }
 
 uint16_t nesGetPPUAddress ( void )
 {
-   return CNES::NES()->PPU()->_PPUADDR();
+   return NES()->PPU()->_PPUADDR();
 }
 
 uint8_t nesGetPPUOAMAddress ( void )
 {
-   return CNES::NES()->PPU()->_OAMADDR();
+   return NES()->PPU()->_OAMADDR();
 }
 
 uint8_t nesGetPPUReadLatch ( void )
 {
-   return CNES::NES()->PPU()->_PPUREADLATCH();
+   return NES()->PPU()->_PPUREADLATCH();
 }
 
 uint16_t nesGetPPUAddressLatch ( void )
 {
-   return CNES::NES()->PPU()->_PPUADDRLATCH();
+   return NES()->PPU()->_PPUADDRLATCH();
 }
 
 int32_t nesGetPPUFlipFlop ( void )
 {
-   return CNES::NES()->PPU()->_PPUFLIPFLOP();
+   return NES()->PPU()->_PPUFLIPFLOP();
 }
 
 uint32_t nesGetPRGROMPhysicalAddress ( uint32_t addr )
 {
-   return CNES::NES()->CART()->PRGROMPHYSADDR(addr);
+   return NES()->CART()->PRGROMPHYSADDR(addr);
 }
 
 uint32_t nesGetCHRMEMPhysicalAddress ( uint32_t addr )
 {
-   return CNES::NES()->CART()->CHRMEMPHYSADDR(addr);
+   return NES()->CART()->CHRMEMPHYSADDR(addr);
 }
 
 uint32_t nesGetPRGROMData ( uint32_t addr )
 {
-   return CNES::NES()->CART()->PRGROM(addr);
+   return NES()->CART()->PRGROM(addr);
+}
+
+bool nesPRGROMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->CART()->PRGROMCHANGEDSINCE(addr,length,generation);
 }
 
 uint32_t nesGetCHRMEMData ( uint32_t addr )
 {
-   return CNES::NES()->CART()->CHRMEM(addr);
+   return NES()->CART()->CHRMEM(addr);
 }
 
 void nesSetCHRMEMData ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->CHRMEM(addr,data);
+   NES()->CART()->CHRMEM(addr,data);
+}
+
+bool nesCHRMEMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->CART()->CHRMEMCHANGEDSINCE(addr,length,generation);
 }
 
 uint32_t nesGetSRAMPhysicalAddress ( uint32_t addr )
 {
-   return CNES::NES()->CART()->SRAMPHYSADDR(addr);
+   return NES()->CART()->SRAMPHYSADDR(addr);
 }
 
 uint32_t nesGetSRAMDataVirtual ( uint32_t addr )
 {
-   return CNES::NES()->CART()->SRAMVIRT(addr);
+   return NES()->CART()->SRAMVIRT(addr);
 }
 
 void nesSetSRAMDataVirtual ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->SRAMVIRT(addr,data);
+   NES()->CART()->SRAMVIRT(addr,data);
+}
+
+bool nesSRAMDataVirtualChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->CART()->SRAMCHANGEDSINCE(addr,length,generation);
 }
 
 uint32_t nesGetSRAMDataPhysical ( uint32_t addr )
 {
-   return CNES::NES()->CART()->SRAMPHYS(addr);
+   return NES()->CART()->SRAMPHYS(addr);
 }
 
 void nesSetSRAMDataPhysical ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->SRAMPHYS(addr,data);
+   NES()->CART()->SRAMPHYS(addr,data);
 }
 
 void nesLoadSRAMDataPhysical ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->SRAMPHYS(addr,data,false);
+   NES()->CART()->SRAMPHYS(addr,data,false);
 }
 
 bool nesIsSRAMDirty ()
 {
-   return CNES::NES()->CART()->SRAMDIRTY();
+   return NES()->CART()->SRAMDIRTY();
 }
 
 uint32_t nesGetEXRAMPhysicalAddress ( uint32_t addr )
 {
-   return CNES::NES()->CART()->EXRAMPHYSADDR(addr);
+   return NES()->CART()->EXRAMPHYSADDR(addr);
 }
 
 uint32_t nesGetEXRAMData ( uint32_t addr )
 {
-   return CNES::NES()->CART()->EXRAM(addr);
+   return NES()->CART()->EXRAM(addr);
 }
 
 void nesSetEXRAMData ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->EXRAM(addr,data);
+   NES()->CART()->EXRAM(addr,data);
+}
+
+bool nesEXRAMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->CART()->EXRAMCHANGEDSINCE(addr,length,generation);
 }
 
 uint32_t nesGetVRAMData ( uint32_t addr )
 {
-   return CNES::NES()->CART()->VRAM(addr);
+   return NES()->CART()->VRAM(addr);
 }
 
 void nesSetVRAMData ( uint32_t addr, uint32_t data )
 {
-   CNES::NES()->CART()->VRAM(addr,data);
+   NES()->CART()->VRAM(addr,data);
+}
+
+bool nesVRAMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation )
+{
+   return (nesActiveMachineGeneration >= generation) ||
+          NES()->CART()->VRAMCHANGEDSINCE(addr,length,generation);
 }
 
 bool nesMapperRemapsPRGROM ( void )
 {
-   return CNES::NES()->CART()->IsPRGRemappable();
+   return NES()->CART()->IsPRGRemappable();
 }
 
 bool nesMapperRemapsCHRMEM ( void )
 {
-   return CNES::NES()->CART()->IsCHRRemappable();
+   return NES()->CART()->IsCHRRemappable();
 }
 
 uint32_t nesMapperRemappedVMEMSize ( void )
 {
-   return CNES::NES()->CART()->VRAMMEMORY()->TOTALSIZE();
+   return NES()->CART()->VRAMMEMORY()->TOTALSIZE();
 }
 
 uint32_t nesGetPaletteRedComponent(uint32_t idx)
@@ -2042,14 +2471,14 @@ void    nesSetPaletteBlueComponent(uint32_t idx,uint32_t b)
 
 void nesMapper001GetInformation ( nesMapper001Info* pInfo )
 {
-   CROMMapper001* pCART = (CROMMapper001*)CNES::NES()->CART();
+   CROMMapper001* pCART = (CROMMapper001*)NES()->CART();
    pInfo->shiftRegister = pCART->SHIFTREGISTER();
    pInfo->shiftRegisterBit = pCART->SHIFTREGISTERBIT();
 }
 
 void nesMapper004GetInformation ( nesMapper004Info* pInfo )
 {
-   CROMMapper004* pCART = (CROMMapper004*)CNES::NES()->CART();
+   CROMMapper004* pCART = (CROMMapper004*)NES()->CART();
    pInfo->irqAsserted = pCART->IRQASSERTED();
    pInfo->irqCounter = pCART->IRQCOUNTER();
    pInfo->irqEnabled = pCART->IRQENABLED();
@@ -2061,7 +2490,7 @@ void nesMapper004GetInformation ( nesMapper004Info* pInfo )
 
 void nesMapper005GetInformation ( nesMapper005Info* pInfo )
 {
-   CROMMapper005* pCART = (CROMMapper005*)CNES::NES()->CART();
+   CROMMapper005* pCART = (CROMMapper005*)NES()->CART();
    pInfo->irqAsserted = pCART->IRQASSERTED();
    pInfo->irqScanline = pCART->IRQSCANLINE();
    pInfo->irqEnabled = pCART->IRQENABLED();
@@ -2071,7 +2500,7 @@ void nesMapper005GetInformation ( nesMapper005Info* pInfo )
 
 void nesMapper009GetInformation ( nesMapper009010Info* pInfo )
 {
-   CROMMapper009* pCART = (CROMMapper009*)CNES::NES()->CART();
+   CROMMapper009* pCART = (CROMMapper009*)NES()->CART();
    pInfo->latch0FD = pCART->LATCH0FD();
    pInfo->latch0FE = pCART->LATCH0FE();
    pInfo->latch1FD = pCART->LATCH1FD();
@@ -2082,7 +2511,7 @@ void nesMapper009GetInformation ( nesMapper009010Info* pInfo )
 
 void nesMapper010GetInformation ( nesMapper009010Info* pInfo )
 {
-   CROMMapper010* pCART = (CROMMapper010*)CNES::NES()->CART();
+   CROMMapper010* pCART = (CROMMapper010*)NES()->CART();
    pInfo->latch0FD = pCART->LATCH0FD();
    pInfo->latch0FE = pCART->LATCH0FE();
    pInfo->latch1FD = pCART->LATCH1FD();
@@ -2093,7 +2522,7 @@ void nesMapper010GetInformation ( nesMapper009010Info* pInfo )
 
 void nesMapper016GetInformation ( nesMapper016Info* pInfo )
 {
-   CROMMapper016* pCART = (CROMMapper016*)CNES::NES()->CART();
+   CROMMapper016* pCART = (CROMMapper016*)NES()->CART();
    pInfo->irqAsserted = pCART->IRQASSERTED();
    pInfo->irqCounter = pCART->IRQCOUNTER();
    pInfo->irqEnabled = pCART->IRQENABLED();
@@ -2106,7 +2535,7 @@ void nesMapper016GetInformation ( nesMapper016Info* pInfo )
 
 void nesMapper028GetInformation ( nesMapper028Info* pInfo )
 {
-   CROMMapper028* pCART = (CROMMapper028*)CNES::NES()->CART();
+   CROMMapper028* pCART = (CROMMapper028*)NES()->CART();
    pInfo->regSel = pCART->REGSEL();
    pInfo->prgMode = pCART->PRGMODE();
    pInfo->prgSize = pCART->PRGSIZE();
@@ -2117,7 +2546,7 @@ void nesMapper028GetInformation ( nesMapper028Info* pInfo )
 
 void nesMapper069GetInformation ( nesMapper069Info* pInfo )
 {
-   CROMMapper069* pCART = (CROMMapper069*)CNES::NES()->CART();
+   CROMMapper069* pCART = (CROMMapper069*)NES()->CART();
    pInfo->irqAsserted = pCART->IRQASSERTED();
    pInfo->irqCounter = pCART->IRQCOUNTER();
    pInfo->irqEnabled = pCART->IRQENABLED();
@@ -2132,75 +2561,117 @@ void nesMapper069GetInformation ( nesMapper069Info* pInfo )
 void nesGetCpuSnapshot(NESCpuStateSnapshot* pSnapshot)
 {
    int idx;
-   pSnapshot->cycle = CNES::NES()->CPU()->_CYCLES();
-   pSnapshot->pc = CNES::NES()->CPU()->__PC();
-   pSnapshot->pcAtSync = CNES::NES()->CPU()->__PCSYNC();
-   pSnapshot->sp = CNES::NES()->CPU()->_SP();
-   pSnapshot->a = CNES::NES()->CPU()->_A();
-   pSnapshot->x = CNES::NES()->CPU()->_X();
-   pSnapshot->y = CNES::NES()->CPU()->_Y();
-   pSnapshot->f = CNES::NES()->CPU()->_F();
+   pSnapshot->cycle = NES()->CPU()->_CYCLES();
+   pSnapshot->pc = NES()->CPU()->__PC();
+   pSnapshot->pcAtSync = NES()->CPU()->__PCSYNC();
+   pSnapshot->sp = NES()->CPU()->_SP();
+   pSnapshot->a = NES()->CPU()->_A();
+   pSnapshot->x = NES()->CPU()->_X();
+   pSnapshot->y = NES()->CPU()->_Y();
+   pSnapshot->f = NES()->CPU()->_F();
    for ( idx = 0; idx < MEM_2KB; idx++ )
    {
-      *(pSnapshot->memory+idx) = CNES::NES()->CPU()->_MEM(idx);
+      *(pSnapshot->memory+idx) = NES()->CPU()->_MEM(idx);
    }
 }
 
 void nesGetPpuSnapshot(PpuStateSnapshot* pSnapshot)
 {
+   nesGetPpuSnapshotSections(pSnapshot,PPU_SNAPSHOT_ALL);
+}
+
+void nesGetPpuSnapshotSections(PpuStateSnapshot* pSnapshot,uint32_t sections)
+{
+   CPPU* pPPU = NES()->PPU();
    int idx;
-   int x,y;
-   pSnapshot->frame = CNES::NES()->PPU()->_FRAME();
-   pSnapshot->cycle = CNES::NES()->PPU()->_CYCLES();
-   for ( idx = 0; idx < NUM_PPU_REGS; idx++ )
+   int y;
+   pSnapshot->frame = pPPU->_FRAME();
+   pSnapshot->cycle = pPPU->_CYCLES();
+   if ( sections&PPU_SNAPSHOT_REGISTERS )
+   {
+      for ( idx = 0; idx < NUM_PPU_REGS; idx++ )
+      {
+         *(pSnapshot->reg+idx) = pPPU->_PPU(idx);
+      }
+   }
+   if ( sections&PPU_SNAPSHOT_OAM )
    {
-      *(pSnapshot->reg+idx) = CNES::NES()->PPU()->_PPU(idx);
+      for ( idx = 0; idx < MEM_256B; idx++ )
+      {
+         *(pSnapshot->oamMemory+idx) = pPPU->_OAM(idx&3,idx>>2);
+      }
    }
-   for ( idx = 0; idx < MEM_256B; idx++ )
+   if ( sections&PPU_SNAPSHOT_PALETTE )
    {
-      *(pSnapshot->oamMemory+idx) = CNES::NES()->PPU()->_OAM(idx&3,idx>>2);
+      for ( idx = 0; idx < MEM_32B; idx++ )
+      {
+         *(pSnapshot->paletteMemory+idx) = pPPU->_PALETTE(idx);
+      }
    }
-   for ( idx = 0; idx < MEM_32B; idx++ )
+   if ( sections&PPU_SNAPSHOT_PATTERNS )
    {
-      *(pSnapshot->paletteMemory+idx) = CNES::NES()->PPU()->_PALETTE(idx);
+      pPPU->_MEMCOPY(pSnapshot->memory,0x0000,MEM_8KB);
    }
-   for ( idx = 0; idx < MEM_16KB; idx++ )
+   if ( sections&PPU_SNAPSHOT_NAMETABLES )
    {
-      *(pSnapshot->memory+idx) = CNES::NES()->PPU()->_MEM(idx);
+      pPPU->_MEMCOPY(pSnapshot->memory+MEM_8KB,MEM_8KB,MEM_8KB);
    }
-   for ( y = 0; y < 240; y++ )
+   if ( sections&PPU_SNAPSHOT_SCROLL )
    {
-      for ( x = 0; x < 256; x++ )
+      // Only the changes each scanline has are copied.
+      for ( y = 0; y < SCANLINES_VISIBLE; y++ )
+      {
+         *(pSnapshot->scrollChanges+y) = pPPU->_SCROLLCHANGES(y);
+         memcpy(*(pSnapshot->scrollChange+y),pPPU->_SCROLLCHANGE(y),pPPU->_SCROLLCHANGES(y)*sizeof(PpuScrollChange));
+      }
+   }
+}
+
+void nesGetPpuSnapshotScroll(const PpuStateSnapshot* pSnapshot,int32_t x,int32_t y,uint16_t* scrollX,uint16_t* scrollY)
+{
+   const PpuScrollChange* pChange = *(pSnapshot->scrollChange+y);
+   int32_t change;
+
+   if ( !(*(pSnapshot->scrollChanges+y)) )
+   {
+      (*scrollX) = 0;
+      (*scrollY) = 0;
+      return;
+   }
+   for ( change = (*(pSnapshot->scrollChanges+y))-1; change > 0; change-- )
+   {
+      if ( (pChange+change)->x <= x )
       {
-         *(*(pSnapshot->xOffset+x)+y) = CNES::NES()->PPU()->_SCROLLX(x,y);
-         *(*(pSnapshot->yOffset+x)+y) = CNES::NES()->PPU()->_SCROLLY(x,y);
+         break;
       }
    }
+   (*scrollX) = (pChange+change)->scrollX;
+   (*scrollY) = (pChange+change)->scrollY;
 }
 
 void nesGetApuSnapshot(ApuStateSnapshot* pSnapshot)
 {
    int idx;
-   pSnapshot->cycle = CNES::NES()->CPU()->APU()->CYCLES();
+   pSnapshot->cycle = NES()->CPU()->APU()->CYCLES();
    for ( idx = 0; idx < NUM_APU_REGS; idx++ )
    {
-      *(pSnapshot->reg+idx) = CNES::NES()->CPU()->APU()->_APU(idx);
+      *(pSnapshot->reg+idx) = NES()->CPU()->APU()->_APU(idx);
    }
-   pSnapshot->sequencerMode = CNES::NES()->CPU()->APU()->SEQUENCERMODE();
-   CNES::NES()->CPU()->APU()->LINEARCOUNTER(&pSnapshot->triangleLinearCounter);
-   CNES::NES()->CPU()->APU()->LENGTHCOUNTERS(&pSnapshot->lengthCounter[0],
+   pSnapshot->sequencerMode = NES()->CPU()->APU()->SEQUENCERMODE();
+   NES()->CPU()->APU()->LINEARCOUNTER(&pSnapshot->triangleLinearCounter);
+   NES()->CPU()->APU()->LENGTHCOUNTERS(&pSnapshot->lengthCounter[0],
                         &pSnapshot->lengthCounter[1],
                         &pSnapshot->lengthCounter[2],
                         &pSnapshot->lengthCounter[3],
                         &pSnapshot->lengthCounter[4]);
-   CNES::NES()->CPU()->APU()->GETDACS(&pSnapshot->dac[0],
+   NES()->CPU()->APU()->GETDACS(&pSnapshot->dac[0],
                  &pSnapshot->dac[1],
                  &pSnapshot->dac[2],
                  &pSnapshot->dac[3],
                  &pSnapshot->dac[4]);
-   CNES::NES()->CPU()->APU()->DMCIRQ(&pSnapshot->dmcIrqEnabled,&pSnapshot->dmcIrqAsserted);
-   CNES::NES()->CPU()->APU()->SAMPLEINFO(&pSnapshot->dmaSampleAddress,&pSnapshot->dmaSampleLength,&pSnapshot->dmaSamplePosition);
-   CNES::NES()->CPU()->APU()->DMAINFO(&pSnapshot->dmcDmaBuffer,&pSnapshot->dmcDmaFull);
+   NES()->CPU()->APU()->DMCIRQ(&pSnapshot->dmcIrqEnabled,&pSnapshot->dmcIrqAsserted);
+   NES()->CPU()->APU()->SAMPLEINFO(&pSnapshot->dmaSampleAddress,&pSnapshot->dmaSampleLength,&pSnapshot->dmaSamplePosition);
+   NES()->CPU()->APU()->DMAINFO(&pSnapshot->dmcDmaBuffer,&pSnapshot->dmcDmaFull);
 }
 
 void nesGetNesSnapshot(NesStateSnapshot *pSnapshot)
@@ -1,10 +1,6 @@
 #ifndef NES_EMULATOR_CORE_H
 #define NES_EMULATOR_CORE_H
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
 #include <stdint.h> // for standard base types...
 #include <string.h> // for memcpy...
 #include <stdio.h> // for sprintf...
@@ -12,8 +8,13 @@ extern "C" {
 #include "cmemorydata.h"
 #include "cregisterdata.h"
 #include "cmarker.h"
+#include "cprofiler.h"
 #include "cbreakpointinfo.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Common enumerations for emulated items.
 typedef enum
 {
@@ -93,6 +94,25 @@ extern CRegisterDatabase*  m_dbCartRegisters;
 #define MODE_PAL   1
 #define MODE_DENDY 2
 
+// TV output formats.
+// TV_FORMAT_RGBA is a 256x256 surface of 4-byte pixels holding the red,
+// green, blue and alpha bytes of the pixel's colour.  Only the first 240
+// rows are drawn on.
+// TV_FORMAT_INDEXED is a 256x240 surface of 1-byte pixels followed by
+// four bytes per scanline.  The low six bits of a pixel are its NES colour
+// with greyscale already applied and the top two bits pick which of its
+// scanline's four bytes holds the PPUMASK colour emphasis bits (bit 0 red,
+// bit 1 green, bit 2 blue) the pixel was drawn with.  A scanline starts
+// with the first and moves to the next each time emphasis changes, so
+// only a fourth change within one scanline loses anything.  The surface
+// is a quarter the size of an RGBA one so it is cheaper to produce, hash
+// and copy; nesConvertTVOut turns it into an RGBA surface when needed.
+#define TV_FORMAT_RGBA    0
+#define TV_FORMAT_INDEXED 1
+#define TV_SIZE_RGBA      (256*256*4)
+#define TV_INDEXED_EMPHASIS_OFFSET (256*240)
+#define TV_SIZE_INDEXED   (TV_INDEXED_EMPHASIS_OFFSET+(240*4))
+
 #define MAKE16(lo,hi) ((((lo)&0xFF)|(((hi)&0xFF)<<8)))
 
 // CPU interrupt vector memory addresses.
@@ -477,8 +497,9 @@ char* nesGetVersion();
 // The following interfaces are to be used by a UI to interact with the emulation
 // core and perform the necessary steps to emulate a NES game.  Those steps are:
 // 1. Set the NES system mode to MODE_NTSC or MODE_PAL using nesSetSystemMode().
-// 2. Provide a 256x256x3-byte chunk of memory to the emulator core for it to
-//    render the NES TV surface onto, using nesSetTVOut().
+// 2. Provide a 256x256x4-byte chunk of memory to the emulator core for it to
+//    render the NES TV surface onto, using nesSetTVOut().  A smaller indexed
+//    surface can be used instead by calling nesSetTVOutFormat().
 // 3. Clear any emulation state by using nesUnload().
 // 4. Pass 16KB PRG-ROM banks in order and 8KB CHR-ROM banks in order to the emulation
 //    core by using nesLoadPRGROMBank() and nesLoadCHRROMBank() respectively.  If no
@@ -504,6 +525,9 @@ char* nesGetVersion();
 void nesSetSystemMode ( uint32_t mode );
 uint32_t nesGetSystemMode ( void );
 void nesSetTVOut ( int8_t* tv );
+void nesSetTVOutFormat ( uint32_t format );
+uint32_t nesGetTVOutFormat ( void );
+void nesConvertTVOut ( const int8_t* indexed, int8_t* rgba );
 void nesFrontload ( uint32_t mapper );
 void nesLoadPRGROMBank ( uint32_t bank, uint8_t* bankData );
 void nesLoadCHRROMBank ( uint32_t bank, uint8_t* bankData );
@@ -522,9 +546,81 @@ void nesSetControllerScreenPosition ( int32_t port, int32_t px, int32_t py, int3
 void nesSetControllerSpecial ( int32_t port, int32_t special );
 bool nesROMIsLoaded ( void );
 
+// Save state interfaces.
+// nesSaveState writes the complete emulation state into buffer and returns
+// its size in bytes.  If the buffer is NULL or too small nothing is written
+// past its end and the returned size is the size the buffer needs to be.  It
+// returns 0 if the machine is in a state that cannot be saved.
+// nesLoadState restores a state saved with the same cartridge loaded.  If the
+// state does not belong to the cartridge, or was saved by a build whose state
+// layout differs, it returns false and the emulation state is left untouched.
+// Save states do not include the cartridge image, debugger state, recorded
+// input, or audio samples not yet played.
+uint32_t nesSaveState ( uint8_t* buffer, uint32_t size );
+bool nesLoadState ( const uint8_t* buffer, uint32_t size );
+
+// Multiple machine interfaces.
+// A NesMachine is a complete emulated NES.  Machines share no emulation
+// state so any number of them can be created, and each one can be driven
+// from its own thread.  The nesMachine* interfaces mirror the emulation
+// interfaces above but act on the machine they are given.
+//
+// The emulation interfaces above and the debug interfaces below act on the
+// active machine.  Unless another machine is made active the active machine
+// is one created by the emulator core on first use.  Each machine is debugged
+// or not on its own.  The breakpoint and audio hooks, the system palette, and
+// the debugger register, memory, and event databases are shared by all
+// machines.
+class CNES;
+typedef CNES NesMachine;
+
+NesMachine* nesCreateMachine ( void );
+void nesDestroyMachine ( NesMachine* machine );
+void nesSetActiveMachine ( NesMachine* machine );
+NesMachine* nesGetActiveMachine ( void );
+
+void nesMachineSetSystemMode ( NesMachine* machine, uint32_t mode );
+uint32_t nesMachineGetSystemMode ( NesMachine* machine );
+void nesMachineSetTVOut ( NesMachine* machine, int8_t* tv );
+int8_t* nesMachineGetTVOut ( NesMachine* machine );
+void nesMachineSetTVOutFormat ( NesMachine* machine, uint32_t format );
+uint32_t nesMachineGetTVOutFormat ( NesMachine* machine );
+void nesMachineFrontload ( NesMachine* machine, uint32_t mapper );
+void nesMachineLoadPRGROMBank ( NesMachine* machine, uint32_t bank, uint8_t* bankData );
+void nesMachineLoadCHRROMBank ( NesMachine* machine, uint32_t bank, uint8_t* bankData );
+void nesMachineSetHorizontalMirroring ( NesMachine* machine );
+void nesMachineSetVerticalMirroring ( NesMachine* machine );
+void nesMachineSetFourScreen ( NesMachine* machine );
+void nesMachineFinalizeLoad ( NesMachine* machine );
+bool nesMachineROMIsLoaded ( NesMachine* machine );
+void nesMachineReset ( NesMachine* machine, bool soft );
+void nesMachineRun ( NesMachine* machine, uint32_t* joypads );
+int32_t nesMachineGetAudioSamplesAvailable ( NesMachine* machine );
+void nesMachineClearAudioSamplesAvailable ( NesMachine* machine );
+uint8_t* nesMachineGetAudioSamples ( NesMachine* machine, uint16_t samples );
+void nesMachineSetAudioChannelMask ( NesMachine* machine, uint8_t mask );
+void nesMachineSetMMC5AudioChannelMask ( NesMachine* machine, uint32_t mask );
+void nesMachineSetVRC6AudioChannelMask ( NesMachine* machine, uint32_t mask );
+void nesMachineSetN106AudioChannelMask ( NesMachine* machine, uint32_t mask );
+void nesMachineSetControllerType ( NesMachine* machine, int32_t port, int32_t type );
+void nesMachineSetControllerScreenPosition ( NesMachine* machine, int32_t port, int32_t px, int32_t py, int32_t wx1, int32_t wy1, int32_t wx2, int32_t wy2 );
+void nesMachineSetControllerSpecial ( NesMachine* machine, int32_t port, int32_t special );
+void nesMachineResetInputRecording ( NesMachine* machine );
+void nesMachineSetInputPlayback ( NesMachine* machine, bool enable );
+void nesMachineSetInputRecording ( NesMachine* machine, bool enable );
+uint32_t nesMachineGetInputSamplesAvailable ( NesMachine* machine, int32_t port );
+uint32_t nesMachineGetFrame ( NesMachine* machine );
+uint32_t nesMachineGetCPUCycle ( NesMachine* machine );
+uint32_t nesMachineSaveState ( NesMachine* machine, uint8_t* buffer, uint32_t size );
+bool nesMachineLoadState ( NesMachine* machine, const uint8_t* buffer, uint32_t size );
+bool nesMachineStartTraceFile ( NesMachine* machine, const char* fileName );
+bool nesMachineStopTraceFile ( NesMachine* machine );
+void nesMachineEnableDebug ( NesMachine* machine );
+void nesMachineDisableDebug ( NesMachine* machine );
+bool nesMachineIsDebuggable ( NesMachine* machine );
+
 // Internal debug interfaces.
-extern bool __nesdebug;
-#define nesIsDebuggable ( __nesdebug )
+#define nesIsDebuggable ( nesMachineIsDebuggable(nesGetActiveMachine()) )
 void nesBreak ( void );
 void nesBreakAudio ( void );
 
@@ -555,9 +651,23 @@ CRegisterDatabase* nesGetCartridgeRegisterDatabase ( void );
 
 CMarker* nesGetExecutionMarkerDatabase ( void );
 
+// While debugging is enabled and the profiler is enabled, the CPU core
+// keeps a shadow call stack and charges each cycle to the routine on top
+// of it.  The profile belongs to the active machine.  Enabling and
+// clearing take effect at the end of the frame being emulated.
+void nesEnableProfiler ( bool enable );
+bool nesIsProfilerEnabled ( void );
+void nesClearProfiler ( void );
+CProfiler* nesGetProfilerDatabase ( void );
+
 // General debug interfaces.
 void nesEnableDebug ( void );
 void nesDisableDebug ( void );
+// While debugging is enabled, also write the execution trace to a file
+// that the nes-tracequery tool can filter.  Stopping returns false if
+// any of the trace could not be written.
+bool nesStartTraceFile ( const char* fileName );
+bool nesStopTraceFile ( void );
 uint32_t nesGetNumColors ( void );
 uint32_t nesGetPaletteRedComponent(uint32_t idx);
 uint32_t nesGetPaletteGreenComponent(uint32_t idx);
@@ -572,6 +682,17 @@ void nesSetVRC6AudioChannelMask ( uint32_t mask );
 void nesSetN106AudioChannelMask ( uint32_t mask );
 void nesSetAudioChannelMask ( uint8_t mask );
 uint8_t nesGetMemory ( uint32_t addr );
+
+// Memory write generations.  Writes to emulated memory are stamped with the
+// active machine's current generation, in pages of 16 bytes.  A debugger view
+// keeps the generation returned when it last refreshed and passes it to the
+// nes*ChangedSince interfaces to learn whether a range of memory may have
+// changed since then.  Switching the active machine changes everything.
+uint32_t nesAdvanceMemoryGeneration ( void );
+
+// Disassembly.  nesDisassemble brings the text of changed lines up to date
+// and is only to be called by the thread running the machine, or while it
+// is stopped; the lookups can be made from any thread.
 void nesDisassemble ();
 void nesDisassembleSingle ( uint8_t* pOpcode, char* buffer );
 char* nesGetDisassemblyAtAddress ( uint32_t addr );
@@ -603,6 +724,7 @@ bool nesCPUIsWritingMemory ( void );
 uint32_t nesGetCPUEffectiveAddress ( void );
 uint32_t nesGetCPUMemory ( uint32_t addr );
 void nesSetCPUMemory ( uint32_t addr, uint32_t data );
+bool nesCPUMemoryChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 uint32_t nesGetCPURegister ( uint32_t addr );
 void nesSetCPURegister ( uint32_t addr, uint32_t data );
 uint32_t nesGetCPUProgramCounterOfLastSync ( void );
@@ -624,6 +746,7 @@ void nesSetCPUFlagCarry ( uint32_t set );
 // PPU debug interfaces.
 uint32_t nesGetPPUMemory ( uint32_t addr );
 void nesSetPPUMemory ( uint32_t addr, uint32_t data );
+bool nesPPUMemoryChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 uint32_t nesGetPPUCycle ( void );
 uint32_t nesGetPPURegister ( uint32_t addr );
 void nesSetPPURegister ( uint32_t addr, uint32_t data );
@@ -683,11 +806,14 @@ void nesMapperHighWrite ( uint32_t addr, uint32_t data );
 uint32_t nesGetPRGROMPhysicalAddress ( uint32_t addr );
 uint32_t nesGetCHRMEMPhysicalAddress ( uint32_t addr );
 uint32_t nesGetPRGROMData ( uint32_t addr );
+bool nesPRGROMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 uint32_t nesGetCHRMEMData ( uint32_t addr );
 void nesSetCHRMEMData ( uint32_t addr, uint32_t data );
+bool nesCHRMEMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 uint32_t nesGetSRAMPhysicalAddress ( uint32_t addr );
 uint32_t nesGetSRAMDataVirtual ( uint32_t addr );
 void nesSetSRAMDataVirtual ( uint32_t addr, uint32_t data );
+bool nesSRAMDataVirtualChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 uint32_t nesGetSRAMDataPhysical ( uint32_t addr );
 void nesSetSRAMDataPhysical ( uint32_t addr, uint32_t data );
 void nesLoadSRAMDataPhysical ( uint32_t addr, uint32_t data );
@@ -695,8 +821,10 @@ bool nesIsSRAMDirty ();
 uint32_t nesGetEXRAMPhysicalAddress ( uint32_t addr );
 uint32_t nesGetEXRAMData ( uint32_t addr );
 void nesSetEXRAMData ( uint32_t addr, uint32_t data );
+bool nesEXRAMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 uint32_t nesGetVRAMData ( uint32_t addr );
 void nesSetVRAMData ( uint32_t addr, uint32_t data );
+bool nesVRAMDataChangedSince ( uint32_t addr, uint32_t length, uint32_t generation );
 bool nesMapperRemapsPRGROM ( void );
 bool nesMapperRemapsCHRMEM ( void );
 uint32_t nesMapperRemappedVMEMSize ( void );
@@ -715,6 +843,17 @@ typedef struct
 
 void nesGetCpuSnapshot(NESCpuStateSnapshot* pSnapshot);
 
+// The scroll values in effect from pixel x of a visible scanline to the
+// pixel of the scanline's next change, or its end.  Every scanline rendered
+// has at least one change, at pixel 0.
+#define PPU_SCROLL_CHANGES_PER_SCANLINE 32
+typedef struct
+{
+   uint8_t x;
+   uint16_t scrollX;
+   uint16_t scrollY;
+} PpuScrollChange;
+
 typedef struct
 {
    uint32_t frame;
@@ -723,11 +862,25 @@ typedef struct
    uint8_t oamMemory[MEM_256B];
    uint8_t paletteMemory[MEM_32B];
    uint8_t reg[NUM_PPU_REGS];
-   uint16_t xOffset[256][240];
-   uint16_t yOffset[256][240];
+   uint8_t scrollChanges[SCANLINES_VISIBLE];
+   PpuScrollChange scrollChange[SCANLINES_VISIBLE][PPU_SCROLL_CHANGES_PER_SCANLINE];
 } PpuStateSnapshot;
 
+// Sections of the PPU state an inspector can ask for.  Frame and cycle are
+// always filled in.
+#define PPU_SNAPSHOT_REGISTERS  0x01
+#define PPU_SNAPSHOT_OAM        0x02
+#define PPU_SNAPSHOT_PALETTE    0x04
+#define PPU_SNAPSHOT_PATTERNS   0x08 // memory[0x0000-0x1FFF]
+#define PPU_SNAPSHOT_NAMETABLES 0x10 // memory[0x2000-0x3FFF]
+#define PPU_SNAPSHOT_SCROLL     0x20
+#define PPU_SNAPSHOT_ALL        0x3F
+
 void nesGetPpuSnapshot(PpuStateSnapshot* pSnapshot);
+void nesGetPpuSnapshotSections(PpuStateSnapshot* pSnapshot,uint32_t sections);
+
+// Returns the scroll values a snapshot recorded at a visible pixel.
+void nesGetPpuSnapshotScroll(const PpuStateSnapshot* pSnapshot,int32_t x,int32_t y,uint16_t* scrollX,uint16_t* scrollY);
 
 typedef struct
 {
@@ -4,6 +4,21 @@
 //#include <conio.h>
 #include <memory.h>
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+//split candidates are tested on several threads where the compiler has C++11 threads, one at a time otherwise
+
+#if !defined(_MSC_VER)||_MSC_VER>=1900
+#define CANDIDATE_THREADS
+#endif
+
+#ifdef CANDIDATE_THREADS
+#include <atomic>
+#include <thread>
+#endif
+
 
 #define OUT_NESASM	0
 #define OUT_CA65	1
@@ -101,6 +116,21 @@ int dpcm_size;
 char *text_src=NULL;
 int text_size;
 
+//every line is indexed by its first few characters, tags are only looked up at line starts
+
+#define TEXT_KEY_LEN		4
+
+struct textLineStruct {
+	unsigned int key;
+	int off;
+};
+
+textLineStruct *text_lines=NULL;
+int text_lines_count;
+
+int *text_sections=NULL;	//lines starting with [
+int text_sections_count;
+
 FILE *outfile=NULL;
 
 struct outputEnvelopeStruct {
@@ -130,6 +160,25 @@ packedPatternStruct packedPatterns[MAX_PACKED_PATTERNS];
 int packedCount;
 int referenceId;
 
+//every prefix of a packed pattern that could be matched, by its hash, to the first pattern that starts with it
+
+#define PREFIX_MIN_LEN	5
+
+#if defined(_MSC_VER)&&_MSC_VER<1600
+typedef std::tr1::unordered_map<unsigned long long,int> packedPrefixMap;
+#else
+typedef std::unordered_map<unsigned long long,int> packedPrefixMap;
+#endif
+
+packedPrefixMap packedPrefixes;
+
+//packed patterns a size test would add to the common list, kept apart from it so several tests could run at once
+
+struct packedListStruct {
+	std::vector<packedPatternStruct> patterns;
+	packedPrefixMap prefixes;
+};
+
 int outtype;
 
 int channels;
@@ -139,6 +188,132 @@ char songName1[1024];
 
 
 
+unsigned int text_key(const char *str,int len)
+{
+	unsigned int key;
+	int i;
+
+	key=0;
+
+	for(i=0;i<TEXT_KEY_LEN;++i)
+	{
+		key<<=8;
+
+		if(i<len&&str[i]!=0x0a) key|=(unsigned char)str[i]; else len=i;
+	}
+
+	return key;
+}
+
+
+bool text_line_less(const textLineStruct &a,const textLineStruct &b)
+{
+	if(a.key!=b.key) return a.key<b.key;
+
+	return a.off<b.off;
+}
+
+
+void text_index_free(void)
+{
+	if(text_lines)
+	{
+		free(text_lines);
+		text_lines=NULL;
+	}
+
+	if(text_sections)
+	{
+		free(text_sections);
+		text_sections=NULL;
+	}
+
+	text_lines_count=0;
+	text_sections_count=0;
+}
+
+
+void text_index(void)
+{
+	int off,lines;
+
+	text_index_free();
+
+	lines=0;
+
+	for(off=0;off<text_size;++off) if(text_src[off]==0x0a) ++lines;
+
+	text_lines=(textLineStruct*)malloc(lines*sizeof(textLineStruct));
+	text_sections=(int*)malloc(lines*sizeof(int));
+
+	off=0;
+
+	if(text_size>=3&&!memcmp(text_src,"\xef\xbb\xbf",3)) off=3;//utf-8 bom
+
+	while(off<text_size)
+	{
+		while(off<text_size&&text_src[off]==' ') ++off;
+
+		if(off>=text_size) break;
+
+		text_lines[text_lines_count].key=text_key(&text_src[off],text_size-off);
+		text_lines[text_lines_count].off=off;
+		++text_lines_count;
+
+		if(text_src[off]=='[') text_sections[text_sections_count++]=off;
+
+		while(off<text_size) if(text_src[off++]==0x0a) break;
+	}
+
+	//lines are added in order, so each key ends up with its lines in order too
+
+	std::sort(text_lines,text_lines+text_lines_count,text_line_less);
+}
+
+
+//first line at or after off and before limit that starts with the tag, or -1
+
+int text_find_line(const char *tag,int len,int off,int limit)
+{
+	textLineStruct *line,*end,find;
+	int i;
+
+	if(len<TEXT_KEY_LEN)
+	{
+		for(i=off<0?0:off;i<limit&&i<=text_size-len;++i)
+		{
+			if(!memcmp(&text_src[i],tag,len)) return i;
+		}
+
+		return -1;
+	}
+
+	find.key=text_key(tag,len);
+	find.off=off;
+
+	end=text_lines+text_lines_count;
+
+	for(line=std::lower_bound(text_lines,end,find,text_line_less);line<end&&line->key==find.key;++line)
+	{
+		if(line->off>=limit) break;
+
+		if(line->off+len<=text_size&&!memcmp(&text_src[line->off],tag,len)) return line->off;
+	}
+
+	return -1;
+}
+
+
+int text_next_section(int off)
+{
+	int *section;
+
+	section=std::lower_bound(text_sections,text_sections+text_sections_count,off);
+
+	return section<text_sections+text_sections_count?*section:text_size;
+}
+
+
 bool text_open(char *filename)
 {
 	FILE *file;
@@ -189,6 +364,8 @@ bool text_open(char *filename)
 		text=NULL;
 	}
 
+	text_index();
+
 	return true;
 }
 
@@ -201,6 +378,8 @@ void text_close(void)
 		text_src=NULL;
 		text_size=0;
 	}
+
+	text_index_free();
 }
 
 
@@ -263,29 +442,24 @@ int text_skip_hex_and_spaces(int off)
 
 int text_find_tag(const char *tag,int off)
 {
-	int i;
+	int len;
 
-	for(i=off;i<text_size-(int)strlen(tag);++i)
-	{
-		if(!memcmp(&text_src[i],tag,strlen(tag))) return text_skip_spaces(i+strlen(tag));
-	}
+	len=strlen(tag);
+	off=text_find_line(tag,len,off,text_size);
 
-	return -1;
+	return off<0?-1:text_skip_spaces(off+len);
 }
 
 
 int text_find_tag_start_sub_song(const char *tag,int off)
 {
-	int i;
+	int len,limit;
 
-	for(i=off;i<text_size-(int)strlen(tag);++i)
-	{
-		if(!memcmp(&text_src[i],"TRACK",5)) return -1;
+	len=strlen(tag);
+	limit=text_find_line("TRACK",5,off,text_size);
+	off=text_find_line(tag,len,off,limit<0?text_size:limit);
 
-		if(!memcmp(&text_src[i],tag,strlen(tag))) return text_skip_spaces(i+strlen(tag));
-	}
-
-	return -1;
+	return off<0?-1:text_skip_spaces(off+len);
 }
 
 
@@ -304,29 +478,18 @@ int text_skip_tag(int off)
 
 int text_find_tag_section(const char *tag,int off)
 {
-	while(off<text_size-(int)strlen(tag))
-	{
-		if(text_src[off]=='[') break;
+	int len;
 
-		if(!memcmp(&text_src[off],tag,strlen(tag))) return text_skip_spaces(off+strlen(tag));
-
-		++off;
-	}
+	len=strlen(tag);
+	off=text_find_line(tag,len,off,text_next_section(off));
 
-	return -1;
+	return off<0?-1:text_skip_spaces(off+len);
 }
 
 
 int text_find_tag_start(const char *tag,int off)
 {
-	int i;
-
-	for(i=off;i<text_size-(int)strlen(tag);++i)
-	{
-		if(!memcmp(&text_src[i],tag,strlen(tag))) return i;
-	}
-
-	return -1;
+	return text_find_line(tag,strlen(tag),off,text_size);
 }
 
 
@@ -391,7 +554,9 @@ int text_read_hex(int off)
 
 void clear_packed_patterns(void)
 {
-	memset(packedPatterns,0,sizeof(packedPatterns));
+	memset(packedPatterns,0,packedCount*sizeof(packedPatternStruct));
+
+	packedPrefixes.clear();
 
 	packedCount=0;	//clear packed patterns list, it is common for all sub songs
 	referenceId=0;	//global reference id
@@ -424,13 +589,48 @@ void clear_instruments(void)
 }
 
 
+//a parsing error on a candidate test thread is handed back to the main thread, which reports it once the tests are done
+
+#ifdef CANDIDATE_THREADS
+
+struct parseErrorStruct {
+	char message[1024];
+};
+
+thread_local bool parse_error_deferred=false;
+
+#endif
+
+
+
+void parse_error_exit(const char *message)
+{
+#ifdef CANDIDATE_THREADS
+	parseErrorStruct error;
+
+	if(parse_error_deferred)
+	{
+		strcpy(error.message,message);
+
+		throw error;
+	}
+#endif
+
+	printf("%s",message);
+
+	exit(1);
+}
+
+
+
 void parse_error(int off,const char *str)
 {
+	char message[1024];
 	int ptr,row,col;
 
 	if(off<0)
 	{
-		printf("Parsing error: %s\n",str);
+		sprintf(message,"Parsing error: %.960s\n",str);
 	}
 	else
 	{
@@ -449,18 +649,20 @@ void parse_error(int off,const char *str)
 			++col;
 		}
 
-		printf("Parsing error (row %i,col %i): %s\n",row,col,str);
+		sprintf(message,"Parsing error (row %i,col %i): %.960s\n",row,col,str);
 	}
 
-	exit(1);
+	parse_error_exit(message);
 }
 
 
 void parse_error_ptn(int song,int pos,int row,int chn,const char *str)
 {
-	printf("Parsing error (song:%2.2i pos:%2.2x row:%2.2x chn %i): %s\n",song+1,pos,row,chn,str);
+	char message[1024];
 
-	exit(1);
+	sprintf(message,"Parsing error (song:%2.2i pos:%2.2x row:%2.2x chn %i): %.960s\n",song+1,pos,row,chn,str);
+
+	parse_error_exit(message);
 }
 
 
@@ -1833,11 +2035,86 @@ int output_instruments(void)
 
 
 
-int output_song(int sub,int spdchn,bool test)
+//hash of packed data one byte longer than the data hashed before
+
+unsigned long long packed_prefix_hash(unsigned long long hash,unsigned char data)
+{
+	return (hash^data)*0x100000001b3ULL;
+}
+
+
+
+void packed_add_prefixes(packedPrefixMap &prefixes,packedPatternStruct *ptn,int id)
+{
+	unsigned long long hash;
+	int i;
+
+	hash=0xcbf29ce484222325ULL;
+
+	for(i=0;i<ptn->length;++i)
+	{
+		hash=packed_prefix_hash(hash,ptn->data[i]);
+
+		if(i+1>=PREFIX_MIN_LEN) prefixes.insert(std::make_pair(hash+i,id));//keeps the first pattern with the prefix
+	}
+}
+
+
+
+//find the first packed pattern that starts with the given data, in the common list, then among the ones a test added
+
+int packed_find(packedPatternStruct *ptn,packedListStruct *test)
+{
+	packedPrefixMap::iterator it;
+	unsigned long long hash;
+	int i,count;
+
+	hash=0xcbf29ce484222325ULL;
+
+	for(i=0;i<ptn->length;++i) hash=packed_prefix_hash(hash,ptn->data[i]);
+
+	hash+=ptn->length-1;
+
+	it=packedPrefixes.find(hash);
+
+	if(it==packedPrefixes.end())
+	{
+		if(!test) return -1;
+
+		it=test->prefixes.find(hash);
+
+		if(it==test->prefixes.end()) return -1;
+
+		if(!memcmp(ptn->data,test->patterns[it->second].data,ptn->length)) return packedCount+it->second;
+	}
+	else
+	{
+		if(!memcmp(ptn->data,packedPatterns[it->second].data,ptn->length)) return it->second;
+	}
+
+	//hashes of different data matched, look the slow way
+
+	count=packedCount+(test?(int)test->patterns.size():0);
+
+	for(i=0;i<count;++i)
+	{
+		packedPatternStruct *cmp=(i<packedCount)?&packedPatterns[i]:&test->patterns[i-packedCount];
+
+		if(ptn->length<=cmp->length&&!memcmp(ptn->data,cmp->data,ptn->length)) return i;
+	}
+
+	return -1;
+}
+
+
+
+//output a song split into patterns, or only work out its size for a test, with the patterns it would add to the common list going into the test list
+
+int output_song(songStruct *song,int sub,int spdchn,packedListStruct *test)
 {
-	static int ins_renumber[MAX_INSTRUMENTS];
-	int i,ins,chn,srow,pos,ptr,note,size,ref,pcnt,pref,len,n1,n2,nrow,empty,ref_len;
-	static packedPatternStruct tptn;
+	int ins_renumber[MAX_INSTRUMENTS];
+	int i,ins,chn,srow,pos,ptr,note,size,ref,len,n1,n2,nrow,empty,ref_len;
+	packedPatternStruct tptn;
 	rowStruct *row;
 	patternStruct *ptn;
 
@@ -1860,9 +2137,6 @@ int output_song(int sub,int spdchn,bool test)
 
 	//process song data
 
-	pcnt=packedCount;
-	pref=referenceId;
-
 	size=0;
 
 	if(!test) fprintf(outfile,"\n");
@@ -1880,24 +2154,24 @@ int output_song(int sub,int spdchn,bool test)
 			ptr=0;
 
 			tptn.data[ptr++]=0xfb;
-			tptn.data[ptr++]=song_split.speed;
+			tptn.data[ptr++]=song->speed;
 
 			tptn.length=ptr;
 
-			size+=output_dump_byte_array(tptn.data,tptn.length,test);
+			size+=output_dump_byte_array(tptn.data,tptn.length,test!=NULL);
 		}
 
-		for(pos=0;pos<song_split.order_length;++pos)
+		for(pos=0;pos<song->order_length;++pos)
 		{
-			if(!test&&pos==song_split.order_loop) fprintf(outfile,"%ssong%ich%iloop:\n",LL,sub,chn);
+			if(!test&&pos==song->order_loop) fprintf(outfile,"%ssong%ich%iloop:\n",LL,sub,chn);
 
 			ptr=0;
 
-			ptn=&song_split.pattern[pos];
+			ptn=&song->pattern[pos];
 
 			//convert a single pattern
 
-			len=song_split.pattern[pos].length;
+			len=song->pattern[pos].length;
 			srow=0;
 			ref_len=len;//pattern length without repeating empty rows
 
@@ -1981,36 +2255,37 @@ int output_song(int sub,int spdchn,bool test)
 
 			ref=-1;
 
-			if(tptn.length>4)	//search data matches that is longer than the reference itself
+			if(tptn.length>=PREFIX_MIN_LEN)	//search data matches that is longer than the reference itself
 			{
-				for(i=0;i<packedCount;++i)
-				{
-					if(tptn.length<=packedPatterns[i].length)
-					{
-						if(!memcmp(tptn.data,packedPatterns[i].data,tptn.length))//match found
-						{
-							ref=i;
-							break;
-						}
-					}
-				}
+				ref=packed_find(&tptn,test);
 			}
 
 			if(ref<0)//no match found, put data into output and the common data list
 			{
-				if(packedCount>=MAX_PACKED_PATTERNS) parse_error(0,"Not enough room in the common data list");
+				if(packedCount+(test?(int)test->patterns.size():0)>=MAX_PACKED_PATTERNS) parse_error(0,"Not enough room in the common data list");
 
-				memcpy(packedPatterns[packedCount].data,tptn.data,tptn.length);
+				if(!test)
+				{
+					memcpy(packedPatterns[packedCount].data,tptn.data,tptn.length);
 
-				packedPatterns[packedCount].length    =tptn.length;
-				packedPatterns[packedCount].ref_length=tptn.ref_length;
-				packedPatterns[packedCount].ref_id    =referenceId;
-				
-				++packedCount;
+					packedPatterns[packedCount].length    =tptn.length;
+					packedPatterns[packedCount].ref_length=tptn.ref_length;
+					packedPatterns[packedCount].ref_id    =referenceId;
+
+					packed_add_prefixes(packedPrefixes,&packedPatterns[packedCount],packedCount);
+
+					++packedCount;
+
+					fprintf(outfile,"%sref%i:\n",LL,referenceId);
+				}
+				else//do not add packed patterns into the common list while in test mode
+				{
+					packed_add_prefixes(test->prefixes,&tptn,test->patterns.size());
 
-				if(!test) fprintf(outfile,"%sref%i:\n",LL,referenceId);
+					test->patterns.push_back(tptn);
+				}
 
-				size+=output_dump_byte_array(tptn.data,tptn.length,test);
+				size+=output_dump_byte_array(tptn.data,tptn.length,test!=NULL);
 			}
 			else//match found, put reference into output
 			{
@@ -2023,7 +2298,7 @@ int output_song(int sub,int spdchn,bool test)
 				size+=4;
 			}
 
-			++referenceId;
+			if(!test) ++referenceId;
 		}
 
 		if(!test)
@@ -2035,12 +2310,6 @@ int output_song(int sub,int spdchn,bool test)
 		size+=3;
 	}
 
-	if(test)//do not add packed patterns into the common list while in test mode
-	{
-		packedCount=pcnt;
-		referenceId=pref;
-	}
-
 	return size;
 }
 
@@ -2059,7 +2328,7 @@ void output_close(void)
 
 //split songs into shorter patterns by dividing pattern lengths by the factor
 
-void split_song(int factor)
+void split_song(songStruct *song,int factor)
 {
 	int spos,srow,dpos,drow,nlen,cnt;
 
@@ -2073,16 +2342,16 @@ void split_song(int factor)
 
 	//split patterns
 
-	memset(&song_split,0,sizeof(song_split));
+	memset(song,0,sizeof(songStruct));
 
-	song_split.speed=song_original.speed;
-	song_split.tempo=song_original.tempo;
+	song->speed=song_original.speed;
+	song->tempo=song_original.tempo;
 
 	dpos=0;
 
 	for(spos=0;spos<song_original.order_length;++spos)
 	{
-		if(spos==song_original.order_loop) song_split.order_loop=dpos;
+		if(spos==song_original.order_loop) song->order_loop=dpos;
 
 		nlen=song_original.pattern[spos].length/factor;
 
@@ -2092,15 +2361,15 @@ void split_song(int factor)
 
 		for(srow=0;srow<song_original.pattern[spos].length;++srow)
 		{
-			memcpy(&song_split.pattern[dpos].row[drow],&song_original.pattern[spos].row[srow],sizeof(rowStruct));
+			memcpy(&song->pattern[dpos].row[drow],&song_original.pattern[spos].row[srow],sizeof(rowStruct));
 
-			song_split.pattern[dpos].row[drow].speed=song_original.pattern[spos].row[srow].speed;
+			song->pattern[dpos].row[drow].speed=song_original.pattern[spos].row[srow].speed;
 
 			++drow;
 
 			if(drow>=nlen||srow==song_original.pattern[spos].length-1)
 			{
-				song_split.pattern[dpos].length=drow;
+				song->pattern[dpos].length=drow;
 
 				++dpos;
 
@@ -2111,7 +2380,63 @@ void split_song(int factor)
 		}
 	}
 
-	song_split.order_length=dpos;
+	song->order_length=dpos;
+}
+
+
+
+//size tests of every split factor and speed channel, run on as many threads as there are cores
+
+#define MAX_CANDIDATES		(MAX_ROWS/MIN_PATTERN_LEN+1)
+
+struct candidateJobStruct {
+	int sub;
+	int factors;
+#ifdef CANDIDATE_THREADS
+	std::atomic<int> next;
+	parseErrorStruct error[MAX_CANDIDATES];//the first one a test of the factor ran into
+#else
+	int next;
+#endif
+	int size[5][MAX_CANDIDATES];
+};
+
+void test_candidates(candidateJobStruct *job,songStruct *song)
+{
+	packedListStruct test;
+	int factor,spdchn;
+
+#ifdef CANDIDATE_THREADS
+	parse_error_deferred=true;
+#endif
+
+	while((factor=job->next++)<=job->factors)
+	{
+#ifdef CANDIDATE_THREADS
+		try
+		{
+#endif
+			split_song(song,factor);
+
+			for(spdchn=0;spdchn<channels;++spdchn)
+			{
+				test.patterns.clear();
+				test.prefixes.clear();
+
+				job->size[spdchn][factor]=output_song(song,job->sub,spdchn,&test);
+			}
+#ifdef CANDIDATE_THREADS
+		}
+		catch(parseErrorStruct &error)
+		{
+			job->error[factor]=error;
+		}
+#endif
+	}
+
+#ifdef CANDIDATE_THREADS
+	parse_error_deferred=false;
+#endif
 }
 
 
@@ -2120,19 +2445,64 @@ void split_song(int factor)
 
 int process_and_output_song(int sub)
 {
-	int size,spdchn,factor,size_min,best_channel,best_factor;
+	static candidateJobStruct job;
+	std::vector<songStruct*> songs;
+	int i,size,spdchn,factor,size_min,best_channel,best_factor,count;
 
 	size_min=65536;
 	best_channel=0;
 	best_factor=1;
 
+	job.sub=sub;
+	job.factors=song_original.pattern_length/MIN_PATTERN_LEN;
+	job.next=1;
+
+#ifdef CANDIDATE_THREADS
+	std::vector<std::thread> threads;
+
+	count=std::thread::hardware_concurrency();
+#else
+	count=1;
+#endif
+
+	if(count<1) count=1;
+	if(count>job.factors) count=job.factors;
+
+	for(i=0;i<count;++i)
+	{
+		songs.push_back((songStruct*)malloc(sizeof(songStruct)));
+
+		if(!songs[i]) parse_error(-1,"Not enough memory for the split song");
+	}
+
+#ifdef CANDIDATE_THREADS
+	for(factor=0;factor<MAX_CANDIDATES;++factor) job.error[factor].message[0]=0;
+
+	for(i=1;i<count;++i) threads.push_back(std::thread(test_candidates,&job,songs[i]));
+#endif
+
+	if(count>0) test_candidates(&job,songs[0]);
+
+#ifdef CANDIDATE_THREADS
+	for(i=0;i<(int)threads.size();++i) threads[i].join();
+#endif
+
+	for(i=0;i<count;++i) free(songs[i]);
+
+#ifdef CANDIDATE_THREADS
+	//the error a one at a time run would have stopped at
+
+	for(factor=1;factor<=job.factors;++factor)
+	{
+		if(job.error[factor].message[0]) parse_error_exit(job.error[factor].message);
+	}
+#endif
+
 	for(spdchn=0;spdchn<channels;++spdchn)
 	{
-		for(factor=1;factor<=song_original.pattern_length/MIN_PATTERN_LEN;++factor)
+		for(factor=1;factor<=job.factors;++factor)
 		{
-			split_song(factor);
-
-			size=output_song(sub,spdchn,true);
+			size=job.size[spdchn][factor];
 
 			if(size<size_min)
 			{
@@ -2143,11 +2513,11 @@ int process_and_output_song(int sub)
 		}
 	}
 
-	split_song(best_factor);
+	split_song(&song_split,best_factor);
 
 	//song_text_dump(&song_split);
 
-	return output_song(sub,best_channel,false);
+	return output_song(&song_split,sub,best_channel,NULL);
 }
 
 